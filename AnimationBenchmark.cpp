@@ -0,0 +1,214 @@
+#include "AnimationBenchmark.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <sstream>
+
+using namespace math;
+
+namespace
+{
+	// Bones in chains of 9 off the root, about the size of a game character
+	constexpr uint32_t g_BoneCount{ 64 };
+	constexpr uint32_t g_ChainLength{ 9 };
+
+	constexpr uint32_t g_VertexCount{ 4096 };
+	constexpr float g_FrameRate{ 30.f };
+	constexpr uint32_t g_FrameCount{ 121 };		// 4 seconds, the last frame loops back onto the first
+
+	constexpr uint32_t g_CrowdSizes[]{ 16, 64, 256, 1024 };
+	constexpr int g_Iterations{ 32 };
+
+	constexpr double g_FrameBudgetUs{ 1000000.0 / 60.0 };
+
+	constexpr AnimationClip::Tolerance g_Tolerance{ 0.001f, 0.0005f, 0.0005f };
+}
+
+AnimationBenchmark::AnimationBenchmark()
+	: m_Animation{}
+	, m_MaskIndex{ AnimationSystem::g_NoIndex }
+	, m_RigReady{ false }
+	, m_Results{}
+{
+	m_RigReady = CreateRig();
+}
+
+bool AnimationBenchmark::Run()
+{
+	m_Results.clear();
+	if (!m_RigReady)
+	{
+		Logger::Log(L"ERROR - Failed to create the animation benchmark rig");
+		return false;
+	}
+
+	for (const uint32_t characterCount : g_CrowdSizes)
+	{
+		m_Animation.ClearCharacters();
+		AddCharacters(characterCount);
+
+		// First update sizes the palettes and vertex streams
+		m_Animation.Update(1.f / 60.f, true);
+
+		double animateMs{};
+		double skinMs{};
+		for (int iteration{}; iteration < g_Iterations; ++iteration)
+		{
+			m_Animation.Update(1.f / 60.f, true);
+			animateMs += m_Animation.GetStatistics().animateMs;
+			skinMs += m_Animation.GetStatistics().skinMs;
+		}
+
+		const double perCharacter{ 1000.0 / (static_cast<double>(g_Iterations) * characterCount) };
+		m_Results.push_back(Result{ characterCount, animateMs * perCharacter, skinMs * perCharacter });
+	}
+
+	m_Animation.ClearCharacters();
+	LogResults();
+	return true;
+}
+
+// Privates
+// --------
+bool AnimationBenchmark::CreateRig()
+{
+	std::mt19937 randomEngine{ 1337 };	// Fixed seed, same rig every run
+	std::uniform_real_distribution<float> unit{ 0.f, 1.f };
+
+	// Skeleton, bind pose without rotations so the inverse bind matrices are translations
+	std::vector<AnimationSystem::Bone> bones(g_BoneCount);
+	std::vector<Float3> localOffsets(g_BoneCount);
+	std::vector<Float3> bindPositions(g_BoneCount);
+
+	const uint32_t chainCount{ (g_BoneCount - 1 + g_ChainLength - 1) / g_ChainLength };
+	for (uint32_t boneIndex{}; boneIndex < g_BoneCount; ++boneIndex)
+	{
+		int32_t parent{ -1 };
+		Float3 offset{};
+		if (boneIndex > 0)
+		{
+			const uint32_t chainBone{ (boneIndex - 1) % g_ChainLength };
+			const float chainAngle{ g_2Pi * ((boneIndex - 1) / g_ChainLength) / chainCount };
+			parent = chainBone == 0 ? 0 : static_cast<int32_t>(boneIndex - 1);
+			offset = chainBone == 0 ? Float3{ 0.2f * std::cos(chainAngle), 0.f, 0.2f * std::sin(chainAngle) } : Float3{ 0.f, 0.25f, 0.f };
+		}
+
+		localOffsets[boneIndex] = offset;
+		bindPositions[boneIndex] = parent < 0 ? offset : Float3Add(bindPositions[parent], offset);
+
+		Float4x4 inverseBind{};
+		StoreFloat4x4(&inverseBind, MatrixTranslation(-bindPositions[boneIndex].x, -bindPositions[boneIndex].y, -bindPositions[boneIndex].z));
+		bones[boneIndex] = AnimationSystem::Bone{ parent, inverseBind };
+	}
+
+	if (!m_Animation.SetSkeleton(bones)) return false;
+
+	// Two clips of smooth swings, whole periods over the loop so it wraps without a jump
+	for (int clipIndex{}; clipIndex < 2; ++clipIndex)
+	{
+		std::vector<AnimationClip::RawTrack> tracks(g_BoneCount);
+		for (uint32_t boneIndex{}; boneIndex < g_BoneCount; ++boneIndex)
+		{
+			const float amplitude{ 0.2f + 0.4f * unit(randomEngine) };
+			const float phase{ g_2Pi * unit(randomEngine) };
+			const float cycles{ static_cast<float>(1 + clipIndex + boneIndex % 2) };
+
+			AnimationClip::RawTrack& track = tracks[boneIndex];
+			for (uint32_t frame{}; frame < g_FrameCount; ++frame)
+			{
+				const float angle{ g_2Pi * cycles * frame / (g_FrameCount - 1) + phase };
+
+				Float4 rotation{};
+				StoreFloat4(&rotation, QuaternionRotationRollPitchYaw(amplitude * std::sin(angle), 0.5f * amplitude * std::cos(angle), 0.25f * amplitude * std::sin(2.f * angle)));
+				track.rotations.push_back(rotation);
+
+				// Only the root moves, every other bone keeps its offset and compresses to one key
+				Float3 translation{ localOffsets[boneIndex] };
+				if (boneIndex == 0) translation.y += 0.05f * std::sin(2.f * angle);
+				track.translations.push_back(translation);
+				track.scales.push_back(Float3{ 1.f, 1.f, 1.f });
+			}
+		}
+
+		AnimationClip clip{};
+		if (!clip.Build(tracks, g_FrameRate, g_Tolerance)) return false;
+		if (m_Animation.AddClip(std::move(clip)) == AnimationSystem::g_NoIndex) return false;
+	}
+
+	// Mask for a layer that only moves the first half of the chains
+	std::vector<float> mask(g_BoneCount, 0.f);
+	for (uint32_t boneIndex{ 1 }; boneIndex < g_BoneCount; ++boneIndex) mask[boneIndex] = (boneIndex - 1) % g_ChainLength < g_ChainLength / 2 ? 1.f : 0.f;
+	m_MaskIndex = m_Animation.AddMask(mask);
+
+	// Vertices around the bones, 4 influences each: the bone, its parent and two random ones
+	std::uniform_int_distribution<uint32_t> boneDistribution{ 0, g_BoneCount - 1 };
+	std::uniform_real_distribution<float> offset{ -0.1f, 0.1f };
+
+	std::vector<AnimationSystem::SkinnedVertex> vertices(g_VertexCount);
+	for (AnimationSystem::SkinnedVertex& vertex : vertices)
+	{
+		const uint32_t boneIndex{ boneDistribution(randomEngine) };
+		const Float3& bonePosition = bindPositions[boneIndex];
+
+		vertex.position = Float3{ bonePosition.x + offset(randomEngine), bonePosition.y + offset(randomEngine), bonePosition.z + offset(randomEngine) };
+		StoreFloat3(&vertex.normal, Vector3Normalize(VectorSet(offset(randomEngine), offset(randomEngine), offset(randomEngine), 0.f)));
+		vertex.uv = Float2{ unit(randomEngine), unit(randomEngine) };
+
+		const int32_t parent{ (std::max)(bones[boneIndex].parent, 0) };
+		const uint32_t influences[4]{ boneIndex, static_cast<uint32_t>(parent), boneDistribution(randomEngine), boneDistribution(randomEngine) };
+		float weights[4]{ 4.f, 2.f, unit(randomEngine), unit(randomEngine) };
+		const float weightSum{ weights[0] + weights[1] + weights[2] + weights[3] };
+
+		for (int influence{}; influence < 4; ++influence) vertex.boneIndices[influence] = static_cast<uint8_t>(influences[influence]);
+		vertex.boneWeights = Float4{ weights[0] / weightSum, weights[1] / weightSum, weights[2] / weightSum, weights[3] / weightSum };
+	}
+
+	return m_Animation.SetMesh(vertices) && m_MaskIndex != AnimationSystem::g_NoIndex;
+}
+void AnimationBenchmark::AddCharacters(uint32_t characterCount)
+{
+	std::mt19937 randomEngine{ 7 };
+	std::uniform_real_distribution<float> unit{ 0.f, 1.f };
+
+	// Three layers each: a base, a half blend of the other clip and a masked layer over it
+	for (uint32_t characterIndex{}; characterIndex < characterCount; ++characterIndex)
+	{
+		AnimationSystem::Character character{};
+		StoreFloat4x4(&character.worldMatrix, MatrixTranslation(static_cast<float>(characterIndex % 32), 0.f, static_cast<float>(characterIndex / 32)));
+		character.layers[0] = AnimationSystem::Layer{ 0, AnimationSystem::g_NoIndex, 4.f * unit(randomEngine), 1.f, 1.f };
+		character.layers[1] = AnimationSystem::Layer{ 1, AnimationSystem::g_NoIndex, 4.f * unit(randomEngine), 1.f, 0.5f };
+		character.layers[2] = AnimationSystem::Layer{ 1, m_MaskIndex, 4.f * unit(randomEngine), 1.5f, 1.f };
+		character.layerCount = 3;
+		m_Animation.AddCharacter(character);
+	}
+}
+void AnimationBenchmark::LogResults() const
+{
+	for (uint32_t clipIndex{}; clipIndex < 2; ++clipIndex)
+	{
+		const AnimationClip::Statistics& clipStatistics = m_Animation.GetClip(clipIndex).GetStatistics();
+
+		std::wstringstream message;
+		message << L"Animation clip: " << clipStatistics.boneCount << L" bones, " << clipStatistics.frameCount << L" frames, "
+			<< clipStatistics.keyCount << L" of " << clipStatistics.rawKeyCount << L" keys kept, " << clipStatistics.rawBytes / 1024.0 << L" KB to "
+			<< clipStatistics.compressedBytes / 1024.0 << L" KB, max error " << ConvertToDegrees(clipStatistics.maxRotationError) << L" degrees, "
+			<< clipStatistics.maxTranslationError << L" translation, " << clipStatistics.maxScaleError << L" scale, built in " << clipStatistics.buildMs << L" ms";
+		Logger::Log(message.str());
+	}
+
+	for (const Result& result : m_Results)
+	{
+		// Palettes only when the GPU skins, the vertices too when the CPU does
+		const double gpuSkinnedCharacters{ result.animateUs > 0.0 ? g_FrameBudgetUs / result.animateUs : 0.0 };
+		const double cpuSkinnedCharacters{ result.animateUs + result.skinUs > 0.0 ? g_FrameBudgetUs / (result.animateUs + result.skinUs) : 0.0 };
+
+		std::wstringstream message;
+		message << L"Animation benchmark: " << result.characterCount << L" characters of " << g_BoneCount << L" bones and " << g_VertexCount
+			<< L" vertices, " << result.animateUs << L" us animating and " << result.skinUs << L" us skinning per character, "
+			<< static_cast<uint32_t>(gpuSkinnedCharacters) << L" characters per 60 Hz frame skinned on the GPU, "
+			<< static_cast<uint32_t>(cpuSkinnedCharacters) << L" on the CPU";
+		Logger::Log(message.str());
+	}
+}
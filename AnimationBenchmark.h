@@ -0,0 +1,45 @@
+#pragma once
+
+#include "AnimationSystem.h"
+
+#include <vector>
+
+// Times updating and CPU skinning growing crowds on a generated 64 bone rig and logs the characters per 60 Hz frame
+// Also logs how far the clips were compressed and the error that was measured
+class AnimationBenchmark final
+{
+public:
+	// Structs
+	struct Result
+	{
+		uint32_t characterCount;
+		double animateUs;		// Per character
+		double skinUs;
+	};
+
+	// Rule of five
+	AnimationBenchmark();
+	~AnimationBenchmark() = default;
+
+	AnimationBenchmark(const AnimationBenchmark& other) = delete;
+	AnimationBenchmark(AnimationBenchmark&& other) = delete;
+	AnimationBenchmark& operator= (const AnimationBenchmark& other) = delete;
+	AnimationBenchmark& operator= (AnimationBenchmark&& other) = delete;
+
+	// Publics
+	bool Run();	// False when the rig couldn't be created
+
+	const std::vector<Result>& GetResults() const { return m_Results; }
+
+private:
+	// Member variables
+	AnimationSystem m_Animation;
+	uint32_t m_MaskIndex;
+	bool m_RigReady;
+	std::vector<Result> m_Results;
+
+	// Member functions
+	bool CreateRig();
+	void AddCharacters(uint32_t characterCount);
+	void LogResults() const;
+};
@@ -0,0 +1,427 @@
+#include "AnimationClip.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace math;
+
+namespace
+{
+	// Smallest three: the other components of a unit quaternion are never bigger than 1 / sqrt(2)
+	constexpr float g_RotationRange{ 0.707106781f };
+	constexpr float g_RotationStep{ 2.f * g_RotationRange / 32767.f };
+
+	// Greedy key reduction, from every kept key jump to the furthest frame that still rebuilds every frame in between
+	// fitsFrame(first, last, frame, t) tests one frame against the interpolation between two kept keys
+	template <typename FrameTest>
+	void ReduceKeys(uint32_t frameCount, FrameTest fitsFrame, std::vector<uint32_t>& keptFrames)
+	{
+		keptFrames.clear();
+		keptFrames.push_back(0);
+
+		// Constant channels keep only their first key
+		bool constant{ true };
+		for (uint32_t frame{ 1 }; frame < frameCount && constant; ++frame) constant = fitsFrame(0, 0, frame, 0.f);
+		if (constant) return;
+
+		uint32_t first{};
+		while (first < frameCount - 1)
+		{
+			uint32_t last{ first + 1 };
+			for (uint32_t candidate{ first + 2 }; candidate < frameCount; ++candidate)
+			{
+				bool fits{ true };
+				for (uint32_t frame{ first + 1 }; frame < candidate && fits; ++frame)
+				{
+					fits = fitsFrame(first, candidate, frame, static_cast<float>(frame - first) / (candidate - first));
+				}
+				if (!fits) break;
+				last = candidate;
+			}
+
+			keptFrames.push_back(last);
+			first = last;
+		}
+	}
+
+	// Same interpolation as the sampling, the short way around and normalized
+	Vector MATH_CALLCONV InterpolateRotation(Vector rotation0, Vector rotation1, float t)
+	{
+		if (VectorGetX(Vector4Dot(rotation0, rotation1)) < 0.f) rotation1 = VectorNegate(rotation1);
+		return QuaternionNormalize(VectorLerp(rotation0, rotation1, t));
+	}
+
+	float RotationError(Vector rotation, Vector expected)
+	{
+		const float cosHalfAngle{ (std::min)(std::abs(VectorGetX(Vector4Dot(rotation, expected))), 1.f) };
+		return 2.f * std::acos(cosHalfAngle);
+	}
+
+	// Smallest three back to 4 components, 4 rotations at once
+	void DecodeRotations(const float (&stored)[3][4], const float (&largest)[4], Vector (&rotation)[4])
+	{
+		const Vector step{ VectorReplicate(g_RotationStep) };
+		const Vector offset{ VectorReplicate(-g_RotationRange) };
+		const Vector a{ VectorMultiplyAdd(VectorLoad(stored[0]), step, offset) };
+		const Vector b{ VectorMultiplyAdd(VectorLoad(stored[1]), step, offset) };
+		const Vector c{ VectorMultiplyAdd(VectorLoad(stored[2]), step, offset) };
+
+		// The dropped component was made positive when quantizing
+		const Vector lengthSq{ VectorMultiplyAdd(a, a, VectorMultiplyAdd(b, b, VectorMultiply(c, c))) };
+		const Vector w{ VectorSqrt(VectorMax(VectorSubtract(VectorReplicate(1.f), lengthSq), VectorZero())) };
+
+		// The stored components keep their order around the dropped one
+		const Vector index{ VectorLoad(largest) };
+		const Vector is0{ VectorEqual(index, VectorReplicate(0.f)) };
+		const Vector is1{ VectorEqual(index, VectorReplicate(1.f)) };
+		const Vector is2{ VectorEqual(index, VectorReplicate(2.f)) };
+		const Vector is3{ VectorEqual(index, VectorReplicate(3.f)) };
+
+		rotation[0] = VectorSelect(a, w, is0);
+		rotation[1] = VectorSelect(VectorSelect(b, a, is0), w, is1);
+		rotation[2] = VectorSelect(VectorSelect(b, c, is3), w, is2);
+		rotation[3] = VectorSelect(c, w, is3);
+	}
+}
+
+AnimationClip::AnimationClip()
+	: m_BoneCount{}
+	, m_FrameCount{}
+	, m_FrameRate{}
+	, m_Duration{}
+	, m_RotationChannels{}
+	, m_RotationFrames{}
+	, m_RotationKeys{}
+	, m_TranslationChannels{}
+	, m_TranslationFrames{}
+	, m_TranslationKeys{}
+	, m_TranslationRanges{}
+	, m_ScaleChannels{}
+	, m_ScaleFrames{}
+	, m_ScaleKeys{}
+	, m_ScaleRanges{}
+	, m_Statistics{}
+{
+}
+
+bool AnimationClip::Build(const std::vector<RawTrack>& tracks, float frameRate, const Tolerance& tolerance)
+{
+	const auto startTime{ std::chrono::steady_clock::now() };
+
+	*this = AnimationClip{};
+	if (tracks.empty() || !(frameRate > 0.f)) return false;
+
+	// Every channel of every bone is sampled at the same frames
+	const size_t frameCount{ tracks.front().rotations.size() };
+	if (frameCount == 0 || frameCount > g_MaxFrames) return false;
+	for (const RawTrack& track : tracks)
+	{
+		if (track.rotations.size() != frameCount || track.translations.size() != frameCount || track.scales.size() != frameCount) return false;
+	}
+
+	m_BoneCount = static_cast<uint32_t>(tracks.size());
+	m_FrameCount = static_cast<uint32_t>(frameCount);
+	m_FrameRate = frameRate;
+	m_Duration = (m_FrameCount - 1) / frameRate;
+
+	for (const RawTrack& track : tracks)
+	{
+		BuildRotationChannel(track, tolerance.rotation);
+		BuildVectorChannel(track.translations, tolerance.translation, m_TranslationChannels, m_TranslationFrames, m_TranslationKeys, m_TranslationRanges);
+		BuildVectorChannel(track.scales, tolerance.scale, m_ScaleChannels, m_ScaleFrames, m_ScaleKeys, m_ScaleRanges);
+	}
+
+	m_Statistics.boneCount = m_BoneCount;
+	m_Statistics.frameCount = m_FrameCount;
+	m_Statistics.keyCount = static_cast<uint32_t>(m_RotationKeys.size() + m_TranslationKeys.size() + m_ScaleKeys.size());
+	m_Statistics.rawKeyCount = m_BoneCount * m_FrameCount * 3;
+	m_Statistics.rawBytes = static_cast<size_t>(m_BoneCount) * m_FrameCount * (sizeof(Float4) + 2 * sizeof(Float3));
+	m_Statistics.compressedBytes = m_RotationKeys.size() * (sizeof(QuantizedRotation) + sizeof(uint16_t))
+		+ (m_TranslationKeys.size() + m_ScaleKeys.size()) * (sizeof(QuantizedVector) + sizeof(uint16_t))
+		+ static_cast<size_t>(m_BoneCount) * (3 * sizeof(Channel) + 2 * sizeof(Range));
+
+	MeasureError(tracks);
+
+	m_Statistics.buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	return true;
+}
+void AnimationClip::Sample(float time, PoseBlock* pPose) const
+{
+	// Looping, the last frame is only reached at the very end
+	float frame{};
+	if (m_Duration > 0.f)
+	{
+		const float wrapped{ time - std::floor(time / m_Duration) * m_Duration };
+		frame = wrapped * m_FrameRate;
+	}
+
+	SampleFrame(frame, pPose);
+}
+
+// Privates
+// --------
+void AnimationClip::SampleFrame(float frame, PoseBlock* pPose) const
+{
+	frame = std::clamp(frame, 0.f, static_cast<float>(m_FrameCount - 1));
+
+	for (uint32_t firstBone{}; firstBone < m_BoneCount; firstBone += 4, ++pPose)
+	{
+		const uint32_t laneCount{ (std::min)(m_BoneCount - firstBone, 4u) };
+
+		// Gather the keys around the frame, decoding and interpolating runs on all 4 bones at once
+		alignas(16) float stored[2][3][4]{};
+		alignas(16) float largest[2][4]{ { 3.f, 3.f, 3.f, 3.f }, { 3.f, 3.f, 3.f, 3.f } };
+		alignas(16) float rotationT[4]{};
+
+		for (uint32_t lane{}; lane < laneCount; ++lane)
+		{
+			const KeyPair keys{ FindKeys(m_RotationFrames.data(), m_RotationChannels[firstBone + lane], frame) };
+			const QuantizedRotation* pKeys[2]{ &m_RotationKeys[keys.first], &m_RotationKeys[keys.second] };
+
+			for (int key{}; key < 2; ++key)
+			{
+				const uint16_t* pValues{ pKeys[key]->values };
+				for (int component{}; component < 3; ++component) stored[key][component][lane] = static_cast<float>(pValues[component] & 0x7FFF);
+				largest[key][lane] = static_cast<float>((pValues[0] >> 15) | ((pValues[1] >> 15) << 1));
+			}
+			rotationT[lane] = keys.t;
+		}
+
+		Vector rotation0[4]{};
+		Vector rotation1[4]{};
+		DecodeRotations(stored[0], largest[0], rotation0);
+		DecodeRotations(stored[1], largest[1], rotation1);
+
+		// Short way around: flip the second key where the dot product is negative
+		Vector dot{ VectorMultiply(rotation0[0], rotation1[0]) };
+		for (int component{ 1 }; component < 4; ++component) dot = VectorMultiplyAdd(rotation0[component], rotation1[component], dot);
+		const Vector flip{ VectorAndInt(dot, VectorReplicateInt(0x80000000u)) };
+
+		const Vector t{ VectorLoad(rotationT) };
+		Vector rotation[4]{};
+		Vector lengthSq{ VectorZero() };
+		for (int component{}; component < 4; ++component)
+		{
+			rotation[component] = VectorLerpV(rotation0[component], VectorXorInt(rotation1[component], flip), t);
+			lengthSq = VectorMultiplyAdd(rotation[component], rotation[component], lengthSq);
+		}
+
+		// Normalized, padding lanes get the identity
+		const Vector inverseLength{ VectorDivide(VectorReplicate(1.f), VectorSqrt(lengthSq)) };
+		const Vector padding{ VectorLess(VectorSet(0.f, 1.f, 2.f, 3.f), VectorReplicate(static_cast<float>(laneCount))) };
+		const Vector identity[4]{ VectorZero(), VectorZero(), VectorZero(), VectorReplicate(1.f) };
+		for (int component{}; component < 4; ++component)
+		{
+			VectorStore(pPose->rotation[component], VectorSelect(identity[component], VectorMultiply(rotation[component], inverseLength), padding));
+		}
+
+		SampleVectors(&m_TranslationChannels[firstBone], m_TranslationFrames.data(), m_TranslationKeys.data(), &m_TranslationRanges[firstBone], laneCount, frame, 0.f, pPose->translation);
+		SampleVectors(&m_ScaleChannels[firstBone], m_ScaleFrames.data(), m_ScaleKeys.data(), &m_ScaleRanges[firstBone], laneCount, frame, 1.f, pPose->scale);
+	}
+}
+void AnimationClip::BuildRotationChannel(const RawTrack& track, float tolerance)
+{
+	const uint32_t frameCount{ static_cast<uint32_t>(track.rotations.size()) };
+
+	// Reduced against the quantized keys, so the tolerance covers both errors
+	std::vector<QuantizedRotation> quantized(frameCount);
+	std::vector<Float4> decoded(frameCount);
+	for (uint32_t frame{}; frame < frameCount; ++frame)
+	{
+		quantized[frame] = QuantizeRotation(track.rotations[frame]);
+		decoded[frame] = DequantizeRotation(quantized[frame]);
+	}
+
+	const float minCosHalfAngle{ std::cos(0.5f * tolerance) };
+	std::vector<uint32_t> keptFrames;
+	ReduceKeys(frameCount, [&](uint32_t first, uint32_t last, uint32_t frame, float t)
+	{
+		const Vector rotation{ InterpolateRotation(LoadFloat4(&decoded[first]), LoadFloat4(&decoded[last]), t) };
+		return std::abs(VectorGetX(Vector4Dot(rotation, LoadFloat4(&track.rotations[frame])))) >= minCosHalfAngle;
+	}, keptFrames);
+
+	m_RotationChannels.push_back(Channel{ static_cast<uint32_t>(m_RotationKeys.size()), static_cast<uint32_t>(keptFrames.size()) });
+	for (const uint32_t frame : keptFrames)
+	{
+		m_RotationFrames.push_back(static_cast<uint16_t>(frame));
+		m_RotationKeys.push_back(quantized[frame]);
+	}
+}
+void AnimationClip::BuildVectorChannel(const std::vector<Float3>& values, float tolerance,
+	std::vector<Channel>& channels, std::vector<uint16_t>& frames, std::vector<QuantizedVector>& keys, std::vector<Range>& ranges)
+{
+	const uint32_t frameCount{ static_cast<uint32_t>(values.size()) };
+
+	// Quantized inside the range of this track only
+	Vector minimum{ LoadFloat3(&values.front()) };
+	Vector maximum{ minimum };
+	for (const Float3& value : values)
+	{
+		minimum = VectorMin(minimum, LoadFloat3(&value));
+		maximum = VectorMax(maximum, LoadFloat3(&value));
+	}
+
+	Range range{};
+	StoreFloat3(&range.minimum, minimum);
+	StoreFloat3(&range.step, VectorScale(VectorSubtract(maximum, minimum), 1.f / 65535.f));
+
+	const float* pMinimum{ &range.minimum.x };
+	const float* pStep{ &range.step.x };
+
+	std::vector<QuantizedVector> quantized(frameCount);
+	std::vector<Float3> decoded(frameCount);
+	for (uint32_t frame{}; frame < frameCount; ++frame)
+	{
+		const float* pValue{ &values[frame].x };
+		float* pDecoded{ &decoded[frame].x };
+		for (int component{}; component < 3; ++component)
+		{
+			const float value{ pStep[component] > 0.f ? std::round((pValue[component] - pMinimum[component]) / pStep[component]) : 0.f };
+			quantized[frame].values[component] = static_cast<uint16_t>(std::clamp(value, 0.f, 65535.f));
+			pDecoded[component] = pMinimum[component] + quantized[frame].values[component] * pStep[component];
+		}
+	}
+
+	std::vector<uint32_t> keptFrames;
+	ReduceKeys(frameCount, [&](uint32_t first, uint32_t last, uint32_t frame, float t)
+	{
+		const Vector value{ VectorLerp(LoadFloat3(&decoded[first]), LoadFloat3(&decoded[last]), t) };
+		return VectorGetX(Vector3Length(VectorSubtract(value, LoadFloat3(&values[frame])))) <= tolerance;
+	}, keptFrames);
+
+	channels.push_back(Channel{ static_cast<uint32_t>(keys.size()), static_cast<uint32_t>(keptFrames.size()) });
+	ranges.push_back(range);
+	for (const uint32_t frame : keptFrames)
+	{
+		frames.push_back(static_cast<uint16_t>(frame));
+		keys.push_back(quantized[frame]);
+	}
+}
+void AnimationClip::MeasureError(const std::vector<RawTrack>& tracks)
+{
+	// Through the real sampling path, on every source frame
+	std::vector<PoseBlock> pose(GetBlockCount());
+	for (uint32_t frame{}; frame < m_FrameCount; ++frame)
+	{
+		SampleFrame(static_cast<float>(frame), pose.data());
+
+		for (uint32_t bone{}; bone < m_BoneCount; ++bone)
+		{
+			const PoseBlock& block = pose[bone / 4];
+			const uint32_t lane{ bone % 4 };
+
+			const Vector rotation{ VectorSet(block.rotation[0][lane], block.rotation[1][lane], block.rotation[2][lane], block.rotation[3][lane]) };
+			const Vector translation{ VectorSet(block.translation[0][lane], block.translation[1][lane], block.translation[2][lane], 0.f) };
+			const Vector scale{ VectorSet(block.scale[0][lane], block.scale[1][lane], block.scale[2][lane], 0.f) };
+
+			const RawTrack& track = tracks[bone];
+			const float rotationError{ RotationError(rotation, LoadFloat4(&track.rotations[frame])) };
+			const float translationError{ VectorGetX(Vector3Length(VectorSubtract(translation, LoadFloat3(&track.translations[frame])))) };
+			const float scaleError{ VectorGetX(Vector3Length(VectorSubtract(scale, LoadFloat3(&track.scales[frame])))) };
+
+			m_Statistics.maxRotationError = (std::max)(m_Statistics.maxRotationError, rotationError);
+			m_Statistics.maxTranslationError = (std::max)(m_Statistics.maxTranslationError, translationError);
+			m_Statistics.maxScaleError = (std::max)(m_Statistics.maxScaleError, scaleError);
+		}
+	}
+}
+
+AnimationClip::KeyPair AnimationClip::FindKeys(const uint16_t* pFrames, const Channel& channel, float frame)
+{
+	const uint16_t* pFirst{ pFrames + channel.firstKey };
+	const uint16_t* pLast{ pFirst + channel.keyCount };
+
+	// The first key is always frame 0, so there is a key before the one found
+	const uint16_t* pNext{ std::upper_bound(pFirst + 1, pLast, frame, [](float value, uint16_t key) { return value < key; }) };
+	if (pNext == pLast)
+	{
+		const uint32_t lastKey{ channel.firstKey + channel.keyCount - 1 };
+		return KeyPair{ lastKey, lastKey, 0.f };
+	}
+
+	const uint32_t second{ static_cast<uint32_t>(pNext - pFrames) };
+	const float firstFrame{ static_cast<float>(pFrames[second - 1]) };
+	return KeyPair{ second - 1, second, (frame - firstFrame) / (*pNext - firstFrame) };
+}
+void AnimationClip::SampleVectors(const Channel* pChannels, const uint16_t* pFrames, const QuantizedVector* pKeys, const Range* pRanges,
+	uint32_t laneCount, float frame, float fill, float (&output)[3][4])
+{
+	// Padding lanes have an empty range that starts at the fill value
+	alignas(16) float values[2][3][4]{};
+	alignas(16) float minimum[3][4]{ { fill, fill, fill, fill }, { fill, fill, fill, fill }, { fill, fill, fill, fill } };
+	alignas(16) float step[3][4]{};
+	alignas(16) float t[4]{};
+
+	for (uint32_t lane{}; lane < laneCount; ++lane)
+	{
+		const KeyPair keys{ FindKeys(pFrames, pChannels[lane], frame) };
+		const Range& range = pRanges[lane];
+
+		const float* pMinimum{ &range.minimum.x };
+		const float* pStep{ &range.step.x };
+		for (int component{}; component < 3; ++component)
+		{
+			values[0][component][lane] = pKeys[keys.first].values[component];
+			values[1][component][lane] = pKeys[keys.second].values[component];
+			minimum[component][lane] = pMinimum[component];
+			step[component][lane] = pStep[component];
+		}
+		t[lane] = keys.t;
+	}
+
+	const Vector lerp{ VectorLoad(t) };
+	for (int component{}; component < 3; ++component)
+	{
+		const Vector componentMinimum{ VectorLoad(minimum[component]) };
+		const Vector componentStep{ VectorLoad(step[component]) };
+		const Vector value0{ VectorMultiplyAdd(VectorLoad(values[0][component]), componentStep, componentMinimum) };
+		const Vector value1{ VectorMultiplyAdd(VectorLoad(values[1][component]), componentStep, componentMinimum) };
+		VectorStore(output[component], VectorLerpV(value0, value1, lerp));
+	}
+}
+AnimationClip::QuantizedRotation AnimationClip::QuantizeRotation(const Float4& rotation)
+{
+	float components[4]{ rotation.x, rotation.y, rotation.z, rotation.w };
+
+	// Drop the biggest component, made positive since q and -q are the same rotation
+	int largest{};
+	for (int component{ 1 }; component < 4; ++component)
+	{
+		if (std::abs(components[component]) > std::abs(components[largest])) largest = component;
+	}
+	const float sign{ components[largest] < 0.f ? -1.f : 1.f };
+
+	QuantizedRotation quantized{};
+	for (int component{}, stored{}; component < 4; ++component)
+	{
+		if (component == largest) continue;
+
+		const float value{ std::clamp(components[component] * sign, -g_RotationRange, g_RotationRange) };
+		quantized.values[stored++] = static_cast<uint16_t>(std::lround((value + g_RotationRange) / g_RotationStep));
+	}
+
+	quantized.values[0] |= static_cast<uint16_t>((largest & 1) << 15);
+	quantized.values[1] |= static_cast<uint16_t>((largest >> 1) << 15);
+	return quantized;
+}
+Float4 AnimationClip::DequantizeRotation(const QuantizedRotation& rotation)
+{
+	const int largest{ (rotation.values[0] >> 15) | ((rotation.values[1] >> 15) << 1) };
+
+	float stored[3]{};
+	float lengthSq{};
+	for (int component{}; component < 3; ++component)
+	{
+		stored[component] = (rotation.values[component] & 0x7FFF) * g_RotationStep - g_RotationRange;
+		lengthSq += stored[component] * stored[component];
+	}
+
+	float components[4]{};
+	for (int component{}, index{}; component < 4; ++component)
+	{
+		components[component] = component == largest ? std::sqrt((std::max)(1.f - lengthSq, 0.f)) : stored[index++];
+	}
+
+	return Float4{ components[0], components[1], components[2], components[3] };
+}
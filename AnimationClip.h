@@ -0,0 +1,137 @@
+#pragma once
+
+#include "EngineMath.h"
+
+#include <cstdint>
+#include <vector>
+
+// Local bone transforms of one looping clip, compressed once when it's built
+// Rotations are quantized to 48 bits (smallest three), translations and scales to 16 bits per component inside the range of their track
+// Every channel of every bone keeps only the keys it needs: a key is dropped when interpolating its neighbours stays inside the tolerance
+// Sampling decodes and interpolates 4 bones at a time, into the SoA pose blocks
+class AnimationClip final
+{
+public:
+	// Structs
+	struct RawTrack					// One bone, a value for every frame
+	{
+		std::vector<math::Float4> rotations;	// Unit quaternions
+		std::vector<math::Float3> translations;
+		std::vector<math::Float3> scales;
+	};
+
+	struct Tolerance				// Largest error a removed key may cause, quantization included
+	{
+		float rotation;				// Radians
+		float translation;
+		float scale;
+	};
+
+	struct alignas(16) PoseBlock	// Local transforms of 4 bones, lanes past the last bone hold the identity
+	{
+		float rotation[4][4];		// [x, y, z, w][lane]
+		float translation[3][4];
+		float scale[3][4];
+	};
+
+	struct Statistics
+	{
+		uint32_t boneCount;
+		uint32_t frameCount;
+		uint32_t keyCount;			// Kept, over every channel
+		uint32_t rawKeyCount;
+		size_t rawBytes;
+		size_t compressedBytes;
+		float maxRotationError;		// Radians, measured by sampling every frame after the build
+		float maxTranslationError;
+		float maxScaleError;
+		double buildMs;
+	};
+
+	static constexpr uint32_t g_MaxFrames{ 65535 };
+
+	// Rule of five
+	AnimationClip();
+	~AnimationClip() = default;
+
+	AnimationClip(const AnimationClip& other) = delete;
+	AnimationClip(AnimationClip&& other) = default;
+	AnimationClip& operator= (const AnimationClip& other) = delete;
+	AnimationClip& operator= (AnimationClip&& other) = default;
+
+	// Publics
+	bool Build(const std::vector<RawTrack>& tracks, float frameRate, const Tolerance& tolerance);	// Every track needs the same frame count
+	void Sample(float time, PoseBlock* pPose) const;	// Wraps around the duration, fills GetBlockCount() blocks
+
+	uint32_t GetBoneCount() const { return m_BoneCount; }
+	uint32_t GetBlockCount() const { return (m_BoneCount + 3) / 4; }
+	float GetDuration() const { return m_Duration; }
+	const Statistics& GetStatistics() const { return m_Statistics; }
+
+private:
+	// Structs
+	struct QuantizedRotation
+	{
+		uint16_t values[3];			// 15 bits each, the index of the dropped component in the top bits of the first two
+	};
+
+	struct QuantizedVector
+	{
+		uint16_t values[3];
+	};
+
+	struct Channel
+	{
+		uint32_t firstKey;
+		uint32_t keyCount;
+	};
+
+	struct Range					// Dequantized as minimum + value * step
+	{
+		math::Float3 minimum;
+		math::Float3 step;
+	};
+
+	struct KeyPair					// The keys around the sampled time, and how far between them
+	{
+		uint32_t first;
+		uint32_t second;
+		float t;
+	};
+
+	// Member variables
+	uint32_t m_BoneCount;
+	uint32_t m_FrameCount;
+	float m_FrameRate;
+	float m_Duration;
+
+	// Keys of every bone back to back, the channels point into them
+	std::vector<Channel> m_RotationChannels;
+	std::vector<uint16_t> m_RotationFrames;
+	std::vector<QuantizedRotation> m_RotationKeys;
+
+	std::vector<Channel> m_TranslationChannels;
+	std::vector<uint16_t> m_TranslationFrames;
+	std::vector<QuantizedVector> m_TranslationKeys;
+	std::vector<Range> m_TranslationRanges;
+
+	std::vector<Channel> m_ScaleChannels;
+	std::vector<uint16_t> m_ScaleFrames;
+	std::vector<QuantizedVector> m_ScaleKeys;
+	std::vector<Range> m_ScaleRanges;
+
+	Statistics m_Statistics;
+
+	// Member functions
+	void SampleFrame(float frame, PoseBlock* pPose) const;
+	void BuildRotationChannel(const RawTrack& track, float tolerance);
+	void BuildVectorChannel(const std::vector<math::Float3>& values, float tolerance,
+		std::vector<Channel>& channels, std::vector<uint16_t>& frames, std::vector<QuantizedVector>& keys, std::vector<Range>& ranges);
+	void MeasureError(const std::vector<RawTrack>& tracks);
+
+	static KeyPair FindKeys(const uint16_t* pFrames, const Channel& channel, float frame);
+	static void SampleVectors(const Channel* pChannels, const uint16_t* pFrames, const QuantizedVector* pKeys, const Range* pRanges,
+		uint32_t laneCount, float frame, float fill, float (&output)[3][4]);
+	static QuantizedRotation QuantizeRotation(const math::Float4& rotation);
+	static math::Float4 DequantizeRotation(const QuantizedRotation& rotation);
+};
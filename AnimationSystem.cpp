@@ -0,0 +1,312 @@
+#include "AnimationSystem.h"
+
+#include <ppl.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace math;
+
+namespace
+{
+	// Characters per animation or skinning job
+	constexpr uint32_t g_CharactersPerJob{ 8 };
+}
+
+AnimationSystem::AnimationSystem()
+	: m_Bones{}
+	, m_Clips{}
+	, m_Masks{}
+	, m_Mesh{}
+	, m_Characters{}
+	, m_Palettes{}
+	, m_SkinnedVertices{}
+	, m_Statistics{}
+{
+}
+
+bool AnimationSystem::SetSkeleton(const std::vector<Bone>& bones)
+{
+	m_Bones.clear();
+	m_Clips.clear();
+	m_Masks.clear();
+	m_Mesh.clear();
+	ClearCharacters();
+
+	if (bones.empty() || bones.size() > g_MaxBones) return false;
+
+	// Parents first, so a single pass builds every model matrix
+	for (size_t index{}; index < bones.size(); ++index)
+	{
+		if (bones[index].parent < -1 || bones[index].parent >= static_cast<int32_t>(index)) return false;
+	}
+
+	m_Bones = bones;
+	return true;
+}
+bool AnimationSystem::SetMesh(const std::vector<SkinnedVertex>& vertices)
+{
+	for (const SkinnedVertex& vertex : vertices)
+	{
+		for (const uint8_t boneIndex : vertex.boneIndices)
+		{
+			if (boneIndex >= m_Bones.size()) return false;
+		}
+	}
+
+	m_Mesh = vertices;
+	return true;
+}
+uint32_t AnimationSystem::AddClip(AnimationClip&& clip)
+{
+	if (clip.GetBoneCount() != m_Bones.size()) return g_NoIndex;
+
+	m_Clips.push_back(std::move(clip));
+	return static_cast<uint32_t>(m_Clips.size() - 1);
+}
+uint32_t AnimationSystem::AddMask(const std::vector<float>& boneWeights)
+{
+	if (boneWeights.size() != m_Bones.size()) return g_NoIndex;
+
+	// Padding lanes never blend
+	std::vector<float> mask{ boneWeights };
+	mask.resize((m_Bones.size() + 3) & ~size_t{ 3 }, 0.f);
+
+	m_Masks.push_back(std::move(mask));
+	return static_cast<uint32_t>(m_Masks.size() - 1);
+}
+uint32_t AnimationSystem::AddCharacter(const Character& character)
+{
+	if (character.layerCount == 0 || character.layerCount > g_MaxLayers) return g_NoIndex;
+
+	for (uint32_t layerIndex{}; layerIndex < character.layerCount; ++layerIndex)
+	{
+		const Layer& layer = character.layers[layerIndex];
+		if (layer.clipIndex >= m_Clips.size()) return g_NoIndex;
+		if (layer.maskIndex != g_NoIndex && layer.maskIndex >= m_Masks.size()) return g_NoIndex;
+	}
+
+	m_Characters.push_back(character);
+	return static_cast<uint32_t>(m_Characters.size() - 1);
+}
+void AnimationSystem::ClearCharacters()
+{
+	m_Characters.clear();
+	m_Palettes.clear();
+	m_SkinnedVertices.clear();
+}
+
+void AnimationSystem::Update(float deltaTime, bool skinOnCpu)
+{
+	using namespace std::chrono;
+
+	m_Statistics = Statistics{};
+	m_Statistics.characterCount = static_cast<uint32_t>(m_Characters.size());
+	if (m_Characters.empty()) return;
+
+	// Advance the layers, wrapped so the times don't lose precision over a long session
+	for (Character& character : m_Characters)
+	{
+		for (uint32_t layerIndex{}; layerIndex < character.layerCount; ++layerIndex)
+		{
+			Layer& layer = character.layers[layerIndex];
+			const float duration{ m_Clips[layer.clipIndex].GetDuration() };
+			layer.time += layer.speed * deltaTime;
+			if (duration > 0.f) layer.time = std::fmod(layer.time, duration);
+
+			if (layerIndex == 0 || layer.weight > 0.f) ++m_Statistics.sampledLayers;
+		}
+	}
+
+	const uint32_t characterCount{ static_cast<uint32_t>(m_Characters.size()) };
+	const uint32_t jobCount{ (characterCount + g_CharactersPerJob - 1) / g_CharactersPerJob };
+
+	// Sample, blend and build the palettes
+	auto startTime{ steady_clock::now() };
+
+	m_Palettes.resize(static_cast<size_t>(characterCount) * m_Bones.size());
+	Concurrency::parallel_for(0u, jobCount, [&](uint32_t jobIndex)
+	{
+		const uint32_t first{ jobIndex * g_CharactersPerJob };
+		const uint32_t last{ (std::min)(first + g_CharactersPerJob, characterCount) };
+		for (uint32_t characterIndex{ first }; characterIndex < last; ++characterIndex) AnimateCharacter(characterIndex);
+	});
+
+	m_Statistics.animateMs = duration<double, std::milli>(steady_clock::now() - startTime).count();
+
+	// Skin, the GPU does it from the palettes otherwise
+	if (!skinOnCpu || m_Mesh.empty()) return;
+
+	startTime = steady_clock::now();
+
+	m_SkinnedVertices.resize(static_cast<size_t>(characterCount) * m_Mesh.size());
+	Concurrency::parallel_for(0u, jobCount, [&](uint32_t jobIndex)
+	{
+		const uint32_t first{ jobIndex * g_CharactersPerJob };
+		const uint32_t last{ (std::min)(first + g_CharactersPerJob, characterCount) };
+		for (uint32_t characterIndex{ first }; characterIndex < last; ++characterIndex) SkinCharacter(characterIndex);
+	});
+
+	m_Statistics.skinMs = duration<double, std::milli>(steady_clock::now() - startTime).count();
+	m_Statistics.skinnedVertices = characterCount * static_cast<uint32_t>(m_Mesh.size());
+}
+
+// Privates
+// --------
+void AnimationSystem::AnimateCharacter(uint32_t characterIndex)
+{
+	const Character& character = m_Characters[characterIndex];
+	const uint32_t blockCount{ static_cast<uint32_t>(m_Bones.size() + 3) / 4 };
+
+	// Scratch on the stack, every worker animates its own characters
+	AnimationClip::PoseBlock pose[g_MaxBones / 4];
+	AnimationClip::PoseBlock layerPose[g_MaxBones / 4];
+
+	const Layer& baseLayer = character.layers[0];
+	m_Clips[baseLayer.clipIndex].Sample(baseLayer.time, pose);
+
+	for (uint32_t layerIndex{ 1 }; layerIndex < character.layerCount; ++layerIndex)
+	{
+		const Layer& layer = character.layers[layerIndex];
+		if (layer.weight <= 0.f) continue;
+
+		m_Clips[layer.clipIndex].Sample(layer.time, layerPose);
+		BlendPose(pose, layerPose, layer.maskIndex == g_NoIndex ? nullptr : m_Masks[layer.maskIndex].data(), layer.weight, blockCount);
+	}
+
+	BuildPalette(pose, character.worldMatrix, &m_Palettes[static_cast<size_t>(characterIndex) * m_Bones.size()]);
+}
+void AnimationSystem::SkinCharacter(uint32_t characterIndex)
+{
+	const Float4x4* pPalette{ &m_Palettes[static_cast<size_t>(characterIndex) * m_Bones.size()] };
+	Vertex* pOutput{ &m_SkinnedVertices[static_cast<size_t>(characterIndex) * m_Mesh.size()] };
+
+	for (const SkinnedVertex& vertex : m_Mesh)
+	{
+		// Blend the bone matrices by their weights, then transform once
+		const Vector weights{ LoadFloat4(&vertex.boneWeights) };
+		const Vector influenceWeights[4]{ VectorSplatX(weights), VectorSplatY(weights), VectorSplatZ(weights), VectorSplatW(weights) };
+
+		Vector rows[4]{ VectorZero(), VectorZero(), VectorZero(), VectorZero() };
+		for (int influence{}; influence < 4; ++influence)
+		{
+			const Float4x4& bone = pPalette[vertex.boneIndices[influence]];
+			for (int row{}; row < 4; ++row) rows[row] = VectorMultiplyAdd(VectorLoad(bone.m[row]), influenceWeights[influence], rows[row]);
+		}
+
+		const Vector position{ LoadFloat3(&vertex.position) };
+		Vector skinnedPosition{ VectorMultiplyAdd(VectorSplatZ(position), rows[2], rows[3]) };
+		skinnedPosition = VectorMultiplyAdd(VectorSplatY(position), rows[1], skinnedPosition);
+		skinnedPosition = VectorMultiplyAdd(VectorSplatX(position), rows[0], skinnedPosition);
+
+		// Like Surface_VS, the normal goes through the same matrix and is normalized again
+		const Vector normal{ LoadFloat3(&vertex.normal) };
+		Vector skinnedNormal{ VectorMultiply(VectorSplatZ(normal), rows[2]) };
+		skinnedNormal = VectorMultiplyAdd(VectorSplatY(normal), rows[1], skinnedNormal);
+		skinnedNormal = VectorMultiplyAdd(VectorSplatX(normal), rows[0], skinnedNormal);
+
+		StoreFloat3(&pOutput->position, skinnedPosition);
+		StoreFloat3(&pOutput->normal, Vector3Normalize(skinnedNormal));
+		pOutput->uv = vertex.uv;
+		++pOutput;
+	}
+}
+void AnimationSystem::BuildPalette(const AnimationClip::PoseBlock* pPose, const Float4x4& worldMatrix, Float4x4* pPalette) const
+{
+	const uint32_t boneCount{ static_cast<uint32_t>(m_Bones.size()) };
+	const Matrix world{ LoadFloat4x4(&worldMatrix) };
+
+	Matrix modelMatrices[g_MaxBones];
+	for (uint32_t firstBone{}; firstBone < boneCount; firstBone += 4, ++pPose)
+	{
+		// Scale, rotation and translation of 4 bones at once, the same terms as MatrixRotationQuaternion
+		const Vector x{ VectorLoad(pPose->rotation[0]) };
+		const Vector y{ VectorLoad(pPose->rotation[1]) };
+		const Vector z{ VectorLoad(pPose->rotation[2]) };
+		const Vector w{ VectorLoad(pPose->rotation[3]) };
+
+		const Vector two{ VectorReplicate(2.f) };
+		const Vector one{ VectorReplicate(1.f) };
+		const Vector x2{ VectorMultiply(x, two) }, y2{ VectorMultiply(y, two) }, z2{ VectorMultiply(z, two) };
+		const Vector xx{ VectorMultiply(x, x2) }, yy{ VectorMultiply(y, y2) }, zz{ VectorMultiply(z, z2) };
+		const Vector xy{ VectorMultiply(x, y2) }, xz{ VectorMultiply(x, z2) }, yz{ VectorMultiply(y, z2) };
+		const Vector xw{ VectorMultiply(w, x2) }, yw{ VectorMultiply(w, y2) }, zw{ VectorMultiply(w, z2) };
+
+		const Vector scaleX{ VectorLoad(pPose->scale[0]) };
+		const Vector scaleY{ VectorLoad(pPose->scale[1]) };
+		const Vector scaleZ{ VectorLoad(pPose->scale[2]) };
+
+		// Every transpose turns one row of 4 bones into the rows of one bone each
+		const Matrix rows0{ MatrixTranspose(Matrix{ {
+			VectorMultiply(VectorSubtract(VectorSubtract(one, yy), zz), scaleX),
+			VectorMultiply(VectorAdd(xy, zw), scaleX),
+			VectorMultiply(VectorSubtract(xz, yw), scaleX),
+			VectorZero() } }) };
+		const Matrix rows1{ MatrixTranspose(Matrix{ {
+			VectorMultiply(VectorSubtract(xy, zw), scaleY),
+			VectorMultiply(VectorSubtract(VectorSubtract(one, xx), zz), scaleY),
+			VectorMultiply(VectorAdd(yz, xw), scaleY),
+			VectorZero() } }) };
+		const Matrix rows2{ MatrixTranspose(Matrix{ {
+			VectorMultiply(VectorAdd(xz, yw), scaleZ),
+			VectorMultiply(VectorSubtract(yz, xw), scaleZ),
+			VectorMultiply(VectorSubtract(VectorSubtract(one, xx), yy), scaleZ),
+			VectorZero() } }) };
+		const Matrix rows3{ MatrixTranspose(Matrix{ {
+			VectorLoad(pPose->translation[0]),
+			VectorLoad(pPose->translation[1]),
+			VectorLoad(pPose->translation[2]),
+			one } }) };
+
+		// Parents come first, so their model matrices are done already
+		const uint32_t laneCount{ (std::min)(boneCount - firstBone, 4u) };
+		for (uint32_t lane{}; lane < laneCount; ++lane)
+		{
+			const uint32_t boneIndex{ firstBone + lane };
+			const Bone& bone = m_Bones[boneIndex];
+
+			const Matrix local{ { rows0.r[lane], rows1.r[lane], rows2.r[lane], rows3.r[lane] } };
+			modelMatrices[boneIndex] = local * (bone.parent < 0 ? world : modelMatrices[bone.parent]);
+			StoreFloat4x4(&pPalette[boneIndex], LoadFloat4x4(&bone.inverseBindMatrix) * modelMatrices[boneIndex]);
+		}
+	}
+}
+
+void AnimationSystem::BlendPose(AnimationClip::PoseBlock* pPose, const AnimationClip::PoseBlock* pLayerPose, const float* pMask, float weight, uint32_t blockCount)
+{
+	for (uint32_t blockIndex{}; blockIndex < blockCount; ++blockIndex)
+	{
+		AnimationClip::PoseBlock& pose = pPose[blockIndex];
+		const AnimationClip::PoseBlock& layerPose = pLayerPose[blockIndex];
+
+		// Weight per bone, the mask fades the layer out on the bones it doesn't cover
+		Vector t{ VectorReplicate(weight) };
+		if (pMask) t = VectorMultiply(t, VectorLoad(pMask + static_cast<size_t>(blockIndex) * 4));
+
+		// Rotations, nlerp the short way around
+		Vector dot{ VectorZero() };
+		for (int component{}; component < 4; ++component)
+		{
+			dot = VectorMultiplyAdd(VectorLoad(pose.rotation[component]), VectorLoad(layerPose.rotation[component]), dot);
+		}
+		const Vector flip{ VectorAndInt(dot, VectorReplicateInt(0x80000000u)) };
+
+		Vector rotation[4]{};
+		Vector lengthSq{ VectorZero() };
+		for (int component{}; component < 4; ++component)
+		{
+			rotation[component] = VectorLerpV(VectorLoad(pose.rotation[component]), VectorXorInt(VectorLoad(layerPose.rotation[component]), flip), t);
+			lengthSq = VectorMultiplyAdd(rotation[component], rotation[component], lengthSq);
+		}
+
+		const Vector inverseLength{ VectorDivide(VectorReplicate(1.f), VectorSqrt(lengthSq)) };
+		for (int component{}; component < 4; ++component) VectorStore(pose.rotation[component], VectorMultiply(rotation[component], inverseLength));
+
+		// Translations and scales lerp
+		for (int component{}; component < 3; ++component)
+		{
+			VectorStore(pose.translation[component], VectorLerpV(VectorLoad(pose.translation[component]), VectorLoad(layerPose.translation[component]), t));
+			VectorStore(pose.scale[component], VectorLerpV(VectorLoad(pose.scale[component]), VectorLoad(layerPose.scale[component]), t));
+		}
+	}
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "AnimationClip.h"
+#include "EngineMath.h"
+
+#include <cstdint>
+#include <vector>
+
+// Skeletal animation of many characters sharing one skeleton and skinned mesh
+// Every update samples and blends the layers of each character 4 bones at a time, then builds its skinning palette
+// The world matrix is folded into the palette, so skinned vertices come out in world space
+// Skinning runs on the GPU from the palettes (Surface_VS.hlsl with SKINNED), or on the CPU into one vertex stream per character
+// Characters are split over the workers, every step of one character runs on the same worker
+class AnimationSystem final
+{
+public:
+	// Structs
+	struct Bone
+	{
+		int32_t parent;					// Comes before its children, -1 for the root
+		math::Float4x4 inverseBindMatrix;
+	};
+
+	struct SkinnedVertex				// Matches the input of Surface_VS.hlsl with SKINNED
+	{
+		math::Float3 position;
+		math::Float3 normal;
+		math::Float2 uv;
+		uint8_t boneIndices[4];
+		math::Float4 boneWeights;		// Adding up to 1
+	};
+
+	static_assert(sizeof(SkinnedVertex) == 52, "Skinned vertices must stay tightly packed, like the input layout");
+
+	struct Vertex						// CPU skinned, laid out like the input of unskinned Surface_VS.hlsl
+	{
+		math::Float3 position;
+		math::Float3 normal;
+		math::Float2 uv;
+	};
+
+	struct Layer						// Blends over the layers below it by its weight, only on the bones of its mask
+	{
+		uint32_t clipIndex;
+		uint32_t maskIndex;				// g_NoIndex for every bone
+		float time;
+		float speed;					// Playback rate, the time advances by it every update
+		float weight;
+	};
+
+	static constexpr uint32_t g_MaxBones{ 64 };		// Size of the palette in Surface_VS.hlsl
+	static constexpr uint32_t g_MaxLayers{ 4 };
+	static constexpr uint32_t g_NoIndex{ 0xFFFFFFFF };
+
+	struct Character					// The first layer is the base pose, its weight and mask are ignored
+	{
+		math::Float4x4 worldMatrix;
+		Layer layers[g_MaxLayers];
+		uint32_t layerCount;
+	};
+
+	struct Statistics
+	{
+		double animateMs;				// Sampling, blending and building the palettes
+		double skinMs;
+		uint32_t characterCount;
+		uint32_t sampledLayers;
+		uint32_t skinnedVertices;
+	};
+
+	// Rule of five
+	AnimationSystem();
+	~AnimationSystem() = default;
+
+	AnimationSystem(const AnimationSystem& other) = delete;
+	AnimationSystem(AnimationSystem&& other) = delete;
+	AnimationSystem& operator= (const AnimationSystem& other) = delete;
+	AnimationSystem& operator= (AnimationSystem&& other) = delete;
+
+	// Publics
+	bool SetSkeleton(const std::vector<Bone>& bones);		// First, drops the mesh, clips, masks and characters of the old one
+	bool SetMesh(const std::vector<SkinnedVertex>& vertices);
+	uint32_t AddClip(AnimationClip&& clip);					// The add functions return g_NoIndex when it doesn't fit the skeleton
+	uint32_t AddMask(const std::vector<float>& boneWeights);	// One weight per bone
+	uint32_t AddCharacter(const Character& character);
+	void ClearCharacters();
+
+	void Update(float deltaTime, bool skinOnCpu);	// Advances the layers, animates every character and skins them when asked
+
+	Character& GetCharacter(uint32_t index) { return m_Characters[index]; }
+	uint32_t GetCharacterCount() const { return static_cast<uint32_t>(m_Characters.size()); }
+	uint32_t GetBoneCount() const { return static_cast<uint32_t>(m_Bones.size()); }
+	uint32_t GetVertexCount() const { return static_cast<uint32_t>(m_Mesh.size()); }
+	const AnimationClip& GetClip(uint32_t index) const { return m_Clips[index]; }
+
+	const std::vector<math::Float4x4>& GetPalettes() const { return m_Palettes; }		// GetBoneCount() per character, row vectors
+	const std::vector<Vertex>& GetSkinnedVertices() const { return m_SkinnedVertices; }	// GetVertexCount() per character, from the last CPU skinning
+	const std::vector<SkinnedVertex>& GetMesh() const { return m_Mesh; }
+	const Statistics& GetStatistics() const { return m_Statistics; }
+
+private:
+	// Member variables
+	std::vector<Bone> m_Bones;
+	std::vector<AnimationClip> m_Clips;
+	std::vector<std::vector<float>> m_Masks;	// Padded to whole pose blocks
+	std::vector<SkinnedVertex> m_Mesh;
+
+	std::vector<Character> m_Characters;
+	std::vector<math::Float4x4> m_Palettes;
+	std::vector<Vertex> m_SkinnedVertices;
+
+	Statistics m_Statistics;
+
+	// Member functions
+	void AnimateCharacter(uint32_t characterIndex);
+	void SkinCharacter(uint32_t characterIndex);
+	void BuildPalette(const AnimationClip::PoseBlock* pPose, const math::Float4x4& worldMatrix, math::Float4x4* pPalette) const;
+
+	static void BlendPose(AnimationClip::PoseBlock* pPose, const AnimationClip::PoseBlock* pLayerPose, const float* pMask, float weight, uint32_t blockCount);
+};
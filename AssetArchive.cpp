@@ -0,0 +1,262 @@
+#include "AssetArchive.h"
+#include "Hash.h"
+#include "Lz4.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+AssetArchive::~AssetArchive()
+{
+	Close();
+}
+
+bool AssetArchive::Open(const std::wstring& filePath)
+{
+	Close();
+	if (!MapFile(filePath)) return false;
+
+	// Everything the table of contents points at has to be inside the file
+	Header header{};
+	bool valid{ m_Size >= sizeof(Header) };
+	if (valid)
+	{
+		std::memcpy(&header, m_pData, sizeof(Header));
+		// Offsets are compared against what is left of the file, so a huge one can't wrap around
+		valid = header.magic == g_Magic && header.version == g_Version && header.fileSize == m_Size
+			&& header.tocOffset % alignof(Entry) == 0 && header.tocOffset <= m_Size && static_cast<uint64_t>(header.entryCount) * sizeof(Entry) <= m_Size - header.tocOffset
+			&& header.namesOffset % alignof(char16_t) == 0 && header.namesOffset <= m_Size && static_cast<uint64_t>(header.namesLength) * sizeof(char16_t) <= m_Size - header.namesOffset;
+	}
+
+	if (valid)
+	{
+		m_pEntries = reinterpret_cast<const Entry*>(m_pData + header.tocOffset);
+		m_pNames = reinterpret_cast<const char16_t*>(m_pData + header.namesOffset);
+		m_EntryCount = header.entryCount;
+
+		// Sizes are checked here, before Read allocates them: an LZ4 entry can't claim more than its stored bytes decompress to
+		for (uint32_t entryIndex{}; entryIndex < m_EntryCount && valid; ++entryIndex)
+		{
+			const Entry& entry = m_pEntries[entryIndex];
+			valid = entry.dataOffset % g_DataAlignment == 0 && entry.dataOffset <= m_Size && entry.storedSize <= m_Size - entry.dataOffset
+				&& static_cast<uint64_t>(entry.nameOffset) + entry.nameLength <= header.namesLength
+				&& ((entry.compression == Compression::Lz4 && entry.size <= lz4::DecompressBound(entry.storedSize))
+					|| (entry.compression == Compression::None && entry.storedSize == entry.size))
+				&& (entryIndex == 0 || m_pEntries[entryIndex - 1].nameHash <= entry.nameHash);
+		}
+	}
+
+	if (!valid) Close();
+	return valid;
+}
+void AssetArchive::Close()
+{
+	UnmapFile();
+	m_pEntries = nullptr;
+	m_pNames = nullptr;
+	m_EntryCount = 0;
+}
+
+const AssetArchive::Entry* AssetArchive::Find(const std::wstring& name) const
+{
+	if (!IsOpen()) return nullptr;
+
+	const uint64_t nameHash{ HashName(name) };
+	const Entry* pEnd{ m_pEntries + m_EntryCount };
+	const Entry* pEntry{ std::lower_bound(m_pEntries, pEnd, nameHash, [](const Entry& entry, uint64_t hash) { return entry.nameHash < hash; }) };
+
+	// Colliding hashes sit next to each other, the name decides
+	for (; pEntry != pEnd && pEntry->nameHash == nameHash; ++pEntry)
+	{
+		if (pEntry->nameLength == name.size() && std::equal(name.begin(), name.end(), m_pNames + pEntry->nameOffset,
+			[](wchar_t character, char16_t stored) { return static_cast<char16_t>(character) == stored; }))
+		{
+			return pEntry;
+		}
+	}
+
+	return nullptr;
+}
+
+const char* AssetArchive::GetData(const Entry& entry) const
+{
+	return entry.compression == Compression::None ? m_pData + entry.dataOffset : nullptr;
+}
+bool AssetArchive::Read(const Entry& entry, std::vector<char>& bytes) const
+{
+	bytes.resize(static_cast<size_t>(entry.size));
+
+	const char* pStored{ m_pData + entry.dataOffset };
+	if (entry.compression == Compression::Lz4)
+	{
+		if (!lz4::Decompress(pStored, static_cast<size_t>(entry.storedSize), bytes.data(), bytes.size())) return false;
+	}
+	else
+	{
+		std::memcpy(bytes.data(), pStored, bytes.size());
+	}
+
+	return hashing::Fnv1a(bytes.data(), bytes.size()) == entry.contentHash;
+}
+
+bool AssetArchive::Write(const std::wstring& filePath, const std::vector<SourceFile>& files, bool compress)
+{
+	std::vector<Entry> entries(files.size());
+	std::vector<char16_t> names;
+	std::vector<char> data(AlignUp(sizeof(Header), g_DataAlignment), 0);
+
+	std::vector<char> compressed;
+	for (size_t fileIndex{}; fileIndex < files.size(); ++fileIndex)
+	{
+		const SourceFile& file = files[fileIndex];
+		Entry& entry = entries[fileIndex];
+
+		entry.nameHash = HashName(file.name);
+		entry.contentHash = hashing::Fnv1a(file.bytes.data(), file.bytes.size());
+		entry.size = file.bytes.size();
+		entry.sourceWriteTime = file.writeTime;
+		entry.nameOffset = static_cast<uint32_t>(names.size());
+		entry.nameLength = static_cast<uint32_t>(file.name.size());
+		for (const wchar_t character : file.name) names.push_back(static_cast<char16_t>(character));
+
+		const char* pStored{ file.bytes.data() };
+		entry.storedSize = file.bytes.size();
+		entry.compression = Compression::None;
+		if (compress && !file.bytes.empty())
+		{
+			compressed.resize(lz4::CompressBound(file.bytes.size()));
+			const size_t compressedSize{ lz4::Compress(file.bytes.data(), file.bytes.size(), compressed.data(), compressed.size()) };
+			if (compressedSize > 0 && compressedSize <= file.bytes.size() - file.bytes.size() / 8)
+			{
+				pStored = compressed.data();
+				entry.storedSize = compressedSize;
+				entry.compression = Compression::Lz4;
+			}
+		}
+
+		entry.dataOffset = data.size();
+		data.insert(data.end(), pStored, pStored + entry.storedSize);
+		data.resize(AlignUp(data.size(), g_DataAlignment), 0);
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const Entry& first, const Entry& second) { return first.nameHash < second.nameHash; });
+
+	Header header{};
+	header.magic = g_Magic;
+	header.version = g_Version;
+	header.entryCount = static_cast<uint32_t>(entries.size());
+	header.namesLength = static_cast<uint32_t>(names.size());
+	header.tocOffset = data.size();
+	header.namesOffset = header.tocOffset + entries.size() * sizeof(Entry);
+	header.fileSize = header.namesOffset + names.size() * sizeof(char16_t);
+	std::memcpy(data.data(), &header, sizeof(Header));
+
+	// Written next to the target and renamed over it, a reader never maps half an archive
+	const std::filesystem::path targetPath{ filePath };
+	std::filesystem::path temporaryPath{ targetPath };
+	temporaryPath += L".tmp";
+	{
+		std::ofstream file{ temporaryPath, std::ios::binary | std::ios::trunc };
+		if (!file) return false;
+
+		file.write(data.data(), data.size());
+		file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Entry));
+		file.write(reinterpret_cast<const char*>(names.data()), names.size() * sizeof(char16_t));
+		if (!file) return false;
+	}
+
+	std::error_code error{};
+	std::filesystem::rename(temporaryPath, targetPath, error);
+	return !error;
+}
+uint64_t AssetArchive::HashName(const std::wstring& name)
+{
+	// UTF-16 units, so the hash is the same whatever the size of wchar_t
+	hashing::Hasher hasher{};
+	for (const wchar_t character : name) hasher.Add(static_cast<char16_t>(character));
+	return hasher.Get();
+}
+
+// Privates
+// --------
+bool AssetArchive::MapFile(const std::wstring& filePath)
+{
+#ifdef _WIN32
+	const HANDLE file{ CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) };
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	const HANDLE mapping{ CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr) };
+	const void* pView{ mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr };
+	if (!pView)
+	{
+		if (mapping) CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_FileHandle = file;
+	m_MappingHandle = mapping;
+	m_pData = static_cast<const char*>(pView);
+	m_Size = static_cast<uint64_t>(fileSize.QuadPart);
+#else
+	const int file{ open(std::filesystem::path{ filePath }.c_str(), O_RDONLY) };
+	if (file < 0) return false;
+
+	struct stat fileStatus{};
+	if (fstat(file, &fileStatus) != 0 || fileStatus.st_size == 0)
+	{
+		close(file);
+		return false;
+	}
+
+	void* pView{ mmap(nullptr, static_cast<size_t>(fileStatus.st_size), PROT_READ, MAP_PRIVATE, file, 0) };
+	close(file);
+	if (pView == MAP_FAILED) return false;
+
+	m_pData = static_cast<const char*>(pView);
+	m_Size = static_cast<uint64_t>(fileStatus.st_size);
+#endif
+	return true;
+}
+void AssetArchive::UnmapFile()
+{
+	if (!m_pData) return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(m_pData);
+	CloseHandle(static_cast<HANDLE>(m_MappingHandle));
+	CloseHandle(static_cast<HANDLE>(m_FileHandle));
+#else
+	munmap(const_cast<char*>(m_pData), static_cast<size_t>(m_Size));
+#endif
+
+	m_pData = nullptr;
+	m_Size = 0;
+	m_FileHandle = nullptr;
+	m_MappingHandle = nullptr;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Packed archive of resource files, memory mapped as a whole
+// Layout: header, entry data each aligned to g_DataAlignment, then the table of contents sorted by name hash and the names
+// Uncompressed entries are used in place through the mapping, LZ4 entries are decompressed on read
+// Every entry keeps the hash of its original content, reads verify it
+class AssetArchive final
+{
+public:
+	// Structs
+	enum class Compression : uint32_t
+	{
+		None,
+		Lz4
+	};
+
+	struct Entry						// As stored in the file
+	{
+		uint64_t nameHash;
+		uint64_t contentHash;			// Of the uncompressed bytes
+		uint64_t dataOffset;
+		uint64_t storedSize;
+		uint64_t size;
+		int64_t sourceWriteTime;		// Of the loose file it was packed from, to detect stale archives
+		uint32_t nameOffset;			// In UTF-16 units into the names
+		uint32_t nameLength;
+		Compression compression;
+		uint32_t padding;
+	};
+
+	struct SourceFile
+	{
+		std::wstring name;
+		std::vector<char> bytes;
+		int64_t writeTime;
+	};
+
+	static constexpr uint64_t g_DataAlignment{ 64 };
+
+	// Rule of five
+	AssetArchive() = default;
+	~AssetArchive();
+
+	AssetArchive(const AssetArchive& other) = delete;
+	AssetArchive(AssetArchive&& other) = delete;
+	AssetArchive& operator= (const AssetArchive& other) = delete;
+	AssetArchive& operator= (AssetArchive&& other) = delete;
+
+	// Publics
+	bool Open(const std::wstring& filePath);	// Maps the file and validates the table of contents
+	void Close();
+	bool IsOpen() const { return m_pData != nullptr; }
+
+	const Entry* Find(const std::wstring& name) const;	// Binary search on the name hash
+	uint32_t GetEntryCount() const { return m_EntryCount; }
+
+	const char* GetData(const Entry& entry) const;		// Zero copy, nullptr for compressed entries
+	bool Read(const Entry& entry, std::vector<char>& bytes) const;	// Thread-safe, false on a decompression or hash mismatch
+
+	// Entries are only compressed when LZ4 saves at least an eighth of their size
+	static bool Write(const std::wstring& filePath, const std::vector<SourceFile>& files, bool compress);
+	static uint64_t HashName(const std::wstring& name);
+
+private:
+	// Structs
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t namesLength;			// In UTF-16 units
+		uint64_t tocOffset;
+		uint64_t namesOffset;
+		uint64_t fileSize;
+	};
+
+	static constexpr uint32_t g_Magic{ 0x4B504547 };	// "GEPK"
+	static constexpr uint32_t g_Version{ 1 };
+
+	// Member variables
+	const char* m_pData{ nullptr };
+	uint64_t m_Size{ 0 };
+	const Entry* m_pEntries{ nullptr };
+	const char16_t* m_pNames{ nullptr };
+	uint32_t m_EntryCount{ 0 };
+
+	void* m_FileHandle{ nullptr };		// Platform handles of the mapping
+	void* m_MappingHandle{ nullptr };
+
+	// Member functions
+	bool MapFile(const std::wstring& filePath);
+	void UnmapFile();
+};
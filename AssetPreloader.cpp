@@ -0,0 +1,178 @@
+#include "AssetPreloader.h"
+#include "Logger.h"
+#include "Utils.h"
+
+#include <filesystem>
+#include <fstream>
+
+AssetPreloader::~AssetPreloader()
+{
+	// The loads reference the assets, they can't outlive them
+	WaitForAll();
+}
+
+void AssetPreloader::Start(const std::wstring& manifestPath, const std::wstring& archivePath)
+{
+	m_StartTime = std::chrono::steady_clock::now();
+	m_ArchivePath = archivePath;
+	m_Directory = std::filesystem::path{ manifestPath }.parent_path().wstring();
+
+	// One name per line, # starts a comment
+	std::wifstream manifest{ std::filesystem::path{ manifestPath } };
+	if (!manifest)
+	{
+		Logger::Log(L"ERROR - Failed to read the asset manifest, every asset will be loaded on demand");
+		return;
+	}
+
+	std::wstring line;
+	while (std::getline(manifest, line))
+	{
+		const size_t commentStart{ line.find(L'#') };
+		if (commentStart != std::wstring::npos) line.erase(commentStart);
+
+		const size_t first{ line.find_first_not_of(L" \t\r") };
+		if (first == std::wstring::npos) continue;
+		const size_t last{ line.find_last_not_of(L" \t\r") };
+
+		std::wstring name{ line.substr(first, last - first + 1) };
+		if (m_AssetIndices.emplace(name, m_Assets.size()).second)
+		{
+			m_Assets.push_back(Asset{ std::move(name), {}, 0, false, {} });
+		}
+	}
+
+	m_Statistics.assetCount = static_cast<uint32_t>(m_Assets.size());
+	if (m_Assets.empty()) return;
+
+	// Only a few stats of the loose files, cheap enough to do before anything is issued
+	m_Statistics.fromArchive = m_Archive.Open(m_ArchivePath) && IsArchiveCurrent();
+	if (!m_Statistics.fromArchive) m_Archive.Close();
+
+	m_PendingCount.store(static_cast<uint32_t>(m_Assets.size()), std::memory_order_relaxed);
+	for (size_t assetIndex{}; assetIndex < m_Assets.size(); ++assetIndex)
+	{
+		const bool fromArchive{ m_Statistics.fromArchive };
+		m_Assets[assetIndex].loadTask = Concurrency::create_task([this, assetIndex, fromArchive]()
+		{
+			LoadAsset(assetIndex, fromArchive);
+
+			// The last load finishes the statistics and, on a cold start, packs the archive for the next one
+			if (m_PendingCount.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+			m_Statistics.loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_StartTime).count();
+			if (!fromArchive) PackArchive();
+		});
+	}
+}
+bool AssetPreloader::Read(const std::wstring& name, std::vector<char>& bytes)
+{
+	const auto foundIt = m_AssetIndices.find(name);
+	if (foundIt == m_AssetIndices.end())
+	{
+		const AssetArchive::Entry* pEntry{ m_Archive.Find(name) };
+		if (pEntry) return m_Archive.Read(*pEntry, bytes);
+
+		return utils::ReadBinaryFile(m_Directory + L"/" + name, bytes);
+	}
+
+	const std::chrono::steady_clock::time_point waitStart{ std::chrono::steady_clock::now() };
+	Asset& asset = m_Assets[foundIt->second];
+	asset.loadTask.wait();
+	m_WaitUs.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - waitStart).count(), std::memory_order_relaxed);
+
+	// Copied, the same asset may be asked for again when the device is recreated
+	if (!asset.loaded) return false;
+	bytes = asset.bytes;
+	return true;
+}
+const AssetPreloader::Statistics& AssetPreloader::GetStatistics()
+{
+	WaitForAll();
+	m_Statistics.waitMs = m_WaitUs.load(std::memory_order_relaxed) / 1000.0;
+	return m_Statistics;
+}
+
+// Privates
+// --------
+bool AssetPreloader::IsArchiveCurrent() const
+{
+	for (const Asset& asset : m_Assets)
+	{
+		const AssetArchive::Entry* pEntry{ m_Archive.Find(asset.name) };
+		if (!pEntry) return false;
+
+		// A shipped archive doesn't need the loose files, but a loose file that changed wins
+		uint64_t size{};
+		const int64_t writeTime{ GetWriteTime(asset.name, size) };
+		if (writeTime != 0 && (writeTime != pEntry->sourceWriteTime || size != pEntry->size)) return false;
+	}
+
+	return true;
+}
+void AssetPreloader::LoadAsset(size_t assetIndex, bool fromArchive)
+{
+	Asset& asset = m_Assets[assetIndex];
+	if (fromArchive)
+	{
+		const AssetArchive::Entry* pEntry{ m_Archive.Find(asset.name) };
+		asset.loaded = pEntry && m_Archive.Read(*pEntry, asset.bytes);
+	}
+	else
+	{
+		uint64_t size{};
+		asset.writeTime = GetWriteTime(asset.name, size);
+		asset.loaded = utils::ReadBinaryFile(m_Directory + L"/" + asset.name, asset.bytes);
+	}
+
+	if (!asset.loaded)
+	{
+		Logger::Log(L"ERROR - Failed to preload " + asset.name);
+		asset.bytes.clear();
+	}
+}
+void AssetPreloader::PackArchive()
+{
+	const std::chrono::steady_clock::time_point packStart{ std::chrono::steady_clock::now() };
+
+	std::vector<AssetArchive::SourceFile> files;
+	files.reserve(m_Assets.size());
+	for (const Asset& asset : m_Assets)
+	{
+		if (asset.loaded) files.push_back(AssetArchive::SourceFile{ asset.name, asset.bytes, asset.writeTime });
+	}
+
+	m_Statistics.packed = AssetArchive::Write(m_ArchivePath, files, true);
+	m_Statistics.packMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - packStart).count();
+
+	if (!m_Statistics.packed) Logger::Log(L"ERROR - Failed to write the asset archive, the next start will be cold as well");
+}
+void AssetPreloader::WaitForAll()
+{
+	for (Asset& asset : m_Assets) asset.loadTask.wait();
+
+	uint64_t byteCount{};
+	uint32_t failedCount{};
+	for (const Asset& asset : m_Assets)
+	{
+		byteCount += asset.bytes.size();
+		if (!asset.loaded) ++failedCount;
+	}
+
+	m_Statistics.byteCount = byteCount;
+	m_Statistics.failedCount = failedCount;
+}
+int64_t AssetPreloader::GetWriteTime(const std::wstring& name, uint64_t& size) const
+{
+	// 0 when the loose file doesn't exist
+	const std::filesystem::path filePath{ m_Directory + L"/" + name };
+
+	std::error_code error{};
+	const auto writeTime{ std::filesystem::last_write_time(filePath, error) };
+	if (error) return 0;
+
+	size = static_cast<uint64_t>(std::filesystem::file_size(filePath, error));
+	if (error) return 0;
+
+	return static_cast<int64_t>(writeTime.time_since_epoch().count());
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "AssetArchive.h"
+
+#include <ppltasks.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Loads every asset listed in a manifest on the job system, so the reads overlap whatever the caller does meanwhile
+// Warm start: the archive is current, assets come out of its mapping
+// Cold start: the archive is missing or stale, assets are read as loose files and packed into a new archive for the next run
+// Read() only blocks on the one asset it asks for
+class AssetPreloader final
+{
+public:
+	// Structs
+	struct Statistics
+	{
+		bool fromArchive;
+		bool packed;				// Cold start wrote a new archive
+		uint32_t assetCount;
+		uint32_t failedCount;
+		uint64_t byteCount;
+		double loadMs;				// Start until the last asset was in memory
+		double packMs;
+		double waitMs;				// Time Read() spent blocked on unfinished assets
+	};
+
+	// Rule of five
+	AssetPreloader() = default;
+	~AssetPreloader();
+
+	AssetPreloader(const AssetPreloader& other) = delete;
+	AssetPreloader(AssetPreloader&& other) = delete;
+	AssetPreloader& operator= (const AssetPreloader& other) = delete;
+	AssetPreloader& operator= (AssetPreloader&& other) = delete;
+
+	// Publics
+	void Start(const std::wstring& manifestPath, const std::wstring& archivePath);	// Names in the manifest are relative to its folder
+	bool Read(const std::wstring& name, std::vector<char>& bytes);	// Thread-safe, unlisted names are read directly
+	const Statistics& GetStatistics();								// Waits for every load first
+
+private:
+	// Structs
+	struct Asset
+	{
+		std::wstring name;
+		std::vector<char> bytes;
+		int64_t writeTime;
+		bool loaded;
+		Concurrency::task<void> loadTask;
+	};
+
+	// Member variables
+	AssetArchive m_Archive{};
+	std::wstring m_ArchivePath{};
+	std::wstring m_Directory{};
+
+	std::vector<Asset> m_Assets{};			// Never resized once the loads started
+	std::unordered_map<std::wstring, size_t> m_AssetIndices{};
+
+	std::chrono::steady_clock::time_point m_StartTime{};
+	std::atomic<uint32_t> m_PendingCount{ 0 };
+	std::atomic<int64_t> m_WaitUs{ 0 };
+	Statistics m_Statistics{};
+
+	// Member functions
+	bool IsArchiveCurrent() const;
+	void LoadAsset(size_t assetIndex, bool fromArchive);
+	void PackArchive();
+	void WaitForAll();
+	int64_t GetWriteTime(const std::wstring& name, uint64_t& size) const;
+};
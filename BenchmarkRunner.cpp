@@ -0,0 +1,76 @@
+#include "AnimationBenchmark.h"
+#include "DepthRejectionBenchmark.h"
+#include "HandleTableBenchmark.h"
+#include "LightClusterBenchmark.h"
+#include "Logger.h"
+#include "MathBenchmark.h"
+#include "MultiViewCullingBenchmark.h"
+#include "PipelineStateCacheBenchmark.h"
+#include "RayQueryBenchmark.h"
+#include "ShadowBenchmark.h"
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+
+// Entry point of the Graphics_Engine_Benchmarks console target, no window and no render device
+// Runs every benchmark, or the ones named on the command line, and exits with 1 when any of their checks failed
+
+namespace
+{
+	struct Benchmark
+	{
+		const char* pName;
+		bool (*pRun)();		// False when a check failed
+	};
+
+	constexpr Benchmark g_Benchmarks[]
+	{
+		{ "Shadow", [] { return ShadowBenchmark{}.Run(); } },
+		{ "Math", [] { return MathBenchmark{}.Run(); } },
+		{ "Animation", [] { return AnimationBenchmark{}.Run(); } },
+		{ "RayQuery", [] { return RayQueryBenchmark{}.Run(); } },
+		{ "HandleTable", [] { return HandleTableBenchmark{}.Run(); } },
+		{ "DepthRejection", [] { return DepthRejectionBenchmark{}.Run(); } },
+		{ "MultiViewCulling", [] { return MultiViewCullingBenchmark{}.Run(); } },
+		{ "LightCluster", [] { return LightClusterBenchmark{}.Run(); } },
+		{ "PipelineStateCache", [] { return PipelineStateCacheBenchmark{}.Run(); } },
+	};
+
+	bool IsSelected(const Benchmark& benchmark, int argc, char* argv[])
+	{
+		if (argc <= 1) return true;
+
+		for (int argumentIndex{ 1 }; argumentIndex < argc; ++argumentIndex)
+		{
+			if (std::strcmp(argv[argumentIndex], benchmark.pName) == 0) return true;
+		}
+		return false;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::wstringstream message;
+	uint32_t runCount{};
+	uint32_t failedCount{};
+	for (const Benchmark& benchmark : g_Benchmarks)
+	{
+		if (!IsSelected(benchmark, argc, argv)) continue;
+
+		++runCount;
+		if (benchmark.pRun()) continue;
+
+		++failedCount;
+		message.str(L"");
+		message << L"ERROR - " << benchmark.pName << L" benchmark failed";
+		Logger::Log(message.str());
+	}
+
+	message.str(L"");
+	message << L"Benchmarks: " << runCount - failedCount << L" of " << runCount << L" passed";
+	Logger::Log(message.str());
+
+	// A misspelled name runs nothing, that shouldn't pass
+	return failedCount > 0 || runCount == 0 ? 1 : 0;
+}
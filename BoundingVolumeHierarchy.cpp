@@ -0,0 +1,760 @@
+#include "BoundingVolumeHierarchy.h"
+
+#include <ppl.h>
+#include <intrin.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+using namespace math;
+
+namespace
+{
+	constexpr float g_Infinity{ std::numeric_limits<float>::infinity() };
+	constexpr BoundingVolumeHierarchy::Bounds g_EmptyBounds{ { g_Infinity, g_Infinity, g_Infinity }, { -g_Infinity, -g_Infinity, -g_Infinity } };
+
+	constexpr uint32_t g_BinCount{ 16 };
+	constexpr uint32_t g_MaxLeafSize{ 4 };			// One SoA block
+
+	// Binary depth, past the first half the splits fall back to the median, which halves the primitives every level
+	constexpr uint32_t g_MaxDepth{ 64 };
+	constexpr uint32_t g_MedianDepth{ g_MaxDepth - 32 };
+	constexpr uint32_t g_StackSize{ g_MaxDepth * 3 + 1 };
+
+	// Relative costs for the heuristic, testing 4 boxes costs about as much as testing 4 triangles
+	// Primitives are counted in whole blocks of 4, a leaf of 1 costs as much as a leaf of 4
+	constexpr float g_TraversalCost{ 1.f };
+	constexpr float g_IntersectionCost{ 1.f };
+
+	constexpr size_t g_RaysPerJob{ 256 };
+
+	// Zero direction components are nudged, so the slab tests never multiply 0 by infinity
+	constexpr float g_MinDirection{ 1e-20f };
+	constexpr float g_MinDeterminant{ 1e-12f };
+
+	float GetBlockCount(uint32_t primitiveCount)
+	{
+		return static_cast<float>((primitiveCount + 3) / 4);
+	}
+	float GetAxis(const Float3& vector, uint32_t axis)
+	{
+		return axis == 0 ? vector.x : axis == 1 ? vector.y : vector.z;
+	}
+}
+
+// Ray splatted over the 4 lanes, built once per query
+struct BoundingVolumeHierarchy::RayData
+{
+	Vector origin[3];
+	Vector direction[3];
+	Vector inverseDirection[3];
+	uint32_t nearPlane[3];			// 0 when the minimum is entered first, 1 when the maximum is
+
+	explicit RayData(const Ray& ray)
+	{
+		const float origins[3]{ ray.origin.x, ray.origin.y, ray.origin.z };
+		const float directions[3]{ ray.direction.x, ray.direction.y, ray.direction.z };
+
+		for (uint32_t axis{}; axis < 3; ++axis)
+		{
+			const float nudged{ std::fabs(directions[axis]) < g_MinDirection ? std::copysign(g_MinDirection, directions[axis]) : directions[axis] };
+
+			origin[axis] = VectorReplicate(origins[axis]);
+			direction[axis] = VectorReplicate(directions[axis]);
+			inverseDirection[axis] = VectorReplicate(1.f / nudged);
+			nearPlane[axis] = nudged < 0.f ? 1 : 0;
+		}
+	}
+};
+
+void BoundingVolumeHierarchy::Build(const void* pPositions, uint32_t positionStride, uint32_t vertexCount, const uint32_t* pIndices, uint32_t indexCount)
+{
+	using namespace std::chrono;
+	const steady_clock::time_point startTime{ steady_clock::now() };
+
+	const uint32_t triangleCount{ vertexCount > 0 ? indexCount / 3 : 0 };
+
+	m_PrimitiveType = PrimitiveType::Triangles;
+	m_VertexCount = vertexCount;
+	m_TriangleIndices.assign(pIndices, pIndices + static_cast<size_t>(triangleCount) * 3);
+	m_Boxes.clear();
+
+	std::vector<Float3> positions;
+	ReadPositions(pPositions, positionStride, positions);
+
+	m_PrimitiveBounds.resize(triangleCount);
+	for (uint32_t triangle{}; triangle < triangleCount; ++triangle)
+	{
+		Bounds& bounds = m_PrimitiveBounds[triangle];
+		bounds = g_EmptyBounds;
+		for (uint32_t corner{}; corner < 3; ++corner)
+		{
+			const Float3& position = positions[m_TriangleIndices[triangle * 3 + corner]];
+			Grow(bounds, Bounds{ position, position });
+		}
+	}
+
+	BuildHierarchy();
+
+	m_Triangles.resize(m_Leaves.size());
+	for (uint32_t leafIndex{}; leafIndex < m_Leaves.size(); ++leafIndex) WriteTriangleBlock(leafIndex, positions);
+
+	m_Statistics.buildMs = duration<double, std::milli>(steady_clock::now() - startTime).count();
+}
+void BoundingVolumeHierarchy::Build(const std::vector<Bounds>& bounds)
+{
+	using namespace std::chrono;
+	const steady_clock::time_point startTime{ steady_clock::now() };
+
+	m_PrimitiveType = PrimitiveType::Bounds;
+	m_VertexCount = 0;
+	m_TriangleIndices.clear();
+	m_Triangles.clear();
+	m_PrimitiveBounds = bounds;
+
+	BuildHierarchy();
+
+	m_Boxes.resize(m_Leaves.size());
+	for (uint32_t leafIndex{}; leafIndex < m_Leaves.size(); ++leafIndex) WriteBoxBlock(leafIndex);
+
+	m_Statistics.buildMs = duration<double, std::milli>(steady_clock::now() - startTime).count();
+}
+void BoundingVolumeHierarchy::Refit(const void* pPositions, uint32_t positionStride)
+{
+	using namespace std::chrono;
+	if (m_PrimitiveType != PrimitiveType::Triangles || m_Nodes.empty()) return;
+
+	const steady_clock::time_point startTime{ steady_clock::now() };
+
+	std::vector<Float3> positions;
+	ReadPositions(pPositions, positionStride, positions);
+
+	for (uint32_t triangle{}; triangle < m_PrimitiveBounds.size(); ++triangle)
+	{
+		Bounds& bounds = m_PrimitiveBounds[triangle];
+		bounds = g_EmptyBounds;
+		for (uint32_t corner{}; corner < 3; ++corner)
+		{
+			const Float3& position = positions[m_TriangleIndices[triangle * 3 + corner]];
+			Grow(bounds, Bounds{ position, position });
+		}
+	}
+
+	for (uint32_t leafIndex{}; leafIndex < m_Leaves.size(); ++leafIndex) WriteTriangleBlock(leafIndex, positions);
+	RefitNodes();
+
+	m_Statistics.refitMs = duration<double, std::milli>(steady_clock::now() - startTime).count();
+}
+void BoundingVolumeHierarchy::Refit(const std::vector<Bounds>& bounds)
+{
+	using namespace std::chrono;
+	if (m_PrimitiveType != PrimitiveType::Bounds || m_Nodes.empty() || bounds.size() != m_PrimitiveBounds.size()) return;
+
+	const steady_clock::time_point startTime{ steady_clock::now() };
+
+	m_PrimitiveBounds = bounds;
+	for (uint32_t leafIndex{}; leafIndex < m_Leaves.size(); ++leafIndex) WriteBoxBlock(leafIndex);
+	RefitNodes();
+
+	m_Statistics.refitMs = duration<double, std::milli>(steady_clock::now() - startTime).count();
+}
+
+BoundingVolumeHierarchy::Hit BoundingVolumeHierarchy::Intersect(const Ray& ray) const
+{
+	Hit hit{ g_NoHit, ray.maxDistance };
+	if (m_Nodes.empty()) return hit;
+
+	const RayData rayData{ ray };
+	Traverse(rayData, hit.distance, true, [&](uint32_t leafIndex)
+	{
+		alignas(16) float distances[4];
+		uint32_t hitMask{ IntersectLeaf(leafIndex, rayData, hit.distance, distances) };
+		while (hitMask)
+		{
+			unsigned long lane{};
+			_BitScanForward(&lane, hitMask);
+			hitMask &= hitMask - 1;
+
+			if (distances[lane] > hit.distance) continue;
+			hit.distance = distances[lane];
+			hit.primitive = m_Leaves[leafIndex].primitives[lane];
+		}
+		return false;
+	});
+
+	return hit;
+}
+bool BoundingVolumeHierarchy::IntersectAny(const Ray& ray) const
+{
+	if (m_Nodes.empty()) return false;
+
+	// No ordering, the first hit ends the walk
+	const RayData rayData{ ray };
+	float maxDistance{ ray.maxDistance };
+	bool isHit{ false };
+	Traverse(rayData, maxDistance, false, [&](uint32_t leafIndex)
+	{
+		alignas(16) float distances[4];
+		isHit = IntersectLeaf(leafIndex, rayData, maxDistance, distances) != 0;
+		return isHit;
+	});
+
+	return isHit;
+}
+void BoundingVolumeHierarchy::IntersectAll(const Ray& ray, std::vector<Hit>& hits) const
+{
+	hits.clear();
+	if (m_Nodes.empty()) return;
+
+	const RayData rayData{ ray };
+	float maxDistance{ ray.maxDistance };
+	Traverse(rayData, maxDistance, false, [&](uint32_t leafIndex)
+	{
+		alignas(16) float distances[4];
+		uint32_t hitMask{ IntersectLeaf(leafIndex, rayData, maxDistance, distances) };
+		while (hitMask)
+		{
+			unsigned long lane{};
+			_BitScanForward(&lane, hitMask);
+			hitMask &= hitMask - 1;
+
+			hits.push_back(Hit{ m_Leaves[leafIndex].primitives[lane], distances[lane] });
+		}
+		return false;
+	});
+
+	std::sort(hits.begin(), hits.end(), [](const Hit& first, const Hit& second) { return first.distance < second.distance; });
+}
+void BoundingVolumeHierarchy::IntersectBatch(const std::vector<Ray>& rays, std::vector<Hit>& hits) const
+{
+	hits.resize(rays.size());
+
+	const size_t jobCount{ (rays.size() + g_RaysPerJob - 1) / g_RaysPerJob };
+	Concurrency::parallel_for(static_cast<size_t>(0), jobCount, [&](size_t jobIndex)
+	{
+		const size_t first{ jobIndex * g_RaysPerJob };
+		const size_t last{ (std::min)(first + g_RaysPerJob, rays.size()) };
+		for (size_t rayIndex{ first }; rayIndex < last; ++rayIndex) hits[rayIndex] = Intersect(rays[rayIndex]);
+	});
+}
+void BoundingVolumeHierarchy::QueryOverlaps(const Bounds& bounds, std::vector<uint32_t>& primitives) const
+{
+	primitives.clear();
+	if (m_Nodes.empty()) return;
+
+	const Vector minimum[3]{ VectorReplicate(bounds.minimum.x), VectorReplicate(bounds.minimum.y), VectorReplicate(bounds.minimum.z) };
+	const Vector maximum[3]{ VectorReplicate(bounds.maximum.x), VectorReplicate(bounds.maximum.y), VectorReplicate(bounds.maximum.z) };
+
+	uint32_t stack[g_StackSize];
+	uint32_t stackSize{ 1 };
+	stack[0] = 0;
+
+	while (stackSize > 0)
+	{
+		const Node& node = m_Nodes[stack[--stackSize]];
+
+		// All 4 children against the box at once, the inverted empty lanes never overlap
+		Vector overlap{ VectorTrueInt() };
+		for (uint32_t axis{}; axis < 3; ++axis)
+		{
+			overlap = VectorAndInt(overlap, VectorLessOrEqual(VectorLoad(node.bounds.planes[0][axis]), maximum[axis]));
+			overlap = VectorAndInt(overlap, VectorGreaterOrEqual(VectorLoad(node.bounds.planes[1][axis]), minimum[axis]));
+		}
+
+		uint32_t overlapMask{ VectorMoveMask(overlap) };
+		while (overlapMask)
+		{
+			unsigned long lane{};
+			_BitScanForward(&lane, overlapMask);
+			overlapMask &= overlapMask - 1;
+
+			const uint32_t child{ node.children[lane] };
+			if (!(child & g_LeafFlag))
+			{
+				stack[stackSize++] = child;
+				continue;
+			}
+
+			const Leaf& leaf = m_Leaves[child & ~g_LeafFlag];
+			for (uint32_t index{}; index < leaf.count; ++index)
+			{
+				const Bounds& primitiveBounds = m_PrimitiveBounds[leaf.primitives[index]];
+				if (primitiveBounds.minimum.x <= bounds.maximum.x && primitiveBounds.maximum.x >= bounds.minimum.x
+					&& primitiveBounds.minimum.y <= bounds.maximum.y && primitiveBounds.maximum.y >= bounds.minimum.y
+					&& primitiveBounds.minimum.z <= bounds.maximum.z && primitiveBounds.maximum.z >= bounds.minimum.z)
+				{
+					primitives.push_back(leaf.primitives[index]);
+				}
+			}
+		}
+	}
+}
+
+// Privates
+// --------
+void BoundingVolumeHierarchy::BuildHierarchy()
+{
+	m_Nodes.clear();
+	m_Leaves.clear();
+	m_RootBounds = Bounds{};
+	m_Statistics = Statistics{};
+
+	const uint32_t primitiveCount{ static_cast<uint32_t>(m_PrimitiveBounds.size()) };
+	m_Statistics.primitiveCount = primitiveCount;
+	if (primitiveCount == 0) return;
+
+	m_Centroids.resize(primitiveCount);
+	for (uint32_t primitive{}; primitive < primitiveCount; ++primitive)
+	{
+		const Bounds& bounds = m_PrimitiveBounds[primitive];
+		StoreFloat3(&m_Centroids[primitive], VectorScale(VectorAdd(LoadFloat3(&bounds.minimum), LoadFloat3(&bounds.maximum)), 0.5f));
+	}
+
+	m_PrimitiveOrder.resize(primitiveCount);
+	std::iota(m_PrimitiveOrder.begin(), m_PrimitiveOrder.end(), 0u);
+
+	// A binary tree has at most one inner node less than it has leaves, so the nodes never move while building
+	m_BuildNodes.clear();
+	m_BuildNodes.reserve(static_cast<size_t>(primitiveCount) * 2);
+	m_BuildNodes.push_back(BuildNode{});
+	BuildBinaryNode(0, 0, primitiveCount, 0);
+
+	const BuildNode& root = m_BuildNodes.front();
+	m_RootBounds = root.bounds;
+
+	// The root is always a node, even when everything fits in one leaf
+	const float rootArea{ (std::max)(GetSurfaceArea(root.bounds), std::numeric_limits<float>::min()) };
+	if (root.count > 0)
+	{
+		Node node{};
+		for (uint32_t lane{}; lane < 4; ++lane)
+		{
+			SetLane(node.bounds, lane, lane == 0 ? root.bounds : g_EmptyBounds);
+			node.children[lane] = g_EmptyChild;
+		}
+		m_Nodes.push_back(node);
+		m_Statistics.sahCost = g_TraversalCost + g_IntersectionCost;
+		m_Nodes.front().children[0] = g_LeafFlag | CreateLeaf(root);
+		m_Statistics.maxDepth = 1;
+	}
+	else
+	{
+		CollapseNode(0, 1, rootArea);
+	}
+
+	m_Statistics.nodeCount = static_cast<uint32_t>(m_Nodes.size());
+	m_Statistics.leafCount = static_cast<uint32_t>(m_Leaves.size());
+
+	// Only needed while building
+	m_BuildNodes = std::vector<BuildNode>{};
+	m_PrimitiveOrder = std::vector<uint32_t>{};
+	m_Centroids = std::vector<Float3>{};
+}
+void BoundingVolumeHierarchy::BuildBinaryNode(uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth)
+{
+	struct Bin
+	{
+		Bounds bounds;
+		uint32_t count;
+	};
+
+	Bounds bounds{ g_EmptyBounds };
+	Bounds centroidBounds{ g_EmptyBounds };
+	for (uint32_t index{ first }; index < first + count; ++index)
+	{
+		const uint32_t primitive{ m_PrimitiveOrder[index] };
+		Grow(bounds, m_PrimitiveBounds[primitive]);
+		Grow(centroidBounds, Bounds{ m_Centroids[primitive], m_Centroids[primitive] });
+	}
+
+	m_BuildNodes[nodeIndex] = BuildNode{ bounds, first, count };
+	if (count == 1) return;
+
+	// Binned surface area heuristic on every axis, the cost of a split is relative to the area of this node
+	float bestCost{ g_Infinity };
+	uint32_t bestAxis{ 3 };
+	uint32_t bestBin{};
+
+	const auto getBin = [&](uint32_t primitive, uint32_t axis, float scale)
+	{
+		const float offset{ GetAxis(m_Centroids[primitive], axis) - GetAxis(centroidBounds.minimum, axis) };
+		return (std::min)(static_cast<uint32_t>(offset * scale), g_BinCount - 1);
+	};
+
+	for (uint32_t axis{}; axis < 3 && depth < g_MedianDepth; ++axis)
+	{
+		const float extent{ GetAxis(centroidBounds.maximum, axis) - GetAxis(centroidBounds.minimum, axis) };
+		if (extent <= 0.f) continue;
+
+		const float scale{ g_BinCount / extent };
+
+		Bin bins[g_BinCount];
+		for (Bin& bin : bins) bin = Bin{ g_EmptyBounds, 0 };
+		for (uint32_t index{ first }; index < first + count; ++index)
+		{
+			const uint32_t primitive{ m_PrimitiveOrder[index] };
+			Bin& bin = bins[getBin(primitive, axis, scale)];
+			Grow(bin.bounds, m_PrimitiveBounds[primitive]);
+			++bin.count;
+		}
+
+		// Right side of every split plane, swept from the back
+		float rightCosts[g_BinCount - 1]{};
+		uint32_t rightCounts[g_BinCount - 1]{};
+		Bounds rightBounds{ g_EmptyBounds };
+		uint32_t rightCount{};
+		for (uint32_t split{ g_BinCount - 1 }; split > 0; --split)
+		{
+			Grow(rightBounds, bins[split].bounds);
+			rightCount += bins[split].count;
+			rightCounts[split - 1] = rightCount;
+			rightCosts[split - 1] = rightCount > 0 ? GetSurfaceArea(rightBounds) * GetBlockCount(rightCount) : 0.f;
+		}
+
+		Bounds leftBounds{ g_EmptyBounds };
+		uint32_t leftCount{};
+		for (uint32_t split{}; split < g_BinCount - 1; ++split)
+		{
+			Grow(leftBounds, bins[split].bounds);
+			leftCount += bins[split].count;
+			if (leftCount == 0 || rightCounts[split] == 0) continue;
+
+			const float cost{ GetSurfaceArea(leftBounds) * GetBlockCount(leftCount) + rightCosts[split] };
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = split;
+			}
+		}
+	}
+
+	// Small enough for a leaf, and splitting doesn't pay off
+	const float area{ GetSurfaceArea(bounds) };
+	const float splitCost{ bestAxis < 3 && area > 0.f ? g_TraversalCost + g_IntersectionCost * bestCost / area : g_Infinity };
+	if (count <= g_MaxLeafSize && splitCost >= g_IntersectionCost) return;
+
+	uint32_t middle{};
+	if (bestAxis < 3)
+	{
+		const float scale{ g_BinCount / (GetAxis(centroidBounds.maximum, bestAxis) - GetAxis(centroidBounds.minimum, bestAxis)) };
+		const auto splitIt = std::partition(m_PrimitiveOrder.begin() + first, m_PrimitiveOrder.begin() + first + count,
+			[&](uint32_t primitive) { return getBin(primitive, bestAxis, scale) <= bestBin; });
+		middle = static_cast<uint32_t>(splitIt - m_PrimitiveOrder.begin());
+	}
+	else
+	{
+		// Too deep, or every centroid in one place: halve along the widest axis
+		const Float3 extent{ Float3Subtract(centroidBounds.maximum, centroidBounds.minimum) };
+		const uint32_t axis{ extent.x >= extent.y && extent.x >= extent.z ? 0u : extent.y >= extent.z ? 1u : 2u };
+
+		middle = first + count / 2;
+		std::nth_element(m_PrimitiveOrder.begin() + first, m_PrimitiveOrder.begin() + middle, m_PrimitiveOrder.begin() + first + count,
+			[&](uint32_t firstPrimitive, uint32_t secondPrimitive) { return GetAxis(m_Centroids[firstPrimitive], axis) < GetAxis(m_Centroids[secondPrimitive], axis); });
+	}
+
+	// Children next to each other, the first one is enough to find both
+	const uint32_t leftIndex{ static_cast<uint32_t>(m_BuildNodes.size()) };
+	m_BuildNodes.push_back(BuildNode{});
+	m_BuildNodes.push_back(BuildNode{});
+	m_BuildNodes[nodeIndex].first = leftIndex;
+	m_BuildNodes[nodeIndex].count = 0;
+
+	BuildBinaryNode(leftIndex, first, middle - first, depth + 1);
+	BuildBinaryNode(leftIndex + 1, middle, first + count - middle, depth + 1);
+}
+uint32_t BoundingVolumeHierarchy::CollapseNode(uint32_t buildIndex, uint32_t depth, float rootArea)
+{
+	// Pull grandchildren up until there are 4 children, always opening the biggest inner child
+	uint32_t children[4]{ m_BuildNodes[buildIndex].first, m_BuildNodes[buildIndex].first + 1 };
+	uint32_t childCount{ 2 };
+	while (childCount < 4)
+	{
+		uint32_t openIndex{ 4 };
+		float openArea{ -1.f };
+		for (uint32_t index{}; index < childCount; ++index)
+		{
+			const BuildNode& child = m_BuildNodes[children[index]];
+			const float area{ GetSurfaceArea(child.bounds) };
+			if (child.count == 0 && area > openArea)
+			{
+				openIndex = index;
+				openArea = area;
+			}
+		}
+		if (openIndex == 4) break;
+
+		const uint32_t opened{ children[openIndex] };
+		children[openIndex] = m_BuildNodes[opened].first;
+		children[childCount++] = m_BuildNodes[opened].first + 1;
+	}
+
+	const uint32_t nodeIndex{ static_cast<uint32_t>(m_Nodes.size()) };
+	m_Nodes.push_back(Node{});
+	for (uint32_t lane{}; lane < 4; ++lane)
+	{
+		SetLane(m_Nodes[nodeIndex].bounds, lane, g_EmptyBounds);
+		m_Nodes[nodeIndex].children[lane] = g_EmptyChild;
+	}
+
+	m_Statistics.maxDepth = (std::max)(m_Statistics.maxDepth, depth);
+	m_Statistics.sahCost += g_TraversalCost * GetSurfaceArea(m_BuildNodes[buildIndex].bounds) / rootArea;
+
+	for (uint32_t lane{}; lane < childCount; ++lane)
+	{
+		const BuildNode child{ m_BuildNodes[children[lane]] };
+		const uint32_t childIndex{ child.count > 0 ? g_LeafFlag | CreateLeaf(child) : CollapseNode(children[lane], depth + 1, rootArea) };
+
+		// Indexed again, the recursion grows the nodes
+		SetLane(m_Nodes[nodeIndex].bounds, lane, child.bounds);
+		m_Nodes[nodeIndex].children[lane] = childIndex;
+
+		if (child.count > 0) m_Statistics.sahCost += g_IntersectionCost * GetSurfaceArea(child.bounds) / rootArea;
+	}
+
+	return nodeIndex;
+}
+uint32_t BoundingVolumeHierarchy::CreateLeaf(const BuildNode& buildNode)
+{
+	Leaf leaf{};
+	leaf.count = buildNode.count;
+	for (uint32_t index{}; index < buildNode.count; ++index) leaf.primitives[index] = m_PrimitiveOrder[buildNode.first + index];
+
+	m_Leaves.push_back(leaf);
+	return static_cast<uint32_t>(m_Leaves.size() - 1);
+}
+void BoundingVolumeHierarchy::ReadPositions(const void* pPositions, uint32_t positionStride, std::vector<Float3>& positions) const
+{
+	positions.resize(m_VertexCount);
+	for (uint32_t vertexIndex{}; vertexIndex < m_VertexCount; ++vertexIndex)
+	{
+		std::memcpy(&positions[vertexIndex], static_cast<const char*>(pPositions) + static_cast<size_t>(vertexIndex) * positionStride, sizeof(Float3));
+	}
+}
+void BoundingVolumeHierarchy::WriteTriangleBlock(uint32_t leafIndex, const std::vector<Float3>& positions)
+{
+	// Unused lanes stay zero, a triangle without area is never hit
+	TriangleBlock& block = m_Triangles[leafIndex];
+	block = TriangleBlock{};
+
+	const Leaf& leaf = m_Leaves[leafIndex];
+	for (uint32_t lane{}; lane < leaf.count; ++lane)
+	{
+		const uint32_t* pCorners{ &m_TriangleIndices[static_cast<size_t>(leaf.primitives[lane]) * 3] };
+		const Float3& vertex0 = positions[pCorners[0]];
+		const Float3 vectors[3]{ vertex0, Float3Subtract(positions[pCorners[1]], vertex0), Float3Subtract(positions[pCorners[2]], vertex0) };
+
+		for (uint32_t vector{}; vector < 3; ++vector)
+		{
+			block.vectors[vector][0][lane] = vectors[vector].x;
+			block.vectors[vector][1][lane] = vectors[vector].y;
+			block.vectors[vector][2][lane] = vectors[vector].z;
+		}
+	}
+}
+void BoundingVolumeHierarchy::WriteBoxBlock(uint32_t leafIndex)
+{
+	const Leaf& leaf = m_Leaves[leafIndex];
+	for (uint32_t lane{}; lane < 4; ++lane)
+	{
+		SetLane(m_Boxes[leafIndex], lane, lane < leaf.count ? m_PrimitiveBounds[leaf.primitives[lane]] : g_EmptyBounds);
+	}
+}
+void BoundingVolumeHierarchy::RefitNodes()
+{
+	// Children come after their parents, so walking backwards sees every child first
+	for (size_t nodeIndex{ m_Nodes.size() }; nodeIndex-- > 0;)
+	{
+		Node& node = m_Nodes[nodeIndex];
+		for (uint32_t lane{}; lane < 4; ++lane)
+		{
+			const uint32_t child{ node.children[lane] };
+			if (child == g_EmptyChild) continue;
+
+			Bounds bounds{ g_EmptyBounds };
+			if (child & g_LeafFlag)
+			{
+				const Leaf& leaf = m_Leaves[child & ~g_LeafFlag];
+				for (uint32_t index{}; index < leaf.count; ++index) Grow(bounds, m_PrimitiveBounds[leaf.primitives[index]]);
+			}
+			else
+			{
+				bounds = GetBlockBounds(m_Nodes[child].bounds);
+			}
+
+			SetLane(node.bounds, lane, bounds);
+		}
+	}
+
+	m_RootBounds = GetBlockBounds(m_Nodes.front().bounds);
+}
+
+template<typename LeafVisitor>
+void BoundingVolumeHierarchy::Traverse(const RayData& rayData, float& maxDistance, bool nearestFirst, LeafVisitor&& visitLeaf) const
+{
+	struct StackEntry
+	{
+		uint32_t child;
+		float distance;				// Where the ray enters it, entries behind the closest hit are skipped
+	};
+
+	StackEntry stack[g_StackSize];
+	uint32_t stackSize{ 1 };
+	stack[0] = StackEntry{ 0, 0.f };
+
+	while (stackSize > 0)
+	{
+		const StackEntry entry{ stack[--stackSize] };
+		if (entry.distance > maxDistance) continue;
+
+		if (entry.child & g_LeafFlag)
+		{
+			if (visitLeaf(entry.child & ~g_LeafFlag)) return;
+			continue;
+		}
+
+		const Node& node = m_Nodes[entry.child];
+		alignas(16) float distances[4];
+		uint32_t hitMask{ IntersectBlock(node.bounds, rayData, maxDistance, distances) };
+
+		uint32_t lanes[4];
+		uint32_t laneCount{};
+		while (hitMask)
+		{
+			unsigned long lane{};
+			_BitScanForward(&lane, hitMask);
+			hitMask &= hitMask - 1;
+			lanes[laneCount++] = lane;
+		}
+
+		// Farthest pushed first, so the nearest child is popped next and the closest hit is found early
+		if (nearestFirst)
+		{
+			for (uint32_t index{ 1 }; index < laneCount; ++index)
+			{
+				const uint32_t lane{ lanes[index] };
+				uint32_t position{ index };
+				for (; position > 0 && distances[lanes[position - 1]] < distances[lane]; --position) lanes[position] = lanes[position - 1];
+				lanes[position] = lane;
+			}
+		}
+
+		for (uint32_t index{}; index < laneCount; ++index)
+		{
+			stack[stackSize++] = StackEntry{ node.children[lanes[index]], distances[lanes[index]] };
+		}
+	}
+}
+uint32_t BoundingVolumeHierarchy::IntersectLeaf(uint32_t leafIndex, const RayData& rayData, float maxDistance, float* pDistances) const
+{
+	if (m_PrimitiveType == PrimitiveType::Bounds) return IntersectBlock(m_Boxes[leafIndex], rayData, maxDistance, pDistances);
+
+	// Moller-Trumbore on 4 triangles at once, both sides are hit
+	const TriangleBlock& block = m_Triangles[leafIndex];
+	const Vector* direction{ rayData.direction };
+
+	Vector edge1[3];
+	Vector edge2[3];
+	Vector offset[3];
+	for (uint32_t axis{}; axis < 3; ++axis)
+	{
+		offset[axis] = VectorSubtract(rayData.origin[axis], VectorLoad(block.vectors[0][axis]));
+		edge1[axis] = VectorLoad(block.vectors[1][axis]);
+		edge2[axis] = VectorLoad(block.vectors[2][axis]);
+	}
+
+	const auto cross = [](const Vector* a, const Vector* b, Vector* pResult)
+	{
+		pResult[0] = VectorSubtract(VectorMultiply(a[1], b[2]), VectorMultiply(a[2], b[1]));
+		pResult[1] = VectorSubtract(VectorMultiply(a[2], b[0]), VectorMultiply(a[0], b[2]));
+		pResult[2] = VectorSubtract(VectorMultiply(a[0], b[1]), VectorMultiply(a[1], b[0]));
+	};
+	const auto dot = [](const Vector* a, const Vector* b)
+	{
+		return VectorMultiplyAdd(a[2], b[2], VectorMultiplyAdd(a[1], b[1], VectorMultiply(a[0], b[0])));
+	};
+
+	Vector p[3];
+	cross(direction, edge2, p);
+	const Vector determinant{ dot(edge1, p) };
+	const Vector inverseDeterminant{ VectorDivide(VectorReplicate(1.f), determinant) };
+
+	Vector q[3];
+	cross(offset, edge1, q);
+
+	const Vector u{ VectorMultiply(dot(offset, p), inverseDeterminant) };
+	const Vector v{ VectorMultiply(dot(direction, q), inverseDeterminant) };
+	const Vector distance{ VectorMultiply(dot(edge2, q), inverseDeterminant) };
+
+	const Vector zero{ VectorZero() };
+	Vector isHit{ VectorGreater(VectorAbs(determinant), VectorReplicate(g_MinDeterminant)) };
+	isHit = VectorAndInt(isHit, VectorGreaterOrEqual(u, zero));
+	isHit = VectorAndInt(isHit, VectorGreaterOrEqual(v, zero));
+	isHit = VectorAndInt(isHit, VectorLessOrEqual(VectorAdd(u, v), VectorReplicate(1.f)));
+	isHit = VectorAndInt(isHit, VectorGreaterOrEqual(distance, zero));
+	isHit = VectorAndInt(isHit, VectorLessOrEqual(distance, VectorReplicate(maxDistance)));
+
+	VectorStore(pDistances, distance);
+	return VectorMoveMask(isHit);
+}
+
+uint32_t BoundingVolumeHierarchy::IntersectBlock(const BoxBlock& block, const RayData& rayData, float maxDistance, float* pDistances)
+{
+	// Slabs on every axis, the near plane is picked per ray so inverted empty lanes come out as misses
+	Vector entry{ VectorZero() };
+	Vector exit{ VectorReplicate(maxDistance) };
+	for (uint32_t axis{}; axis < 3; ++axis)
+	{
+		const uint32_t nearPlane{ rayData.nearPlane[axis] };
+		const Vector nearDistance{ VectorMultiply(VectorSubtract(VectorLoad(block.planes[nearPlane][axis]), rayData.origin[axis]), rayData.inverseDirection[axis]) };
+		const Vector farDistance{ VectorMultiply(VectorSubtract(VectorLoad(block.planes[1 - nearPlane][axis]), rayData.origin[axis]), rayData.inverseDirection[axis]) };
+		entry = VectorMax(entry, nearDistance);
+		exit = VectorMin(exit, farDistance);
+	}
+
+	VectorStore(pDistances, entry);
+	return VectorMoveMask(VectorLessOrEqual(entry, exit));
+}
+void BoundingVolumeHierarchy::SetLane(BoxBlock& block, uint32_t lane, const Bounds& bounds)
+{
+	block.planes[0][0][lane] = bounds.minimum.x;
+	block.planes[0][1][lane] = bounds.minimum.y;
+	block.planes[0][2][lane] = bounds.minimum.z;
+	block.planes[1][0][lane] = bounds.maximum.x;
+	block.planes[1][1][lane] = bounds.maximum.y;
+	block.planes[1][2][lane] = bounds.maximum.z;
+}
+BoundingVolumeHierarchy::Bounds BoundingVolumeHierarchy::GetBlockBounds(const BoxBlock& block)
+{
+	// Empty lanes are inverted, so they drop out of the min and max
+	Bounds bounds{};
+	const Vector minimums[3]{ VectorLoad(block.planes[0][0]), VectorLoad(block.planes[0][1]), VectorLoad(block.planes[0][2]) };
+	const Vector maximums[3]{ VectorLoad(block.planes[1][0]), VectorLoad(block.planes[1][1]), VectorLoad(block.planes[1][2]) };
+
+	float* pMinimum[3]{ &bounds.minimum.x, &bounds.minimum.y, &bounds.minimum.z };
+	float* pMaximum[3]{ &bounds.maximum.x, &bounds.maximum.y, &bounds.maximum.z };
+	for (uint32_t axis{}; axis < 3; ++axis)
+	{
+		alignas(16) float lanes[4];
+		VectorStore(lanes, minimums[axis]);
+		*pMinimum[axis] = (std::min)((std::min)(lanes[0], lanes[1]), (std::min)(lanes[2], lanes[3]));
+		VectorStore(lanes, maximums[axis]);
+		*pMaximum[axis] = (std::max)((std::max)(lanes[0], lanes[1]), (std::max)(lanes[2], lanes[3]));
+	}
+
+	return bounds;
+}
+float BoundingVolumeHierarchy::GetSurfaceArea(const Bounds& bounds)
+{
+	// Half the area, only ratios are used; empty bounds have none
+	const Float3 extent{ Float3Subtract(bounds.maximum, bounds.minimum) };
+	if (extent.x < 0.f || extent.y < 0.f || extent.z < 0.f) return 0.f;
+	return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+void BoundingVolumeHierarchy::Grow(Bounds& bounds, const Bounds& other)
+{
+	bounds.minimum = Float3{ (std::min)(bounds.minimum.x, other.minimum.x), (std::min)(bounds.minimum.y, other.minimum.y), (std::min)(bounds.minimum.z, other.minimum.z) };
+	bounds.maximum = Float3{ (std::max)(bounds.maximum.x, other.maximum.x), (std::max)(bounds.maximum.y, other.maximum.y), (std::max)(bounds.maximum.z, other.maximum.z) };
+}
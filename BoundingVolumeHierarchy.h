@@ -0,0 +1,159 @@
+#pragma once
+
+#include "EngineMath.h"
+
+#include <cstdint>
+#include <vector>
+
+// Spatial index over the triangles of a mesh or the bounds of scene objects, for picking, line-of-sight and proximity queries
+// Built top-down with a binned surface area heuristic, then collapsed into nodes of 4 children stored as SoA boxes,
+// so one ray is tested against all 4 children at once and a node fits in two cache lines
+// Leaves hold up to 4 primitives, triangles are stored SoA in the leaf and also intersected 4 at a time
+// Refit keeps the tree and only recomputes the boxes, for primitives that moved but didn't change order much
+class BoundingVolumeHierarchy final
+{
+public:
+	// Structs
+	struct Bounds
+	{
+		math::Float3 minimum;
+		math::Float3 maximum;
+	};
+
+	struct Ray
+	{
+		math::Float3 origin;
+		math::Float3 direction;			// Doesn't have to be normalized, distances are in multiples of it
+		float maxDistance;
+	};
+
+	struct Hit
+	{
+		uint32_t primitive;				// g_NoHit when nothing was hit
+		float distance;
+	};
+
+	struct Statistics
+	{
+		double buildMs;
+		double refitMs;					// Of the last refit
+		uint32_t primitiveCount;
+		uint32_t nodeCount;
+		uint32_t leafCount;
+		uint32_t maxDepth;
+		float sahCost;					// Expected cost of a random ray, in box tests, lower is better
+	};
+
+	static constexpr uint32_t g_NoHit{ 0xFFFFFFFF };
+
+	// Rule of five
+	BoundingVolumeHierarchy() = default;
+	~BoundingVolumeHierarchy() = default;
+
+	BoundingVolumeHierarchy(const BoundingVolumeHierarchy& other) = delete;
+	BoundingVolumeHierarchy(BoundingVolumeHierarchy&& other) = delete;
+	BoundingVolumeHierarchy& operator= (const BoundingVolumeHierarchy& other) = delete;
+	BoundingVolumeHierarchy& operator= (BoundingVolumeHierarchy&& other) = delete;
+
+	// Publics
+	// Positions are read with the given stride, so the vertex buffer data can be passed as is, primitives are the triangles
+	void Build(const void* pPositions, uint32_t positionStride, uint32_t vertexCount, const uint32_t* pIndices, uint32_t indexCount);
+	void Build(const std::vector<Bounds>& bounds);		// Primitives are the boxes, rays hit them where they enter
+
+	// Same primitives as the build, in the same order
+	void Refit(const void* pPositions, uint32_t positionStride);
+	void Refit(const std::vector<Bounds>& bounds);
+
+	Hit Intersect(const Ray& ray) const;								// Closest hit
+	bool IntersectAny(const Ray& ray) const;							// Any hit, for line-of-sight
+	void IntersectAll(const Ray& ray, std::vector<Hit>& hits) const;	// Every hit, closest first
+	void IntersectBatch(const std::vector<Ray>& rays, std::vector<Hit>& hits) const;	// Closest hits, split over the workers
+	void QueryOverlaps(const Bounds& bounds, std::vector<uint32_t>& primitives) const;	// Primitives whose bounds overlap, for proximity
+
+	bool IsEmpty() const { return m_Nodes.empty(); }
+	const Bounds& GetBounds() const { return m_RootBounds; }
+	const Statistics& GetStatistics() const { return m_Statistics; }
+
+private:
+	// Structs
+	struct alignas(16) BoxBlock			// 4 boxes, [minimum or maximum][axis][lane], empty lanes are inverted so they are never hit
+	{
+		float planes[2][3][4];
+	};
+
+	struct alignas(64) Node
+	{
+		BoxBlock bounds;
+		uint32_t children[4];			// Node index, or g_LeafFlag with a leaf index, g_EmptyChild for unused lanes
+	};
+
+	struct Leaf
+	{
+		uint32_t primitives[4];
+		uint32_t count;
+	};
+
+	struct alignas(16) TriangleBlock	// 4 triangles, [vertex 0, edge 1, edge 2][axis][lane]
+	{
+		float vectors[3][3][4];
+	};
+
+	struct BuildNode					// Binary, collapsed into Nodes once the build is done
+	{
+		Bounds bounds;
+		uint32_t first;					// Into m_PrimitiveOrder for leaves, the children otherwise
+		uint32_t count;					// 0 for inner nodes
+	};
+
+	struct RayData;
+
+	enum class PrimitiveType : uint8_t
+	{
+		Triangles,
+		Bounds
+	};
+
+	static constexpr uint32_t g_LeafFlag{ 0x80000000 };
+	static constexpr uint32_t g_EmptyChild{ 0xFFFFFFFF };
+
+	// Member variables
+	PrimitiveType m_PrimitiveType{};
+
+	std::vector<Node> m_Nodes;				// Parents before their children, the root first
+	std::vector<Leaf> m_Leaves;
+	std::vector<TriangleBlock> m_Triangles;	// Per leaf, triangle hierarchies only
+	std::vector<BoxBlock> m_Boxes;			// Per leaf, bounds hierarchies only
+
+	std::vector<Bounds> m_PrimitiveBounds;
+	std::vector<uint32_t> m_TriangleIndices;
+	uint32_t m_VertexCount{};
+	Bounds m_RootBounds{};
+
+	// Build scratch
+	std::vector<BuildNode> m_BuildNodes;
+	std::vector<uint32_t> m_PrimitiveOrder;
+	std::vector<math::Float3> m_Centroids;
+
+	Statistics m_Statistics{};
+
+	// Member functions
+	void BuildHierarchy();
+	void BuildBinaryNode(uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth);
+	uint32_t CollapseNode(uint32_t buildIndex, uint32_t depth, float rootArea);
+	uint32_t CreateLeaf(const BuildNode& buildNode);
+	void ReadPositions(const void* pPositions, uint32_t positionStride, std::vector<math::Float3>& positions) const;
+	void WriteTriangleBlock(uint32_t leafIndex, const std::vector<math::Float3>& positions);
+	void WriteBoxBlock(uint32_t leafIndex);
+	void RefitNodes();
+
+	template<typename LeafVisitor>
+	void Traverse(const RayData& rayData, float& maxDistance, bool nearestFirst, LeafVisitor&& visitLeaf) const;
+	uint32_t IntersectLeaf(uint32_t leafIndex, const RayData& rayData, float maxDistance, float* pDistances) const;	// Mask of the primitives hit
+
+	static uint32_t IntersectBlock(const BoxBlock& block, const RayData& rayData, float maxDistance, float* pDistances);	// Mask of the boxes hit
+
+	static void SetLane(BoxBlock& block, uint32_t lane, const Bounds& bounds);
+	static Bounds GetBlockBounds(const BoxBlock& block);
+	static float GetSurfaceArea(const Bounds& bounds);
+	static void Grow(Bounds& bounds, const Bounds& other);
+};
@@ -0,0 +1,138 @@
+#include "CommandBuffer.h"
+
+#include <algorithm>
+
+void CommandBuffer::SetViewport(const Viewport& viewport)
+{
+	Add(CommandType::SetViewport).viewport = viewport;
+}
+void CommandBuffer::SetPipelineState(PipelineStateHandle pipelineState)
+{
+	Add(CommandType::SetPipelineState).arguments[0] = pipelineState.id;
+}
+void CommandBuffer::SetInputLayout(InputLayoutHandle inputLayout)
+{
+	Add(CommandType::SetInputLayout).arguments[0] = inputLayout.id;
+}
+void CommandBuffer::SetVertexShader(VertexShaderHandle vertexShader)
+{
+	Add(CommandType::SetVertexShader).arguments[0] = vertexShader.id;
+}
+void CommandBuffer::SetPixelShader(PixelShaderHandle pixelShader)
+{
+	Add(CommandType::SetPixelShader).arguments[0] = pixelShader.id;
+}
+void CommandBuffer::SetVertexBuffers(uint32_t startSlot, uint32_t bufferCount, const BufferHandle* pBuffers, const uint32_t* pStrides)
+{
+	Command& command = Add(CommandType::SetVertexBuffers);
+	command.arguments[0] = startSlot;
+	command.arguments[1] = bufferCount;
+	command.arguments[2] = static_cast<uint32_t>(m_Payload.size());
+
+	// Buffers first, then the strides
+	for (uint32_t index{}; index < bufferCount; ++index) m_Payload.push_back(pBuffers[index].id);
+	m_Payload.insert(m_Payload.end(), pStrides, pStrides + bufferCount);
+}
+void CommandBuffer::SetIndexBuffer(BufferHandle buffer, ElementFormat format)
+{
+	Command& command = Add(CommandType::SetIndexBuffer);
+	command.format = format;
+	command.arguments[0] = buffer.id;
+}
+void CommandBuffer::SetConstantBuffer(ShaderStage stage, uint32_t slot, BufferHandle buffer, uint32_t firstConstant, uint32_t constantCount)
+{
+	Command& command = Add(CommandType::SetConstantBuffer);
+	command.stage = stage;
+	command.arguments[0] = slot;
+	command.arguments[1] = buffer.id;
+	command.arguments[2] = firstConstant;
+	command.arguments[3] = constantCount;
+}
+void CommandBuffer::SetShaderViews(ShaderStage stage, uint32_t startSlot, uint32_t viewCount, const ShaderViewHandle* pViews)
+{
+	Command& command = Add(CommandType::SetShaderViews);
+	command.stage = stage;
+	command.arguments[0] = startSlot;
+	command.arguments[1] = viewCount;
+	command.arguments[2] = static_cast<uint32_t>(m_Payload.size());
+
+	for (uint32_t index{}; index < viewCount; ++index) m_Payload.push_back(pViews[index].id);
+}
+
+void CommandBuffer::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+	Command& command = Add(CommandType::DrawIndexed);
+	command.arguments[0] = indexCount;
+	command.arguments[1] = startIndex;
+	command.arguments[2] = static_cast<uint32_t>(baseVertex);
+}
+void CommandBuffer::DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount)
+{
+	Command& command = Add(CommandType::DrawIndexedInstanced);
+	command.arguments[0] = indexCountPerInstance;
+	command.arguments[1] = instanceCount;
+}
+
+void CommandBuffer::Replay(CommandRecorder& target) const
+{
+	// Handles are stored as plain ids, and rebuilt in small arrays for the array binds
+	constexpr uint32_t maxArrayCount{ 16 };
+	BufferHandle buffers[maxArrayCount]{};
+	ShaderViewHandle views[maxArrayCount]{};
+
+	for (const Command& command : m_Commands)
+	{
+		const uint32_t* pArguments{ command.arguments };
+
+		switch (command.type)
+		{
+		case CommandType::SetViewport:			target.SetViewport(command.viewport);											break;
+		case CommandType::SetPipelineState:		target.SetPipelineState(PipelineStateHandle{ pArguments[0] });				break;
+		case CommandType::SetInputLayout:		target.SetInputLayout(InputLayoutHandle{ pArguments[0] });					break;
+		case CommandType::SetVertexShader:		target.SetVertexShader(VertexShaderHandle{ pArguments[0] });					break;
+		case CommandType::SetPixelShader:		target.SetPixelShader(PixelShaderHandle{ pArguments[0] });					break;
+		case CommandType::SetIndexBuffer:		target.SetIndexBuffer(BufferHandle{ pArguments[0] }, command.format);			break;
+		case CommandType::DrawIndexed:			target.DrawIndexed(pArguments[0], pArguments[1], static_cast<int32_t>(pArguments[2]));	break;
+		case CommandType::DrawIndexedInstanced:	target.DrawIndexedInstanced(pArguments[0], pArguments[1]);					break;
+
+		case CommandType::SetConstantBuffer:
+			target.SetConstantBuffer(command.stage, pArguments[0], BufferHandle{ pArguments[1] }, pArguments[2], pArguments[3]);
+			break;
+
+		case CommandType::SetVertexBuffers:
+		{
+			const uint32_t bufferCount{ (std::min)(pArguments[1], maxArrayCount) };
+			const uint32_t* pIds{ m_Payload.data() + pArguments[2] };
+			for (uint32_t index{}; index < bufferCount; ++index) buffers[index] = BufferHandle{ pIds[index] };
+
+			target.SetVertexBuffers(pArguments[0], bufferCount, buffers, pIds + pArguments[1]);
+		}
+		break;
+
+		case CommandType::SetShaderViews:
+		{
+			const uint32_t viewCount{ (std::min)(pArguments[1], maxArrayCount) };
+			const uint32_t* pIds{ m_Payload.data() + pArguments[2] };
+			for (uint32_t index{}; index < viewCount; ++index) views[index] = ShaderViewHandle{ pIds[index] };
+
+			target.SetShaderViews(command.stage, pArguments[0], viewCount, views);
+		}
+		break;
+		}
+	}
+}
+void CommandBuffer::Clear()
+{
+	// Keeps the capacity for the next frame
+	m_Commands.clear();
+	m_Payload.clear();
+}
+
+// Privates
+// --------
+CommandBuffer::Command& CommandBuffer::Add(CommandType type)
+{
+	Command& command = m_Commands.emplace_back();
+	command.type = type;
+	return command;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "RenderDevice.h"
+
+#include <vector>
+
+// Plain recorded list of binds and draws, replayed later onto another recorder
+// Used by backends without native command lists, the arrays are kept between frames so recording doesn't allocate
+class CommandBuffer final : public CommandRecorder
+{
+public:
+	// Rule of five
+	CommandBuffer() = default;
+	~CommandBuffer() override = default;
+
+	CommandBuffer(const CommandBuffer& other) = delete;
+	CommandBuffer(CommandBuffer&& other) = delete;
+	CommandBuffer& operator= (const CommandBuffer& other) = delete;
+	CommandBuffer& operator= (CommandBuffer&& other) = delete;
+
+	// Publics
+	void SetViewport(const Viewport& viewport) override;
+	void SetPipelineState(PipelineStateHandle pipelineState) override;
+	void SetInputLayout(InputLayoutHandle inputLayout) override;
+	void SetVertexShader(VertexShaderHandle vertexShader) override;
+	void SetPixelShader(PixelShaderHandle pixelShader) override;
+	void SetVertexBuffers(uint32_t startSlot, uint32_t bufferCount, const BufferHandle* pBuffers, const uint32_t* pStrides) override;
+	void SetIndexBuffer(BufferHandle buffer, ElementFormat format) override;
+	void SetConstantBuffer(ShaderStage stage, uint32_t slot, BufferHandle buffer, uint32_t firstConstant = 0, uint32_t constantCount = 0) override;
+	void SetShaderViews(ShaderStage stage, uint32_t startSlot, uint32_t viewCount, const ShaderViewHandle* pViews) override;
+
+	void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+	void DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount) override;
+
+	void Replay(CommandRecorder& target) const;
+	void Clear();
+
+	size_t GetCommandCount() const { return m_Commands.size(); }
+
+private:
+	// Structs
+	enum class CommandType : uint8_t
+	{
+		SetViewport,
+		SetPipelineState,
+		SetInputLayout,
+		SetVertexShader,
+		SetPixelShader,
+		SetVertexBuffers,
+		SetIndexBuffer,
+		SetConstantBuffer,
+		SetShaderViews,
+		DrawIndexed,
+		DrawIndexedInstanced
+	};
+
+	struct Command
+	{
+		CommandType type;
+		ShaderStage stage;
+		ElementFormat format;
+		union
+		{
+			Viewport viewport;
+			uint32_t arguments[4];
+		};
+	};
+	static_assert(std::is_trivially_copyable_v<Command>, "Commands only hold handles and values, recording copies them as plain words");
+
+	// Member variables
+	std::vector<Command> m_Commands;
+	std::vector<uint32_t> m_Payload;	// Handle and stride arrays, referenced by offset
+
+	// Member functions
+	Command& Add(CommandType type);
+};
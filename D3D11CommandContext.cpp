@@ -0,0 +1,170 @@
+#include "D3D11CommandContext.h"
+#include "D3D11RenderDevice.h"
+
+#include <algorithm>
+
+D3D11CommandContext::D3D11CommandContext(const D3D11RenderDevice& device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> pContext)
+	: m_Device{ device }
+	, m_pContext{ std::move(pContext) }
+	, m_pContext1{}
+	, m_pCommandList{}
+	, m_Statistics{}
+{
+	if (device.GetFeatures().constantBufferOffsets) m_pContext.As(&m_pContext1);
+}
+
+void D3D11CommandContext::SetViewport(const Viewport& viewport)
+{
+	const D3D11_VIEWPORT d3dViewport{ viewport.x, viewport.y, viewport.width, viewport.height, 0.f, 1.f };
+	m_pContext->RSSetViewports(1, &d3dViewport);
+	++m_Statistics.bindCount;
+}
+void D3D11CommandContext::SetPipelineState(PipelineStateHandle pipelineState)
+{
+	const D3D11RenderDevice::PipelineStateEntry* pEntry{ m_Device.m_PipelineStates.Get(pipelineState.id) };
+	if (!pEntry) return;
+
+	const float blendFactor[] = { 1.f, 1.f, 1.f, 1.f };
+	m_pContext->RSSetState(pEntry->pRasterizerState);
+	m_pContext->OMSetDepthStencilState(pEntry->pDepthStencilState, 0);
+	m_pContext->OMSetBlendState(pEntry->pBlendState, blendFactor, 0xffffffff);
+	++m_Statistics.bindCount;
+}
+void D3D11CommandContext::SetInputLayout(InputLayoutHandle inputLayout)
+{
+	ID3D11InputLayout* const* ppInputLayout{ m_Device.m_InputLayouts.Get(inputLayout.id) };
+	m_pContext->IASetInputLayout(ppInputLayout ? *ppInputLayout : nullptr);
+	++m_Statistics.bindCount;
+}
+void D3D11CommandContext::SetVertexShader(VertexShaderHandle vertexShader)
+{
+	ID3D11VertexShader* const* ppVertexShader{ m_Device.m_VertexShaders.Get(vertexShader.id) };
+	m_pContext->VSSetShader(ppVertexShader ? *ppVertexShader : nullptr, nullptr, 0);
+	++m_Statistics.bindCount;
+}
+void D3D11CommandContext::SetPixelShader(PixelShaderHandle pixelShader)
+{
+	ID3D11PixelShader* const* ppPixelShader{ m_Device.m_PixelShaders.Get(pixelShader.id) };
+	m_pContext->PSSetShader(ppPixelShader ? *ppPixelShader : nullptr, nullptr, 0);
+	++m_Statistics.bindCount;
+}
+void D3D11CommandContext::SetVertexBuffers(uint32_t startSlot, uint32_t bufferCount, const BufferHandle* pBuffers, const uint32_t* pStrides)
+{
+	constexpr uint32_t maxVertexSlots{ 8 };
+	ID3D11Buffer* vertexBuffers[maxVertexSlots]{};
+	UINT strides[maxVertexSlots]{};
+	UINT offsets[maxVertexSlots]{};
+
+	bufferCount = (std::min)(bufferCount, maxVertexSlots);
+	for (uint32_t index{}; index < bufferCount; ++index)
+	{
+		vertexBuffers[index] = m_Device.GetBuffer(pBuffers[index]);
+		strides[index] = pStrides[index];
+	}
+
+	m_pContext->IASetVertexBuffers(startSlot, bufferCount, vertexBuffers, strides, offsets);
+	++m_Statistics.bindCount;
+}
+void D3D11CommandContext::SetIndexBuffer(BufferHandle buffer, ElementFormat format)
+{
+	m_pContext->IASetIndexBuffer(m_Device.GetBuffer(buffer), D3D11RenderDevice::ToDxgiFormat(format), 0);
+	++m_Statistics.bindCount;
+}
+void D3D11CommandContext::SetConstantBuffer(ShaderStage stage, uint32_t slot, BufferHandle buffer, uint32_t firstConstant, uint32_t constantCount)
+{
+	ID3D11Buffer* const pBuffer{ m_Device.GetBuffer(buffer) };
+
+	// Windowed, only move the offset into the batched buffer
+	if (constantCount > 0 && m_pContext1)
+	{
+		if (stage == ShaderStage::Vertex) m_pContext1->VSSetConstantBuffers1(slot, 1, &pBuffer, &firstConstant, &constantCount);
+		else m_pContext1->PSSetConstantBuffers1(slot, 1, &pBuffer, &firstConstant, &constantCount);
+	}
+	else
+	{
+		if (stage == ShaderStage::Vertex) m_pContext->VSSetConstantBuffers(slot, 1, &pBuffer);
+		else m_pContext->PSSetConstantBuffers(slot, 1, &pBuffer);
+	}
+
+	++m_Statistics.bindCount;
+}
+void D3D11CommandContext::SetShaderViews(ShaderStage stage, uint32_t startSlot, uint32_t viewCount, const ShaderViewHandle* pViews)
+{
+	ID3D11ShaderResourceView* shaderResourceViews[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT]{};
+
+	viewCount = (std::min)(viewCount, static_cast<uint32_t>(D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT));
+	for (uint32_t index{}; index < viewCount; ++index)
+	{
+		const Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>* ppView{ m_Device.m_ShaderViews.Get(pViews[index].id) };
+		shaderResourceViews[index] = ppView ? ppView->Get() : nullptr;
+	}
+
+	if (stage == ShaderStage::Vertex) m_pContext->VSSetShaderResources(startSlot, viewCount, shaderResourceViews);
+	else m_pContext->PSSetShaderResources(startSlot, viewCount, shaderResourceViews);
+
+	++m_Statistics.bindCount;
+}
+
+void D3D11CommandContext::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+	m_pContext->DrawIndexed
+	(
+		indexCount,		// IndexCount
+		startIndex,		// Start index
+		baseVertex		// Base vertexLocation
+	);
+
+	++m_Statistics.drawCount;
+	m_Statistics.triangleCount += indexCount / 3;
+}
+void D3D11CommandContext::DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount)
+{
+	m_pContext->DrawIndexedInstanced
+	(
+		indexCountPerInstance,	// Index count per instance
+		instanceCount,			// Instance count
+		0,						// Start index
+		0,						// Base vertexLocation
+		0						// Start instance
+	);
+
+	++m_Statistics.drawCount;
+	m_Statistics.triangleCount += static_cast<uint64_t>(indexCountPerInstance / 3) * instanceCount;
+}
+
+void D3D11CommandContext::BindBackBuffer(ID3D11RenderTargetView* pRenderTargetView, ID3D11DepthStencilView* pDepthStencilView)
+{
+	m_pContext->OMSetRenderTargets(1, &pRenderTargetView, pDepthStencilView);
+	m_pContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	// Depth shader views are always read through the comparison sampler
+	m_pContext->PSSetSamplers(0, 1, m_Device.m_pShadowSampler.GetAddressOf());
+}
+void D3D11CommandContext::BindDepthTarget(ID3D11DepthStencilView* pDepthStencilView)
+{
+	m_pContext->OMSetRenderTargets(0, nullptr, pDepthStencilView);
+	m_pContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+void D3D11CommandContext::Begin(ID3D11RenderTargetView* pRenderTargetView, ID3D11DepthStencilView* pDepthStencilView)
+{
+	// A deferred context starts from default state, the targets have to be recorded as well
+	m_pCommandList.Reset();
+	ResetStatistics();
+	BindBackBuffer(pRenderTargetView, pDepthStencilView);
+}
+void D3D11CommandContext::Finish()
+{
+	// Don't restore the deferred state, the next recording starts clean anyway
+	if (FAILED(m_pContext->FinishCommandList(FALSE, m_pCommandList.ReleaseAndGetAddressOf())))
+	{
+		m_pCommandList.Reset();
+	}
+}
+void D3D11CommandContext::Execute(ID3D11DeviceContext* pImmediateContext)
+{
+	if (!m_pCommandList) return;
+
+	// The immediate state is cleared afterwards, cheaper than saving and restoring it
+	pImmediateContext->ExecuteCommandList(m_pCommandList.Get(), FALSE);
+	m_pCommandList.Reset();
+}
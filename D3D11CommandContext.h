@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Windows.h>
+#include <d3d11.h>
+#include <d3d11_1.h>
+#include <wrl.h>
+
+#include "RenderDevice.h"
+
+class D3D11RenderDevice;
+
+// Binds and draws on one D3D11 context, the immediate one or a deferred one filled by a worker
+// Deferred contexts finish into a command list, executed later on the immediate context
+class D3D11CommandContext final : public CommandRecorder
+{
+public:
+	// Rule of five
+	D3D11CommandContext(const D3D11RenderDevice& device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> pContext);
+	~D3D11CommandContext() override = default;
+
+	D3D11CommandContext(const D3D11CommandContext& other) = delete;
+	D3D11CommandContext(D3D11CommandContext&& other) = delete;
+	D3D11CommandContext& operator= (const D3D11CommandContext& other) = delete;
+	D3D11CommandContext& operator= (D3D11CommandContext&& other) = delete;
+
+	// Publics
+	void SetViewport(const Viewport& viewport) override;
+	void SetPipelineState(PipelineStateHandle pipelineState) override;
+	void SetInputLayout(InputLayoutHandle inputLayout) override;
+	void SetVertexShader(VertexShaderHandle vertexShader) override;
+	void SetPixelShader(PixelShaderHandle pixelShader) override;
+	void SetVertexBuffers(uint32_t startSlot, uint32_t bufferCount, const BufferHandle* pBuffers, const uint32_t* pStrides) override;
+	void SetIndexBuffer(BufferHandle buffer, ElementFormat format) override;
+	void SetConstantBuffer(ShaderStage stage, uint32_t slot, BufferHandle buffer, uint32_t firstConstant = 0, uint32_t constantCount = 0) override;
+	void SetShaderViews(ShaderStage stage, uint32_t startSlot, uint32_t viewCount, const ShaderViewHandle* pViews) override;
+
+	void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+	void DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount) override;
+
+	void BindBackBuffer(ID3D11RenderTargetView* pRenderTargetView, ID3D11DepthStencilView* pDepthStencilView);
+	void BindDepthTarget(ID3D11DepthStencilView* pDepthStencilView);	// Depth only, no renderTarget
+	void Begin(ID3D11RenderTargetView* pRenderTargetView, ID3D11DepthStencilView* pDepthStencilView);	// Deferred only, drops the unexecuted list
+	void Finish();
+	void Execute(ID3D11DeviceContext* pImmediateContext);
+	void Discard() { m_pCommandList.Reset(); }	// Drops an unexecuted list and the targets it references
+
+	bool HasCommandList() const { return m_pCommandList != nullptr; }
+	ID3D11DeviceContext* GetContext() const { return m_pContext.Get(); }
+
+	const RenderDevice::Statistics& GetStatistics() const { return m_Statistics; }
+	void ResetStatistics() { m_Statistics = RenderDevice::Statistics{}; }
+
+private:
+	// Member variables
+	const D3D11RenderDevice& m_Device;
+
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_pContext;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> m_pContext1;	// Only set when constant buffer offsetting is supported
+	Microsoft::WRL::ComPtr<ID3D11CommandList> m_pCommandList;
+
+	RenderDevice::Statistics m_Statistics;						// Binds and draws only
+};
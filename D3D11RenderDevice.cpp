@@ -0,0 +1,932 @@
+#include "D3D11RenderDevice.h"
+#include "Logger.h"
+#include "Utils.h"
+#include "PipelineStateCache.h"
+#include "FrameCapture.h"
+
+#include <d3dcompiler.h>
+#include <dxgi1_3.h>
+#include <algorithm>
+#include <sstream>
+#include <thread>
+
+D3D11RenderDevice::D3D11RenderDevice(HWND windowHandle)
+	: m_WindowHandle{ windowHandle }
+	, m_pDevice{ nullptr }
+	, m_pDeviceContext{ nullptr }
+	, m_pDeviceContext1{}
+	, m_pSwapChain{}
+	, m_pRenderTargetView{}
+	, m_pDepthStencil{}
+	, m_pDepthStencilView{}
+	, m_pBackBuffer{}
+	, m_BackBufferDescription{}
+	, m_pSceneTarget{}
+	, m_pSceneTargetView{}
+	, m_pSceneShaderView{}
+	, m_RenderWidth{}
+	, m_RenderHeight{}
+	, m_UpscalePass{}
+	, m_pShadowSampler{}
+	, m_TimestampQueries{}
+	, m_TimestampsIssued{}
+	, m_TimestampsRead{}
+	, m_TimingFrame{ false }
+	, m_LastGpuMs{}
+	, m_FeatureLevel{}
+	, m_Features{}
+	, m_pStateCache{}
+	, m_pFrameCapture{}
+	, m_pImmediateContext{}
+	, m_DeferredContexts{}
+	, m_Buffers{ g_MaxObjects }
+	, m_ShaderViews{ g_MaxObjects }
+	, m_VertexShaders{ g_MaxObjects }
+	, m_PixelShaders{ g_MaxObjects }
+	, m_InputLayouts{ g_MaxObjects }
+	, m_PipelineStates{ g_MaxObjects }
+	, m_DepthTargets{ g_MaxObjects }
+	, m_FrameStatistics{}
+	, m_LastFrameStatistics{}
+	, m_ResourceCreations{ 0 }
+{
+}
+D3D11RenderDevice::~D3D11RenderDevice()
+{
+	if (!m_pStateCache) return;
+
+	// Persist keys for warming on the next startup
+	m_pStateCache->LogStatistics();
+	m_pStateCache->SaveKeysToFile(utils::GetFullResourcePath(L"PipelineStateKeys.bin"));
+}
+
+bool D3D11RenderDevice::Initialize(const utils::ResourceReader& readResource)
+{
+	bool success =		   CreateDevice();
+	if (success) success = CreateSwapChain();
+	if (success) success = CreateRenderTarget();
+	if (success) success = CreateDepthStencil();
+	if (success) success = CreateSceneTarget();
+
+	if (!success) return false;
+
+	m_Features.constantBufferOffsets = m_pDeviceContext1 != nullptr;
+	m_Features.structuredBuffers = m_FeatureLevel >= D3D_FEATURE_LEVEL_11_0;
+
+	// Pre-create every pipeline object used in a previous run
+	m_pStateCache = std::make_unique<PipelineStateCache>(std::make_unique<D3D11PipelineObjectFactory>(m_pDevice.Get()));
+	m_pStateCache->WarmFromFile(utils::GetFullResourcePath(L"PipelineStateKeys.bin"), readResource);
+
+	// Without the upscale pass frames stay at full resolution
+	if (!CreateUpscalePass(readResource)) Logger::Log(L"ERROR - Failed to create the upscale pass, dynamic resolution is disabled");
+	if (!CreateShadowSampler()) Logger::Log(L"ERROR - Failed to create the shadow sampler");
+	CreateTimestampQueries();
+
+	m_pFrameCapture = std::make_unique<FrameCapture>(m_pDevice.Get(), m_pDeviceContext.Get());
+
+	m_pImmediateContext = std::make_unique<D3D11CommandContext>(*this, m_pDeviceContext);
+	CreateDeferredContexts();
+
+	return true;
+}
+
+BufferHandle D3D11RenderDevice::CreateBuffer(const BufferDescription& description, const void* pInitialData)
+{
+	UINT bindFlags{};
+	switch (description.type)
+	{
+	case BufferType::Vertex:			bindFlags = D3D11_BIND_VERTEX_BUFFER;	break;
+	case BufferType::Index:				bindFlags = D3D11_BIND_INDEX_BUFFER;	break;
+	case BufferType::Constant:			bindFlags = D3D11_BIND_CONSTANT_BUFFER;	break;
+	case BufferType::ShaderResource:	bindFlags = D3D11_BIND_SHADER_RESOURCE;	break;
+	}
+
+	const bool dynamic{ description.usage == BufferUsage::Dynamic };
+	const bool structured{ description.type == BufferType::ShaderResource && description.structureStride > 0 };
+
+	const CD3D11_BUFFER_DESC bufferDescription
+	{
+		description.byteSize,																// Size
+		bindFlags,																			// Binding
+		description.usage == BufferUsage::Immutable ? D3D11_USAGE_IMMUTABLE
+			: dynamic ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT,							// Usage
+		dynamic ? static_cast<UINT>(D3D11_CPU_ACCESS_WRITE) : 0u,							// CPU access
+		structured ? static_cast<UINT>(D3D11_RESOURCE_MISC_BUFFER_STRUCTURED) : 0u,			// Misc
+		structured ? description.structureStride : 0u										// Element stride
+	};
+
+	D3D11_SUBRESOURCE_DATA initialData{ pInitialData, 0, 0 };
+
+	BufferEntry entry{ nullptr, description };
+	const HRESULT result = m_pDevice->CreateBuffer(&bufferDescription, pInitialData ? &initialData : nullptr, entry.pBuffer.GetAddressOf());
+	if (FAILED(result))
+	{
+		Logger::Log(L"ERROR - Failed to create a buffer");
+		return BufferHandle{};
+	}
+
+	++m_ResourceCreations;
+	return BufferHandle{ m_Buffers.Add(std::move(entry)) };
+}
+ShaderViewHandle D3D11RenderDevice::CreateShaderView(BufferHandle buffer, ElementFormat format, uint32_t elementCount)
+{
+	ID3D11Buffer* pBuffer{ GetBuffer(buffer) };
+	if (!pBuffer) return ShaderViewHandle{};
+
+	const CD3D11_SHADER_RESOURCE_VIEW_DESC viewDescription{ D3D11_SRV_DIMENSION_BUFFER, ToDxgiFormat(format), 0, elementCount };
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> pView;
+	const HRESULT result = m_pDevice->CreateShaderResourceView(pBuffer, &viewDescription, pView.GetAddressOf());
+	if (FAILED(result))
+	{
+		Logger::Log(L"ERROR - Failed to create a shaderResourceView");
+		return ShaderViewHandle{};
+	}
+
+	++m_ResourceCreations;
+	return ShaderViewHandle{ m_ShaderViews.Add(std::move(pView)) };
+}
+VertexShaderHandle D3D11RenderDevice::CreateVertexShader(const std::wstring& name, const std::vector<char>& bytecode)
+{
+	ID3D11VertexShader* pVertexShader{ m_pStateCache->GetVertexShader(name, bytecode) };
+	if (!pVertexShader) return VertexShaderHandle{};
+
+	++m_ResourceCreations;
+	return VertexShaderHandle{ m_VertexShaders.Add(std::move(pVertexShader)) };
+}
+PixelShaderHandle D3D11RenderDevice::CreatePixelShader(const std::wstring& name, const std::vector<char>& bytecode)
+{
+	ID3D11PixelShader* pPixelShader{ m_pStateCache->GetPixelShader(name, bytecode) };
+	if (!pPixelShader) return PixelShaderHandle{};
+
+	++m_ResourceCreations;
+	return PixelShaderHandle{ m_PixelShaders.Add(std::move(pPixelShader)) };
+}
+InputLayoutHandle D3D11RenderDevice::CreateInputLayout(const InputElement* pElements, uint32_t elementCount, const std::wstring& shaderName, const std::vector<char>& bytecode)
+{
+	std::vector<D3D11_INPUT_ELEMENT_DESC> inputLayoutDescription(elementCount);
+	for (uint32_t index{}; index < elementCount; ++index)
+	{
+		const InputElement& element = pElements[index];
+		inputLayoutDescription[index] = D3D11_INPUT_ELEMENT_DESC
+		{
+			element.pSemanticName,
+			element.semanticIndex,
+			ToDxgiFormat(element.format),
+			element.inputSlot,
+			D3D11_APPEND_ALIGNED_ELEMENT,
+			element.perInstance ? D3D11_INPUT_PER_INSTANCE_DATA : D3D11_INPUT_PER_VERTEX_DATA,
+			element.perInstance ? 1u : 0u
+		};
+	}
+
+	ID3D11InputLayout* pInputLayout{ m_pStateCache->GetInputLayout(inputLayoutDescription.data(), elementCount, shaderName, bytecode) };
+	if (!pInputLayout) return InputLayoutHandle{};
+
+	++m_ResourceCreations;
+	return InputLayoutHandle{ m_InputLayouts.Add(std::move(pInputLayout)) };
+}
+PipelineStateHandle D3D11RenderDevice::CreatePipelineState(const PipelineStateDescription& description)
+{
+	// Identical descriptions share one object through the cache
+	CD3D11_RASTERIZER_DESC rasterizerDescription{ D3D11_DEFAULT };
+	rasterizerDescription.CullMode = description.cullMode == CullMode::None ? D3D11_CULL_NONE : D3D11_CULL_BACK;
+	rasterizerDescription.DepthBias = description.depthBias;
+	rasterizerDescription.SlopeScaledDepthBias = description.slopeScaledDepthBias;
+
+	CD3D11_DEPTH_STENCIL_DESC depthStencilDescription{ D3D11_DEFAULT };
+	depthStencilDescription.DepthEnable = description.depthTest;
+	depthStencilDescription.DepthWriteMask = description.depthWrite ? D3D11_DEPTH_WRITE_MASK_ALL : D3D11_DEPTH_WRITE_MASK_ZERO;
+
+	CD3D11_BLEND_DESC blendDescription{ D3D11_DEFAULT };
+	if (description.blendMode == BlendMode::AlphaBlend)
+	{
+		blendDescription.RenderTarget[0].BlendEnable = TRUE;
+		blendDescription.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+		blendDescription.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+		blendDescription.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+		blendDescription.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+	}
+
+	PipelineStateEntry entry
+	{
+		m_pStateCache->GetRasterizerState(rasterizerDescription),
+		m_pStateCache->GetDepthStencilState(depthStencilDescription),
+		m_pStateCache->GetBlendState(blendDescription)
+	};
+
+	if (!entry.pRasterizerState || !entry.pDepthStencilState || !entry.pBlendState)
+	{
+		Logger::Log(L"ERROR - Failed to create the fixed-function pipeline states");
+		return PipelineStateHandle{};
+	}
+
+	++m_ResourceCreations;
+	return PipelineStateHandle{ m_PipelineStates.Add(std::move(entry)) };
+}
+DepthTargetHandle D3D11RenderDevice::CreateDepthTarget(const DepthTargetDescription& description)
+{
+	// Typeless, so the same texture can be a depth target and a shader input
+	const CD3D11_TEXTURE2D_DESC textureDescription
+	{
+		DXGI_FORMAT_R32_TYPELESS,
+		description.width,
+		description.height,
+		description.sliceCount,
+		1,
+		D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE
+	};
+
+	DepthTargetEntry entry{};
+	entry.description = description;
+	HRESULT result = m_pDevice->CreateTexture2D(&textureDescription, nullptr, entry.pTexture.GetAddressOf());
+	for (uint32_t slice{}; SUCCEEDED(result) && slice < description.sliceCount; ++slice)
+	{
+		const CD3D11_DEPTH_STENCIL_VIEW_DESC viewDescription{ D3D11_DSV_DIMENSION_TEXTURE2DARRAY, DXGI_FORMAT_D32_FLOAT, 0, slice, 1 };
+		entry.sliceViews.emplace_back();
+		result = m_pDevice->CreateDepthStencilView(entry.pTexture.Get(), &viewDescription, entry.sliceViews.back().GetAddressOf());
+	}
+	if (FAILED(result))
+	{
+		Logger::Log(L"ERROR - Failed to create a depth target");
+		return DepthTargetHandle{};
+	}
+
+	++m_ResourceCreations;
+	return DepthTargetHandle{ m_DepthTargets.Add(std::move(entry)) };
+}
+ShaderViewHandle D3D11RenderDevice::CreateDepthShaderView(DepthTargetHandle depthTarget)
+{
+	const DepthTargetEntry* pEntry{ m_DepthTargets.Get(depthTarget.id) };
+	if (!pEntry) return ShaderViewHandle{};
+
+	const CD3D11_SHADER_RESOURCE_VIEW_DESC viewDescription{ D3D11_SRV_DIMENSION_TEXTURE2DARRAY, DXGI_FORMAT_R32_FLOAT, 0, 1, 0, pEntry->description.sliceCount };
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> pView;
+	const HRESULT result = m_pDevice->CreateShaderResourceView(pEntry->pTexture.Get(), &viewDescription, pView.GetAddressOf());
+	if (FAILED(result))
+	{
+		Logger::Log(L"ERROR - Failed to create a depth shaderResourceView");
+		return ShaderViewHandle{};
+	}
+
+	++m_ResourceCreations;
+	return ShaderViewHandle{ m_ShaderViews.Add(std::move(pView)) };
+}
+
+void D3D11RenderDevice::DestroyBuffer(BufferHandle buffer)
+{
+	m_Buffers.Remove(buffer.id);
+}
+void D3D11RenderDevice::DestroyShaderView(ShaderViewHandle view)
+{
+	m_ShaderViews.Remove(view.id);
+}
+void D3D11RenderDevice::DestroyDepthTarget(DepthTargetHandle depthTarget)
+{
+	m_DepthTargets.Remove(depthTarget.id);
+}
+
+const char* D3D11RenderDevice::GetShaderProfile(ShaderStage stage) const
+{
+	// Highest shader model the feature level runs
+	const bool isVertex{ stage == ShaderStage::Vertex };
+	if (m_FeatureLevel >= D3D_FEATURE_LEVEL_11_0) return isVertex ? "vs_5_0" : "ps_5_0";
+	if (m_FeatureLevel >= D3D_FEATURE_LEVEL_10_1) return isVertex ? "vs_4_1" : "ps_4_1";
+	if (m_FeatureLevel >= D3D_FEATURE_LEVEL_10_0) return isVertex ? "vs_4_0" : "ps_4_0";
+	return isVertex ? "vs_4_0_level_9_1" : "ps_4_0_level_9_1";
+}
+bool D3D11RenderDevice::CompileShader(const ShaderCompileDescription& description, std::vector<char>& bytecode, std::string& errors)
+{
+	// D3DCompile is thread-safe, the defines end with an empty one
+	std::vector<D3D_SHADER_MACRO> macros(static_cast<size_t>(description.defineCount) + 1, D3D_SHADER_MACRO{ nullptr, nullptr });
+	for (uint32_t index{}; index < description.defineCount; ++index)
+	{
+		macros[index] = D3D_SHADER_MACRO{ description.pDefines[index].pName, description.pDefines[index].pValue };
+	}
+
+	Microsoft::WRL::ComPtr<ID3DBlob> pBytecode;
+	Microsoft::WRL::ComPtr<ID3DBlob> pErrors;
+	const HRESULT result = D3DCompile(description.pSource, description.sourceSize, description.pSourceName, macros.data(), nullptr,
+		description.pEntryPoint, description.pProfile, D3DCOMPILE_ENABLE_STRICTNESS | D3DCOMPILE_OPTIMIZATION_LEVEL3, 0, pBytecode.GetAddressOf(), pErrors.GetAddressOf());
+
+	// Warnings come through here too
+	if (pErrors) errors.assign(static_cast<const char*>(pErrors->GetBufferPointer()), pErrors->GetBufferSize());
+	if (FAILED(result) || !pBytecode) return false;
+
+	const char* pBytes = static_cast<const char*>(pBytecode->GetBufferPointer());
+	bytecode.assign(pBytes, pBytes + pBytecode->GetBufferSize());
+	return true;
+}
+
+void D3D11RenderDevice::BeginFrame(const float clearColor[4])
+{
+	m_FrameStatistics = Statistics{};
+	m_pImmediateContext->ResetStatistics();
+
+	// Skipped while the GPU is so far behind that every query is still in flight
+	const TimestampQuery& query = m_TimestampQueries[m_TimestampsIssued % g_TimestampLatency];
+	m_TimingFrame = query.pDisjoint && m_TimestampsIssued - m_TimestampsRead < g_TimestampLatency;
+	if (m_TimingFrame)
+	{
+		m_pDeviceContext->Begin(query.pDisjoint.Get());
+		m_pDeviceContext->End(query.pStart.Get());
+	}
+
+	// Clear the renderTarget and the z-buffer
+	m_pDeviceContext->ClearRenderTargetView(m_pSceneTargetView.Get(), clearColor);
+	m_pDeviceContext->ClearDepthStencilView(m_pDepthStencilView.Get(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.f, 0);
+
+	// Set the renderTarget
+	m_pImmediateContext->BindBackBuffer(m_pSceneTargetView.Get(), m_pDepthStencilView.Get());
+}
+void D3D11RenderDevice::Present()
+{
+	UpscaleSceneTarget();
+
+	if (m_TimingFrame)
+	{
+		const TimestampQuery& query = m_TimestampQueries[m_TimestampsIssued % g_TimestampLatency];
+		m_pDeviceContext->End(query.pEnd.Get());
+		m_pDeviceContext->End(query.pDisjoint.Get());
+		++m_TimestampsIssued;
+	}
+	ReadTimestamps();
+
+	// Queue the backBuffer readback, mapped a few frames later
+	m_pFrameCapture->CaptureFrame(m_pBackBuffer.Get());
+
+	// Present frame (do after every geometry is rendered)
+	m_pSwapChain->Present(1, 0);
+
+	AddStatistics(m_pImmediateContext->GetStatistics());
+	m_FrameStatistics.resourceCreations = m_ResourceCreations.load(std::memory_order_relaxed);
+	m_FrameStatistics.gpuMs = m_LastGpuMs;
+	m_LastFrameStatistics = m_FrameStatistics;
+
+	RetireObjects();
+}
+bool D3D11RenderDevice::ResizeBackBuffer(uint32_t width, uint32_t height)
+{
+	// ResizeBuffers fails while anything still references the backBuffer, bound or recorded
+	for (const std::unique_ptr<D3D11CommandContext>& pContext : m_DeferredContexts) pContext->Discard();
+	m_pDeviceContext->OMSetRenderTargets(0, nullptr, nullptr);
+
+	m_pRenderTargetView.Reset();
+	m_pBackBuffer.Reset();
+	m_pDepthStencilView.Reset();
+	m_pDepthStencil.Reset();
+	m_pSceneShaderView.Reset();
+	m_pSceneTargetView.Reset();
+	m_pSceneTarget.Reset();
+
+	// Released views are only destroyed once the context flushes
+	m_pDeviceContext->Flush();
+
+	// Keep the buffer count and format, only the size changes
+	const HRESULT result{ m_pSwapChain->ResizeBuffers(0, width, height, DXGI_FORMAT_UNKNOWN, 0) };
+	if (FAILED(result))
+	{
+		Logger::Log(L"FAILED - There was an error resizing the SwapChain buffers");
+		return false;
+	}
+
+	return CreateRenderTarget() && CreateDepthStencil() && CreateSceneTarget();
+}
+
+void D3D11RenderDevice::SetRenderResolution(uint32_t width, uint32_t height)
+{
+	if (!m_UpscalePass.pPixelShader) return;
+
+	m_RenderWidth = std::clamp(width, 1u, static_cast<uint32_t>(m_BackBufferDescription.Width));
+	m_RenderHeight = std::clamp(height, 1u, static_cast<uint32_t>(m_BackBufferDescription.Height));
+
+	// Sampling stops half a texel inside the drawn part, the rest of the scene target is stale
+	const float targetWidth{ static_cast<float>(m_BackBufferDescription.Width) };
+	const float targetHeight{ static_cast<float>(m_BackBufferDescription.Height) };
+	const CB_Upscale constants
+	{
+		{ m_RenderWidth / targetWidth, m_RenderHeight / targetHeight },
+		{ (m_RenderWidth - 0.5f) / targetWidth, (m_RenderHeight - 0.5f) / targetHeight }
+	};
+	m_pDeviceContext->UpdateSubresource(m_UpscalePass.pConstantBuffer.Get(), 0, nullptr, &constants, 0, 0);
+}
+
+void D3D11RenderDevice::UpdateBuffer(BufferHandle buffer, const void* pData, uint32_t byteSize)
+{
+	BufferEntry* pEntry{ m_Buffers.Get(buffer.id) };
+	if (!pEntry) return;
+
+	if (pEntry->description.usage == BufferUsage::Dynamic)
+	{
+		// Fully rewritten, so the old contents can be discarded
+		D3D11_MAPPED_SUBRESOURCE mappedResource{};
+		if (FAILED(m_pDeviceContext->Map(pEntry->pBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource))) return;
+
+		if (byteSize > 0) memcpy(mappedResource.pData, pData, byteSize);
+		m_pDeviceContext->Unmap(pEntry->pBuffer.Get(), 0);
+	}
+	else
+	{
+		// Constant buffers can only be updated as a whole
+		const D3D11_BOX destinationBox{ 0, 0, 0, byteSize, 1, 1 };
+		const bool wholeBuffer{ pEntry->description.type == BufferType::Constant || byteSize == pEntry->description.byteSize };
+		m_pDeviceContext->UpdateSubresource(pEntry->pBuffer.Get(), 0, wholeBuffer ? nullptr : &destinationBox, pData, 0, 0);
+	}
+
+	++m_FrameStatistics.uploadCount;
+	m_FrameStatistics.uploadBytes += byteSize;
+}
+
+void D3D11RenderDevice::BeginDepthPass(DepthTargetHandle depthTarget, uint32_t slice)
+{
+	const DepthTargetEntry* pEntry{ m_DepthTargets.Get(depthTarget.id) };
+	if (!pEntry || slice >= pEntry->sliceViews.size()) return;
+
+	// Nothing stays bound, a view of this target can't be read while it is drawn to
+	ID3D11DepthStencilView* pSliceView{ pEntry->sliceViews[slice].Get() };
+	m_pDeviceContext->ClearState();
+	m_pDeviceContext->ClearDepthStencilView(pSliceView, D3D11_CLEAR_DEPTH, 1.f, 0);
+	m_pImmediateContext->BindDepthTarget(pSliceView);
+}
+void D3D11RenderDevice::EndDepthPass()
+{
+	m_pDeviceContext->ClearState();
+	m_pImmediateContext->BindBackBuffer(m_pSceneTargetView.Get(), m_pDepthStencilView.Get());
+}
+
+void D3D11RenderDevice::SetViewport(const Viewport& viewport)
+{
+	m_pImmediateContext->SetViewport(viewport);
+}
+void D3D11RenderDevice::SetPipelineState(PipelineStateHandle pipelineState)
+{
+	m_pImmediateContext->SetPipelineState(pipelineState);
+}
+void D3D11RenderDevice::SetInputLayout(InputLayoutHandle inputLayout)
+{
+	m_pImmediateContext->SetInputLayout(inputLayout);
+}
+void D3D11RenderDevice::SetVertexShader(VertexShaderHandle vertexShader)
+{
+	m_pImmediateContext->SetVertexShader(vertexShader);
+}
+void D3D11RenderDevice::SetPixelShader(PixelShaderHandle pixelShader)
+{
+	m_pImmediateContext->SetPixelShader(pixelShader);
+}
+void D3D11RenderDevice::SetVertexBuffers(uint32_t startSlot, uint32_t bufferCount, const BufferHandle* pBuffers, const uint32_t* pStrides)
+{
+	m_pImmediateContext->SetVertexBuffers(startSlot, bufferCount, pBuffers, pStrides);
+}
+void D3D11RenderDevice::SetIndexBuffer(BufferHandle buffer, ElementFormat format)
+{
+	m_pImmediateContext->SetIndexBuffer(buffer, format);
+}
+void D3D11RenderDevice::SetConstantBuffer(ShaderStage stage, uint32_t slot, BufferHandle buffer, uint32_t firstConstant, uint32_t constantCount)
+{
+	m_pImmediateContext->SetConstantBuffer(stage, slot, buffer, firstConstant, constantCount);
+}
+void D3D11RenderDevice::SetShaderViews(ShaderStage stage, uint32_t startSlot, uint32_t viewCount, const ShaderViewHandle* pViews)
+{
+	m_pImmediateContext->SetShaderViews(stage, startSlot, viewCount, pViews);
+}
+
+void D3D11RenderDevice::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+	m_pImmediateContext->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+void D3D11RenderDevice::DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount)
+{
+	m_pImmediateContext->DrawIndexedInstanced(indexCountPerInstance, instanceCount);
+}
+
+CommandRecorder& D3D11RenderDevice::BeginRecording(uint32_t recorderIndex)
+{
+	// Every worker owns one deferred context, so recording doesn't lock
+	D3D11CommandContext& context = *m_DeferredContexts[(std::min)(recorderIndex, GetRecorderCount() - 1)];
+	context.Begin(m_pSceneTargetView.Get(), m_pDepthStencilView.Get());
+	return context;
+}
+void D3D11RenderDevice::EndRecording(uint32_t recorderIndex)
+{
+	if (recorderIndex >= GetRecorderCount()) return;
+	m_DeferredContexts[recorderIndex]->Finish();
+}
+void D3D11RenderDevice::ExecuteRecording(uint32_t recorderIndex)
+{
+	if (recorderIndex >= GetRecorderCount()) return;
+
+	D3D11CommandContext& context = *m_DeferredContexts[recorderIndex];
+	if (!context.HasCommandList()) return;
+
+	context.Execute(m_pDeviceContext.Get());
+	AddStatistics(context.GetStatistics());
+	context.ResetStatistics();
+
+	// Executing clears the immediate state, later immediate draws still need the targets
+	m_pImmediateContext->BindBackBuffer(m_pSceneTargetView.Get(), m_pDepthStencilView.Get());
+}
+
+bool D3D11RenderDevice::StartCapture(FrameCaptureEncoder::Format format, const std::wstring& filePath)
+{
+	return m_pFrameCapture && m_pFrameCapture->Start(format, filePath);
+}
+void D3D11RenderDevice::StopCapture()
+{
+	if (m_pFrameCapture) m_pFrameCapture->Stop();
+}
+bool D3D11RenderDevice::IsCapturing() const
+{
+	return m_pFrameCapture && m_pFrameCapture->IsCapturing();
+}
+
+void D3D11RenderDevice::LogStatistics() const
+{
+	const Statistics& statistics = m_LastFrameStatistics;
+
+	std::wstringstream message;
+	message << L"D3D11 device: " << statistics.drawCount << L" draws, " << statistics.triangleCount << L" triangles, "
+		<< statistics.bindCount << L" binds, " << statistics.uploadCount << L" uploads (" << statistics.uploadBytes << L" bytes), "
+		<< statistics.resourceCreations << L" resources created, " << m_RenderWidth << L"x" << m_RenderHeight
+		<< L" drawn in " << statistics.gpuMs << L" ms on the GPU";
+	Logger::Log(message.str());
+
+	if (IsCapturing()) m_pFrameCapture->LogStatistics();
+}
+
+// Privates
+// --------
+bool D3D11RenderDevice::CreateDevice()
+{
+	// Minimum level of hardware the application supports
+	const D3D_FEATURE_LEVEL featureLevels[] =
+	{
+		D3D_FEATURE_LEVEL_11_1,
+		D3D_FEATURE_LEVEL_11_0,
+		D3D_FEATURE_LEVEL_10_1,
+		D3D_FEATURE_LEVEL_10_0,
+		D3D_FEATURE_LEVEL_9_3,
+		D3D_FEATURE_LEVEL_9_2,
+		D3D_FEATURE_LEVEL_9_1,
+	};
+
+	// Supports surface with different color-change than API default, required for Direct2D
+	UINT deviceFlags = D3D11_CREATE_DEVICE_BGRA_SUPPORT;
+
+#if defined(DEBUG) || defined(_DEBUG)
+	deviceFlags |= D3D11_CREATE_DEVICE_DEBUG;
+#endif
+
+	// Create device
+	HRESULT result = D3D11CreateDevice
+	(
+		nullptr,							// Default adapter
+		D3D_DRIVER_TYPE_HARDWARE,			// Create device using hardware graphics driver
+		0,									// Not using D3D_DRIVER_TYPE_SOFTWARE
+		deviceFlags,						// Direct2D and debug compatiblity
+		featureLevels,						// Supported feature levels
+		ARRAYSIZE(featureLevels),			// Size of levels array
+		D3D11_SDK_VERSION,					// Version for Windows Store Apps
+		m_pDevice.GetAddressOf(),			// Returns created Direct3D device
+		&m_FeatureLevel,					// Returns feature level of created device
+		m_pDeviceContext.GetAddressOf()		// Returns device immediate context
+	);
+
+	if (FAILED(result))
+	{
+		Logger::Log(L"FAILED - There was an error creating the DirectX Device");
+		return false;
+	}
+
+	Logger::Log(L"Succeeded creating the DirectX Device");
+
+	// Constant buffer offsetting lets every view and object share one batched buffer
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options{};
+	result = m_pDevice->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+	if (SUCCEEDED(result) && options.ConstantBufferOffsetting)
+	{
+		m_pDeviceContext.As(&m_pDeviceContext1);
+	}
+	else
+	{
+		Logger::Log(L"Constant buffer offsetting is not supported, falling back to per draw updates");
+	}
+
+	return true;
+}
+bool D3D11RenderDevice::CreateSwapChain()
+{
+	// Create swapChain description
+	DXGI_SWAP_CHAIN_DESC chainDescription;
+	ZeroMemory(&chainDescription, sizeof(DXGI_SWAP_CHAIN_DESC));
+
+	chainDescription.Windowed = TRUE;									// Not in full-screen mode
+	chainDescription.BufferCount = 2;									// Double-buffer
+	chainDescription.BufferDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;	// 32-bit color
+	chainDescription.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;		// Used for drawing
+	chainDescription.SampleDesc.Count = 1;								// Multisampling setting
+	chainDescription.SampleDesc.Quality = 0;							// Vendor-specific flag
+	chainDescription.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;		// How buffer swaps
+	chainDescription.OutputWindow = m_WindowHandle;						// Window to render to
+
+	// Cast to IDXGIDevice3
+	Microsoft::WRL::ComPtr<IDXGIDevice3> pDxgiDevice;
+	m_pDevice.As(&pDxgiDevice);
+
+	// Create swapChain
+	Microsoft::WRL::ComPtr<IDXGIAdapter> pAdapter;
+	HRESULT result = pDxgiDevice->GetAdapter(&pAdapter);
+
+	if (FAILED(result))
+	{
+		Logger::Log(L"FAILED - There was an error getting the DirectX Adapter");
+		return false;
+	}
+
+	Logger::Log(L"Succeeded getting the DirectX Adapter");
+
+	Microsoft::WRL::ComPtr<IDXGIFactory> pFactory;
+	pAdapter->GetParent(__uuidof(IDXGIFactory), &pFactory);
+
+	result = pFactory->CreateSwapChain(m_pDevice.Get(), &chainDescription, m_pSwapChain.GetAddressOf());
+	if (FAILED(result))
+	{
+		Logger::Log(L"FAILED - There was an error creating the DirectX SwapChain");
+		return false;
+	}
+	else
+	{
+		Logger::Log(L"Succeeded creating the DirectX SwapChain");
+		return true;
+	}
+}
+bool D3D11RenderDevice::CreateRenderTarget()
+{
+	// Get backBuffer
+	HRESULT result = m_pSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), reinterpret_cast<void**>(m_pBackBuffer.GetAddressOf()));
+	if (FAILED(result))
+	{
+		Logger::Log(L"FAILED - There was an error getting the SwapChain backBuffer");
+		return false;
+	}
+
+	// Create renderTargetView
+	result = m_pDevice->CreateRenderTargetView
+	(
+		m_pBackBuffer.Get(),					// Give backBuffer for read
+		nullptr,								// Default description
+		m_pRenderTargetView.GetAddressOf()		// Returns renderTargetView
+	);
+
+	if (FAILED(result))
+	{
+		Logger::Log(L"FAILED - There was an error creating the RenderTargetView");
+		return false;
+	}
+
+	m_pBackBuffer->GetDesc(&m_BackBufferDescription);
+
+	return true;
+}
+bool D3D11RenderDevice::CreateDepthStencil()
+{
+	// Create description
+	const CD3D11_TEXTURE2D_DESC depthStencilDesc
+	{
+		DXGI_FORMAT_D24_UNORM_S8_UINT,	// Texture Format
+		m_BackBufferDescription.Width,	// Width
+		m_BackBufferDescription.Height,	// Height
+		1,								// Only 1 texture
+		1,								// 1 mipmap level
+		D3D11_BIND_DEPTH_STENCIL		// Used as depth stencil
+	};
+
+	// Create texture
+	HRESULT result = m_pDevice->CreateTexture2D(&depthStencilDesc, nullptr, m_pDepthStencil.GetAddressOf());
+	if (FAILED(result))
+	{
+		Logger::Log(L"FAILED - There was an error creating the DepthStencil texture");
+		return false;
+	}
+
+	// Create view
+	CD3D11_DEPTH_STENCIL_VIEW_DESC depthStencilViewDesc{ D3D11_DSV_DIMENSION_TEXTURE2D };	// Used by texture2D
+	result = m_pDevice->CreateDepthStencilView(m_pDepthStencil.Get(), &depthStencilViewDesc, m_pDepthStencilView.GetAddressOf());
+	if (FAILED(result))
+	{
+		Logger::Log(L"FAILED - There was an error creating the DepthStencilView");
+		return false;
+	}
+
+	return true;
+}
+bool D3D11RenderDevice::CreateSceneTarget()
+{
+	// Same size and format as the backBuffer, so a full resolution frame is a plain copy
+	const CD3D11_TEXTURE2D_DESC sceneTargetDesc
+	{
+		m_BackBufferDescription.Format,									// Texture Format
+		m_BackBufferDescription.Width,									// Width
+		m_BackBufferDescription.Height,									// Height
+		1,																// Only 1 texture
+		1,																// 1 mipmap level
+		D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE			// Drawn to, then sampled by the upscale
+	};
+
+	HRESULT result = m_pDevice->CreateTexture2D(&sceneTargetDesc, nullptr, m_pSceneTarget.GetAddressOf());
+	if (SUCCEEDED(result)) result = m_pDevice->CreateRenderTargetView(m_pSceneTarget.Get(), nullptr, m_pSceneTargetView.GetAddressOf());
+	if (SUCCEEDED(result)) result = m_pDevice->CreateShaderResourceView(m_pSceneTarget.Get(), nullptr, m_pSceneShaderView.GetAddressOf());
+	if (FAILED(result))
+	{
+		Logger::Log(L"FAILED - There was an error creating the scene target");
+		return false;
+	}
+
+	// A new size always starts at full resolution
+	m_RenderWidth = m_BackBufferDescription.Width;
+	m_RenderHeight = m_BackBufferDescription.Height;
+	return true;
+}
+bool D3D11RenderDevice::CreateUpscalePass(const utils::ResourceReader& readResource)
+{
+	std::vector<char> vertexBytecode;
+	std::vector<char> pixelBytecode;
+	if (!readResource(L"Upscale_VS.cso", vertexBytecode) || !readResource(L"Upscale_PS.cso", pixelBytecode)) return false;
+
+	m_UpscalePass.pVertexShader = m_pStateCache->GetVertexShader(L"Upscale_VS.cso", vertexBytecode);
+	m_UpscalePass.pPixelShader = m_pStateCache->GetPixelShader(L"Upscale_PS.cso", pixelBytecode);
+
+	// One triangle over the whole backBuffer, no culling, depth or blending
+	CD3D11_RASTERIZER_DESC rasterizerDescription{ D3D11_DEFAULT };
+	rasterizerDescription.CullMode = D3D11_CULL_NONE;
+	CD3D11_DEPTH_STENCIL_DESC depthStencilDescription{ D3D11_DEFAULT };
+	depthStencilDescription.DepthEnable = FALSE;
+	depthStencilDescription.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+
+	m_UpscalePass.states = PipelineStateEntry
+	{
+		m_pStateCache->GetRasterizerState(rasterizerDescription),
+		m_pStateCache->GetDepthStencilState(depthStencilDescription),
+		m_pStateCache->GetBlendState(CD3D11_BLEND_DESC{ D3D11_DEFAULT })
+	};
+
+	const CD3D11_SAMPLER_DESC samplerDescription{ D3D11_DEFAULT };	// Linear and clamped
+	const CD3D11_BUFFER_DESC constantBufferDescription{ sizeof(CB_Upscale), D3D11_BIND_CONSTANT_BUFFER };
+
+	const bool created{ m_UpscalePass.pVertexShader && m_UpscalePass.pPixelShader && m_UpscalePass.states.pRasterizerState
+		&& m_UpscalePass.states.pDepthStencilState && m_UpscalePass.states.pBlendState
+		&& SUCCEEDED(m_pDevice->CreateSamplerState(&samplerDescription, m_UpscalePass.pSampler.GetAddressOf()))
+		&& SUCCEEDED(m_pDevice->CreateBuffer(&constantBufferDescription, nullptr, m_UpscalePass.pConstantBuffer.GetAddressOf())) };
+
+	if (!created)
+	{
+		m_UpscalePass = UpscalePass{};
+		return false;
+	}
+
+	return true;
+}
+bool D3D11RenderDevice::CreateShadowSampler()
+{
+	// Bilinear comparison gives 2x2 PCF per tap, outside the map counts as lit
+	CD3D11_SAMPLER_DESC samplerDescription{ D3D11_DEFAULT };
+	samplerDescription.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+	samplerDescription.AddressU = D3D11_TEXTURE_ADDRESS_BORDER;
+	samplerDescription.AddressV = D3D11_TEXTURE_ADDRESS_BORDER;
+	samplerDescription.ComparisonFunc = D3D11_COMPARISON_LESS_EQUAL;
+	samplerDescription.BorderColor[0] = 1.f;
+
+	return SUCCEEDED(m_pDevice->CreateSamplerState(&samplerDescription, m_pShadowSampler.GetAddressOf()));
+}
+void D3D11RenderDevice::CreateTimestampQueries()
+{
+	const CD3D11_QUERY_DESC disjointDescription{ D3D11_QUERY_TIMESTAMP_DISJOINT };
+	const CD3D11_QUERY_DESC timestampDescription{ D3D11_QUERY_TIMESTAMP };
+
+	for (TimestampQuery& query : m_TimestampQueries)
+	{
+		if (FAILED(m_pDevice->CreateQuery(&disjointDescription, query.pDisjoint.GetAddressOf()))
+			|| FAILED(m_pDevice->CreateQuery(&timestampDescription, query.pStart.GetAddressOf()))
+			|| FAILED(m_pDevice->CreateQuery(&timestampDescription, query.pEnd.GetAddressOf())))
+		{
+			// Frames just aren't timed, the resolution stays where it is
+			Logger::Log(L"ERROR - Failed to create the timestamp queries, GPU frame times are unknown");
+			m_TimestampQueries = {};
+			return;
+		}
+	}
+}
+
+void D3D11RenderDevice::CreateDeferredContexts()
+{
+	// Without driver command lists the runtime emulates them, recording in parallel still helps
+	D3D11_FEATURE_DATA_THREADING threading{};
+	if (FAILED(m_pDevice->CheckFeatureSupport(D3D11_FEATURE_THREADING, &threading, sizeof(threading))) || !threading.DriverCommandLists)
+	{
+		Logger::Log(L"Driver command lists are not supported, deferred contexts are emulated by the runtime");
+	}
+
+	const uint32_t recorderCount{ std::clamp(std::thread::hardware_concurrency(), 1u, g_MaxRecorders) };
+	for (uint32_t index{}; index < recorderCount; ++index)
+	{
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> pDeferredContext;
+		if (FAILED(m_pDevice->CreateDeferredContext(0, pDeferredContext.GetAddressOf())))
+		{
+			Logger::Log(L"ERROR - Failed to create a deferred context");
+			break;
+		}
+
+		m_DeferredContexts.push_back(std::make_unique<D3D11CommandContext>(*this, pDeferredContext));
+	}
+}
+
+void D3D11RenderDevice::UpscaleSceneTarget()
+{
+	// Same size and format, nothing to filter
+	if (m_RenderWidth == m_BackBufferDescription.Width && m_RenderHeight == m_BackBufferDescription.Height)
+	{
+		m_pDeviceContext->CopyResource(m_pBackBuffer.Get(), m_pSceneTarget.Get());
+		return;
+	}
+
+	const D3D11_VIEWPORT viewport{ 0.f, 0.f, static_cast<float>(m_BackBufferDescription.Width), static_cast<float>(m_BackBufferDescription.Height), 0.f, 1.f };
+	const float blendFactor[] = { 1.f, 1.f, 1.f, 1.f };
+
+	m_pDeviceContext->OMSetRenderTargets(1, m_pRenderTargetView.GetAddressOf(), nullptr);
+	m_pDeviceContext->RSSetViewports(1, &viewport);
+	m_pDeviceContext->RSSetState(m_UpscalePass.states.pRasterizerState);
+	m_pDeviceContext->OMSetDepthStencilState(m_UpscalePass.states.pDepthStencilState, 0);
+	m_pDeviceContext->OMSetBlendState(m_UpscalePass.states.pBlendState, blendFactor, 0xffffffff);
+
+	m_pDeviceContext->IASetInputLayout(nullptr);
+	m_pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	m_pDeviceContext->VSSetShader(m_UpscalePass.pVertexShader, nullptr, 0);
+	m_pDeviceContext->VSSetConstantBuffers(0, 1, m_UpscalePass.pConstantBuffer.GetAddressOf());
+	m_pDeviceContext->PSSetShader(m_UpscalePass.pPixelShader, nullptr, 0);
+	m_pDeviceContext->PSSetConstantBuffers(0, 1, m_UpscalePass.pConstantBuffer.GetAddressOf());
+	m_pDeviceContext->PSSetShaderResources(0, 1, m_pSceneShaderView.GetAddressOf());
+	m_pDeviceContext->PSSetSamplers(0, 1, m_UpscalePass.pSampler.GetAddressOf());
+
+	m_pDeviceContext->Draw(3, 0);
+
+	// The scene target is bound as a renderTarget again next frame, it can't stay bound as an input
+	ID3D11ShaderResourceView* pNullView{ nullptr };
+	m_pDeviceContext->PSSetShaderResources(0, 1, &pNullView);
+}
+void D3D11RenderDevice::ReadTimestamps()
+{
+	// Oldest first, stops at the first frame the GPU hasn't finished
+	while (m_TimestampsRead < m_TimestampsIssued)
+	{
+		const TimestampQuery& query = m_TimestampQueries[m_TimestampsRead % g_TimestampLatency];
+
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint{};
+		UINT64 start{};
+		UINT64 end{};
+		if (m_pDeviceContext->GetData(query.pDisjoint.Get(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK
+			|| m_pDeviceContext->GetData(query.pStart.Get(), &start, sizeof(start), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK
+			|| m_pDeviceContext->GetData(query.pEnd.Get(), &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK) break;
+
+		// A disjoint frame had its clock change halfway, the timestamps mean nothing
+		if (!disjoint.Disjoint && disjoint.Frequency > 0) m_LastGpuMs = static_cast<float>(static_cast<double>(end - start) * 1000.0 / disjoint.Frequency);
+		++m_TimestampsRead;
+	}
+}
+void D3D11RenderDevice::RetireObjects()
+{
+	// Recorded lists and the frames still queued may reference destroyed objects, the COM objects are released once those have retired
+	m_Buffers.RetireFrame(g_RetireLatency);
+	m_ShaderViews.RetireFrame(g_RetireLatency);
+	m_VertexShaders.RetireFrame(g_RetireLatency);
+	m_PixelShaders.RetireFrame(g_RetireLatency);
+	m_InputLayouts.RetireFrame(g_RetireLatency);
+	m_PipelineStates.RetireFrame(g_RetireLatency);
+	m_DepthTargets.RetireFrame(g_RetireLatency);
+}
+
+void D3D11RenderDevice::AddStatistics(const Statistics& statistics)
+{
+	m_FrameStatistics.drawCount += statistics.drawCount;
+	m_FrameStatistics.triangleCount += statistics.triangleCount;
+	m_FrameStatistics.bindCount += statistics.bindCount;
+}
+ID3D11Buffer* D3D11RenderDevice::GetBuffer(BufferHandle buffer) const
+{
+	const BufferEntry* pEntry{ m_Buffers.Get(buffer.id) };
+	return pEntry ? pEntry->pBuffer.Get() : nullptr;
+}
+DXGI_FORMAT D3D11RenderDevice::ToDxgiFormat(ElementFormat format)
+{
+	switch (format)
+	{
+	case ElementFormat::R16_UInt:			return DXGI_FORMAT_R16_UINT;
+	case ElementFormat::R32_UInt:			return DXGI_FORMAT_R32_UINT;
+	case ElementFormat::R32G32_UInt:		return DXGI_FORMAT_R32G32_UINT;
+	case ElementFormat::R8G8B8A8_UInt:		return DXGI_FORMAT_R8G8B8A8_UINT;
+	case ElementFormat::R32G32_Float:		return DXGI_FORMAT_R32G32_FLOAT;
+	case ElementFormat::R32G32B32_Float:	return DXGI_FORMAT_R32G32B32_FLOAT;
+	case ElementFormat::R32G32B32A32_Float:	return DXGI_FORMAT_R32G32B32A32_FLOAT;
+	default:								return DXGI_FORMAT_UNKNOWN;
+	}
+}
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <Windows.h>
+#include <d3d11.h>
+#include <d3d11_1.h>
+#include <wrl.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "D3D11CommandContext.h"
+#include "DeviceObjectTable.h"
+#include "RenderDevice.h"
+#include "Utils.h"
+
+class PipelineStateCache;
+class FrameCapture;
+
+// The D3D11 backend, owns the device, the swapChain and the backBuffer targets
+// Shaders and fixed-function states come from the PipelineStateCache, so identical objects are shared
+// Workers record into deferred contexts, the immediate context only executes their command lists
+// Frames are drawn into a backBuffer sized scene target, Present upscales the part at render resolution into the backBuffer
+// GPU frame times come from timestamp queries, read back a few frames later without stalling
+class D3D11RenderDevice final : public RenderDevice
+{
+public:
+	// Rule of five
+	explicit D3D11RenderDevice(HWND windowHandle);
+	~D3D11RenderDevice() override;
+
+	D3D11RenderDevice(const D3D11RenderDevice& other) = delete;
+	D3D11RenderDevice(D3D11RenderDevice&& other) = delete;
+	D3D11RenderDevice& operator= (const D3D11RenderDevice& other) = delete;
+	D3D11RenderDevice& operator= (D3D11RenderDevice&& other) = delete;
+
+	// Publics
+	bool Initialize(const utils::ResourceReader& readResource);	// Shader bytecode for warming the pipeline state cache
+
+	RenderDeviceType GetType() const override { return RenderDeviceType::D3D11; }
+	const Features& GetFeatures() const override { return m_Features; }
+	uint32_t GetBackBufferWidth() const override { return m_BackBufferDescription.Width; }
+	uint32_t GetBackBufferHeight() const override { return m_BackBufferDescription.Height; }
+
+	BufferHandle CreateBuffer(const BufferDescription& description, const void* pInitialData) override;
+	ShaderViewHandle CreateShaderView(BufferHandle buffer, ElementFormat format, uint32_t elementCount) override;
+	VertexShaderHandle CreateVertexShader(const std::wstring& name, const std::vector<char>& bytecode) override;
+	PixelShaderHandle CreatePixelShader(const std::wstring& name, const std::vector<char>& bytecode) override;
+	InputLayoutHandle CreateInputLayout(const InputElement* pElements, uint32_t elementCount, const std::wstring& shaderName, const std::vector<char>& bytecode) override;
+	PipelineStateHandle CreatePipelineState(const PipelineStateDescription& description) override;
+	DepthTargetHandle CreateDepthTarget(const DepthTargetDescription& description) override;
+	ShaderViewHandle CreateDepthShaderView(DepthTargetHandle depthTarget) override;
+
+	void DestroyBuffer(BufferHandle buffer) override;
+	void DestroyShaderView(ShaderViewHandle view) override;
+	void DestroyDepthTarget(DepthTargetHandle depthTarget) override;
+
+	const char* GetShaderProfile(ShaderStage stage) const override;
+	bool CompileShader(const ShaderCompileDescription& description, std::vector<char>& bytecode, std::string& errors) override;
+
+	void BeginFrame(const float clearColor[4]) override;
+	void Present() override;
+	bool ResizeBackBuffer(uint32_t width, uint32_t height) override;
+
+	void SetRenderResolution(uint32_t width, uint32_t height) override;
+	uint32_t GetRenderWidth() const override { return m_RenderWidth; }
+	uint32_t GetRenderHeight() const override { return m_RenderHeight; }
+
+	void UpdateBuffer(BufferHandle buffer, const void* pData, uint32_t byteSize) override;
+
+	void BeginDepthPass(DepthTargetHandle depthTarget, uint32_t slice) override;
+	void EndDepthPass() override;
+
+	void SetViewport(const Viewport& viewport) override;
+	void SetPipelineState(PipelineStateHandle pipelineState) override;
+	void SetInputLayout(InputLayoutHandle inputLayout) override;
+	void SetVertexShader(VertexShaderHandle vertexShader) override;
+	void SetPixelShader(PixelShaderHandle pixelShader) override;
+	void SetVertexBuffers(uint32_t startSlot, uint32_t bufferCount, const BufferHandle* pBuffers, const uint32_t* pStrides) override;
+	void SetIndexBuffer(BufferHandle buffer, ElementFormat format) override;
+	void SetConstantBuffer(ShaderStage stage, uint32_t slot, BufferHandle buffer, uint32_t firstConstant = 0, uint32_t constantCount = 0) override;
+	void SetShaderViews(ShaderStage stage, uint32_t startSlot, uint32_t viewCount, const ShaderViewHandle* pViews) override;
+
+	void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+	void DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount) override;
+
+	uint32_t GetRecorderCount() const override { return static_cast<uint32_t>(m_DeferredContexts.size()); }
+	CommandRecorder& BeginRecording(uint32_t recorderIndex) override;
+	void EndRecording(uint32_t recorderIndex) override;
+	void ExecuteRecording(uint32_t recorderIndex) override;
+
+	bool StartCapture(FrameCaptureEncoder::Format format, const std::wstring& filePath) override;
+	void StopCapture() override;
+	bool IsCapturing() const override;
+
+	const Statistics& GetFrameStatistics() const override { return m_LastFrameStatistics; }
+	void LogStatistics() const override;
+
+private:
+	// The contexts read the object tables directly
+	friend class D3D11CommandContext;
+
+	// Structs
+	struct BufferEntry
+	{
+		Microsoft::WRL::ComPtr<ID3D11Buffer> pBuffer;
+		BufferDescription description;
+	};
+
+	struct PipelineStateEntry
+	{
+		ID3D11RasterizerState* pRasterizerState;		// Owned by the state cache
+		ID3D11DepthStencilState* pDepthStencilState;
+		ID3D11BlendState* pBlendState;
+	};
+
+	struct DepthTargetEntry
+	{
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> pTexture;	// Typeless, written as D32 and read as R32
+		std::vector<Microsoft::WRL::ComPtr<ID3D11DepthStencilView>> sliceViews;
+		DepthTargetDescription description;
+	};
+
+	struct UpscalePass
+	{
+		ID3D11VertexShader* pVertexShader;				// Owned by the state cache
+		ID3D11PixelShader* pPixelShader;
+		PipelineStateEntry states;
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> pSampler;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> pConstantBuffer;
+	};
+
+	struct CB_Upscale
+	{
+		float uvScale[2];
+		float maxUv[2];
+	};
+
+	struct TimestampQuery
+	{
+		Microsoft::WRL::ComPtr<ID3D11Query> pDisjoint;
+		Microsoft::WRL::ComPtr<ID3D11Query> pStart;
+		Microsoft::WRL::ComPtr<ID3D11Query> pEnd;
+	};
+
+	static constexpr uint32_t g_MaxObjects{ 4096 };		// Per kind of object
+	static constexpr uint32_t g_MaxRecorders{ 8 };
+	static constexpr uint32_t g_TimestampLatency{ 4 };	// Frames the GPU may run behind before a query is skipped
+	static constexpr uint32_t g_RetireLatency{ 3 };		// DXGI's default frame latency, destroyed objects are released that much later
+
+	// Member variables
+	HWND m_WindowHandle;
+
+	Microsoft::WRL::ComPtr<ID3D11Device> m_pDevice;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_pDeviceContext;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> m_pDeviceContext1;	// Only set when constant buffer offsetting is supported
+	Microsoft::WRL::ComPtr<IDXGISwapChain> m_pSwapChain;
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> m_pRenderTargetView;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> m_pDepthStencil;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> m_pDepthStencilView;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> m_pBackBuffer;
+	D3D11_TEXTURE2D_DESC m_BackBufferDescription;
+
+	// BackBuffer sized, the frame only uses the top left render resolution
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> m_pSceneTarget;
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> m_pSceneTargetView;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_pSceneShaderView;
+	uint32_t m_RenderWidth;
+	uint32_t m_RenderHeight;
+	UpscalePass m_UpscalePass;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> m_pShadowSampler;	// LESS_EQUAL comparison, always bound at s0
+
+	std::array<TimestampQuery, g_TimestampLatency> m_TimestampQueries;
+	uint32_t m_TimestampsIssued;		// Frames with queries, the ring slot is this modulo the latency
+	uint32_t m_TimestampsRead;
+	bool m_TimingFrame;					// Queries were begun for the current frame
+	float m_LastGpuMs;
+
+	D3D_FEATURE_LEVEL m_FeatureLevel;
+	Features m_Features;
+
+	std::unique_ptr<PipelineStateCache> m_pStateCache;
+	std::unique_ptr<FrameCapture> m_pFrameCapture;
+
+	std::unique_ptr<D3D11CommandContext> m_pImmediateContext;
+	std::vector<std::unique_ptr<D3D11CommandContext>> m_DeferredContexts;	// One per recording worker
+
+	DeviceObjectTable<BufferEntry> m_Buffers;
+	DeviceObjectTable<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> m_ShaderViews;
+	DeviceObjectTable<ID3D11VertexShader*> m_VertexShaders;		// Owned by the state cache
+	DeviceObjectTable<ID3D11PixelShader*> m_PixelShaders;
+	DeviceObjectTable<ID3D11InputLayout*> m_InputLayouts;
+	DeviceObjectTable<PipelineStateEntry> m_PipelineStates;
+	DeviceObjectTable<DepthTargetEntry> m_DepthTargets;
+
+	Statistics m_FrameStatistics;
+	Statistics m_LastFrameStatistics;
+	std::atomic<uint32_t> m_ResourceCreations;
+
+	// Member functions
+	bool CreateDevice();
+	bool CreateSwapChain();
+	bool CreateRenderTarget();
+	bool CreateDepthStencil();
+	bool CreateSceneTarget();
+	bool CreateUpscalePass(const utils::ResourceReader& readResource);
+	bool CreateShadowSampler();
+	void CreateTimestampQueries();
+	void CreateDeferredContexts();
+
+	void UpscaleSceneTarget();
+	void ReadTimestamps();
+	void RetireObjects();
+
+	void AddStatistics(const Statistics& statistics);
+	ID3D11Buffer* GetBuffer(BufferHandle buffer) const;
+	static DXGI_FORMAT ToDxgiFormat(ElementFormat format);
+};
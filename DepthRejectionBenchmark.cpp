@@ -0,0 +1,201 @@
+#include "DepthRejectionBenchmark.h"
+#include "Logger.h"
+#include "SoftwareRasterizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <vector>
+
+using namespace math;
+
+namespace
+{
+	constexpr uint32_t g_QuadCount{ 4096 };
+	constexpr uint32_t g_Width{ 512 };
+	constexpr uint32_t g_Height{ 512 };
+	constexpr uint32_t g_FrameCount{ 8 };
+	constexpr uint32_t g_ClearColor{ 0xFF000000 };
+
+	const wchar_t* const g_ModeNames[DepthRejectionBenchmark::g_ModeCount]{ L"plain", L"hierarchical depth", L"hierarchical depth and prepass" };
+
+	struct Quad
+	{
+		Float4 corners[4];				// Clip space, clockwise on screen
+		uint32_t color;
+		float depth;					// At the center, for sorting
+	};
+
+	// Screen aligned in x and y but sloped in depth, so the depth planes differ per pixel
+	// Every quad has its own depth layer and slopes less than the gap to the next one, intersecting quads would tie where they cross
+	// and a LESS_EQUAL prepass shades ties once per tied draw, like a GPU does
+	std::vector<Quad> CreateQuads()
+	{
+		constexpr float layerGap{ 0.8f / g_QuadCount };
+
+		std::mt19937 randomEngine{ 1337 };	// Fixed seed, same quads every run
+		std::uniform_real_distribution<float> center{ -1.f, 1.f };
+		std::uniform_real_distribution<float> halfSize{ 0.04f, 0.3f };
+		std::uniform_real_distribution<float> slope{ -0.4f * layerGap, 0.4f * layerGap };	// At most a quarter of the gap over the largest quad
+		std::uniform_int_distribution<uint32_t> color{ 0, 0x00FFFFFF };
+
+		std::vector<uint32_t> layers(g_QuadCount);
+		for (uint32_t layer{}; layer < g_QuadCount; ++layer) layers[layer] = layer;
+		std::shuffle(layers.begin(), layers.end(), randomEngine);
+
+		std::vector<Quad> quads(g_QuadCount);
+		for (uint32_t quadIndex{}; quadIndex < g_QuadCount; ++quadIndex)
+		{
+			Quad& quad = quads[quadIndex];
+
+			const float centerX{ center(randomEngine) };
+			const float centerY{ center(randomEngine) };
+			const float halfWidth{ halfSize(randomEngine) };
+			const float halfHeight{ halfSize(randomEngine) };
+			const float slopeX{ slope(randomEngine) };
+			const float slopeY{ slope(randomEngine) };
+			quad.depth = 0.1f + (layers[quadIndex] + 0.5f) * layerGap;
+			quad.color = 0xFF000000 | color(randomEngine);
+
+			const float offsetsX[4]{ -halfWidth, halfWidth, halfWidth, -halfWidth };
+			const float offsetsY[4]{ halfHeight, halfHeight, -halfHeight, -halfHeight };
+			for (uint32_t corner{}; corner < 4; ++corner)
+			{
+				quad.corners[corner] = Float4{ centerX + offsetsX[corner], centerY + offsetsY[corner], quad.depth + offsetsX[corner] * slopeX + offsetsY[corner] * slopeY, 1.f };
+			}
+		}
+		return quads;
+	}
+}
+
+DepthRejectionBenchmark::DepthRejectionBenchmark()
+	: m_Result{}
+{
+}
+
+bool DepthRejectionBenchmark::Run()
+{
+	m_Result = Result{};
+	m_Result.quadCount = g_QuadCount;
+	m_Result.width = g_Width;
+	m_Result.height = g_Height;
+
+	TimeOrder(true, m_Result.frontToBack);
+	TimeOrder(false, m_Result.backToFront);
+
+	return LogResults();
+}
+
+// Privates
+// --------
+void DepthRejectionBenchmark::TimeOrder(bool isFrontToBack, Pass* pPasses)
+{
+	using namespace std::chrono;
+
+	std::vector<Quad> quads{ CreateQuads() };
+	std::sort(quads.begin(), quads.end(), [isFrontToBack](const Quad& a, const Quad& b) { return isFrontToBack ? a.depth < b.depth : a.depth > b.depth; });
+
+	constexpr uint32_t indices[6]{ 0, 1, 2, 0, 2, 3 };
+	const auto drawQuads = [&](SoftwareRasterizer& rasterizer, SoftwareRasterizer::DrawState state)
+	{
+		for (const Quad& quad : quads)
+		{
+			state.color = quad.color;
+			rasterizer.DrawTriangles(quad.corners, indices, 6, state);
+		}
+	};
+
+	const SoftwareRasterizer::DrawState opaqueState{ true, true, true, false, true, 0, 0, 0.f };
+	const SoftwareRasterizer::DrawState depthOnlyState{ true, true, true, false, false, 0, 0, 0.f };
+	const SoftwareRasterizer::DrawState shadeState{ true, true, false, true, true, 0, 0, 0.f };
+
+	std::vector<uint32_t> plainColor;
+	std::vector<float> plainDepth;
+	for (uint32_t mode{}; mode < g_ModeCount; ++mode)
+	{
+		SoftwareRasterizer rasterizer{};
+		rasterizer.Resize(g_Width, g_Height);
+		rasterizer.SetHierarchicalDepth(mode != 0);
+
+		// The same frame drawn a few times, the statistics are the last one's
+		const steady_clock::time_point start{ steady_clock::now() };
+		for (uint32_t frame{}; frame < g_FrameCount; ++frame)
+		{
+			rasterizer.Clear(g_ClearColor, 1.f, g_Width, g_Height);
+			rasterizer.ResetStatistics();
+
+			if (mode == 2)
+			{
+				drawQuads(rasterizer, depthOnlyState);
+				const uint64_t prepassPixels{ rasterizer.GetStatistics().shadedPixels };
+				drawQuads(rasterizer, shadeState);
+				pPasses[mode].shadedPixels = rasterizer.GetStatistics().shadedPixels - prepassPixels;
+			}
+			else
+			{
+				drawQuads(rasterizer, opaqueState);
+				pPasses[mode].shadedPixels = rasterizer.GetStatistics().shadedPixels;
+			}
+		}
+
+		Pass& pass = pPasses[mode];
+		pass.frameMs = duration<double, std::milli>(steady_clock::now() - start).count() / g_FrameCount;
+
+		const SoftwareRasterizer::Statistics& statistics = rasterizer.GetStatistics();
+		pass.coveredPixels = statistics.coveredPixels;
+		pass.rejectedTriangles = statistics.rejectedTriangles;
+		pass.rejectedBlocks = statistics.rejectedBlocks;
+		pass.acceptedBlocks = statistics.acceptedBlocks;
+
+		const size_t pixelCount{ static_cast<size_t>(g_Width) * g_Height };
+		if (mode == 0)
+		{
+			plainColor.assign(rasterizer.GetColor(), rasterizer.GetColor() + pixelCount);
+			plainDepth.assign(rasterizer.GetDepth(), rasterizer.GetDepth() + pixelCount);
+			m_Result.visiblePixels = std::count_if(plainDepth.begin(), plainDepth.end(), [](float depth) { return depth < 1.f; });
+			continue;
+		}
+
+		for (size_t pixel{}; pixel < pixelCount; ++pixel)
+		{
+			if (rasterizer.GetColor()[pixel] != plainColor[pixel] || rasterizer.GetDepth()[pixel] != plainDepth[pixel]) ++pass.mismatchedPixels;
+		}
+	}
+}
+bool DepthRejectionBenchmark::LogResults() const
+{
+	const Result& result = m_Result;
+
+	std::wstringstream message;
+	message << L"Depth rejection benchmark: " << result.quadCount << L" quads at " << result.width << L"x" << result.height << L", "
+		<< result.visiblePixels << L" visible pixels";
+	Logger::Log(message.str());
+
+	bool isMatching{ true };
+	bool isShadedOnce{ true };
+	for (const bool isFrontToBack : { true, false })
+	{
+		const Pass* pPasses{ isFrontToBack ? result.frontToBack : result.backToFront };
+		for (uint32_t mode{}; mode < g_ModeCount; ++mode)
+		{
+			const Pass& pass = pPasses[mode];
+
+			message.str(L"");
+			message << L"Depth rejection benchmark: " << (isFrontToBack ? L"front to back, " : L"back to front, ") << g_ModeNames[mode] << L": "
+				<< pass.frameMs << L" ms, " << pass.coveredPixels << L" pixels covered, " << pass.shadedPixels << L" shaded, "
+				<< pass.rejectedTriangles << L" triangles and " << pass.rejectedBlocks << L" blocks rejected, " << pass.acceptedBlocks << L" accepted, "
+				<< pass.mismatchedPixels << L" pixels differing";
+			Logger::Log(message.str());
+
+			isMatching = isMatching && pass.mismatchedPixels == 0;
+		}
+
+		// Every visible pixel shaded once after the prepass, the quads never tie
+		isShadedOnce = isShadedOnce && pPasses[g_ModeCount - 1].shadedPixels == result.visiblePixels;
+	}
+
+	if (!isMatching) Logger::Log(L"ERROR - Depth rejection benchmark: depth rejection changed the image");
+	if (!isShadedOnce) Logger::Log(L"ERROR - Depth rejection benchmark: the prepass didn't shade every visible pixel exactly once");
+	return isMatching && isShadedOnce;
+}
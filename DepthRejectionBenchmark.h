@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+// Times drawing overlapping quads front to back and back to front through the software rasterizer, plain, with the depth hierarchy and with a depth prepass
+// Logs the covered and shaded pixels of each, other colors or depths than the plain pass or a visible pixel the prepass doesn't shade exactly once is logged as an error
+class DepthRejectionBenchmark final
+{
+public:
+	// Structs
+	struct Pass
+	{
+		double frameMs;
+		uint64_t coveredPixels;				// Per frame, prepass included
+		uint64_t shadedPixels;				// Per frame, colored
+		uint64_t rejectedTriangles;
+		uint64_t rejectedBlocks;
+		uint64_t acceptedBlocks;
+		uint32_t mismatchedPixels;			// Color or depth differing from the pass without rejection
+	};
+
+	static constexpr uint32_t g_ModeCount{ 3 };		// Plain, hierarchical depth, hierarchical depth and prepass
+
+	struct Result
+	{
+		uint32_t quadCount;
+		uint32_t width;
+		uint32_t height;
+		uint64_t visiblePixels;				// Covered by any quad
+		Pass frontToBack[g_ModeCount];
+		Pass backToFront[g_ModeCount];
+	};
+
+	// Rule of five
+	DepthRejectionBenchmark();
+	~DepthRejectionBenchmark() = default;
+
+	DepthRejectionBenchmark(const DepthRejectionBenchmark& other) = delete;
+	DepthRejectionBenchmark(DepthRejectionBenchmark&& other) = delete;
+	DepthRejectionBenchmark& operator= (const DepthRejectionBenchmark& other) = delete;
+	DepthRejectionBenchmark& operator= (DepthRejectionBenchmark&& other) = delete;
+
+	// Publics
+	bool Run();	// False when a check failed, the failures are logged as errors
+
+	const Result& GetResult() const { return m_Result; }
+
+private:
+	// Member variables
+	Result m_Result;
+
+	// Member functions
+	void TimeOrder(bool isFrontToBack, Pass* pPasses);
+	bool LogResults() const;
+};
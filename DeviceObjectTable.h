@@ -0,0 +1,139 @@
+#pragma once
+
+#include "RenderDevice.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Fixed capacity pool behind one kind of device handle, the objects stay in one array and freed slots are handed out again
+// Slots never move, so the render thread reads them without locking while loading tasks add new ones
+// Remove makes the id stale at once, but the object is only destroyed once the frames that may still use it have retired
+template <typename T>
+class DeviceObjectTable final
+{
+public:
+	// Rule of five
+	explicit DeviceObjectTable(uint32_t capacity)
+		: m_Mutex{}
+		, m_Objects((std::min)(capacity, handles::g_MaxSlots))
+		, m_LiveIds(m_Objects.size())
+		, m_Generations(m_Objects.size(), 0)
+		, m_FreeSlots{}
+		, m_Retired{}
+		, m_UsedSlots{ 0 }
+		, m_Count{ 0 }
+		, m_Frame{}
+	{
+	}
+	~DeviceObjectTable() = default;
+
+	DeviceObjectTable(const DeviceObjectTable& other) = delete;
+	DeviceObjectTable(DeviceObjectTable&& other) = delete;
+	DeviceObjectTable& operator= (const DeviceObjectTable& other) = delete;
+	DeviceObjectTable& operator= (DeviceObjectTable&& other) = delete;
+
+	// Publics
+	uint32_t Add(T&& object)	// 0 when the table is full
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+
+		// Last freed slot first, it is the most likely to still be cached
+		uint32_t index{};
+		if (!m_FreeSlots.empty())
+		{
+			index = m_FreeSlots.back();
+			m_FreeSlots.pop_back();
+		}
+		else
+		{
+			index = m_UsedSlots.load(std::memory_order_relaxed);
+			if (index == m_Objects.size()) return 0;
+			m_UsedSlots.store(index + 1, std::memory_order_release);
+		}
+
+		// Generation 0 is skipped, so no id is ever 0
+		uint32_t& generation = m_Generations[index];
+		generation = generation == handles::g_MaxGeneration ? 1 : generation + 1;
+
+		const uint32_t id{ handles::MakeId(index, generation) };
+		m_Objects[index] = std::move(object);
+		m_LiveIds[index].store(id, std::memory_order_release);
+		m_Count.fetch_add(1, std::memory_order_relaxed);
+		return id;
+	}
+	T* Get(uint32_t id)			// nullptr for ids that were never handed out or were removed
+	{
+		const uint32_t index{ handles::GetIndex(id) };
+		if (id == 0 || index >= m_LiveIds.size() || m_LiveIds[index].load(std::memory_order_acquire) != id) return nullptr;
+		return &m_Objects[index];
+	}
+	const T* Get(uint32_t id) const
+	{
+		return const_cast<DeviceObjectTable*>(this)->Get(id);
+	}
+	bool IsStale(uint32_t id) const	// Its slot was handed out, but the id was removed since; ids that old can come back after a generation wraps
+	{
+		const uint32_t index{ handles::GetIndex(id) };
+		if (id == 0 || handles::GetGeneration(id) == 0 || index >= m_UsedSlots.load(std::memory_order_acquire)) return false;
+		return m_LiveIds[index].load(std::memory_order_acquire) != id;
+	}
+	void Remove(uint32_t id)	// Render thread only, the object lives on until RetireFrame lets it go
+	{
+		if (!Get(id)) return;
+
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+
+		const uint32_t index{ handles::GetIndex(id) };
+		m_LiveIds[index].store(0, std::memory_order_release);
+		m_Retired.push_back(RetiredSlot{ index, m_Frame });
+		m_Count.fetch_sub(1, std::memory_order_relaxed);
+	}
+	void RetireFrame(uint32_t framesInFlight)	// Once per frame, destroys what was removed framesInFlight frames ago and frees the slots
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+
+		// Removed in frame order, the ones old enough are always at the front
+		while (!m_Retired.empty() && m_Retired.front().frame + framesInFlight <= m_Frame)
+		{
+			const uint32_t index{ m_Retired.front().index };
+			m_Objects[index] = T{};
+			m_FreeSlots.push_back(index);
+			m_Retired.pop_front();
+		}
+
+		++m_Frame;
+	}
+
+	uint32_t GetRetiredCount() const	// Removed, waiting for their frames to retire
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		return static_cast<uint32_t>(m_Retired.size());
+	}
+
+	uint32_t GetCount() const { return m_Count.load(std::memory_order_relaxed); }	// Live objects
+	uint32_t GetCapacity() const { return static_cast<uint32_t>(m_Objects.size()); }
+
+private:
+	// Structs
+	struct RetiredSlot
+	{
+		uint32_t index;
+		uint64_t frame;				// Removed during this frame
+	};
+
+	// Member variables
+	mutable std::mutex m_Mutex;		// Add, Remove and RetireFrame, never Get
+	std::vector<T> m_Objects;
+	std::vector<std::atomic<uint32_t>> m_LiveIds;	// Id of the object in the slot, 0 when there is none
+	std::vector<uint32_t> m_Generations;			// Last one handed out per slot
+	std::vector<uint32_t> m_FreeSlots;
+	std::deque<RetiredSlot> m_Retired;
+	std::atomic<uint32_t> m_UsedSlots;				// Slots handed out at least once, the rest were never touched
+	std::atomic<uint32_t> m_Count;
+	uint64_t m_Frame;
+};
@@ -2,6 +2,7 @@
 #include "Engine.h"
 
 #include "InputManager.h"
+#include "PerformanceCounters.h"
 #include "Renderer.h"
 
 #include <thread>
@@ -13,9 +14,30 @@ std::unique_ptr<Engine> g_pEngine;
 // -------------------
 #pragma region Windows
 
-int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE /*hPrevInstance*/, _In_ LPWSTR /*lpCmdLine*/, _In_ int nCmdShow)
+int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE /*hPrevInstance*/, _In_ LPWSTR lpCmdLine, _In_ int nCmdShow)
 {
-    g_pEngine = std::make_unique<Engine>(hInstance, nCmdShow);
+    // -nulldevice submits every frame to a backend that only validates and counts, to measure the CPU cost
+    const bool useNullDevice{ lpCmdLine && wcsstr(lpCmdLine, L"-nulldevice") };
+
+    // -softwaredevice rasterizes every frame on the CPU instead, no GPU needed
+    const bool useSoftwareDevice{ lpCmdLine && wcsstr(lpCmdLine, L"-softwaredevice") };
+    const RenderDeviceType deviceType{ useNullDevice ? RenderDeviceType::Null : useSoftwareDevice ? RenderDeviceType::Software : RenderDeviceType::D3D11 };
+
+    // -counters=<file> or -counterport=<udp port> dumps the performance counters every second, for external monitoring
+    const wchar_t* pCounterFile{ lpCmdLine ? wcsstr(lpCmdLine, L"-counters=") : nullptr };
+    const wchar_t* pCounterPort{ lpCmdLine ? wcsstr(lpCmdLine, L"-counterport=") : nullptr };
+    if (pCounterFile)
+    {
+        const std::wstring arguments{ pCounterFile + wcslen(L"-counters=") };
+        PerformanceCounters::GetInstance()->StartFileDump(arguments.substr(0, arguments.find(L' ')));
+    }
+    else if (pCounterPort)
+    {
+        const unsigned long port{ wcstoul(pCounterPort + wcslen(L"-counterport="), nullptr, 10) };
+        if (port > 0 && port <= 0xFFFF) PerformanceCounters::GetInstance()->StartSocketDump(static_cast<uint16_t>(port));
+    }
+
+    g_pEngine = std::make_unique<Engine>(hInstance, nCmdShow, deviceType);
     return g_pEngine->Run();
 }
 LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
@@ -30,9 +52,10 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 // ------------------
 #pragma region Engine
 
-Engine::Engine(HINSTANCE hInstance, int nCmdShow)
+Engine::Engine(HINSTANCE hInstance, int nCmdShow, RenderDeviceType deviceType)
     : m_WindowInstance { hInstance }
     , m_InitialWindowMode{ nCmdShow }
+    , m_DeviceType{ deviceType }
 
     , m_AppName{ L"Graphics Engine" }
     , m_TitleName{ L"Graphics Engine" }
@@ -42,6 +65,7 @@ Engine::Engine(HINSTANCE hInstance, int nCmdShow)
 
     , m_pInputManager{}
     , m_pRenderer{}
+    , m_ResizeTracker{}
 {
     // Set FPS
     const float maxFPS{ 144.f };
@@ -108,7 +132,8 @@ int Engine::Run()
     m_pInputManager = InputManager::GetInstance();
 
     // Renderer
-    m_pRenderer = std::make_unique<Renderer>(hWnd);
+    m_pRenderer = std::make_unique<Renderer>(hWnd, m_DeviceType);
+    m_pRenderer->SetFrameTimeTarget(m_MsPerFrame);
     m_pRenderer->CreateDeviceDependentResources();      // Should be called on scene load
     m_pRenderer->CreateWindowSizeDependentResources();  // Should be called on windowSize change
 
@@ -151,6 +176,19 @@ LRESULT Engine::HandleEvent(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPara
     }
     break;
 
+    // Only recorded here, the game loop applies the last size once the messages are handled
+    case WM_SIZE:
+        m_ResizeTracker.OnSize(wParam == SIZE_MINIMIZED, LOWORD(lParam), HIWORD(lParam));
+        break;
+
+    case WM_ENTERSIZEMOVE:
+        m_ResizeTracker.OnEnterSizeMove();
+        break;
+
+    case WM_EXITSIZEMOVE:
+        m_ResizeTracker.OnExitSizeMove();
+        break;
+
     case WM_DESTROY:
         PostQuitMessage(0);
         break;
@@ -179,9 +217,14 @@ bool Engine::GameLoop()
 
     // Update
 
-    // Render
+    // Resize, at most once per frame
+    uint32_t width{};
+    uint32_t height{};
+    if (m_ResizeTracker.TakePendingResize(width, height)) m_pRenderer->Resize(width, height);
+
+    // Render, nothing to present to while minimized
     m_pRenderer->Temp_Update(deltaTime);
-    m_pRenderer->Render();
+    if (m_ResizeTracker.ShouldRender()) m_pRenderer->Render();
 
     // Sleep
     const auto sleepTime{ currentTime + milliseconds(static_cast<long long>(m_MsPerFrame)) - high_resolution_clock::now() };
@@ -1,5 +1,7 @@
 #pragma once
 #include "resource.h"
+#include "RenderDevice.h"
+#include "ResizeTracker.h"
 
 #include <memory>
 #include <string>
@@ -12,7 +14,7 @@ class Engine final
 {
 public:
 	// Rule of five
-	Engine(HINSTANCE hInstance, int nCmdShow);
+	Engine(HINSTANCE hInstance, int nCmdShow, RenderDeviceType deviceType);
 	~Engine() = default;
 
 	Engine(const Engine& other) = delete;
@@ -28,6 +30,7 @@ private:
 	// Member variables
 	HINSTANCE m_WindowInstance;
 	int m_InitialWindowMode;
+	RenderDeviceType m_DeviceType;
 
 	std::wstring m_AppName;
 	std::wstring m_TitleName;
@@ -38,6 +41,7 @@ private:
 
 	InputManager* m_pInputManager;
 	std::unique_ptr<Renderer> m_pRenderer;
+	ResizeTracker m_ResizeTracker;
 
 	// Member functions
 	bool GameLoop();
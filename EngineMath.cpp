@@ -0,0 +1,319 @@
+#include "EngineMath.h"
+
+#if defined(MATH_SSE)
+	#define MATH_AVX2_KERNELS
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#endif
+#endif
+
+// AVX2 kernels are compiled regardless of the /arch flags and only called when the CPU has AVX2 and FMA
+#if defined(MATH_AVX2_KERNELS) && (defined(__GNUC__) || defined(__clang__))
+	#define MATH_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+	#define MATH_TARGET_AVX2
+#endif
+
+namespace math
+{
+	Float4x4 Float4x4Inverse(const Float4x4& a, float* pDeterminant)
+	{
+		// Cofactor expansion, works for both row and column major storage
+		const float* m{ &a.m[0][0] };
+		float inverse[16]{};
+
+		inverse[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+		inverse[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+		inverse[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+		inverse[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+		inverse[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+		inverse[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+		inverse[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+		inverse[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+		inverse[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+		inverse[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+		inverse[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+		inverse[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+		inverse[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+		inverse[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+		inverse[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+		inverse[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+		const float determinant{ m[0] * inverse[0] + m[1] * inverse[4] + m[2] * inverse[8] + m[3] * inverse[12] };
+		if (pDeterminant) *pDeterminant = determinant;
+
+		// Singular, nothing sensible to return
+		Float4x4 result{};
+		if (determinant == 0.f) return result;
+
+		const float inverseDeterminant{ 1.f / determinant };
+		for (int index{}; index < 16; ++index) result.m[index / 4][index % 4] = inverse[index] * inverseDeterminant;
+
+		return result;
+	}
+}
+
+namespace
+{
+	using namespace math;
+
+	// ----------------------------------
+	// Compile time backend, 4 lanes wide
+	// ----------------------------------
+
+	void Vector3TransformCoordStreamDefault(Float3* pOutput, const Float3* pInput, size_t count, const Matrix& m)
+	{
+		for (size_t index{}; index < count; ++index)
+		{
+			StoreFloat3(&pOutput[index], Vector3TransformCoord(LoadFloat3(&pInput[index]), m));
+		}
+	}
+	void Vector4TransformStreamDefault(Float4* pOutput, const Float4* pInput, size_t count, const Matrix& m)
+	{
+		for (size_t index{}; index < count; ++index)
+		{
+			StoreFloat4(&pOutput[index], Vector4Transform(LoadFloat4(&pInput[index]), m));
+		}
+	}
+	void Vector3TransformCoordSoADefault(float* pOutputX, float* pOutputY, float* pOutputZ,
+		const float* pInputX, const float* pInputY, const float* pInputZ, size_t count, const Float4x4& m)
+	{
+		size_t index{};
+
+		// Every lane is a different point, every register one component
+		for (; index + 4 <= count; index += 4)
+		{
+			const Vector x{ VectorLoad(pInputX + index) };
+			const Vector y{ VectorLoad(pInputY + index) };
+			const Vector z{ VectorLoad(pInputZ + index) };
+
+			Vector column[4]{};
+			for (int component{}; component < 4; ++component)
+			{
+				column[component] = VectorMultiplyAdd(x, VectorReplicate(m.m[0][component]),
+					VectorMultiplyAdd(y, VectorReplicate(m.m[1][component]),
+					VectorMultiplyAdd(z, VectorReplicate(m.m[2][component]), VectorReplicate(m.m[3][component]))));
+			}
+
+			VectorStore(pOutputX + index, VectorDivide(column[0], column[3]));
+			VectorStore(pOutputY + index, VectorDivide(column[1], column[3]));
+			VectorStore(pOutputZ + index, VectorDivide(column[2], column[3]));
+		}
+
+		for (; index < count; ++index)
+		{
+			const Float3 point{ Float3TransformCoord(Float3{ pInputX[index], pInputY[index], pInputZ[index] }, m) };
+			pOutputX[index] = point.x;
+			pOutputY[index] = point.y;
+			pOutputZ[index] = point.z;
+		}
+	}
+	void MatrixMultiplyStreamDefault(Float4x4* pOutput, const Float4x4* pInput, size_t count, const Matrix& m)
+	{
+		for (size_t index{}; index < count; ++index)
+		{
+			StoreFloat4x4(&pOutput[index], MatrixMultiply(LoadFloat4x4(&pInput[index]), m));
+		}
+	}
+
+#if defined(MATH_AVX2_KERNELS)
+	// ------------------------------------------
+	// AVX2, two vectors or 8 SoA lanes at a time
+	// ------------------------------------------
+
+	MATH_TARGET_AVX2 __m256 LoadFloat3Pair(const Float3* pSource)
+	{
+		const __m128 first{ _mm_movelh_ps(_mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(pSource))), _mm_load_ss(&pSource[0].z)) };
+		const __m128 second{ _mm_movelh_ps(_mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(pSource + 1))), _mm_load_ss(&pSource[1].z)) };
+		return _mm256_insertf128_ps(_mm256_castps128_ps256(first), second, 1);
+	}
+	MATH_TARGET_AVX2 void StoreFloat3Pair(Float3* pDestination, __m256 pair)
+	{
+		const __m128 first{ _mm256_castps256_ps128(pair) };
+		const __m128 second{ _mm256_extractf128_ps(pair, 1) };
+
+		_mm_store_sd(reinterpret_cast<double*>(pDestination), _mm_castps_pd(first));
+		_mm_store_ss(&pDestination[0].z, _mm_movehl_ps(first, first));
+		_mm_store_sd(reinterpret_cast<double*>(pDestination + 1), _mm_castps_pd(second));
+		_mm_store_ss(&pDestination[1].z, _mm_movehl_ps(second, second));
+	}
+	MATH_TARGET_AVX2 __m256 TransformPair(__m256 pair, const __m256 rows[4], bool includeW)
+	{
+		// Splat within each 128-bit half, so both vectors go through the same rows
+		__m256 result{ includeW ? _mm256_fmadd_ps(_mm256_permute_ps(pair, 0xFF), rows[3], _mm256_mul_ps(_mm256_permute_ps(pair, 0xAA), rows[2]))
+			: _mm256_fmadd_ps(_mm256_permute_ps(pair, 0xAA), rows[2], rows[3]) };
+		result = _mm256_fmadd_ps(_mm256_permute_ps(pair, 0x55), rows[1], result);
+		return _mm256_fmadd_ps(_mm256_permute_ps(pair, 0x00), rows[0], result);
+	}
+
+	MATH_TARGET_AVX2 void Vector3TransformCoordStreamAvx2(Float3* pOutput, const Float3* pInput, size_t count, const Matrix& m)
+	{
+		const __m256 rows[4]{ _mm256_broadcast_ps(&m.r[0]), _mm256_broadcast_ps(&m.r[1]), _mm256_broadcast_ps(&m.r[2]), _mm256_broadcast_ps(&m.r[3]) };
+
+		size_t index{};
+		for (; index + 2 <= count; index += 2)
+		{
+			const __m256 result{ TransformPair(LoadFloat3Pair(pInput + index), rows, false) };
+			StoreFloat3Pair(pOutput + index, _mm256_div_ps(result, _mm256_permute_ps(result, 0xFF)));
+		}
+
+		if (index < count) Vector3TransformCoordStreamDefault(pOutput + index, pInput + index, count - index, m);
+	}
+	MATH_TARGET_AVX2 void Vector4TransformStreamAvx2(Float4* pOutput, const Float4* pInput, size_t count, const Matrix& m)
+	{
+		const __m256 rows[4]{ _mm256_broadcast_ps(&m.r[0]), _mm256_broadcast_ps(&m.r[1]), _mm256_broadcast_ps(&m.r[2]), _mm256_broadcast_ps(&m.r[3]) };
+
+		size_t index{};
+		for (; index + 2 <= count; index += 2)
+		{
+			const __m256 pair{ _mm256_loadu_ps(&pInput[index].x) };
+			_mm256_storeu_ps(&pOutput[index].x, TransformPair(pair, rows, true));
+		}
+
+		if (index < count) Vector4TransformStreamDefault(pOutput + index, pInput + index, count - index, m);
+	}
+	MATH_TARGET_AVX2 void Vector3TransformCoordSoAAvx2(float* pOutputX, float* pOutputY, float* pOutputZ,
+		const float* pInputX, const float* pInputY, const float* pInputZ, size_t count, const Float4x4& m)
+	{
+		size_t index{};
+		for (; index + 8 <= count; index += 8)
+		{
+			const __m256 x{ _mm256_loadu_ps(pInputX + index) };
+			const __m256 y{ _mm256_loadu_ps(pInputY + index) };
+			const __m256 z{ _mm256_loadu_ps(pInputZ + index) };
+
+			__m256 column[4]{};
+			for (int component{}; component < 4; ++component)
+			{
+				column[component] = _mm256_fmadd_ps(x, _mm256_set1_ps(m.m[0][component]),
+					_mm256_fmadd_ps(y, _mm256_set1_ps(m.m[1][component]),
+					_mm256_fmadd_ps(z, _mm256_set1_ps(m.m[2][component]), _mm256_set1_ps(m.m[3][component]))));
+			}
+
+			_mm256_storeu_ps(pOutputX + index, _mm256_div_ps(column[0], column[3]));
+			_mm256_storeu_ps(pOutputY + index, _mm256_div_ps(column[1], column[3]));
+			_mm256_storeu_ps(pOutputZ + index, _mm256_div_ps(column[2], column[3]));
+		}
+
+		if (index < count)
+		{
+			Vector3TransformCoordSoADefault(pOutputX + index, pOutputY + index, pOutputZ + index,
+				pInputX + index, pInputY + index, pInputZ + index, count - index, m);
+		}
+	}
+	MATH_TARGET_AVX2 void MatrixMultiplyStreamAvx2(Float4x4* pOutput, const Float4x4* pInput, size_t count, const Matrix& m)
+	{
+		const __m256 rows[4]{ _mm256_broadcast_ps(&m.r[0]), _mm256_broadcast_ps(&m.r[1]), _mm256_broadcast_ps(&m.r[2]), _mm256_broadcast_ps(&m.r[3]) };
+
+		// Two rows of the input per register
+		for (size_t index{}; index < count; ++index)
+		{
+			const __m256 rows01{ _mm256_loadu_ps(pInput[index].m[0]) };
+			const __m256 rows23{ _mm256_loadu_ps(pInput[index].m[2]) };
+
+			_mm256_storeu_ps(pOutput[index].m[0], TransformPair(rows01, rows, true));
+			_mm256_storeu_ps(pOutput[index].m[2], TransformPair(rows23, rows, true));
+		}
+	}
+
+	bool CpuSupportsAvx2()
+	{
+	#if defined(_MSC_VER)
+		int info[4]{};
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+
+		// AVX and FMA, and the OS saving the upper halves of the registers
+		__cpuid(info, 1);
+		const bool hasFma{ (info[2] & (1 << 12)) != 0 };
+		const bool hasOsSave{ (info[2] & (1 << 27)) != 0 };
+		const bool hasAvx{ (info[2] & (1 << 28)) != 0 };
+		if (!hasFma || !hasOsSave || !hasAvx || (_xgetbv(0) & 0x6) != 0x6) return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+	#else
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	#endif
+	}
+#endif
+
+	// --------
+	// Dispatch
+	// --------
+
+	struct BatchKernels
+	{
+		SimdLevel level;
+		void (*pVector3TransformCoordStream)(Float3*, const Float3*, size_t, const Matrix&);
+		void (*pVector4TransformStream)(Float4*, const Float4*, size_t, const Matrix&);
+		void (*pVector3TransformCoordSoA)(float*, float*, float*, const float*, const float*, const float*, size_t, const Float4x4&);
+		void (*pMatrixMultiplyStream)(Float4x4*, const Float4x4*, size_t, const Matrix&);
+	};
+
+	BatchKernels SelectKernels()
+	{
+#if defined(MATH_AVX2_KERNELS)
+		if (CpuSupportsAvx2())
+		{
+			return BatchKernels{ SimdLevel::Avx2, Vector3TransformCoordStreamAvx2, Vector4TransformStreamAvx2, Vector3TransformCoordSoAAvx2, MatrixMultiplyStreamAvx2 };
+		}
+#endif
+
+#if defined(MATH_SSE4)
+		const SimdLevel level{ SimdLevel::Sse4 };
+#elif defined(MATH_SSE)
+		const SimdLevel level{ SimdLevel::Sse2 };
+#elif defined(MATH_NEON)
+		const SimdLevel level{ SimdLevel::Neon };
+#else
+		const SimdLevel level{ SimdLevel::Scalar };
+#endif
+
+		return BatchKernels{ level, Vector3TransformCoordStreamDefault, Vector4TransformStreamDefault, Vector3TransformCoordSoADefault, MatrixMultiplyStreamDefault };
+	}
+	const BatchKernels& GetKernels()
+	{
+		static const BatchKernels kernels{ SelectKernels() };
+		return kernels;
+	}
+}
+
+namespace math
+{
+	SimdLevel GetBatchSimdLevel()
+	{
+		return GetKernels().level;
+	}
+	const char* GetSimdLevelName(SimdLevel level)
+	{
+		switch (level)
+		{
+		case SimdLevel::Scalar:	return "Scalar";
+		case SimdLevel::Sse2:	return "SSE2";
+		case SimdLevel::Sse4:	return "SSE4.1";
+		case SimdLevel::Avx2:	return "AVX2";
+		case SimdLevel::Neon:	return "NEON";
+		}
+		return "Unknown";
+	}
+
+	void Vector3TransformCoordStream(Float3* pOutput, const Float3* pInput, size_t count, const Matrix& m)
+	{
+		GetKernels().pVector3TransformCoordStream(pOutput, pInput, count, m);
+	}
+	void Vector4TransformStream(Float4* pOutput, const Float4* pInput, size_t count, const Matrix& m)
+	{
+		GetKernels().pVector4TransformStream(pOutput, pInput, count, m);
+	}
+	void Vector3TransformCoordSoA(float* pOutputX, float* pOutputY, float* pOutputZ,
+		const float* pInputX, const float* pInputY, const float* pInputZ, size_t count, const Float4x4& m)
+	{
+		GetKernels().pVector3TransformCoordSoA(pOutputX, pOutputY, pOutputZ, pInputX, pInputY, pInputZ, count, m);
+	}
+	void MatrixMultiplyStream(Float4x4* pOutput, const Float4x4* pInput, size_t count, const Matrix& m)
+	{
+		GetKernels().pMatrixMultiplyStream(pOutput, pInput, count, m);
+	}
+}
@@ -0,0 +1,1048 @@
+#pragma once
+
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Engine math, row vectors and left handed like the rest of the renderer
+// Storage types (Float3, Float4x4...) are plain floats for constant buffers and files,
+// Vector and Matrix live in registers and are only used for computing
+//
+// The backend is picked at compile time:
+//	SSE2, with SSE4.1/FMA instructions when the compiler targets them (/arch:AVX2, -msse4.1, -mfma)
+//	NEON on AArch64
+//	Scalar everywhere else, or when MATH_NO_SIMD is defined
+// Batch functions additionally pick AVX2 at run time, see EngineMath.cpp
+
+#if !defined(MATH_NO_SIMD) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__))
+	#define MATH_SSE
+	#include <emmintrin.h>
+	#if defined(__SSE4_1__) || defined(__AVX__)
+		#define MATH_SSE4
+		#include <smmintrin.h>
+	#endif
+	#if defined(__FMA__) || defined(__AVX2__)
+		#define MATH_FMA
+		#include <immintrin.h>
+	#endif
+#elif !defined(MATH_NO_SIMD) && (defined(__aarch64__) || defined(_M_ARM64))
+	#define MATH_NEON
+	#include <arm_neon.h>
+#else
+	#define MATH_SCALAR
+#endif
+
+// Registers are passed in registers where the ABI allows it
+#if defined(_MSC_VER) && !defined(__clang__) && (defined(_M_X64) || defined(_M_IX86))
+	#define MATH_CALLCONV __vectorcall
+#else
+	#define MATH_CALLCONV
+#endif
+
+// The scalar backend has no intrinsics, so it can be evaluated at compile time
+#if defined(MATH_SCALAR)
+	#define MATH_CONSTEXPR constexpr
+#else
+	#define MATH_CONSTEXPR inline
+#endif
+
+namespace math
+{
+	// -------------
+	// Storage types
+	// -------------
+
+	struct Float2
+	{
+		float x;
+		float y;
+	};
+
+	struct Float3
+	{
+		float x;
+		float y;
+		float z;
+	};
+
+	struct Float4
+	{
+		float x;
+		float y;
+		float z;
+		float w;
+	};
+
+	struct UInt4
+	{
+		uint32_t x;
+		uint32_t y;
+		uint32_t z;
+		uint32_t w;
+	};
+
+	struct Float4x4
+	{
+		float m[4][4];		// [row][column]
+	};
+
+	static_assert(sizeof(Float3) == 12 && sizeof(Float4) == 16 && sizeof(Float4x4) == 64, "Storage types must stay tightly packed");
+
+	// ---------
+	// Constants
+	// ---------
+
+	constexpr float g_Pi{ 3.141592654f };
+	constexpr float g_2Pi{ 6.283185307f };
+	constexpr float g_1Div2Pi{ 0.159154943f };
+	constexpr float g_PiDiv2{ 1.570796327f };
+
+	constexpr float ConvertToRadians(float degrees) { return degrees * (g_Pi / 180.f); }
+	constexpr float ConvertToDegrees(float radians) { return radians * (180.f / g_Pi); }
+
+	// ------------------------------------------------
+	// Scalar fallbacks, usable in constant expressions
+	// ------------------------------------------------
+
+	constexpr Float3 Float3Add(const Float3& a, const Float3& b) { return Float3{ a.x + b.x, a.y + b.y, a.z + b.z }; }
+	constexpr Float3 Float3Subtract(const Float3& a, const Float3& b) { return Float3{ a.x - b.x, a.y - b.y, a.z - b.z }; }
+	constexpr Float3 Float3Scale(const Float3& a, float scale) { return Float3{ a.x * scale, a.y * scale, a.z * scale }; }
+	constexpr float Float3Dot(const Float3& a, const Float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	constexpr Float3 Float3Cross(const Float3& a, const Float3& b)
+	{
+		return Float3{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	constexpr Float4x4 Float4x4Identity()
+	{
+		return Float4x4{ { { 1.f, 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f, 0.f }, { 0.f, 0.f, 0.f, 1.f } } };
+	}
+	constexpr Float4x4 Float4x4Multiply(const Float4x4& a, const Float4x4& b)
+	{
+		Float4x4 result{};
+		for (int row{}; row < 4; ++row)
+		{
+			for (int column{}; column < 4; ++column)
+			{
+				result.m[row][column] = a.m[row][0] * b.m[0][column] + a.m[row][1] * b.m[1][column]
+					+ a.m[row][2] * b.m[2][column] + a.m[row][3] * b.m[3][column];
+			}
+		}
+		return result;
+	}
+	constexpr Float4x4 Float4x4Transpose(const Float4x4& a)
+	{
+		Float4x4 result{};
+		for (int row{}; row < 4; ++row)
+		{
+			for (int column{}; column < 4; ++column) result.m[row][column] = a.m[column][row];
+		}
+		return result;
+	}
+	constexpr Float3 Float3TransformCoord(const Float3& point, const Float4x4& a)
+	{
+		const float x{ point.x * a.m[0][0] + point.y * a.m[1][0] + point.z * a.m[2][0] + a.m[3][0] };
+		const float y{ point.x * a.m[0][1] + point.y * a.m[1][1] + point.z * a.m[2][1] + a.m[3][1] };
+		const float z{ point.x * a.m[0][2] + point.y * a.m[1][2] + point.z * a.m[2][2] + a.m[3][2] };
+		const float w{ point.x * a.m[0][3] + point.y * a.m[1][3] + point.z * a.m[2][3] + a.m[3][3] };
+		return Float3{ x / w, y / w, z / w };
+	}
+
+	Float4x4 Float4x4Inverse(const Float4x4& a, float* pDeterminant = nullptr);
+
+	// --------------
+	// Register types
+	// --------------
+
+#if defined(MATH_SSE)
+	using Vector = __m128;
+#elif defined(MATH_NEON)
+	using Vector = float32x4_t;
+#else
+	struct alignas(16) Vector
+	{
+		float f[4];
+	};
+#endif
+
+	struct Matrix
+	{
+		Vector r[4];		// Rows
+	};
+
+	// -----------------
+	// Vector - creation
+	// -----------------
+
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorSet(float x, float y, float z, float w)
+	{
+#if defined(MATH_SSE)
+		return _mm_setr_ps(x, y, z, w);
+#elif defined(MATH_NEON)
+		const float values[4]{ x, y, z, w };
+		return vld1q_f32(values);
+#else
+		return Vector{ { x, y, z, w } };
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorSetInt(uint32_t x, uint32_t y, uint32_t z, uint32_t w)
+	{
+#if defined(MATH_SSE)
+		return _mm_castsi128_ps(_mm_setr_epi32(static_cast<int>(x), static_cast<int>(y), static_cast<int>(z), static_cast<int>(w)));
+#elif defined(MATH_NEON)
+		const uint32_t values[4]{ x, y, z, w };
+		return vreinterpretq_f32_u32(vld1q_u32(values));
+#else
+		return Vector{ { std::bit_cast<float>(x), std::bit_cast<float>(y), std::bit_cast<float>(z), std::bit_cast<float>(w) } };
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorReplicate(float value)
+	{
+#if defined(MATH_SSE)
+		return _mm_set1_ps(value);
+#elif defined(MATH_NEON)
+		return vdupq_n_f32(value);
+#else
+		return Vector{ { value, value, value, value } };
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorReplicateInt(uint32_t value)
+	{
+#if defined(MATH_SSE)
+		return _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(value)));
+#elif defined(MATH_NEON)
+		return vreinterpretq_f32_u32(vdupq_n_u32(value));
+#else
+		const float bits{ std::bit_cast<float>(value) };
+		return Vector{ { bits, bits, bits, bits } };
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorZero()
+	{
+#if defined(MATH_SSE)
+		return _mm_setzero_ps();
+#else
+		return VectorReplicate(0.f);
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorTrueInt()
+	{
+		return VectorReplicateInt(0xFFFFFFFFu);
+	}
+
+	// ---------------
+	// Vector - access
+	// ---------------
+
+	MATH_CONSTEXPR float MATH_CALLCONV VectorGetX(Vector v)
+	{
+#if defined(MATH_SSE)
+		return _mm_cvtss_f32(v);
+#elif defined(MATH_NEON)
+		return vgetq_lane_f32(v, 0);
+#else
+		return v.f[0];
+#endif
+	}
+	MATH_CONSTEXPR float MATH_CALLCONV VectorGetY(Vector v)
+	{
+#if defined(MATH_SSE)
+		return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+#elif defined(MATH_NEON)
+		return vgetq_lane_f32(v, 1);
+#else
+		return v.f[1];
+#endif
+	}
+	MATH_CONSTEXPR float MATH_CALLCONV VectorGetZ(Vector v)
+	{
+#if defined(MATH_SSE)
+		return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)));
+#elif defined(MATH_NEON)
+		return vgetq_lane_f32(v, 2);
+#else
+		return v.f[2];
+#endif
+	}
+	MATH_CONSTEXPR float MATH_CALLCONV VectorGetW(Vector v)
+	{
+#if defined(MATH_SSE)
+		return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)));
+#elif defined(MATH_NEON)
+		return vgetq_lane_f32(v, 3);
+#else
+		return v.f[3];
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorSplatX(Vector v)
+	{
+#if defined(MATH_SSE)
+		return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0));
+#elif defined(MATH_NEON)
+		return vdupq_laneq_f32(v, 0);
+#else
+		return VectorReplicate(v.f[0]);
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorSplatY(Vector v)
+	{
+#if defined(MATH_SSE)
+		return _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+#elif defined(MATH_NEON)
+		return vdupq_laneq_f32(v, 1);
+#else
+		return VectorReplicate(v.f[1]);
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorSplatZ(Vector v)
+	{
+#if defined(MATH_SSE)
+		return _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+#elif defined(MATH_NEON)
+		return vdupq_laneq_f32(v, 2);
+#else
+		return VectorReplicate(v.f[2]);
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorSplatW(Vector v)
+	{
+#if defined(MATH_SSE)
+		return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+#elif defined(MATH_NEON)
+		return vdupq_laneq_f32(v, 3);
+#else
+		return VectorReplicate(v.f[3]);
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorSetW(Vector v, float w)
+	{
+#if defined(MATH_SSE4)
+		return _mm_insert_ps(v, _mm_set_ss(w), 0x30);
+#elif defined(MATH_SSE)
+		const __m128 zw{ _mm_unpacklo_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)), _mm_set_ss(w)) };	// z, w, z, 0
+		return _mm_shuffle_ps(v, zw, _MM_SHUFFLE(1, 0, 1, 0));											// x, y, z, w
+#elif defined(MATH_NEON)
+		return vsetq_lane_f32(w, v, 3);
+#else
+		return Vector{ { v.f[0], v.f[1], v.f[2], w } };
+#endif
+	}
+
+	// ---------------------
+	// Vector - load / store
+	// ---------------------
+
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorLoad(const float* pSource)	// 4 floats, no alignment needed
+	{
+#if defined(MATH_SSE)
+		return _mm_loadu_ps(pSource);
+#elif defined(MATH_NEON)
+		return vld1q_f32(pSource);
+#else
+		return Vector{ { pSource[0], pSource[1], pSource[2], pSource[3] } };
+#endif
+	}
+	MATH_CONSTEXPR void MATH_CALLCONV VectorStore(float* pDestination, Vector v)
+	{
+#if defined(MATH_SSE)
+		_mm_storeu_ps(pDestination, v);
+#elif defined(MATH_NEON)
+		vst1q_f32(pDestination, v);
+#else
+		for (int lane{}; lane < 4; ++lane) pDestination[lane] = v.f[lane];
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV LoadFloat4(const Float4* pSource)
+	{
+#if defined(MATH_SCALAR)
+		return Vector{ { pSource->x, pSource->y, pSource->z, pSource->w } };
+#else
+		return VectorLoad(reinterpret_cast<const float*>(pSource));
+#endif
+	}
+	MATH_CONSTEXPR void MATH_CALLCONV StoreFloat4(Float4* pDestination, Vector v)
+	{
+#if defined(MATH_SCALAR)
+		*pDestination = Float4{ v.f[0], v.f[1], v.f[2], v.f[3] };
+#else
+		VectorStore(reinterpret_cast<float*>(pDestination), v);
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV LoadFloat3(const Float3* pSource)	// w = 0
+	{
+#if defined(MATH_SSE)
+		const __m128 xy{ _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(pSource))) };
+		return _mm_movelh_ps(xy, _mm_load_ss(&pSource->z));
+#elif defined(MATH_NEON)
+		return vcombine_f32(vld1_f32(&pSource->x), vld1_lane_f32(&pSource->z, vdup_n_f32(0.f), 0));
+#else
+		return Vector{ { pSource->x, pSource->y, pSource->z, 0.f } };
+#endif
+	}
+	MATH_CONSTEXPR void MATH_CALLCONV StoreFloat3(Float3* pDestination, Vector v)
+	{
+#if defined(MATH_SSE)
+		_mm_store_sd(reinterpret_cast<double*>(pDestination), _mm_castps_pd(v));
+		_mm_store_ss(&pDestination->z, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)));
+#elif defined(MATH_NEON)
+		vst1_f32(&pDestination->x, vget_low_f32(v));
+		vst1q_lane_f32(&pDestination->z, v, 2);
+#else
+		pDestination->x = v.f[0];
+		pDestination->y = v.f[1];
+		pDestination->z = v.f[2];
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV LoadInt4(const uint32_t* pSource)
+	{
+#if defined(MATH_SSE)
+		return _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pSource)));
+#elif defined(MATH_NEON)
+		return vreinterpretq_f32_u32(vld1q_u32(pSource));
+#else
+		return VectorSetInt(pSource[0], pSource[1], pSource[2], pSource[3]);
+#endif
+	}
+	MATH_CONSTEXPR void MATH_CALLCONV StoreInt4(uint32_t* pDestination, Vector v)
+	{
+#if defined(MATH_SSE)
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pDestination), _mm_castps_si128(v));
+#elif defined(MATH_NEON)
+		vst1q_u32(pDestination, vreinterpretq_u32_f32(v));
+#else
+		for (int lane{}; lane < 4; ++lane) pDestination[lane] = std::bit_cast<uint32_t>(v.f[lane]);
+#endif
+	}
+
+	// -------------------
+	// Vector - arithmetic
+	// -------------------
+
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorAdd(Vector a, Vector b)
+	{
+#if defined(MATH_SSE)
+		return _mm_add_ps(a, b);
+#elif defined(MATH_NEON)
+		return vaddq_f32(a, b);
+#else
+		return Vector{ { a.f[0] + b.f[0], a.f[1] + b.f[1], a.f[2] + b.f[2], a.f[3] + b.f[3] } };
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorSubtract(Vector a, Vector b)
+	{
+#if defined(MATH_SSE)
+		return _mm_sub_ps(a, b);
+#elif defined(MATH_NEON)
+		return vsubq_f32(a, b);
+#else
+		return Vector{ { a.f[0] - b.f[0], a.f[1] - b.f[1], a.f[2] - b.f[2], a.f[3] - b.f[3] } };
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorMultiply(Vector a, Vector b)
+	{
+#if defined(MATH_SSE)
+		return _mm_mul_ps(a, b);
+#elif defined(MATH_NEON)
+		return vmulq_f32(a, b);
+#else
+		return Vector{ { a.f[0] * b.f[0], a.f[1] * b.f[1], a.f[2] * b.f[2], a.f[3] * b.f[3] } };
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorMultiplyAdd(Vector a, Vector b, Vector c)	// a * b + c
+	{
+#if defined(MATH_FMA)
+		return _mm_fmadd_ps(a, b, c);
+#elif defined(MATH_SSE)
+		return _mm_add_ps(_mm_mul_ps(a, b), c);
+#elif defined(MATH_NEON)
+		return vfmaq_f32(c, a, b);
+#else
+		return VectorAdd(VectorMultiply(a, b), c);
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorDivide(Vector a, Vector b)
+	{
+#if defined(MATH_SSE)
+		return _mm_div_ps(a, b);
+#elif defined(MATH_NEON)
+		return vdivq_f32(a, b);
+#else
+		return Vector{ { a.f[0] / b.f[0], a.f[1] / b.f[1], a.f[2] / b.f[2], a.f[3] / b.f[3] } };
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorScale(Vector v, float scale)
+	{
+		return VectorMultiply(v, VectorReplicate(scale));
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorNegate(Vector v)
+	{
+#if defined(MATH_SSE)
+		return _mm_xor_ps(v, _mm_set1_ps(-0.f));
+#elif defined(MATH_NEON)
+		return vnegq_f32(v);
+#else
+		return Vector{ { -v.f[0], -v.f[1], -v.f[2], -v.f[3] } };
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorAbs(Vector v)
+	{
+#if defined(MATH_SSE)
+		return _mm_andnot_ps(_mm_set1_ps(-0.f), v);
+#elif defined(MATH_NEON)
+		return vabsq_f32(v);
+#else
+		return Vector{ { v.f[0] < 0.f ? -v.f[0] : v.f[0], v.f[1] < 0.f ? -v.f[1] : v.f[1], v.f[2] < 0.f ? -v.f[2] : v.f[2], v.f[3] < 0.f ? -v.f[3] : v.f[3] } };
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorMin(Vector a, Vector b)
+	{
+#if defined(MATH_SSE)
+		return _mm_min_ps(a, b);
+#elif defined(MATH_NEON)
+		return vminq_f32(a, b);
+#else
+		return Vector{ { a.f[0] < b.f[0] ? a.f[0] : b.f[0], a.f[1] < b.f[1] ? a.f[1] : b.f[1], a.f[2] < b.f[2] ? a.f[2] : b.f[2], a.f[3] < b.f[3] ? a.f[3] : b.f[3] } };
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorMax(Vector a, Vector b)
+	{
+#if defined(MATH_SSE)
+		return _mm_max_ps(a, b);
+#elif defined(MATH_NEON)
+		return vmaxq_f32(a, b);
+#else
+		return Vector{ { a.f[0] > b.f[0] ? a.f[0] : b.f[0], a.f[1] > b.f[1] ? a.f[1] : b.f[1], a.f[2] > b.f[2] ? a.f[2] : b.f[2], a.f[3] > b.f[3] ? a.f[3] : b.f[3] } };
+#endif
+	}
+	inline Vector MATH_CALLCONV VectorSqrt(Vector v)
+	{
+#if defined(MATH_SSE)
+		return _mm_sqrt_ps(v);
+#elif defined(MATH_NEON)
+		return vsqrtq_f32(v);
+#else
+		return Vector{ { std::sqrt(v.f[0]), std::sqrt(v.f[1]), std::sqrt(v.f[2]), std::sqrt(v.f[3]) } };
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorLerp(Vector a, Vector b, float t)
+	{
+		return VectorMultiplyAdd(VectorSubtract(b, a), VectorReplicate(t), a);
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorLerpV(Vector a, Vector b, Vector t)
+	{
+		return VectorMultiplyAdd(VectorSubtract(b, a), t, a);
+	}
+
+	// -------------------------------
+	// Vector - comparisons and masks
+	// -------------------------------
+	// Comparisons return all bits set in the lanes where they hold
+
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorEqual(Vector a, Vector b)
+	{
+#if defined(MATH_SSE)
+		return _mm_cmpeq_ps(a, b);
+#elif defined(MATH_NEON)
+		return vreinterpretq_f32_u32(vceqq_f32(a, b));
+#else
+		return VectorSetInt(a.f[0] == b.f[0] ? ~0u : 0u, a.f[1] == b.f[1] ? ~0u : 0u, a.f[2] == b.f[2] ? ~0u : 0u, a.f[3] == b.f[3] ? ~0u : 0u);
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorLess(Vector a, Vector b)
+	{
+#if defined(MATH_SSE)
+		return _mm_cmplt_ps(a, b);
+#elif defined(MATH_NEON)
+		return vreinterpretq_f32_u32(vcltq_f32(a, b));
+#else
+		return VectorSetInt(a.f[0] < b.f[0] ? ~0u : 0u, a.f[1] < b.f[1] ? ~0u : 0u, a.f[2] < b.f[2] ? ~0u : 0u, a.f[3] < b.f[3] ? ~0u : 0u);
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorLessOrEqual(Vector a, Vector b)
+	{
+#if defined(MATH_SSE)
+		return _mm_cmple_ps(a, b);
+#elif defined(MATH_NEON)
+		return vreinterpretq_f32_u32(vcleq_f32(a, b));
+#else
+		return VectorSetInt(a.f[0] <= b.f[0] ? ~0u : 0u, a.f[1] <= b.f[1] ? ~0u : 0u, a.f[2] <= b.f[2] ? ~0u : 0u, a.f[3] <= b.f[3] ? ~0u : 0u);
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorGreater(Vector a, Vector b)
+	{
+		return VectorLess(b, a);
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorGreaterOrEqual(Vector a, Vector b)
+	{
+		return VectorLessOrEqual(b, a);
+	}
+
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorAndInt(Vector a, Vector b)
+	{
+#if defined(MATH_SSE)
+		return _mm_and_ps(a, b);
+#elif defined(MATH_NEON)
+		return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+#else
+		Vector result{};
+		for (int lane{}; lane < 4; ++lane) result.f[lane] = std::bit_cast<float>(std::bit_cast<uint32_t>(a.f[lane]) & std::bit_cast<uint32_t>(b.f[lane]));
+		return result;
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorAndCInt(Vector a, Vector b)	// a & ~b
+	{
+#if defined(MATH_SSE)
+		return _mm_andnot_ps(b, a);
+#elif defined(MATH_NEON)
+		return vreinterpretq_f32_u32(vbicq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+#else
+		Vector result{};
+		for (int lane{}; lane < 4; ++lane) result.f[lane] = std::bit_cast<float>(std::bit_cast<uint32_t>(a.f[lane]) & ~std::bit_cast<uint32_t>(b.f[lane]));
+		return result;
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorOrInt(Vector a, Vector b)
+	{
+#if defined(MATH_SSE)
+		return _mm_or_ps(a, b);
+#elif defined(MATH_NEON)
+		return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+#else
+		Vector result{};
+		for (int lane{}; lane < 4; ++lane) result.f[lane] = std::bit_cast<float>(std::bit_cast<uint32_t>(a.f[lane]) | std::bit_cast<uint32_t>(b.f[lane]));
+		return result;
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorXorInt(Vector a, Vector b)
+	{
+#if defined(MATH_SSE)
+		return _mm_xor_ps(a, b);
+#elif defined(MATH_NEON)
+		return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+#else
+		Vector result{};
+		for (int lane{}; lane < 4; ++lane) result.f[lane] = std::bit_cast<float>(std::bit_cast<uint32_t>(a.f[lane]) ^ std::bit_cast<uint32_t>(b.f[lane]));
+		return result;
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV VectorSelect(Vector a, Vector b, Vector mask)	// mask ? b : a, per bit
+	{
+#if defined(MATH_SSE)
+		return _mm_or_ps(_mm_andnot_ps(mask, a), _mm_and_ps(mask, b));
+#elif defined(MATH_NEON)
+		return vbslq_f32(vreinterpretq_u32_f32(mask), b, a);
+#else
+		return VectorOrInt(VectorAndCInt(a, mask), VectorAndInt(b, mask));
+#endif
+	}
+	MATH_CONSTEXPR uint32_t MATH_CALLCONV VectorMoveMask(Vector v)	// Sign bit of lane i in bit i
+	{
+#if defined(MATH_SSE)
+		return static_cast<uint32_t>(_mm_movemask_ps(v));
+#elif defined(MATH_NEON)
+		static const int32_t shifts[4]{ 0, 1, 2, 3 };
+		const uint32x4_t signs{ vshrq_n_u32(vreinterpretq_u32_f32(v), 31) };
+		return vaddvq_u32(vshlq_u32(signs, vld1q_s32(shifts)));
+#else
+		uint32_t mask{};
+		for (int lane{}; lane < 4; ++lane) mask |= (std::bit_cast<uint32_t>(v.f[lane]) >> 31) << lane;
+		return mask;
+#endif
+	}
+
+	// --------------------
+	// Vector - rounding
+	// --------------------
+
+	inline Vector MATH_CALLCONV VectorRound(Vector v)	// To nearest, ties to even
+	{
+#if defined(MATH_SSE4)
+		return _mm_round_ps(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+#elif defined(MATH_SSE)
+		// Values from 2^23 up are integral already and don't fit the conversion
+		const __m128 integral{ _mm_cmpge_ps(VectorAbs(v), _mm_set1_ps(8388608.f)) };
+		const __m128 rounded{ _mm_cvtepi32_ps(_mm_cvtps_epi32(v)) };
+		return VectorSelect(rounded, v, integral);
+#elif defined(MATH_NEON)
+		return vrndnq_f32(v);
+#else
+		return Vector{ { std::nearbyint(v.f[0]), std::nearbyint(v.f[1]), std::nearbyint(v.f[2]), std::nearbyint(v.f[3]) } };
+#endif
+	}
+	inline Vector MATH_CALLCONV VectorFloor(Vector v)
+	{
+#if defined(MATH_SSE4)
+		return _mm_floor_ps(v);
+#elif defined(MATH_SSE)
+		// Truncation rounds negative values up, step those back down
+		const __m128 integral{ _mm_cmpge_ps(VectorAbs(v), _mm_set1_ps(8388608.f)) };
+		const __m128 truncated{ _mm_cvtepi32_ps(_mm_cvttps_epi32(v)) };
+		const __m128 floored{ _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, v), _mm_set1_ps(1.f))) };
+		return VectorSelect(floored, v, integral);
+#elif defined(MATH_NEON)
+		return vrndmq_f32(v);
+#else
+		return Vector{ { std::floor(v.f[0]), std::floor(v.f[1]), std::floor(v.f[2]), std::floor(v.f[3]) } };
+#endif
+	}
+	inline Vector MATH_CALLCONV VectorSin(Vector v)
+	{
+		// Wrap into [-pi, pi], then mirror into [-pi/2, pi/2] where the polynomial is accurate
+		Vector x{ VectorSubtract(v, VectorMultiply(VectorRound(VectorMultiply(v, VectorReplicate(g_1Div2Pi))), VectorReplicate(g_2Pi))) };
+
+		const Vector signMask{ VectorReplicateInt(0x80000000u) };
+		const Vector mirror{ VectorOrInt(VectorReplicate(g_Pi), VectorAndInt(x, signMask)) };	// pi with the sign of x
+		const Vector inRange{ VectorLessOrEqual(VectorAbs(x), VectorReplicate(g_PiDiv2)) };
+		x = VectorSelect(VectorSubtract(mirror, x), x, inRange);
+
+		// 11th degree minimax polynomial
+		const Vector x2{ VectorMultiply(x, x) };
+		Vector result{ VectorMultiplyAdd(VectorReplicate(-2.3889859e-08f), x2, VectorReplicate(2.7525562e-06f)) };
+		result = VectorMultiplyAdd(result, x2, VectorReplicate(-0.00019840874f));
+		result = VectorMultiplyAdd(result, x2, VectorReplicate(0.0083333310f));
+		result = VectorMultiplyAdd(result, x2, VectorReplicate(-0.16666667f));
+		result = VectorMultiplyAdd(result, x2, VectorReplicate(1.f));
+		return VectorMultiply(result, x);
+	}
+	inline Vector MATH_CALLCONV VectorCos(Vector v)
+	{
+		return VectorSin(VectorAdd(v, VectorReplicate(g_PiDiv2)));
+	}
+
+	// ---------------------------
+	// Vector - 3D and 4D vectors
+	// ---------------------------
+	// Results are replicated in every lane, like DirectXMath
+
+	MATH_CONSTEXPR Vector MATH_CALLCONV Vector3Dot(Vector a, Vector b)
+	{
+#if defined(MATH_SSE4)
+		return _mm_dp_ps(a, b, 0x7F);
+#elif defined(MATH_SSE)
+		const __m128 product{ _mm_mul_ps(a, b) };
+		const __m128 sum{ _mm_add_ss(_mm_add_ss(product, _mm_shuffle_ps(product, product, _MM_SHUFFLE(1, 1, 1, 1))), _mm_shuffle_ps(product, product, _MM_SHUFFLE(2, 2, 2, 2))) };
+		return _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(0, 0, 0, 0));
+#elif defined(MATH_NEON)
+		return vdupq_n_f32(vaddvq_f32(vsetq_lane_f32(0.f, vmulq_f32(a, b), 3)));
+#else
+		return VectorReplicate(a.f[0] * b.f[0] + a.f[1] * b.f[1] + a.f[2] * b.f[2]);
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV Vector4Dot(Vector a, Vector b)
+	{
+#if defined(MATH_SSE4)
+		return _mm_dp_ps(a, b, 0xFF);
+#elif defined(MATH_SSE)
+		__m128 product{ _mm_mul_ps(a, b) };
+		product = _mm_add_ps(product, _mm_shuffle_ps(product, product, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_add_ps(product, _mm_shuffle_ps(product, product, _MM_SHUFFLE(1, 0, 3, 2)));
+#elif defined(MATH_NEON)
+		return vdupq_n_f32(vaddvq_f32(vmulq_f32(a, b)));
+#else
+		return VectorReplicate(a.f[0] * b.f[0] + a.f[1] * b.f[1] + a.f[2] * b.f[2] + a.f[3] * b.f[3]);
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV Vector3Cross(Vector a, Vector b)	// w = 0
+	{
+#if defined(MATH_SSE)
+		const __m128 aYZX{ _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1)) };
+		const __m128 bYZX{ _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1)) };
+		const __m128 difference{ _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b)) };	// z, x, y order
+		const __m128 result{ _mm_shuffle_ps(difference, difference, _MM_SHUFFLE(3, 0, 2, 1)) };
+		return _mm_and_ps(result, _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0)));
+#else
+		const float ax{ VectorGetX(a) }, ay{ VectorGetY(a) }, az{ VectorGetZ(a) };
+		const float bx{ VectorGetX(b) }, by{ VectorGetY(b) }, bz{ VectorGetZ(b) };
+		return VectorSet(ay * bz - az * by, az * bx - ax * bz, ax * by - ay * bx, 0.f);
+#endif
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV Vector3LengthSq(Vector v)
+	{
+		return Vector3Dot(v, v);
+	}
+	inline Vector MATH_CALLCONV Vector3Length(Vector v)
+	{
+		return VectorSqrt(Vector3Dot(v, v));
+	}
+	inline Vector MATH_CALLCONV Vector3Normalize(Vector v)
+	{
+		const Vector length{ Vector3Length(v) };
+		return VectorSelect(VectorDivide(v, length), VectorZero(), VectorEqual(length, VectorZero()));
+	}
+	inline Vector MATH_CALLCONV Vector4Normalize(Vector v)
+	{
+		const Vector length{ VectorSqrt(Vector4Dot(v, v)) };
+		return VectorSelect(VectorDivide(v, length), VectorZero(), VectorEqual(length, VectorZero()));
+	}
+	inline Vector MATH_CALLCONV PlaneNormalize(Vector plane)	// Scales the whole plane by the length of its normal
+	{
+		return VectorDivide(plane, Vector3Length(plane));
+	}
+
+	MATH_CONSTEXPR Vector MATH_CALLCONV Vector4Transform(Vector v, const Matrix& m)
+	{
+		Vector result{ VectorMultiply(VectorSplatW(v), m.r[3]) };
+		result = VectorMultiplyAdd(VectorSplatZ(v), m.r[2], result);
+		result = VectorMultiplyAdd(VectorSplatY(v), m.r[1], result);
+		return VectorMultiplyAdd(VectorSplatX(v), m.r[0], result);
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV Vector3TransformCoord(Vector v, const Matrix& m)	// w = 1, then divided by w
+	{
+		Vector result{ VectorMultiplyAdd(VectorSplatZ(v), m.r[2], m.r[3]) };
+		result = VectorMultiplyAdd(VectorSplatY(v), m.r[1], result);
+		result = VectorMultiplyAdd(VectorSplatX(v), m.r[0], result);
+		return VectorDivide(result, VectorSplatW(result));
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV Vector3TransformNormal(Vector v, const Matrix& m)	// w = 0
+	{
+		Vector result{ VectorMultiply(VectorSplatZ(v), m.r[2]) };
+		result = VectorMultiplyAdd(VectorSplatY(v), m.r[1], result);
+		return VectorMultiplyAdd(VectorSplatX(v), m.r[0], result);
+	}
+
+	// ----------
+	// Quaternion
+	// ----------
+	// x, y, z, w with w the real part, multiplication order like DirectXMath (first rotation first)
+
+	MATH_CONSTEXPR Vector MATH_CALLCONV QuaternionIdentity()
+	{
+		return VectorSet(0.f, 0.f, 0.f, 1.f);
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV QuaternionConjugate(Vector q)
+	{
+		return VectorXorInt(q, VectorSetInt(0x80000000u, 0x80000000u, 0x80000000u, 0u));
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV QuaternionMultiply(Vector q1, Vector q2)	// Rotates by q1, then by q2
+	{
+		// Hamilton product q2 * q1
+		const float ax{ VectorGetX(q2) }, ay{ VectorGetY(q2) }, az{ VectorGetZ(q2) }, aw{ VectorGetW(q2) };
+		const float bx{ VectorGetX(q1) }, by{ VectorGetY(q1) }, bz{ VectorGetZ(q1) }, bw{ VectorGetW(q1) };
+
+		return VectorSet
+		(
+			aw * bx + ax * bw + ay * bz - az * by,
+			aw * by - ax * bz + ay * bw + az * bx,
+			aw * bz + ax * by - ay * bx + az * bw,
+			aw * bw - ax * bx - ay * by - az * bz
+		);
+	}
+	inline Vector MATH_CALLCONV QuaternionNormalize(Vector q)
+	{
+		return Vector4Normalize(q);
+	}
+	inline Vector MATH_CALLCONV QuaternionRotationAxis(Vector axis, float angle)
+	{
+		const float halfAngle{ 0.5f * angle };
+		return VectorSetW(VectorScale(Vector3Normalize(axis), std::sin(halfAngle)), std::cos(halfAngle));
+	}
+	inline Vector MATH_CALLCONV QuaternionRotationRollPitchYaw(float pitch, float yaw, float roll)	// Roll around z, then pitch around x, then yaw around y
+	{
+		const float sp{ std::sin(0.5f * pitch) }, cp{ std::cos(0.5f * pitch) };
+		const float sy{ std::sin(0.5f * yaw) }, cy{ std::cos(0.5f * yaw) };
+		const float sr{ std::sin(0.5f * roll) }, cr{ std::cos(0.5f * roll) };
+
+		return VectorSet
+		(
+			cy * cr * sp + sy * cp * sr,
+			sy * cp * cr - cy * sp * sr,
+			cy * cp * sr - sy * cr * sp,
+			cy * cp * cr + sy * sp * sr
+		);
+	}
+	inline Vector MATH_CALLCONV QuaternionSlerp(Vector q0, Vector q1, float t)
+	{
+		// Take the short way around
+		float cosOmega{ VectorGetX(Vector4Dot(q0, q1)) };
+		if (cosOmega < 0.f)
+		{
+			q1 = VectorNegate(q1);
+			cosOmega = -cosOmega;
+		}
+
+		// Nearly parallel, lerp doesn't divide by zero
+		if (cosOmega > 0.9999f) return QuaternionNormalize(VectorLerp(q0, q1, t));
+
+		const float omega{ std::acos(cosOmega) };
+		const float inverseSin{ 1.f / std::sin(omega) };
+		const float scale0{ std::sin((1.f - t) * omega) * inverseSin };
+		const float scale1{ std::sin(t * omega) * inverseSin };
+		return VectorMultiplyAdd(q0, VectorReplicate(scale0), VectorScale(q1, scale1));
+	}
+	MATH_CONSTEXPR Vector MATH_CALLCONV Vector3Rotate(Vector v, Vector q)
+	{
+		// v + w * t + q x t, with t = 2 * (q x v)
+		const Vector t{ VectorScale(Vector3Cross(q, v), 2.f) };
+		return VectorAdd(VectorMultiplyAdd(VectorSplatW(q), t, v), Vector3Cross(q, t));
+	}
+
+	// ------
+	// Matrix
+	// ------
+
+	MATH_CONSTEXPR Matrix MATH_CALLCONV MatrixIdentity()
+	{
+		return Matrix{ { VectorSet(1.f, 0.f, 0.f, 0.f), VectorSet(0.f, 1.f, 0.f, 0.f), VectorSet(0.f, 0.f, 1.f, 0.f), VectorSet(0.f, 0.f, 0.f, 1.f) } };
+	}
+	MATH_CONSTEXPR Matrix MATH_CALLCONV LoadFloat4x4(const Float4x4* pSource)
+	{
+		return Matrix{ { VectorLoad(pSource->m[0]), VectorLoad(pSource->m[1]), VectorLoad(pSource->m[2]), VectorLoad(pSource->m[3]) } };
+	}
+	MATH_CONSTEXPR void MATH_CALLCONV StoreFloat4x4(Float4x4* pDestination, const Matrix& m)
+	{
+		VectorStore(pDestination->m[0], m.r[0]);
+		VectorStore(pDestination->m[1], m.r[1]);
+		VectorStore(pDestination->m[2], m.r[2]);
+		VectorStore(pDestination->m[3], m.r[3]);
+	}
+	MATH_CONSTEXPR Matrix MATH_CALLCONV MatrixMultiply(const Matrix& a, const Matrix& b)
+	{
+		Matrix result{};
+		for (int row{}; row < 4; ++row) result.r[row] = Vector4Transform(a.r[row], b);
+		return result;
+	}
+	MATH_CONSTEXPR Matrix MATH_CALLCONV operator*(const Matrix& a, const Matrix& b)
+	{
+		return MatrixMultiply(a, b);
+	}
+	MATH_CONSTEXPR Matrix MATH_CALLCONV MatrixTranspose(const Matrix& m)
+	{
+#if defined(MATH_SSE)
+		const __m128 xy01{ _mm_unpacklo_ps(m.r[0], m.r[1]) };	// 0x 1x 0y 1y
+		const __m128 xy23{ _mm_unpacklo_ps(m.r[2], m.r[3]) };
+		const __m128 zw01{ _mm_unpackhi_ps(m.r[0], m.r[1]) };	// 0z 1z 0w 1w
+		const __m128 zw23{ _mm_unpackhi_ps(m.r[2], m.r[3]) };
+		return Matrix{ { _mm_movelh_ps(xy01, xy23), _mm_movehl_ps(xy23, xy01), _mm_movelh_ps(zw01, zw23), _mm_movehl_ps(zw23, zw01) } };
+#elif defined(MATH_NEON)
+		const float32x4x2_t rows01{ vtrnq_f32(m.r[0], m.r[1]) };
+		const float32x4x2_t rows23{ vtrnq_f32(m.r[2], m.r[3]) };
+		return Matrix
+		{ {
+			vcombine_f32(vget_low_f32(rows01.val[0]), vget_low_f32(rows23.val[0])),
+			vcombine_f32(vget_low_f32(rows01.val[1]), vget_low_f32(rows23.val[1])),
+			vcombine_f32(vget_high_f32(rows01.val[0]), vget_high_f32(rows23.val[0])),
+			vcombine_f32(vget_high_f32(rows01.val[1]), vget_high_f32(rows23.val[1]))
+		} };
+#else
+		Matrix result{};
+		for (int row{}; row < 4; ++row)
+		{
+			for (int column{}; column < 4; ++column) result.r[row].f[column] = m.r[column].f[row];
+		}
+		return result;
+#endif
+	}
+	inline Matrix MATH_CALLCONV MatrixInverse(const Matrix& m, float* pDeterminant = nullptr)
+	{
+		// Cofactors in scalar code, only used for a handful of camera matrices per frame
+		Float4x4 stored{};
+		StoreFloat4x4(&stored, m);
+		const Float4x4 inverse{ Float4x4Inverse(stored, pDeterminant) };
+		return LoadFloat4x4(&inverse);
+	}
+	MATH_CONSTEXPR Matrix MATH_CALLCONV MatrixTranslation(float x, float y, float z)
+	{
+		return Matrix{ { VectorSet(1.f, 0.f, 0.f, 0.f), VectorSet(0.f, 1.f, 0.f, 0.f), VectorSet(0.f, 0.f, 1.f, 0.f), VectorSet(x, y, z, 1.f) } };
+	}
+	MATH_CONSTEXPR Matrix MATH_CALLCONV MatrixScaling(float x, float y, float z)
+	{
+		return Matrix{ { VectorSet(x, 0.f, 0.f, 0.f), VectorSet(0.f, y, 0.f, 0.f), VectorSet(0.f, 0.f, z, 0.f), VectorSet(0.f, 0.f, 0.f, 1.f) } };
+	}
+	MATH_CONSTEXPR Matrix MATH_CALLCONV MatrixRotationQuaternion(Vector q)
+	{
+		const float x{ VectorGetX(q) }, y{ VectorGetY(q) }, z{ VectorGetZ(q) }, w{ VectorGetW(q) };
+		const float xx{ 2.f * x * x }, yy{ 2.f * y * y }, zz{ 2.f * z * z };
+		const float xy{ 2.f * x * y }, xz{ 2.f * x * z }, yz{ 2.f * y * z };
+		const float xw{ 2.f * x * w }, yw{ 2.f * y * w }, zw{ 2.f * z * w };
+
+		return Matrix
+		{ {
+			VectorSet(1.f - yy - zz, xy + zw, xz - yw, 0.f),
+			VectorSet(xy - zw, 1.f - xx - zz, yz + xw, 0.f),
+			VectorSet(xz + yw, yz - xw, 1.f - xx - yy, 0.f),
+			VectorSet(0.f, 0.f, 0.f, 1.f)
+		} };
+	}
+	inline Matrix MATH_CALLCONV MatrixRotationRollPitchYaw(float pitch, float yaw, float roll)
+	{
+		return MatrixRotationQuaternion(QuaternionRotationRollPitchYaw(pitch, yaw, roll));
+	}
+	inline Matrix MATH_CALLCONV MatrixLookToLH(Vector eyePosition, Vector eyeDirection, Vector upDirection)
+	{
+		const Vector axisZ{ Vector3Normalize(eyeDirection) };
+		const Vector axisX{ Vector3Normalize(Vector3Cross(upDirection, axisZ)) };
+		const Vector axisY{ Vector3Cross(axisZ, axisX) };
+
+		// Built transposed, every row holds an axis and the eye offset along it
+		const Vector negativeEye{ VectorNegate(eyePosition) };
+		const Matrix transposed
+		{ {
+			VectorSetW(axisX, VectorGetX(Vector3Dot(axisX, negativeEye))),
+			VectorSetW(axisY, VectorGetX(Vector3Dot(axisY, negativeEye))),
+			VectorSetW(axisZ, VectorGetX(Vector3Dot(axisZ, negativeEye))),
+			VectorSet(0.f, 0.f, 0.f, 1.f)
+		} };
+		return MatrixTranspose(transposed);
+	}
+	inline Matrix MATH_CALLCONV MatrixLookAtLH(Vector eyePosition, Vector focusPosition, Vector upDirection)
+	{
+		return MatrixLookToLH(eyePosition, VectorSubtract(focusPosition, eyePosition), upDirection);
+	}
+	inline Matrix MATH_CALLCONV MatrixPerspectiveFovLH(float fovAngleY, float aspectRatio, float nearZ, float farZ)
+	{
+		const float height{ std::cos(0.5f * fovAngleY) / std::sin(0.5f * fovAngleY) };
+		const float width{ height / aspectRatio };
+		const float range{ farZ / (farZ - nearZ) };
+
+		return Matrix
+		{ {
+			VectorSet(width, 0.f, 0.f, 0.f),
+			VectorSet(0.f, height, 0.f, 0.f),
+			VectorSet(0.f, 0.f, range, 1.f),
+			VectorSet(0.f, 0.f, -range * nearZ, 0.f)
+		} };
+	}
+	MATH_CONSTEXPR Matrix MATH_CALLCONV MatrixOrthographicOffCenterLH(float left, float right, float bottom, float top, float nearZ, float farZ)
+	{
+		const float width{ 1.f / (right - left) };
+		const float height{ 1.f / (top - bottom) };
+		const float range{ 1.f / (farZ - nearZ) };
+
+		return Matrix
+		{ {
+			VectorSet(2.f * width, 0.f, 0.f, 0.f),
+			VectorSet(0.f, 2.f * height, 0.f, 0.f),
+			VectorSet(0.f, 0.f, range, 0.f),
+			VectorSet(-(left + right) * width, -(top + bottom) * height, -range * nearZ, 1.f)
+		} };
+	}
+
+	// -----
+	// Batch
+	// -----
+	// Whole arrays at once, AVX2 is picked at run time when the CPU has it, see EngineMath.cpp
+	// Input and output may be the same array
+
+	enum class SimdLevel
+	{
+		Scalar,
+		Sse2,
+		Sse4,
+		Avx2,
+		Neon
+	};
+
+	SimdLevel GetBatchSimdLevel();
+	const char* GetSimdLevelName(SimdLevel level);
+
+	void Vector3TransformCoordStream(Float3* pOutput, const Float3* pInput, size_t count, const Matrix& m);
+	void Vector4TransformStream(Float4* pOutput, const Float4* pInput, size_t count, const Matrix& m);
+	void Vector3TransformCoordSoA(float* pOutputX, float* pOutputY, float* pOutputZ,
+		const float* pInputX, const float* pInputY, const float* pInputZ, size_t count, const Float4x4& m);
+	void MatrixMultiplyStream(Float4x4* pOutput, const Float4x4* pInput, size_t count, const Matrix& m);	// pOutput[i] = pInput[i] * m
+}
+
+// The scalar fallbacks have to keep working at compile time
+static_assert(math::Float3Dot(math::Float3Cross(math::Float3{ 1.f, 0.f, 0.f }, math::Float3{ 0.f, 1.f, 0.f }), math::Float3{ 0.f, 0.f, 1.f }) == 1.f);
+static_assert(math::Float4x4Multiply(math::Float4x4Identity(), math::Float4x4Transpose(math::Float4x4Identity())).m[3][3] == 1.f);
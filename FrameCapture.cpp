@@ -0,0 +1,213 @@
+#include "FrameCapture.h"
+#include "Logger.h"
+
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+FrameCapture::FrameCapture(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext)
+	: m_pDevice{ pDevice }
+	, m_pDeviceContext{ pDeviceContext }
+	, m_Slots{}
+	, m_Encoder{}
+	, m_Capturing{ false }
+	, m_Stopping{ false }
+	, m_FrameCounter{}
+	, m_NextCaptureIndex{}
+	, m_NextSubmitIndex{}
+	, m_CapturedFrames{}
+	, m_DroppedFrames{}
+	, m_SessionFrames{}
+	, m_RenderThreadMs{}
+{
+	for (Slot& slot : m_Slots)
+	{
+		slot.state = SlotState::Free;
+		slot.encoded.store(false);
+	}
+}
+FrameCapture::~FrameCapture()
+{
+	// Shutdown is the only place allowed to wait, the encoder joins its worker here
+	for (Slot& slot : m_Slots)
+	{
+		while (slot.state == SlotState::Encoding && !slot.encoded.load(std::memory_order_acquire))
+		{
+			std::this_thread::yield();
+		}
+
+		if (slot.state == SlotState::Encoding) m_pDeviceContext->Unmap(slot.pTexture.Get(), 0);
+	}
+}
+
+bool FrameCapture::Start(FrameCaptureEncoder::Format format, const std::wstring& outputPath)
+{
+	// Previous session still draining
+	if (m_Capturing || m_Stopping) return false;
+
+	m_Encoder.Begin(format, outputPath);
+
+	m_Capturing = true;
+	m_NextCaptureIndex = 0;
+	m_NextSubmitIndex = 0;
+	m_SessionFrames = 0;
+	m_RenderThreadMs = 0.0;
+
+	Logger::Log(L"Capture started");
+	return true;
+}
+void FrameCapture::Stop()
+{
+	if (!m_Capturing) return;
+
+	// Frames in flight are still written, the session ends once they drained
+	m_Capturing = false;
+	m_Stopping = true;
+}
+
+void FrameCapture::CaptureFrame(ID3D11Texture2D* pSource)
+{
+	if (!m_Capturing && !m_Stopping) return;
+
+	const auto startTime{ std::chrono::steady_clock::now() };
+	++m_FrameCounter;
+
+	RecycleEncodedSlots();
+	SubmitReadySlots();
+	if (m_Capturing) CopyIntoFreeSlot(pSource);
+
+	// Close the session once everything is written
+	if (m_Stopping)
+	{
+		bool drained{ true };
+		for (const Slot& slot : m_Slots) drained = drained && slot.state == SlotState::Free;
+
+		if (drained)
+		{
+			m_Encoder.End();
+			m_Stopping = false;
+			LogStatistics();
+		}
+	}
+
+	m_RenderThreadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+void FrameCapture::LogStatistics() const
+{
+	const double averageMs{ m_SessionFrames ? m_RenderThreadMs / m_SessionFrames : 0.0 };
+
+	std::wstringstream message;
+	message << L"Capture: " << m_CapturedFrames << L" captured, " << m_DroppedFrames << L" dropped, "
+		<< m_Encoder.GetEncodedCount() << L" encoded, " << averageMs << L" ms per frame on the render thread, "
+		<< m_Encoder.GetEncodeMs() << L" ms encoding on the worker";
+	Logger::Log(message.str());
+}
+
+// Privates
+// --------
+void FrameCapture::RecycleEncodedSlots()
+{
+	for (Slot& slot : m_Slots)
+	{
+		if (slot.state != SlotState::Encoding || !slot.encoded.load(std::memory_order_acquire)) continue;
+
+		m_pDeviceContext->Unmap(slot.pTexture.Get(), 0);
+		slot.state = SlotState::Free;
+	}
+}
+void FrameCapture::SubmitReadySlots()
+{
+	// Frames are handed over in capture order, so the output stays sequential
+	bool submitted{ true };
+	while (submitted)
+	{
+		submitted = false;
+
+		for (Slot& slot : m_Slots)
+		{
+			if (slot.state != SlotState::Copied || slot.captureIndex != m_NextSubmitIndex) continue;
+			if (m_FrameCounter - slot.copiedOnFrame < g_ReadbackLatency) return;
+
+			// Never wait, try again next frame when the GPU isn't done yet
+			D3D11_MAPPED_SUBRESOURCE mappedResource{};
+			const HRESULT result = m_pDeviceContext->Map(slot.pTexture.Get(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mappedResource);
+			if (result == DXGI_ERROR_WAS_STILL_DRAWING) return;
+
+			if (FAILED(result))
+			{
+				Logger::Log(L"ERROR - Failed to map a capture texture");
+				slot.state = SlotState::Free;
+				++m_NextSubmitIndex;
+				submitted = true;
+				break;
+			}
+
+			slot.encoded.store(false, std::memory_order_relaxed);
+			slot.state = SlotState::Encoding;
+
+			m_Encoder.Submit(FrameCaptureEncoder::Frame
+			{
+				static_cast<const uint8_t*>(mappedResource.pData),
+				slot.description.Width,
+				slot.description.Height,
+				mappedResource.RowPitch,
+				slot.captureIndex,
+				&slot.encoded
+			});
+
+			++m_NextSubmitIndex;
+			submitted = true;
+			break;
+		}
+	}
+}
+void FrameCapture::CopyIntoFreeSlot(ID3D11Texture2D* pSource)
+{
+	D3D11_TEXTURE2D_DESC sourceDescription{};
+	pSource->GetDesc(&sourceDescription);
+
+	for (Slot& slot : m_Slots)
+	{
+		if (slot.state != SlotState::Free) continue;
+		if (!PrepareSlot(slot, sourceDescription)) break;
+
+		m_pDeviceContext->CopyResource(slot.pTexture.Get(), pSource);
+
+		slot.state = SlotState::Copied;
+		slot.captureIndex = m_NextCaptureIndex++;
+		slot.copiedOnFrame = m_FrameCounter;
+
+		++m_CapturedFrames;
+		++m_SessionFrames;
+		return;
+	}
+
+	// Every slot is in flight
+	++m_DroppedFrames;
+}
+bool FrameCapture::PrepareSlot(Slot& slot, const D3D11_TEXTURE2D_DESC& sourceDescription)
+{
+	// Reuse the texture while the source keeps its size and format
+	if (slot.pTexture && slot.description.Width == sourceDescription.Width
+		&& slot.description.Height == sourceDescription.Height && slot.description.Format == sourceDescription.Format)
+	{
+		return true;
+	}
+
+	D3D11_TEXTURE2D_DESC stagingDescription{ sourceDescription };
+	stagingDescription.Usage = D3D11_USAGE_STAGING;			// CPU readable copy
+	stagingDescription.BindFlags = 0;
+	stagingDescription.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	stagingDescription.MiscFlags = 0;
+
+	slot.pTexture.Reset();
+	const HRESULT result = m_pDevice->CreateTexture2D(&stagingDescription, nullptr, slot.pTexture.GetAddressOf());
+	if (FAILED(result))
+	{
+		Logger::Log(L"ERROR - Failed to create a capture staging texture");
+		return false;
+	}
+
+	slot.description = stagingDescription;
+	return true;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "FrameCaptureEncoder.h"
+
+#include <Windows.h>
+#include <d3d11.h>
+#include <wrl.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Asynchronous backBuffer readback
+// Frames are copied into a ring of staging textures and only mapped a few frames later, without waiting on the GPU
+// When every slot is still in flight the frame is dropped, the render thread never blocks
+class FrameCapture final
+{
+public:
+	// Rule of five
+	FrameCapture(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext);
+	~FrameCapture();
+
+	FrameCapture(const FrameCapture& other) = delete;
+	FrameCapture(FrameCapture&& other) = delete;
+	FrameCapture& operator= (const FrameCapture& other) = delete;
+	FrameCapture& operator= (FrameCapture&& other) = delete;
+
+	// Publics
+	bool Start(FrameCaptureEncoder::Format format, const std::wstring& outputPath);
+	void Stop();
+	bool IsCapturing() const { return m_Capturing; }
+
+	void CaptureFrame(ID3D11Texture2D* pSource);	// Call every frame before Present, also keeps pending frames moving
+	void LogStatistics() const;
+
+private:
+	// Structs
+	enum class SlotState
+	{
+		Free,
+		Copied,		// GPU copy queued
+		Encoding	// Mapped and handed to the encoder
+	};
+
+	struct Slot
+	{
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> pTexture;
+		D3D11_TEXTURE2D_DESC description;
+		SlotState state;
+		uint64_t captureIndex;
+		uint64_t copiedOnFrame;
+		std::atomic<bool> encoded;
+	};
+
+	static constexpr uint32_t g_SlotCount{ 6 };
+	static constexpr uint64_t g_ReadbackLatency{ 3 };	// Frames between the copy and the first map attempt
+
+	// Member variables
+	ID3D11Device* m_pDevice;
+	ID3D11DeviceContext* m_pDeviceContext;
+
+	std::array<Slot, g_SlotCount> m_Slots;
+	FrameCaptureEncoder m_Encoder;
+
+	bool m_Capturing;
+	bool m_Stopping;
+	uint64_t m_FrameCounter;
+	uint64_t m_NextCaptureIndex;
+	uint64_t m_NextSubmitIndex;
+
+	uint64_t m_CapturedFrames;
+	uint64_t m_DroppedFrames;
+	uint64_t m_SessionFrames;
+	double m_RenderThreadMs;
+
+	// Member functions
+	void RecycleEncodedSlots();
+	void SubmitReadySlots();
+	void CopyIntoFreeSlot(ID3D11Texture2D* pSource);
+	bool PrepareSlot(Slot& slot, const D3D11_TEXTURE2D_DESC& sourceDescription);
+};
@@ -0,0 +1,229 @@
+#include "FrameCaptureEncoder.h"
+#include "Logger.h"
+
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+	template <typename T>
+	void WriteValue(std::ofstream& file, T value)
+	{
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+}
+
+FrameCaptureEncoder::FrameCaptureEncoder()
+	: m_Worker{}
+	, m_Jobs{}
+	, m_Quit{ false }
+	, m_Format{ Format::ImageSequence }
+	, m_OutputPath{}
+	, m_RawFile{}
+	, m_RawWidth{}
+	, m_RawHeight{}
+	, m_SessionFrames{}
+	, m_EncodedCount{}
+	, m_EncodeMs{}
+{
+	m_Worker = std::thread{ &FrameCaptureEncoder::WorkerLoop, this };
+}
+FrameCaptureEncoder::~FrameCaptureEncoder()
+{
+	// Finish whatever is queued, then stop
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		m_Quit = true;
+	}
+	m_Condition.notify_one();
+
+	if (m_Worker.joinable()) m_Worker.join();
+}
+
+void FrameCaptureEncoder::Begin(Format format, const std::wstring& outputPath)
+{
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		m_Jobs.push_back(Job{ JobType::Begin, format, outputPath, Frame{} });
+	}
+	m_Condition.notify_one();
+}
+void FrameCaptureEncoder::Submit(const Frame& frame)
+{
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		m_Jobs.push_back(Job{ JobType::Frame, Format{}, std::wstring{}, frame });
+	}
+	m_Condition.notify_one();
+}
+void FrameCaptureEncoder::End()
+{
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		m_Jobs.push_back(Job{ JobType::End, Format{}, std::wstring{}, Frame{} });
+	}
+	m_Condition.notify_one();
+}
+double FrameCaptureEncoder::GetEncodeMs() const
+{
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	return m_EncodeMs;
+}
+
+// Privates
+// --------
+void FrameCaptureEncoder::WorkerLoop()
+{
+	while (true)
+	{
+		// Wait for work
+		Job job{};
+		{
+			std::unique_lock<std::mutex> lock{ m_Mutex };
+			m_Condition.wait(lock, [this]() { return m_Quit || !m_Jobs.empty(); });
+
+			if (m_Jobs.empty()) break;	// Quit, and everything has been written
+
+			job = std::move(m_Jobs.front());
+			m_Jobs.pop_front();
+		}
+
+		switch (job.type)
+		{
+		case JobType::Begin:	BeginSession(job);		break;
+		case JobType::Frame:	EncodeFrame(job.frame);	break;
+		case JobType::End:		EndSession();			break;
+		}
+	}
+
+	EndSession();
+}
+void FrameCaptureEncoder::BeginSession(const Job& job)
+{
+	EndSession();
+
+	m_Format = job.format;
+	m_OutputPath = job.outputPath;
+	m_SessionFrames = 0;
+
+	// Make sure the folder exists
+	std::error_code errorCode{};
+	std::filesystem::create_directories(std::filesystem::path{ m_OutputPath }.parent_path(), errorCode);
+
+	if (m_Format == Format::RawVideo)
+	{
+		m_RawFile.open(std::filesystem::path{ m_OutputPath + L".raw" }, std::ofstream::binary | std::ofstream::trunc);
+		if (!m_RawFile) Logger::Log(L"ERROR - Failed to open the raw capture file");
+	}
+}
+void FrameCaptureEncoder::EncodeFrame(const Frame& frame)
+{
+	const auto startTime{ std::chrono::steady_clock::now() };
+
+	const bool written{ m_Format == Format::ImageSequence ? WriteBitmap(frame) : WriteRaw(frame) };
+
+	// The pixels can be released now
+	frame.pEncoded->store(true, std::memory_order_release);
+
+	if (written)
+	{
+		++m_SessionFrames;
+		++m_EncodedCount;
+	}
+
+	const double encodeMs{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count() };
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	m_EncodeMs += encodeMs;
+}
+void FrameCaptureEncoder::EndSession()
+{
+	if (m_OutputPath.empty()) return;
+
+	// Describe the raw stream, so tools know how to read it
+	if (m_Format == Format::RawVideo && m_RawFile.is_open())
+	{
+		m_RawFile.close();
+
+		std::wofstream descriptionFile{ std::filesystem::path{ m_OutputPath + L".txt" } };
+		descriptionFile << L"format=bgra\n"
+			<< L"width=" << m_RawWidth << L"\n"
+			<< L"height=" << m_RawHeight << L"\n"
+			<< L"frames=" << m_SessionFrames << L"\n";
+	}
+
+	std::wstringstream message;
+	message << L"Capture finished, " << m_SessionFrames << L" frames written to " << m_OutputPath;
+	Logger::Log(message.str());
+
+	m_OutputPath.clear();
+}
+
+bool FrameCaptureEncoder::WriteBitmap(const Frame& frame)
+{
+	std::wstringstream fileName;
+	fileName << m_OutputPath << L"_" << std::setw(6) << std::setfill(L'0') << frame.frameIndex << L".bmp";
+
+	std::ofstream file{ std::filesystem::path{ fileName.str() }, std::ofstream::binary | std::ofstream::trunc };
+	if (!file)
+	{
+		Logger::Log(L"ERROR - Failed to open a capture bitmap for writing");
+		return false;
+	}
+
+	const uint32_t tightPitch{ frame.width * 4 };
+	const uint32_t pixelBytes{ tightPitch * frame.height };
+	const uint32_t headerSize{ 14 + 40 };
+
+	// BITMAPFILEHEADER
+	WriteValue<uint16_t>(file, 0x4D42);					// "BM"
+	WriteValue<uint32_t>(file, headerSize + pixelBytes);	// File size
+	WriteValue<uint32_t>(file, 0);						// Reserved
+	WriteValue<uint32_t>(file, headerSize);				// Offset to the pixels
+
+	// BITMAPINFOHEADER
+	WriteValue<uint32_t>(file, 40);						// Header size
+	WriteValue<int32_t>(file, static_cast<int32_t>(frame.width));
+	WriteValue<int32_t>(file, -static_cast<int32_t>(frame.height));	// Negative, rows are stored top-down
+	WriteValue<uint16_t>(file, 1);						// Planes
+	WriteValue<uint16_t>(file, 32);						// Bits per pixel, BGRA like the backBuffer
+	WriteValue<uint32_t>(file, 0);						// BI_RGB
+	WriteValue<uint32_t>(file, pixelBytes);
+	WriteValue<int32_t>(file, 2835);					// 72 DPI
+	WriteValue<int32_t>(file, 2835);
+	WriteValue<uint32_t>(file, 0);						// Palette size
+	WriteValue<uint32_t>(file, 0);						// Important colors
+
+	// Rows, without the GPU row padding
+	for (uint32_t row{}; row < frame.height; ++row)
+	{
+		file.write(reinterpret_cast<const char*>(frame.pPixels + static_cast<size_t>(row) * frame.rowPitch), tightPitch);
+	}
+
+	return static_cast<bool>(file);
+}
+bool FrameCaptureEncoder::WriteRaw(const Frame& frame)
+{
+	if (!m_RawFile.is_open()) return false;
+
+	// The stream has one size, frames that don't match are skipped
+	if (m_SessionFrames == 0)
+	{
+		m_RawWidth = frame.width;
+		m_RawHeight = frame.height;
+	}
+	else if (frame.width != m_RawWidth || frame.height != m_RawHeight)
+	{
+		return false;
+	}
+
+	const uint32_t tightPitch{ frame.width * 4 };
+	for (uint32_t row{}; row < frame.height; ++row)
+	{
+		m_RawFile.write(reinterpret_cast<const char*>(frame.pPixels + static_cast<size_t>(row) * frame.rowPitch), tightPitch);
+	}
+
+	return static_cast<bool>(m_RawFile);
+}
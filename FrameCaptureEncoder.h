@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Writes captured frames to disk on its own worker thread
+// Device agnostic, it only sees mapped BGRA8 pixels, so every backend can feed it
+class FrameCaptureEncoder final
+{
+public:
+	// Structs
+	enum class Format
+	{
+		ImageSequence,	// One .bmp per frame
+		RawVideo		// All frames back to back in one .raw, described by a .txt next to it
+	};
+
+	struct Frame
+	{
+		const uint8_t* pPixels;			// BGRA8, must stay valid until pEncoded is set
+		uint32_t width;
+		uint32_t height;
+		uint32_t rowPitch;
+		uint64_t frameIndex;
+		std::atomic<bool>* pEncoded;	// Set by the worker once the pixels aren't needed anymore
+	};
+
+	// Rule of five
+	FrameCaptureEncoder();
+	~FrameCaptureEncoder();
+
+	FrameCaptureEncoder(const FrameCaptureEncoder& other) = delete;
+	FrameCaptureEncoder(FrameCaptureEncoder&& other) = delete;
+	FrameCaptureEncoder& operator= (const FrameCaptureEncoder& other) = delete;
+	FrameCaptureEncoder& operator= (FrameCaptureEncoder&& other) = delete;
+
+	// Publics, none of these wait for the worker
+	void Begin(Format format, const std::wstring& outputPath);	// Path without extension
+	void Submit(const Frame& frame);
+	void End();
+
+	uint64_t GetEncodedCount() const { return m_EncodedCount.load(); }
+	double GetEncodeMs() const;
+
+private:
+	// Structs
+	enum class JobType
+	{
+		Begin,
+		Frame,
+		End
+	};
+
+	struct Job
+	{
+		JobType type;
+		Format format;
+		std::wstring outputPath;
+		Frame frame;
+	};
+
+	// Member variables
+	std::thread m_Worker;
+	mutable std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	std::deque<Job> m_Jobs;
+	bool m_Quit;
+
+	// Worker only
+	Format m_Format;
+	std::wstring m_OutputPath;
+	std::ofstream m_RawFile;
+	uint32_t m_RawWidth;
+	uint32_t m_RawHeight;
+	uint64_t m_SessionFrames;
+
+	std::atomic<uint64_t> m_EncodedCount;
+	double m_EncodeMs;
+
+	// Member functions
+	void WorkerLoop();
+	void BeginSession(const Job& job);
+	void EncodeFrame(const Frame& frame);
+	void EndSession();
+
+	bool WriteBitmap(const Frame& frame);
+	bool WriteRaw(const Frame& frame);
+};
@@ -0,0 +1,270 @@
+#include "HandleTableBenchmark.h"
+#include "DeviceObjectTable.h"
+#include "Logger.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+	constexpr uint32_t g_ObjectCount{ 4096 };		// Like the devices' tables
+	constexpr uint32_t g_BindCount{ 262144 };		// Per round
+	constexpr uint32_t g_RoundCount{ 16 };
+
+	constexpr uint32_t g_RetireLatency{ 3 };		// Like the D3D11 backend
+	constexpr uint32_t g_RetireFrames{ 64 };
+
+	volatile uint32_t g_Sink{};
+
+	// What the table keeps per object, a description like the null device's
+	struct MockEntry
+	{
+		uint32_t byteSize;
+		uint32_t flags;
+	};
+
+	// Stand-in for a COM interface, every call goes through the vtable
+	class MockUnknown
+	{
+	public:
+		virtual ~MockUnknown() = default;
+
+		virtual void AddRef() = 0;
+		virtual void Release() = 0;
+		virtual uint32_t GetByteSize() const = 0;
+	};
+
+	// Allocated one by one and freed on the last release, the reference count is interlocked like COM's
+	class MockBuffer final : public MockUnknown
+	{
+	public:
+		explicit MockBuffer(uint32_t byteSize)
+			: m_References{ 1 }
+			, m_ByteSize{ byteSize }
+		{
+		}
+
+		void AddRef() override { m_References.fetch_add(1, std::memory_order_relaxed); }
+		void Release() override
+		{
+			if (m_References.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+		}
+		uint32_t GetByteSize() const override { return m_ByteSize; }
+
+	private:
+		std::atomic<uint32_t> m_References;
+		uint32_t m_ByteSize;
+	};
+
+	// Same random bind order for both, objects are rarely bound in the order they were created
+	std::vector<uint32_t> CreateBindOrder()
+	{
+		std::mt19937 randomEngine{ 1337 };	// Fixed seed, same order every run
+		std::uniform_int_distribution<uint32_t> object{ 0, g_ObjectCount - 1 };
+
+		std::vector<uint32_t> order(g_BindCount);
+		for (uint32_t& objectIndex : order) objectIndex = object(randomEngine);
+		return order;
+	}
+}
+
+HandleTableBenchmark::HandleTableBenchmark()
+	: m_Result{}
+{
+}
+
+bool HandleTableBenchmark::Run()
+{
+	m_Result = Result{};
+	m_Result.objectCount = g_ObjectCount;
+	m_Result.bindCount = g_BindCount;
+
+	TimeTable();
+	TimeMockDevice();
+	CheckStaleHandles();
+	CheckRetirement();
+
+	return LogResults();
+}
+
+// Privates
+// --------
+void HandleTableBenchmark::TimeTable()
+{
+	using namespace std::chrono;
+
+	const std::vector<uint32_t> bindOrder{ CreateBindOrder() };
+	DeviceObjectTable<MockEntry> table{ g_ObjectCount };
+	std::vector<uint32_t> ids(g_ObjectCount);
+
+	// Every round reuses the slots of the last one, with the next generation
+	double createSeconds{};
+	double bindSeconds{};
+	double destroySeconds{};
+	uint32_t checksum{};
+	for (uint32_t round{}; round < g_RoundCount; ++round)
+	{
+		const steady_clock::time_point createStart{ steady_clock::now() };
+		for (uint32_t objectIndex{}; objectIndex < g_ObjectCount; ++objectIndex) ids[objectIndex] = table.Add(MockEntry{ objectIndex * 16 + 16, round });
+
+		const steady_clock::time_point bindStart{ steady_clock::now() };
+		for (const uint32_t objectIndex : bindOrder)
+		{
+			const MockEntry* pEntry{ table.Get(ids[objectIndex]) };
+			if (pEntry) checksum += pEntry->byteSize;
+		}
+
+		const steady_clock::time_point destroyStart{ steady_clock::now() };
+		for (const uint32_t id : ids) table.Remove(id);
+		table.RetireFrame(0);
+		const steady_clock::time_point destroyEnd{ steady_clock::now() };
+
+		createSeconds += duration<double>(bindStart - createStart).count();
+		bindSeconds += duration<double>(destroyStart - bindStart).count();
+		destroySeconds += duration<double>(destroyEnd - destroyStart).count();
+	}
+	g_Sink = checksum;
+
+	m_Result.tableCreateNs = createSeconds * 1e9 / (static_cast<double>(g_ObjectCount) * g_RoundCount);
+	m_Result.tableBindNs = bindSeconds * 1e9 / (static_cast<double>(g_BindCount) * g_RoundCount);
+	m_Result.tableDestroyNs = destroySeconds * 1e9 / (static_cast<double>(g_ObjectCount) * g_RoundCount);
+}
+void HandleTableBenchmark::TimeMockDevice()
+{
+	using namespace std::chrono;
+
+	const std::vector<uint32_t> bindOrder{ CreateBindOrder() };
+	std::vector<MockUnknown*> objects(g_ObjectCount);
+
+	double createSeconds{};
+	double bindSeconds{};
+	double destroySeconds{};
+	uint32_t checksum{};
+	for (uint32_t round{}; round < g_RoundCount; ++round)
+	{
+		const steady_clock::time_point createStart{ steady_clock::now() };
+		for (uint32_t objectIndex{}; objectIndex < g_ObjectCount; ++objectIndex) objects[objectIndex] = new MockBuffer{ objectIndex * 16 + 16 };
+
+		// Binding keeps the object alive while it is bound, like D3D11 does with the interfaces it is given
+		const steady_clock::time_point bindStart{ steady_clock::now() };
+		for (const uint32_t objectIndex : bindOrder)
+		{
+			MockUnknown* pObject{ objects[objectIndex] };
+			pObject->AddRef();
+			checksum += pObject->GetByteSize();
+			pObject->Release();
+		}
+
+		const steady_clock::time_point destroyStart{ steady_clock::now() };
+		for (MockUnknown* pObject : objects) pObject->Release();
+		const steady_clock::time_point destroyEnd{ steady_clock::now() };
+
+		createSeconds += duration<double>(bindStart - createStart).count();
+		bindSeconds += duration<double>(destroyStart - bindStart).count();
+		destroySeconds += duration<double>(destroyEnd - destroyStart).count();
+	}
+	g_Sink = checksum;
+
+	m_Result.mockCreateNs = createSeconds * 1e9 / (static_cast<double>(g_ObjectCount) * g_RoundCount);
+	m_Result.mockBindNs = bindSeconds * 1e9 / (static_cast<double>(g_BindCount) * g_RoundCount);
+	m_Result.mockDestroyNs = destroySeconds * 1e9 / (static_cast<double>(g_ObjectCount) * g_RoundCount);
+}
+void HandleTableBenchmark::CheckStaleHandles()
+{
+	DeviceObjectTable<MockEntry> table{ g_ObjectCount };
+
+	// Fill the table, destroy everything and fill it again, every old id now shares its slot with a new object
+	std::vector<uint32_t> oldIds(g_ObjectCount);
+	for (uint32_t objectIndex{}; objectIndex < g_ObjectCount; ++objectIndex) oldIds[objectIndex] = table.Add(MockEntry{ objectIndex, 0 });
+	for (const uint32_t id : oldIds) table.Remove(id);
+	table.RetireFrame(0);
+
+	std::vector<uint32_t> newIds(g_ObjectCount);
+	for (uint32_t objectIndex{}; objectIndex < g_ObjectCount; ++objectIndex) newIds[objectIndex] = table.Add(MockEntry{ objectIndex, 1 });
+
+	for (const uint32_t id : oldIds)
+	{
+		++m_Result.staleHandles;
+		if (!table.Get(id) && table.IsStale(id)) ++m_Result.caughtStaleHandles;
+	}
+
+	// The new ones reach their own objects, never one of the old generation
+	for (uint32_t objectIndex{}; objectIndex < g_ObjectCount; ++objectIndex)
+	{
+		const MockEntry* pEntry{ table.Get(newIds[objectIndex]) };
+		++m_Result.reusedHandles;
+		if (pEntry && pEntry->byteSize == objectIndex && pEntry->flags == 1 && !table.IsStale(newIds[objectIndex])) ++m_Result.resolvedHandles;
+	}
+}
+void HandleTableBenchmark::CheckRetirement()
+{
+	struct Removal
+	{
+		std::weak_ptr<uint32_t> object;	// Expires when the table lets go of it
+		uint32_t index;
+		uint32_t frame;
+		bool isOnTime;
+	};
+
+	// One object created and destroyed every frame, the table is the only owner
+	DeviceObjectTable<std::shared_ptr<uint32_t>> table{ g_ObjectCount };
+	std::vector<Removal> removals;
+
+	for (uint32_t frame{}; frame < g_RetireFrames; ++frame)
+	{
+		const uint32_t id{ table.Add(std::make_shared<uint32_t>(frame)) };
+		const uint32_t index{ handles::GetIndex(id) };
+
+		// Slots still holding a destroyed object must not be handed out
+		for (Removal& removal : removals)
+		{
+			if (removal.index == index && !removal.object.expired()) removal.isOnTime = false;
+		}
+
+		removals.push_back(Removal{ *table.Get(id), index, frame, true });
+		table.Remove(id);
+		table.RetireFrame(g_RetireLatency);
+
+		// Released by the retirement at the end of frame + latency, not a frame earlier or later
+		for (Removal& removal : removals)
+		{
+			const bool shouldBeAlive{ frame < removal.frame + g_RetireLatency };
+			if (removal.object.expired() == shouldBeAlive) removal.isOnTime = false;
+		}
+	}
+
+	// Only the ones that had time to retire
+	for (const Removal& removal : removals)
+	{
+		if (removal.frame + g_RetireLatency >= g_RetireFrames) continue;
+
+		++m_Result.retiredObjects;
+		if (removal.isOnTime) ++m_Result.retiredOnTime;
+	}
+}
+bool HandleTableBenchmark::LogResults() const
+{
+	const Result& result = m_Result;
+
+	std::wstringstream message;
+	message << L"Handle table benchmark: " << result.objectCount << L" objects, " << result.bindCount << L" binds per round, handles against a mock COM device: "
+		<< result.tableCreateNs << L" vs " << result.mockCreateNs << L" ns creating, " << result.tableBindNs << L" vs " << result.mockBindNs << L" ns binding, "
+		<< result.tableDestroyNs << L" vs " << result.mockDestroyNs << L" ns destroying";
+	Logger::Log(message.str());
+
+	message.str(L"");
+	message << L"Handle table benchmark: " << result.caughtStaleHandles << L" of " << result.staleHandles << L" stale handles caught, "
+		<< result.resolvedHandles << L" of " << result.reusedHandles << L" handles of reused slots resolved, " << result.retiredOnTime << L" of "
+		<< result.retiredObjects << L" destroyed objects kept exactly " << g_RetireLatency << L" frames";
+	Logger::Log(message.str());
+
+	const bool isResolving{ result.caughtStaleHandles >= result.staleHandles && result.resolvedHandles >= result.reusedHandles };
+	const bool isRetiring{ result.retiredOnTime >= result.retiredObjects };
+	if (!isResolving) Logger::Log(L"ERROR - Handle table benchmark: a handle reached the wrong object");
+	if (!isRetiring) Logger::Log(L"ERROR - Handle table benchmark: destroyed objects weren't kept until their frames retired");
+	return isResolving && isRetiring;
+}
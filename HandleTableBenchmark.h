@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+// Times creating, binding and destroying device objects through the handle tables against a mock COM style device
+// Also checks that stale handles are caught once their slots are reused and that objects live until their frames retire
+class HandleTableBenchmark final
+{
+public:
+	// Structs
+	struct Result
+	{
+		uint32_t objectCount;
+		uint32_t bindCount;				// Per round
+		double tableCreateNs;			// Per object
+		double mockCreateNs;
+		double tableBindNs;				// Per bind
+		double mockBindNs;
+		double tableDestroyNs;			// Per object, retiring included
+		double mockDestroyNs;
+		uint32_t staleHandles;			// Kept past their destruction, while their slots held new objects
+		uint32_t caughtStaleHandles;
+		uint32_t reusedHandles;			// Handed out for the reused slots
+		uint32_t resolvedHandles;
+		uint32_t retiredObjects;		// Destroyed while frames went by
+		uint32_t retiredOnTime;			// Kept exactly until their frame retired, without their slot being reused before
+	};
+
+	// Rule of five
+	HandleTableBenchmark();
+	~HandleTableBenchmark() = default;
+
+	HandleTableBenchmark(const HandleTableBenchmark& other) = delete;
+	HandleTableBenchmark(HandleTableBenchmark&& other) = delete;
+	HandleTableBenchmark& operator= (const HandleTableBenchmark& other) = delete;
+	HandleTableBenchmark& operator= (HandleTableBenchmark&& other) = delete;
+
+	// Publics
+	bool Run();	// False when a check failed, the failures are logged as errors
+
+	const Result& GetResult() const { return m_Result; }
+
+private:
+	// Member variables
+	Result m_Result;
+
+	// Member functions
+	void TimeTable();
+	void TimeMockDevice();
+	void CheckStaleHandles();
+	void CheckRetirement();
+	bool LogResults() const;
+};
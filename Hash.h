@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+namespace hashing
+{
+	// 64-bit FNV-1a, stable across runs so keys can be persisted to disk
+	constexpr uint64_t g_FnvOffsetBasis{ 14695981039346656037ull };
+	constexpr uint64_t g_FnvPrime{ 1099511628211ull };
+
+	inline uint64_t Fnv1a(const void* pData, size_t size, uint64_t hash = g_FnvOffsetBasis)
+	{
+		const unsigned char* pBytes = static_cast<const unsigned char*>(pData);
+		for (size_t index{}; index < size; ++index)
+		{
+			hash ^= pBytes[index];
+			hash *= g_FnvPrime;
+		}
+
+		return hash;
+	}
+
+	// Incremental hasher, add fields one by one so struct padding never ends up in the key
+	class Hasher final
+	{
+	public:
+		Hasher& AddBytes(const void* pData, size_t size)
+		{
+			m_Hash = Fnv1a(pData, size, m_Hash);
+			return *this;
+		}
+
+		template <typename T>
+		Hasher& Add(const T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be hashed directly");
+			return AddBytes(&value, sizeof(T));
+		}
+
+		Hasher& AddString(const char* pString)
+		{
+			const size_t length{ pString ? std::strlen(pString) : 0 };
+			Add(length);
+			return AddBytes(pString, length);
+		}
+		Hasher& AddString(const std::wstring& string)
+		{
+			Add(string.size());
+			return AddBytes(string.data(), string.size() * sizeof(wchar_t));
+		}
+
+		uint64_t Get() const { return m_Hash; }
+
+	private:
+		uint64_t m_Hash{ g_FnvOffsetBasis };
+	};
+}
@@ -0,0 +1,138 @@
+#include "LightClusterBenchmark.h"
+#include "LightClusterGrid.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sstream>
+
+using namespace math;
+
+namespace
+{
+	constexpr uint32_t g_LightCounts[]{ 64, 128, 256, 512, 1024, 2048, 4096 };
+	constexpr int g_Iterations{ 16 };
+
+	// A 16:9 view at the origin looking down +z, its view matrix is the identity
+	constexpr float g_FovRadians{ ConvertToRadians(60.f) };
+	constexpr float g_AspectRatio{ 16.f / 9.f };
+	constexpr float g_NearZ{ 0.1f };
+	constexpr float g_FarZ{ 100.f };
+
+	// Scattered through the first part of the frustum, where the slices are thin, and a little past its sides
+	std::vector<LightClusterGrid::Light> CreateLights(uint32_t lightCount)
+	{
+		const float tanHalfFov{ std::tan(g_FovRadians * 0.5f) };
+
+		std::mt19937 randomEngine{ 1337 };	// Fixed seed, same lights every run
+		std::uniform_real_distribution<float> depth{ 1.f, 60.f };
+		std::uniform_real_distribution<float> side{ -1.1f, 1.1f };
+		std::uniform_real_distribution<float> range{ 0.5f, 3.f };
+
+		std::vector<LightClusterGrid::Light> lights(lightCount);
+		for (LightClusterGrid::Light& light : lights)
+		{
+			const float z{ depth(randomEngine) };
+			light.position = Float3{ side(randomEngine) * z * tanHalfFov * g_AspectRatio, side(randomEngine) * z * tanHalfFov, z };
+			light.range = range(randomEngine);
+			light.color = Float3{ 1.f, 1.f, 1.f };
+			light.spotCosOuter = -2.f;
+			light.spotCosInner = -2.f;
+		}
+		return lights;
+	}
+}
+
+LightClusterBenchmark::LightClusterBenchmark()
+	: m_Results{}
+{
+}
+
+bool LightClusterBenchmark::Run()
+{
+	m_Results.clear();
+
+	LightClusterGrid grid{};
+	grid.SetProjection(g_FovRadians, g_AspectRatio, g_NearZ, g_FarZ);
+
+	Float4x4 viewMatrix{};
+	StoreFloat4x4(&viewMatrix, MatrixIdentity());
+
+	const float yScale{ 1.f / std::tan(g_FovRadians * 0.5f) };
+	const float xScale{ yScale / g_AspectRatio };
+
+	for (const uint32_t lightCount : g_LightCounts)
+	{
+		const std::vector<LightClusterGrid::Light> lights{ CreateLights(lightCount) };
+
+		// First assignment sizes the scratch arrays
+		grid.AssignLights(lights, viewMatrix);
+
+		Result result{};
+		result.lightCount = lightCount;
+		for (int iteration{}; iteration < g_Iterations; ++iteration)
+		{
+			grid.AssignLights(lights, viewMatrix);
+			result.assignMs += grid.GetStatistics().assignMs;
+		}
+		result.assignMs /= g_Iterations;
+		result.indexCount = grid.GetStatistics().indexCount;
+		result.maxLightsPerCluster = grid.GetStatistics().maxLightsPerCluster;
+
+		const std::vector<LightClusterGrid::ClusterRange>& clusterRanges = grid.GetClusterRanges();
+		const std::vector<uint32_t>& lightIndices = grid.GetLightIndices();
+		result.occupiedClusters = static_cast<uint32_t>(std::count_if(clusterRanges.begin(), clusterRanges.end(),
+			[](const LightClusterGrid::ClusterRange& range) { return range.count > 0; }));
+
+		// The cluster holding a light's center always touches it, whatever rounding picks between neighbors the light reaches both
+		for (uint32_t lightIndex{}; lightIndex < lightCount; ++lightIndex)
+		{
+			const Float3& position = lights[lightIndex].position;
+			const float ndcX{ position.x * xScale / position.z };
+			const float ndcY{ position.y * yScale / position.z };
+			if (ndcX < -1.f || ndcX >= 1.f || ndcY <= -1.f || ndcY > 1.f) continue;
+
+			const uint32_t x{ (std::min)(static_cast<uint32_t>((ndcX + 1.f) * 0.5f * LightClusterGrid::g_ClustersX), LightClusterGrid::g_ClustersX - 1) };
+			const uint32_t y{ (std::min)(static_cast<uint32_t>((1.f - ndcY) * 0.5f * LightClusterGrid::g_ClustersY), LightClusterGrid::g_ClustersY - 1) };
+			const float slice{ std::log(position.z) * grid.GetSliceScale() + grid.GetSliceBias() };
+			const uint32_t z{ (std::min)(static_cast<uint32_t>((std::max)(slice, 0.f)), LightClusterGrid::g_ClustersZ - 1) };
+
+			const LightClusterGrid::ClusterRange& range = clusterRanges[x + LightClusterGrid::g_ClustersX * (y + LightClusterGrid::g_ClustersY * z)];
+			const auto first{ lightIndices.begin() + range.offset };
+
+			++result.checkedLights;
+			if (std::find(first, first + range.count, lightIndex) != first + range.count) ++result.foundLights;
+		}
+
+		m_Results.push_back(result);
+	}
+
+	return LogResults();
+}
+
+// Privates
+// --------
+bool LightClusterBenchmark::LogResults() const
+{
+	std::wstringstream message;
+	bool isComplete{ true };
+	for (const Result& result : m_Results)
+	{
+		const double averageLights{ static_cast<double>(result.indexCount) / LightClusterGrid::g_ClusterCount };
+		const double averageOccupied{ result.occupiedClusters ? static_cast<double>(result.indexCount) / result.occupiedClusters : 0.0 };
+
+		message.str(L"");
+		message << L"Light cluster benchmark: " << result.lightCount << L" lights in " << LightClusterGrid::g_ClustersX << L"x" << LightClusterGrid::g_ClustersY
+			<< L"x" << LightClusterGrid::g_ClustersZ << L" clusters, " << result.assignMs << L" ms assigning (" << result.assignMs * 1000000.0 / result.lightCount
+			<< L" ns per light), " << averageLights << L" lights per cluster on average, " << averageOccupied << L" over the " << result.occupiedClusters
+			<< L" occupied ones, at most " << result.maxLightsPerCluster << L", " << result.foundLights << L" of " << result.checkedLights << L" lights found in their own cluster";
+		Logger::Log(message.str());
+
+		isComplete = isComplete && result.foundLights == result.checkedLights;
+	}
+
+	if (!isComplete) Logger::Log(L"ERROR - Light cluster benchmark: a light was missing from the cluster holding its center");
+	return isComplete;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Times assigning 64 to 4096 generated lights to the 16x9x24 cluster grid of one view
+// Logs the time and the lights per cluster for every count, and checks each light reaches the cluster its center is in
+class LightClusterBenchmark final
+{
+public:
+	// Structs
+	struct Result
+	{
+		uint32_t lightCount;
+		double assignMs;
+		uint32_t indexCount;			// Light indices over every cluster
+		uint32_t occupiedClusters;
+		uint32_t maxLightsPerCluster;
+		uint32_t checkedLights;			// With their center inside the frustum
+		uint32_t foundLights;			// Listed by the cluster holding their center
+	};
+
+	// Rule of five
+	LightClusterBenchmark();
+	~LightClusterBenchmark() = default;
+
+	LightClusterBenchmark(const LightClusterBenchmark& other) = delete;
+	LightClusterBenchmark(LightClusterBenchmark&& other) = delete;
+	LightClusterBenchmark& operator= (const LightClusterBenchmark& other) = delete;
+	LightClusterBenchmark& operator= (LightClusterBenchmark&& other) = delete;
+
+	// Publics
+	bool Run();	// False when a light is missing from the cluster holding its center
+
+	const std::vector<Result>& GetResults() const { return m_Results; }
+
+private:
+	// Member variables
+	std::vector<Result> m_Results;
+
+	// Member functions
+	bool LogResults() const;
+};
@@ -0,0 +1,255 @@
+#include "LightClusterGrid.h"
+
+#include <ppl.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+	// Padding lanes sit this far away, so they never touch a cluster
+	constexpr float g_OutOfReach{ 1e30f };
+}
+
+LightClusterGrid::LightClusterGrid()
+	: m_FovRadians{}
+	, m_AspectRatio{}
+	, m_NearZ{}
+	, m_FarZ{}
+	, m_SliceScale{}
+	, m_SliceBias{}
+	, m_ClusterMin(g_ClusterCount)
+	, m_ClusterMax(g_ClusterCount)
+	, m_SliceNear(g_ClustersZ)
+	, m_SliceFar(g_ClustersZ)
+	, m_ViewX{}
+	, m_ViewY{}
+	, m_ViewZ{}
+	, m_ViewRadius{}
+	, m_SliceScratch(g_ClustersZ)
+	, m_ClusterRanges(g_ClusterCount)
+	, m_LightIndices{}
+	, m_Statistics{}
+{
+}
+
+void LightClusterGrid::SetProjection(float fovRadians, float aspectRatio, float nearZ, float farZ)
+{
+	// Only rebuild when the frustum actually changed
+	if (fovRadians == m_FovRadians && aspectRatio == m_AspectRatio && nearZ == m_NearZ && farZ == m_FarZ) return;
+
+	m_FovRadians = fovRadians;
+	m_AspectRatio = aspectRatio;
+	m_NearZ = nearZ;
+	m_FarZ = farZ;
+
+	// Exponential slicing, so clusters stay roughly cubic in view space
+	const float logDepthRange{ std::log(farZ / nearZ) };
+	m_SliceScale = g_ClustersZ / logDepthRange;
+	m_SliceBias = -static_cast<float>(g_ClustersZ) * std::log(nearZ) / logDepthRange;
+
+	for (uint32_t z{}; z < g_ClustersZ; ++z)
+	{
+		m_SliceNear[z] = nearZ * std::pow(farZ / nearZ, static_cast<float>(z) / g_ClustersZ);
+		m_SliceFar[z] = nearZ * std::pow(farZ / nearZ, static_cast<float>(z + 1) / g_ClustersZ);
+	}
+
+	// Same scales as MatrixPerspectiveFovLH, view = ndc * depth / scale
+	const float yScale{ 1.f / std::tan(fovRadians * 0.5f) };
+	const float xScale{ yScale / aspectRatio };
+
+	for (uint32_t z{}; z < g_ClustersZ; ++z)
+	{
+		const float sliceNear{ m_SliceNear[z] };
+		const float sliceFar{ m_SliceFar[z] };
+
+		for (uint32_t y{}; y < g_ClustersY; ++y)
+		{
+			// Rows start at the top of the screen, like SV_Position
+			const float ndcTop{ 1.f - 2.f * y / g_ClustersY };
+			const float ndcBottom{ 1.f - 2.f * (y + 1) / g_ClustersY };
+
+			for (uint32_t x{}; x < g_ClustersX; ++x)
+			{
+				const float ndcLeft{ -1.f + 2.f * x / g_ClustersX };
+				const float ndcRight{ -1.f + 2.f * (x + 1) / g_ClustersX };
+
+				const uint32_t clusterIndex{ x + g_ClustersX * (y + g_ClustersY * z) };
+				math::Float3& clusterMin = m_ClusterMin[clusterIndex];
+				math::Float3& clusterMax = m_ClusterMax[clusterIndex];
+
+				clusterMin.x = (std::min)(ndcLeft * sliceNear, ndcLeft * sliceFar) / xScale;
+				clusterMax.x = (std::max)(ndcRight * sliceNear, ndcRight * sliceFar) / xScale;
+				clusterMin.y = (std::min)(ndcBottom * sliceNear, ndcBottom * sliceFar) / yScale;
+				clusterMax.y = (std::max)(ndcTop * sliceNear, ndcTop * sliceFar) / yScale;
+				clusterMin.z = sliceNear;
+				clusterMax.z = sliceFar;
+			}
+		}
+	}
+}
+void LightClusterGrid::AssignLights(const std::vector<Light>& lights, const math::Float4x4& viewMatrix)
+{
+	using namespace math;
+
+	const auto startTime{ std::chrono::steady_clock::now() };
+
+	const uint32_t lightCount{ static_cast<uint32_t>(lights.size()) };
+	const size_t paddedCount{ (static_cast<size_t>(lightCount) + 3) & ~static_cast<size_t>(3) };
+
+	// Scatter into SoA, padded to a multiple of 4
+	m_ViewX.assign(paddedCount, g_OutOfReach);
+	m_ViewY.assign(paddedCount, g_OutOfReach);
+	m_ViewZ.assign(paddedCount, g_OutOfReach);
+	m_ViewRadius.assign(paddedCount, 0.f);
+
+	for (uint32_t index{}; index < lightCount; ++index)
+	{
+		m_ViewX[index] = lights[index].position.x;
+		m_ViewY[index] = lights[index].position.y;
+		m_ViewZ[index] = lights[index].position.z;
+		m_ViewRadius[index] = lights[index].range;
+	}
+
+	// Transform all positions into view space in place, the padding stays out of reach
+	Vector3TransformCoordSoA
+	(
+		m_ViewX.data(), m_ViewY.data(), m_ViewZ.data(),	// Output
+		m_ViewX.data(), m_ViewY.data(), m_ViewZ.data(),	// Input
+		lightCount,										// Nr vectors
+		viewMatrix										// Transform
+	);
+
+	// Every depth slice is an independent job
+	Concurrency::parallel_for(0u, g_ClustersZ, [this](uint32_t sliceIndex)
+	{
+		AssignSlice(sliceIndex);
+	});
+
+	// Compact in slice order, so the result doesn't depend on job scheduling
+	m_LightIndices.clear();
+	m_Statistics.maxLightsPerCluster = 0;
+
+	uint32_t offset{};
+	for (uint32_t z{}; z < g_ClustersZ; ++z)
+	{
+		const SliceScratch& scratch = m_SliceScratch[z];
+		m_LightIndices.insert(m_LightIndices.end(), scratch.clusterIndices.begin(), scratch.clusterIndices.end());
+
+		for (uint32_t tileIndex{}; tileIndex < g_ClustersX * g_ClustersY; ++tileIndex)
+		{
+			const uint32_t count{ scratch.clusterCounts[tileIndex] };
+			m_ClusterRanges[z * g_ClustersX * g_ClustersY + tileIndex] = ClusterRange{ offset, count };
+
+			offset += count;
+			m_Statistics.maxLightsPerCluster = (std::max)(m_Statistics.maxLightsPerCluster, count);
+		}
+	}
+
+	m_Statistics.lightCount = lightCount;
+	m_Statistics.indexCount = static_cast<uint32_t>(m_LightIndices.size());
+	m_Statistics.assignMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+// Privates
+// --------
+void LightClusterGrid::AssignSlice(uint32_t sliceIndex)
+{
+	using namespace math;
+
+	SliceScratch& scratch = m_SliceScratch[sliceIndex];
+	scratch.x.clear();
+	scratch.y.clear();
+	scratch.z.clear();
+	scratch.radius.clear();
+	scratch.lightIndices.clear();
+	scratch.clusterIndices.clear();
+	scratch.clusterCounts.assign(g_ClustersX * g_ClustersY, 0);
+
+	// Gather the lights overlapping this depth range, 4 at a time
+	const Vector sliceNear{ VectorReplicate(m_SliceNear[sliceIndex]) };
+	const Vector sliceFar{ VectorReplicate(m_SliceFar[sliceIndex]) };
+
+	for (size_t index{}; index < m_ViewZ.size(); index += 4)
+	{
+		const Vector z{ VectorLoad(&m_ViewZ[index]) };
+		const Vector radius{ VectorLoad(&m_ViewRadius[index]) };
+
+		const Vector overlaps{ VectorAndInt
+		(
+			VectorGreaterOrEqual(VectorAdd(z, radius), sliceNear),
+			VectorLessOrEqual(VectorSubtract(z, radius), sliceFar)
+		) };
+
+		uint32_t laneMask[4];
+		StoreInt4(laneMask, overlaps);
+
+		for (size_t lane{}; lane < 4; ++lane)
+		{
+			if (!laneMask[lane]) continue;
+
+			const size_t lightIndex{ index + lane };
+			scratch.x.push_back(m_ViewX[lightIndex]);
+			scratch.y.push_back(m_ViewY[lightIndex]);
+			scratch.z.push_back(m_ViewZ[lightIndex]);
+			scratch.radius.push_back(m_ViewRadius[lightIndex]);
+			scratch.lightIndices.push_back(static_cast<uint32_t>(lightIndex));
+		}
+	}
+
+	const size_t gatheredCount{ scratch.lightIndices.size() };
+	if (gatheredCount == 0) return;
+
+	// Pad the gathered lights as well
+	const size_t paddedCount{ (gatheredCount + 3) & ~static_cast<size_t>(3) };
+	scratch.x.resize(paddedCount, g_OutOfReach);
+	scratch.y.resize(paddedCount, g_OutOfReach);
+	scratch.z.resize(paddedCount, g_OutOfReach);
+	scratch.radius.resize(paddedCount, 0.f);
+
+	// Sphere versus cluster AABB, 4 lights per test
+	const Vector zero{ VectorZero() };
+	for (uint32_t tileIndex{}; tileIndex < g_ClustersX * g_ClustersY; ++tileIndex)
+	{
+		const uint32_t clusterIndex{ sliceIndex * g_ClustersX * g_ClustersY + tileIndex };
+		const Float3& clusterMin = m_ClusterMin[clusterIndex];
+		const Float3& clusterMax = m_ClusterMax[clusterIndex];
+
+		const Vector minX{ VectorReplicate(clusterMin.x) };
+		const Vector minY{ VectorReplicate(clusterMin.y) };
+		const Vector minZ{ VectorReplicate(clusterMin.z) };
+		const Vector maxX{ VectorReplicate(clusterMax.x) };
+		const Vector maxY{ VectorReplicate(clusterMax.y) };
+		const Vector maxZ{ VectorReplicate(clusterMax.z) };
+
+		uint32_t count{};
+		for (size_t index{}; index < paddedCount; index += 4)
+		{
+			const Vector x{ VectorLoad(&scratch.x[index]) };
+			const Vector y{ VectorLoad(&scratch.y[index]) };
+			const Vector z{ VectorLoad(&scratch.z[index]) };
+			const Vector radius{ VectorLoad(&scratch.radius[index]) };
+
+			// Distance from the center to the box, per axis
+			const Vector dx{ VectorMax(VectorMax(VectorSubtract(minX, x), VectorSubtract(x, maxX)), zero) };
+			const Vector dy{ VectorMax(VectorMax(VectorSubtract(minY, y), VectorSubtract(y, maxY)), zero) };
+			const Vector dz{ VectorMax(VectorMax(VectorSubtract(minZ, z), VectorSubtract(z, maxZ)), zero) };
+
+			const Vector distanceSquared{ VectorMultiplyAdd(dz, dz, VectorMultiplyAdd(dy, dy, VectorMultiply(dx, dx))) };
+			const Vector touches{ VectorLessOrEqual(distanceSquared, VectorMultiply(radius, radius)) };
+
+			uint32_t laneMask[4];
+			StoreInt4(laneMask, touches);
+
+			for (size_t lane{}; lane < 4; ++lane)
+			{
+				if (!laneMask[lane]) continue;
+
+				scratch.clusterIndices.push_back(scratch.lightIndices[index + lane]);
+				++count;
+			}
+		}
+
+		scratch.clusterCounts[tileIndex] = count;
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "EngineMath.h"
+
+#include <cstdint>
+#include <vector>
+
+// Divides the view frustum in exponential depth slices of screen tiles
+// and assigns every light to the clusters its bounding sphere touches
+// Keep the grid size in sync with Surface_PS.hlsl
+class LightClusterGrid final
+{
+public:
+	// Structs
+	struct Light		// Matches the structured buffer layout in Surface_PS.hlsl
+	{
+		math::Float3 position;
+		float range;
+		math::Float3 color;
+		float spotCosOuter;			// Below -1 for point lights
+		math::Float3 direction;
+		float spotCosInner;
+	};
+
+	static_assert((sizeof(Light) % 16) == 0, "Structured buffer elements should be 16-byte aligned");
+
+	struct ClusterRange
+	{
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	struct Statistics
+	{
+		double assignMs;
+		uint32_t lightCount;
+		uint32_t indexCount;
+		uint32_t maxLightsPerCluster;
+	};
+
+	static constexpr uint32_t g_ClustersX{ 16 };
+	static constexpr uint32_t g_ClustersY{ 9 };
+	static constexpr uint32_t g_ClustersZ{ 24 };
+	static constexpr uint32_t g_ClusterCount{ g_ClustersX * g_ClustersY * g_ClustersZ };
+
+	// Rule of five
+	LightClusterGrid();
+	~LightClusterGrid() = default;
+
+	LightClusterGrid(const LightClusterGrid& other) = delete;
+	LightClusterGrid(LightClusterGrid&& other) = delete;
+	LightClusterGrid& operator= (const LightClusterGrid& other) = delete;
+	LightClusterGrid& operator= (LightClusterGrid&& other) = delete;
+
+	// Publics
+	void SetProjection(float fovRadians, float aspectRatio, float nearZ, float farZ);	// Rebuilds the cluster bounds when the frustum changes
+	void AssignLights(const std::vector<Light>& lights, const math::Float4x4& viewMatrix);
+
+	const std::vector<ClusterRange>& GetClusterRanges() const { return m_ClusterRanges; }
+	const std::vector<uint32_t>& GetLightIndices() const { return m_LightIndices; }
+	const Statistics& GetStatistics() const { return m_Statistics; }
+
+	float GetSliceScale() const { return m_SliceScale; }	// slice = log(viewDepth) * scale + bias
+	float GetSliceBias() const { return m_SliceBias; }
+
+private:
+	// Structs
+	struct SliceScratch
+	{
+		// Lights overlapping the slice depth range, SoA and padded to a multiple of 4
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> z;
+		std::vector<float> radius;
+		std::vector<uint32_t> lightIndices;
+
+		std::vector<uint32_t> clusterIndices;	// Light indices of every cluster in the slice, back to back
+		std::vector<uint32_t> clusterCounts;
+	};
+
+	// Member variables
+	float m_FovRadians;
+	float m_AspectRatio;
+	float m_NearZ;
+	float m_FarZ;
+	float m_SliceScale;
+	float m_SliceBias;
+
+	std::vector<math::Float3> m_ClusterMin;	// View space bounds
+	std::vector<math::Float3> m_ClusterMax;
+	std::vector<float> m_SliceNear;
+	std::vector<float> m_SliceFar;
+
+	// View space lights, SoA for the SIMD tests
+	std::vector<float> m_ViewX;
+	std::vector<float> m_ViewY;
+	std::vector<float> m_ViewZ;
+	std::vector<float> m_ViewRadius;
+
+	std::vector<SliceScratch> m_SliceScratch;
+	std::vector<ClusterRange> m_ClusterRanges;
+	std::vector<uint32_t> m_LightIndices;
+
+	Statistics m_Statistics;
+
+	// Member functions
+	void AssignSlice(uint32_t sliceIndex);
+};
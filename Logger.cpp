@@ -1,9 +1,19 @@
 #include "Logger.h"
 
+#if defined(_WIN32) && !defined(_CONSOLE)
 #include <Windows.h>
+#else
+#include <iostream>
+#endif
 
 void Logger::Log(const std::wstring& message)
 {
 	const std::wstring finalString{ message + L'\n' };
+
+#if defined(_WIN32) && !defined(_CONSOLE)
 	OutputDebugString(finalString.c_str());
-}
\ No newline at end of file
+#else
+	// Headless builds (null render device) and the benchmark runner log to the console
+	std::wcerr << finalString;
+#endif
+}
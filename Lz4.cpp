@@ -0,0 +1,169 @@
+#include "Lz4.h"
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	constexpr size_t g_MinMatch{ 4 };
+	constexpr size_t g_LastLiterals{ 5 };		// The block always ends with at least this many literals
+	constexpr size_t g_MatchFindLimit{ 12 };	// No match may start closer to the end than this
+	constexpr size_t g_MaxOffset{ 65535 };
+
+	constexpr uint32_t g_HashBits{ 12 };
+	constexpr uint32_t g_EmptySlot{ 0xFFFFFFFF };
+
+	uint32_t Read32(const uint8_t* pBytes)
+	{
+		uint32_t value{};
+		std::memcpy(&value, pBytes, sizeof(value));
+		return value;
+	}
+	uint32_t Hash(uint32_t sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - g_HashBits);
+	}
+
+	// Lengths of 15 and more continue in 255 steps
+	bool WriteLength(uint8_t*& pOutput, const uint8_t* pOutputEnd, size_t length)
+	{
+		for (; length >= 255; length -= 255)
+		{
+			if (pOutput == pOutputEnd) return false;
+			*pOutput++ = 255;
+		}
+		if (pOutput == pOutputEnd) return false;
+		*pOutput++ = static_cast<uint8_t>(length);
+		return true;
+	}
+	bool ReadLength(const uint8_t*& pInput, const uint8_t* pInputEnd, size_t& length)
+	{
+		uint8_t byte{};
+		do
+		{
+			if (pInput == pInputEnd) return false;
+			byte = *pInput++;
+			length += byte;
+		} while (byte == 255);
+		return true;
+	}
+
+	bool WriteSequence(uint8_t*& pOutput, const uint8_t* pOutputEnd, const uint8_t* pLiterals, size_t literalCount, size_t offset, size_t matchLength)
+	{
+		if (pOutput == pOutputEnd) return false;
+
+		uint8_t* pToken{ pOutput++ };
+		*pToken = static_cast<uint8_t>((literalCount >= 15 ? 15 : literalCount) << 4);
+		if (literalCount >= 15 && !WriteLength(pOutput, pOutputEnd, literalCount - 15)) return false;
+
+		if (static_cast<size_t>(pOutputEnd - pOutput) < literalCount) return false;
+		std::memcpy(pOutput, pLiterals, literalCount);
+		pOutput += literalCount;
+
+		// The last sequence has no match
+		if (matchLength == 0) return true;
+
+		if (pOutputEnd - pOutput < 2) return false;
+		*pOutput++ = static_cast<uint8_t>(offset & 0xFF);
+		*pOutput++ = static_cast<uint8_t>(offset >> 8);
+
+		const size_t extraLength{ matchLength - g_MinMatch };
+		*pToken |= static_cast<uint8_t>(extraLength >= 15 ? 15 : extraLength);
+		return extraLength < 15 || WriteLength(pOutput, pOutputEnd, extraLength - 15);
+	}
+}
+
+namespace lz4
+{
+	size_t Compress(const char* pSource, size_t sourceSize, char* pDestination, size_t destinationCapacity)
+	{
+		const uint8_t* pInput{ reinterpret_cast<const uint8_t*>(pSource) };
+		const uint8_t* pInputEnd{ pInput + sourceSize };
+		uint8_t* pOutput{ reinterpret_cast<uint8_t*>(pDestination) };
+		const uint8_t* pOutputEnd{ pOutput + destinationCapacity };
+
+		const uint8_t* pAnchor{ pInput };
+		if (sourceSize > g_MatchFindLimit)
+		{
+			// Last position seen for every hashed 4 byte sequence
+			std::vector<uint32_t> table(size_t{ 1 } << g_HashBits, g_EmptySlot);
+
+			const uint8_t* pCurrent{ pInput };
+			const uint8_t* pMatchStartLimit{ pInputEnd - g_MatchFindLimit };
+			const uint8_t* pMatchEndLimit{ pInputEnd - g_LastLiterals };
+			while (pCurrent < pMatchStartLimit)
+			{
+				const uint32_t sequence{ Read32(pCurrent) };
+				const uint32_t hash{ Hash(sequence) };
+				const uint32_t candidate{ table[hash] };
+				table[hash] = static_cast<uint32_t>(pCurrent - pInput);
+
+				if (candidate == g_EmptySlot)
+				{
+					++pCurrent;
+					continue;
+				}
+
+				const uint8_t* pReference{ pInput + candidate };
+				if (static_cast<size_t>(pCurrent - pReference) > g_MaxOffset || Read32(pReference) != sequence)
+				{
+					++pCurrent;
+					continue;
+				}
+
+				size_t matchLength{ g_MinMatch };
+				while (pCurrent + matchLength < pMatchEndLimit && pCurrent[matchLength] == pReference[matchLength]) ++matchLength;
+
+				if (!WriteSequence(pOutput, pOutputEnd, pAnchor, pCurrent - pAnchor, pCurrent - pReference, matchLength)) return 0;
+
+				pCurrent += matchLength;
+				pAnchor = pCurrent;
+			}
+		}
+
+		if (!WriteSequence(pOutput, pOutputEnd, pAnchor, pInputEnd - pAnchor, 0, 0)) return 0;
+		return static_cast<size_t>(pOutput - reinterpret_cast<uint8_t*>(pDestination));
+	}
+
+	bool Decompress(const char* pSource, size_t sourceSize, char* pDestination, size_t destinationSize)
+	{
+		const uint8_t* pInput{ reinterpret_cast<const uint8_t*>(pSource) };
+		const uint8_t* pInputEnd{ pInput + sourceSize };
+		uint8_t* pOutput{ reinterpret_cast<uint8_t*>(pDestination) };
+		uint8_t* pOutputStart{ pOutput };
+		const uint8_t* pOutputEnd{ pOutput + destinationSize };
+
+		while (pInput < pInputEnd)
+		{
+			const uint8_t token{ *pInput++ };
+
+			size_t literalCount{ static_cast<size_t>(token >> 4) };
+			if (literalCount == 15 && !ReadLength(pInput, pInputEnd, literalCount)) return false;
+			if (literalCount > static_cast<size_t>(pInputEnd - pInput) || literalCount > static_cast<size_t>(pOutputEnd - pOutput)) return false;
+
+			std::memcpy(pOutput, pInput, literalCount);
+			pInput += literalCount;
+			pOutput += literalCount;
+
+			// The last sequence ends after its literals
+			if (pInput == pInputEnd) break;
+
+			if (pInputEnd - pInput < 2) return false;
+			const size_t offset{ static_cast<size_t>(pInput[0]) | (static_cast<size_t>(pInput[1]) << 8) };
+			pInput += 2;
+			if (offset == 0 || offset > static_cast<size_t>(pOutput - pOutputStart)) return false;
+
+			size_t matchLength{ static_cast<size_t>(token & 15) };
+			if (matchLength == 15 && !ReadLength(pInput, pInputEnd, matchLength)) return false;
+			matchLength += g_MinMatch;
+			if (matchLength > static_cast<size_t>(pOutputEnd - pOutput)) return false;
+
+			// Byte by byte, a match may overlap the bytes it produces
+			const uint8_t* pMatch{ pOutput - offset };
+			for (size_t index{}; index < matchLength; ++index) pOutput[index] = pMatch[index];
+			pOutput += matchLength;
+		}
+
+		return pOutput == pOutputEnd;
+	}
+}
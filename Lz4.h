@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// LZ4 block format, compatible with the reference decoder
+// The compressor is the single pass greedy variant: fast enough to pack at startup, decompression is what matters
+namespace lz4
+{
+	constexpr size_t CompressBound(size_t sourceSize) { return sourceSize + sourceSize / 255 + 16; }
+	constexpr uint64_t DecompressBound(uint64_t compressedSize) { return compressedSize * 255; }	// A length byte never adds more than 255 bytes
+
+	// Returns the compressed size, 0 when the destination is too small
+	size_t Compress(const char* pSource, size_t sourceSize, char* pDestination, size_t destinationCapacity);
+
+	// The decompressed size has to be known up front, false on malformed input or a size mismatch
+	bool Decompress(const char* pSource, size_t sourceSize, char* pDestination, size_t destinationSize);
+}
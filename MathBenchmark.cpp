@@ -0,0 +1,389 @@
+#include "MathBenchmark.h"
+#include "Logger.h"
+
+#include <DirectXMath.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sstream>
+
+namespace
+{
+	// Inputs per operation, every operation reads index and index + 1
+	constexpr size_t g_InputCount{ 4096 };
+
+	// Timed passes over the inputs
+	constexpr int g_Repetitions{ 64 };
+
+	// Largest accepted error, relative to the DirectXMath result
+	constexpr float g_Tolerance{ 1e-4f };
+
+	// Results are summed in here, so the timed work can't be optimized away
+	volatile float g_Sink{};
+
+	// Storage types share the DirectXMath layouts
+	static_assert(sizeof(math::Float3) == sizeof(DirectX::XMFLOAT3) && sizeof(math::Float4) == sizeof(DirectX::XMFLOAT4)
+		&& sizeof(math::Float4x4) == sizeof(DirectX::XMFLOAT4X4), "Storage types must match DirectXMath");
+
+	const DirectX::XMFLOAT4* ToDirectX(const math::Float4* pValue) { return reinterpret_cast<const DirectX::XMFLOAT4*>(pValue); }
+	const DirectX::XMFLOAT4X4* ToDirectX(const math::Float4x4* pValue) { return reinterpret_cast<const DirectX::XMFLOAT4X4*>(pValue); }
+
+	float RelativeError(float value, float expected)
+	{
+		return std::abs(value - expected) / (std::max)(1.f, std::abs(expected));
+	}
+	void TrackError(float& maxError, float error)
+	{
+		// Also catches NaN
+		if (!(error <= maxError)) maxError = error;
+	}
+}
+
+MathBenchmark::MathBenchmark()
+	: m_Vectors(g_InputCount + 1)
+	, m_Quaternions(g_InputCount + 1)
+	, m_Matrices(g_InputCount + 1)
+	, m_Results{}
+{
+	using namespace math;
+
+	std::mt19937 randomEngine{ 1337 };	// Fixed seed, same inputs every run
+	std::uniform_real_distribution<float> coordinate{ -10.f, 10.f };
+	std::uniform_real_distribution<float> angle{ -g_Pi, g_Pi };
+	std::uniform_real_distribution<float> scale{ 0.5f, 2.f };
+
+	for (size_t index{}; index < g_InputCount + 1; ++index)
+	{
+		m_Vectors[index] = Float4{ coordinate(randomEngine), coordinate(randomEngine), coordinate(randomEngine), coordinate(randomEngine) };
+
+		const Vector rotation{ QuaternionRotationRollPitchYaw(angle(randomEngine), angle(randomEngine), angle(randomEngine)) };
+		StoreFloat4(&m_Quaternions[index], rotation);
+
+		// Scale, rotate and translate, well conditioned for the inverse
+		const Matrix world{ MatrixScaling(scale(randomEngine), scale(randomEngine), scale(randomEngine))
+			* MatrixRotationQuaternion(rotation)
+			* MatrixTranslation(coordinate(randomEngine), coordinate(randomEngine), coordinate(randomEngine)) };
+		StoreFloat4x4(&m_Matrices[index], world);
+	}
+}
+
+bool MathBenchmark::Run()
+{
+	using namespace DirectX;
+
+	m_Results.clear();
+
+	// Every operation writes its result as floats, so both sides are compared the same way
+	Compare(L"MatrixMultiply",
+		[this](size_t index, float* pOutput)
+		{
+			math::StoreFloat4x4(reinterpret_cast<math::Float4x4*>(pOutput), math::LoadFloat4x4(&m_Matrices[index]) * math::LoadFloat4x4(&m_Matrices[index + 1]));
+		},
+		[this](size_t index, float* pOutput)
+		{
+			XMStoreFloat4x4(reinterpret_cast<XMFLOAT4X4*>(pOutput), XMLoadFloat4x4(ToDirectX(&m_Matrices[index])) * XMLoadFloat4x4(ToDirectX(&m_Matrices[index + 1])));
+		});
+	Compare(L"MatrixTranspose",
+		[this](size_t index, float* pOutput)
+		{
+			math::StoreFloat4x4(reinterpret_cast<math::Float4x4*>(pOutput), math::MatrixTranspose(math::LoadFloat4x4(&m_Matrices[index])));
+		},
+		[this](size_t index, float* pOutput)
+		{
+			XMStoreFloat4x4(reinterpret_cast<XMFLOAT4X4*>(pOutput), XMMatrixTranspose(XMLoadFloat4x4(ToDirectX(&m_Matrices[index]))));
+		});
+	Compare(L"MatrixInverse",
+		[this](size_t index, float* pOutput)
+		{
+			math::StoreFloat4x4(reinterpret_cast<math::Float4x4*>(pOutput), math::MatrixInverse(math::LoadFloat4x4(&m_Matrices[index])));
+		},
+		[this](size_t index, float* pOutput)
+		{
+			XMStoreFloat4x4(reinterpret_cast<XMFLOAT4X4*>(pOutput), XMMatrixInverse(nullptr, XMLoadFloat4x4(ToDirectX(&m_Matrices[index]))));
+		});
+	Compare(L"MatrixRotationQuaternion",
+		[this](size_t index, float* pOutput)
+		{
+			math::StoreFloat4x4(reinterpret_cast<math::Float4x4*>(pOutput), math::MatrixRotationQuaternion(math::LoadFloat4(&m_Quaternions[index])));
+		},
+		[this](size_t index, float* pOutput)
+		{
+			XMStoreFloat4x4(reinterpret_cast<XMFLOAT4X4*>(pOutput), XMMatrixRotationQuaternion(XMLoadFloat4(ToDirectX(&m_Quaternions[index]))));
+		});
+	Compare(L"MatrixLookToLH",
+		[this](size_t index, float* pOutput)
+		{
+			const math::Vector eye{ math::LoadFloat4(&m_Vectors[index]) };
+			const math::Vector direction{ math::Vector3Normalize(math::LoadFloat4(&m_Vectors[index + 1])) };
+			math::StoreFloat4x4(reinterpret_cast<math::Float4x4*>(pOutput), math::MatrixLookToLH(eye, direction, math::VectorSet(0.f, 1.f, 0.f, 0.f)));
+		},
+		[this](size_t index, float* pOutput)
+		{
+			const XMVECTOR eye{ XMLoadFloat4(ToDirectX(&m_Vectors[index])) };
+			const XMVECTOR direction{ XMVector3Normalize(XMLoadFloat4(ToDirectX(&m_Vectors[index + 1]))) };
+			XMStoreFloat4x4(reinterpret_cast<XMFLOAT4X4*>(pOutput), XMMatrixLookToLH(eye, direction, XMVectorSet(0.f, 1.f, 0.f, 0.f)));
+		});
+	Compare(L"MatrixPerspectiveFovLH",
+		[this](size_t index, float* pOutput)
+		{
+			const float fov{ 0.5f + std::abs(m_Vectors[index].x) * 0.2f };
+			const float aspectRatio{ 0.5f + std::abs(m_Vectors[index].y) * 0.2f };
+			math::StoreFloat4x4(reinterpret_cast<math::Float4x4*>(pOutput), math::MatrixPerspectiveFovLH(fov, aspectRatio, 0.1f, 100.f));
+		},
+		[this](size_t index, float* pOutput)
+		{
+			const float fov{ 0.5f + std::abs(m_Vectors[index].x) * 0.2f };
+			const float aspectRatio{ 0.5f + std::abs(m_Vectors[index].y) * 0.2f };
+			XMStoreFloat4x4(reinterpret_cast<XMFLOAT4X4*>(pOutput), XMMatrixPerspectiveFovLH(fov, aspectRatio, 0.1f, 100.f));
+		});
+	Compare(L"Vector3TransformCoord",
+		[this](size_t index, float* pOutput)
+		{
+			math::VectorStore(pOutput, math::Vector3TransformCoord(math::LoadFloat4(&m_Vectors[index]), math::LoadFloat4x4(&m_Matrices[index])));
+		},
+		[this](size_t index, float* pOutput)
+		{
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pOutput), XMVector3TransformCoord(XMLoadFloat4(ToDirectX(&m_Vectors[index])), XMLoadFloat4x4(ToDirectX(&m_Matrices[index]))));
+		});
+	Compare(L"Vector4Dot",
+		[this](size_t index, float* pOutput)
+		{
+			math::VectorStore(pOutput, math::Vector4Dot(math::LoadFloat4(&m_Vectors[index]), math::LoadFloat4(&m_Vectors[index + 1])));
+		},
+		[this](size_t index, float* pOutput)
+		{
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pOutput), XMVector4Dot(XMLoadFloat4(ToDirectX(&m_Vectors[index])), XMLoadFloat4(ToDirectX(&m_Vectors[index + 1]))));
+		});
+	Compare(L"Vector3Cross",
+		[this](size_t index, float* pOutput)
+		{
+			math::VectorStore(pOutput, math::Vector3Cross(math::LoadFloat4(&m_Vectors[index]), math::LoadFloat4(&m_Vectors[index + 1])));
+		},
+		[this](size_t index, float* pOutput)
+		{
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pOutput), XMVector3Cross(XMLoadFloat4(ToDirectX(&m_Vectors[index])), XMLoadFloat4(ToDirectX(&m_Vectors[index + 1]))));
+		});
+	Compare(L"Vector3Normalize",
+		[this](size_t index, float* pOutput)
+		{
+			math::VectorStore(pOutput, math::Vector3Normalize(math::LoadFloat4(&m_Vectors[index])));
+		},
+		[this](size_t index, float* pOutput)
+		{
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pOutput), XMVector3Normalize(XMLoadFloat4(ToDirectX(&m_Vectors[index]))));
+		});
+	Compare(L"Vector3Rotate",
+		[this](size_t index, float* pOutput)
+		{
+			math::StoreFloat3(reinterpret_cast<math::Float3*>(pOutput), math::Vector3Rotate(math::LoadFloat4(&m_Vectors[index]), math::LoadFloat4(&m_Quaternions[index])));
+		},
+		[this](size_t index, float* pOutput)
+		{
+			XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(pOutput), XMVector3Rotate(XMLoadFloat4(ToDirectX(&m_Vectors[index])), XMLoadFloat4(ToDirectX(&m_Quaternions[index]))));
+		});
+	Compare(L"VectorSinCos",
+		[this](size_t index, float* pOutput)
+		{
+			const math::Vector angles{ math::LoadFloat4(&m_Vectors[index]) };
+			math::VectorStore(pOutput, math::VectorSin(angles));
+			math::VectorStore(pOutput + 4, math::VectorCos(angles));
+		},
+		[this](size_t index, float* pOutput)
+		{
+			const XMVECTOR angles{ XMLoadFloat4(ToDirectX(&m_Vectors[index])) };
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pOutput), XMVectorSin(angles));
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pOutput + 4), XMVectorCos(angles));
+		});
+	Compare(L"QuaternionMultiply",
+		[this](size_t index, float* pOutput)
+		{
+			math::VectorStore(pOutput, math::QuaternionMultiply(math::LoadFloat4(&m_Quaternions[index]), math::LoadFloat4(&m_Quaternions[index + 1])));
+		},
+		[this](size_t index, float* pOutput)
+		{
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pOutput), XMQuaternionMultiply(XMLoadFloat4(ToDirectX(&m_Quaternions[index])), XMLoadFloat4(ToDirectX(&m_Quaternions[index + 1]))));
+		});
+	Compare(L"QuaternionSlerp",
+		[this](size_t index, float* pOutput)
+		{
+			math::VectorStore(pOutput, math::QuaternionSlerp(math::LoadFloat4(&m_Quaternions[index]), math::LoadFloat4(&m_Quaternions[index + 1]), 0.3f));
+		},
+		[this](size_t index, float* pOutput)
+		{
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pOutput), XMQuaternionSlerp(XMLoadFloat4(ToDirectX(&m_Quaternions[index])), XMLoadFloat4(ToDirectX(&m_Quaternions[index + 1])), 0.3f));
+		});
+	Compare(L"QuaternionRotationRollPitchYaw",
+		[this](size_t index, float* pOutput)
+		{
+			const math::Float4& angles = m_Vectors[index];
+			math::VectorStore(pOutput, math::QuaternionRotationRollPitchYaw(angles.x, angles.y, angles.z));
+		},
+		[this](size_t index, float* pOutput)
+		{
+			const math::Float4& angles = m_Vectors[index];
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(pOutput), XMQuaternionRotationRollPitchYaw(angles.x, angles.y, angles.z));
+		});
+
+	CompareBatches();
+	return LogResults();
+}
+
+// Privates
+// --------
+template <typename EngineOperation, typename DirectXOperation>
+void MathBenchmark::Compare(const wchar_t* pName, EngineOperation engineOperation, DirectXOperation directXOperation)
+{
+	using namespace std::chrono;
+
+	// Validate, no operation writes more than a matrix
+	float maxError{};
+	for (size_t index{}; index < g_InputCount; ++index)
+	{
+		float engineOutput[16]{};
+		float directXOutput[16]{};
+		engineOperation(index, engineOutput);
+		directXOperation(index, directXOutput);
+
+		for (int element{}; element < 16; ++element)
+		{
+			TrackError(maxError, RelativeError(engineOutput[element], directXOutput[element]));
+		}
+	}
+
+	// Time both sides the same way
+	const auto measure = [](auto operation)
+	{
+		float output[16]{};
+		float sink{};
+
+		const auto startTime{ steady_clock::now() };
+		for (int repetition{}; repetition < g_Repetitions; ++repetition)
+		{
+			for (size_t index{}; index < g_InputCount; ++index)
+			{
+				operation(index, output);
+				sink += output[0] + output[3] + output[15];
+			}
+		}
+		const double elapsedNs{ duration<double, std::nano>(steady_clock::now() - startTime).count() };
+
+		g_Sink = sink;
+		return elapsedNs / (static_cast<double>(g_Repetitions) * g_InputCount);
+	};
+
+	m_Results.push_back(Result{ pName, maxError, measure(engineOperation), measure(directXOperation) });
+}
+void MathBenchmark::CompareBatches()
+{
+	using namespace DirectX;
+	using namespace std::chrono;
+
+	std::vector<math::Float3> points(g_InputCount);
+	std::vector<float> pointsX(g_InputCount);
+	std::vector<float> pointsY(g_InputCount);
+	std::vector<float> pointsZ(g_InputCount);
+	for (size_t index{}; index < g_InputCount; ++index)
+	{
+		points[index] = math::Float3{ m_Vectors[index].x, m_Vectors[index].y, m_Vectors[index].z };
+		pointsX[index] = points[index].x;
+		pointsY[index] = points[index].y;
+		pointsZ[index] = points[index].z;
+	}
+
+	const math::Float4x4& transform = m_Matrices.front();
+	const math::Matrix engineMatrix{ math::LoadFloat4x4(&transform) };
+	const XMMATRIX directXMatrix{ XMLoadFloat4x4(ToDirectX(&transform)) };
+
+	// Both libraries write the same outputs, so the memory layout doesn't favour either
+	std::vector<math::Float3> output3(g_InputCount);
+	std::vector<math::Float4> output4(g_InputCount);
+	std::vector<float> outputX(g_InputCount);
+	std::vector<float> outputY(g_InputCount);
+	std::vector<float> outputZ(g_InputCount);
+
+	const auto measure = [](auto batch)
+	{
+		const auto startTime{ steady_clock::now() };
+		for (int repetition{}; repetition < g_Repetitions; ++repetition) batch();
+		return duration<double, std::nano>(steady_clock::now() - startTime).count() / (static_cast<double>(g_Repetitions) * g_InputCount);
+	};
+
+	// AoS points, both libraries stream the whole array
+	const auto engineStream3 = [&]() { math::Vector3TransformCoordStream(output3.data(), points.data(), g_InputCount, engineMatrix); };
+	const auto directXStream3 = [&]()
+	{
+		XMVector3TransformCoordStream(reinterpret_cast<XMFLOAT3*>(output3.data()), sizeof(XMFLOAT3),
+			reinterpret_cast<const XMFLOAT3*>(points.data()), sizeof(XMFLOAT3), g_InputCount, directXMatrix);
+	};
+
+	const auto engineStream4 = [&]() { math::Vector4TransformStream(output4.data(), m_Vectors.data(), g_InputCount, engineMatrix); };
+	const auto directXStream4 = [&]()
+	{
+		XMVector4TransformStream(reinterpret_cast<XMFLOAT4*>(output4.data()), sizeof(XMFLOAT4),
+			ToDirectX(m_Vectors.data()), sizeof(XMFLOAT4), g_InputCount, directXMatrix);
+	};
+
+	// SoA has no DirectXMath counterpart, it is held against the AoS stream
+	const auto engineSoA = [&]()
+	{
+		math::Vector3TransformCoordSoA(outputX.data(), outputY.data(), outputZ.data(), pointsX.data(), pointsY.data(), pointsZ.data(), g_InputCount, transform);
+	};
+
+	// Reference results first
+	directXStream3();
+	directXStream4();
+	const std::vector<math::Float3> expected3{ output3 };
+	const std::vector<math::Float4> expected4{ output4 };
+
+	engineStream3();
+	engineStream4();
+	engineSoA();
+
+	float stream3Error{};
+	float stream4Error{};
+	float soaError{};
+	for (size_t index{}; index < g_InputCount; ++index)
+	{
+		TrackError(stream3Error, RelativeError(output3[index].x, expected3[index].x));
+		TrackError(stream3Error, RelativeError(output3[index].y, expected3[index].y));
+		TrackError(stream3Error, RelativeError(output3[index].z, expected3[index].z));
+
+		TrackError(soaError, RelativeError(outputX[index], expected3[index].x));
+		TrackError(soaError, RelativeError(outputY[index], expected3[index].y));
+		TrackError(soaError, RelativeError(outputZ[index], expected3[index].z));
+
+		TrackError(stream4Error, RelativeError(output4[index].x, expected4[index].x));
+		TrackError(stream4Error, RelativeError(output4[index].y, expected4[index].y));
+		TrackError(stream4Error, RelativeError(output4[index].z, expected4[index].z));
+		TrackError(stream4Error, RelativeError(output4[index].w, expected4[index].w));
+	}
+
+	const double directXStream3Ns{ measure(directXStream3) };
+	m_Results.push_back(Result{ L"Vector3TransformCoordStream", stream3Error, measure(engineStream3), directXStream3Ns });
+	m_Results.push_back(Result{ L"Vector4TransformStream", stream4Error, measure(engineStream4), measure(directXStream4) });
+	m_Results.push_back(Result{ L"Vector3TransformCoordSoA", soaError, measure(engineSoA), directXStream3Ns });
+}
+bool MathBenchmark::LogResults() const
+{
+	std::wstringstream header;
+	header << L"Math: batch functions use " << math::GetSimdLevelName(math::GetBatchSimdLevel()) << L", errors relative to DirectXMath";
+	Logger::Log(header.str());
+
+	bool isMatching{ true };
+	for (const Result& result : m_Results)
+	{
+		std::wstringstream message;
+		if (!(result.maxError <= g_Tolerance))
+		{
+			message << L"ERROR - ";
+			isMatching = false;
+		}
+
+		message << L"Math: " << result.pName << L" max error " << result.maxError << L", "
+			<< result.engineNs << L" ns engine, " << result.directXNs << L" ns DirectXMath";
+		Logger::Log(message.str());
+	}
+	return isMatching;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "EngineMath.h"
+
+#include <vector>
+
+// Checks the engine math against DirectXMath on random inputs and times both
+// Every result is logged, a mismatch above the tolerance is logged as an error
+class MathBenchmark final
+{
+public:
+	// Structs
+	struct Result
+	{
+		const wchar_t* pName;
+		float maxError;			// Relative to the DirectXMath result
+		double engineNs;		// Per operation, or per element for the batch functions
+		double directXNs;
+	};
+
+	// Rule of five
+	MathBenchmark();
+	~MathBenchmark() = default;
+
+	MathBenchmark(const MathBenchmark& other) = delete;
+	MathBenchmark(MathBenchmark&& other) = delete;
+	MathBenchmark& operator= (const MathBenchmark& other) = delete;
+	MathBenchmark& operator= (MathBenchmark&& other) = delete;
+
+	// Publics
+	bool Run();	// False when a result is off by more than the tolerance
+
+	const std::vector<Result>& GetResults() const { return m_Results; }
+
+private:
+	// Member variables
+	std::vector<math::Float4> m_Vectors;
+	std::vector<math::Float4> m_Quaternions;
+	std::vector<math::Float4x4> m_Matrices;
+	std::vector<Result> m_Results;
+
+	// Member functions
+	template <typename EngineOperation, typename DirectXOperation>
+	void Compare(const wchar_t* pName, EngineOperation engineOperation, DirectXOperation directXOperation);
+	void CompareBatches();
+	bool LogResults() const;
+};
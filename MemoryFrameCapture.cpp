@@ -0,0 +1,126 @@
+#include "MemoryFrameCapture.h"
+#include "Logger.h"
+
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+MemoryFrameCapture::MemoryFrameCapture()
+	: m_Slots{}
+	, m_Encoder{}
+	, m_Capturing{ false }
+	, m_Stopping{ false }
+	, m_NextCaptureIndex{}
+	, m_CapturedFrames{}
+	, m_DroppedFrames{}
+	, m_SessionFrames{}
+	, m_RenderThreadMs{}
+{
+	for (Slot& slot : m_Slots)
+	{
+		slot.isEncoding = false;
+		slot.encoded.store(false);
+	}
+}
+
+bool MemoryFrameCapture::Start(FrameCaptureEncoder::Format format, const std::wstring& outputPath)
+{
+	// Previous session still draining
+	if (m_Capturing || m_Stopping) return false;
+
+	m_Encoder.Begin(format, outputPath);
+
+	m_Capturing = true;
+	m_NextCaptureIndex = 0;
+	m_SessionFrames = 0;
+	m_RenderThreadMs = 0.0;
+
+	Logger::Log(L"Capture started");
+	return true;
+}
+void MemoryFrameCapture::Stop()
+{
+	if (!m_Capturing) return;
+
+	// Frames being encoded are still written, the session ends once they drained
+	m_Capturing = false;
+	m_Stopping = true;
+}
+
+void MemoryFrameCapture::CaptureFrame(const uint32_t* pPixels, uint32_t width, uint32_t height)
+{
+	if (!m_Capturing && !m_Stopping) return;
+
+	const auto startTime{ std::chrono::steady_clock::now() };
+
+	RecycleEncodedSlots();
+	if (m_Capturing) CopyIntoFreeSlot(pPixels, width, height);
+
+	// Close the session once everything is written
+	if (m_Stopping)
+	{
+		bool drained{ true };
+		for (const Slot& slot : m_Slots) drained = drained && !slot.isEncoding;
+
+		if (drained)
+		{
+			m_Encoder.End();
+			m_Stopping = false;
+			LogStatistics();
+		}
+	}
+
+	m_RenderThreadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+void MemoryFrameCapture::LogStatistics() const
+{
+	const double averageMs{ m_SessionFrames ? m_RenderThreadMs / m_SessionFrames : 0.0 };
+
+	std::wstringstream message;
+	message << L"Capture: " << m_CapturedFrames << L" captured, " << m_DroppedFrames << L" dropped, "
+		<< m_Encoder.GetEncodedCount() << L" encoded, " << averageMs << L" ms per frame on the render thread, "
+		<< m_Encoder.GetEncodeMs() << L" ms encoding on the worker";
+	Logger::Log(message.str());
+}
+
+// Privates
+// --------
+void MemoryFrameCapture::RecycleEncodedSlots()
+{
+	for (Slot& slot : m_Slots)
+	{
+		if (slot.isEncoding && slot.encoded.load(std::memory_order_acquire)) slot.isEncoding = false;
+	}
+}
+void MemoryFrameCapture::CopyIntoFreeSlot(const uint32_t* pPixels, uint32_t width, uint32_t height)
+{
+	for (Slot& slot : m_Slots)
+	{
+		if (slot.isEncoding) continue;
+
+		// Keeps its allocation while the backBuffer keeps its size
+		slot.pixels.resize(static_cast<size_t>(width) * height);
+		std::memcpy(slot.pixels.data(), pPixels, slot.pixels.size() * sizeof(uint32_t));
+
+		slot.encoded.store(false, std::memory_order_relaxed);
+		slot.isEncoding = true;
+
+		// Little endian 0xAARRGGBB is BGRA8 in memory, like the D3D11 backBuffer
+		m_Encoder.Submit(FrameCaptureEncoder::Frame
+		{
+			reinterpret_cast<const uint8_t*>(slot.pixels.data()),
+			width,
+			height,
+			width * static_cast<uint32_t>(sizeof(uint32_t)),
+			m_NextCaptureIndex++,
+			&slot.encoded
+		});
+
+		++m_CapturedFrames;
+		++m_SessionFrames;
+		return;
+	}
+
+	// Every slot is being encoded
+	++m_DroppedFrames;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "FrameCaptureEncoder.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Capture for the backends whose frames already are in memory, the null and software devices
+// Every frame is copied into a ring of buffers the encoder reads from, that copy is all the render thread pays
+// When every buffer is still being encoded the frame is dropped, the render thread never blocks
+class MemoryFrameCapture final
+{
+public:
+	// Rule of five
+	MemoryFrameCapture();
+	~MemoryFrameCapture() = default;
+
+	MemoryFrameCapture(const MemoryFrameCapture& other) = delete;
+	MemoryFrameCapture(MemoryFrameCapture&& other) = delete;
+	MemoryFrameCapture& operator= (const MemoryFrameCapture& other) = delete;
+	MemoryFrameCapture& operator= (MemoryFrameCapture&& other) = delete;
+
+	// Publics
+	bool Start(FrameCaptureEncoder::Format format, const std::wstring& outputPath);
+	void Stop();
+	bool IsCapturing() const { return m_Capturing; }
+
+	void CaptureFrame(const uint32_t* pPixels, uint32_t width, uint32_t height);	// 0xAARRGGBB, call every Present, also closes stopped sessions
+	void LogStatistics() const;
+
+private:
+	// Structs
+	struct Slot
+	{
+		std::vector<uint32_t> pixels;
+		bool isEncoding;
+		std::atomic<bool> encoded;
+	};
+
+	static constexpr uint32_t g_SlotCount{ 6 };
+
+	// Member variables
+	std::array<Slot, g_SlotCount> m_Slots;
+	FrameCaptureEncoder m_Encoder;		// After the slots, its worker is joined before their pixels go away
+
+	bool m_Capturing;
+	bool m_Stopping;
+	uint64_t m_NextCaptureIndex;
+
+	uint64_t m_CapturedFrames;
+	uint64_t m_DroppedFrames;
+	uint64_t m_SessionFrames;
+	double m_RenderThreadMs;
+
+	// Member functions
+	void RecycleEncodedSlots();
+	void CopyIntoFreeSlot(const uint32_t* pPixels, uint32_t width, uint32_t height);
+};
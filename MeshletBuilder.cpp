@@ -0,0 +1,206 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	constexpr uint8_t g_NotInMeshlet{ 0xFF };
+
+	// Narrower cones than this are still worth testing, wider ones almost never cull
+	constexpr float g_MinConeDot{ 0.1f };
+}
+
+void MeshletBuilder::Build(const void* pPositions, uint32_t positionStride, uint32_t vertexCount, const uint32_t* pIndices, uint32_t indexCount)
+{
+	using namespace std::chrono;
+	const steady_clock::time_point startTime{ steady_clock::now() };
+
+	m_Meshlets.clear();
+	m_Vertices.clear();
+	m_Triangles.clear();
+	m_Statistics = Statistics{};
+
+	const uint32_t triangleCount{ indexCount / 3 };
+	if (vertexCount == 0 || triangleCount == 0) return;
+
+	std::vector<math::Float3> positions(vertexCount);
+	for (uint32_t vertexIndex{}; vertexIndex < vertexCount; ++vertexIndex)
+	{
+		std::memcpy(&positions[vertexIndex], static_cast<const char*>(pPositions) + static_cast<size_t>(vertexIndex) * positionStride, sizeof(math::Float3));
+	}
+
+	// Triangles around every vertex, in one flat array
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (uint32_t index{}; index < triangleCount * 3; ++index) ++adjacencyOffsets[pIndices[index] + 1];
+	for (uint32_t vertexIndex{}; vertexIndex < vertexCount; ++vertexIndex) adjacencyOffsets[vertexIndex + 1] += adjacencyOffsets[vertexIndex];
+
+	std::vector<uint32_t> adjacency(adjacencyOffsets.back());
+	std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (uint32_t index{}; index < triangleCount * 3; ++index) adjacency[adjacencyFill[pIndices[index]]++] = index / 3;
+
+	std::vector<uint8_t> usedTriangles(triangleCount, 0);
+	std::vector<uint8_t> localIndices(vertexCount, g_NotInMeshlet);
+
+	Meshlet meshlet{};
+	const auto finishMeshlet = [&]()
+	{
+		for (uint32_t localIndex{}; localIndex < meshlet.vertexCount; ++localIndex)
+		{
+			localIndices[m_Vertices[meshlet.vertexOffset + localIndex]] = g_NotInMeshlet;
+		}
+
+		ComputeBounds(meshlet, positions);
+		m_Meshlets.push_back(meshlet);
+
+		meshlet = Meshlet{};
+		meshlet.vertexOffset = static_cast<uint32_t>(m_Vertices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(m_Triangles.size() / 3);
+	};
+	const auto countNewVertices = [&](uint32_t triangleIndex)
+	{
+		uint32_t newVertices{};
+		for (uint32_t corner{}; corner < 3; ++corner)
+		{
+			if (localIndices[pIndices[triangleIndex * 3 + corner]] == g_NotInMeshlet) ++newVertices;
+		}
+		return newVertices;
+	};
+	const auto addTriangle = [&](uint32_t triangleIndex)
+	{
+		for (uint32_t corner{}; corner < 3; ++corner)
+		{
+			const uint32_t vertexIndex{ pIndices[triangleIndex * 3 + corner] };
+			if (localIndices[vertexIndex] == g_NotInMeshlet)
+			{
+				localIndices[vertexIndex] = static_cast<uint8_t>(meshlet.vertexCount++);
+				m_Vertices.push_back(vertexIndex);
+			}
+			m_Triangles.push_back(localIndices[vertexIndex]);
+		}
+
+		usedTriangles[triangleIndex] = 1;
+		++meshlet.triangleCount;
+	};
+
+	uint32_t seedTriangle{};
+	for (;;)
+	{
+		// Grow over the triangles that touch the meshlet, the fewer new vertices they bring the better
+		uint32_t bestTriangle{ triangleCount };
+		uint32_t bestNewVertices{ 4 };
+		for (uint32_t localIndex{}; localIndex < meshlet.vertexCount && bestNewVertices > 0; ++localIndex)
+		{
+			const uint32_t vertexIndex{ m_Vertices[meshlet.vertexOffset + localIndex] };
+			for (uint32_t adjacencyIndex{ adjacencyOffsets[vertexIndex] }; adjacencyIndex < adjacencyOffsets[vertexIndex + 1]; ++adjacencyIndex)
+			{
+				const uint32_t triangleIndex{ adjacency[adjacencyIndex] };
+				if (usedTriangles[triangleIndex]) continue;
+
+				const uint32_t newVertices{ countNewVertices(triangleIndex) };
+				if (newVertices < bestNewVertices)
+				{
+					bestTriangle = triangleIndex;
+					bestNewVertices = newVertices;
+					if (newVertices == 0) break;
+				}
+			}
+		}
+
+		// Nothing connected left, continue from the next unused triangle in index order
+		if (bestTriangle == triangleCount)
+		{
+			while (seedTriangle < triangleCount && usedTriangles[seedTriangle]) ++seedTriangle;
+			if (seedTriangle == triangleCount) break;
+
+			bestTriangle = seedTriangle;
+			bestNewVertices = countNewVertices(seedTriangle);
+		}
+
+		if (meshlet.vertexCount + bestNewVertices > g_MaxVertices || meshlet.triangleCount == g_MaxTriangles)
+		{
+			finishMeshlet();
+			continue;
+		}
+
+		addTriangle(bestTriangle);
+	}
+
+	if (meshlet.triangleCount > 0) finishMeshlet();
+
+	m_Statistics.buildMs = duration<double, std::milli>(steady_clock::now() - startTime).count();
+	m_Statistics.meshletCount = static_cast<uint32_t>(m_Meshlets.size());
+	m_Statistics.triangleCount = triangleCount;
+	m_Statistics.averageVertices = static_cast<float>(m_Vertices.size()) / m_Meshlets.size();
+	m_Statistics.averageTriangles = static_cast<float>(triangleCount) / m_Meshlets.size();
+}
+
+// Privates
+// --------
+void MeshletBuilder::ComputeBounds(Meshlet& meshlet, const std::vector<math::Float3>& positions) const
+{
+	using namespace math;
+
+	// Sphere around the box of the vertices
+	Vector minimum{ LoadFloat3(&positions[m_Vertices[meshlet.vertexOffset]]) };
+	Vector maximum{ minimum };
+	for (uint32_t localIndex{ 1 }; localIndex < meshlet.vertexCount; ++localIndex)
+	{
+		const Vector position{ LoadFloat3(&positions[m_Vertices[meshlet.vertexOffset + localIndex]]) };
+		minimum = VectorMin(minimum, position);
+		maximum = VectorMax(maximum, position);
+	}
+
+	const Vector center{ VectorScale(VectorAdd(minimum, maximum), 0.5f) };
+	float radius{};
+	for (uint32_t localIndex{}; localIndex < meshlet.vertexCount; ++localIndex)
+	{
+		const Vector position{ LoadFloat3(&positions[m_Vertices[meshlet.vertexOffset + localIndex]]) };
+		radius = (std::max)(radius, VectorGetX(Vector3Length(VectorSubtract(position, center))));
+	}
+
+	StoreFloat4(&meshlet.boundingSphere, center);
+	meshlet.boundingSphere.w = radius;
+
+	// Clockwise front faces, so the cross product of the edges points out of the front
+	const uint8_t* pTriangles{ m_Triangles.data() + static_cast<size_t>(meshlet.triangleOffset) * 3 };
+	std::vector<Float3> normals;
+	normals.reserve(meshlet.triangleCount);
+
+	Vector axis{ VectorZero() };
+	for (uint32_t triangleIndex{}; triangleIndex < meshlet.triangleCount; ++triangleIndex)
+	{
+		const Vector p0{ LoadFloat3(&positions[m_Vertices[meshlet.vertexOffset + pTriangles[triangleIndex * 3 + 0]]]) };
+		const Vector p1{ LoadFloat3(&positions[m_Vertices[meshlet.vertexOffset + pTriangles[triangleIndex * 3 + 1]]]) };
+		const Vector p2{ LoadFloat3(&positions[m_Vertices[meshlet.vertexOffset + pTriangles[triangleIndex * 3 + 2]]]) };
+
+		const Vector normal{ Vector3Cross(VectorSubtract(p1, p0), VectorSubtract(p2, p0)) };
+		const float length{ VectorGetX(Vector3Length(normal)) };
+		if (length <= 1e-12f) continue;		// Degenerate, faces nowhere
+
+		const Vector unitNormal{ VectorScale(normal, 1.f / length) };
+		normals.push_back(Float3{});
+		StoreFloat3(&normals.back(), unitNormal);
+		axis = VectorAdd(axis, unitNormal);
+	}
+
+	meshlet.cone = Float4{ 0.f, 0.f, 0.f, 1.f };
+	const float axisLength{ VectorGetX(Vector3Length(axis)) };
+	if (normals.empty() || axisLength <= 1e-6f) return;
+
+	axis = VectorScale(axis, 1.f / axisLength);
+
+	float minimumDot{ 1.f };
+	for (const Float3& normal : normals)
+	{
+		minimumDot = (std::min)(minimumDot, VectorGetX(Vector3Dot(axis, LoadFloat3(&normal))));
+	}
+
+	if (minimumDot <= g_MinConeDot) return;
+
+	// Backfacing for every view direction within 90 degrees minus the spread of the axis
+	StoreFloat4(&meshlet.cone, axis);
+	meshlet.cone.w = std::sqrt(1.f - minimumDot * minimumDot);
+}
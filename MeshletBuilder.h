@@ -0,0 +1,65 @@
+#pragma once
+
+#include "EngineMath.h"
+
+#include <cstdint>
+#include <vector>
+
+// Splits an indexed triangle mesh into meshlets: clusters of at most 64 vertices and 124 triangles with their own bounds
+// Meshlets grow over shared vertices, so they stay compact and their normal cone stays narrow enough to cull backfaces
+// Runs once when the mesh is loaded, MeshletCuller uses the result every frame
+class MeshletBuilder final
+{
+public:
+	// Structs
+	struct Meshlet
+	{
+		math::Float4 boundingSphere;	// xyz = center, w = radius, in object space
+		math::Float4 cone;				// xyz = average front face normal, w = sine of the spread, 1 when it can't be backface culled
+		uint32_t vertexOffset;			// Into the meshlet vertices
+		uint32_t triangleOffset;		// Into the meshlet triangles, 3 local vertex indices per triangle
+		uint32_t vertexCount;
+		uint32_t triangleCount;
+	};
+
+	struct Statistics
+	{
+		double buildMs;
+		uint32_t meshletCount;
+		uint32_t triangleCount;
+		float averageVertices;			// Per meshlet, the closer to the maximum the fewer meshlets to cull
+		float averageTriangles;
+	};
+
+	static constexpr uint32_t g_MaxVertices{ 64 };
+	static constexpr uint32_t g_MaxTriangles{ 124 };	// Keeps the 3 byte local indices of a meshlet a multiple of 4 bytes
+
+	// Rule of five
+	MeshletBuilder() = default;
+	~MeshletBuilder() = default;
+
+	MeshletBuilder(const MeshletBuilder& other) = delete;
+	MeshletBuilder(MeshletBuilder&& other) = delete;
+	MeshletBuilder& operator= (const MeshletBuilder& other) = delete;
+	MeshletBuilder& operator= (MeshletBuilder&& other) = delete;
+
+	// Publics
+	// Positions are read with the given stride, so the vertex buffer data can be passed as is
+	void Build(const void* pPositions, uint32_t positionStride, uint32_t vertexCount, const uint32_t* pIndices, uint32_t indexCount);
+
+	const std::vector<Meshlet>& GetMeshlets() const { return m_Meshlets; }
+	const std::vector<uint32_t>& GetVertices() const { return m_Vertices; }		// Mesh vertex index per meshlet vertex
+	const std::vector<uint8_t>& GetTriangles() const { return m_Triangles; }
+	const Statistics& GetStatistics() const { return m_Statistics; }
+
+private:
+	// Member variables
+	std::vector<Meshlet> m_Meshlets;
+	std::vector<uint32_t> m_Vertices;
+	std::vector<uint8_t> m_Triangles;
+
+	Statistics m_Statistics{};
+
+	// Member functions
+	void ComputeBounds(Meshlet& meshlet, const std::vector<math::Float3>& positions) const;
+};
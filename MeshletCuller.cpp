@@ -0,0 +1,91 @@
+#include "MeshletCuller.h"
+#include "MultiViewCuller.h"
+
+#include <chrono>
+
+void MeshletCuller::SetMeshlets(const MeshletBuilder& builder)
+{
+	const std::vector<MeshletBuilder::Meshlet>& meshlets = builder.GetMeshlets();
+	const std::vector<uint32_t>& vertices = builder.GetVertices();
+	const std::vector<uint8_t>& triangles = builder.GetTriangles();
+
+	m_Clusters.clear();
+	m_MeshletIndices.clear();
+	m_Clusters.reserve(meshlets.size());
+	m_MeshletIndices.reserve(triangles.size());
+
+	for (const MeshletBuilder::Meshlet& meshlet : meshlets)
+	{
+		const uint32_t firstIndex{ static_cast<uint32_t>(m_MeshletIndices.size()) };
+		for (uint32_t index{}; index < meshlet.triangleCount * 3; ++index)
+		{
+			m_MeshletIndices.push_back(vertices[meshlet.vertexOffset + triangles[static_cast<size_t>(meshlet.triangleOffset) * 3 + index]]);
+		}
+
+		m_Clusters.push_back(Cluster{ meshlet.boundingSphere, meshlet.cone, firstIndex, meshlet.triangleCount * 3 });
+	}
+}
+
+void MeshletCuller::Begin()
+{
+	m_Indices.clear();
+	m_Statistics = Statistics{};
+}
+MeshletCuller::DrawRange MeshletCuller::Cull(uint32_t objectIndex, const math::Float4x4& worldMatrix, const RenderView& view)
+{
+	using namespace math;
+	using namespace std::chrono;
+	const steady_clock::time_point startTime{ steady_clock::now() };
+
+	const Matrix world{ LoadFloat4x4(&worldMatrix) };
+
+	Float4x4 worldViewProjection{};
+	StoreFloat4x4(&worldViewProjection, world * LoadFloat4x4(&view.viewProjectionMatrix));
+	const MultiViewCuller::FrustumPlanes frustum{ MultiViewCuller::ExtractPlanes(worldViewProjection) };
+
+	const Vector cameraPosition{ Vector3TransformCoord(LoadFloat3(&view.position), MatrixInverse(world)) };
+
+	DrawRange range{ objectIndex, static_cast<uint32_t>(m_Indices.size()), 0 };
+	for (const Cluster& cluster : m_Clusters)
+	{
+		const Vector sphere{ LoadFloat4(&cluster.boundingSphere) };
+		const float radius{ cluster.boundingSphere.w };
+
+		++m_Statistics.testedMeshlets;
+		m_Statistics.testedTriangles += cluster.indexCount / 3;
+
+		// Outside of any plane
+		bool outside{ false };
+		for (const Float4& plane : frustum.planes)
+		{
+			if (VectorGetX(Vector3Dot(LoadFloat4(&plane), sphere)) + plane.w < -radius)
+			{
+				outside = true;
+				break;
+			}
+		}
+
+		if (outside)
+		{
+			++m_Statistics.frustumCulled;
+			m_Statistics.rejectedTriangles += cluster.indexCount / 3;
+			continue;
+		}
+
+		// Every triangle faces away when the camera looks along the cone, with the sphere as margin
+		const Vector toCluster{ VectorSubtract(sphere, cameraPosition) };
+		const float alongAxis{ VectorGetX(Vector3Dot(toCluster, LoadFloat4(&cluster.cone))) };
+		if (alongAxis >= cluster.cone.w * VectorGetX(Vector3Length(toCluster)) + radius)
+		{
+			++m_Statistics.backfaceCulled;
+			m_Statistics.rejectedTriangles += cluster.indexCount / 3;
+			continue;
+		}
+
+		m_Indices.insert(m_Indices.end(), m_MeshletIndices.begin() + cluster.firstIndex, m_MeshletIndices.begin() + cluster.firstIndex + cluster.indexCount);
+		range.indexCount += cluster.indexCount;
+	}
+
+	m_Statistics.cullMs += duration<double, std::milli>(steady_clock::now() - startTime).count();
+	return range;
+}
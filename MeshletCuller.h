@@ -0,0 +1,69 @@
+#pragma once
+
+#include "EngineMath.h"
+#include "MeshletBuilder.h"
+#include "RenderView.h"
+
+#include <cstdint>
+#include <vector>
+
+// Culls the meshlets of one mesh per instance and view, the surviving triangles are compacted into one index list
+// Both tests run in object space: the frustum planes come from world * viewProjection and the camera is moved into the object,
+// so the meshlet bounds are never transformed. Assumes uniform scale, like the scene bounds
+class MeshletCuller final
+{
+public:
+	// Structs
+	struct DrawRange
+	{
+		uint32_t objectIndex;
+		uint32_t firstIndex;			// Into GetIndices
+		uint32_t indexCount;
+	};
+
+	struct Statistics					// Since Begin
+	{
+		double cullMs;
+		uint32_t testedMeshlets;
+		uint32_t frustumCulled;
+		uint32_t backfaceCulled;
+		uint64_t testedTriangles;
+		uint64_t rejectedTriangles;
+	};
+
+	// Rule of five
+	MeshletCuller() = default;
+	~MeshletCuller() = default;
+
+	MeshletCuller(const MeshletCuller& other) = delete;
+	MeshletCuller(MeshletCuller&& other) = delete;
+	MeshletCuller& operator= (const MeshletCuller& other) = delete;
+	MeshletCuller& operator= (MeshletCuller&& other) = delete;
+
+	// Publics
+	void SetMeshlets(const MeshletBuilder& builder);
+
+	void Begin();		// Once per frame, drops the previous indices
+	DrawRange Cull(uint32_t objectIndex, const math::Float4x4& worldMatrix, const RenderView& view);	// Appends the visible triangles
+
+	const std::vector<uint32_t>& GetIndices() const { return m_Indices; }	// Mesh vertex indices, 3 per triangle
+	uint32_t GetMeshIndexCount() const { return static_cast<uint32_t>(m_MeshletIndices.size()); }
+	const Statistics& GetStatistics() const { return m_Statistics; }
+
+private:
+	// Structs
+	struct Cluster
+	{
+		math::Float4 boundingSphere;
+		math::Float4 cone;
+		uint32_t firstIndex;			// Into m_MeshletIndices
+		uint32_t indexCount;
+	};
+
+	// Member variables
+	std::vector<Cluster> m_Clusters;
+	std::vector<uint32_t> m_MeshletIndices;	// Every meshlet expanded to mesh indices, so a survivor is one copy
+	std::vector<uint32_t> m_Indices;
+
+	Statistics m_Statistics{};
+};
@@ -0,0 +1,298 @@
+#include "MultiViewCuller.h"
+
+#include <ppl.h>
+#include <intrin.h>
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+	// Padding lanes never intersect anything
+	constexpr float g_OutOfReach{ 1e30f };
+
+	// Candidates per job when testing a group
+	constexpr size_t g_CandidatesPerJob{ 256 };
+
+	// Views are grouped while their merged bounds stay within this factor of the largest view bounds
+	constexpr float g_GroupGrowthLimit{ 2.f };
+}
+
+void MultiViewCuller::SetObjects(const std::vector<math::Float4>& worldSpheres)
+{
+	m_ObjectCount = static_cast<uint32_t>(worldSpheres.size());
+	const size_t paddedCount{ (worldSpheres.size() + 3) & ~static_cast<size_t>(3) };
+
+	m_CenterX.assign(paddedCount, g_OutOfReach);
+	m_CenterY.assign(paddedCount, g_OutOfReach);
+	m_CenterZ.assign(paddedCount, g_OutOfReach);
+	m_Radius.assign(paddedCount, 0.f);
+
+	for (size_t index{}; index < worldSpheres.size(); ++index)
+	{
+		m_CenterX[index] = worldSpheres[index].x;
+		m_CenterY[index] = worldSpheres[index].y;
+		m_CenterZ[index] = worldSpheres[index].z;
+		m_Radius[index] = worldSpheres[index].w;
+	}
+}
+void MultiViewCuller::Cull(const std::vector<RenderView>& views)
+{
+	using namespace std::chrono;
+
+	const uint32_t viewCount{ (std::min)(static_cast<uint32_t>(views.size()), g_MaxViews) };
+
+	m_Statistics = Statistics{};
+	m_Statistics.objectCount = m_ObjectCount;
+	m_Statistics.viewCount = viewCount;
+
+	m_ViewMasks.assign(m_ObjectCount, 0);
+	m_VisibleObjects.resize(viewCount);
+	for (std::vector<uint32_t>& visibleObjects : m_VisibleObjects) visibleObjects.clear();
+
+	// Shared: frusta and groups
+	auto startTime{ steady_clock::now() };
+
+	m_Frusta.resize(viewCount);
+	for (uint32_t viewIndex{}; viewIndex < viewCount; ++viewIndex)
+	{
+		m_Frusta[viewIndex] = ExtractPlanes(views[viewIndex].viewProjectionMatrix);
+	}
+	BuildGroups(views, viewCount);
+	m_Statistics.groupCount = static_cast<uint32_t>(m_Groups.size());
+
+	double sharedMs{ duration<double, std::milli>(steady_clock::now() - startTime).count() };
+
+	for (const ViewGroup& group : m_Groups)
+	{
+		// Shared: one rejection test per object for the whole group
+		startTime = steady_clock::now();
+		GatherGroupCandidates(group);
+		m_Statistics.groupCandidates += static_cast<uint32_t>(m_Candidates.size());
+		sharedMs += duration<double, std::milli>(steady_clock::now() - startTime).count();
+
+		// Per view: only the survivors
+		startTime = steady_clock::now();
+		TestCandidates(group);
+		m_Statistics.perViewMs += duration<double, std::milli>(steady_clock::now() - startTime).count();
+	}
+
+	// Shared: one walk over the objects builds every draw list, in object order
+	startTime = steady_clock::now();
+	for (uint32_t objectIndex{}; objectIndex < m_ObjectCount; ++objectIndex)
+	{
+		uint32_t viewMask{ m_ViewMasks[objectIndex] };
+		while (viewMask)
+		{
+			unsigned long viewIndex{};
+			_BitScanForward(&viewIndex, viewMask);
+			viewMask &= viewMask - 1;
+
+			m_VisibleObjects[viewIndex].push_back(objectIndex);
+			++m_Statistics.visiblePairs;
+		}
+	}
+	sharedMs += duration<double, std::milli>(steady_clock::now() - startTime).count();
+
+	m_Statistics.sharedMs = sharedMs;
+}
+
+MultiViewCuller::FrustumPlanes MultiViewCuller::ExtractPlanes(const math::Float4x4& matrix)
+{
+	using namespace math;
+
+	const auto& m = matrix.m;
+
+	// Gribb-Hartmann, for row-vector matrices and a 0..1 depth range
+	FrustumPlanes frustum{};
+	const Float4 planes[6] =
+	{
+		{ m[0][3] + m[0][0], m[1][3] + m[1][0], m[2][3] + m[2][0], m[3][3] + m[3][0] },	// Left
+		{ m[0][3] - m[0][0], m[1][3] - m[1][0], m[2][3] - m[2][0], m[3][3] - m[3][0] },	// Right
+		{ m[0][3] + m[0][1], m[1][3] + m[1][1], m[2][3] + m[2][1], m[3][3] + m[3][1] },	// Bottom
+		{ m[0][3] - m[0][1], m[1][3] - m[1][1], m[2][3] - m[2][1], m[3][3] - m[3][1] },	// Top
+		{ m[0][2], m[1][2], m[2][2], m[3][2] },								// Near
+		{ m[0][3] - m[0][2], m[1][3] - m[1][2], m[2][3] - m[2][2], m[3][3] - m[3][2] }	// Far
+	};
+
+	for (int index{}; index < 6; ++index)
+	{
+		StoreFloat4(&frustum.planes[index], PlaneNormalize(LoadFloat4(&planes[index])));
+	}
+
+	return frustum;
+}
+
+// Privates
+// --------
+math::Float4 MultiViewCuller::ComputeFrustumSphere(const math::Float4x4& viewProjectionMatrix)
+{
+	using namespace math;
+
+	// Unproject the 8 clip space corners
+	const Matrix inverseViewProjection = MatrixInverse(LoadFloat4x4(&viewProjectionMatrix));
+
+	Vector corners[8];
+	Vector center{ VectorZero() };
+	for (int index{}; index < 8; ++index)
+	{
+		const Vector clipCorner{ VectorSet(index & 1 ? 1.f : -1.f, index & 2 ? 1.f : -1.f, index & 4 ? 1.f : 0.f, 1.f) };
+		corners[index] = Vector3TransformCoord(clipCorner, inverseViewProjection);
+		center = VectorAdd(center, corners[index]);
+	}
+	center = VectorScale(center, 1.f / 8.f);
+
+	float radius{};
+	for (const Vector& corner : corners)
+	{
+		radius = (std::max)(radius, VectorGetX(Vector3Length(VectorSubtract(corner, center))));
+	}
+
+	Float4 sphere{};
+	StoreFloat4(&sphere, center);
+	sphere.w = radius;
+	return sphere;
+}
+math::Float4 MultiViewCuller::MergeSpheres(const math::Float4& first, const math::Float4& second)
+{
+	using namespace math;
+
+	const Vector firstCenter{ LoadFloat4(&first) };
+	const Vector secondCenter{ LoadFloat4(&second) };
+	const Vector offset{ VectorSetW(VectorSubtract(secondCenter, firstCenter), 0.f) };
+	const float distance{ VectorGetX(Vector3Length(offset)) };
+
+	// One contains the other
+	if (distance + second.w <= first.w) return first;
+	if (distance + first.w <= second.w) return second;
+
+	const float radius{ (distance + first.w + second.w) * 0.5f };
+	const Vector center{ VectorAdd(firstCenter, VectorScale(offset, (radius - first.w) / distance)) };
+
+	Float4 sphere{};
+	StoreFloat4(&sphere, center);
+	sphere.w = radius;
+	return sphere;
+}
+
+void MultiViewCuller::BuildGroups(const std::vector<RenderView>& views, uint32_t viewCount)
+{
+	m_Groups.clear();
+
+	for (uint32_t viewIndex{}; viewIndex < viewCount; ++viewIndex)
+	{
+		const math::Float4 viewSphere{ ComputeFrustumSphere(views[viewIndex].viewProjectionMatrix) };
+
+		// Join the first group that doesn't grow too much, split-screen players and cubemap faces end up together
+		bool joinedGroup{ false };
+		for (ViewGroup& group : m_Groups)
+		{
+			const math::Float4 mergedSphere{ MergeSpheres(group.sphere, viewSphere) };
+			const float largestViewRadius{ (std::max)(group.largestViewRadius, viewSphere.w) };
+			if (mergedSphere.w <= g_GroupGrowthLimit * largestViewRadius)
+			{
+				group.sphere = mergedSphere;
+				group.largestViewRadius = largestViewRadius;
+				group.viewIndices.push_back(viewIndex);
+				joinedGroup = true;
+				break;
+			}
+		}
+
+		if (!joinedGroup)
+		{
+			m_Groups.push_back(ViewGroup{ viewSphere, viewSphere.w, { viewIndex } });
+		}
+	}
+}
+void MultiViewCuller::GatherGroupCandidates(const ViewGroup& group)
+{
+	using namespace math;
+
+	m_Candidates.clear();
+
+	const Vector groupX{ VectorReplicate(group.sphere.x) };
+	const Vector groupY{ VectorReplicate(group.sphere.y) };
+	const Vector groupZ{ VectorReplicate(group.sphere.z) };
+	const Vector groupRadius{ VectorReplicate(group.sphere.w) };
+
+	// Sphere versus sphere, 4 objects per test
+	for (size_t index{}; index < m_CenterX.size(); index += 4)
+	{
+		const Vector dx{ VectorSubtract(VectorLoad(&m_CenterX[index]), groupX) };
+		const Vector dy{ VectorSubtract(VectorLoad(&m_CenterY[index]), groupY) };
+		const Vector dz{ VectorSubtract(VectorLoad(&m_CenterZ[index]), groupZ) };
+		const Vector reach{ VectorAdd(VectorLoad(&m_Radius[index]), groupRadius) };
+
+		const Vector distanceSquared{ VectorMultiplyAdd(dz, dz, VectorMultiplyAdd(dy, dy, VectorMultiply(dx, dx))) };
+		const Vector overlaps{ VectorLessOrEqual(distanceSquared, VectorMultiply(reach, reach)) };
+
+		uint32_t laneMask[4];
+		StoreInt4(laneMask, overlaps);
+
+		for (size_t lane{}; lane < 4; ++lane)
+		{
+			if (laneMask[lane]) m_Candidates.push_back(static_cast<uint32_t>(index + lane));
+		}
+	}
+}
+void MultiViewCuller::TestCandidates(const ViewGroup& group)
+{
+	using namespace math;
+
+	// Every job owns a range of candidates, so it can write their masks without synchronization
+	const size_t jobCount{ (m_Candidates.size() + g_CandidatesPerJob - 1) / g_CandidatesPerJob };
+
+	Concurrency::parallel_for(size_t{ 0 }, jobCount, [this, &group](size_t jobIndex)
+	{
+		const size_t firstCandidate{ jobIndex * g_CandidatesPerJob };
+		const size_t lastCandidate{ (std::min)(firstCandidate + g_CandidatesPerJob, m_Candidates.size()) };
+
+		for (size_t candidate{ firstCandidate }; candidate < lastCandidate; candidate += 4)
+		{
+			// Gather 4 candidates, padding with unreachable spheres
+			Float4 x{ g_OutOfReach, g_OutOfReach, g_OutOfReach, g_OutOfReach };
+			Float4 y{ x };
+			Float4 z{ x };
+			Float4 radius{};
+
+			uint32_t objectIndices[4]{};
+			const size_t laneCount{ (std::min)(lastCandidate - candidate, size_t{ 4 }) };
+			for (size_t lane{}; lane < laneCount; ++lane)
+			{
+				const uint32_t objectIndex{ m_Candidates[candidate + lane] };
+				objectIndices[lane] = objectIndex;
+				(&x.x)[lane] = m_CenterX[objectIndex];
+				(&y.x)[lane] = m_CenterY[objectIndex];
+				(&z.x)[lane] = m_CenterZ[objectIndex];
+				(&radius.x)[lane] = m_Radius[objectIndex];
+			}
+
+			const Vector centerX{ LoadFloat4(&x) };
+			const Vector centerY{ LoadFloat4(&y) };
+			const Vector centerZ{ LoadFloat4(&z) };
+			const Vector negativeRadius{ VectorNegate(LoadFloat4(&radius)) };
+
+			for (const uint32_t viewIndex : group.viewIndices)
+			{
+				// Inside when no plane has the sphere fully behind it
+				Vector inside{ VectorTrueInt() };
+				for (const Float4& plane : m_Frusta[viewIndex].planes)
+				{
+					const Vector distance{ VectorMultiplyAdd(centerZ, VectorReplicate(plane.z),
+						VectorMultiplyAdd(centerY, VectorReplicate(plane.y),
+						VectorMultiplyAdd(centerX, VectorReplicate(plane.x), VectorReplicate(plane.w)))) };
+
+					inside = VectorAndInt(inside, VectorGreaterOrEqual(distance, negativeRadius));
+				}
+
+				uint32_t laneMask[4];
+				StoreInt4(laneMask, inside);
+
+				for (size_t lane{}; lane < laneCount; ++lane)
+				{
+					if (laneMask[lane]) m_ViewMasks[objectIndices[lane]] |= 1u << viewIndex;
+				}
+			}
+		}
+	});
+}
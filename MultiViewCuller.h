@@ -0,0 +1,86 @@
+#pragma once
+
+#include "RenderView.h"
+
+#include "EngineMath.h"
+
+#include <cstdint>
+#include <vector>
+
+// Culls every object against every view of the frame in one pass
+// Views whose frusta overlap are grouped, objects are first rejected against the group bounds,
+// so only the survivors pay for the per-view plane tests
+class MultiViewCuller final
+{
+public:
+	// Structs
+	struct Statistics
+	{
+		double sharedMs;		// Bounds, group rejection and draw-list building
+		double perViewMs;		// Plane tests of the group survivors
+		uint32_t objectCount;
+		uint32_t viewCount;
+		uint32_t groupCount;
+		uint32_t groupCandidates;
+		uint32_t visiblePairs;
+	};
+
+	struct FrustumPlanes
+	{
+		math::Float4 planes[6];	// Normals point inwards
+	};
+
+	static constexpr uint32_t g_MaxViews{ 32 };	// One bit per view in the visibility mask
+
+	// Rule of five
+	MultiViewCuller() = default;
+	~MultiViewCuller() = default;
+
+	MultiViewCuller(const MultiViewCuller& other) = delete;
+	MultiViewCuller(MultiViewCuller&& other) = delete;
+	MultiViewCuller& operator= (const MultiViewCuller& other) = delete;
+	MultiViewCuller& operator= (MultiViewCuller&& other) = delete;
+
+	// Publics
+	void SetObjects(const std::vector<math::Float4>& worldSpheres);	// xyz = center, w = radius
+	void Cull(const std::vector<RenderView>& views);
+
+	const std::vector<uint32_t>& GetVisibleObjects(uint32_t viewIndex) const { return m_VisibleObjects[viewIndex]; }
+	const std::vector<uint32_t>& GetViewMasks() const { return m_ViewMasks; }
+	const Statistics& GetStatistics() const { return m_Statistics; }
+
+	// Planes in the space the matrix transforms from, pass world * viewProjection for object space planes
+	static FrustumPlanes ExtractPlanes(const math::Float4x4& viewProjectionMatrix);
+
+private:
+	// Structs
+	struct ViewGroup
+	{
+		math::Float4 sphere;
+		float largestViewRadius;		// Measured against, not the group sphere, or groups would keep chaining further views
+		std::vector<uint32_t> viewIndices;
+	};
+
+	// Member variables
+	std::vector<float> m_CenterX;		// SoA, padded to a multiple of 4
+	std::vector<float> m_CenterY;
+	std::vector<float> m_CenterZ;
+	std::vector<float> m_Radius;
+	uint32_t m_ObjectCount{};
+
+	std::vector<FrustumPlanes> m_Frusta;
+	std::vector<ViewGroup> m_Groups;
+	std::vector<uint32_t> m_Candidates;
+	std::vector<uint32_t> m_ViewMasks;
+	std::vector<std::vector<uint32_t>> m_VisibleObjects;
+
+	Statistics m_Statistics{};
+
+	// Member functions
+	static math::Float4 ComputeFrustumSphere(const math::Float4x4& viewProjectionMatrix);
+	static math::Float4 MergeSpheres(const math::Float4& first, const math::Float4& second);
+
+	void BuildGroups(const std::vector<RenderView>& views, uint32_t viewCount);
+	void GatherGroupCandidates(const ViewGroup& group);
+	void TestCandidates(const ViewGroup& group);
+};
@@ -0,0 +1,170 @@
+#include "MultiViewCullingBenchmark.h"
+#include "Logger.h"
+#include "MultiViewCuller.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <sstream>
+
+using namespace math;
+
+namespace
+{
+	constexpr uint32_t g_ObjectCount{ 16384 };
+	constexpr float g_WorldExtent{ 120.f };		// Objects and probes within +-extent on every axis
+
+	constexpr uint32_t g_ViewCounts[]{ 1, 2, 4, 8, 16, MultiViewCuller::g_MaxViews };
+	constexpr int g_Iterations{ 16 };
+
+	constexpr float g_NearZ{ 0.1f };
+	constexpr float g_FarZ{ 40.f };
+
+	volatile uint32_t g_Sink{};
+
+	std::vector<Float4> CreateObjects()
+	{
+		std::mt19937 randomEngine{ 1337 };	// Fixed seed, same scene every run
+		std::uniform_real_distribution<float> position{ -g_WorldExtent, g_WorldExtent };
+		std::uniform_real_distribution<float> radius{ 0.2f, 1.5f };
+
+		std::vector<Float4> spheres(g_ObjectCount);
+		for (Float4& sphere : spheres) sphere = Float4{ position(randomEngine), position(randomEngine), position(randomEngine), radius(randomEngine) };
+		return spheres;
+	}
+
+	// Cubemaps around probes spread through the scene, like reflection probes or point light shadows, the faces of a probe overlap
+	std::vector<RenderView> CreateViews()
+	{
+		std::mt19937 randomEngine{ 7331 };
+		std::uniform_real_distribution<float> position{ -g_WorldExtent * 0.75f, g_WorldExtent * 0.75f };
+
+		std::vector<RenderView> views;
+		while (views.size() < MultiViewCuller::g_MaxViews)
+		{
+			const Float3 probePosition{ position(randomEngine), position(randomEngine), position(randomEngine) };
+			for (const RenderView& face : RenderView::CreateCubemap(probePosition, g_NearZ, g_FarZ, Float4{ 0.f, 0.f, 768.f, 512.f }))
+			{
+				if (views.size() < MultiViewCuller::g_MaxViews) views.push_back(face);
+			}
+		}
+		return views;
+	}
+}
+
+MultiViewCullingBenchmark::MultiViewCullingBenchmark()
+	: m_Results{}
+{
+}
+
+bool MultiViewCullingBenchmark::Run()
+{
+	using namespace std::chrono;
+
+	m_Results.clear();
+
+	const std::vector<RenderView> allViews{ CreateViews() };
+
+	// One culler for the pass over every view, one for the views on their own, so neither reuses what the other sized
+	MultiViewCuller culler{};
+	MultiViewCuller separateCuller{};
+	const std::vector<Float4> objects{ CreateObjects() };
+	culler.SetObjects(objects);
+	separateCuller.SetObjects(objects);
+
+	uint32_t checksum{};
+	for (const uint32_t viewCount : g_ViewCounts)
+	{
+		const std::vector<RenderView> views{ allViews.begin(), allViews.begin() + viewCount };
+		std::vector<std::vector<RenderView>> singleViews(viewCount);
+		for (uint32_t viewIndex{}; viewIndex < viewCount; ++viewIndex) singleViews[viewIndex].push_back(views[viewIndex]);
+
+		Result result{};
+		result.viewCount = viewCount;
+
+		// First passes size the lists
+		culler.Cull(views);
+		separateCuller.Cull(singleViews[0]);
+
+		const steady_clock::time_point cullStart{ steady_clock::now() };
+		for (int iteration{}; iteration < g_Iterations; ++iteration)
+		{
+			culler.Cull(views);
+			result.sharedMs += culler.GetStatistics().sharedMs;
+			result.perViewMs += culler.GetStatistics().perViewMs;
+		}
+		const steady_clock::time_point separateStart{ steady_clock::now() };
+		for (int iteration{}; iteration < g_Iterations; ++iteration)
+		{
+			for (const std::vector<RenderView>& singleView : singleViews)
+			{
+				separateCuller.Cull(singleView);
+				checksum += separateCuller.GetStatistics().visiblePairs;
+			}
+		}
+		const steady_clock::time_point separateEnd{ steady_clock::now() };
+
+		result.cullMs = duration<double, std::milli>(separateStart - cullStart).count() / g_Iterations;
+		result.separateMs = duration<double, std::milli>(separateEnd - separateStart).count() / g_Iterations;
+		result.sharedMs /= g_Iterations;
+		result.perViewMs /= g_Iterations;
+		result.groupCount = culler.GetStatistics().groupCount;
+		result.visiblePairs = culler.GetStatistics().visiblePairs;
+
+		// Grouping only skips tests, a view can't lose anything it sees on its own; both lists are in object order
+		for (uint32_t viewIndex{}; viewIndex < viewCount; ++viewIndex)
+		{
+			separateCuller.Cull(singleViews[viewIndex]);
+			const std::vector<uint32_t>& visibleObjects = culler.GetVisibleObjects(viewIndex);
+			const std::vector<uint32_t>& ownVisibleObjects = separateCuller.GetVisibleObjects(0);
+
+			const size_t sharedCount{ static_cast<size_t>(std::count_if(ownVisibleObjects.begin(), ownVisibleObjects.end(),
+				[&visibleObjects](uint32_t objectIndex) { return std::binary_search(visibleObjects.begin(), visibleObjects.end(), objectIndex); })) };
+			result.missingPairs += static_cast<uint32_t>(ownVisibleObjects.size() - sharedCount);
+			result.extraPairs += static_cast<uint32_t>(visibleObjects.size() - sharedCount);
+		}
+
+		m_Results.push_back(result);
+	}
+	g_Sink = checksum;
+
+	return LogResults();
+}
+
+// Privates
+// --------
+bool MultiViewCullingBenchmark::LogResults() const
+{
+	if (m_Results.empty()) return false;
+
+	std::wstringstream message;
+	uint32_t missingPairs{};
+	for (const Result& result : m_Results)
+	{
+		message.str(L"");
+		message << L"Multi-view culling benchmark: " << g_ObjectCount << L" objects, " << result.viewCount << L" views in " << result.groupCount << L" groups, "
+			<< result.cullMs << L" ms (" << result.cullMs / result.viewCount << L" ms per view, " << result.sharedMs << L" shared, " << result.perViewMs
+			<< L" in the per view tests) against " << result.separateMs << L" ms one by one, " << result.visiblePairs << L" visible pairs ("
+			<< result.extraPairs << L" more and " << result.missingPairs << L" fewer than one by one)";
+		Logger::Log(message.str());
+
+		missingPairs += result.missingPairs;
+	}
+
+	// Culling one by one grows linearly with the view count, it is timed alongside so both see the same machine load
+	const Result& first = m_Results.front();
+	const Result& last = m_Results.back();
+	const double growth{ first.cullMs > 0.0 ? last.cullMs / first.cullMs : 0.0 };
+	const double separateRatio{ last.separateMs > 0.0 ? last.cullMs / last.separateMs : 0.0 };
+
+	message.str(L"");
+	message << L"Multi-view culling benchmark: " << last.viewCount << L" views cost " << growth << L" times " << first.viewCount << L" view, "
+		<< separateRatio << L" times culling them one by one";
+	Logger::Log(message.str());
+
+	const bool isComplete{ missingPairs == 0 };
+	const bool isCheaper{ separateRatio < 1.0 };
+	if (!isComplete) Logger::Log(L"ERROR - Multi-view culling benchmark: culling the views together hid visible objects");
+	if (!isCheaper) Logger::Log(L"ERROR - Multi-view culling benchmark: culling the views together cost as much as one by one");
+	return isComplete && isCheaper;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Times culling generated objects for 1 to 32 cubemap views in one pass, against culling the same views one by one
+// Logs the cost per view count and how it grows, and checks the pass is cheaper and no view loses an object it sees when culled on its own
+class MultiViewCullingBenchmark final
+{
+public:
+	// Structs
+	struct Result
+	{
+		uint32_t viewCount;
+		uint32_t groupCount;
+		double cullMs;					// Every view in one pass
+		double separateMs;				// Every view culled on its own, what the cost would be if it grew linearly
+		double sharedMs;				// Of cullMs
+		double perViewMs;
+		uint32_t visiblePairs;
+		uint32_t extraPairs;			// Outside the view's own bounds, kept by the conservative plane tests because its group's bounds reach them
+		uint32_t missingPairs;			// Seen by a view on its own but not in the pass, never allowed
+	};
+
+	// Rule of five
+	MultiViewCullingBenchmark();
+	~MultiViewCullingBenchmark() = default;
+
+	MultiViewCullingBenchmark(const MultiViewCullingBenchmark& other) = delete;
+	MultiViewCullingBenchmark(MultiViewCullingBenchmark&& other) = delete;
+	MultiViewCullingBenchmark& operator= (const MultiViewCullingBenchmark& other) = delete;
+	MultiViewCullingBenchmark& operator= (MultiViewCullingBenchmark&& other) = delete;
+
+	// Publics
+	bool Run();	// False when a check failed, the failures are logged as errors
+
+	const std::vector<Result>& GetResults() const { return m_Results; }
+
+private:
+	// Member variables
+	std::vector<Result> m_Results;
+
+	// Member functions
+	bool LogResults() const;
+};
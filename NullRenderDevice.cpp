@@ -0,0 +1,632 @@
+#include "NullRenderDevice.h"
+#include "Logger.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <sstream>
+#include <string_view>
+#include <thread>
+
+NullRenderDevice::NullRenderDevice(uint32_t backBufferWidth, uint32_t backBufferHeight)
+	: m_BackBufferWidth{ backBufferWidth }
+	, m_BackBufferHeight{ backBufferHeight }
+	, m_RenderWidth{ backBufferWidth }
+	, m_RenderHeight{ backBufferHeight }
+	, m_Features{ true, true }
+	, m_Buffers{ g_MaxObjects }
+	, m_ShaderViews{ g_MaxObjects }
+	, m_VertexShaders{ g_MaxObjects }
+	, m_PixelShaders{ g_MaxObjects }
+	, m_InputLayouts{ g_MaxObjects }
+	, m_PipelineStates{ g_MaxObjects }
+	, m_DepthTargets{ g_MaxObjects }
+	, m_State{}
+	, m_Recorders{}
+	, m_FrameStatistics{}
+	, m_LastFrameStatistics{}
+	, m_FrameDepthPasses{}
+	, m_LastFrameDepthPasses{}
+	, m_ResourceCreations{ 0 }
+	, m_ValidationErrors{ 0 }
+	, m_StaleHandles{ 0 }
+	, m_FrameValidationStart{}
+	, m_PresentedFrames{}
+	, m_pFrameCapture{}
+	, m_CaptureImage{}
+{
+	// One recorder per worker, like the D3D11 backend
+	const uint32_t recorderCount{ std::clamp(std::thread::hardware_concurrency(), 1u, g_MaxRecorders) };
+	for (uint32_t index{}; index < recorderCount; ++index)
+	{
+		m_Recorders.push_back(RecorderEntry{ std::make_unique<CommandBuffer>(), false });
+	}
+}
+
+BufferHandle NullRenderDevice::CreateBuffer(const BufferDescription& description, const void* pInitialData)
+{
+	if (description.byteSize == 0)
+	{
+		ReportError(L"CreateBuffer", L"empty buffer");
+		return BufferHandle{};
+	}
+	if (description.usage == BufferUsage::Immutable && !pInitialData)
+	{
+		ReportError(L"CreateBuffer", L"immutable buffer without initial data");
+		return BufferHandle{};
+	}
+	if (description.type == BufferType::Constant && description.byteSize % 16 != 0)
+	{
+		ReportError(L"CreateBuffer", L"constant buffer size is not a multiple of 16 bytes");
+		return BufferHandle{};
+	}
+
+	++m_ResourceCreations;
+	return BufferHandle{ m_Buffers.Add(BufferDescription{ description }) };
+}
+ShaderViewHandle NullRenderDevice::CreateShaderView(BufferHandle buffer, ElementFormat format, uint32_t elementCount)
+{
+	const BufferDescription* pBuffer{ m_Buffers.Get(buffer.id) };
+	if (!pBuffer || pBuffer->type != BufferType::ShaderResource)
+	{
+		ReportError(L"CreateShaderView", L"not a shader resource buffer");
+		return ShaderViewHandle{};
+	}
+
+	// Structured views need a stride, typed views a format
+	const uint32_t elementSize{ format == ElementFormat::Unknown ? pBuffer->structureStride
+		: format == ElementFormat::R32G32_UInt ? 8u : 4u };
+	if (elementSize == 0 || static_cast<uint64_t>(elementSize) * elementCount > pBuffer->byteSize)
+	{
+		ReportError(L"CreateShaderView", L"view is bigger than the buffer");
+		return ShaderViewHandle{};
+	}
+
+	++m_ResourceCreations;
+	return ShaderViewHandle{ m_ShaderViews.Add(ShaderViewEntry{ buffer, DepthTargetHandle{}, format, elementCount }) };
+}
+VertexShaderHandle NullRenderDevice::CreateVertexShader(const std::wstring& /*name*/, const std::vector<char>& bytecode)
+{
+	if (bytecode.empty())
+	{
+		ReportError(L"CreateVertexShader", L"no bytecode");
+		return VertexShaderHandle{};
+	}
+
+	++m_ResourceCreations;
+	return VertexShaderHandle{ m_VertexShaders.Add(static_cast<uint32_t>(bytecode.size())) };
+}
+PixelShaderHandle NullRenderDevice::CreatePixelShader(const std::wstring& /*name*/, const std::vector<char>& bytecode)
+{
+	if (bytecode.empty())
+	{
+		ReportError(L"CreatePixelShader", L"no bytecode");
+		return PixelShaderHandle{};
+	}
+
+	++m_ResourceCreations;
+	return PixelShaderHandle{ m_PixelShaders.Add(static_cast<uint32_t>(bytecode.size())) };
+}
+InputLayoutHandle NullRenderDevice::CreateInputLayout(const InputElement* pElements, uint32_t elementCount, const std::wstring& /*shaderName*/, const std::vector<char>& bytecode)
+{
+	if (!pElements || elementCount == 0 || bytecode.empty())
+	{
+		ReportError(L"CreateInputLayout", L"no elements or no bytecode");
+		return InputLayoutHandle{};
+	}
+
+	InputLayoutEntry entry{};
+	for (uint32_t index{}; index < elementCount; ++index)
+	{
+		const InputElement& element = pElements[index];
+		if (element.inputSlot >= g_MaxVertexSlots || element.format == ElementFormat::Unknown || !element.pSemanticName)
+		{
+			ReportError(L"CreateInputLayout", L"invalid element");
+			return InputLayoutHandle{};
+		}
+
+		entry.slotMask |= 1u << element.inputSlot;
+	}
+
+	++m_ResourceCreations;
+	return InputLayoutHandle{ m_InputLayouts.Add(InputLayoutEntry{ entry }) };
+}
+PipelineStateHandle NullRenderDevice::CreatePipelineState(const PipelineStateDescription& description)
+{
+	if (description.depthWrite && !description.depthTest)
+	{
+		ReportError(L"CreatePipelineState", L"depth writes without the depth test are ignored by D3D11");
+	}
+
+	++m_ResourceCreations;
+	return PipelineStateHandle{ m_PipelineStates.Add(PipelineStateDescription{ description }) };
+}
+DepthTargetHandle NullRenderDevice::CreateDepthTarget(const DepthTargetDescription& description)
+{
+	if (description.width == 0 || description.height == 0 || description.sliceCount == 0)
+	{
+		ReportError(L"CreateDepthTarget", L"empty depth target");
+		return DepthTargetHandle{};
+	}
+	if (description.width > 16384 || description.height > 16384 || description.sliceCount > 2048)
+	{
+		ReportError(L"CreateDepthTarget", L"bigger than a D3D11 texture array can be");
+		return DepthTargetHandle{};
+	}
+
+	++m_ResourceCreations;
+	return DepthTargetHandle{ m_DepthTargets.Add(DepthTargetDescription{ description }) };
+}
+ShaderViewHandle NullRenderDevice::CreateDepthShaderView(DepthTargetHandle depthTarget)
+{
+	const DepthTargetDescription* pDepthTarget{ m_DepthTargets.Get(depthTarget.id) };
+	if (!pDepthTarget)
+	{
+		ReportMissing(L"CreateDepthShaderView", m_DepthTargets, depthTarget.id, L"depth target");
+		return ShaderViewHandle{};
+	}
+
+	++m_ResourceCreations;
+	return ShaderViewHandle{ m_ShaderViews.Add(ShaderViewEntry{ BufferHandle{}, depthTarget, ElementFormat::Unknown, pDepthTarget->sliceCount }) };
+}
+
+void NullRenderDevice::DestroyBuffer(BufferHandle buffer)
+{
+	if (!m_Buffers.Get(buffer.id)) ReportMissing(L"DestroyBuffer", m_Buffers, buffer.id, L"buffer");
+	m_Buffers.Remove(buffer.id);
+}
+void NullRenderDevice::DestroyShaderView(ShaderViewHandle view)
+{
+	if (!m_ShaderViews.Get(view.id)) ReportMissing(L"DestroyShaderView", m_ShaderViews, view.id, L"view");
+	m_ShaderViews.Remove(view.id);
+}
+void NullRenderDevice::DestroyDepthTarget(DepthTargetHandle depthTarget)
+{
+	if (!m_DepthTargets.Get(depthTarget.id)) ReportMissing(L"DestroyDepthTarget", m_DepthTargets, depthTarget.id, L"depth target");
+	if (m_State.depthPass == depthTarget) ReportError(L"DestroyDepthTarget", L"depth target is being drawn to");
+	m_DepthTargets.Remove(depthTarget.id);
+}
+
+bool NullRenderDevice::CompileShader(const ShaderCompileDescription& description, std::vector<char>& bytecode, std::string& errors)
+{
+	if (!description.pSource || description.sourceSize == 0 || !description.pEntryPoint || !description.pProfile)
+	{
+		ReportError(L"CompileShader", L"no source, entry point or profile");
+		return false;
+	}
+
+	// Nothing to compile for, only the entry point is checked
+	const std::string_view source{ description.pSource, description.sourceSize };
+	if (source.find(description.pEntryPoint) == std::string_view::npos)
+	{
+		errors = std::string{ description.pSourceName ? description.pSourceName : "" } + ": entry point " + description.pEntryPoint + " not found";
+		return false;
+	}
+
+	// Stand-in bytecode, different for every variant so they don't look like one shader
+	hashing::Hasher hasher{};
+	hasher.AddBytes(description.pSource, description.sourceSize).AddString(description.pEntryPoint).AddString(description.pProfile);
+	for (uint32_t index{}; index < description.defineCount; ++index)
+	{
+		hasher.AddString(description.pDefines[index].pName).AddString(description.pDefines[index].pValue);
+	}
+
+	const uint64_t hash{ hasher.Get() };
+	bytecode.assign(reinterpret_cast<const char*>(&hash), reinterpret_cast<const char*>(&hash) + sizeof(hash));
+	return true;
+}
+
+void NullRenderDevice::BeginFrame(const float /*clearColor*/[4])
+{
+	if (m_State.inFrame) ReportError(L"BeginFrame", L"previous frame was never presented");
+
+	// Nothing stays bound across frames, like a fresh deferred context
+	m_State = BoundState{};
+	m_State.inFrame = true;
+
+	m_FrameStatistics = Statistics{};
+	m_FrameDepthPasses = 0;
+	m_FrameValidationStart = m_ValidationErrors.load(std::memory_order_relaxed);
+}
+void NullRenderDevice::Present()
+{
+	CheckInFrame(L"Present");
+	CheckOutsideDepthPass(L"Present");
+
+	m_FrameStatistics.resourceCreations = m_ResourceCreations.load(std::memory_order_relaxed);
+	m_FrameStatistics.validationErrors = m_ValidationErrors.load(std::memory_order_relaxed) - m_FrameValidationStart;
+	m_LastFrameStatistics = m_FrameStatistics;
+	m_LastFrameDepthPasses = m_FrameDepthPasses;
+
+	m_State = BoundState{};
+	++m_PresentedFrames;
+
+	// Nothing was drawn, but a cleared frame still costs what capturing this backBuffer size costs
+	if (m_pFrameCapture)
+	{
+		const size_t pixelCount{ static_cast<size_t>(m_BackBufferWidth) * m_BackBufferHeight };
+		if (m_CaptureImage.size() != pixelCount) m_CaptureImage.assign(pixelCount, g_CaptureColor);
+		m_pFrameCapture->CaptureFrame(m_CaptureImage.data(), m_BackBufferWidth, m_BackBufferHeight);
+	}
+
+	RetireObjects();
+}
+bool NullRenderDevice::ResizeBackBuffer(uint32_t width, uint32_t height)
+{
+	if (m_State.inFrame)
+	{
+		ReportError(L"ResizeBackBuffer", L"called inside BeginFrame/Present");
+		return false;
+	}
+	if (width == 0 || height == 0)
+	{
+		ReportError(L"ResizeBackBuffer", L"empty backBuffer");
+		return false;
+	}
+
+	m_BackBufferWidth = width;
+	m_BackBufferHeight = height;
+	m_RenderWidth = width;
+	m_RenderHeight = height;
+	return true;
+}
+
+void NullRenderDevice::SetRenderResolution(uint32_t width, uint32_t height)
+{
+	if (m_State.inFrame)
+	{
+		ReportError(L"SetRenderResolution", L"called inside BeginFrame/Present");
+		return;
+	}
+
+	m_RenderWidth = std::clamp(width, 1u, m_BackBufferWidth);
+	m_RenderHeight = std::clamp(height, 1u, m_BackBufferHeight);
+}
+
+void NullRenderDevice::UpdateBuffer(BufferHandle buffer, const void* pData, uint32_t byteSize)
+{
+	if (!CheckInFrame(L"UpdateBuffer")) return;
+
+	const BufferDescription* pBuffer{ m_Buffers.Get(buffer.id) };
+	if (!pBuffer)
+	{
+		ReportMissing(L"UpdateBuffer", m_Buffers, buffer.id, L"buffer");
+		return;
+	}
+	if (pBuffer->usage == BufferUsage::Immutable)
+	{
+		ReportError(L"UpdateBuffer", L"buffer is immutable");
+		return;
+	}
+	if (byteSize > pBuffer->byteSize || (byteSize > 0 && !pData))
+	{
+		ReportError(L"UpdateBuffer", L"data doesn't fit the buffer");
+		return;
+	}
+
+	// Only counted, the data is never read
+	++m_FrameStatistics.uploadCount;
+	m_FrameStatistics.uploadBytes += byteSize;
+}
+
+void NullRenderDevice::BeginDepthPass(DepthTargetHandle depthTarget, uint32_t slice)
+{
+	if (!CheckInFrame(L"BeginDepthPass") || !CheckOutsideDepthPass(L"BeginDepthPass")) return;
+
+	const DepthTargetDescription* pDepthTarget{ m_DepthTargets.Get(depthTarget.id) };
+	if (!pDepthTarget)
+	{
+		ReportMissing(L"BeginDepthPass", m_DepthTargets, depthTarget.id, L"depth target");
+		return;
+	}
+	if (slice >= pDepthTarget->sliceCount)
+	{
+		ReportError(L"BeginDepthPass", L"slice out of range");
+		return;
+	}
+
+	// Leaves nothing bound, so a view of the target can't still be read while it is drawn to
+	m_State = BoundState{};
+	m_State.inFrame = true;
+	m_State.depthPass = depthTarget;
+
+	++m_FrameDepthPasses;
+	++m_FrameStatistics.bindCount;
+}
+void NullRenderDevice::EndDepthPass()
+{
+	if (!CheckInFrame(L"EndDepthPass")) return;
+	if (!m_State.depthPass.IsValid())
+	{
+		ReportError(L"EndDepthPass", L"no depth pass was begun");
+		return;
+	}
+
+	m_State = BoundState{};
+	m_State.inFrame = true;
+	++m_FrameStatistics.bindCount;
+}
+
+void NullRenderDevice::SetViewport(const Viewport& viewport)
+{
+	if (!CheckInFrame(L"SetViewport")) return;
+	if (viewport.width <= 0.f || viewport.height <= 0.f) ReportError(L"SetViewport", L"empty viewport");
+
+	m_State.viewportSet = true;
+	++m_FrameStatistics.bindCount;
+}
+void NullRenderDevice::SetPipelineState(PipelineStateHandle pipelineState)
+{
+	if (!CheckInFrame(L"SetPipelineState")) return;
+	if (!m_PipelineStates.Get(pipelineState.id)) ReportMissing(L"SetPipelineState", m_PipelineStates, pipelineState.id, L"pipeline state");
+
+	m_State.pipelineState = pipelineState;
+	++m_FrameStatistics.bindCount;
+}
+void NullRenderDevice::SetInputLayout(InputLayoutHandle inputLayout)
+{
+	if (!CheckInFrame(L"SetInputLayout")) return;
+	if (!m_InputLayouts.Get(inputLayout.id)) ReportMissing(L"SetInputLayout", m_InputLayouts, inputLayout.id, L"inputLayout");
+
+	m_State.inputLayout = inputLayout;
+	++m_FrameStatistics.bindCount;
+}
+void NullRenderDevice::SetVertexShader(VertexShaderHandle vertexShader)
+{
+	if (!CheckInFrame(L"SetVertexShader")) return;
+	if (!m_VertexShaders.Get(vertexShader.id)) ReportMissing(L"SetVertexShader", m_VertexShaders, vertexShader.id, L"vertexShader");
+
+	m_State.vertexShader = vertexShader;
+	++m_FrameStatistics.bindCount;
+}
+void NullRenderDevice::SetPixelShader(PixelShaderHandle pixelShader)
+{
+	if (!CheckInFrame(L"SetPixelShader")) return;
+	if (!m_PixelShaders.Get(pixelShader.id)) ReportMissing(L"SetPixelShader", m_PixelShaders, pixelShader.id, L"pixelShader");
+
+	m_State.pixelShader = pixelShader;
+	++m_FrameStatistics.bindCount;
+}
+void NullRenderDevice::SetVertexBuffers(uint32_t startSlot, uint32_t bufferCount, const BufferHandle* pBuffers, const uint32_t* pStrides)
+{
+	if (!CheckInFrame(L"SetVertexBuffers")) return;
+	if (startSlot + bufferCount > g_MaxVertexSlots || !pBuffers || !pStrides)
+	{
+		ReportError(L"SetVertexBuffers", L"invalid slot range");
+		return;
+	}
+
+	for (uint32_t index{}; index < bufferCount; ++index)
+	{
+		if (pStrides[index] == 0) ReportError(L"SetVertexBuffers", L"zero stride");
+		if (CheckBuffer(L"SetVertexBuffers", pBuffers[index], BufferType::Vertex)) m_State.vertexBuffers[startSlot + index] = pBuffers[index];
+	}
+
+	++m_FrameStatistics.bindCount;
+}
+void NullRenderDevice::SetIndexBuffer(BufferHandle buffer, ElementFormat format)
+{
+	if (!CheckInFrame(L"SetIndexBuffer")) return;
+	if (format != ElementFormat::R16_UInt && format != ElementFormat::R32_UInt) ReportError(L"SetIndexBuffer", L"indices must be 16 or 32 bit");
+	if (CheckBuffer(L"SetIndexBuffer", buffer, BufferType::Index)) m_State.indexBuffer = buffer;
+
+	++m_FrameStatistics.bindCount;
+}
+void NullRenderDevice::SetConstantBuffer(ShaderStage /*stage*/, uint32_t slot, BufferHandle buffer, uint32_t firstConstant, uint32_t constantCount)
+{
+	if (!CheckInFrame(L"SetConstantBuffer")) return;
+	if (slot >= 14) ReportError(L"SetConstantBuffer", L"slot out of range");
+
+	if (CheckBuffer(L"SetConstantBuffer", buffer, BufferType::Constant) && constantCount > 0)
+	{
+		// Windows have to start on 256 bytes and stay inside the buffer
+		const BufferDescription* pBuffer{ m_Buffers.Get(buffer.id) };
+		if (!m_Features.constantBufferOffsets) ReportError(L"SetConstantBuffer", L"offsets are not supported");
+		if (firstConstant % 16 != 0 || constantCount % 16 != 0) ReportError(L"SetConstantBuffer", L"window is not 256-byte aligned");
+		if ((static_cast<uint64_t>(firstConstant) + constantCount) * 16 > pBuffer->byteSize) ReportError(L"SetConstantBuffer", L"window is outside the buffer");
+	}
+
+	++m_FrameStatistics.bindCount;
+}
+void NullRenderDevice::SetShaderViews(ShaderStage /*stage*/, uint32_t startSlot, uint32_t viewCount, const ShaderViewHandle* pViews)
+{
+	if (!CheckInFrame(L"SetShaderViews")) return;
+	if (startSlot + viewCount > 128 || !pViews)
+	{
+		ReportError(L"SetShaderViews", L"invalid slot range");
+		return;
+	}
+
+	for (uint32_t index{}; index < viewCount; ++index)
+	{
+		const ShaderViewEntry* pView{ m_ShaderViews.Get(pViews[index].id) };
+		if (!pView)
+		{
+			ReportMissing(L"SetShaderViews", m_ShaderViews, pViews[index].id, L"view");
+		}
+		else if (!m_Buffers.Get(pView->buffer.id) && !m_DepthTargets.Get(pView->depthTarget.id))
+		{
+			ReportError(L"SetShaderViews", L"view of a destroyed resource");
+		}
+		else if (pView->depthTarget.IsValid() && pView->depthTarget == m_State.depthPass)
+		{
+			ReportError(L"SetShaderViews", L"depth target is read while it is drawn to");
+		}
+	}
+
+	++m_FrameStatistics.bindCount;
+}
+
+void NullRenderDevice::DrawIndexed(uint32_t indexCount, uint32_t /*startIndex*/, int32_t /*baseVertex*/)
+{
+	CountDraw(L"DrawIndexed", indexCount, 1);
+}
+void NullRenderDevice::DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount)
+{
+	CountDraw(L"DrawIndexedInstanced", indexCountPerInstance, instanceCount);
+}
+
+CommandRecorder& NullRenderDevice::BeginRecording(uint32_t recorderIndex)
+{
+	// Only touches this recorder, so workers can record side by side
+	RecorderEntry& recorder = m_Recorders[(std::min)(recorderIndex, GetRecorderCount() - 1)];
+	recorder.pCommands->Clear();
+	recorder.recording = true;
+	return *recorder.pCommands;
+}
+void NullRenderDevice::EndRecording(uint32_t recorderIndex)
+{
+	if (recorderIndex >= GetRecorderCount()) return;
+	m_Recorders[recorderIndex].recording = false;
+}
+void NullRenderDevice::ExecuteRecording(uint32_t recorderIndex)
+{
+	if (!CheckInFrame(L"ExecuteRecording") || !CheckOutsideDepthPass(L"ExecuteRecording") || !CheckRecorder(L"ExecuteRecording", recorderIndex)) return;
+
+	// The list starts without state and leaves none behind, like a D3D11 command list
+	m_State = BoundState{};
+	m_State.inFrame = true;
+
+	RecorderEntry& recorder = m_Recorders[recorderIndex];
+	recorder.pCommands->Replay(*this);
+	recorder.pCommands->Clear();
+
+	m_State = BoundState{};
+	m_State.inFrame = true;
+}
+
+bool NullRenderDevice::StartCapture(FrameCaptureEncoder::Format format, const std::wstring& filePath)
+{
+	if (!m_pFrameCapture) m_pFrameCapture = std::make_unique<MemoryFrameCapture>();
+	return m_pFrameCapture->Start(format, filePath);
+}
+void NullRenderDevice::StopCapture()
+{
+	if (m_pFrameCapture) m_pFrameCapture->Stop();
+}
+bool NullRenderDevice::IsCapturing() const
+{
+	return m_pFrameCapture && m_pFrameCapture->IsCapturing();
+}
+
+void NullRenderDevice::LogStatistics() const
+{
+	const Statistics& statistics = m_LastFrameStatistics;
+
+	std::wstringstream message;
+	message << L"Null device (frame " << m_PresentedFrames << L"): " << statistics.drawCount << L" draws, "
+		<< statistics.triangleCount << L" triangles, " << statistics.bindCount << L" binds, "
+		<< statistics.uploadCount << L" uploads (" << statistics.uploadBytes << L" bytes), " << m_LastFrameDepthPasses << L" depth passes, "
+		<< statistics.resourceCreations << L" resources created, " << statistics.validationErrors << L" validation errors ("
+		<< m_StaleHandles.load(std::memory_order_relaxed) << L" stale handles so far)";
+	Logger::Log(message.str());
+
+	if (IsCapturing()) m_pFrameCapture->LogStatistics();
+}
+
+// Privates
+// --------
+void NullRenderDevice::ReportError(const wchar_t* pCall, const wchar_t* pProblem)
+{
+	const uint32_t errorCount{ ++m_ValidationErrors };
+	if (errorCount > g_MaxLoggedErrors) return;
+
+	std::wstringstream message;
+	message << L"ERROR - Null device: " << pCall << L", " << pProblem;
+	if (errorCount == g_MaxLoggedErrors) message << L" (further errors are only counted)";
+	Logger::Log(message.str());
+}
+template <typename T>
+void NullRenderDevice::ReportMissing(const wchar_t* pCall, const DeviceObjectTable<T>& table, uint32_t id, const wchar_t* pObjectName)
+{
+	// Stale ids were handed out once, their object has been destroyed and the slot may hold another one by now
+	const bool isStale{ table.IsStale(id) };
+	if (isStale) ++m_StaleHandles;
+
+	const std::wstring problem{ (isStale ? std::wstring{ L"stale " } : std::wstring{ L"unknown " }) + pObjectName };
+	ReportError(pCall, problem.c_str());
+}
+void NullRenderDevice::RetireObjects()
+{
+	// Destroyed objects are released a few frames late, their slots are only reused after that
+	m_Buffers.RetireFrame(g_RetireLatency);
+	m_ShaderViews.RetireFrame(g_RetireLatency);
+	m_VertexShaders.RetireFrame(g_RetireLatency);
+	m_PixelShaders.RetireFrame(g_RetireLatency);
+	m_InputLayouts.RetireFrame(g_RetireLatency);
+	m_PipelineStates.RetireFrame(g_RetireLatency);
+	m_DepthTargets.RetireFrame(g_RetireLatency);
+}
+bool NullRenderDevice::CheckInFrame(const wchar_t* pCall)
+{
+	if (m_State.inFrame) return true;
+
+	ReportError(pCall, L"called outside BeginFrame/Present");
+	return false;
+}
+bool NullRenderDevice::CheckOutsideDepthPass(const wchar_t* pCall)
+{
+	if (!m_State.depthPass.IsValid()) return true;
+
+	ReportError(pCall, L"called inside BeginDepthPass/EndDepthPass");
+	return false;
+}
+bool NullRenderDevice::CheckRecorder(const wchar_t* pCall, uint32_t recorderIndex)
+{
+	if (recorderIndex >= GetRecorderCount())
+	{
+		ReportError(pCall, L"recorder index out of range");
+		return false;
+	}
+	if (m_Recorders[recorderIndex].recording)
+	{
+		ReportError(pCall, L"recording was never ended");
+		return false;
+	}
+
+	return true;
+}
+bool NullRenderDevice::CheckBuffer(const wchar_t* pCall, BufferHandle buffer, BufferType expectedType)
+{
+	const BufferDescription* pBuffer{ m_Buffers.Get(buffer.id) };
+	if (!pBuffer)
+	{
+		ReportMissing(pCall, m_Buffers, buffer.id, L"buffer");
+		return false;
+	}
+	if (pBuffer->type != expectedType)
+	{
+		ReportError(pCall, L"buffer was created for another binding");
+		return false;
+	}
+
+	return true;
+}
+void NullRenderDevice::CountDraw(const wchar_t* pCall, uint32_t indexCountPerInstance, uint32_t instanceCount)
+{
+	if (!CheckInFrame(pCall)) return;
+
+	// Everything the draw reads has to be bound and still alive
+	if (!m_State.viewportSet) ReportError(pCall, L"no viewport");
+	if (!m_PipelineStates.Get(m_State.pipelineState.id)) ReportError(pCall, L"no pipeline state");
+	if (!m_VertexShaders.Get(m_State.vertexShader.id)) ReportError(pCall, L"no vertexShader");
+	if (!m_State.depthPass.IsValid() && !m_PixelShaders.Get(m_State.pixelShader.id)) ReportError(pCall, L"no pixelShader");	// Depth passes don't need one
+	if (!m_Buffers.Get(m_State.indexBuffer.id)) ReportError(pCall, L"no indexBuffer");
+
+	const InputLayoutEntry* pInputLayout{ m_InputLayouts.Get(m_State.inputLayout.id) };
+	if (!pInputLayout)
+	{
+		ReportError(pCall, L"no inputLayout");
+	}
+	else
+	{
+		for (uint32_t slot{}; slot < g_MaxVertexSlots; ++slot)
+		{
+			if ((pInputLayout->slotMask & (1u << slot)) && !m_Buffers.Get(m_State.vertexBuffers[slot].id)) ReportError(pCall, L"inputLayout reads an empty vertexBuffer slot");
+		}
+	}
+
+	if (indexCountPerInstance == 0 || instanceCount == 0) ReportError(pCall, L"empty draw");
+
+	++m_FrameStatistics.drawCount;
+	m_FrameStatistics.triangleCount += static_cast<uint64_t>(indexCountPerInstance / 3) * instanceCount;
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "CommandBuffer.h"
+#include "DeviceObjectTable.h"
+#include "MemoryFrameCapture.h"
+#include "RenderDevice.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Backend without a GPU, every call is validated and counted but nothing is executed
+// The frame is still submitted call for call, so its CPU cost and draw counts can be tracked headless
+// Recorded lists are plain CommandBuffers, replayed through the same validation when executed
+class NullRenderDevice final : public RenderDevice
+{
+public:
+	// Rule of five
+	NullRenderDevice(uint32_t backBufferWidth, uint32_t backBufferHeight);
+	~NullRenderDevice() override = default;
+
+	NullRenderDevice(const NullRenderDevice& other) = delete;
+	NullRenderDevice(NullRenderDevice&& other) = delete;
+	NullRenderDevice& operator= (const NullRenderDevice& other) = delete;
+	NullRenderDevice& operator= (NullRenderDevice&& other) = delete;
+
+	// Publics
+	RenderDeviceType GetType() const override { return RenderDeviceType::Null; }
+	const Features& GetFeatures() const override { return m_Features; }
+	uint32_t GetBackBufferWidth() const override { return m_BackBufferWidth; }
+	uint32_t GetBackBufferHeight() const override { return m_BackBufferHeight; }
+
+	BufferHandle CreateBuffer(const BufferDescription& description, const void* pInitialData) override;
+	ShaderViewHandle CreateShaderView(BufferHandle buffer, ElementFormat format, uint32_t elementCount) override;
+	VertexShaderHandle CreateVertexShader(const std::wstring& name, const std::vector<char>& bytecode) override;
+	PixelShaderHandle CreatePixelShader(const std::wstring& name, const std::vector<char>& bytecode) override;
+	InputLayoutHandle CreateInputLayout(const InputElement* pElements, uint32_t elementCount, const std::wstring& shaderName, const std::vector<char>& bytecode) override;
+	PipelineStateHandle CreatePipelineState(const PipelineStateDescription& description) override;
+	DepthTargetHandle CreateDepthTarget(const DepthTargetDescription& description) override;
+	ShaderViewHandle CreateDepthShaderView(DepthTargetHandle depthTarget) override;
+
+	void DestroyBuffer(BufferHandle buffer) override;
+	void DestroyShaderView(ShaderViewHandle view) override;
+	void DestroyDepthTarget(DepthTargetHandle depthTarget) override;
+
+	const char* GetShaderProfile(ShaderStage stage) const override { return stage == ShaderStage::Vertex ? "null_vs" : "null_ps"; }
+	bool CompileShader(const ShaderCompileDescription& description, std::vector<char>& bytecode, std::string& errors) override;
+
+	void BeginFrame(const float clearColor[4]) override;
+	void Present() override;
+	bool ResizeBackBuffer(uint32_t width, uint32_t height) override;
+
+	void SetRenderResolution(uint32_t width, uint32_t height) override;
+	uint32_t GetRenderWidth() const override { return m_RenderWidth; }
+	uint32_t GetRenderHeight() const override { return m_RenderHeight; }
+
+	void UpdateBuffer(BufferHandle buffer, const void* pData, uint32_t byteSize) override;
+
+	void BeginDepthPass(DepthTargetHandle depthTarget, uint32_t slice) override;
+	void EndDepthPass() override;
+
+	void SetViewport(const Viewport& viewport) override;
+	void SetPipelineState(PipelineStateHandle pipelineState) override;
+	void SetInputLayout(InputLayoutHandle inputLayout) override;
+	void SetVertexShader(VertexShaderHandle vertexShader) override;
+	void SetPixelShader(PixelShaderHandle pixelShader) override;
+	void SetVertexBuffers(uint32_t startSlot, uint32_t bufferCount, const BufferHandle* pBuffers, const uint32_t* pStrides) override;
+	void SetIndexBuffer(BufferHandle buffer, ElementFormat format) override;
+	void SetConstantBuffer(ShaderStage stage, uint32_t slot, BufferHandle buffer, uint32_t firstConstant = 0, uint32_t constantCount = 0) override;
+	void SetShaderViews(ShaderStage stage, uint32_t startSlot, uint32_t viewCount, const ShaderViewHandle* pViews) override;
+
+	void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+	void DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount) override;
+
+	uint32_t GetRecorderCount() const override { return static_cast<uint32_t>(m_Recorders.size()); }
+	CommandRecorder& BeginRecording(uint32_t recorderIndex) override;
+	void EndRecording(uint32_t recorderIndex) override;
+	void ExecuteRecording(uint32_t recorderIndex) override;
+
+	bool StartCapture(FrameCaptureEncoder::Format format, const std::wstring& filePath) override;	// Captures cleared frames, nothing is drawn
+	void StopCapture() override;
+	bool IsCapturing() const override;
+
+	const Statistics& GetFrameStatistics() const override { return m_LastFrameStatistics; }
+	void LogStatistics() const override;
+
+	uint32_t GetTotalValidationErrors() const { return m_ValidationErrors.load(std::memory_order_relaxed); }
+
+	// For backends keeping their own data next to the slots, stale handles must not reach it
+	bool IsAlive(BufferHandle buffer) const { return m_Buffers.Get(buffer.id) != nullptr; }
+	bool IsAlive(InputLayoutHandle inputLayout) const { return m_InputLayouts.Get(inputLayout.id) != nullptr; }
+	bool IsAlive(PipelineStateHandle pipelineState) const { return m_PipelineStates.Get(pipelineState.id) != nullptr; }
+	bool IsAlive(DepthTargetHandle depthTarget) const { return m_DepthTargets.Get(depthTarget.id) != nullptr; }
+
+private:
+	// Structs
+	struct ShaderViewEntry
+	{
+		BufferHandle buffer;			// Or a depth target
+		DepthTargetHandle depthTarget;
+		ElementFormat format;
+		uint32_t elementCount;
+	};
+
+	struct InputLayoutEntry
+	{
+		uint32_t slotMask;		// Vertex buffer slots the layout reads from
+	};
+
+	struct RecorderEntry
+	{
+		std::unique_ptr<CommandBuffer> pCommands;
+		bool recording;
+	};
+
+	struct BoundState
+	{
+		bool inFrame;
+		bool viewportSet;
+		DepthTargetHandle depthPass;	// Draws go to the backBuffer when not set
+		PipelineStateHandle pipelineState;
+		InputLayoutHandle inputLayout;
+		VertexShaderHandle vertexShader;
+		PixelShaderHandle pixelShader;
+		BufferHandle indexBuffer;
+		BufferHandle vertexBuffers[8];
+	};
+
+	static constexpr uint32_t g_MaxObjects{ 4096 };		// Per kind of object
+	static constexpr uint32_t g_MaxVertexSlots{ 8 };
+	static constexpr uint32_t g_MaxLoggedErrors{ 16 };	// The same error tends to repeat every frame
+	static constexpr uint32_t g_MaxRecorders{ 8 };
+	static constexpr uint32_t g_RetireLatency{ 3 };		// Frames a destroyed object is kept, like a GPU running behind
+	static constexpr uint32_t g_CaptureColor{ 0xFF000000 };
+
+	// Member variables
+	uint32_t m_BackBufferWidth;
+	uint32_t m_BackBufferHeight;
+	uint32_t m_RenderWidth;
+	uint32_t m_RenderHeight;
+	Features m_Features;
+
+	DeviceObjectTable<BufferDescription> m_Buffers;
+	DeviceObjectTable<ShaderViewEntry> m_ShaderViews;
+	DeviceObjectTable<uint32_t> m_VertexShaders;		// Bytecode size
+	DeviceObjectTable<uint32_t> m_PixelShaders;
+	DeviceObjectTable<InputLayoutEntry> m_InputLayouts;
+	DeviceObjectTable<PipelineStateDescription> m_PipelineStates;
+	DeviceObjectTable<DepthTargetDescription> m_DepthTargets;
+
+	BoundState m_State;
+	std::vector<RecorderEntry> m_Recorders;
+
+	Statistics m_FrameStatistics;
+	Statistics m_LastFrameStatistics;
+	uint32_t m_FrameDepthPasses;
+	uint32_t m_LastFrameDepthPasses;
+	std::atomic<uint32_t> m_ResourceCreations;
+	std::atomic<uint32_t> m_ValidationErrors;
+	std::atomic<uint32_t> m_StaleHandles;				// Used after being destroyed
+	uint32_t m_FrameValidationStart;
+	uint64_t m_PresentedFrames;
+
+	std::unique_ptr<MemoryFrameCapture> m_pFrameCapture;	// Created by the first capture, along with its encoder thread
+	std::vector<uint32_t> m_CaptureImage;
+
+	// Member functions
+	void ReportError(const wchar_t* pCall, const wchar_t* pProblem);
+	template <typename T>
+	void ReportMissing(const wchar_t* pCall, const DeviceObjectTable<T>& table, uint32_t id, const wchar_t* pObjectName);
+	void RetireObjects();
+	bool CheckInFrame(const wchar_t* pCall);
+	bool CheckOutsideDepthPass(const wchar_t* pCall);
+	bool CheckRecorder(const wchar_t* pCall, uint32_t recorderIndex);
+	bool CheckBuffer(const wchar_t* pCall, BufferHandle buffer, BufferType expectedType);
+	void CountDraw(const wchar_t* pCall, uint32_t indexCountPerInstance, uint32_t instanceCount);
+};
@@ -0,0 +1,336 @@
+#include "ParticleSystem.h"
+
+#include <ppl.h>
+#include <algorithm>
+#include <chrono>
+
+using namespace math;
+
+namespace
+{
+	// Particles per integration job, a multiple of 4
+	constexpr uint32_t g_ParticlesPerJob{ 4096 };
+
+	// Keys per radix sort chunk, every chunk gets its own histogram
+	constexpr uint32_t g_SortChunkSize{ 16384 };
+
+	// Hash based noise, cheap enough to generate 4 values per instruction sequence
+	Vector MATH_CALLCONV RandomUnit(Vector seed, float stream)
+	{
+		const Vector angle{ VectorMultiplyAdd(seed, VectorReplicate(12.9898f), VectorReplicate(stream * 78.233f)) };
+		const Vector noise{ VectorMultiply(VectorSin(angle), VectorReplicate(43758.5453f)) };
+		return VectorSubtract(noise, VectorFloor(noise));	// [0, 1)
+	}
+	Vector MATH_CALLCONV RandomSigned(Vector seed, float stream)
+	{
+		return VectorMultiplyAdd(RandomUnit(seed, stream), VectorReplicate(2.f), VectorReplicate(-1.f));	// [-1, 1)
+	}
+
+	float* Block(std::vector<float>& values, uint32_t index)
+	{
+		return values.data() + index;
+	}
+}
+
+ParticleSystem::ParticleSystem(uint32_t capacity)
+	: m_Capacity{ capacity }
+	, m_Count{}
+	, m_PositionX(capacity + 4, 0.f)
+	, m_PositionY(capacity + 4, 0.f)
+	, m_PositionZ(capacity + 4, 0.f)
+	, m_VelocityX(capacity + 4, 0.f)
+	, m_VelocityY(capacity + 4, 0.f)
+	, m_VelocityZ(capacity + 4, 0.f)
+	, m_Age(capacity + 4, 0.f)
+	, m_Lifetime(capacity + 4, 0.f)
+	, m_Settings{}
+	, m_EmitAccumulator{}
+	, m_EmitSeed{}
+	, m_SortKeys(capacity + 4, 0)
+	, m_SortIndices(capacity + 4, 0)
+	, m_SortKeysScratch(capacity + 4, 0)
+	, m_SortIndicesScratch(capacity + 4, 0)
+	, m_Histograms{}
+	, m_Instances{}
+	, m_Statistics{}
+{
+	m_Instances.reserve(capacity);
+}
+
+void ParticleSystem::Update(float deltaTime)
+{
+	using namespace std::chrono;
+
+	m_Statistics = Statistics{};
+
+	// Emit, keeping the fraction for the next frame
+	auto startTime{ steady_clock::now() };
+
+	m_EmitAccumulator += m_Settings.particlesPerSecond * deltaTime;
+	const uint32_t emitCount{ static_cast<uint32_t>(m_EmitAccumulator) };
+	m_EmitAccumulator -= static_cast<float>(emitCount);
+	Emit(emitCount);
+
+	m_Statistics.emitMs = duration<double, std::milli>(steady_clock::now() - startTime).count();
+
+	// Integrate
+	startTime = steady_clock::now();
+	Integrate(deltaTime);
+	m_Statistics.simulateMs = duration<double, std::milli>(steady_clock::now() - startTime).count();
+
+	// Kill
+	startTime = steady_clock::now();
+	Kill();
+	m_Statistics.killMs = duration<double, std::milli>(steady_clock::now() - startTime).count();
+
+	m_Statistics.aliveCount = m_Count;
+}
+void ParticleSystem::SortByDepth(const Float4x4& viewMatrix)
+{
+	using namespace std::chrono;
+
+	auto startTime{ steady_clock::now() };
+	BuildSortKeys(viewMatrix);
+	RadixSort();
+	m_Statistics.sortMs = duration<double, std::milli>(steady_clock::now() - startTime).count();
+
+	startTime = steady_clock::now();
+	BuildInstances();
+	m_Statistics.buildMs = duration<double, std::milli>(steady_clock::now() - startTime).count();
+}
+
+// Privates
+// --------
+void ParticleSystem::Emit(uint32_t count)
+{
+	count = (std::min)(count, m_Capacity - m_Count);
+	m_Statistics.emittedCount = count;
+
+	const EmitterSettings& settings = m_Settings;
+	const Vector laneOffsets{ VectorSet(0.f, 1.f, 2.f, 3.f) };
+
+	// Whole blocks are written, lanes past the new count are dead slots and get overwritten later
+	for (uint32_t emitted{}; emitted < count; emitted += 4)
+	{
+		const uint32_t index{ m_Count + emitted };
+
+		const Vector seed{ VectorAdd(VectorReplicate(static_cast<float>(m_EmitSeed & 0xFFFF)), laneOffsets) };
+		m_EmitSeed += 4;
+
+		const Vector spawnRadius{ VectorReplicate(settings.spawnRadius) };
+		const Vector jitter{ VectorReplicate(settings.velocityJitter) };
+
+		VectorStore(Block(m_PositionX, index), VectorMultiplyAdd(RandomSigned(seed, 0.f), spawnRadius, VectorReplicate(settings.position.x)));
+		VectorStore(Block(m_PositionY, index), VectorMultiplyAdd(RandomSigned(seed, 1.f), spawnRadius, VectorReplicate(settings.position.y)));
+		VectorStore(Block(m_PositionZ, index), VectorMultiplyAdd(RandomSigned(seed, 2.f), spawnRadius, VectorReplicate(settings.position.z)));
+
+		VectorStore(Block(m_VelocityX, index), VectorMultiplyAdd(RandomSigned(seed, 3.f), jitter, VectorReplicate(settings.velocity.x)));
+		VectorStore(Block(m_VelocityY, index), VectorMultiplyAdd(RandomSigned(seed, 4.f), jitter, VectorReplicate(settings.velocity.y)));
+		VectorStore(Block(m_VelocityZ, index), VectorMultiplyAdd(RandomSigned(seed, 5.f), jitter, VectorReplicate(settings.velocity.z)));
+
+		const Vector lifetime{ VectorLerpV(VectorReplicate(settings.minLifetime), VectorReplicate(settings.maxLifetime), RandomUnit(seed, 6.f)) };
+		VectorStore(Block(m_Age, index), VectorZero());
+		VectorStore(Block(m_Lifetime, index), lifetime);
+	}
+
+	m_Count += count;
+}
+void ParticleSystem::Integrate(float deltaTime)
+{
+	const uint32_t paddedCount{ (m_Count + 3) & ~3u };
+	const uint32_t jobCount{ (paddedCount + g_ParticlesPerJob - 1) / g_ParticlesPerJob };
+
+	const Vector timeStep{ VectorReplicate(deltaTime) };
+	const Vector gravityX{ VectorReplicate(m_Settings.gravity.x * deltaTime) };
+	const Vector gravityY{ VectorReplicate(m_Settings.gravity.y * deltaTime) };
+	const Vector gravityZ{ VectorReplicate(m_Settings.gravity.z * deltaTime) };
+
+	// Explicit Euler, padding lanes are integrated too, which is harmless
+	Concurrency::parallel_for(0u, jobCount, [&](uint32_t jobIndex)
+	{
+		const uint32_t first{ jobIndex * g_ParticlesPerJob };
+		const uint32_t last{ (std::min)(first + g_ParticlesPerJob, paddedCount) };
+
+		for (uint32_t index{ first }; index < last; index += 4)
+		{
+			float* pPositionX{ Block(m_PositionX, index) };
+			float* pPositionY{ Block(m_PositionY, index) };
+			float* pPositionZ{ Block(m_PositionZ, index) };
+			float* pVelocityX{ Block(m_VelocityX, index) };
+			float* pVelocityY{ Block(m_VelocityY, index) };
+			float* pVelocityZ{ Block(m_VelocityZ, index) };
+			float* pAge{ Block(m_Age, index) };
+
+			const Vector velocityX{ VectorAdd(VectorLoad(pVelocityX), gravityX) };
+			const Vector velocityY{ VectorAdd(VectorLoad(pVelocityY), gravityY) };
+			const Vector velocityZ{ VectorAdd(VectorLoad(pVelocityZ), gravityZ) };
+
+			VectorStore(pVelocityX, velocityX);
+			VectorStore(pVelocityY, velocityY);
+			VectorStore(pVelocityZ, velocityZ);
+
+			VectorStore(pPositionX, VectorMultiplyAdd(velocityX, timeStep, VectorLoad(pPositionX)));
+			VectorStore(pPositionY, VectorMultiplyAdd(velocityY, timeStep, VectorLoad(pPositionY)));
+			VectorStore(pPositionZ, VectorMultiplyAdd(velocityZ, timeStep, VectorLoad(pPositionZ)));
+
+			VectorStore(pAge, VectorAdd(VectorLoad(pAge), timeStep));
+		}
+	});
+}
+void ParticleSystem::Kill()
+{
+	const uint32_t startCount{ m_Count };
+
+	// Most blocks are fully alive, those are skipped with one compare
+	for (uint32_t index{}; index < m_Count; index += 4)
+	{
+		const Vector age{ VectorLoad(Block(m_Age, index)) };
+		const Vector lifetime{ VectorLoad(Block(m_Lifetime, index)) };
+		if (VectorMoveMask(VectorGreaterOrEqual(age, lifetime)) == 0) continue;
+
+		// Swap in from the tail, the moved particle is tested in the same slot
+		const uint32_t blockEnd{ index + 4 };
+		for (uint32_t lane{ index }; lane < blockEnd && lane < m_Count; ++lane)
+		{
+			while (lane < m_Count && m_Age[lane] >= m_Lifetime[lane]) RemoveAt(lane);
+		}
+	}
+
+	m_Statistics.killedCount = startCount - m_Count;
+}
+void ParticleSystem::RemoveAt(uint32_t index)
+{
+	const uint32_t last{ --m_Count };
+
+	m_PositionX[index] = m_PositionX[last];
+	m_PositionY[index] = m_PositionY[last];
+	m_PositionZ[index] = m_PositionZ[last];
+	m_VelocityX[index] = m_VelocityX[last];
+	m_VelocityY[index] = m_VelocityY[last];
+	m_VelocityZ[index] = m_VelocityZ[last];
+	m_Age[index] = m_Age[last];
+	m_Lifetime[index] = m_Lifetime[last];
+}
+
+void ParticleSystem::BuildSortKeys(const Float4x4& viewMatrix)
+{
+	const uint32_t paddedCount{ (m_Count + 3) & ~3u };
+
+	// View space depth is the third column of the view matrix
+	const Vector columnX{ VectorReplicate(viewMatrix.m[0][2]) };
+	const Vector columnY{ VectorReplicate(viewMatrix.m[1][2]) };
+	const Vector columnZ{ VectorReplicate(viewMatrix.m[2][2]) };
+	const Vector translation{ VectorReplicate(viewMatrix.m[3][2]) };
+	const Vector lowBits{ VectorReplicateInt(0x7FFFFFFF) };
+
+	for (uint32_t index{}; index < paddedCount; index += 4)
+	{
+		Vector depth{ VectorMultiplyAdd(VectorLoad(Block(m_PositionX, index)), columnX, translation) };
+		depth = VectorMultiplyAdd(VectorLoad(Block(m_PositionY, index)), columnY, depth);
+		depth = VectorMultiplyAdd(VectorLoad(Block(m_PositionZ, index)), columnZ, depth);
+
+		// Float bits to an unsigned key that sorts far to near:
+		// positive depths flip every bit but the sign, negative depths keep their bits
+		const Vector negative{ VectorLess(depth, VectorZero()) };
+		const Vector key{ VectorXorInt(depth, VectorAndCInt(lowBits, negative)) };
+
+		StoreInt4(m_SortKeys.data() + index, key);
+		m_SortIndices[index + 0] = index + 0;
+		m_SortIndices[index + 1] = index + 1;
+		m_SortIndices[index + 2] = index + 2;
+		m_SortIndices[index + 3] = index + 3;
+	}
+}
+void ParticleSystem::RadixSort()
+{
+	const uint32_t count{ m_Count };
+	const uint32_t chunkCount{ (count + g_SortChunkSize - 1) / g_SortChunkSize };
+	m_Histograms.resize(chunkCount);
+
+	for (uint32_t shift{}; shift < 32; shift += g_RadixBits)
+	{
+		// Count per chunk
+		Concurrency::parallel_for(0u, chunkCount, [&](uint32_t chunkIndex)
+		{
+			Histogram& histogram = m_Histograms[chunkIndex];
+			histogram.fill(0);
+
+			const uint32_t first{ chunkIndex * g_SortChunkSize };
+			const uint32_t last{ (std::min)(first + g_SortChunkSize, count) };
+			for (uint32_t index{ first }; index < last; ++index)
+			{
+				++histogram[(m_SortKeys[index] >> shift) & (g_RadixBuckets - 1)];
+			}
+		});
+
+		// Nothing moves when every key shares this digit
+		bool singleBucket{ false };
+		for (uint32_t bucket{}; bucket < g_RadixBuckets && !singleBucket; ++bucket)
+		{
+			uint32_t bucketTotal{};
+			for (const Histogram& histogram : m_Histograms) bucketTotal += histogram[bucket];
+			singleBucket = bucketTotal == count;
+		}
+		if (singleBucket) continue;
+
+		// Bucket major prefix sum keeps the sort stable across chunks
+		uint32_t offset{};
+		for (uint32_t bucket{}; bucket < g_RadixBuckets; ++bucket)
+		{
+			for (Histogram& histogram : m_Histograms)
+			{
+				const uint32_t bucketCount{ histogram[bucket] };
+				histogram[bucket] = offset;
+				offset += bucketCount;
+			}
+		}
+
+		// Scatter, every chunk owns its own ranges of the output
+		Concurrency::parallel_for(0u, chunkCount, [&](uint32_t chunkIndex)
+		{
+			Histogram& offsets = m_Histograms[chunkIndex];
+
+			const uint32_t first{ chunkIndex * g_SortChunkSize };
+			const uint32_t last{ (std::min)(first + g_SortChunkSize, count) };
+			for (uint32_t index{ first }; index < last; ++index)
+			{
+				const uint32_t key{ m_SortKeys[index] };
+				const uint32_t destination{ offsets[(key >> shift) & (g_RadixBuckets - 1)]++ };
+
+				m_SortKeysScratch[destination] = key;
+				m_SortIndicesScratch[destination] = m_SortIndices[index];
+			}
+		});
+
+		m_SortKeys.swap(m_SortKeysScratch);
+		m_SortIndices.swap(m_SortIndicesScratch);
+		++m_Statistics.sortPasses;
+	}
+}
+void ParticleSystem::BuildInstances()
+{
+	const uint32_t count{ m_Count };
+	const uint32_t jobCount{ (count + g_ParticlesPerJob - 1) / g_ParticlesPerJob };
+	m_Instances.resize(count);
+
+	const Vector startColor{ LoadFloat4(&m_Settings.startColor) };
+	const Vector endColor{ LoadFloat4(&m_Settings.endColor) };
+
+	// Gather in sorted order, fading color and size over the lifetime
+	Concurrency::parallel_for(0u, jobCount, [&](uint32_t jobIndex)
+	{
+		const uint32_t first{ jobIndex * g_ParticlesPerJob };
+		const uint32_t last{ (std::min)(first + g_ParticlesPerJob, count) };
+
+		for (uint32_t index{ first }; index < last; ++index)
+		{
+			const uint32_t particle{ m_SortIndices[index] };
+			const float lifeFraction{ (std::min)(m_Age[particle] / m_Lifetime[particle], 1.f) };
+
+			Instance& instance = m_Instances[index];
+			instance.position = Float3{ m_PositionX[particle], m_PositionY[particle], m_PositionZ[particle] };
+			instance.size = m_Settings.startSize + (m_Settings.endSize - m_Settings.startSize) * lifeFraction;
+			StoreFloat4(&instance.color, VectorLerp(startColor, endColor, lifeFraction));
+		}
+	});
+}
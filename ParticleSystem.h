@@ -0,0 +1,117 @@
+#pragma once
+
+#include "EngineMath.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// CPU particle simulation, stored as SoA so emission, integration and kill run 4 particles at a time
+// Dead particles are swap-removed, the live ones always stay packed at the front
+// Keep the instance layout in sync with Particle_VS.hlsl
+class ParticleSystem final
+{
+public:
+	// Structs
+	struct EmitterSettings
+	{
+		math::Float3 position;
+		float spawnRadius;				// Particles start inside a box of this half size
+		math::Float3 velocity;
+		float velocityJitter;			// Random velocity added on every axis
+		math::Float3 gravity;
+		float particlesPerSecond;
+		float minLifetime;
+		float maxLifetime;
+		float startSize;
+		float endSize;
+		math::Float4 startColor;
+		math::Float4 endColor;		// Alpha fades towards this one
+	};
+
+	struct Instance					// One quad, matches the per-instance input of Particle_VS.hlsl
+	{
+		math::Float3 position;
+		float size;
+		math::Float4 color;
+	};
+
+	static_assert((sizeof(Instance) % 16) == 0, "Instance data should be 16-byte aligned");
+
+	struct Statistics
+	{
+		double emitMs;
+		double simulateMs;
+		double killMs;
+		double sortMs;
+		double buildMs;
+		uint32_t aliveCount;
+		uint32_t emittedCount;
+		uint32_t killedCount;
+		uint32_t sortPasses;		// Radix passes that weren't skipped
+	};
+
+	// Rule of five
+	explicit ParticleSystem(uint32_t capacity);
+	~ParticleSystem() = default;
+
+	ParticleSystem(const ParticleSystem& other) = delete;
+	ParticleSystem(ParticleSystem&& other) = delete;
+	ParticleSystem& operator= (const ParticleSystem& other) = delete;
+	ParticleSystem& operator= (ParticleSystem&& other) = delete;
+
+	// Publics
+	void SetEmitter(const EmitterSettings& settings) { m_Settings = settings; }
+	void Update(float deltaTime);								// Emit, integrate and kill
+	void SortByDepth(const math::Float4x4& viewMatrix);	// Back to front for alpha blending, then rebuilds the instances
+
+	const std::vector<Instance>& GetInstances() const { return m_Instances; }
+	uint32_t GetCount() const { return m_Count; }
+	uint32_t GetCapacity() const { return m_Capacity; }
+	const Statistics& GetStatistics() const { return m_Statistics; }
+
+private:
+	// Structs
+	static constexpr uint32_t g_RadixBits{ 8 };
+	static constexpr uint32_t g_RadixBuckets{ 1 << g_RadixBits };
+
+	using Histogram = std::array<uint32_t, g_RadixBuckets>;
+
+	// Member variables
+	uint32_t m_Capacity;
+	uint32_t m_Count;
+
+	// Every array has room for one extra 4-wide block past the capacity
+	std::vector<float> m_PositionX;
+	std::vector<float> m_PositionY;
+	std::vector<float> m_PositionZ;
+	std::vector<float> m_VelocityX;
+	std::vector<float> m_VelocityY;
+	std::vector<float> m_VelocityZ;
+	std::vector<float> m_Age;
+	std::vector<float> m_Lifetime;
+
+	EmitterSettings m_Settings;
+	float m_EmitAccumulator;
+	uint32_t m_EmitSeed;
+
+	// Sorting
+	std::vector<uint32_t> m_SortKeys;
+	std::vector<uint32_t> m_SortIndices;
+	std::vector<uint32_t> m_SortKeysScratch;
+	std::vector<uint32_t> m_SortIndicesScratch;
+	std::vector<Histogram> m_Histograms;	// One per sort chunk
+
+	std::vector<Instance> m_Instances;
+	Statistics m_Statistics;
+
+	// Member functions
+	void Emit(uint32_t count);
+	void Integrate(float deltaTime);
+	void Kill();
+	void RemoveAt(uint32_t index);
+
+	void BuildSortKeys(const math::Float4x4& viewMatrix);
+	void RadixSort();
+	void BuildInstances();
+};
@@ -0,0 +1,315 @@
+#include "PerformanceCounters.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <psapi.h>
+#pragma comment(lib, "Ws2_32.lib")
+#pragma comment(lib, "Psapi.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "Logger.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+#ifdef _WIN32
+	constexpr uintptr_t g_NoSocket{ INVALID_SOCKET };
+#else
+	constexpr uintptr_t g_NoSocket{ static_cast<uintptr_t>(-1) };
+#endif
+}
+
+PerformanceCounters::PerformanceCounters()
+	: m_RegisterMutex{}
+	, m_Names{}
+	, m_Kinds{}
+	, m_ValueCount{ 0 }
+	, m_Values{}
+	, m_FrameTimes{ g_HistogramSlices, g_HistogramSliceUs }
+	, m_FrameIndex{ 0 }
+	, m_StartTime{ std::chrono::steady_clock::now() }
+	, m_SnapshotSequence{ 0 }
+	, m_SnapshotWords{}
+	, m_DumpThread{}
+	, m_DumpMutex{}
+	, m_DumpCondition{}
+	, m_StopDump{ false }
+	, m_DumpTarget{ DumpTarget::None }
+	, m_DumpFilePath{}
+	, m_DumpSocket{ g_NoSocket }
+	, m_DumpPort{ 0 }
+{
+	for (std::atomic<int64_t>& value : m_Values) value.store(0, std::memory_order_relaxed);
+	for (std::atomic<uint64_t>& word : m_SnapshotWords) word.store(0, std::memory_order_relaxed);
+}
+PerformanceCounters::~PerformanceCounters()
+{
+	StopDump();
+}
+
+uint32_t PerformanceCounters::Register(const char* pName, Kind kind)
+{
+	std::lock_guard<std::mutex> lock{ m_RegisterMutex };
+
+	const uint32_t count{ m_ValueCount.load(std::memory_order_relaxed) };
+	for (uint32_t id{}; id < count; ++id)
+	{
+		if (std::strcmp(m_Names[id], pName) == 0) return id;
+	}
+
+	if (count == g_MaxValues)
+	{
+		Logger::Log(L"ERROR - Too many performance counters");
+		return g_InvalidId;
+	}
+
+	// The count is published last, so readers never see a half registered value
+	m_Names[count] = pName;
+	m_Kinds[count] = kind;
+	m_Values[count].store(0, std::memory_order_relaxed);
+	m_ValueCount.store(count + 1, std::memory_order_release);
+	return count;
+}
+
+void PerformanceCounters::EndFrame(int64_t frameTimeUs)
+{
+	m_FrameTimes.Advance(frameTimeUs);
+	m_FrameTimes.Record(frameTimeUs);
+	++m_FrameIndex;
+
+	PublishSnapshot();
+}
+bool PerformanceCounters::GetSnapshot(Snapshot& snapshot) const
+{
+	std::array<uint64_t, g_SnapshotWords> words;
+
+	// Retry while the render thread is halfway through a publish, it never waits for a reader
+	uint64_t sequence{};
+	for (;;)
+	{
+		sequence = m_SnapshotSequence.load(std::memory_order_acquire);
+		if ((sequence & 1) != 0)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		for (uint32_t wordIndex{}; wordIndex < g_SnapshotWords; ++wordIndex)
+		{
+			words[wordIndex] = m_SnapshotWords[wordIndex].load(std::memory_order_relaxed);
+		}
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (m_SnapshotSequence.load(std::memory_order_relaxed) == sequence) break;
+	}
+
+	if (sequence == 0) return false;
+
+	uint32_t wordIndex{};
+	snapshot.frameIndex = words[wordIndex++];
+	snapshot.uptimeSeconds = std::bit_cast<double>(words[wordIndex++]);
+	snapshot.valueCount = static_cast<uint32_t>(words[wordIndex++]);
+	for (int64_t& value : snapshot.values) value = static_cast<int64_t>(words[wordIndex++]);
+
+	snapshot.frameTime.count = words[wordIndex++];
+	snapshot.frameTime.mean = std::bit_cast<double>(words[wordIndex++]);
+	snapshot.frameTime.p50 = static_cast<int64_t>(words[wordIndex++]);
+	snapshot.frameTime.p90 = static_cast<int64_t>(words[wordIndex++]);
+	snapshot.frameTime.p99 = static_cast<int64_t>(words[wordIndex++]);
+	snapshot.frameTime.p999 = static_cast<int64_t>(words[wordIndex++]);
+	snapshot.frameTime.max = static_cast<int64_t>(words[wordIndex++]);
+	return true;
+}
+
+bool PerformanceCounters::StartFileDump(const std::wstring& filePath, std::chrono::milliseconds interval)
+{
+	StopDump();
+
+	m_DumpFilePath = filePath;
+	return StartDump(DumpTarget::File, interval);
+}
+bool PerformanceCounters::StartSocketDump(uint16_t port, std::chrono::milliseconds interval)
+{
+	StopDump();
+
+#ifdef _WIN32
+	WSADATA socketData{};
+	if (WSAStartup(MAKEWORD(2, 2), &socketData) != 0)
+	{
+		Logger::Log(L"ERROR - Failed to initialize the sockets for the counter dump");
+		return false;
+	}
+#endif
+
+	m_DumpSocket = static_cast<uintptr_t>(socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+	if (m_DumpSocket == g_NoSocket)
+	{
+		Logger::Log(L"ERROR - Failed to create the counter dump socket");
+#ifdef _WIN32
+		WSACleanup();
+#endif
+		return false;
+	}
+
+	m_DumpPort = port;
+	return StartDump(DumpTarget::Socket, interval);
+}
+void PerformanceCounters::StopDump()
+{
+	if (m_DumpThread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock{ m_DumpMutex };
+			m_StopDump = true;
+		}
+		m_DumpCondition.notify_one();
+		m_DumpThread.join();
+	}
+
+	if (m_DumpSocket != g_NoSocket)
+	{
+#ifdef _WIN32
+		closesocket(static_cast<SOCKET>(m_DumpSocket));
+		WSACleanup();
+#else
+		close(static_cast<int>(m_DumpSocket));
+#endif
+		m_DumpSocket = g_NoSocket;
+	}
+
+	m_DumpTarget = DumpTarget::None;
+	m_StopDump = false;
+}
+
+int64_t PerformanceCounters::QueryResidentBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS memoryCounters{};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &memoryCounters, sizeof(memoryCounters))) return 0;
+	return static_cast<int64_t>(memoryCounters.WorkingSetSize);
+#else
+	// Second field of statm is the resident page count
+	std::ifstream statm{ "/proc/self/statm" };
+	int64_t totalPages{}, residentPages{};
+	if (!(statm >> totalPages >> residentPages)) return 0;
+	return residentPages * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+// Privates
+// --------
+void PerformanceCounters::PublishSnapshot()
+{
+	const RollingHistogram::Summary frameTime{ m_FrameTimes.GetSummary() };
+	const double uptimeSeconds{ std::chrono::duration<double>(std::chrono::steady_clock::now() - m_StartTime).count() };
+	const uint32_t valueCount{ GetValueCount() };
+
+	const uint64_t sequence{ m_SnapshotSequence.load(std::memory_order_relaxed) };
+	m_SnapshotSequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	uint32_t wordIndex{};
+	const auto write = [&](uint64_t word) { m_SnapshotWords[wordIndex++].store(word, std::memory_order_relaxed); };
+
+	write(m_FrameIndex);
+	write(std::bit_cast<uint64_t>(uptimeSeconds));
+	write(valueCount);
+	for (uint32_t id{}; id < g_MaxValues; ++id) write(static_cast<uint64_t>(m_Values[id].load(std::memory_order_relaxed)));
+
+	write(frameTime.count);
+	write(std::bit_cast<uint64_t>(frameTime.mean));
+	write(static_cast<uint64_t>(frameTime.p50));
+	write(static_cast<uint64_t>(frameTime.p90));
+	write(static_cast<uint64_t>(frameTime.p99));
+	write(static_cast<uint64_t>(frameTime.p999));
+	write(static_cast<uint64_t>(frameTime.max));
+
+	m_SnapshotSequence.store(sequence + 2, std::memory_order_release);
+}
+bool PerformanceCounters::StartDump(DumpTarget target, std::chrono::milliseconds interval)
+{
+	m_DumpTarget = target;
+	m_StopDump = false;
+	m_DumpThread = std::thread{ [this, interval]() { DumpLoop(interval); } };
+	return true;
+}
+void PerformanceCounters::DumpLoop(std::chrono::milliseconds interval)
+{
+	std::unique_lock<std::mutex> lock{ m_DumpMutex };
+	while (!m_DumpCondition.wait_for(lock, interval, [this]() { return m_StopDump; }))
+	{
+		// Only this thread touches the target, the snapshot copy is lock free
+		Snapshot snapshot{};
+		if (GetSnapshot(snapshot)) WriteDump(snapshot);
+	}
+}
+void PerformanceCounters::WriteDump(const Snapshot& snapshot)
+{
+	const RollingHistogram::Summary& frameTime = snapshot.frameTime;
+	const uint32_t valueCount{ (std::min)(snapshot.valueCount, g_MaxValues) };
+
+	std::ostringstream text;
+	if (m_DumpTarget == DumpTarget::File)
+	{
+		// One "name value" pair per line
+		text << "frame " << snapshot.frameIndex << '\n'
+			<< "uptime_s " << snapshot.uptimeSeconds << '\n'
+			<< "frame_time_us.count " << frameTime.count << '\n'
+			<< "frame_time_us.mean " << frameTime.mean << '\n'
+			<< "frame_time_us.p50 " << frameTime.p50 << '\n'
+			<< "frame_time_us.p90 " << frameTime.p90 << '\n'
+			<< "frame_time_us.p99 " << frameTime.p99 << '\n'
+			<< "frame_time_us.p999 " << frameTime.p999 << '\n'
+			<< "frame_time_us.max " << frameTime.max << '\n';
+		for (uint32_t id{}; id < valueCount; ++id) text << m_Names[id] << ' ' << snapshot.values[id] << '\n';
+
+		// Written next to the target and renamed over it, so a reader never sees half a dump
+		const std::filesystem::path filePath{ m_DumpFilePath };
+		std::filesystem::path temporaryPath{ filePath };
+		temporaryPath += L".tmp";
+		{
+			std::ofstream file{ temporaryPath, std::ios::binary | std::ios::trunc };
+			if (!file) return;
+			file << text.str();
+		}
+
+		std::error_code error{};
+		std::filesystem::rename(temporaryPath, filePath, error);
+	}
+	else if (m_DumpTarget == DumpTarget::Socket)
+	{
+		// StatsD gauges, counters are sent as their running total
+		text << "frame:" << snapshot.frameIndex << "|g\n"
+			<< "frame_time_us.mean:" << frameTime.mean << "|g\n"
+			<< "frame_time_us.p50:" << frameTime.p50 << "|g\n"
+			<< "frame_time_us.p90:" << frameTime.p90 << "|g\n"
+			<< "frame_time_us.p99:" << frameTime.p99 << "|g\n"
+			<< "frame_time_us.p999:" << frameTime.p999 << "|g\n"
+			<< "frame_time_us.max:" << frameTime.max << "|g\n";
+		for (uint32_t id{}; id < valueCount; ++id) text << m_Names[id] << ':' << snapshot.values[id] << "|g\n";
+
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(m_DumpPort);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		const std::string datagram{ text.str() };
+#ifdef _WIN32
+		sendto(static_cast<SOCKET>(m_DumpSocket), datagram.data(), static_cast<int>(datagram.size()), 0, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+#else
+		sendto(static_cast<int>(m_DumpSocket), datagram.data(), datagram.size(), 0, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+#endif
+	}
+}
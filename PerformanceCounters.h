@@ -0,0 +1,122 @@
+#pragma once
+#include "Singleton.h"
+#include "RollingHistogram.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Process wide counters and gauges, with a rolling histogram of the frame times
+// Any thread updates a value with one relaxed atomic, the render thread publishes a snapshot of all of them once per frame
+// Readers copy the last snapshot without taking a lock, so monitoring never stalls the frame
+// The optional dump thread writes the snapshot to a file or a loopback UDP port at a fixed interval
+class PerformanceCounters final : public Singleton<PerformanceCounters>
+{
+public:
+	// Structs
+	enum class Kind : uint8_t
+	{
+		Counter,		// Only grows, reported as a running total
+		Gauge			// Current level, set or adjusted
+	};
+
+	static constexpr uint32_t g_MaxValues{ 32 };
+	static constexpr uint32_t g_InvalidId{ g_MaxValues };
+	static constexpr std::chrono::milliseconds g_DefaultDumpInterval{ 1000 };
+
+	struct Snapshot
+	{
+		uint64_t frameIndex;
+		double uptimeSeconds;
+		uint32_t valueCount;
+		std::array<int64_t, g_MaxValues> values;	// Indexed by id
+		RollingHistogram::Summary frameTime;		// Microseconds, over the rolling window
+	};
+
+	// Destructor
+	~PerformanceCounters() override;
+
+	// Publics
+	uint32_t Register(const char* pName, Kind kind);	// Name must be a literal, the same name returns the same id
+	void Add(uint32_t id, int64_t delta)
+	{
+		if (id < g_MaxValues) m_Values[id].fetch_add(delta, std::memory_order_relaxed);
+	}
+	void Set(uint32_t id, int64_t value)
+	{
+		if (id < g_MaxValues) m_Values[id].store(value, std::memory_order_relaxed);
+	}
+	int64_t Get(uint32_t id) const { return id < g_MaxValues ? m_Values[id].load(std::memory_order_relaxed) : 0; }
+
+	const char* GetName(uint32_t id) const { return id < GetValueCount() ? m_Names[id] : ""; }
+	Kind GetKind(uint32_t id) const { return id < GetValueCount() ? m_Kinds[id] : Kind::Gauge; }
+	uint32_t GetValueCount() const { return m_ValueCount.load(std::memory_order_acquire); }
+
+	void EndFrame(int64_t frameTimeUs);				// Render thread only, records the frame time and publishes the snapshot
+	bool GetSnapshot(Snapshot& snapshot) const;		// Any thread, false before the first frame
+
+	bool StartFileDump(const std::wstring& filePath, std::chrono::milliseconds interval = g_DefaultDumpInterval);
+	bool StartSocketDump(uint16_t port, std::chrono::milliseconds interval = g_DefaultDumpInterval);
+	void StopDump();
+
+	static int64_t QueryResidentBytes();			// Working set of the process, 0 when unknown
+
+private:
+	// Initialization
+	friend class Singleton<PerformanceCounters>;
+	PerformanceCounters();
+
+	PerformanceCounters(const PerformanceCounters& other) = delete;
+	PerformanceCounters(PerformanceCounters&& other) = delete;
+	PerformanceCounters& operator= (const PerformanceCounters& other) = delete;
+	PerformanceCounters& operator= (PerformanceCounters&& other) = delete;
+
+	// Structs
+	enum class DumpTarget
+	{
+		None,
+		File,
+		Socket
+	};
+
+	static constexpr uint32_t g_HistogramSlices{ 10 };
+	static constexpr int64_t g_HistogramSliceUs{ 1'000'000 };	// 10 seconds of frames
+
+	// Snapshot words: frame index, uptime, value count, the values, then the 7 histogram fields
+	static constexpr uint32_t g_SnapshotWords{ 3 + g_MaxValues + 7 };
+
+	// Member variables
+	std::mutex m_RegisterMutex;
+	std::array<const char*, g_MaxValues> m_Names;
+	std::array<Kind, g_MaxValues> m_Kinds;
+	std::atomic<uint32_t> m_ValueCount;
+	std::array<std::atomic<int64_t>, g_MaxValues> m_Values;
+
+	RollingHistogram m_FrameTimes;
+	uint64_t m_FrameIndex;
+	std::chrono::steady_clock::time_point m_StartTime;
+
+	// Seqlock, odd while the render thread rewrites the words
+	std::atomic<uint64_t> m_SnapshotSequence;
+	std::array<std::atomic<uint64_t>, g_SnapshotWords> m_SnapshotWords;
+
+	std::thread m_DumpThread;
+	std::mutex m_DumpMutex;
+	std::condition_variable m_DumpCondition;
+	bool m_StopDump;
+	DumpTarget m_DumpTarget;
+	std::wstring m_DumpFilePath;
+	uintptr_t m_DumpSocket;
+	uint16_t m_DumpPort;
+
+	// Member functions
+	void PublishSnapshot();
+	bool StartDump(DumpTarget target, std::chrono::milliseconds interval);
+	void DumpLoop(std::chrono::milliseconds interval);
+	void WriteDump(const Snapshot& snapshot);
+};
@@ -0,0 +1,577 @@
+#include "PipelineStateCache.h"
+#include "Logger.h"
+#include "Utils.h"
+#include "Hash.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+
+namespace
+{
+	constexpr uint32_t g_KeyFileMagic{ 0x32435350 };	// "PSC2"
+	constexpr uint32_t g_OldKeyFileMagic{ 0x31435350 };	// "PSC1", named runtime compiled shaders after their HLSL source
+
+	// Only compiled shader resources can be read back as bytecode, shaders compiled at runtime (the permutation variants) carry theirs in the record
+	bool IsBytecodeResource(const std::wstring& resourceName)
+	{
+		constexpr std::wstring_view extension{ L".cso" };
+		return resourceName.size() >= extension.size() && resourceName.compare(resourceName.size() - extension.size(), extension.size(), extension) == 0;
+	}
+
+	// Small helpers to (de)serialize recipes
+	class RecipeWriter final
+	{
+	public:
+		template <typename T>
+		void Write(const T& value)
+		{
+			const char* pBytes = reinterpret_cast<const char*>(&value);
+			m_Bytes.insert(m_Bytes.end(), pBytes, pBytes + sizeof(T));
+		}
+		void WriteString(const std::string& string)
+		{
+			Write(static_cast<uint32_t>(string.size()));
+			m_Bytes.insert(m_Bytes.end(), string.begin(), string.end());
+		}
+		void WriteString(const std::wstring& string)
+		{
+			Write(static_cast<uint32_t>(string.size()));
+			const char* pBytes = reinterpret_cast<const char*>(string.data());
+			m_Bytes.insert(m_Bytes.end(), pBytes, pBytes + string.size() * sizeof(wchar_t));
+		}
+
+		void WriteShader(const std::wstring& resourceName, const std::vector<char>& bytecode)
+		{
+			WriteString(resourceName);
+			const bool isEmbedded{ !IsBytecodeResource(resourceName) };
+			Write(isEmbedded);
+			if (isEmbedded) WriteString(std::string{ bytecode.begin(), bytecode.end() });
+		}
+
+		std::vector<char>&& Release() { return std::move(m_Bytes); }
+
+	private:
+		std::vector<char> m_Bytes;
+	};
+
+	class RecipeReader final
+	{
+	public:
+		RecipeReader(const std::vector<char>& bytes) : m_Bytes{ bytes }, m_Offset{} {}
+
+		template <typename T>
+		bool Read(T& value)
+		{
+			if (m_Offset + sizeof(T) > m_Bytes.size()) return false;
+			std::memcpy(&value, m_Bytes.data() + m_Offset, sizeof(T));
+			m_Offset += sizeof(T);
+			return true;
+		}
+		bool ReadString(std::string& string)
+		{
+			uint32_t length{};
+			if (!Read(length) || m_Offset + length > m_Bytes.size()) return false;
+			string.assign(m_Bytes.data() + m_Offset, length);
+			m_Offset += length;
+			return true;
+		}
+		bool ReadString(std::wstring& string)
+		{
+			uint32_t length{};
+			if (!Read(length) || m_Offset + length * sizeof(wchar_t) > m_Bytes.size()) return false;
+			string.resize(length);
+			std::memcpy(string.data(), m_Bytes.data() + m_Offset, length * sizeof(wchar_t));
+			m_Offset += length * sizeof(wchar_t);
+			return true;
+		}
+
+	private:
+		const std::vector<char>& m_Bytes;
+		size_t m_Offset;
+	};
+}
+
+D3D11PipelineObjectFactory::D3D11PipelineObjectFactory(ID3D11Device* pDevice)
+	: m_pDevice{ pDevice }
+{
+}
+
+ID3D11VertexShader* D3D11PipelineObjectFactory::CreateVertexShader(const std::vector<char>& bytecode)
+{
+	ID3D11VertexShader* pShader{};
+	if (FAILED(m_pDevice->CreateVertexShader(bytecode.data(), bytecode.size(), nullptr, &pShader))) return nullptr;
+	return pShader;
+}
+ID3D11PixelShader* D3D11PipelineObjectFactory::CreatePixelShader(const std::vector<char>& bytecode)
+{
+	ID3D11PixelShader* pShader{};
+	if (FAILED(m_pDevice->CreatePixelShader(bytecode.data(), bytecode.size(), nullptr, &pShader))) return nullptr;
+	return pShader;
+}
+ID3D11InputLayout* D3D11PipelineObjectFactory::CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* pElements, UINT elementCount, const std::vector<char>& bytecode)
+{
+	ID3D11InputLayout* pInputLayout{};
+	if (FAILED(m_pDevice->CreateInputLayout(pElements, elementCount, bytecode.data(), bytecode.size(), &pInputLayout))) return nullptr;
+	return pInputLayout;
+}
+
+ID3D11RasterizerState* D3D11PipelineObjectFactory::CreateRasterizerState(const D3D11_RASTERIZER_DESC& description)
+{
+	ID3D11RasterizerState* pState{};
+	if (FAILED(m_pDevice->CreateRasterizerState(&description, &pState))) return nullptr;
+	return pState;
+}
+ID3D11DepthStencilState* D3D11PipelineObjectFactory::CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& description)
+{
+	ID3D11DepthStencilState* pState{};
+	if (FAILED(m_pDevice->CreateDepthStencilState(&description, &pState))) return nullptr;
+	return pState;
+}
+ID3D11BlendState* D3D11PipelineObjectFactory::CreateBlendState(const D3D11_BLEND_DESC& description)
+{
+	ID3D11BlendState* pState{};
+	if (FAILED(m_pDevice->CreateBlendState(&description, &pState))) return nullptr;
+	return pState;
+}
+
+PipelineStateCache::PipelineStateCache(std::unique_ptr<PipelineObjectFactory> pFactory)
+	: m_pFactory{ std::move(pFactory) }
+	, m_VertexShaders{}
+	, m_PixelShaders{}
+	, m_InputLayouts{}
+	, m_RasterizerStates{}
+	, m_DepthStencilStates{}
+	, m_BlendStates{}
+	, m_Records{}
+	, m_WarmedCount{}
+	, m_WarmMs{}
+{
+}
+
+// Lookup-or-create
+// ----------------
+ID3D11VertexShader* PipelineStateCache::GetVertexShader(const std::wstring& resourceName, const std::vector<char>& bytecode)
+{
+	const uint64_t key{ HashShader(static_cast<uint8_t>(EntryType::VertexShader), bytecode) };
+
+	bool created{};
+	ID3D11VertexShader* pShader = m_VertexShaders.GetOrCreate(key, [&] { return m_pFactory->CreateVertexShader(bytecode); }, &created);
+
+	if (created)
+	{
+		RecipeWriter writer{};
+		writer.WriteShader(resourceName, bytecode);
+		AddRecord(EntryType::VertexShader, key, writer.Release());
+	}
+
+	return pShader;
+}
+ID3D11PixelShader* PipelineStateCache::GetPixelShader(const std::wstring& resourceName, const std::vector<char>& bytecode)
+{
+	const uint64_t key{ HashShader(static_cast<uint8_t>(EntryType::PixelShader), bytecode) };
+
+	bool created{};
+	ID3D11PixelShader* pShader = m_PixelShaders.GetOrCreate(key, [&] { return m_pFactory->CreatePixelShader(bytecode); }, &created);
+
+	if (created)
+	{
+		RecipeWriter writer{};
+		writer.WriteShader(resourceName, bytecode);
+		AddRecord(EntryType::PixelShader, key, writer.Release());
+	}
+
+	return pShader;
+}
+ID3D11InputLayout* PipelineStateCache::GetInputLayout(const D3D11_INPUT_ELEMENT_DESC* pElements, UINT elementCount, const std::wstring& resourceName, const std::vector<char>& bytecode)
+{
+	const uint64_t key{ HashInputLayout(pElements, elementCount, bytecode) };
+
+	bool created{};
+	ID3D11InputLayout* pInputLayout = m_InputLayouts.GetOrCreate(key, [&] { return m_pFactory->CreateInputLayout(pElements, elementCount, bytecode); }, &created);
+
+	if (created)
+	{
+		RecipeWriter writer{};
+		writer.WriteShader(resourceName, bytecode);
+		writer.Write(elementCount);
+		for (UINT index{}; index < elementCount; ++index)
+		{
+			const D3D11_INPUT_ELEMENT_DESC& element = pElements[index];
+			writer.WriteString(std::string{ element.SemanticName });
+			writer.Write(element.SemanticIndex);
+			writer.Write(element.Format);
+			writer.Write(element.InputSlot);
+			writer.Write(element.AlignedByteOffset);
+			writer.Write(element.InputSlotClass);
+			writer.Write(element.InstanceDataStepRate);
+		}
+		AddRecord(EntryType::InputLayout, key, writer.Release());
+	}
+
+	return pInputLayout;
+}
+
+ID3D11RasterizerState* PipelineStateCache::GetRasterizerState(const D3D11_RASTERIZER_DESC& description)
+{
+	const uint64_t key{ HashRasterizerState(description) };
+
+	bool created{};
+	ID3D11RasterizerState* pState = m_RasterizerStates.GetOrCreate(key, [&] { return m_pFactory->CreateRasterizerState(description); }, &created);
+
+	if (created)
+	{
+		RecipeWriter writer{};
+		writer.Write(description);
+		AddRecord(EntryType::RasterizerState, key, writer.Release());
+	}
+
+	return pState;
+}
+ID3D11DepthStencilState* PipelineStateCache::GetDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& description)
+{
+	const uint64_t key{ HashDepthStencilState(description) };
+
+	bool created{};
+	ID3D11DepthStencilState* pState = m_DepthStencilStates.GetOrCreate(key, [&] { return m_pFactory->CreateDepthStencilState(description); }, &created);
+
+	if (created)
+	{
+		RecipeWriter writer{};
+		writer.Write(description);
+		AddRecord(EntryType::DepthStencilState, key, writer.Release());
+	}
+
+	return pState;
+}
+ID3D11BlendState* PipelineStateCache::GetBlendState(const D3D11_BLEND_DESC& description)
+{
+	const uint64_t key{ HashBlendState(description) };
+
+	bool created{};
+	ID3D11BlendState* pState = m_BlendStates.GetOrCreate(key, [&] { return m_pFactory->CreateBlendState(description); }, &created);
+
+	if (created)
+	{
+		RecipeWriter writer{};
+		writer.Write(description);
+		AddRecord(EntryType::BlendState, key, writer.Release());
+	}
+
+	return pState;
+}
+
+// Persistence
+// -----------
+void PipelineStateCache::WarmFromFile(const std::wstring& filePath, const utils::ResourceReader& readResource)
+{
+	std::vector<char> fileBytes;
+	if (!utils::ReadBinaryFile(filePath, fileBytes))
+	{
+		Logger::Log(L"No pipeline state key file found, starting with a cold cache");
+		return;
+	}
+
+	RecipeReader fileReader{ fileBytes };
+	uint32_t magic{};
+	uint32_t recordCount{};
+	if (fileReader.Read(magic) && magic == g_OldKeyFileMagic)
+	{
+		Logger::Log(L"Pipeline state key file is from an older version, starting with a cold cache");
+		return;
+	}
+	if (magic != g_KeyFileMagic || !fileReader.Read(recordCount))
+	{
+		Logger::Log(L"ERROR - Pipeline state key file is invalid, ignoring it");
+		return;
+	}
+
+	const auto startTime{ std::chrono::steady_clock::now() };
+
+	// Shaders are reloaded once per resource, layouts and shaders often share the same file
+	std::unordered_map<std::wstring, std::vector<char>> loadedBytecode;
+	auto getBytecode = [&](const std::wstring& resourceName) -> const std::vector<char>*
+	{
+		auto foundIt = loadedBytecode.find(resourceName);
+		if (foundIt == loadedBytecode.end())
+		{
+			std::vector<char> bytecode;
+			if (!readResource(resourceName, bytecode)) return nullptr;
+			foundIt = loadedBytecode.emplace(resourceName, std::move(bytecode)).first;
+		}
+		return &foundIt->second;
+	};
+
+	// The name and either the bytecode carried by the record or the resource it names
+	auto readShader = [&](RecipeReader& reader, std::wstring& resourceName, std::vector<char>& embeddedBytecode) -> const std::vector<char>*
+	{
+		bool isEmbedded{};
+		if (!reader.ReadString(resourceName) || !reader.Read(isEmbedded)) return nullptr;
+		if (!isEmbedded) return getBytecode(resourceName);
+
+		std::string bytecode;
+		if (!reader.ReadString(bytecode)) return nullptr;
+		embeddedBytecode.assign(bytecode.begin(), bytecode.end());
+		return &embeddedBytecode;
+	};
+
+	std::wstringstream message;
+	for (uint32_t recordIndex{}; recordIndex < recordCount; ++recordIndex)
+	{
+		uint8_t type{};
+		uint64_t key{};
+		std::string recipeBytes;
+		if (!fileReader.Read(type) || !fileReader.Read(key) || !fileReader.ReadString(recipeBytes))
+		{
+			Logger::Log(L"ERROR - Pipeline state key file is truncated");
+			break;
+		}
+
+		const std::vector<char> recipe{ recipeBytes.begin(), recipeBytes.end() };
+		RecipeReader reader{ recipe };
+		std::wstring resourceName;
+		std::vector<char> embeddedBytecode;
+		bool warmed{ false };
+		bool isStale{ false };	// The resource no longer holds the bytecode the key was made from
+
+		switch (static_cast<EntryType>(type))
+		{
+		case EntryType::VertexShader:
+		case EntryType::PixelShader:
+		{
+			const std::vector<char>* pBytecode = readShader(reader, resourceName, embeddedBytecode);
+			if (!pBytecode) break;
+
+			isStale = HashShader(type, *pBytecode) != key;
+			if (isStale) break;
+
+			if (static_cast<EntryType>(type) == EntryType::VertexShader) warmed = GetVertexShader(resourceName, *pBytecode) != nullptr;
+			else warmed = GetPixelShader(resourceName, *pBytecode) != nullptr;
+		}
+		break;
+
+		case EntryType::InputLayout:
+		{
+			UINT elementCount{};
+			const std::vector<char>* pBytecode = readShader(reader, resourceName, embeddedBytecode);
+			if (!pBytecode || !reader.Read(elementCount)) break;
+
+			// Semantic names must outlive the element descriptions
+			std::vector<std::string> semanticNames(elementCount);
+			std::vector<D3D11_INPUT_ELEMENT_DESC> elements(elementCount);
+
+			bool validRecipe{ true };
+			for (UINT index{}; index < elementCount && validRecipe; ++index)
+			{
+				D3D11_INPUT_ELEMENT_DESC& element = elements[index];
+				validRecipe = reader.ReadString(semanticNames[index])
+					&& reader.Read(element.SemanticIndex)
+					&& reader.Read(element.Format)
+					&& reader.Read(element.InputSlot)
+					&& reader.Read(element.AlignedByteOffset)
+					&& reader.Read(element.InputSlotClass)
+					&& reader.Read(element.InstanceDataStepRate);
+				element.SemanticName = semanticNames[index].c_str();
+			}
+			if (!validRecipe) break;
+
+			isStale = HashInputLayout(elements.data(), elementCount, *pBytecode) != key;
+			if (isStale) break;
+
+			warmed = GetInputLayout(elements.data(), elementCount, resourceName, *pBytecode) != nullptr;
+		}
+		break;
+
+		case EntryType::RasterizerState:
+		{
+			D3D11_RASTERIZER_DESC description{};
+			if (reader.Read(description)) warmed = GetRasterizerState(description) != nullptr;
+		}
+		break;
+
+		case EntryType::DepthStencilState:
+		{
+			D3D11_DEPTH_STENCIL_DESC description{};
+			if (reader.Read(description)) warmed = GetDepthStencilState(description) != nullptr;
+		}
+		break;
+
+		case EntryType::BlendState:
+		{
+			D3D11_BLEND_DESC description{};
+			if (reader.Read(description)) warmed = GetBlendState(description) != nullptr;
+		}
+		break;
+		}
+
+		if (warmed)
+		{
+			++m_WarmedCount;
+			continue;
+		}
+
+		// Rebuilt on first use like on a cold start, a shader rebuilt since the last run is expected but any other failure means the records are wrong
+		message.str(L"");
+		if (isStale) message << L"Pipeline state record " << recordIndex << L" for " << resourceName << L" is stale, the shader changed since the key was saved";
+		else
+		{
+			message << L"ERROR - Failed to warm pipeline state record " << recordIndex << L" (type " << static_cast<uint32_t>(type) << L")";
+			if (!resourceName.empty()) message << L" for " << resourceName;
+		}
+		Logger::Log(message.str());
+	}
+
+	m_WarmMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+	message.str(L"");
+	message << L"Warmed " << m_WarmedCount << L"/" << recordCount << L" pipeline states in " << m_WarmMs << L" ms";
+	Logger::Log(message.str());
+}
+bool PipelineStateCache::SaveKeysToFile(const std::wstring& filePath) const
+{
+	std::ofstream file{ filePath.c_str(), std::ofstream::binary | std::ofstream::trunc };
+	if (!file)
+	{
+		Logger::Log(L"ERROR - Failed to open the pipeline state key file for writing");
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock{ m_RecordMutex };
+
+	const uint32_t recordCount{ static_cast<uint32_t>(m_Records.size()) };
+	file.write(reinterpret_cast<const char*>(&g_KeyFileMagic), sizeof(g_KeyFileMagic));
+	file.write(reinterpret_cast<const char*>(&recordCount), sizeof(recordCount));
+
+	for (const KeyRecord& record : m_Records)
+	{
+		const uint8_t type{ static_cast<uint8_t>(record.type) };
+		const uint32_t recipeSize{ static_cast<uint32_t>(record.recipe.size()) };
+
+		file.write(reinterpret_cast<const char*>(&type), sizeof(type));
+		file.write(reinterpret_cast<const char*>(&record.key), sizeof(record.key));
+		file.write(reinterpret_cast<const char*>(&recipeSize), sizeof(recipeSize));
+		file.write(record.recipe.data(), recipeSize);
+	}
+
+	return static_cast<bool>(file);
+}
+void PipelineStateCache::LogStatistics() const
+{
+	auto logTable = [](const wchar_t* pName, const auto& table)
+	{
+		const auto statistics = table.GetStatistics();
+		const uint32_t lookups{ statistics.hits + statistics.misses };
+		const double hitRate{ lookups ? 100.0 * statistics.hits / lookups : 0.0 };
+
+		std::wstringstream message;
+		message << L"  " << pName << L": " << table.GetSize() << L" objects, "
+			<< statistics.hits << L"/" << lookups << L" hits (" << hitRate << L"%), "
+			<< statistics.failures << L" failures, " << statistics.duplicates << L" created twice at once, " << statistics.creationMs << L" ms creating";
+		Logger::Log(message.str());
+	};
+
+	Logger::Log(L"Pipeline state cache:");
+	logTable(L"VertexShaders", m_VertexShaders);
+	logTable(L"PixelShaders", m_PixelShaders);
+	logTable(L"InputLayouts", m_InputLayouts);
+	logTable(L"RasterizerStates", m_RasterizerStates);
+	logTable(L"DepthStencilStates", m_DepthStencilStates);
+	logTable(L"BlendStates", m_BlendStates);
+}
+
+// Hashing
+// -------
+uint64_t PipelineStateCache::HashShader(uint8_t stage, const std::vector<char>& bytecode)
+{
+	hashing::Hasher hasher{};
+	hasher.Add(stage);
+	hasher.AddBytes(bytecode.data(), bytecode.size());
+	return hasher.Get();
+}
+uint64_t PipelineStateCache::HashInputLayout(const D3D11_INPUT_ELEMENT_DESC* pElements, UINT elementCount, const std::vector<char>& bytecode)
+{
+	hashing::Hasher hasher{};
+	hasher.Add(static_cast<uint8_t>(EntryType::InputLayout));
+	hasher.Add(elementCount);
+
+	for (UINT index{}; index < elementCount; ++index)
+	{
+		const D3D11_INPUT_ELEMENT_DESC& element = pElements[index];
+		hasher.AddString(element.SemanticName);
+		hasher.Add(element.SemanticIndex);
+		hasher.Add(element.Format);
+		hasher.Add(element.InputSlot);
+		hasher.Add(element.AlignedByteOffset);
+		hasher.Add(element.InputSlotClass);
+		hasher.Add(element.InstanceDataStepRate);
+	}
+
+	// Input signature lives in the bytecode
+	hasher.AddBytes(bytecode.data(), bytecode.size());
+	return hasher.Get();
+}
+uint64_t PipelineStateCache::HashRasterizerState(const D3D11_RASTERIZER_DESC& description)
+{
+	// Only 4-byte members, so no padding to worry about
+	hashing::Hasher hasher{};
+	hasher.Add(static_cast<uint8_t>(EntryType::RasterizerState));
+	hasher.Add(description);
+	return hasher.Get();
+}
+uint64_t PipelineStateCache::HashDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& description)
+{
+	auto addFace = [](hashing::Hasher& hasher, const D3D11_DEPTH_STENCILOP_DESC& face)
+	{
+		hasher.Add(face.StencilFailOp);
+		hasher.Add(face.StencilDepthFailOp);
+		hasher.Add(face.StencilPassOp);
+		hasher.Add(face.StencilFunc);
+	};
+
+	// Field by field, the stencil masks leave padding behind them
+	hashing::Hasher hasher{};
+	hasher.Add(static_cast<uint8_t>(EntryType::DepthStencilState));
+	hasher.Add(description.DepthEnable);
+	hasher.Add(description.DepthWriteMask);
+	hasher.Add(description.DepthFunc);
+	hasher.Add(description.StencilEnable);
+	hasher.Add(description.StencilReadMask);
+	hasher.Add(description.StencilWriteMask);
+	addFace(hasher, description.FrontFace);
+	addFace(hasher, description.BackFace);
+	return hasher.Get();
+}
+uint64_t PipelineStateCache::HashBlendState(const D3D11_BLEND_DESC& description)
+{
+	hashing::Hasher hasher{};
+	hasher.Add(static_cast<uint8_t>(EntryType::BlendState));
+	hasher.Add(description.AlphaToCoverageEnable);
+	hasher.Add(description.IndependentBlendEnable);
+
+	// Without independent blending only the first target is used
+	const size_t targetCount{ description.IndependentBlendEnable ? ARRAYSIZE(description.RenderTarget) : 1 };
+	for (size_t index{}; index < targetCount; ++index)
+	{
+		const D3D11_RENDER_TARGET_BLEND_DESC& target = description.RenderTarget[index];
+		hasher.Add(target.BlendEnable);
+		hasher.Add(target.SrcBlend);
+		hasher.Add(target.DestBlend);
+		hasher.Add(target.BlendOp);
+		hasher.Add(target.SrcBlendAlpha);
+		hasher.Add(target.DestBlendAlpha);
+		hasher.Add(target.BlendOpAlpha);
+		hasher.Add(target.RenderTargetWriteMask);
+	}
+	return hasher.Get();
+}
+
+// Privates
+// --------
+void PipelineStateCache::AddRecord(EntryType type, uint64_t key, std::vector<char>&& recipe)
+{
+	std::lock_guard<std::mutex> lock{ m_RecordMutex };
+	m_Records.push_back(KeyRecord{ type, key, std::move(recipe) });
+}
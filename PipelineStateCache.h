@@ -0,0 +1,141 @@
+#pragma once
+
+#include <Windows.h>
+#include <d3d11.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "StateCacheTable.h"
+#include "Utils.h"
+
+// Creates the objects the cache holds, from the D3D11 device in the engine and from a mock device in the benchmarks
+// Every call returns a new reference the caller releases, or nullptr when creation failed
+class PipelineObjectFactory
+{
+public:
+	// Rule of five
+	PipelineObjectFactory() = default;
+	virtual ~PipelineObjectFactory() = default;
+
+	PipelineObjectFactory(const PipelineObjectFactory& other) = delete;
+	PipelineObjectFactory(PipelineObjectFactory&& other) = delete;
+	PipelineObjectFactory& operator= (const PipelineObjectFactory& other) = delete;
+	PipelineObjectFactory& operator= (PipelineObjectFactory&& other) = delete;
+
+	// Publics
+	virtual ID3D11VertexShader* CreateVertexShader(const std::vector<char>& bytecode) = 0;
+	virtual ID3D11PixelShader* CreatePixelShader(const std::vector<char>& bytecode) = 0;
+	virtual ID3D11InputLayout* CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* pElements, UINT elementCount, const std::vector<char>& bytecode) = 0;
+
+	virtual ID3D11RasterizerState* CreateRasterizerState(const D3D11_RASTERIZER_DESC& description) = 0;
+	virtual ID3D11DepthStencilState* CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& description) = 0;
+	virtual ID3D11BlendState* CreateBlendState(const D3D11_BLEND_DESC& description) = 0;
+};
+
+class D3D11PipelineObjectFactory final : public PipelineObjectFactory
+{
+public:
+	// Rule of five
+	D3D11PipelineObjectFactory(ID3D11Device* pDevice);
+	~D3D11PipelineObjectFactory() override = default;
+
+	D3D11PipelineObjectFactory(const D3D11PipelineObjectFactory& other) = delete;
+	D3D11PipelineObjectFactory(D3D11PipelineObjectFactory&& other) = delete;
+	D3D11PipelineObjectFactory& operator= (const D3D11PipelineObjectFactory& other) = delete;
+	D3D11PipelineObjectFactory& operator= (D3D11PipelineObjectFactory&& other) = delete;
+
+	// Publics
+	ID3D11VertexShader* CreateVertexShader(const std::vector<char>& bytecode) override;
+	ID3D11PixelShader* CreatePixelShader(const std::vector<char>& bytecode) override;
+	ID3D11InputLayout* CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* pElements, UINT elementCount, const std::vector<char>& bytecode) override;
+
+	ID3D11RasterizerState* CreateRasterizerState(const D3D11_RASTERIZER_DESC& description) override;
+	ID3D11DepthStencilState* CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& description) override;
+	ID3D11BlendState* CreateBlendState(const D3D11_BLEND_DESC& description) override;
+
+private:
+	// Member variables
+	ID3D11Device* m_pDevice;
+};
+
+class PipelineStateCache final
+{
+public:
+	// Rule of five
+	PipelineStateCache(std::unique_ptr<PipelineObjectFactory> pFactory);
+	~PipelineStateCache() = default;
+
+	PipelineStateCache(const PipelineStateCache& other) = delete;
+	PipelineStateCache(PipelineStateCache&& other) = delete;
+	PipelineStateCache& operator= (const PipelineStateCache& other) = delete;
+	PipelineStateCache& operator= (PipelineStateCache&& other) = delete;
+
+	// Publics
+	// Shaders named after a .cso resource are reloaded from it when warming, any other name (a runtime compiled variant) keeps its bytecode in the key file
+	ID3D11VertexShader* GetVertexShader(const std::wstring& resourceName, const std::vector<char>& bytecode);
+	ID3D11PixelShader* GetPixelShader(const std::wstring& resourceName, const std::vector<char>& bytecode);
+	ID3D11InputLayout* GetInputLayout(const D3D11_INPUT_ELEMENT_DESC* pElements, UINT elementCount, const std::wstring& resourceName, const std::vector<char>& bytecode);
+
+	ID3D11RasterizerState* GetRasterizerState(const D3D11_RASTERIZER_DESC& description);
+	ID3D11DepthStencilState* GetDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& description);
+	ID3D11BlendState* GetBlendState(const D3D11_BLEND_DESC& description);
+
+	void WarmFromFile(const std::wstring& filePath, const utils::ResourceReader& readResource);	// Recreates every object listed in a previously saved key file
+	bool SaveKeysToFile(const std::wstring& filePath) const;
+	void LogStatistics() const;
+
+	uint32_t GetWarmedCount() const { return m_WarmedCount; }	// By the last WarmFromFile
+
+	// Stable keys, exposed so they can be checked without a device
+	static uint64_t HashShader(uint8_t stage, const std::vector<char>& bytecode);
+	static uint64_t HashInputLayout(const D3D11_INPUT_ELEMENT_DESC* pElements, UINT elementCount, const std::vector<char>& bytecode);
+	static uint64_t HashRasterizerState(const D3D11_RASTERIZER_DESC& description);
+	static uint64_t HashDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& description);
+	static uint64_t HashBlendState(const D3D11_BLEND_DESC& description);
+
+private:
+	// Structs
+	enum class EntryType : uint8_t
+	{
+		VertexShader,
+		PixelShader,
+		InputLayout,
+		RasterizerState,
+		DepthStencilState,
+		BlendState
+	};
+
+	struct ComRelease
+	{
+		void operator()(IUnknown* pObject) const { pObject->Release(); }
+	};
+
+	struct KeyRecord
+	{
+		EntryType type;
+		uint64_t key;
+		std::vector<char> recipe;	// Everything needed to recreate the object on the next startup
+	};
+
+	// Member variables
+	std::unique_ptr<PipelineObjectFactory> m_pFactory;
+
+	StateCacheTable<ID3D11VertexShader, ComRelease> m_VertexShaders;
+	StateCacheTable<ID3D11PixelShader, ComRelease> m_PixelShaders;
+	StateCacheTable<ID3D11InputLayout, ComRelease> m_InputLayouts;
+	StateCacheTable<ID3D11RasterizerState, ComRelease> m_RasterizerStates;
+	StateCacheTable<ID3D11DepthStencilState, ComRelease> m_DepthStencilStates;
+	StateCacheTable<ID3D11BlendState, ComRelease> m_BlendStates;
+
+	mutable std::mutex m_RecordMutex;
+	std::vector<KeyRecord> m_Records;
+	uint32_t m_WarmedCount;
+	double m_WarmMs;
+
+	// Member functions
+	void AddRecord(EntryType type, uint64_t key, std::vector<char>&& recipe);
+};
@@ -0,0 +1,450 @@
+#include "PipelineStateCacheBenchmark.h"
+#include "Logger.h"
+#include "PipelineStateCache.h"
+#include "StateCacheTable.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	constexpr uint32_t g_KeyCount{ 4096 };
+	constexpr uint32_t g_LookupCount{ 1u << 20 };
+	constexpr uint32_t g_RoundCount{ 8 };
+
+	constexpr uint32_t g_ThreadCount{ 8 };			// Like the loading tasks
+	constexpr uint32_t g_RacedKeyCount{ 64 };
+	constexpr uint32_t g_CreationUs{ 200 };			// Slow like a shader creation, long enough for the other threads to miss on the same key
+
+	constexpr uint32_t g_RequestedObjects{ 7 };		// By RequestObjects
+	constexpr uint32_t g_RequestedStates{ 3 };
+
+	volatile uint64_t g_Sink{};
+
+	// Every mock object alive, tables and caches must release them all
+	std::atomic<int32_t> g_LiveObjects{};
+
+	// Pipeline object stand-in for the table on its own
+	struct MockObject
+	{
+		explicit MockObject(uint64_t key)
+			: key{ key }
+		{
+			++g_LiveObjects;
+		}
+		~MockObject() { --g_LiveObjects; }
+
+		uint64_t key;
+	};
+
+	// Just enough of a D3D11 device child for the cache, which only hands it out and releases it
+	template <typename Interface>
+	class MockDeviceChild : public Interface
+	{
+	public:
+		MockDeviceChild()
+			: m_References{ 1 }
+		{
+			++g_LiveObjects;
+		}
+		virtual ~MockDeviceChild() { --g_LiveObjects; }
+
+		HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** ppObject) override
+		{
+			*ppObject = nullptr;
+			return E_NOINTERFACE;
+		}
+		ULONG STDMETHODCALLTYPE AddRef() override { return m_References.fetch_add(1, std::memory_order_relaxed) + 1; }
+		ULONG STDMETHODCALLTYPE Release() override
+		{
+			const ULONG references{ m_References.fetch_sub(1, std::memory_order_acq_rel) - 1 };
+			if (references == 0) delete this;
+			return references;
+		}
+
+		void STDMETHODCALLTYPE GetDevice(ID3D11Device** ppDevice) override { *ppDevice = nullptr; }
+		HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID, UINT*, void*) override { return E_NOTIMPL; }
+		HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID, UINT, const void*) override { return E_NOTIMPL; }
+		HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID, const IUnknown*) override { return E_NOTIMPL; }
+
+	private:
+		std::atomic<ULONG> m_References;
+	};
+
+	// Keeps its description, so a warmed state can be compared with the one it was saved from
+	template <typename Interface, typename Description>
+	class MockState final : public MockDeviceChild<Interface>
+	{
+	public:
+		explicit MockState(const Description& description)
+			: m_Description{ description }
+		{
+		}
+
+		void STDMETHODCALLTYPE GetDesc(Description* pDescription) override { *pDescription = m_Description; }
+
+	private:
+		Description m_Description;
+	};
+
+	// Counts what it creates, and rejects bytecode that doesn't start like compiled shader bytecode, like the device would
+	class MockPipelineObjectFactory final : public PipelineObjectFactory
+	{
+	public:
+		ID3D11VertexShader* CreateVertexShader(const std::vector<char>& bytecode) override
+		{
+			return IsBytecode(bytecode) ? Count(new MockDeviceChild<ID3D11VertexShader>{}) : nullptr;
+		}
+		ID3D11PixelShader* CreatePixelShader(const std::vector<char>& bytecode) override
+		{
+			return IsBytecode(bytecode) ? Count(new MockDeviceChild<ID3D11PixelShader>{}) : nullptr;
+		}
+		ID3D11InputLayout* CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC*, UINT elementCount, const std::vector<char>& bytecode) override
+		{
+			return IsBytecode(bytecode) && elementCount > 0 ? Count(new MockDeviceChild<ID3D11InputLayout>{}) : nullptr;
+		}
+
+		ID3D11RasterizerState* CreateRasterizerState(const D3D11_RASTERIZER_DESC& description) override
+		{
+			return Count(new MockState<ID3D11RasterizerState, D3D11_RASTERIZER_DESC>{ description });
+		}
+		ID3D11DepthStencilState* CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& description) override
+		{
+			return Count(new MockState<ID3D11DepthStencilState, D3D11_DEPTH_STENCIL_DESC>{ description });
+		}
+		ID3D11BlendState* CreateBlendState(const D3D11_BLEND_DESC& description) override
+		{
+			return Count(new MockState<ID3D11BlendState, D3D11_BLEND_DESC>{ description });
+		}
+
+		uint32_t GetCreationCount() const { return m_CreationCount; }
+
+	private:
+		std::atomic<uint32_t> m_CreationCount{};
+
+		static bool IsBytecode(const std::vector<char>& bytecode) { return bytecode.size() > 4 && std::memcmp(bytecode.data(), "DXBC", 4) == 0; }
+
+		template <typename T>
+		T* Count(T* pObject)
+		{
+			++m_CreationCount;
+			return pObject;
+		}
+	};
+
+	std::vector<char> CreateBytecode(const char* pName)
+	{
+		const std::string bytecode{ std::string{ "DXBC" } + pName };
+		return std::vector<char>{ bytecode.begin(), bytecode.end() };
+	}
+
+	// What a frame asks from the cache, the variant is compiled at runtime so its bytecode is carried by the key file
+	struct Requests
+	{
+		Requests()
+			: vertexBytecode{ CreateBytecode("vertex") }
+			, pixelBytecode{ CreateBytecode("pixel") }
+			, variantBytecode{ CreateBytecode("variant") }
+			, elements
+			{
+				{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+				{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+			}
+			, rasterizer{}
+			, depthStencil{}
+			, blend{}
+		{
+			rasterizer.FillMode = D3D11_FILL_SOLID;
+			rasterizer.CullMode = D3D11_CULL_NONE;
+			rasterizer.DepthBias = 64;
+			rasterizer.SlopeScaledDepthBias = 1.5f;
+			rasterizer.DepthClipEnable = TRUE;
+
+			depthStencil.DepthEnable = TRUE;
+			depthStencil.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+			depthStencil.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
+
+			D3D11_RENDER_TARGET_BLEND_DESC& target = blend.RenderTarget[0];
+			target.BlendEnable = TRUE;
+			target.SrcBlend = D3D11_BLEND_SRC_ALPHA;
+			target.DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+			target.BlendOp = D3D11_BLEND_OP_ADD;
+			target.SrcBlendAlpha = D3D11_BLEND_ONE;
+			target.DestBlendAlpha = D3D11_BLEND_ZERO;
+			target.BlendOpAlpha = D3D11_BLEND_OP_ADD;
+			target.RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+		}
+
+		// Returns how many objects the cache handed out
+		uint32_t RequestObjects(PipelineStateCache& cache) const
+		{
+			uint32_t foundCount{};
+			if (cache.GetVertexShader(L"MockVertexShader.cso", vertexBytecode)) ++foundCount;
+			if (cache.GetPixelShader(L"MockPixelShader.cso", pixelBytecode)) ++foundCount;
+			if (cache.GetPixelShader(L"MockPixelShader_VARIANT", variantBytecode)) ++foundCount;
+			if (cache.GetInputLayout(elements, ARRAYSIZE(elements), L"MockVertexShader.cso", vertexBytecode)) ++foundCount;
+			if (cache.GetRasterizerState(rasterizer)) ++foundCount;
+			if (cache.GetDepthStencilState(depthStencil)) ++foundCount;
+			if (cache.GetBlendState(blend)) ++foundCount;
+			return foundCount;
+		}
+
+		bool ReadResource(const std::wstring& resource, std::vector<char>& readBytes) const
+		{
+			if (resource == L"MockVertexShader.cso") readBytes = vertexBytecode;
+			else if (resource == L"MockPixelShader.cso") readBytes = pixelBytecode;
+			else return false;
+			return true;
+		}
+
+		std::vector<char> vertexBytecode;
+		std::vector<char> pixelBytecode;
+		std::vector<char> variantBytecode;
+		D3D11_INPUT_ELEMENT_DESC elements[2];
+		D3D11_RASTERIZER_DESC rasterizer;
+		D3D11_DEPTH_STENCIL_DESC depthStencil;
+		D3D11_BLEND_DESC blend;
+	};
+}
+
+PipelineStateCacheBenchmark::PipelineStateCacheBenchmark()
+	: m_Result{}
+{
+}
+
+bool PipelineStateCacheBenchmark::Run()
+{
+	m_Result = Result{};
+	m_Result.keyCount = g_KeyCount;
+	m_Result.threadCount = g_ThreadCount;
+	m_Result.racedKeys = g_RacedKeyCount;
+
+	TimeLookups();
+	CheckCounting();
+	CheckRacing();
+	CheckRoundTrip();
+	m_Result.leakedObjects = static_cast<uint32_t>(g_LiveObjects.load());
+
+	return LogResults();
+}
+
+// Privates
+// --------
+void PipelineStateCacheBenchmark::TimeLookups()
+{
+	using namespace std::chrono;
+
+	std::mt19937 randomEngine{ 1337 };	// Fixed seed, same order every run
+	std::uniform_int_distribution<uint64_t> key{ 0, g_KeyCount - 1 };
+	std::vector<uint64_t> lookupOrder(g_LookupCount);
+	for (uint64_t& lookupKey : lookupOrder) lookupKey = key(randomEngine);
+
+	// Every round starts cold, the same keys are looked up out of order once all were created
+	double missSeconds{};
+	double hitSeconds{};
+	uint64_t checksum{};
+	for (uint32_t round{}; round < g_RoundCount; ++round)
+	{
+		StateCacheTable<MockObject> table{};
+
+		const steady_clock::time_point missStart{ steady_clock::now() };
+		for (uint64_t missKey{}; missKey < g_KeyCount; ++missKey)
+		{
+			checksum += table.GetOrCreate(missKey, [missKey] { return new MockObject{ missKey }; })->key;
+		}
+
+		const steady_clock::time_point hitStart{ steady_clock::now() };
+		for (const uint64_t hitKey : lookupOrder)
+		{
+			const MockObject* pObject{ table.GetOrCreate(hitKey, [] { return nullptr; }) };
+			if (pObject) checksum += pObject->key;
+		}
+		const steady_clock::time_point hitEnd{ steady_clock::now() };
+
+		missSeconds += duration<double>(hitStart - missStart).count();
+		hitSeconds += duration<double>(hitEnd - hitStart).count();
+	}
+	g_Sink = checksum;
+
+	m_Result.missNs = missSeconds * 1e9 / (static_cast<double>(g_KeyCount) * g_RoundCount);
+	m_Result.hitNs = hitSeconds * 1e9 / (static_cast<double>(g_LookupCount) * g_RoundCount);
+}
+void PipelineStateCacheBenchmark::CheckCounting()
+{
+	StateCacheTable<MockObject> table{};
+	auto create = [](uint64_t key) { return [key] { return new MockObject{ key }; }; };
+	auto fail = []() -> MockObject* { return nullptr; };
+	auto check = [this](bool isMatching)
+	{
+		++m_Result.checkedLookups;
+		if (isMatching) ++m_Result.matchingLookups;
+	};
+
+	bool created{};
+	MockObject* pFirst{ table.GetOrCreate(1, create(1), &created) };
+	check(pFirst && pFirst->key == 1 && created);
+
+	// A hit never calls the create function, this one would fail
+	check(table.GetOrCreate(1, fail, &created) == pFirst && !created);
+
+	// A failure isn't kept, the next lookup tries again
+	check(!table.GetOrCreate(2, fail, &created) && !created && !table.Contains(2));
+	MockObject* pSecond{ table.GetOrCreate(2, create(2), &created) };
+	check(pSecond && pSecond != pFirst && pSecond->key == 2 && created);
+	check(table.GetOrCreate(2, create(2), &created) == pSecond && !created);
+
+	const StateCacheTable<MockObject>::Statistics statistics{ table.GetStatistics() };
+	check(statistics.hits == 2 && statistics.misses == 3 && statistics.failures == 1 && statistics.duplicates == 0 && table.GetSize() == 2);
+
+	table.Clear();
+	check(table.GetSize() == 0 && table.GetStatistics().misses == 0 && g_LiveObjects == 0);
+}
+void PipelineStateCacheBenchmark::CheckRacing()
+{
+	StateCacheTable<MockObject> table{};
+	std::vector<std::vector<MockObject*>> threadObjects(g_ThreadCount, std::vector<MockObject*>(g_RacedKeyCount));
+	std::atomic<uint32_t> readyThreads{};
+	std::atomic<uint32_t> creatingThreads{};
+	std::atomic<uint32_t> mostCreations{};
+
+	auto race = [&](uint32_t threadIndex)
+	{
+		// Start together, so the threads miss on the same keys
+		++readyThreads;
+		while (readyThreads < g_ThreadCount) std::this_thread::yield();
+
+		for (uint64_t key{}; key < g_RacedKeyCount; ++key)
+		{
+			threadObjects[threadIndex][key] = table.GetOrCreate(key, [&, key]
+			{
+				const uint32_t creations{ ++creatingThreads };
+				uint32_t most{ mostCreations };
+				while (creations > most && !mostCreations.compare_exchange_weak(most, creations)) {}
+
+				std::this_thread::sleep_for(std::chrono::microseconds{ g_CreationUs });
+				--creatingThreads;
+				return new MockObject{ key };
+			});
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(g_ThreadCount);
+	for (uint32_t threadIndex{}; threadIndex < g_ThreadCount; ++threadIndex) threads.emplace_back(race, threadIndex);
+	for (std::thread& thread : threads) thread.join();
+
+	for (uint32_t key{}; key < g_RacedKeyCount; ++key)
+	{
+		const MockObject* pObject{ threadObjects[0][key] };
+		bool isShared{ pObject && pObject->key == key };
+		for (uint32_t threadIndex{ 1 }; threadIndex < g_ThreadCount && isShared; ++threadIndex) isShared = threadObjects[threadIndex][key] == pObject;
+		if (isShared) ++m_Result.sharedKeys;
+	}
+
+	const StateCacheTable<MockObject>::Statistics statistics{ table.GetStatistics() };
+	m_Result.racedMisses = statistics.misses;
+	m_Result.duplicates = statistics.duplicates;
+	m_Result.racedObjects = static_cast<uint32_t>(g_LiveObjects.load());
+	m_Result.mostCreations = mostCreations;
+}
+void PipelineStateCacheBenchmark::CheckRoundTrip()
+{
+	const Requests requests{};
+	const std::filesystem::path keyFilePath{ std::filesystem::temp_directory_path() / L"PipelineStateCacheBenchmark.bin" };
+
+	// Cold, everything is created and recorded, bytecode the device rejects is neither
+	{
+		auto pFactory = std::make_unique<MockPipelineObjectFactory>();
+		const MockPipelineObjectFactory& factory = *pFactory;
+		PipelineStateCache cache{ std::move(pFactory) };
+
+		m_Result.checkedLookups += 2;
+		if (requests.RequestObjects(cache) == g_RequestedObjects) ++m_Result.matchingLookups;
+		if (!cache.GetPixelShader(L"MockBroken.cso", std::vector<char>{ 'b', 'a', 'd' })) ++m_Result.matchingLookups;
+
+		if (cache.SaveKeysToFile(keyFilePath.wstring())) m_Result.savedObjects = factory.GetCreationCount();
+	}
+
+	// Warm, from the key file alone
+	{
+		auto pFactory = std::make_unique<MockPipelineObjectFactory>();
+		const MockPipelineObjectFactory& factory = *pFactory;
+		PipelineStateCache cache{ std::move(pFactory) };
+
+		cache.WarmFromFile(keyFilePath.wstring(), [&requests](const std::wstring& resource, std::vector<char>& readBytes)
+		{
+			return requests.ReadResource(resource, readBytes);
+		});
+		m_Result.warmedObjects = cache.GetWarmedCount();
+		m_Result.warmCreations = factory.GetCreationCount();
+
+		m_Result.foundAfterWarm = requests.RequestObjects(cache);
+		m_Result.createdAfterWarm = factory.GetCreationCount() - m_Result.warmCreations;
+
+		// Found by the original descriptions, created from the saved ones
+		m_Result.checkedDescriptions = g_RequestedStates;
+		if (ID3D11RasterizerState* pState = cache.GetRasterizerState(requests.rasterizer))
+		{
+			D3D11_RASTERIZER_DESC description{};
+			pState->GetDesc(&description);
+			if (PipelineStateCache::HashRasterizerState(description) == PipelineStateCache::HashRasterizerState(requests.rasterizer)) ++m_Result.matchingDescriptions;
+		}
+		if (ID3D11DepthStencilState* pState = cache.GetDepthStencilState(requests.depthStencil))
+		{
+			D3D11_DEPTH_STENCIL_DESC description{};
+			pState->GetDesc(&description);
+			if (PipelineStateCache::HashDepthStencilState(description) == PipelineStateCache::HashDepthStencilState(requests.depthStencil)) ++m_Result.matchingDescriptions;
+		}
+		if (ID3D11BlendState* pState = cache.GetBlendState(requests.blend))
+		{
+			D3D11_BLEND_DESC description{};
+			pState->GetDesc(&description);
+			if (PipelineStateCache::HashBlendState(description) == PipelineStateCache::HashBlendState(requests.blend)) ++m_Result.matchingDescriptions;
+		}
+	}
+
+	std::error_code errorCode;
+	std::filesystem::remove(keyFilePath, errorCode);
+}
+bool PipelineStateCacheBenchmark::LogResults() const
+{
+	const Result& result = m_Result;
+
+	std::wstringstream message;
+	message << L"Pipeline state cache benchmark: " << result.keyCount << L" keys, " << result.hitNs << L" ns per hit, " << result.missNs << L" ns per miss creating a mock object, "
+		<< result.matchingLookups << L" of " << result.checkedLookups << L" scripted lookups counted as expected";
+	Logger::Log(message.str());
+
+	message.str(L"");
+	message << L"Pipeline state cache benchmark: " << result.threadCount << L" threads racing on " << result.racedKeys << L" keys, " << result.sharedKeys
+		<< L" handed out as one object to every thread, " << result.racedMisses << L" misses, " << result.duplicates << L" duplicates dropped, "
+		<< result.racedObjects << L" objects kept, up to " << result.mostCreations << L" creations at once";
+	Logger::Log(message.str());
+
+	message.str(L"");
+	message << L"Pipeline state cache benchmark: " << result.savedObjects << L" objects saved, " << result.warmedObjects << L" warmed from the key file with "
+		<< result.warmCreations << L" creations, then " << result.foundAfterWarm << L" found with " << result.createdAfterWarm << L" more creations, "
+		<< result.matchingDescriptions << L" of " << result.checkedDescriptions << L" state descriptions restored, " << result.leakedObjects << L" objects leaked";
+	Logger::Log(message.str());
+
+	const bool isCounting{ result.matchingLookups == result.checkedLookups };
+	const bool isSharing{ result.sharedKeys == result.racedKeys && result.racedMisses == result.racedKeys + result.duplicates && result.racedObjects == result.racedKeys };
+	const bool isUnlocked{ result.mostCreations > 1 };
+	const bool isWarming{ result.savedObjects == g_RequestedObjects && result.warmedObjects == g_RequestedObjects && result.warmCreations == g_RequestedObjects
+		&& result.foundAfterWarm == g_RequestedObjects && result.createdAfterWarm == 0 && result.matchingDescriptions == result.checkedDescriptions };
+	const bool isReleasing{ result.leakedObjects == 0 };
+
+	if (!isCounting) Logger::Log(L"ERROR - Pipeline state cache benchmark: a lookup returned the wrong object or was counted wrong");
+	if (!isSharing) Logger::Log(L"ERROR - Pipeline state cache benchmark: threads racing on a key ended up with different objects");
+	if (!isUnlocked) Logger::Log(L"ERROR - Pipeline state cache benchmark: creations never overlapped, the lock is held while creating");
+	if (!isWarming) Logger::Log(L"ERROR - Pipeline state cache benchmark: the key file didn't warm every object");
+	if (!isReleasing) Logger::Log(L"ERROR - Pipeline state cache benchmark: objects outlived their table");
+	return isCounting && isSharing && isUnlocked && isWarming && isReleasing;
+}
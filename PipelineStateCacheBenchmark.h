@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+// Times the pipeline state cache's lookups and drives it with a mock device, so it runs without a GPU
+// Checks hits, misses and failed creations are counted, threads racing on a key all get one object, and a saved key file warms a new cache with every object
+class PipelineStateCacheBenchmark final
+{
+public:
+	// Structs
+	struct Result
+	{
+		uint32_t keyCount;
+		double hitNs;					// Per lookup
+		double missNs;					// Per lookup, creating the mock object included
+		uint32_t checkedLookups;
+		uint32_t matchingLookups;		// Returned the expected object and were counted as the expected hit, miss or failure
+		uint32_t threadCount;
+		uint32_t racedKeys;
+		uint32_t sharedKeys;			// Handed out as the same object to every thread
+		uint32_t racedMisses;
+		uint32_t duplicates;			// Created by a thread that lost the race, then dropped
+		uint32_t racedObjects;			// Alive once the race is over
+		uint32_t mostCreations;			// At once, only above 1 when creation runs outside the lock
+		uint32_t savedObjects;			// Created through the first cache, the records of its key file
+		uint32_t warmedObjects;			// Created by the second cache from that file
+		uint32_t warmCreations;
+		uint32_t foundAfterWarm;		// Asked for again once warmed
+		uint32_t createdAfterWarm;
+		uint32_t checkedDescriptions;
+		uint32_t matchingDescriptions;	// Warmed states created from the same description as the originals
+		uint32_t leakedObjects;			// Alive once every table and cache is gone
+	};
+
+	// Rule of five
+	PipelineStateCacheBenchmark();
+	~PipelineStateCacheBenchmark() = default;
+
+	PipelineStateCacheBenchmark(const PipelineStateCacheBenchmark& other) = delete;
+	PipelineStateCacheBenchmark(PipelineStateCacheBenchmark&& other) = delete;
+	PipelineStateCacheBenchmark& operator= (const PipelineStateCacheBenchmark& other) = delete;
+	PipelineStateCacheBenchmark& operator= (PipelineStateCacheBenchmark&& other) = delete;
+
+	// Publics
+	bool Run();	// False when a check failed, the failures are logged as errors
+
+	const Result& GetResult() const { return m_Result; }
+
+private:
+	// Member variables
+	Result m_Result;
+
+	// Member functions
+	void TimeLookups();
+	void CheckCounting();
+	void CheckRacing();
+	void CheckRoundTrip();
+	bool LogResults() const;
+};
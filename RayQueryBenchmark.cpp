@@ -0,0 +1,247 @@
+#include "RayQueryBenchmark.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sstream>
+
+using namespace math;
+
+namespace
+{
+	// Rings and segments of the generated spheres, about 16k, 64k and 256k triangles
+	constexpr uint32_t g_MeshSizes[][2]{ { 64, 128 }, { 128, 256 }, { 256, 512 } };
+	constexpr uint32_t g_ObjectCount{ 16384 };
+
+	constexpr uint32_t g_RayCount{ 65536 };
+	constexpr uint32_t g_CheckedRays{ 256 };	// Against brute force, which is too slow for all of them
+	constexpr float g_MatchTolerance{ 1e-4f };
+
+	volatile uint32_t g_Sink{};
+
+	// Closest hit over every triangle, the reference for the checks
+	BoundingVolumeHierarchy::Hit IntersectBruteForce(const BoundingVolumeHierarchy::Ray& ray, const std::vector<Float3>& positions, const std::vector<uint32_t>& indices)
+	{
+		BoundingVolumeHierarchy::Hit hit{ BoundingVolumeHierarchy::g_NoHit, ray.maxDistance };
+		for (uint32_t triangle{}; triangle < indices.size() / 3; ++triangle)
+		{
+			const Float3& vertex0 = positions[indices[triangle * 3]];
+			const Float3 edge1{ Float3Subtract(positions[indices[triangle * 3 + 1]], vertex0) };
+			const Float3 edge2{ Float3Subtract(positions[indices[triangle * 3 + 2]], vertex0) };
+
+			const Float3 p{ Float3Cross(ray.direction, edge2) };
+			const float determinant{ Float3Dot(edge1, p) };
+			if (std::fabs(determinant) <= 1e-12f) continue;
+
+			const float inverseDeterminant{ 1.f / determinant };
+			const Float3 offset{ Float3Subtract(ray.origin, vertex0) };
+			const float u{ Float3Dot(offset, p) * inverseDeterminant };
+			if (u < 0.f || u > 1.f) continue;
+
+			const Float3 q{ Float3Cross(offset, edge1) };
+			const float v{ Float3Dot(ray.direction, q) * inverseDeterminant };
+			if (v < 0.f || u + v > 1.f) continue;
+
+			const float distance{ Float3Dot(edge2, q) * inverseDeterminant };
+			if (distance < 0.f || distance > hit.distance) continue;
+
+			hit = BoundingVolumeHierarchy::Hit{ triangle, distance };
+		}
+		return hit;
+	}
+}
+
+RayQueryBenchmark::RayQueryBenchmark()
+	: m_Rays{}
+	, m_Hits{}
+	, m_Results{}
+{
+}
+
+bool RayQueryBenchmark::Run()
+{
+	m_Results.clear();
+
+	for (const auto& meshSize : g_MeshSizes) RunMesh(meshSize[0], meshSize[1]);
+	RunBounds(g_ObjectCount);
+
+	return LogResults();
+}
+
+// Privates
+// --------
+void RayQueryBenchmark::RunMesh(uint32_t rings, uint32_t segments)
+{
+	using namespace std::chrono;
+
+	// Bumpy sphere, ring 0 is the top pole
+	std::vector<Float3> positions;
+	positions.reserve(static_cast<size_t>(rings + 1) * (segments + 1));
+	for (uint32_t ring{}; ring <= rings; ++ring)
+	{
+		const float theta{ g_Pi * ring / rings };
+		for (uint32_t segment{}; segment <= segments; ++segment)
+		{
+			const float phi{ g_2Pi * segment / segments };
+			const float radius{ 1.f + 0.1f * std::sin(8.f * theta) * std::cos(8.f * phi) };
+			positions.push_back(Float3{ radius * std::sin(theta) * std::cos(phi), radius * std::cos(theta), radius * std::sin(theta) * std::sin(phi) });
+		}
+	}
+
+	std::vector<uint32_t> indices;
+	indices.reserve(static_cast<size_t>(rings) * segments * 6);
+	for (uint32_t ring{}; ring < rings; ++ring)
+	{
+		for (uint32_t segment{}; segment < segments; ++segment)
+		{
+			const uint32_t topLeft{ ring * (segments + 1) + segment };
+			const uint32_t bottomLeft{ topLeft + segments + 1 };
+
+			if (ring != 0) indices.insert(indices.end(), { topLeft, topLeft + 1, bottomLeft });
+			if (ring != rings - 1) indices.insert(indices.end(), { topLeft + 1, bottomLeft + 1, bottomLeft });
+		}
+	}
+
+	BoundingVolumeHierarchy hierarchy{};
+	hierarchy.Build(positions.data(), sizeof(Float3), static_cast<uint32_t>(positions.size()), indices.data(), static_cast<uint32_t>(indices.size()));
+
+	CreateRays(1.f);
+
+	Result result{};
+	result.pName = L"Mesh";
+	result.primitiveCount = hierarchy.GetStatistics().primitiveCount;
+	result.buildMs = hierarchy.GetStatistics().buildMs;
+	TimeQueries(hierarchy, result);
+
+	// Brute force on the first rays, and check the closest hits against it
+	const steady_clock::time_point startTime{ steady_clock::now() };
+	for (uint32_t rayIndex{}; rayIndex < g_CheckedRays; ++rayIndex)
+	{
+		const BoundingVolumeHierarchy::Hit reference{ IntersectBruteForce(m_Rays[rayIndex], positions, indices) };
+		const BoundingVolumeHierarchy::Hit& hit = m_Hits[rayIndex];
+
+		// Hits on a shared edge may land on either triangle, the distance is what counts
+		const bool isMatch{ reference.primitive == hit.primitive
+			|| (reference.primitive != BoundingVolumeHierarchy::g_NoHit && hit.primitive != BoundingVolumeHierarchy::g_NoHit
+				&& std::fabs(reference.distance - hit.distance) <= g_MatchTolerance) };
+		if (isMatch) ++result.matchingRays;
+	}
+	const double bruteForceSeconds{ duration<double>(steady_clock::now() - startTime).count() };
+
+	result.checkedRays = g_CheckedRays;
+	result.bruteForceRaysPerSecond = bruteForceSeconds > 0.0 ? g_CheckedRays / bruteForceSeconds : 0.0;
+	m_Results.push_back(result);
+
+	// Ripple the surface and refit instead of rebuilding, the boxes grow looser so the queries slow down a little
+	for (Float3& position : positions)
+	{
+		const float scale{ 1.f + 0.15f * std::sin(6.f * position.y + 3.f * position.x) };
+		position = Float3Scale(position, scale);
+	}
+	hierarchy.Refit(positions.data(), sizeof(Float3));
+
+	Result refitResult{};
+	refitResult.pName = L"Mesh refitted";
+	refitResult.primitiveCount = result.primitiveCount;
+	refitResult.buildMs = result.buildMs;
+	refitResult.refitMs = hierarchy.GetStatistics().refitMs;
+	TimeQueries(hierarchy, refitResult);
+	m_Results.push_back(refitResult);
+}
+void RayQueryBenchmark::RunBounds(uint32_t objectCount)
+{
+	std::mt19937 randomEngine{ 1337 };	// Fixed seed, same objects every run
+	std::uniform_real_distribution<float> position{ -50.f, 50.f };
+	std::uniform_real_distribution<float> size{ 0.25f, 1.f };
+
+	std::vector<BoundingVolumeHierarchy::Bounds> bounds(objectCount);
+	for (BoundingVolumeHierarchy::Bounds& object : bounds)
+	{
+		const Float3 center{ position(randomEngine), position(randomEngine), position(randomEngine) };
+		const Float3 extent{ size(randomEngine), size(randomEngine), size(randomEngine) };
+		object = BoundingVolumeHierarchy::Bounds{ Float3Subtract(center, extent), Float3Add(center, extent) };
+	}
+
+	BoundingVolumeHierarchy hierarchy{};
+	hierarchy.Build(bounds);
+
+	CreateRays(50.f);
+
+	Result result{};
+	result.pName = L"Object bounds";
+	result.primitiveCount = objectCount;
+	result.buildMs = hierarchy.GetStatistics().buildMs;
+	TimeQueries(hierarchy, result);
+	m_Results.push_back(result);
+}
+void RayQueryBenchmark::TimeQueries(const BoundingVolumeHierarchy& hierarchy, Result& result)
+{
+	using namespace std::chrono;
+
+	m_Hits.resize(m_Rays.size());
+
+	steady_clock::time_point startTime{ steady_clock::now() };
+	for (size_t rayIndex{}; rayIndex < m_Rays.size(); ++rayIndex) m_Hits[rayIndex] = hierarchy.Intersect(m_Rays[rayIndex]);
+	const double closestSeconds{ duration<double>(steady_clock::now() - startTime).count() };
+
+	startTime = steady_clock::now();
+	hierarchy.IntersectBatch(m_Rays, m_Hits);
+	const double batchedSeconds{ duration<double>(steady_clock::now() - startTime).count() };
+
+	uint32_t anyHits{};
+	startTime = steady_clock::now();
+	for (const BoundingVolumeHierarchy::Ray& ray : m_Rays) anyHits += hierarchy.IntersectAny(ray) ? 1 : 0;
+	const double anySeconds{ duration<double>(steady_clock::now() - startTime).count() };
+	g_Sink = anyHits;
+
+	const double rayCount{ static_cast<double>(m_Rays.size()) };
+	result.closestRaysPerSecond = closestSeconds > 0.0 ? rayCount / closestSeconds : 0.0;
+	result.batchedRaysPerSecond = batchedSeconds > 0.0 ? rayCount / batchedSeconds : 0.0;
+	result.anyRaysPerSecond = anySeconds > 0.0 ? rayCount / anySeconds : 0.0;
+}
+void RayQueryBenchmark::CreateRays(float radius)
+{
+	std::mt19937 randomEngine{ 7 };
+	std::uniform_real_distribution<float> unit{ -1.f, 1.f };
+
+	// From a sphere around the primitives towards their middle, so most rays hit something and some miss
+	m_Rays.resize(g_RayCount);
+	for (BoundingVolumeHierarchy::Ray& ray : m_Rays)
+	{
+		const Vector direction{ Vector3Normalize(VectorSet(unit(randomEngine), unit(randomEngine), unit(randomEngine) + 1e-3f, 0.f)) };
+		const Vector origin{ VectorScale(direction, 3.f * radius) };
+		const Vector target{ VectorScale(VectorSet(unit(randomEngine), unit(randomEngine), unit(randomEngine), 0.f), 0.6f * radius) };
+
+		StoreFloat3(&ray.origin, origin);
+		StoreFloat3(&ray.direction, VectorSubtract(target, origin));
+		ray.maxDistance = 2.f;
+	}
+}
+bool RayQueryBenchmark::LogResults() const
+{
+	bool isMatching{ true };
+	for (const Result& result : m_Results)
+	{
+		std::wstringstream message;
+		message << L"Ray benchmark: " << result.pName << L", " << result.primitiveCount << L" primitives, built in " << result.buildMs << L" ms";
+		if (result.refitMs > 0.0) message << L", refitted in " << result.refitMs << L" ms";
+		message << L", " << result.closestRaysPerSecond / 1e6 << L" Mrays/s closest hit, " << result.batchedRaysPerSecond / 1e6
+			<< L" Mrays/s batched, " << result.anyRaysPerSecond / 1e6 << L" Mrays/s any hit";
+		if (result.checkedRays > 0)
+		{
+			message << L", brute force " << result.bruteForceRaysPerSecond / 1e6 << L" Mrays/s ("
+				<< result.closestRaysPerSecond / (std::max)(result.bruteForceRaysPerSecond, 1.0) << L"x slower than the hierarchy), "
+				<< result.matchingRays << L" of " << result.checkedRays << L" hits match it";
+		}
+		Logger::Log(message.str());
+
+		if (result.matchingRays < result.checkedRays)
+		{
+			Logger::Log(L"ERROR - Ray benchmark: closest hits differ from brute force");
+			isMatching = false;
+		}
+	}
+	return isMatching;
+}
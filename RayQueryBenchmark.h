@@ -0,0 +1,53 @@
+#pragma once
+
+#include "BoundingVolumeHierarchy.h"
+
+#include <vector>
+
+// Times building, refitting and ray querying bounding volume hierarchies over generated meshes and object bounds
+// A sample of the closest hits is checked against brute force over every triangle, a mismatch is logged as an error
+class RayQueryBenchmark final
+{
+public:
+	// Structs
+	struct Result
+	{
+		const wchar_t* pName;
+		uint32_t primitiveCount;
+		double buildMs;
+		double refitMs;					// 0 when not refitted
+		double closestRaysPerSecond;	// On one worker
+		double batchedRaysPerSecond;	// Split over the workers
+		double anyRaysPerSecond;
+		double bruteForceRaysPerSecond;	// 0 when not measured
+		uint32_t checkedRays;
+		uint32_t matchingRays;
+	};
+
+	// Rule of five
+	RayQueryBenchmark();
+	~RayQueryBenchmark() = default;
+
+	RayQueryBenchmark(const RayQueryBenchmark& other) = delete;
+	RayQueryBenchmark(RayQueryBenchmark&& other) = delete;
+	RayQueryBenchmark& operator= (const RayQueryBenchmark& other) = delete;
+	RayQueryBenchmark& operator= (RayQueryBenchmark&& other) = delete;
+
+	// Publics
+	bool Run();	// False when a closest hit differs from brute force
+
+	const std::vector<Result>& GetResults() const { return m_Results; }
+
+private:
+	// Member variables
+	std::vector<BoundingVolumeHierarchy::Ray> m_Rays;
+	std::vector<BoundingVolumeHierarchy::Hit> m_Hits;
+	std::vector<Result> m_Results;
+
+	// Member functions
+	void RunMesh(uint32_t rings, uint32_t segments);
+	void RunBounds(uint32_t objectCount);
+	void TimeQueries(const BoundingVolumeHierarchy& hierarchy, Result& result);
+	void CreateRays(float radius);
+	bool LogResults() const;
+};
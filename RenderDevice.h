@@ -0,0 +1,277 @@
+#pragma once
+
+#include "FrameCaptureEncoder.h"
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Everything the renderer asks from the GPU goes through here, so the frame can be submitted
+// to D3D11, to a software backend that rasterizes on the CPU or to a null backend that only validates and counts (no window or GPU needed)
+// Objects are referred to by handles, 0 is never handed out
+// Binds and draws can also be recorded on worker threads, one CommandRecorder per worker
+
+// Handle ids are 32 bits: the slot in the device's table, and above it the generation of that slot
+// Destroyed slots are handed out again with the next generation, so an id kept past its Destroy call is caught instead of reaching the new object
+namespace handles
+{
+	constexpr uint32_t g_IndexBits{ 16 };
+	constexpr uint32_t g_MaxSlots{ 1u << g_IndexBits };						// Per kind of object
+	constexpr uint32_t g_MaxGeneration{ (1u << (32 - g_IndexBits)) - 1 };	// Wraps back to 1
+
+	constexpr uint32_t MakeId(uint32_t index, uint32_t generation) { return (generation << g_IndexBits) | index; }
+	constexpr uint32_t GetIndex(uint32_t id) { return id & (g_MaxSlots - 1); }
+	constexpr uint32_t GetGeneration(uint32_t id) { return id >> g_IndexBits; }
+}
+
+template <typename Tag>
+struct DeviceHandle
+{
+	uint32_t id;
+
+	bool IsValid() const { return id != 0; }
+	uint32_t GetIndex() const { return handles::GetIndex(id); }	// Slot in the device's table, for backends keeping data next to it
+	bool operator== (const DeviceHandle& other) const { return id == other.id; }
+	bool operator!= (const DeviceHandle& other) const { return id != other.id; }
+};
+
+using BufferHandle = DeviceHandle<struct BufferTag>;
+using ShaderViewHandle = DeviceHandle<struct ShaderViewTag>;
+using VertexShaderHandle = DeviceHandle<struct VertexShaderTag>;
+using PixelShaderHandle = DeviceHandle<struct PixelShaderTag>;
+using InputLayoutHandle = DeviceHandle<struct InputLayoutTag>;
+using PipelineStateHandle = DeviceHandle<struct PipelineStateTag>;
+using DepthTargetHandle = DeviceHandle<struct DepthTargetTag>;
+
+static_assert(sizeof(BufferHandle) == sizeof(uint32_t) && std::is_trivially_copyable_v<BufferHandle>, "Handles are recorded into command lists as plain words");
+
+enum class RenderDeviceType
+{
+	D3D11,
+	Software,
+	Null
+};
+
+enum class ShaderStage : uint8_t
+{
+	Vertex,
+	Pixel
+};
+
+enum class ElementFormat : uint8_t
+{
+	Unknown,			// Structured
+	R16_UInt,
+	R32_UInt,
+	R32G32_UInt,
+	R8G8B8A8_UInt,
+	R32G32_Float,
+	R32G32B32_Float,
+	R32G32B32A32_Float
+};
+
+enum class BufferType : uint8_t
+{
+	Vertex,
+	Index,
+	Constant,
+	ShaderResource
+};
+
+enum class BufferUsage : uint8_t
+{
+	Immutable,			// Only initial data
+	Default,			// Rarely updated, copied by the driver
+	Dynamic				// Rewritten every frame, the old contents are discarded
+};
+
+struct BufferDescription
+{
+	BufferType type;
+	BufferUsage usage;
+	uint32_t byteSize;
+	uint32_t structureStride;	// Structured shader resources only
+};
+
+struct InputElement			// Elements of one slot are packed in order
+{
+	const char* pSemanticName;
+	uint32_t semanticIndex;
+	ElementFormat format;
+	uint32_t inputSlot;
+	bool perInstance;
+};
+
+enum class CullMode : uint8_t
+{
+	None,
+	Back
+};
+
+enum class BlendMode : uint8_t
+{
+	Opaque,
+	AlphaBlend
+};
+
+struct PipelineStateDescription		// Rasterizer, depth and blend state in one
+{
+	CullMode cullMode;
+	bool depthTest;
+	bool depthWrite;
+	BlendMode blendMode;
+	int32_t depthBias;				// In steps of the depth format, for the shadow casters
+	float slopeScaledDepthBias;
+};
+
+struct DepthTargetDescription		// Depth only array, one slice per shadow cascade
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t sliceCount;
+};
+
+struct Viewport
+{
+	float x;
+	float y;
+	float width;
+	float height;
+};
+
+struct ShaderDefine
+{
+	const char* pName;
+	const char* pValue;
+};
+
+struct ShaderCompileDescription		// HLSL source to bytecode
+{
+	const char* pSource;
+	size_t sourceSize;
+	const char* pSourceName;		// For the error messages
+	const char* pEntryPoint;
+	const char* pProfile;			// From GetShaderProfile
+	const ShaderDefine* pDefines;
+	uint32_t defineCount;
+};
+
+// Binds and draws, either submitted right away by the device or recorded for later
+// A recorded list starts without any state bound, like a D3D11 deferred context
+class CommandRecorder
+{
+public:
+	// Rule of five
+	CommandRecorder() = default;
+	virtual ~CommandRecorder() = default;
+
+	CommandRecorder(const CommandRecorder& other) = delete;
+	CommandRecorder(CommandRecorder&& other) = delete;
+	CommandRecorder& operator= (const CommandRecorder& other) = delete;
+	CommandRecorder& operator= (CommandRecorder&& other) = delete;
+
+	// Publics
+	virtual void SetViewport(const Viewport& viewport) = 0;
+	virtual void SetPipelineState(PipelineStateHandle pipelineState) = 0;
+	virtual void SetInputLayout(InputLayoutHandle inputLayout) = 0;
+	virtual void SetVertexShader(VertexShaderHandle vertexShader) = 0;
+	virtual void SetPixelShader(PixelShaderHandle pixelShader) = 0;
+	virtual void SetVertexBuffers(uint32_t startSlot, uint32_t bufferCount, const BufferHandle* pBuffers, const uint32_t* pStrides) = 0;
+	virtual void SetIndexBuffer(BufferHandle buffer, ElementFormat format) = 0;
+	virtual void SetConstantBuffer(ShaderStage stage, uint32_t slot, BufferHandle buffer, uint32_t firstConstant = 0, uint32_t constantCount = 0) = 0;	// 16-byte constants, 0 count binds the whole buffer
+	virtual void SetShaderViews(ShaderStage stage, uint32_t startSlot, uint32_t viewCount, const ShaderViewHandle* pViews) = 0;
+
+	virtual void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) = 0;
+	virtual void DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount) = 0;
+};
+
+class RenderDevice : public CommandRecorder
+{
+public:
+	// Structs
+	struct Features
+	{
+		bool constantBufferOffsets;		// SetConstantBuffer with a window into a bigger buffer
+		bool structuredBuffers;			// Structured shader resources in the pixelShader
+	};
+
+	struct Statistics					// Per frame, except for the creations
+	{
+		uint32_t drawCount;
+		uint64_t triangleCount;
+		uint32_t bindCount;				// Every Set call
+		uint32_t uploadCount;
+		uint64_t uploadBytes;
+		uint32_t resourceCreations;		// Since the device was created
+		uint32_t validationErrors;		// Null and software backends only
+		float gpuMs;					// Time the backend spent drawing the frame, 0 when it isn't known yet
+	};
+
+	// Rule of five
+	RenderDevice() = default;
+	~RenderDevice() override = default;
+
+	RenderDevice(const RenderDevice& other) = delete;
+	RenderDevice(RenderDevice&& other) = delete;
+	RenderDevice& operator= (const RenderDevice& other) = delete;
+	RenderDevice& operator= (RenderDevice&& other) = delete;
+
+	// Publics
+	virtual RenderDeviceType GetType() const = 0;
+	virtual const Features& GetFeatures() const = 0;
+	virtual uint32_t GetBackBufferWidth() const = 0;
+	virtual uint32_t GetBackBufferHeight() const = 0;
+
+	// Creation, safe to call from loading tasks while a frame is being submitted
+	virtual BufferHandle CreateBuffer(const BufferDescription& description, const void* pInitialData) = 0;
+	virtual ShaderViewHandle CreateShaderView(BufferHandle buffer, ElementFormat format, uint32_t elementCount) = 0;
+	virtual VertexShaderHandle CreateVertexShader(const std::wstring& name, const std::vector<char>& bytecode) = 0;
+	virtual PixelShaderHandle CreatePixelShader(const std::wstring& name, const std::vector<char>& bytecode) = 0;
+	virtual InputLayoutHandle CreateInputLayout(const InputElement* pElements, uint32_t elementCount, const std::wstring& shaderName, const std::vector<char>& bytecode) = 0;
+	virtual PipelineStateHandle CreatePipelineState(const PipelineStateDescription& description) = 0;
+
+	virtual DepthTargetHandle CreateDepthTarget(const DepthTargetDescription& description) = 0;
+	virtual ShaderViewHandle CreateDepthShaderView(DepthTargetHandle depthTarget) = 0;	// Every slice, sampled with the comparison sampler bound at s0 of the pixelShader
+
+	virtual void DestroyBuffer(BufferHandle buffer) = 0;
+	virtual void DestroyShaderView(ShaderViewHandle view) = 0;
+	virtual void DestroyDepthTarget(DepthTargetHandle depthTarget) = 0;
+
+	// Runtime compilation for the shader permutations, thread-safe so variants can compile on the workers
+	virtual const char* GetShaderProfile(ShaderStage stage) const = 0;	// Part of the compiled variant keys, bytecode of another profile can't be reused
+	virtual bool CompileShader(const ShaderCompileDescription& description, std::vector<char>& bytecode, std::string& errors) = 0;
+
+	// Frame, everything below is called from the render thread only
+	virtual void BeginFrame(const float clearColor[4]) = 0;	// Clears and binds the backBuffer, triangle lists only
+	virtual void Present() = 0;
+	virtual bool ResizeBackBuffer(uint32_t width, uint32_t height) = 0;	// Between frames, recreates the backBuffer targets at the new size
+
+	// Dynamic resolution, between frames: the frame is drawn in the top left width x height of the targets and upscaled to the backBuffer on Present
+	// Clamped to the backBuffer size, resizing the backBuffer resets it to the full size
+	virtual void SetRenderResolution(uint32_t width, uint32_t height) = 0;
+	virtual uint32_t GetRenderWidth() const = 0;
+	virtual uint32_t GetRenderHeight() const = 0;
+
+	virtual void UpdateBuffer(BufferHandle buffer, const void* pData, uint32_t byteSize) = 0;
+
+	// Depth only passes, draws between them go to one slice of a depth target instead of the backBuffer and don't need a pixelShader
+	// Begin clears the slice to the far plane and unbinds every view, End rebinds the backBuffer; set the viewport again after both
+	virtual void BeginDepthPass(DepthTargetHandle depthTarget, uint32_t slice) = 0;
+	virtual void EndDepthPass() = 0;
+
+	// Parallel recording, a recorder is begun and ended by the worker filling it and executed on the render thread
+	// Executing in a fixed order keeps the frame identical whatever the number of workers
+	virtual uint32_t GetRecorderCount() const = 0;
+	virtual CommandRecorder& BeginRecording(uint32_t recorderIndex) = 0;	// Discards anything recorded before
+	virtual void EndRecording(uint32_t recorderIndex) = 0;
+	virtual void ExecuteRecording(uint32_t recorderIndex) = 0;				// Nothing stays bound afterwards, the backBuffer is rebound
+
+	// Backbuffer capture, not every backend can do it
+	virtual bool StartCapture(FrameCaptureEncoder::Format format, const std::wstring& filePath) = 0;
+	virtual void StopCapture() = 0;
+	virtual bool IsCapturing() const = 0;
+
+	virtual const Statistics& GetFrameStatistics() const = 0;	// Of the last presented frame
+	virtual void LogStatistics() const = 0;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "EngineMath.h"
+
+#include <array>
+
+// One camera rendered this frame: a split-screen player, a cubemap face, a shadow cascade...
+struct RenderView final
+{
+	math::Float4x4 viewMatrix;
+	math::Float4x4 projectionMatrix;
+	math::Float4x4 viewProjectionMatrix;
+	math::Float3 position;
+
+	float fovRadians;
+	float aspectRatio;
+	float nearZ;
+	float farZ;
+
+	math::Float4 viewportRect;		// x, y, width, height in pixels
+
+	static RenderView CreatePerspective(const math::Float3& position, const math::Float3& forward, const math::Float3& up,
+		float fovRadians, float nearZ, float farZ, const math::Float4& viewportRect)
+	{
+		using namespace math;
+
+		RenderView view{};
+		view.position = position;
+		view.fovRadians = fovRadians;
+		view.aspectRatio = viewportRect.z / viewportRect.w;
+		view.nearZ = nearZ;
+		view.farZ = farZ;
+		view.viewportRect = viewportRect;
+
+		const Matrix viewMatrix = MatrixLookToLH(LoadFloat3(&position), LoadFloat3(&forward), LoadFloat3(&up));
+		const Matrix projectionMatrix = MatrixPerspectiveFovLH(fovRadians, view.aspectRatio, nearZ, farZ);
+
+		StoreFloat4x4(&view.viewMatrix, viewMatrix);
+		StoreFloat4x4(&view.projectionMatrix, projectionMatrix);
+		StoreFloat4x4(&view.viewProjectionMatrix, viewMatrix * projectionMatrix);
+		return view;
+	}
+
+	// Six 90 degree views around one position, viewportRects are laid out in a 3x2 grid inside the given area
+	static std::array<RenderView, 6> CreateCubemap(const math::Float3& position, float nearZ, float farZ, const math::Float4& area)
+	{
+		using namespace math;
+
+		// +X, -X, +Y, -Y, +Z, -Z, same order as the D3D cubemap faces
+		const Float3 forwards[6] = { { 1.f, 0.f, 0.f }, { -1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }, { 0.f, -1.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 0.f, -1.f } };
+		const Float3 ups[6] = { { 0.f, 1.f, 0.f }, { 0.f, 1.f, 0.f }, { 0.f, 0.f, -1.f }, { 0.f, 0.f, 1.f }, { 0.f, 1.f, 0.f }, { 0.f, 1.f, 0.f } };
+
+		const float faceWidth{ area.z / 3.f };
+		const float faceHeight{ area.w / 2.f };
+
+		std::array<RenderView, 6> faces{};
+		for (int index{}; index < 6; ++index)
+		{
+			const Float4 faceRect{ area.x + (index % 3) * faceWidth, area.y + (index / 3) * faceHeight, faceWidth, faceHeight };
+			faces[index] = CreatePerspective(position, forwards[index], ups[index], g_PiDiv2, nearZ, farZ, faceRect);
+
+			// Faces are square, whatever the debug layout looks like
+			faces[index].aspectRatio = 1.f;
+			const Matrix projectionMatrix = MatrixPerspectiveFovLH(g_PiDiv2, 1.f, nearZ, farZ);
+			StoreFloat4x4(&faces[index].projectionMatrix, projectionMatrix);
+			StoreFloat4x4(&faces[index].viewProjectionMatrix, LoadFloat4x4(&faces[index].viewMatrix) * projectionMatrix);
+		}
+
+		return faces;
+	}
+};
@@ -2,43 +2,167 @@
 #include "Logger.h"
 #include "Utils.h"
 #include "InputManager.h"
+#include "D3D11RenderDevice.h"
+#include "NullRenderDevice.h"
+#include "SoftwareRenderDevice.h"
+#include "MeshletBuilder.h"
+#include "PerformanceCounters.h"
 
-#include <dxgi1_3.h>
 #include <combaseapi.h>
+#include <ppl.h>
 #include <ppltasks.h>
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cmath>
 #include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
 
-Renderer::Renderer(HWND windowHandle)
+Renderer::Renderer(HWND windowHandle, RenderDeviceType deviceType)
 	: m_WindowHandle{ windowHandle }
-	, m_pDevice{ nullptr }
-	, m_pDeviceContext{ nullptr }
-	, m_pSwapChain{}
-	, m_pRenderTargetView{}
-	, m_pDepthStencil{}
-	, m_pDepthStencilView{}
-	, m_pBackBuffer{}
-	, m_BackBufferDescription{}
-	, m_pInputLayout{}
-	, m_pVertexShader{}
-	, m_pPixelShader{}
-	, m_pConstantBuffer{}
+	, m_Assets{}
+	, m_StartupTime{ std::chrono::steady_clock::now() }
+	, m_DeviceCreationMs{}
+	, m_StartupReported{ false }
+	, m_pDevice{}
+	, m_ShaderPermutations{}
+	, m_SurfaceVertexShader{ ShaderPermutationCache::g_NoShader }
+	, m_SurfacePixelShader{ ShaderPermutationCache::g_NoShader }
+	, m_InputLayout{}
+	, m_VertexShader{}
+	, m_PixelShader{}
+	, m_PipelineState{}
+	, m_ConstantBuffer{}
 	, m_VertexConstantBuffer{}
-	, m_pVertexBuffer{}
-	, m_pIndexBuffer{}
+	, m_ViewConstantBuffer{}
+	, m_ViewConstants{}
+	, m_ObjectConstantBatch{}
+	, m_ViewConstantBatch{}
+	, m_ViewConstantSlots(static_cast<size_t>(g_ConstantSlotSize) * g_MaxViewSlots)
+	, m_VertexBuffer{}
+	, m_IndexBuffer{}
 	, m_IndexCount{}
-	, m_Viewport{}
-	, m_FeatureLevel{}
 	, m_SuccesfullCreation{ false }
 	, m_CameraPos{ 0.f, 0.f, -5.f }
+	, m_FieldOfView{ 45.f }
+	, m_NearZ{ 0.1f }
+	, m_FarZ{ 100.f }
+	, m_MeshBoundingSphere{}
+	, m_ObjectWorldMatrices{}
+	, m_ObjectSpheres{}
+	, m_MeshHierarchy{}
+	, m_DenseMeshHierarchy{}
+	, m_ObjectHierarchy{}
+	, m_PickCandidates{}
+	, m_MeshletCuller{}
+	, m_MeshletDraws{}
+	, m_DenseVertexBuffer{}
+	, m_MeshletIndexBuffer{}
+	, m_MeshletIndexCapacity{}
+	, m_DenseMeshBoundingSphere{}
+	, m_DenseObjectStart{}
+	, m_MeshletsReady{ false }
+	, m_ViewMode{ ViewMode::Single }
+	, m_Views{}
+	, m_ViewCuller{}
+	, m_Lights{}
+	, m_LightClusters{}
+	, m_ClusteredPixelShader{}
+	, m_ClusterConstantBuffer{}
+	, m_ClusterConstants{}
+	, m_LightBuffer{}
+	, m_ClusterRangeBuffer{}
+	, m_LightIndexBuffer{}
+	, m_LightView{}
+	, m_ClusterRangeView{}
+	, m_LightIndexView{}
+	, m_LightIndexCapacity{}
+	, m_ClusteredLightingReady{ false }
+	, m_ShadowCascades{ ShadowCascades::Settings{ 4, 1024, 0.75f, 60.f } }
+	, m_ShadowCuller{}
+	, m_SunDirection{ 0.3224f, -0.9211f, 0.2303f }
+	, m_ShadowMap{}
+	, m_ShadowMapView{}
+	, m_ShadowPipelineState{}
+	, m_ShadowedPixelShader{}
+	, m_ShadowedClusteredPixelShader{}
+	, m_ShadowConstantBuffer{}
+	, m_ShadowConstants{}
+	, m_ShadowsReady{ false }
+	, m_ShadowsEnabled{ true }
+	, m_Particles{ g_ParticleCapacity }
+	, m_ParticleVertexShader{}
+	, m_ParticlePixelShader{}
+	, m_ParticleInputLayout{}
+	, m_ParticlePipelineState{}
+	, m_ParticleQuadVertexBuffer{}
+	, m_ParticleQuadIndexBuffer{}
+	, m_ParticleInstanceBuffer{}
+	, m_ParticlesReady{ false }
+	, m_Animation{}
+	, m_SkinOnCpu{ deviceType == RenderDeviceType::Software }
+	, m_SkinnedVertexShader{}
+	, m_SkinnedInputLayout{}
+	, m_SkinnedVertexBuffer{}
+	, m_CharacterVertexBuffer{}
+	, m_CharacterIndexBuffer{}
+	, m_CharacterIndexCount{}
+	, m_IdentityConstantBuffer{}
+	, m_SkinConstantBatch{}
+	, m_SkinConstantBuffer{}
+	, m_SkinConstants{}
+	, m_SkinConstantSlots{}
+	, m_CharactersReady{ false }
+	, m_ResolutionController{ ResolutionController::Settings{ 1000.f / 60.f, g_MinRenderScale, 1.f, g_RenderScaleHeadroom, g_RenderScaleSettleFrames } }
+	, m_DynamicResolution{ true }
+	, m_ParallelRecording{ true }
+	, m_RecordingMs{}
+	, m_RecordedLists{}
+	, m_FrameCount{}
+	, m_SubmissionMs{}
+	, m_pCounters{ PerformanceCounters::GetInstance() }
+	, m_FrameCounter{ m_pCounters->Register("frames", PerformanceCounters::Kind::Counter) }
+	, m_FrameTimeGauge{ m_pCounters->Register("frame_time_us", PerformanceCounters::Kind::Gauge) }
+	, m_DrawCallGauge{ m_pCounters->Register("draw_calls", PerformanceCounters::Kind::Gauge) }
+	, m_TriangleGauge{ m_pCounters->Register("triangles", PerformanceCounters::Kind::Gauge) }
+	, m_UploadBytesGauge{ m_pCounters->Register("upload_bytes", PerformanceCounters::Kind::Gauge) }
+	, m_ResidentMemoryGauge{ m_pCounters->Register("resident_bytes", PerformanceCounters::Kind::Gauge) }
+	, m_JobQueueGauge{ m_pCounters->Register("job_queue_depth", PerformanceCounters::Kind::Gauge) }
+	, m_ResizeHitchGauge{ m_pCounters->Register("resize_hitch_us", PerformanceCounters::Kind::Gauge) }
+	, m_RenderScaleGauge{ m_pCounters->Register("render_scale_pct", PerformanceCounters::Kind::Gauge) }
+	, m_LastFrameStart{}
 {
-	
-	bool success =		   CreateDevice();
-	if (success) success = CreateSwapChain();
-	if (success) success = CreateRenderTarget();
-	if (success) success = CreateDepthStencil();
+	// Issued first, the shader reads run on the workers while the device is created
+	m_Assets.Start(utils::GetFullResourcePath(L"AssetManifest.txt"), utils::GetFullResourcePath(L"Assets.pak"));
 
-	if (success) CreateViewport();
+	if (deviceType == RenderDeviceType::Null || deviceType == RenderDeviceType::Software)
+	{
+		// Same size as the window, so the views and clusters match a real run
+		RECT clientRect{};
+		GetClientRect(windowHandle, &clientRect);
+
+		const uint32_t width{ static_cast<uint32_t>((std::max)(clientRect.right - clientRect.left, 1L)) };
+		const uint32_t height{ static_cast<uint32_t>((std::max)(clientRect.bottom - clientRect.top, 1L)) };
+
+		if (deviceType == RenderDeviceType::Software)
+		{
+			m_pDevice = std::make_unique<SoftwareRenderDevice>(width, height);
+			Logger::Log(L"Using the software render device, frames are rasterized on the CPU");
+			return;
+		}
+
+		m_pDevice = std::make_unique<NullRenderDevice>(width, height);
+		Logger::Log(L"Using the null render device, frames are validated and counted but not drawn");
+		return;
+	}
+
+	const std::chrono::steady_clock::time_point deviceStart{ std::chrono::steady_clock::now() };
+	std::unique_ptr<D3D11RenderDevice> pD3D11Device{ std::make_unique<D3D11RenderDevice>(windowHandle) };
+	const utils::ResourceReader readResource{ [this](const std::wstring& resource, std::vector<char>& readBytes) { return m_Assets.Read(resource, readBytes); } };
+	if (pD3D11Device->Initialize(readResource)) m_pDevice = std::move(pD3D11Device);
+	m_DeviceCreationMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - deviceStart).count();
 }
 
 void Renderer::Temp_Update(float deltaTime)
@@ -79,324 +203,281 @@ void Renderer::Temp_Update(float deltaTime)
 		m_CameraPos.y -= moveSpeed * deltaTime;
 	}
 
+	// Cycle single view, split-screen and cubemap faces
+	if (pInput->IsKeyReleased('V'))
+	{
+		switch (m_ViewMode)
+		{
+		case ViewMode::Single:		m_ViewMode = ViewMode::SplitScreen; break;
+		case ViewMode::SplitScreen:	m_ViewMode = ViewMode::Cubemap;		break;
+		case ViewMode::Cubemap:		m_ViewMode = ViewMode::Single;		break;
+		}
+	}
+
+	// Toggle frame capture, as numbered bitmaps or one raw stream
+	if (pInput->IsKeyReleased('C')) ToggleCapture(FrameCaptureEncoder::Format::ImageSequence);
+	if (pInput->IsKeyReleased('R')) ToggleCapture(FrameCaptureEncoder::Format::RawVideo);
+
+	// Cycle the software device's depth rejection: hierarchical depth, with a depth prepass, then neither
+	if (pInput->IsKeyReleased('Z') && m_pDevice->GetType() == RenderDeviceType::Software)
+	{
+		SoftwareRenderDevice& softwareDevice = static_cast<SoftwareRenderDevice&>(*m_pDevice);
+		const bool hierarchicalDepth{ softwareDevice.IsHierarchicalDepthEnabled() };
+		const bool depthPrepass{ softwareDevice.IsDepthPrepassEnabled() };
+
+		softwareDevice.SetHierarchicalDepth(!hierarchicalDepth || !depthPrepass);
+		softwareDevice.SetDepthPrepass(hierarchicalDepth && !depthPrepass);
+	}
+
+	// Toggle the sun shadows, off skips the depth passes and shades with the unshadowed pixelShaders
+	if (pInput->IsKeyReleased('L')) m_ShadowsEnabled = !m_ShadowsEnabled;
+
+	// Log the scene object under the cursor, found through the object and mesh hierarchies
+	if (pInput->IsKeyReleased(VK_LBUTTON)) PickObject();
+
+	// Toggle skinning the characters on the CPU, the software device only runs unskinned Surface_VS so it always does
+	if (pInput->IsKeyReleased('K')) m_SkinOnCpu = !m_SkinOnCpu || m_pDevice->GetType() == RenderDeviceType::Software;
+
+	// Toggle recording the draws on the workers, and time the recording for every worker count
+	if (pInput->IsKeyReleased('P')) m_ParallelRecording = !m_ParallelRecording;
+	if (pInput->IsKeyReleased('B')) BenchmarkRecording();
+
+	// Toggle dynamic resolution, off draws every frame at the backBuffer size again
+	if (pInput->IsKeyReleased('U'))
+	{
+		m_DynamicResolution = !m_DynamicResolution;
+		m_ResolutionController.Reset();
+		m_pDevice->SetRenderResolution(m_pDevice->GetBackBufferWidth(), m_pDevice->GetBackBufferHeight());
+	}
+
+	// ------------------
+	// DEBUG LIGHT ORBIT
+	// ------------------
+
+	const float orbitAngle{ 0.5f * deltaTime };
+	const float cosAngle{ cosf(orbitAngle) };
+	const float sinAngle{ sinf(orbitAngle) };
+
+	for (LightClusterGrid::Light& light : m_Lights)
+	{
+		const float x{ light.position.x };
+		const float y{ light.position.y };
+		light.position.x = x * cosAngle - y * sinAngle;
+		light.position.y = x * sinAngle + y * cosAngle;
+	}
+
 	CreateViewProjectionMatrix();
+
+	// Simulate particles, sorted for the first view
+	if (m_ParticlesReady)
+	{
+		m_Particles.Update(deltaTime);
+		m_Particles.SortByDepth(m_Views.front().viewMatrix);
+	}
+
+	if (m_CharactersReady) UpdateCharacters(deltaTime);
 }
 void Renderer::Render()
 {
+	// Publishes the previous frame, also while loading so the job queue can be watched
+	const std::chrono::steady_clock::time_point submitStart{ std::chrono::steady_clock::now() };
+	UpdateCounters(submitStart);
+
 	// Don't render if faulty init
 	if (!m_SuccesfullCreation) return;
 
-	// Update subresource
-	m_pDeviceContext->UpdateSubresource
-	(
-		m_pConstantBuffer.Get(),	// Destination resource
-		0,							// Resource index
-		nullptr,					// Write data to destination resource without offset
-		&m_VertexConstantBuffer,	// Source data
-		0,							// Size of one row of source data
-		0							// Size of one depth slice of source data
-	);
-
-	// Clear the renderTarget and the z-buffer
+	// Clear and bind the backBuffer
 	const float backgroundColor[] = { 0.098f, 0.439f, 0.439f, 1.f };
-	m_pDeviceContext->ClearRenderTargetView(m_pRenderTargetView.Get(), backgroundColor);
-	m_pDeviceContext->ClearDepthStencilView(m_pDepthStencilView.Get(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.f, 0);
-
-	// Set the renderTarget
-	m_pDeviceContext->OMSetRenderTargets
-	(
-		1,									// Nr renderTargets
-		m_pRenderTargetView.GetAddressOf(),	// RenderTargets
-		m_pDepthStencilView.Get()			// DepthStencilView
-	);
+	m_pDevice->BeginFrame(backgroundColor);
 
-	// Set up the IA stage by setting the inputTopology and -layout
-	UINT stride = sizeof(BaseVertexInput);
-	UINT offset{};
+	// Cull once for all views and upload all view constants in one go
+	m_ViewCuller.Cull(m_Views);
+	if (m_ShadowsReady && m_ShadowsEnabled) UpdateShadows();
+	UploadViewConstants();
+	if (m_ClusteredLightingReady) UploadLights();
+	if (m_MeshletsReady) CullMeshlets();
+	if (m_CharactersReady) UploadCharacters();
 
-	m_pDeviceContext->IASetVertexBuffers
-	(
-		0,								// StartSlot
-		1,								// Nr VertexBuffers
-		m_pVertexBuffer.GetAddressOf(),	// VertexBuffers
-		&stride,						// Strides
-		&offset							// Offsets
-	);
+	// Shadow maps first, the views sample them
+	if (m_ShadowsReady && m_ShadowsEnabled) RenderShadowMaps();
 
-	m_pDeviceContext->IASetIndexBuffer
-	(
-		m_pIndexBuffer.Get(),			// IndexBuffer
-		DXGI_FORMAT_R16_UINT,			// Format
-		0								// Offset
-	);
+	// Per draw constant updates only work on the immediate context, otherwise the workers record the draws
+	const uint32_t workerCount{ m_ParallelRecording && m_pDevice->GetFeatures().constantBufferOffsets ? m_pDevice->GetRecorderCount() : 0 };
 
-	m_pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	m_pDeviceContext->IASetInputLayout(m_pInputLayout.Get());
+	// Draw every view
+	for (uint32_t viewIndex{}; viewIndex < m_Views.size() && viewIndex < MultiViewCuller::g_MaxViews; ++viewIndex)
+	{
+		// Uploads stay on the render thread, before the lists reading them are executed
+		if (m_ClusteredLightingReady) UpdateClusteredLighting(viewIndex);
+
+		// Dense objects come last in the visible list, they are drawn from their meshlets
+		const std::vector<uint32_t>& visibleObjects = GetVisibleObjects(viewIndex);
+		const size_t meshObjectCount{ static_cast<size_t>(std::lower_bound(visibleObjects.begin(), visibleObjects.end(), m_DenseObjectStart) - visibleObjects.begin()) };
+
+		if (workerCount == 0)
+		{
+			RecordDraws(*m_pDevice, viewIndex, visibleObjects.data(), meshObjectCount);
+		}
+		else
+		{
+			const std::chrono::steady_clock::time_point recordStart{ std::chrono::steady_clock::now() };
+			const uint32_t listCount{ RecordDrawsInParallel(viewIndex, visibleObjects.data(), meshObjectCount, workerCount) };
+			m_RecordingMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
+
+			// Always in list order, so the frame doesn't depend on which worker finished first
+			for (uint32_t listIndex{}; listIndex < listCount; ++listIndex)
+			{
+				m_pDevice->ExecuteRecording(listIndex);
+			}
+			m_RecordedLists += listCount;
+		}
+
+		if (m_MeshletsReady) RecordMeshletDraws(*m_pDevice, viewIndex);
+		if (m_CharactersReady) RecordCharacterDraws(*m_pDevice, viewIndex);
+	}
 
-	// Set up the vertexShader stage
-	m_pDeviceContext->VSSetShader
-	(
-		m_pVertexShader.Get(),	// VertexShader
-		nullptr,				// Class instances
-		0						// Nr class instances
-	);
+	// Alpha blended particles last, on top of every view
+	if (m_ParticlesReady) RenderParticles();
 
-	m_pDeviceContext->VSSetConstantBuffers
-	(
-		0,									// StartSlot
-		1,									// Nr buffers
-		m_pConstantBuffer.GetAddressOf()	// ConstantBuffers
-	);
+	// Present waits for vsync, so it isn't part of the submission cost
+	m_SubmissionMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - submitStart).count();
 
-	// Set up the pixelShader stage
-	m_pDeviceContext->PSSetShader
-	(
-		m_pPixelShader.Get(),	// PixelShader
-		nullptr,				// Class instances
-		0						// Nr class instances
-	);
+	LogFrameStatistics();
+	if (!m_StartupReported) LogStartup();
 
-	// Draw
-	m_pDeviceContext->DrawIndexed
-	(
-		m_IndexCount,	// IndexCount
-		0,				// Start index
-		0				// Base vertexLocation
-	);
+	m_pDevice->Present();
 
-	// Present frame (do after every geometry is rendered)
-	m_pSwapChain->Present(1, 0);
+	// Between frames, the next views are created at the new size
+	UpdateRenderResolution();
 }
 
 void Renderer::CreateDeviceDependentResources()
 {
+	if (!m_pDevice) return;
+
+	// Every task leaves the job queue counter when it's done
+	m_pCounters->Add(m_JobQueueGauge, 3);
+
 	// Compile shaders
 	auto createShadersTask = Concurrency::create_task([this]()
 	{
 		CreateShaders();
+		m_pCounters->Add(m_JobQueueGauge, -1);
+	});
+
+	// Lights, particles and characters use the shader cache, so wait for the shaders
+	auto createLightingTask = createShadersTask.then([this]()
+	{
+		CreateLights();
+		CreateClusteredLighting();
+		CreateShadows();
+		CreateParticles();
+		CreateCharacters();
+		m_pCounters->Add(m_JobQueueGauge, -1);
 	});
 
 	// Load the geometry, after compiling shaders
-	auto createTriangleTask = createShadersTask.then([this]()
+	auto createTriangleTask = createLightingTask.then([this]()
 	{
 		CreateTriangle();
+		m_pCounters->Add(m_JobQueueGauge, -1);
 	});
 }
 void Renderer::CreateWindowSizeDependentResources()
 {
+	if (!m_pDevice) return;
+
 	// Create view & projection matrix
 	CreateViewProjectionMatrix();
 }
+void Renderer::Resize(uint32_t width, uint32_t height)
+{
+	if (!m_pDevice || width == 0 || height == 0) return;
 
-// Privates
-// --------
-bool Renderer::CreateDevice()
-{
-	// Minimum level of hardware the application supports
-	const D3D_FEATURE_LEVEL featureLevels[] =
-	{
-		D3D_FEATURE_LEVEL_11_1,
-		D3D_FEATURE_LEVEL_11_0,
-		D3D_FEATURE_LEVEL_10_1,
-		D3D_FEATURE_LEVEL_10_0,
-		D3D_FEATURE_LEVEL_9_3,
-		D3D_FEATURE_LEVEL_9_2,
-		D3D_FEATURE_LEVEL_9_1,
-	};
-
-	// Supports surface with different color-change than API default, required for Direct2D
-	UINT deviceFlags = D3D11_CREATE_DEVICE_BGRA_SUPPORT;
-
-#if defined(DEBUG) || defined(_DEBUG)
-	deviceFlags |= D3D11_CREATE_DEVICE_DEBUG;
-#endif
-
-	// Create device
-	HRESULT result = D3D11CreateDevice
-	(
-		nullptr,							// Default adapter
-		D3D_DRIVER_TYPE_HARDWARE,			// Create device using hardware graphics driver
-		0,									// Not using D3D_DRIVER_TYPE_SOFTWARE
-		deviceFlags,						// Direct2D and debug compatiblity
-		featureLevels,						// Supported feature levels
-		ARRAYSIZE(featureLevels),			// Size of levels array
-		D3D11_SDK_VERSION,					// Version for Windows Store Apps
-		m_pDevice.GetAddressOf(),			// Returns created Direct3D device
-		&m_FeatureLevel,					// Returns feature level of created device
-		m_pDeviceContext.GetAddressOf()		// Returns device immediate context
-	);
+	// Restoring a minimized window often reports the size it already had
+	const uint32_t oldWidth{ m_pDevice->GetBackBufferWidth() };
+	const uint32_t oldHeight{ m_pDevice->GetBackBufferHeight() };
+	if (width == oldWidth && height == oldHeight) return;
 
-	if (FAILED(result))
-	{
-		Logger::Log(L"FAILED - There was an error creating the DirectX Device");
-		return false;
-	}
-	else
+	// A capture can't change size halfway through
+	if (m_pDevice->IsCapturing())
 	{
-		Logger::Log(L"Succeeded creating the DirectX Device");
-		return true;
+		m_pDevice->StopCapture();
+		Logger::Log(L"Capture stopped, the backBuffer is being resized");
 	}
-}
-bool Renderer::CreateSwapChain()
-{
-	// Create swapChain description
-	DXGI_SWAP_CHAIN_DESC chainDescription;
-	ZeroMemory(&chainDescription, sizeof(DXGI_SWAP_CHAIN_DESC));
 
-	chainDescription.Windowed = TRUE;									// Not in full-screen mode
-	chainDescription.BufferCount = 2;									// Double-buffer
-	chainDescription.BufferDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;	// 32-bit color
-	chainDescription.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;		// Used for drawing
-	chainDescription.SampleDesc.Count = 1;								// Multisampling setting
-	chainDescription.SampleDesc.Quality = 0;							// Vendor-specific flag
-	chainDescription.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;		// How buffer swaps
-	chainDescription.OutputWindow = m_WindowHandle;						// Window to render to
-
-	// Cast to IDXGIDevice3
-	Microsoft::WRL::ComPtr<IDXGIDevice3> pDxgiDevice;
-	m_pDevice.As(&pDxgiDevice);
-
-	// Create swapChain
-	Microsoft::WRL::ComPtr<IDXGIAdapter> pAdapter;
-	HRESULT result = pDxgiDevice->GetAdapter(&pAdapter);
-
-	if (FAILED(result))
+	// The hitch is everything the frame waits for: the targets, the views and the light clusters
+	const std::chrono::steady_clock::time_point resizeStart{ std::chrono::steady_clock::now() };
+	if (!m_pDevice->ResizeBackBuffer(width, height))
 	{
-		Logger::Log(L"FAILED - There was an error getting the DirectX Adapter");
-		return false;
+		// Without targets there is nothing left to draw to
+		Logger::Log(L"ERROR - Failed to resize the backBuffer, rendering stops");
+		m_SuccesfullCreation = false;
+		return;
 	}
 
-	Logger::Log(L"Succeeded getting the DirectX Adapter");
-
-	Microsoft::WRL::ComPtr<IDXGIFactory> pFactory;
-	pAdapter->GetParent(__uuidof(IDXGIFactory), &pFactory);
+	CreateWindowSizeDependentResources();
+	const std::chrono::steady_clock::duration hitch{ std::chrono::steady_clock::now() - resizeStart };
+	m_pCounters->Set(m_ResizeHitchGauge, std::chrono::duration_cast<std::chrono::microseconds>(hitch).count());
 
-	result = pFactory->CreateSwapChain(m_pDevice.Get(), &chainDescription, m_pSwapChain.GetAddressOf());
-	if (FAILED(result))
-	{
-		Logger::Log(L"FAILED - There was an error creating the DirectX SwapChain");
-		return false;
-	}
-	else
-	{
-		Logger::Log(L"Succeeded creating the DirectX SwapChain");
-		return true;
-	}
+	std::wstringstream message;
+	message << L"Resized the backBuffer from " << oldWidth << L"x" << oldHeight << L" to " << width << L"x" << height
+		<< L" in " << std::chrono::duration<double, std::milli>(hitch).count() << L" ms";
+	Logger::Log(message.str());
 }
-bool Renderer::CreateRenderTarget()
+void Renderer::SetFrameTimeTarget(float targetMs)
 {
-	// Get backBuffer
-	HRESULT result = m_pSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), reinterpret_cast<void**>(m_pBackBuffer.GetAddressOf()));
-	if (FAILED(result))
-	{
-		Logger::Log(L"FAILED - There was an error getting the SwapChain backBuffer");
-		return false;
-	}
+	m_ResolutionController.SetTargetMs(targetMs);
+}
 
-	// Create renderTargetView
-	result = m_pDevice->CreateRenderTargetView
-	(
-		m_pBackBuffer.Get(),					// Give backBuffer for read
-		nullptr,								// Default description
-		m_pRenderTargetView.GetAddressOf()		// Returns renderTargetView
-	);
+// Privates
+// --------
+void Renderer::CreateShaders()
+{
+	// Shader permutations
+	// -------------------
 
-	if (FAILED(result))
+	// Compiled by the device on the workers, or taken from the cache the last run saved
+	m_ShaderPermutations.Initialize([this](const ShaderCompileDescription& description, std::vector<char>& bytecode, std::string& errors)
 	{
-		Logger::Log(L"FAILED - There was an error creating the RenderTargetView");
-		return false;
-	}
+		return m_pDevice->CompileShader(description, bytecode, errors);
+	}, m_pDevice->GetShaderProfile(ShaderStage::Vertex), m_pDevice->GetShaderProfile(ShaderStage::Pixel));
+	m_ShaderPermutations.LoadFromFile(utils::GetFullResourcePath(L"ShaderCache.bin"));
 
-	m_pBackBuffer->GetDesc(&m_BackBufferDescription);
+	const utils::ResourceReader readResource{ [this](const std::wstring& resource, std::vector<char>& readBytes) { return m_Assets.Read(resource, readBytes); } };
+	m_SurfaceVertexShader = m_ShaderPermutations.AddShader(ShaderPermutationCache::ShaderDescription{ L"Surface_VS.hlsl", "VSMain", ShaderStage::Vertex, { "SKINNED" } }, readResource);
+	m_SurfacePixelShader = m_ShaderPermutations.AddShader(ShaderPermutationCache::ShaderDescription{ L"Surface_PS.hlsl", "PSMain", ShaderStage::Pixel, { "CLUSTERED_LIGHTING", "SHADOWS" } }, readResource);
 
-	return true;
-}
-bool Renderer::CreateDepthStencil()
-{
-	// Create description
-	const CD3D11_TEXTURE2D_DESC depthStencilDesc
+	// Every variant the scene draws with, in parallel, anything else compiles on first use
+	std::vector<ShaderPermutationCache::VariantRequest> variants
 	{
-		DXGI_FORMAT_D24_UNORM_S8_UINT,	// Texture Format
-		m_BackBufferDescription.Width,	// Width
-		m_BackBufferDescription.Height,	// Height
-		1,								// Only 1 texture
-		1,								// 1 mipmap level
-		D3D11_BIND_DEPTH_STENCIL		// Used as depth stencil
+		{ m_SurfaceVertexShader, 0 },
+		{ m_SurfaceVertexShader, g_SkinnedFeature },
+		{ m_SurfacePixelShader, 0 },
+		{ m_SurfacePixelShader, g_ShadowsFeature }
 	};
-
-	// Create texture
-	HRESULT result = m_pDevice->CreateTexture2D(&depthStencilDesc, nullptr, m_pDepthStencil.GetAddressOf());
-	if (FAILED(result))
-	{
-		Logger::Log(L"FAILED - There was an error creating the DepthStencil texture");
-		return false;
-	}
-
-	// Create view
-	CD3D11_DEPTH_STENCIL_VIEW_DESC depthStencilViewDesc{ D3D11_DSV_DIMENSION_TEXTURE2D };	// Used by texture2D
-	result = m_pDevice->CreateDepthStencilView(m_pDepthStencil.Get(), &depthStencilViewDesc, m_pDepthStencilView.GetAddressOf());
-	if (FAILED(result))
+	if (m_pDevice->GetFeatures().structuredBuffers)
 	{
-		Logger::Log(L"FAILED - There was an error creating the DepthStencilView");
-		return false;
+		variants.push_back(ShaderPermutationCache::VariantRequest{ m_SurfacePixelShader, g_ClusteredLightingFeature });
+		variants.push_back(ShaderPermutationCache::VariantRequest{ m_SurfacePixelShader, g_ClusteredLightingFeature | g_ShadowsFeature });
 	}
+	m_ShaderPermutations.Precompile(variants);
 
-	return true;
-}
-void Renderer::CreateViewport()
-{
-	// Empty variable
-	ZeroMemory(&m_Viewport, sizeof(D3D11_VIEWPORT));
-	
-	// Setup viewport
-	m_Viewport.Width = static_cast<float>(m_BackBufferDescription.Width);
-	m_Viewport.Height = static_cast<float>(m_BackBufferDescription.Height);
-	m_Viewport.MinDepth = 0;
-	m_Viewport.MaxDepth = 1;
-
-	// Set viewport
-	m_pDeviceContext->RSSetViewports(1, &m_Viewport);	// Only 1 viewport
-}
-
-void Renderer::CreateShaders()
-{
-	// -----------------------------------------------
-	// TODO: WILL NEED TO BE REPLACED BY A FILE LOADER
-	// -----------------------------------------------
 
 	// VertexShader
 	// ------------
 
-	// Open file
-	std::wstring fileName{ utils::GetFullResourcePath(L"Base_VS.cso") };
-	std::ifstream vertexShaderFile{ fileName.c_str(), std::ifstream::binary | std::ifstream::ate };
-
-	if (!vertexShaderFile)
-	{
-		Logger::Log(L"ERROR - Failed to open Base_VS.cso");
-		return;
-	}
-
-	// Read file and create vertexShader
-	std::streamsize fileSize{ vertexShaderFile.tellg() };
-	vertexShaderFile.seekg(0, std::ios::beg);
-	std::vector<char> readBytes(fileSize);
-	
-	if (!vertexShaderFile.read(readBytes.data(), fileSize))
+	const std::wstring vertexShaderName{ m_ShaderPermutations.GetVariantName(m_SurfaceVertexShader, 0) };
+	const std::vector<char>* pVertexShaderBytes{ m_ShaderPermutations.GetBytecode(m_SurfaceVertexShader, 0) };
+	if (!pVertexShaderBytes)
 	{
-		Logger::Log(L"ERROR - Failed to read the shader file");
+		Logger::Log(L"ERROR - Failed to compile the surface vertexShader");
 		return;
 	}
 
-	HRESULT result = m_pDevice->CreateVertexShader
-	(
-		readBytes.data(),				// Data
-		readBytes.size(),				// Data size
-		nullptr,						// Class linkage interface, for linking to the shader
-		m_pVertexShader.GetAddressOf()	// VertexShader
-	);
-
-	if (FAILED(result))
+	// Get or create vertexShader
+	m_VertexShader = m_pDevice->CreateVertexShader(vertexShaderName, *pVertexShaderBytes);
+	if (!m_VertexShader.IsValid())
 	{
 		Logger::Log(L"Error - Failed to create a vertexShader");
 		return;
@@ -406,23 +487,22 @@ void Renderer::CreateShaders()
 	// Create inputLayout
 	// ------------------
 
-	const D3D11_INPUT_ELEMENT_DESC inputLayoutDescription[] =
+	const InputElement inputLayoutDescription[] =
 	{
-		{"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT , D3D11_INPUT_PER_VERTEX_DATA, 0},
-		{"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-		{"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0}
+		{ "POSITION", 0, ElementFormat::R32G32B32_Float, 0, false },
+		{ "NORMAL", 0, ElementFormat::R32G32B32_Float, 0, false },
+		{ "TEXCOORD", 0, ElementFormat::R32G32_Float, 0, false }
 	};
 
-	result = m_pDevice->CreateInputLayout
+	m_InputLayout = m_pDevice->CreateInputLayout
 	(
 		inputLayoutDescription,
 		ARRAYSIZE(inputLayoutDescription),
-		readBytes.data(),
-		readBytes.size(),
-		m_pInputLayout.GetAddressOf()
+		vertexShaderName,
+		*pVertexShaderBytes
 	);
 
-	if (FAILED(result))
+	if (!m_InputLayout.IsValid())
 	{
 		Logger::Log(L"Error - Failed to create an inputLayout");
 		return;
@@ -432,96 +512,66 @@ void Renderer::CreateShaders()
 	// PixelShader
 	// -----------
 
-	// Open file
-	fileName = utils::GetFullResourcePath(L"Color_PS.cso");
-	std::ifstream pixelShaderFile{ fileName.c_str(), std::ifstream::binary | std::ifstream::ate };
-
-	if (!pixelShaderFile)
+	const std::wstring pixelShaderName{ m_ShaderPermutations.GetVariantName(m_SurfacePixelShader, 0) };
+	const std::vector<char>* pPixelShaderBytes{ m_ShaderPermutations.GetBytecode(m_SurfacePixelShader, 0) };
+	if (!pPixelShaderBytes)
 	{
-		Logger::Log(L"ERROR - Failed to open Color_PS.cso");
+		Logger::Log(L"ERROR - Failed to compile the surface pixelShader");
 		return;
 	}
 
-	// Read file and create pixelShader
-	fileSize = pixelShaderFile.tellg();
-	pixelShaderFile.seekg(0, std::ios::beg);
-
-	readBytes.clear();
-	readBytes.resize(fileSize);
-
-	if (!pixelShaderFile.read(readBytes.data(), fileSize))
+	// Get or create pixelShader
+	m_PixelShader = m_pDevice->CreatePixelShader(pixelShaderName, *pPixelShaderBytes);
+	if (!m_PixelShader.IsValid())
 	{
-		Logger::Log(L"ERROR - Failed to read the shader file");
+		Logger::Log(L"ERROR - Failed to create a pixelShader");
 		return;
 	}
 
-	result = m_pDevice->CreatePixelShader
-	(
-		readBytes.data(),
-		readBytes.size(),
-		nullptr,
-		m_pPixelShader.GetAddressOf()
-	);
 
-	if (FAILED(result))
+	// Fixed-function states
+	// ---------------------
+
+	// Default states for now, back faces culled and depth tested
+	m_PipelineState = m_pDevice->CreatePipelineState(PipelineStateDescription{ CullMode::Back, true, true, BlendMode::Opaque, 0, 0.f });
+	if (!m_PipelineState.IsValid())
 	{
-		Logger::Log(L"ERROR - Failed to create a pixelShader");
-		return;
+		Logger::Log(L"ERROR - Failed to create the fixed-function pipeline states");
 	}
 
 
 	// ConstantBuffer
 	// --------------
 
-	const CD3D11_BUFFER_DESC constantBufferDescription
+	m_ConstantBuffer = m_pDevice->CreateBuffer(BufferDescription{ BufferType::Constant, BufferUsage::Default, sizeof(CB_BaseVertex), 0 }, nullptr);
+	if (!m_ConstantBuffer.IsValid())
 	{
-		sizeof(CB_BaseVertex),
-		D3D11_BIND_CONSTANT_BUFFER
-	};
-
-	result = m_pDevice->CreateBuffer
-	(
-		&constantBufferDescription,
-		nullptr,
-		m_pConstantBuffer.GetAddressOf()
-	);
+		Logger::Log(L"ERROR - Failed to create the constantBuffer");
+		return;
+	}
 
-	if (FAILED(result))
+	if (!CreateViewConstants())
 	{
-		Logger::Log(L"ERROR - Failed to create the constantBuffer");
+		Logger::Log(L"ERROR - Failed to create the view constantBuffers");
 		return;
 	}
 }
-HRESULT Renderer::CreateTriangle()
+bool Renderer::CreateTriangle()
 {
 	// Create triangle geometry
 	const BaseVertexInput triangleVertices[] =
 	{
-		{ DirectX::XMFLOAT3{ -0.5f,-0.5f, 0.0f }, DirectX::XMFLOAT3{}, DirectX::XMFLOAT2{} },
-		{ DirectX::XMFLOAT3{  0.5f,-0.5f, 0.0f }, DirectX::XMFLOAT3{}, DirectX::XMFLOAT2{} },
-		{ DirectX::XMFLOAT3{  0.0f, 0.3f, 0.0f }, DirectX::XMFLOAT3{}, DirectX::XMFLOAT2{} }
+		{ math::Float3{ -0.5f,-0.5f, 0.0f }, math::Float3{ 0.f, 0.f, -1.f }, math::Float2{} },
+		{ math::Float3{  0.5f,-0.5f, 0.0f }, math::Float3{ 0.f, 0.f, -1.f }, math::Float2{} },
+		{ math::Float3{  0.0f, 0.3f, 0.0f }, math::Float3{ 0.f, 0.f, -1.f }, math::Float2{} }
 	};
 
 	// Create vertexBuffer
-	const CD3D11_BUFFER_DESC vertexDescription{ sizeof(triangleVertices), D3D11_BIND_VERTEX_BUFFER};
-
-	D3D11_SUBRESOURCE_DATA vertexData;
-	ZeroMemory(&vertexData, sizeof(D3D11_SUBRESOURCE_DATA));	// Stops writes being compiled away if it isn't being read immeadiatly
-	vertexData.pSysMem = triangleVertices;						// Initialization data
-	vertexData.SysMemPitch = 0;									// Distance from beginning line of texture to the next line (only for 2D & 3D texture)
-	vertexData.SysMemSlicePitch = 0;							// Distance from beginning of one depth level to the next	(only for 3D texture)
-
-	HRESULT result = m_pDevice->CreateBuffer
-	(
-		&vertexDescription,
-		&vertexData,
-		m_pVertexBuffer.GetAddressOf()
-	);
-
-	if (FAILED(result))
+	m_VertexBuffer = m_pDevice->CreateBuffer(BufferDescription{ BufferType::Vertex, BufferUsage::Default, sizeof(triangleVertices), 0 }, triangleVertices);
+	if (!m_VertexBuffer.IsValid())
 	{
 		Logger::Log(L"ERROR - Failed to create a vertexBuffer");
-		return result;
+		return false;
 	}
 
 	// Create indexBuffer
@@ -532,62 +582,1584 @@ HRESULT Renderer::CreateTriangle()
 
 	m_IndexCount = ARRAYSIZE(triangleIndices);
 
-	const CD3D11_BUFFER_DESC indexDescription{ sizeof(triangleIndices), D3D11_BIND_INDEX_BUFFER };
+	m_IndexBuffer = m_pDevice->CreateBuffer(BufferDescription{ BufferType::Index, BufferUsage::Default, sizeof(triangleIndices), 0 }, triangleIndices);
+	if (!m_IndexBuffer.IsValid())
+	{
+		Logger::Log(L"ERROR - Failed to create an indexBuffer");
+		return false;
+	}
 
-	D3D11_SUBRESOURCE_DATA indexData;
-	ZeroMemory(&indexData, sizeof(D3D11_SUBRESOURCE_DATA));
-	indexData.pSysMem = triangleIndices;
-	indexData.SysMemPitch = 0;
-	indexData.SysMemSlicePitch = 0;
+	// Bounding sphere around the vertices, used for culling
+	math::Vector center{ math::VectorZero() };
+	for (const BaseVertexInput& vertex : triangleVertices)
+	{
+		center = math::VectorAdd(center, math::LoadFloat3(&vertex.position));
+	}
+	center = math::VectorScale(center, 1.f / ARRAYSIZE(triangleVertices));
 
-	result = m_pDevice->CreateBuffer
-	(
-		&indexDescription,
-		&indexData,
-		m_pIndexBuffer.GetAddressOf()
-	);
+	float radius{};
+	for (const BaseVertexInput& vertex : triangleVertices)
+	{
+		const math::Vector offset{ math::VectorSubtract(math::LoadFloat3(&vertex.position), center) };
+		radius = (std::max)(radius, math::VectorGetX(math::Vector3Length(offset)));
+	}
+
+	math::StoreFloat4(&m_MeshBoundingSphere, center);
+	m_MeshBoundingSphere.w = radius;
+
+	// Triangles for picking, in object space so every instance shares them
+	const std::vector<uint32_t> hierarchyIndices(std::begin(triangleIndices), std::end(triangleIndices));
+	m_MeshHierarchy.Build(triangleVertices, sizeof(BaseVertexInput), ARRAYSIZE(triangleVertices), hierarchyIndices.data(), static_cast<uint32_t>(hierarchyIndices.size()));
 
-	if (FAILED(result))
+	// Dense meshes are optional, the scene works without them
+	m_MeshletsReady = CreateDenseMesh();
+	if (!m_MeshletsReady) Logger::Log(L"ERROR - Failed to create the dense meshes, they are left out");
+
+	// Instances of the geometry
+	if (!CreateSceneObjects())
 	{
-		Logger::Log(L"ERROR - Failed to create an indexBuffer");
-		return result;
+		Logger::Log(L"ERROR - Failed to create the scene objects");
+		return false;
 	}
 
 	// Creation success
 	m_SuccesfullCreation = true;
 
-	return result;
+	return true;
+}
+bool Renderer::CreateDenseMesh()
+{
+	using namespace math;
+
+	// Sphere, ring 0 is the top pole
+	std::vector<BaseVertexInput> vertices;
+	vertices.reserve(static_cast<size_t>(g_DenseMeshRings + 1) * (g_DenseMeshSegments + 1));
+	for (uint32_t ring{}; ring <= g_DenseMeshRings; ++ring)
+	{
+		const float theta{ g_Pi * ring / g_DenseMeshRings };
+		for (uint32_t segment{}; segment <= g_DenseMeshSegments; ++segment)
+		{
+			const float phi{ g_2Pi * segment / g_DenseMeshSegments };
+			const Float3 normal{ std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) };
+			const Float3 position{ normal.x * g_DenseMeshRadius, normal.y * g_DenseMeshRadius, normal.z * g_DenseMeshRadius };
+			vertices.push_back(BaseVertexInput{ position, normal, Float2{ static_cast<float>(segment) / g_DenseMeshSegments, static_cast<float>(ring) / g_DenseMeshRings } });
+		}
+	}
+
+	// Clockwise seen from outside, the triangles that collapse on the poles are left out
+	std::vector<uint32_t> indices;
+	indices.reserve(static_cast<size_t>(g_DenseMeshRings) * g_DenseMeshSegments * 6);
+	for (uint32_t ring{}; ring < g_DenseMeshRings; ++ring)
+	{
+		for (uint32_t segment{}; segment < g_DenseMeshSegments; ++segment)
+		{
+			const uint32_t topLeft{ ring * (g_DenseMeshSegments + 1) + segment };
+			const uint32_t topRight{ topLeft + 1 };
+			const uint32_t bottomLeft{ topLeft + g_DenseMeshSegments + 1 };
+			const uint32_t bottomRight{ bottomLeft + 1 };
+
+			if (ring != 0) indices.insert(indices.end(), { topLeft, topRight, bottomLeft });
+			if (ring != g_DenseMeshRings - 1) indices.insert(indices.end(), { topRight, bottomRight, bottomLeft });
+		}
+	}
+
+	// Import time: only the meshlets are kept, the index buffer is rebuilt from them every frame
+	MeshletBuilder meshletBuilder{};
+	meshletBuilder.Build(vertices.data(), sizeof(BaseVertexInput), static_cast<uint32_t>(vertices.size()), indices.data(), static_cast<uint32_t>(indices.size()));
+	m_MeshletCuller.SetMeshlets(meshletBuilder);
+
+	const MeshletBuilder::Statistics& builderStatistics = meshletBuilder.GetStatistics();
+	std::wstringstream message;
+	message << L"Meshlets built: " << builderStatistics.meshletCount << L" meshlets from " << builderStatistics.triangleCount << L" triangles, "
+		<< builderStatistics.averageVertices << L" vertices and " << builderStatistics.averageTriangles << L" triangles on average, "
+		<< builderStatistics.buildMs << L" ms";
+	Logger::Log(message.str());
+
+	// Unlike the index buffer, the triangles are kept for picking
+	m_DenseMeshHierarchy.Build(vertices.data(), sizeof(BaseVertexInput), static_cast<uint32_t>(vertices.size()), indices.data(), static_cast<uint32_t>(indices.size()));
+
+	const BoundingVolumeHierarchy::Statistics& hierarchyStatistics = m_DenseMeshHierarchy.GetStatistics();
+	message.str(L"");
+	message << L"Dense mesh hierarchy built: " << hierarchyStatistics.nodeCount << L" nodes and " << hierarchyStatistics.leafCount << L" leaves over "
+		<< hierarchyStatistics.primitiveCount << L" triangles, " << hierarchyStatistics.maxDepth << L" deep, SAH cost " << hierarchyStatistics.sahCost << L", "
+		<< hierarchyStatistics.buildMs << L" ms";
+	Logger::Log(message.str());
+
+	m_DenseMeshBoundingSphere = Float4{ 0.f, 0.f, 0.f, g_DenseMeshRadius };
+
+	m_DenseVertexBuffer = m_pDevice->CreateBuffer(BufferDescription{ BufferType::Vertex, BufferUsage::Immutable, static_cast<uint32_t>(vertices.size() * sizeof(BaseVertexInput)), 0 }, vertices.data());
+	return m_DenseVertexBuffer.IsValid();
+}
+bool Renderer::CreateSceneObjects()
+{
+	using namespace math;
+
+	// Grid of triangles, a few layers deep
+	const int gridSize{ 16 };
+	const int layerCount{ 4 };
+	const float spacing{ 1.5f };
+	const float layerDistance{ 6.f };
+
+	m_ObjectWorldMatrices.clear();
+	m_ObjectSpheres.clear();
+
+	for (int layer{}; layer < layerCount; ++layer)
+	{
+		for (int row{}; row < gridSize; ++row)
+		{
+			for (int column{}; column < gridSize; ++column)
+			{
+				// Create world matrix
+				const Matrix translation = MatrixTranslation((column - gridSize / 2) * spacing, (row - gridSize / 2) * spacing, layer * layerDistance);
+				const Matrix rotation = MatrixRotationRollPitchYaw(0.f, 0.f, 0.f);	// In radians
+				const Matrix scale = MatrixScaling(1.f, 1.f, 1.f);
+
+				const Matrix worldMatrix = scale * rotation * translation;
+
+				Float4x4 storedMatrix{};
+				StoreFloat4x4(&storedMatrix, worldMatrix);
+				m_ObjectWorldMatrices.push_back(storedMatrix);
+
+				// World bounds, uniform scale so the radius only scales
+				Float4 sphere{};
+				StoreFloat4(&sphere, Vector3TransformCoord(LoadFloat4(&m_MeshBoundingSphere), worldMatrix));
+				sphere.w = m_MeshBoundingSphere.w;
+				m_ObjectSpheres.push_back(sphere);
+			}
+		}
+	}
+
+	// A few dense meshes behind the grid, the outer ones partly out of view
+	m_DenseObjectStart = static_cast<uint32_t>(m_ObjectWorldMatrices.size());
+	if (m_MeshletsReady)
+	{
+		const float denseMeshX[]{ -12.f, -4.f, 4.f, 12.f };
+		for (const float x : denseMeshX)
+		{
+			const Matrix worldMatrix = MatrixTranslation(x, 0.f, layerCount * layerDistance + 2.f);
+
+			Float4x4 storedMatrix{};
+			StoreFloat4x4(&storedMatrix, worldMatrix);
+			m_ObjectWorldMatrices.push_back(storedMatrix);
+
+			Float4 sphere{};
+			StoreFloat4(&sphere, Vector3TransformCoord(LoadFloat4(&m_DenseMeshBoundingSphere), worldMatrix));
+			sphere.w = m_DenseMeshBoundingSphere.w;
+			m_ObjectSpheres.push_back(sphere);
+		}
+	}
+
+	m_ViewCuller.SetObjects(m_ObjectSpheres);
+	m_ShadowCuller.SetObjects(m_ObjectSpheres);
+	BuildObjectHierarchy();
+
+	// One constant slot per object, only the fallback path updates per draw
+	if (!m_pDevice->GetFeatures().constantBufferOffsets) return true;
+
+	const uint32_t objectCount{ static_cast<uint32_t>(m_ObjectWorldMatrices.size()) };
+	std::vector<char> slots(static_cast<size_t>(objectCount) * g_ConstantSlotSize);
+
+	for (uint32_t objectIndex{}; objectIndex < objectCount; ++objectIndex)
+	{
+		// HLSL reads matrices column major
+		CB_BaseVertex* pSlot = reinterpret_cast<CB_BaseVertex*>(slots.data() + static_cast<size_t>(objectIndex) * g_ConstantSlotSize);
+		StoreFloat4x4(&pSlot->worldMatrix, MatrixTranspose(LoadFloat4x4(&m_ObjectWorldMatrices[objectIndex])));
+	}
+
+	if (m_ObjectConstantBatch.IsValid()) m_pDevice->DestroyBuffer(m_ObjectConstantBatch);
+	m_ObjectConstantBatch = m_pDevice->CreateBuffer(BufferDescription{ BufferType::Constant, BufferUsage::Default, static_cast<uint32_t>(slots.size()), 0 }, slots.data());
+
+	return m_ObjectConstantBatch.IsValid();
+}
+void Renderer::BuildObjectHierarchy()
+{
+	// Boxes around the bounding spheres, rebuilt whenever the objects are
+	std::vector<BoundingVolumeHierarchy::Bounds> objectBounds(m_ObjectSpheres.size());
+	for (size_t objectIndex{}; objectIndex < m_ObjectSpheres.size(); ++objectIndex)
+	{
+		const math::Float4& sphere = m_ObjectSpheres[objectIndex];
+		objectBounds[objectIndex] = BoundingVolumeHierarchy::Bounds{ math::Float3{ sphere.x - sphere.w, sphere.y - sphere.w, sphere.z - sphere.w },
+			math::Float3{ sphere.x + sphere.w, sphere.y + sphere.w, sphere.z + sphere.w } };
+	}
+
+	m_ObjectHierarchy.Build(objectBounds);
 }
 void Renderer::CreateViewProjectionMatrix()
 {
-	using namespace DirectX;
+	using namespace math;
+
+	// Views cover the part of the targets drawn at render resolution
+	const float width{ static_cast<float>(m_pDevice->GetRenderWidth()) };
+	const float height{ static_cast<float>(m_pDevice->GetRenderHeight()) };
+
+	// Create views
+	const Float3 cameraForward{ 0.f, 0.f, 1.f };
+	const Float3 cameraUp{ 0.f, 1.f, 0.f };
+	const float fovRadians{ ConvertToRadians(m_FieldOfView) };
+
+	m_Views.clear();
+	switch (m_ViewMode)
+	{
+	case ViewMode::Single:
+		m_Views.push_back(RenderView::CreatePerspective(m_CameraPos, cameraForward, cameraUp, fovRadians, m_NearZ, m_FarZ, Float4{ 0.f, 0.f, width, height }));
+		break;
+
+	case ViewMode::SplitScreen:
+	{
+		// Second player stands a bit to the right of the first one
+		const Float3 secondCameraPos{ m_CameraPos.x + 3.f, m_CameraPos.y, m_CameraPos.z };
+		m_Views.push_back(RenderView::CreatePerspective(m_CameraPos, cameraForward, cameraUp, fovRadians, m_NearZ, m_FarZ, Float4{ 0.f, 0.f, width * 0.5f, height }));
+		m_Views.push_back(RenderView::CreatePerspective(secondCameraPos, cameraForward, cameraUp, fovRadians, m_NearZ, m_FarZ, Float4{ width * 0.5f, 0.f, width * 0.5f, height }));
+	}
+	break;
+
+	case ViewMode::Cubemap:
+	{
+		const std::array<RenderView, 6> faces{ RenderView::CreateCubemap(m_CameraPos, m_NearZ, m_FarZ, Float4{ 0.f, 0.f, width, height }) };
+		m_Views.assign(faces.begin(), faces.end());
+	}
+	break;
+	}
+
+	// Light clusters follow every view frustum
+	while (m_LightClusters.size() < m_Views.size())
+	{
+		m_LightClusters.push_back(std::make_unique<LightClusterGrid>());
+	}
+
+	for (size_t viewIndex{}; viewIndex < m_Views.size(); ++viewIndex)
+	{
+		const RenderView& view = m_Views[viewIndex];
+		m_LightClusters[viewIndex]->SetProjection(view.fovRadians, view.aspectRatio, view.nearZ, view.farZ);
+	}
+}
+void Renderer::UpdateRenderResolution()
+{
+	if (!m_DynamicResolution) return;
+
+	// GPU time of a frame a few frames back, the controller ignores the frames right after a change
+	const float scale{ m_ResolutionController.Update(m_pDevice->GetFrameStatistics().gpuMs) };
+	m_pCounters->Set(m_RenderScaleGauge, std::lround(scale * 100.f));
+
+	const uint32_t width{ static_cast<uint32_t>((std::max)(std::lround(m_pDevice->GetBackBufferWidth() * scale), 1L)) };
+	const uint32_t height{ static_cast<uint32_t>((std::max)(std::lround(m_pDevice->GetBackBufferHeight() * scale), 1L)) };
+	if (width != m_pDevice->GetRenderWidth() || height != m_pDevice->GetRenderHeight()) m_pDevice->SetRenderResolution(width, height);
+}
+
+const RenderView& Renderer::GetView(uint32_t viewIndex) const
+{
+	if (viewIndex < m_Views.size()) return m_Views[viewIndex];
+	return m_ShadowCascades.GetViews()[viewIndex - m_Views.size()];
+}
+const std::vector<uint32_t>& Renderer::GetVisibleObjects(uint32_t viewIndex) const
+{
+	if (viewIndex < m_Views.size()) return m_ViewCuller.GetVisibleObjects(viewIndex);
+	return m_ShadowCuller.GetVisibleObjects(viewIndex - static_cast<uint32_t>(m_Views.size()));
+}
+uint32_t Renderer::GetViewCount() const
+{
+	const size_t cameraViewCount{ (std::min)(m_Views.size(), static_cast<size_t>(MultiViewCuller::g_MaxViews)) };
+	if (!m_ShadowsReady || !m_ShadowsEnabled) return static_cast<uint32_t>(cameraViewCount);
+
+	// Cascades start right after the camera views, there are never more camera views than the culler takes
+	return static_cast<uint32_t>(m_Views.size() + m_ShadowCascades.GetViews().size());
+}
+
+bool Renderer::CreateViewConstants()
+{
+	// Fallback buffers, updated before every view or draw
+	m_ViewConstantBuffer = m_pDevice->CreateBuffer(BufferDescription{ BufferType::Constant, BufferUsage::Default, sizeof(CB_View), 0 }, nullptr);
+	if (!m_ViewConstantBuffer.IsValid()) return false;
+
+	if (!m_pDevice->GetFeatures().constantBufferOffsets) return true;
+
+	// Batched buffer, one slot per view and shadow cascade
+	m_ViewConstantBatch = m_pDevice->CreateBuffer(BufferDescription{ BufferType::Constant, BufferUsage::Dynamic, g_ConstantSlotSize * g_MaxViewSlots, 0 }, nullptr);
+	return m_ViewConstantBatch.IsValid();
+}
+void Renderer::UploadViewConstants()
+{
+	if (!m_pDevice->GetFeatures().constantBufferOffsets) return;
+
+	// Every view and shadow cascade in one upload
+	const uint32_t viewCount{ GetViewCount() };
+	for (uint32_t viewIndex{}; viewIndex < viewCount; ++viewIndex)
+	{
+		const RenderView& view = GetView(viewIndex);
+
+		CB_View* pSlot = reinterpret_cast<CB_View*>(m_ViewConstantSlots.data() + viewIndex * g_ConstantSlotSize);
+		math::StoreFloat4x4(&pSlot->viewProjection, math::MatrixTranspose(math::LoadFloat4x4(&view.viewProjectionMatrix)));
+		pSlot->cameraPosition = math::Float4{ view.position.x, view.position.y, view.position.z, 1.f };
+	}
+
+	m_pDevice->UpdateBuffer(m_ViewConstantBatch, m_ViewConstantSlots.data(), viewCount * g_ConstantSlotSize);
+}
+void Renderer::BindViewConstants(CommandRecorder& recorder, uint32_t viewIndex)
+{
+	// Batched, only move the window
+	if (m_pDevice->GetFeatures().constantBufferOffsets)
+	{
+		const uint32_t firstConstant{ viewIndex * g_ConstantSlotSize / 16 };
+		const uint32_t constantCount{ g_ConstantSlotSize / 16 };
+		recorder.SetConstantBuffer(ShaderStage::Vertex, 1, m_ViewConstantBatch, firstConstant, constantCount);
+		return;
+	}
+
+	// Fallback, immediate only
+	const RenderView& view = GetView(viewIndex);
+	math::StoreFloat4x4(&m_ViewConstants.viewProjection, math::MatrixTranspose(math::LoadFloat4x4(&view.viewProjectionMatrix)));
+	m_ViewConstants.cameraPosition = math::Float4{ view.position.x, view.position.y, view.position.z, 1.f };
+
+	m_pDevice->UpdateBuffer(m_ViewConstantBuffer, &m_ViewConstants, sizeof(CB_View));
+	recorder.SetConstantBuffer(ShaderStage::Vertex, 1, m_ViewConstantBuffer);
+}
+void Renderer::BindObjectConstants(CommandRecorder& recorder, uint32_t objectIndex)
+{
+	// Batched, only move the window
+	if (m_pDevice->GetFeatures().constantBufferOffsets)
+	{
+		const uint32_t firstConstant{ objectIndex * g_ConstantSlotSize / 16 };
+		const uint32_t constantCount{ g_ConstantSlotSize / 16 };
+		recorder.SetConstantBuffer(ShaderStage::Vertex, 0, m_ObjectConstantBatch, firstConstant, constantCount);
+		return;
+	}
+
+	// Fallback, immediate only
+	math::StoreFloat4x4(&m_VertexConstantBuffer.worldMatrix, math::MatrixTranspose(math::LoadFloat4x4(&m_ObjectWorldMatrices[objectIndex])));
+
+	m_pDevice->UpdateBuffer(m_ConstantBuffer, &m_VertexConstantBuffer, sizeof(CB_BaseVertex));
+	recorder.SetConstantBuffer(ShaderStage::Vertex, 0, m_ConstantBuffer);
+}
 
-	// Create world matrix
-	const XMMATRIX translation = XMMatrixTranslation(0.f, 0.f, 0.f);
-	const XMMATRIX rotation = XMMatrixRotationRollPitchYaw(0.f, 0.f, 0.f);	// In radians
-	const XMMATRIX scale = XMMatrixScaling(1.f, 1.f, 1.f);
+void Renderer::BindViewState(CommandRecorder& recorder, uint32_t viewIndex)
+{
+	const RenderView& view = GetView(viewIndex);
+	const bool isShadowCascade{ viewIndex >= m_Views.size() };
 
-	const XMMATRIX worldMatrix = scale * rotation * translation;
-	XMStoreFloat4x4(&m_VertexConstantBuffer.worldMatrix, worldMatrix);
+	recorder.SetInputLayout(m_InputLayout);
 
-	// Create view matrix
-	const XMFLOAT3 cameraForward{ 0.f, 0.f, 1.f };
-	const XMFLOAT3 cameraUp{ 0.f, 1.f, 0.f };
+	// Set up the fixed-function stages, casters are biased and drawn from both sides
+	recorder.SetPipelineState(isShadowCascade ? m_ShadowPipelineState : m_PipelineState);
+	recorder.SetViewport(Viewport{ view.viewportRect.x, view.viewportRect.y, view.viewportRect.z, view.viewportRect.w });
 
-	const XMVECTOR worldPos = XMLoadFloat3(&m_CameraPos);
-	const XMVECTOR worldForward = XMLoadFloat3(&cameraForward);
-	const XMVECTOR worldUp = XMLoadFloat3(&cameraUp);
+	// Set up the shader stages
+	recorder.SetVertexShader(m_VertexShader);
+	BindViewConstants(recorder, viewIndex);
 
-	const XMMATRIX viewMatrix = XMMatrixLookToLH(worldPos, worldForward, worldUp);
+	// Depth only, the pass started without a pixelShader
+	if (isShadowCascade) return;
 
-	// Create projection matrix
-	const float aspectRatioX = static_cast<float>(m_BackBufferDescription.Width) / m_BackBufferDescription.Height;
-	const float FOV{ 45.f };
-	const float nearZ{ 0.1f };
-	const float farZ{ 100.f };
-	const XMMATRIX projectionMatrix = XMMatrixPerspectiveFovLH(XMConvertToRadians(FOV), aspectRatioX, nearZ, farZ);
+	const bool isShadowed{ m_ShadowsReady && m_ShadowsEnabled };
+	if (isShadowed)
+	{
+		recorder.SetConstantBuffer(ShaderStage::Pixel, 2, m_ShadowConstantBuffer);
+		recorder.SetShaderViews(ShaderStage::Pixel, 3, 1, &m_ShadowMapView);
+	}
 
-	// Store WVP matrix
-	const XMMATRIX WVPMatrix = worldMatrix * viewMatrix * projectionMatrix;
-	XMStoreFloat4x4(&m_VertexConstantBuffer.worldViewProjection, WVPMatrix);
-}
\ No newline at end of file
+	if (m_ClusteredLightingReady)
+	{
+		const ShaderViewHandle shaderViews[] = { m_LightView, m_ClusterRangeView, m_LightIndexView };
+		recorder.SetPixelShader(isShadowed ? m_ShadowedClusteredPixelShader : m_ClusteredPixelShader);
+		recorder.SetConstantBuffer(ShaderStage::Pixel, 1, m_ClusterConstantBuffer);
+		recorder.SetShaderViews(ShaderStage::Pixel, 0, ARRAYSIZE(shaderViews), shaderViews);
+	}
+	else
+	{
+		recorder.SetPixelShader(isShadowed ? m_ShadowedPixelShader : m_PixelShader);
+	}
+}
+void Renderer::RecordDraws(CommandRecorder& recorder, uint32_t viewIndex, const uint32_t* pObjects, size_t objectCount)
+{
+	if (objectCount == 0) return;
+
+	// Everything is bound again, a recorded list starts without state
+	// Set up the IA stage by setting the vertex- and indexBuffer
+	const uint32_t stride{ sizeof(BaseVertexInput) };
+	recorder.SetVertexBuffers(0, 1, &m_VertexBuffer, &stride);
+	recorder.SetIndexBuffer(m_IndexBuffer, ElementFormat::R16_UInt);
+	BindViewState(recorder, viewIndex);
+
+	for (size_t index{}; index < objectCount; ++index)
+	{
+		BindObjectConstants(recorder, pObjects[index]);
+
+		recorder.DrawIndexed
+		(
+			m_IndexCount,	// IndexCount
+			0,				// Start index
+			0				// Base vertexLocation
+		);
+	}
+}
+uint32_t Renderer::RecordDrawsInParallel(uint32_t viewIndex, const uint32_t* pObjects, size_t objectCount, uint32_t workerCount)
+{
+	if (objectCount == 0) return 0;
+
+	// Contiguous ranges, a list needs enough draws to be worth its setup
+	const uint32_t listCount{ static_cast<uint32_t>(std::clamp<size_t>(objectCount / g_MinDrawsPerList, 1, workerCount)) };
+	m_pCounters->Add(m_JobQueueGauge, listCount);
+
+	Concurrency::parallel_for(0u, listCount, [&](uint32_t listIndex)
+	{
+		const size_t firstObject{ objectCount * listIndex / listCount };
+		const size_t lastObject{ objectCount * (listIndex + 1) / listCount };
+
+		CommandRecorder& recorder = m_pDevice->BeginRecording(listIndex);
+		RecordDraws(recorder, viewIndex, pObjects + firstObject, lastObject - firstObject);
+		m_pDevice->EndRecording(listIndex);
+		m_pCounters->Add(m_JobQueueGauge, -1);
+	});
+
+	return listCount;
+}
+void Renderer::BenchmarkRecording()
+{
+	const uint32_t maxWorkers{ m_pDevice->GetRecorderCount() };
+	if (maxWorkers == 0 || !m_pDevice->GetFeatures().constantBufferOffsets || m_Views.empty())
+	{
+		Logger::Log(L"Parallel recording is not available on this device");
+		return;
+	}
+
+	// Every object a few times over, so there are thousands of draws to split
+	std::vector<uint32_t> objects;
+	for (uint32_t repeat{}; repeat < g_BenchmarkRepeats; ++repeat)
+	{
+		for (uint32_t objectIndex{}; objectIndex < m_DenseObjectStart; ++objectIndex) objects.push_back(objectIndex);
+	}
+
+	// Recorded lists are dropped by the next recording, nothing is executed
+	double singleWorkerMs{};
+	for (uint32_t workerCount{ 1 }; ; workerCount = (std::min)(workerCount * 2, maxWorkers))
+	{
+		RecordDrawsInParallel(0, objects.data(), objects.size(), workerCount);
+
+		const std::chrono::steady_clock::time_point start{ std::chrono::steady_clock::now() };
+		for (uint32_t iteration{}; iteration < g_BenchmarkIterations; ++iteration)
+		{
+			RecordDrawsInParallel(0, objects.data(), objects.size(), workerCount);
+		}
+		const double recordMs{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / g_BenchmarkIterations };
+		if (workerCount == 1) singleWorkerMs = recordMs;
+
+		std::wstringstream message;
+		message << L"Recording benchmark: " << objects.size() << L" draws on " << workerCount << L" workers, "
+			<< recordMs << L" ms (" << (recordMs > 0.0 ? singleWorkerMs / recordMs : 0.0) << L"x)";
+		Logger::Log(message.str());
+
+		if (workerCount == maxWorkers) break;
+	}
+}
+
+void Renderer::CullMeshlets()
+{
+	m_MeshletCuller.Begin();
+	m_MeshletDraws.resize(GetViewCount());
+
+	// Only the dense objects that survived the object culling, of the views and the shadow cascades
+	for (uint32_t viewIndex{}; viewIndex < m_MeshletDraws.size(); ++viewIndex)
+	{
+		const std::vector<uint32_t>& visibleObjects = GetVisibleObjects(viewIndex);
+		m_MeshletDraws[viewIndex].clear();
+
+		for (auto it = std::lower_bound(visibleObjects.begin(), visibleObjects.end(), m_DenseObjectStart); it != visibleObjects.end(); ++it)
+		{
+			const MeshletCuller::DrawRange range{ m_MeshletCuller.Cull(*it, m_ObjectWorldMatrices[*it], GetView(viewIndex)) };
+			if (range.indexCount > 0) m_MeshletDraws[viewIndex].push_back(range);
+		}
+	}
+
+	const std::vector<uint32_t>& indices = m_MeshletCuller.GetIndices();
+	if (indices.empty()) return;
+
+	// Grows to the worst frame seen so far
+	const uint32_t indexCount{ static_cast<uint32_t>(indices.size()) };
+	if (indexCount > m_MeshletIndexCapacity)
+	{
+		if (m_MeshletIndexBuffer.IsValid()) m_pDevice->DestroyBuffer(m_MeshletIndexBuffer);
+
+		const uint32_t capacity{ (std::max)(indexCount, m_MeshletCuller.GetMeshIndexCount()) };
+		m_MeshletIndexBuffer = m_pDevice->CreateBuffer(BufferDescription{ BufferType::Index, BufferUsage::Dynamic, capacity * static_cast<uint32_t>(sizeof(uint32_t)), 0 }, nullptr);
+		if (!m_MeshletIndexBuffer.IsValid())
+		{
+			Logger::Log(L"ERROR - Failed to create the meshlet indexBuffer");
+			m_MeshletIndexCapacity = 0;
+			m_MeshletsReady = false;
+			return;
+		}
+		m_MeshletIndexCapacity = capacity;
+	}
+
+	// Every view in one upload
+	m_pDevice->UpdateBuffer(m_MeshletIndexBuffer, indices.data(), indexCount * static_cast<uint32_t>(sizeof(uint32_t)));
+}
+void Renderer::RecordMeshletDraws(CommandRecorder& recorder, uint32_t viewIndex)
+{
+	if (viewIndex >= m_MeshletDraws.size() || m_MeshletDraws[viewIndex].empty()) return;
+
+	const uint32_t stride{ sizeof(BaseVertexInput) };
+	recorder.SetVertexBuffers(0, 1, &m_DenseVertexBuffer, &stride);
+	recorder.SetIndexBuffer(m_MeshletIndexBuffer, ElementFormat::R32_UInt);
+	BindViewState(recorder, viewIndex);
+
+	for (const MeshletCuller::DrawRange& range : m_MeshletDraws[viewIndex])
+	{
+		BindObjectConstants(recorder, range.objectIndex);
+		recorder.DrawIndexed(range.indexCount, range.firstIndex, 0);
+	}
+}
+
+void Renderer::CreateLights()
+{
+	const size_t lightCount{ 1024 };
+
+	std::mt19937 randomEngine{ 1337 };	// Fixed seed, same scene every run
+	std::uniform_real_distribution<float> positionXY{ -4.f, 4.f };
+	std::uniform_real_distribution<float> positionZ{ -3.f, 20.f };
+	std::uniform_real_distribution<float> range{ 0.5f, 2.f };
+	std::uniform_real_distribution<float> color{ 0.2f, 1.f };
+
+	m_Lights.resize(lightCount);
+	for (size_t index{}; index < lightCount; ++index)
+	{
+		LightClusterGrid::Light& light = m_Lights[index];
+		light.position = math::Float3{ positionXY(randomEngine), positionXY(randomEngine), positionZ(randomEngine) };
+		light.range = range(randomEngine);
+		light.color = math::Float3{ color(randomEngine), color(randomEngine), color(randomEngine) };
+
+		// Every fourth light is a spot light looking down the scene
+		if (index % 4 == 0)
+		{
+			light.direction = math::Float3{ 0.f, 0.f, 1.f };
+			light.spotCosOuter = cosf(math::ConvertToRadians(35.f));
+			light.spotCosInner = cosf(math::ConvertToRadians(25.f));
+		}
+		else
+		{
+			light.direction = math::Float3{};
+			light.spotCosOuter = -2.f;
+			light.spotCosInner = -2.f;
+		}
+	}
+}
+void Renderer::CreateClusteredLighting()
+{
+	// Structured buffers in the pixelShader need feature level 11
+	if (!m_pDevice->GetFeatures().structuredBuffers || m_Lights.empty())
+	{
+		Logger::Log(L"Clustered lighting is not supported, falling back to the unlit pixelShader");
+		return;
+	}
+
+	// PixelShader
+	// -----------
+
+	const std::wstring pixelShaderName{ m_ShaderPermutations.GetVariantName(m_SurfacePixelShader, g_ClusteredLightingFeature) };
+	const std::vector<char>* pPixelShaderBytes{ m_ShaderPermutations.GetBytecode(m_SurfacePixelShader, g_ClusteredLightingFeature) };
+	if (!pPixelShaderBytes)
+	{
+		Logger::Log(L"ERROR - Failed to compile the clustered pixelShader");
+		return;
+	}
+
+	m_ClusteredPixelShader = m_pDevice->CreatePixelShader(pixelShaderName, *pPixelShaderBytes);
+	if (!m_ClusteredPixelShader.IsValid())
+	{
+		Logger::Log(L"ERROR - Failed to create the clustered pixelShader");
+		return;
+	}
+
+	// ConstantBuffer
+	// --------------
+
+	m_ClusterConstantBuffer = m_pDevice->CreateBuffer(BufferDescription{ BufferType::Constant, BufferUsage::Default, sizeof(CB_Clusters), 0 }, nullptr);
+	if (!m_ClusterConstantBuffer.IsValid())
+	{
+		Logger::Log(L"ERROR - Failed to create the cluster constantBuffer");
+		return;
+	}
+
+	// Light buffer
+	// ------------
+
+	const BufferDescription lightDescription
+	{
+		BufferType::ShaderResource,													// Read in the pixelShader
+		BufferUsage::Dynamic,														// Rewritten every frame
+		static_cast<uint32_t>(sizeof(LightClusterGrid::Light) * m_Lights.size()),	// Size
+		sizeof(LightClusterGrid::Light)												// Element stride
+	};
+
+	m_LightBuffer = m_pDevice->CreateBuffer(lightDescription, nullptr);
+	if (m_LightBuffer.IsValid())
+	{
+		m_LightView = m_pDevice->CreateShaderView(m_LightBuffer, ElementFormat::Unknown, static_cast<uint32_t>(m_Lights.size()));
+	}
+
+	if (!m_LightView.IsValid())
+	{
+		Logger::Log(L"ERROR - Failed to create the light buffer");
+		return;
+	}
+
+	// Cluster range buffer
+	// --------------------
+
+	const BufferDescription rangeDescription
+	{
+		BufferType::ShaderResource,
+		BufferUsage::Dynamic,
+		sizeof(LightClusterGrid::ClusterRange) * LightClusterGrid::g_ClusterCount,
+		0
+	};
+
+	m_ClusterRangeBuffer = m_pDevice->CreateBuffer(rangeDescription, nullptr);
+	if (m_ClusterRangeBuffer.IsValid())
+	{
+		m_ClusterRangeView = m_pDevice->CreateShaderView(m_ClusterRangeBuffer, ElementFormat::R32G32_UInt, LightClusterGrid::g_ClusterCount);
+	}
+
+	if (!m_ClusterRangeView.IsValid())
+	{
+		Logger::Log(L"ERROR - Failed to create the cluster range buffer");
+		return;
+	}
+
+	// Light index buffer, grows when needed
+	// -------------------------------------
+
+	if (!CreateLightIndexBuffer(LightClusterGrid::g_ClusterCount * 8)) return;
+
+	m_ClusteredLightingReady = true;
+}
+bool Renderer::CreateLightIndexBuffer(uint32_t capacity)
+{
+	if (m_LightIndexView.IsValid()) m_pDevice->DestroyShaderView(m_LightIndexView);
+	if (m_LightIndexBuffer.IsValid()) m_pDevice->DestroyBuffer(m_LightIndexBuffer);
+
+	m_LightIndexView = ShaderViewHandle{};
+	m_LightIndexCapacity = 0;
+
+	const BufferDescription indexDescription
+	{
+		BufferType::ShaderResource,
+		BufferUsage::Dynamic,
+		static_cast<uint32_t>(sizeof(uint32_t) * capacity),
+		0
+	};
+
+	m_LightIndexBuffer = m_pDevice->CreateBuffer(indexDescription, nullptr);
+	if (m_LightIndexBuffer.IsValid())
+	{
+		m_LightIndexView = m_pDevice->CreateShaderView(m_LightIndexBuffer, ElementFormat::R32_UInt, capacity);
+	}
+
+	if (!m_LightIndexView.IsValid())
+	{
+		Logger::Log(L"ERROR - Failed to create the light index buffer");
+		return false;
+	}
+
+	m_LightIndexCapacity = capacity;
+	return true;
+}
+void Renderer::UploadLights()
+{
+	// Shared by every view
+	m_pDevice->UpdateBuffer(m_LightBuffer, m_Lights.data(), static_cast<uint32_t>(sizeof(LightClusterGrid::Light) * m_Lights.size()));
+}
+void Renderer::UpdateClusteredLighting(uint32_t viewIndex)
+{
+	const RenderView& view = m_Views[viewIndex];
+	LightClusterGrid& lightClusters = *m_LightClusters[viewIndex];
+
+	// Assign lights to the clusters of this view
+	lightClusters.AssignLights(m_Lights, view.viewMatrix);
+
+	const std::vector<LightClusterGrid::ClusterRange>& clusterRanges = lightClusters.GetClusterRanges();
+	const std::vector<uint32_t>& lightIndices = lightClusters.GetLightIndices();
+
+	// Grow the index list when it doesn't fit anymore
+	const uint32_t indexCount{ static_cast<uint32_t>(lightIndices.size()) };
+	if (indexCount > m_LightIndexCapacity && !CreateLightIndexBuffer((std::max)(indexCount, m_LightIndexCapacity * 2)))
+	{
+		m_ClusteredLightingReady = false;
+		return;
+	}
+
+	// Upload, every buffer is fully rewritten so the old contents can be discarded
+	m_pDevice->UpdateBuffer(m_ClusterRangeBuffer, clusterRanges.data(), static_cast<uint32_t>(sizeof(LightClusterGrid::ClusterRange) * clusterRanges.size()));
+	m_pDevice->UpdateBuffer(m_LightIndexBuffer, lightIndices.data(), static_cast<uint32_t>(sizeof(uint32_t) * lightIndices.size()));
+
+	// Cluster lookup constants
+	m_ClusterConstants.clusterCount = math::UInt4{ LightClusterGrid::g_ClustersX, LightClusterGrid::g_ClustersY, LightClusterGrid::g_ClustersZ, 0 };
+	m_ClusterConstants.clusterParams = math::Float4
+	{
+		LightClusterGrid::g_ClustersX / view.viewportRect.z,
+		LightClusterGrid::g_ClustersY / view.viewportRect.w,
+		lightClusters.GetSliceScale(),
+		lightClusters.GetSliceBias()
+	};
+	m_ClusterConstants.viewportOffset = math::Float4{ view.viewportRect.x, view.viewportRect.y, 0.f, 0.f };
+
+	m_pDevice->UpdateBuffer(m_ClusterConstantBuffer, &m_ClusterConstants, sizeof(CB_Clusters));
+}
+
+void Renderer::CreateShadows()
+{
+	// PixelShaders
+	// ------------
+
+	const std::wstring pixelShaderName{ m_ShaderPermutations.GetVariantName(m_SurfacePixelShader, g_ShadowsFeature) };
+	const std::vector<char>* pPixelShaderBytes{ m_ShaderPermutations.GetBytecode(m_SurfacePixelShader, g_ShadowsFeature) };
+	if (!pPixelShaderBytes)
+	{
+		Logger::Log(L"ERROR - Failed to compile the shadowed pixelShader");
+		return;
+	}
+
+	m_ShadowedPixelShader = m_pDevice->CreatePixelShader(pixelShaderName, *pPixelShaderBytes);
+	if (!m_ShadowedPixelShader.IsValid())
+	{
+		Logger::Log(L"ERROR - Failed to create the shadowed pixelShader");
+		return;
+	}
+
+	// Shadows on top of the clustered lights, when those are there
+	if (m_ClusteredLightingReady)
+	{
+		const uint32_t features{ g_ClusteredLightingFeature | g_ShadowsFeature };
+		const std::vector<char>* pClusteredBytes{ m_ShaderPermutations.GetBytecode(m_SurfacePixelShader, features) };
+		if (pClusteredBytes) m_ShadowedClusteredPixelShader = m_pDevice->CreatePixelShader(m_ShaderPermutations.GetVariantName(m_SurfacePixelShader, features), *pClusteredBytes);
+
+		if (!m_ShadowedClusteredPixelShader.IsValid())
+		{
+			Logger::Log(L"ERROR - Failed to create the shadowed clustered pixelShader");
+			return;
+		}
+	}
+
+	// Fixed-function states
+	// ---------------------
+
+	// The scene triangles are one sided, but they cast from both sides
+	const PipelineStateDescription casterDescription{ CullMode::None, true, true, BlendMode::Opaque, ShadowCascades::g_DepthBias, ShadowCascades::g_SlopeScaledDepthBias };
+	m_ShadowPipelineState = m_pDevice->CreatePipelineState(casterDescription);
+	if (!m_ShadowPipelineState.IsValid())
+	{
+		Logger::Log(L"ERROR - Failed to create the shadow caster states");
+		return;
+	}
+
+	// ConstantBuffer
+	// --------------
+
+	m_ShadowConstantBuffer = m_pDevice->CreateBuffer(BufferDescription{ BufferType::Constant, BufferUsage::Default, sizeof(CB_Shadows), 0 }, nullptr);
+	if (!m_ShadowConstantBuffer.IsValid())
+	{
+		Logger::Log(L"ERROR - Failed to create the shadow constantBuffer");
+		return;
+	}
+
+	// Shadow map, one slice per cascade
+	// ---------------------------------
+
+	const ShadowCascades::Settings& settings = m_ShadowCascades.GetSettings();
+	m_ShadowMap = m_pDevice->CreateDepthTarget(DepthTargetDescription{ settings.resolution, settings.resolution, settings.cascadeCount });
+	if (m_ShadowMap.IsValid())
+	{
+		m_ShadowMapView = m_pDevice->CreateDepthShaderView(m_ShadowMap);
+	}
+
+	if (!m_ShadowMapView.IsValid())
+	{
+		Logger::Log(L"ERROR - Failed to create the shadow map");
+		return;
+	}
+
+	m_ShadowsReady = true;
+}
+void Renderer::UpdateShadows()
+{
+	using namespace math;
+
+	// Fitted to the first view, the other views read the same cascades
+	m_ShadowCascades.Update(m_Views.front(), m_SunDirection, m_ObjectHierarchy.GetBounds());
+	m_ShadowCuller.Cull(m_ShadowCascades.GetViews());
+
+	const std::vector<RenderView>& cascadeViews = m_ShadowCascades.GetViews();
+	const std::vector<ShadowCascades::Cascade>& cascades = m_ShadowCascades.GetCascades();
+
+	// Unused splits stay at 0, the pixelShader never gets past the cascade count
+	float cascadeSplits[ShadowCascades::g_MaxCascades]{};
+	for (size_t cascadeIndex{}; cascadeIndex < cascades.size(); ++cascadeIndex)
+	{
+		StoreFloat4x4(&m_ShadowConstants.cascadeViewProjections[cascadeIndex], MatrixTranspose(LoadFloat4x4(&cascadeViews[cascadeIndex].viewProjectionMatrix)));
+		cascadeSplits[cascadeIndex] = cascades[cascadeIndex].farDepth;
+	}
+
+	m_ShadowConstants.cascadeSplits = Float4{ cascadeSplits[0], cascadeSplits[1], cascadeSplits[2], cascadeSplits[3] };
+	m_ShadowConstants.sunDirection = Float4{ -m_SunDirection.x, -m_SunDirection.y, -m_SunDirection.z, 0.f };
+	m_ShadowConstants.sunColor = Float4{ 1.f, 0.95f, 0.85f, static_cast<float>(cascades.size()) };
+	m_ShadowConstants.shadowParams = Float4{ 1.f / m_ShadowCascades.GetSettings().resolution, 0.f, 0.f, 0.f };
+
+	m_pDevice->UpdateBuffer(m_ShadowConstantBuffer, &m_ShadowConstants, sizeof(CB_Shadows));
+}
+void Renderer::RenderShadowMaps()
+{
+	// Immediate, a depth pass can't be split over recorded lists
+	for (uint32_t cascadeIndex{}; cascadeIndex < m_ShadowCascades.GetViews().size(); ++cascadeIndex)
+	{
+		const uint32_t viewIndex{ static_cast<uint32_t>(m_Views.size()) + cascadeIndex };
+
+		// Dense casters come last, they are drawn from their meshlets
+		const std::vector<uint32_t>& casters = GetVisibleObjects(viewIndex);
+		const size_t meshCasterCount{ static_cast<size_t>(std::lower_bound(casters.begin(), casters.end(), m_DenseObjectStart) - casters.begin()) };
+
+		m_pDevice->BeginDepthPass(m_ShadowMap, cascadeIndex);
+		RecordDraws(*m_pDevice, viewIndex, casters.data(), meshCasterCount);
+		if (m_MeshletsReady) RecordMeshletDraws(*m_pDevice, viewIndex);
+		if (m_CharactersReady) RecordCharacterDraws(*m_pDevice, viewIndex);
+		m_pDevice->EndDepthPass();
+	}
+}
+
+void Renderer::CreateParticles()
+{
+	using namespace math;
+
+	// Shaders
+	// -------
+
+	const std::wstring vertexShaderName{ L"Particle_VS.cso" };
+	const std::wstring pixelShaderName{ L"Particle_PS.cso" };
+	std::vector<char> vertexShaderBytes;
+	std::vector<char> pixelShaderBytes;
+
+	if (!m_Assets.Read(vertexShaderName, vertexShaderBytes)
+		|| !m_Assets.Read(pixelShaderName, pixelShaderBytes))
+	{
+		Logger::Log(L"ERROR - Failed to read the particle shaders");
+		return;
+	}
+
+	m_ParticleVertexShader = m_pDevice->CreateVertexShader(vertexShaderName, vertexShaderBytes);
+	m_ParticlePixelShader = m_pDevice->CreatePixelShader(pixelShaderName, pixelShaderBytes);
+	if (!m_ParticleVertexShader.IsValid() || !m_ParticlePixelShader.IsValid())
+	{
+		Logger::Log(L"ERROR - Failed to create the particle shaders");
+		return;
+	}
+
+	// InputLayout, the quad per vertex and the particle per instance
+	// ----------------------------------------------------------------
+
+	const InputElement inputLayoutDescription[] =
+	{
+		{ "POSITION", 0, ElementFormat::R32G32B32_Float, 0, false },
+		{ "NORMAL", 0, ElementFormat::R32G32B32_Float, 0, false },
+		{ "TEXCOORD", 0, ElementFormat::R32G32_Float, 0, false },
+		{ "INSTANCE_POSITION", 0, ElementFormat::R32G32B32A32_Float, 1, true },
+		{ "INSTANCE_COLOR", 0, ElementFormat::R32G32B32A32_Float, 1, true }
+	};
+
+	m_ParticleInputLayout = m_pDevice->CreateInputLayout
+	(
+		inputLayoutDescription,
+		ARRAYSIZE(inputLayoutDescription),
+		vertexShaderName,
+		vertexShaderBytes
+	);
+
+	if (!m_ParticleInputLayout.IsValid())
+	{
+		Logger::Log(L"ERROR - Failed to create the particle inputLayout");
+		return;
+	}
+
+	// Fixed-function states, alpha blended and depth tested without writing
+	// ---------------------------------------------------------------------
+
+	m_ParticlePipelineState = m_pDevice->CreatePipelineState(PipelineStateDescription{ CullMode::Back, true, false, BlendMode::AlphaBlend, 0, 0.f });
+	if (!m_ParticlePipelineState.IsValid())
+	{
+		Logger::Log(L"ERROR - Failed to create the particle pipeline states");
+		return;
+	}
+
+	// Buffers
+	// -------
+
+	// Unit quad, clockwise when facing the camera
+	const BaseVertexInput quadVertices[] =
+	{
+		{ Float3{ -0.5f,-0.5f, 0.f }, Float3{ 0.f, 0.f, -1.f }, Float2{ 0.f, 1.f } },
+		{ Float3{ -0.5f, 0.5f, 0.f }, Float3{ 0.f, 0.f, -1.f }, Float2{ 0.f, 0.f } },
+		{ Float3{  0.5f, 0.5f, 0.f }, Float3{ 0.f, 0.f, -1.f }, Float2{ 1.f, 0.f } },
+		{ Float3{  0.5f,-0.5f, 0.f }, Float3{ 0.f, 0.f, -1.f }, Float2{ 1.f, 1.f } }
+	};
+	const unsigned short quadIndices[]{ 0, 1, 2, 0, 2, 3 };
+
+	const BufferDescription instanceDescription
+	{
+		BufferType::Vertex,																// Read per instance
+		BufferUsage::Dynamic,															// Rewritten every frame
+		static_cast<uint32_t>(sizeof(ParticleSystem::Instance) * g_ParticleCapacity),	// Size
+		0
+	};
+
+	m_ParticleQuadVertexBuffer = m_pDevice->CreateBuffer(BufferDescription{ BufferType::Vertex, BufferUsage::Immutable, sizeof(quadVertices), 0 }, quadVertices);
+	m_ParticleQuadIndexBuffer = m_pDevice->CreateBuffer(BufferDescription{ BufferType::Index, BufferUsage::Immutable, sizeof(quadIndices), 0 }, quadIndices);
+	m_ParticleInstanceBuffer = m_pDevice->CreateBuffer(instanceDescription, nullptr);
+
+	if (!m_ParticleQuadVertexBuffer.IsValid() || !m_ParticleQuadIndexBuffer.IsValid() || !m_ParticleInstanceBuffer.IsValid())
+	{
+		Logger::Log(L"ERROR - Failed to create the particle buffers");
+		return;
+	}
+
+	// Emitter
+	// -------
+
+	// A fountain under the triangle grid, around 100k particles alive at once
+	ParticleSystem::EmitterSettings settings{};
+	settings.position = Float3{ 0.f, -8.f, 8.f };
+	settings.spawnRadius = 0.5f;
+	settings.velocity = Float3{ 0.f, 9.f, 0.f };
+	settings.velocityJitter = 2.5f;
+	settings.gravity = Float3{ 0.f, -6.f, 0.f };
+	settings.particlesPerSecond = 40000.f;
+	settings.minLifetime = 2.f;
+	settings.maxLifetime = 3.f;
+	settings.startSize = 0.08f;
+	settings.endSize = 0.02f;
+	settings.startColor = Float4{ 1.f, 0.8f, 0.3f, 0.8f };
+	settings.endColor = Float4{ 0.9f, 0.2f, 0.1f, 0.f };
+
+	m_Particles.SetEmitter(settings);
+	m_ParticlesReady = true;
+}
+void Renderer::RenderParticles()
+{
+	const std::vector<ParticleSystem::Instance>& instances = m_Particles.GetInstances();
+	if (instances.empty()) return;
+
+	// Upload the sorted instances once for every view
+	m_pDevice->UpdateBuffer(m_ParticleInstanceBuffer, instances.data(), static_cast<uint32_t>(sizeof(ParticleSystem::Instance) * instances.size()));
+
+	// Quad in slot 0, instances in slot 1
+	const BufferHandle vertexBuffers[] = { m_ParticleQuadVertexBuffer, m_ParticleInstanceBuffer };
+	const uint32_t strides[] = { sizeof(BaseVertexInput), sizeof(ParticleSystem::Instance) };
+
+	m_pDevice->SetVertexBuffers(0, ARRAYSIZE(vertexBuffers), vertexBuffers, strides);
+	m_pDevice->SetIndexBuffer(m_ParticleQuadIndexBuffer, ElementFormat::R16_UInt);
+	m_pDevice->SetInputLayout(m_ParticleInputLayout);
+
+	m_pDevice->SetPipelineState(m_ParticlePipelineState);
+
+	m_pDevice->SetVertexShader(m_ParticleVertexShader);
+	m_pDevice->SetPixelShader(m_ParticlePixelShader);
+
+	// Sorted for the first view, the other views accept a slightly wrong blend order
+	for (uint32_t viewIndex{}; viewIndex < m_Views.size() && viewIndex < MultiViewCuller::g_MaxViews; ++viewIndex)
+	{
+		const RenderView& view = m_Views[viewIndex];
+
+		m_pDevice->SetViewport(Viewport{ view.viewportRect.x, view.viewportRect.y, view.viewportRect.z, view.viewportRect.w });
+
+		BindViewConstants(*m_pDevice, viewIndex);
+
+		m_pDevice->DrawIndexedInstanced
+		(
+			6,											// Index count per instance
+			static_cast<uint32_t>(instances.size())		// Instance count
+		);
+	}
+}
+
+void Renderer::CreateCharacters()
+{
+	using namespace math;
+
+	// Shader and inputLayout
+	// ----------------------
+
+	const std::wstring vertexShaderName{ m_ShaderPermutations.GetVariantName(m_SurfaceVertexShader, g_SkinnedFeature) };
+	const std::vector<char>* pVertexShaderBytes{ m_ShaderPermutations.GetBytecode(m_SurfaceVertexShader, g_SkinnedFeature) };
+	if (!pVertexShaderBytes)
+	{
+		Logger::Log(L"ERROR - Failed to compile the skinned vertexShader");
+		return;
+	}
+
+	m_SkinnedVertexShader = m_pDevice->CreateVertexShader(vertexShaderName, *pVertexShaderBytes);
+	if (!m_SkinnedVertexShader.IsValid())
+	{
+		Logger::Log(L"ERROR - Failed to create the skinned vertexShader");
+		return;
+	}
+
+	const InputElement inputLayoutDescription[] =
+	{
+		{ "POSITION", 0, ElementFormat::R32G32B32_Float, 0, false },
+		{ "NORMAL", 0, ElementFormat::R32G32B32_Float, 0, false },
+		{ "TEXCOORD", 0, ElementFormat::R32G32_Float, 0, false },
+		{ "BLENDINDICES", 0, ElementFormat::R8G8B8A8_UInt, 0, false },
+		{ "BLENDWEIGHT", 0, ElementFormat::R32G32B32A32_Float, 0, false }
+	};
+
+	m_SkinnedInputLayout = m_pDevice->CreateInputLayout
+	(
+		inputLayoutDescription,
+		ARRAYSIZE(inputLayoutDescription),
+		vertexShaderName,
+		*pVertexShaderBytes
+	);
+
+	if (!m_SkinnedInputLayout.IsValid())
+	{
+		Logger::Log(L"ERROR - Failed to create the skinned inputLayout");
+		return;
+	}
+
+	// Skeleton, a chain of bones straight up from the root
+	// -----------------------------------------------------
+
+	std::vector<AnimationSystem::Bone> bones(g_CharacterBones);
+	for (uint32_t boneIndex{}; boneIndex < g_CharacterBones; ++boneIndex)
+	{
+		bones[boneIndex].parent = static_cast<int32_t>(boneIndex) - 1;
+		StoreFloat4x4(&bones[boneIndex].inverseBindMatrix, MatrixTranslation(0.f, -g_CharacterBoneLength * boneIndex, 0.f));
+	}
+
+	if (!m_Animation.SetSkeleton(bones))
+	{
+		Logger::Log(L"ERROR - Failed to create the character skeleton");
+		return;
+	}
+
+	// Mesh, a tapered tube around the chain, every ring skinned to the two closest bones
+	// -----------------------------------------------------------------------------------
+
+	const uint32_t ringCount{ g_CharacterBones * g_CharacterRingsPerBone + 1 };
+	const float height{ g_CharacterBones * g_CharacterBoneLength };
+
+	// Ring 0 is the top, like the dense mesh
+	std::vector<AnimationSystem::SkinnedVertex> vertices;
+	vertices.reserve(static_cast<size_t>(ringCount) * (g_CharacterSegments + 1));
+	for (uint32_t ring{}; ring < ringCount; ++ring)
+	{
+		const float y{ height * (ringCount - 1 - ring) / (ringCount - 1) };
+		const float radius{ g_CharacterRadius * (1.f - 0.7f * y / height) };
+
+		// Blends from the middle of one bone to the middle of the next
+		const float bonePosition{ (std::max)(y / g_CharacterBoneLength - 0.5f, 0.f) };
+		const uint32_t firstBone{ (std::min)(static_cast<uint32_t>(bonePosition), g_CharacterBones - 1) };
+		const uint32_t secondBone{ (std::min)(firstBone + 1, g_CharacterBones - 1) };
+		const float secondWeight{ (std::min)(bonePosition - firstBone, 1.f) };
+
+		for (uint32_t segment{}; segment <= g_CharacterSegments; ++segment)
+		{
+			const float phi{ g_2Pi * segment / g_CharacterSegments };
+
+			AnimationSystem::SkinnedVertex vertex{};
+			vertex.normal = Float3{ std::cos(phi), 0.f, std::sin(phi) };
+			vertex.position = Float3{ vertex.normal.x * radius, y, vertex.normal.z * radius };
+			vertex.uv = Float2{ static_cast<float>(segment) / g_CharacterSegments, static_cast<float>(ring) / (ringCount - 1) };
+			vertex.boneIndices[0] = static_cast<uint8_t>(firstBone);
+			vertex.boneIndices[1] = static_cast<uint8_t>(secondBone);
+			vertex.boneWeights = Float4{ 1.f - secondWeight, secondWeight, 0.f, 0.f };
+			vertices.push_back(vertex);
+		}
+	}
+
+	// Clockwise seen from outside
+	std::vector<uint16_t> indices;
+	indices.reserve(static_cast<size_t>(ringCount - 1) * g_CharacterSegments * 6);
+	for (uint32_t ring{}; ring < ringCount - 1; ++ring)
+	{
+		for (uint32_t segment{}; segment < g_CharacterSegments; ++segment)
+		{
+			const uint16_t topLeft{ static_cast<uint16_t>(ring * (g_CharacterSegments + 1) + segment) };
+			const uint16_t topRight{ static_cast<uint16_t>(topLeft + 1) };
+			const uint16_t bottomLeft{ static_cast<uint16_t>(topLeft + g_CharacterSegments + 1) };
+			const uint16_t bottomRight{ static_cast<uint16_t>(bottomLeft + 1) };
+
+			indices.insert(indices.end(), { topLeft, topRight, bottomLeft, topRight, bottomRight, bottomLeft });
+		}
+	}
+
+	if (!m_Animation.SetMesh(vertices))
+	{
+		Logger::Log(L"ERROR - Failed to create the character mesh");
+		return;
+	}
+
+	// Clips, a sway travelling up the chain and a curl, both looping over 2 seconds
+	// ------------------------------------------------------------------------------
+
+	const uint32_t frameCount{ 61 };
+	const float frameRate{ 30.f };
+
+	for (int clipIndex{}; clipIndex < 2; ++clipIndex)
+	{
+		std::vector<AnimationClip::RawTrack> tracks(g_CharacterBones);
+		for (uint32_t boneIndex{}; boneIndex < g_CharacterBones; ++boneIndex)
+		{
+			AnimationClip::RawTrack& track = tracks[boneIndex];
+			for (uint32_t frame{}; frame < frameCount; ++frame)
+			{
+				const float angle{ g_2Pi * frame / (frameCount - 1) };
+				const float sway{ 0.15f * std::sin(angle - 0.4f * boneIndex) };
+				const float curl{ 0.12f * (1.f - std::cos(angle)) };
+
+				Float4 rotation{};
+				StoreFloat4(&rotation, clipIndex == 0 ? QuaternionRotationRollPitchYaw(0.f, 0.f, sway) : QuaternionRotationRollPitchYaw(curl, 0.f, 0.f));
+				track.rotations.push_back(rotation);
+				track.translations.push_back(Float3{ 0.f, boneIndex > 0 ? g_CharacterBoneLength : 0.f, 0.f });
+				track.scales.push_back(Float3{ 1.f, 1.f, 1.f });
+			}
+		}
+
+		AnimationClip clip{};
+		if (!clip.Build(tracks, frameRate, AnimationClip::Tolerance{ 0.001f, 0.0005f, 0.0005f })
+			|| m_Animation.AddClip(std::move(clip)) == AnimationSystem::g_NoIndex)
+		{
+			Logger::Log(L"ERROR - Failed to build the character clips");
+			return;
+		}
+	}
+
+	// The curl only bends the upper half
+	std::vector<float> mask(g_CharacterBones, 0.f);
+	for (uint32_t boneIndex{ g_CharacterBones / 2 }; boneIndex < g_CharacterBones; ++boneIndex) mask[boneIndex] = 1.f;
+	const uint32_t maskIndex{ m_Animation.AddMask(mask) };
+
+	// Characters, a grid standing between the triangle layers, around the fountain
+	// -----------------------------------------------------------------------------
+
+	std::mt19937 randomEngine{ 42 };
+	std::uniform_real_distribution<float> randomTime{ 0.f, 2.f };
+
+	for (uint32_t row{}; row < g_CharacterGridSize; ++row)
+	{
+		for (uint32_t column{}; column < g_CharacterGridSize; ++column)
+		{
+			AnimationSystem::Character character{};
+			StoreFloat4x4(&character.worldMatrix, MatrixTranslation(-7.f + 2.f * column, -4.f, 9.f + 2.f * row));
+			character.layers[0] = AnimationSystem::Layer{ 0, AnimationSystem::g_NoIndex, randomTime(randomEngine), 1.f, 1.f };
+			character.layers[1] = AnimationSystem::Layer{ 1, maskIndex, randomTime(randomEngine), 0.5f, 0.f };
+			character.layerCount = 2;
+			m_Animation.AddCharacter(character);
+		}
+	}
+
+	// Buffers
+	// -------
+
+	const uint32_t characterCount{ m_Animation.GetCharacterCount() };
+	const uint32_t vertexCount{ m_Animation.GetVertexCount() };
+	m_CharacterIndexCount = static_cast<uint32_t>(indices.size());
+
+	CB_BaseVertex identity{};
+	StoreFloat4x4(&identity.worldMatrix, MatrixIdentity());
+
+	m_SkinnedVertexBuffer = m_pDevice->CreateBuffer(BufferDescription{ BufferType::Vertex, BufferUsage::Immutable, static_cast<uint32_t>(vertices.size() * sizeof(AnimationSystem::SkinnedVertex)), 0 }, vertices.data());
+	m_CharacterVertexBuffer = m_pDevice->CreateBuffer(BufferDescription{ BufferType::Vertex, BufferUsage::Dynamic, characterCount * vertexCount * static_cast<uint32_t>(sizeof(AnimationSystem::Vertex)), 0 }, nullptr);
+	m_CharacterIndexBuffer = m_pDevice->CreateBuffer(BufferDescription{ BufferType::Index, BufferUsage::Immutable, static_cast<uint32_t>(indices.size() * sizeof(uint16_t)), 0 }, indices.data());
+	m_IdentityConstantBuffer = m_pDevice->CreateBuffer(BufferDescription{ BufferType::Constant, BufferUsage::Default, sizeof(CB_BaseVertex), 0 }, &identity);
+	m_SkinConstantBuffer = m_pDevice->CreateBuffer(BufferDescription{ BufferType::Constant, BufferUsage::Default, sizeof(CB_Skin), 0 }, nullptr);
+
+	if (!m_SkinnedVertexBuffer.IsValid() || !m_CharacterVertexBuffer.IsValid() || !m_CharacterIndexBuffer.IsValid()
+		|| !m_IdentityConstantBuffer.IsValid() || !m_SkinConstantBuffer.IsValid())
+	{
+		Logger::Log(L"ERROR - Failed to create the character buffers");
+		return;
+	}
+
+	// One palette slot per character, only the fallback path updates per draw
+	if (m_pDevice->GetFeatures().constantBufferOffsets)
+	{
+		m_SkinConstantSlots.resize(static_cast<size_t>(characterCount) * sizeof(CB_Skin));
+		m_SkinConstantBatch = m_pDevice->CreateBuffer(BufferDescription{ BufferType::Constant, BufferUsage::Dynamic, static_cast<uint32_t>(m_SkinConstantSlots.size()), 0 }, nullptr);
+		if (!m_SkinConstantBatch.IsValid())
+		{
+			Logger::Log(L"ERROR - Failed to create the skin constantBuffer");
+			return;
+		}
+	}
+
+	m_CharactersReady = true;
+}
+void Renderer::UpdateCharacters(float deltaTime)
+{
+	// Fade the curl in and out, a sine over its 2 second loop
+	for (uint32_t characterIndex{}; characterIndex < m_Animation.GetCharacterCount(); ++characterIndex)
+	{
+		AnimationSystem::Layer& curl = m_Animation.GetCharacter(characterIndex).layers[1];
+		curl.weight = 0.5f + 0.5f * std::sin(math::g_Pi * curl.time);
+	}
+
+	m_Animation.Update(deltaTime, m_SkinOnCpu);
+}
+void Renderer::UploadCharacters()
+{
+	// Every character in one upload, either the skinned vertices or the palettes
+	if (m_SkinOnCpu)
+	{
+		const std::vector<AnimationSystem::Vertex>& vertices = m_Animation.GetSkinnedVertices();
+		if (!vertices.empty()) m_pDevice->UpdateBuffer(m_CharacterVertexBuffer, vertices.data(), static_cast<uint32_t>(vertices.size() * sizeof(AnimationSystem::Vertex)));
+		return;
+	}
+
+	if (!m_pDevice->GetFeatures().constantBufferOffsets) return;
+
+	const std::vector<math::Float4x4>& palettes = m_Animation.GetPalettes();
+	const uint32_t boneCount{ m_Animation.GetBoneCount() };
+	const uint32_t characterCount{ static_cast<uint32_t>(palettes.size() / boneCount) };
+
+	for (uint32_t characterIndex{}; characterIndex < characterCount; ++characterIndex)
+	{
+		// HLSL reads matrices column major
+		CB_Skin* pSlot = reinterpret_cast<CB_Skin*>(m_SkinConstantSlots.data() + static_cast<size_t>(characterIndex) * sizeof(CB_Skin));
+		for (uint32_t boneIndex{}; boneIndex < boneCount; ++boneIndex)
+		{
+			math::StoreFloat4x4(&pSlot->bones[boneIndex], math::MatrixTranspose(math::LoadFloat4x4(&palettes[static_cast<size_t>(characterIndex) * boneCount + boneIndex])));
+		}
+	}
+
+	m_pDevice->UpdateBuffer(m_SkinConstantBatch, m_SkinConstantSlots.data(), characterCount * static_cast<uint32_t>(sizeof(CB_Skin)));
+}
+void Renderer::BindSkinConstants(CommandRecorder& recorder, uint32_t characterIndex)
+{
+	// Batched, only move the window
+	if (m_pDevice->GetFeatures().constantBufferOffsets)
+	{
+		const uint32_t firstConstant{ characterIndex * static_cast<uint32_t>(sizeof(CB_Skin)) / 16 };
+		const uint32_t constantCount{ static_cast<uint32_t>(sizeof(CB_Skin)) / 16 };
+		recorder.SetConstantBuffer(ShaderStage::Vertex, 2, m_SkinConstantBatch, firstConstant, constantCount);
+		return;
+	}
+
+	// Fallback, immediate only
+	const uint32_t boneCount{ m_Animation.GetBoneCount() };
+	const math::Float4x4* pPalette{ m_Animation.GetPalettes().data() + static_cast<size_t>(characterIndex) * boneCount };
+	for (uint32_t boneIndex{}; boneIndex < boneCount; ++boneIndex)
+	{
+		math::StoreFloat4x4(&m_SkinConstants.bones[boneIndex], math::MatrixTranspose(math::LoadFloat4x4(&pPalette[boneIndex])));
+	}
+
+	m_pDevice->UpdateBuffer(m_SkinConstantBuffer, &m_SkinConstants, sizeof(CB_Skin));
+	recorder.SetConstantBuffer(ShaderStage::Vertex, 2, m_SkinConstantBuffer);
+}
+void Renderer::RecordCharacterDraws(CommandRecorder& recorder, uint32_t viewIndex)
+{
+	const uint32_t characterCount{ m_Animation.GetCharacterCount() };
+	if (characterCount == 0 || m_Animation.GetPalettes().empty()) return;
+
+	recorder.SetIndexBuffer(m_CharacterIndexBuffer, ElementFormat::R16_UInt);
+	BindViewState(recorder, viewIndex);
+
+	// Skinned vertices are in world space already, every character is drawn from its own range
+	if (m_SkinOnCpu)
+	{
+		if (m_Animation.GetSkinnedVertices().empty()) return;
+
+		const uint32_t stride{ sizeof(AnimationSystem::Vertex) };
+		recorder.SetVertexBuffers(0, 1, &m_CharacterVertexBuffer, &stride);
+		recorder.SetConstantBuffer(ShaderStage::Vertex, 0, m_IdentityConstantBuffer);
+
+		const uint32_t vertexCount{ m_Animation.GetVertexCount() };
+		for (uint32_t characterIndex{}; characterIndex < characterCount; ++characterIndex)
+		{
+			recorder.DrawIndexed(m_CharacterIndexCount, 0, static_cast<int32_t>(characterIndex * vertexCount));
+		}
+		return;
+	}
+
+	// Bind pose shared by every character, skinned by the vertexShader from the palette
+	const uint32_t stride{ sizeof(AnimationSystem::SkinnedVertex) };
+	recorder.SetVertexBuffers(0, 1, &m_SkinnedVertexBuffer, &stride);
+	recorder.SetInputLayout(m_SkinnedInputLayout);
+	recorder.SetVertexShader(m_SkinnedVertexShader);
+
+	for (uint32_t characterIndex{}; characterIndex < characterCount; ++characterIndex)
+	{
+		BindSkinConstants(recorder, characterIndex);
+		recorder.DrawIndexed(m_CharacterIndexCount, 0, 0);
+	}
+}
+
+void Renderer::PickObject()
+{
+	using namespace math;
+
+	if (m_ObjectHierarchy.IsEmpty()) return;
+
+	const std::chrono::steady_clock::time_point startTime{ std::chrono::steady_clock::now() };
+
+	// Cursor in render pixels, the views are laid out in them
+	POINT cursor{};
+	RECT clientRect{};
+	if (!GetCursorPos(&cursor) || !ScreenToClient(m_WindowHandle, &cursor) || !GetClientRect(m_WindowHandle, &clientRect)) return;
+
+	const float x{ (cursor.x + 0.5f) * m_pDevice->GetRenderWidth() / (std::max)(clientRect.right - clientRect.left, 1L) };
+	const float y{ (cursor.y + 0.5f) * m_pDevice->GetRenderHeight() / (std::max)(clientRect.bottom - clientRect.top, 1L) };
+
+	const auto viewIt = std::find_if(m_Views.begin(), m_Views.end(), [x, y](const RenderView& view)
+	{
+		return x >= view.viewportRect.x && x < view.viewportRect.x + view.viewportRect.z && y >= view.viewportRect.y && y < view.viewportRect.y + view.viewportRect.w;
+	});
+	if (viewIt == m_Views.end()) return;
+
+	// From the near to the far plane, so the distances run from 0 to 1
+	const float clipX{ 2.f * (x - viewIt->viewportRect.x) / viewIt->viewportRect.z - 1.f };
+	const float clipY{ 1.f - 2.f * (y - viewIt->viewportRect.y) / viewIt->viewportRect.w };
+
+	const Matrix inverseViewProjection{ MatrixInverse(LoadFloat4x4(&viewIt->viewProjectionMatrix)) };
+	const Vector nearPoint{ Vector3TransformCoord(VectorSet(clipX, clipY, 0.f, 1.f), inverseViewProjection) };
+	const Vector farPoint{ Vector3TransformCoord(VectorSet(clipX, clipY, 1.f, 1.f), inverseViewProjection) };
+
+	BoundingVolumeHierarchy::Ray worldRay{};
+	StoreFloat3(&worldRay.origin, nearPoint);
+	StoreFloat3(&worldRay.direction, VectorSubtract(farPoint, nearPoint));
+	worldRay.maxDistance = 1.f;
+
+	// Objects in the order the ray enters their bounds, stop once the closest triangle is nearer than the next bounds
+	m_ObjectHierarchy.IntersectAll(worldRay, m_PickCandidates);
+
+	BoundingVolumeHierarchy::Hit closestHit{ BoundingVolumeHierarchy::g_NoHit, worldRay.maxDistance };
+	uint32_t pickedObject{ BoundingVolumeHierarchy::g_NoHit };
+	uint32_t testedObjects{};
+	for (const BoundingVolumeHierarchy::Hit& candidate : m_PickCandidates)
+	{
+		if (candidate.distance >= closestHit.distance) break;
+
+		const BoundingVolumeHierarchy& meshHierarchy = candidate.primitive < m_DenseObjectStart ? m_MeshHierarchy : m_DenseMeshHierarchy;
+		if (meshHierarchy.IsEmpty()) continue;
+		++testedObjects;
+
+		// Into object space, the direction keeps its scale so the distances stay comparable
+		const Matrix inverseWorld{ MatrixInverse(LoadFloat4x4(&m_ObjectWorldMatrices[candidate.primitive])) };
+
+		BoundingVolumeHierarchy::Ray objectRay{};
+		StoreFloat3(&objectRay.origin, Vector3TransformCoord(LoadFloat3(&worldRay.origin), inverseWorld));
+		StoreFloat3(&objectRay.direction, Vector3TransformNormal(LoadFloat3(&worldRay.direction), inverseWorld));
+		objectRay.maxDistance = closestHit.distance;
+
+		const BoundingVolumeHierarchy::Hit hit{ meshHierarchy.Intersect(objectRay) };
+		if (hit.primitive == BoundingVolumeHierarchy::g_NoHit) continue;
+
+		closestHit = hit;
+		pickedObject = candidate.primitive;
+	}
+
+	const double pickMs{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count() };
+
+	std::wstringstream message;
+	if (pickedObject == BoundingVolumeHierarchy::g_NoHit)
+	{
+		message << L"Picked nothing";
+	}
+	else
+	{
+		const float distance{ closestHit.distance * VectorGetX(Vector3Length(LoadFloat3(&worldRay.direction))) };
+		message << L"Picked object " << pickedObject << L", triangle " << closestHit.primitive << L", " << distance << L" units away";
+	}
+	message << L", " << m_PickCandidates.size() << L" bounds hit and " << testedObjects << L" meshes tested in " << pickMs << L" ms";
+	Logger::Log(message.str());
+}
+
+void Renderer::ToggleCapture(FrameCaptureEncoder::Format format)
+{
+	if (m_pDevice->IsCapturing())
+	{
+		m_pDevice->StopCapture();
+		return;
+	}
+
+	// Every session gets its own timestamped name
+	SYSTEMTIME time{};
+	GetLocalTime(&time);
+
+	std::wstringstream fileName;
+	fileName << L"Captures/capture_" << std::setfill(L'0')
+		<< std::setw(4) << time.wYear << std::setw(2) << time.wMonth << std::setw(2) << time.wDay << L"_"
+		<< std::setw(2) << time.wHour << std::setw(2) << time.wMinute << std::setw(2) << time.wSecond;
+
+	if (!m_pDevice->StartCapture(format, utils::GetFullResourcePath(fileName.str())))
+	{
+		Logger::Log(L"FAILED - Previous capture is still being written, or the device can't capture");
+	}
+}
+void Renderer::UpdateCounters(std::chrono::steady_clock::time_point frameStart)
+{
+	// Frame start to frame start, so vsync and the engine sleep are part of it
+	const bool firstFrame{ m_LastFrameStart == std::chrono::steady_clock::time_point{} };
+	const int64_t frameTimeUs{ std::chrono::duration_cast<std::chrono::microseconds>(frameStart - m_LastFrameStart).count() };
+	m_LastFrameStart = frameStart;
+	if (firstFrame) return;
+
+	m_pCounters->Add(m_FrameCounter, 1);
+	m_pCounters->Set(m_FrameTimeGauge, frameTimeUs);
+
+	if (m_pDevice)
+	{
+		const RenderDevice::Statistics& deviceStatistics = m_pDevice->GetFrameStatistics();
+		m_pCounters->Set(m_DrawCallGauge, static_cast<int64_t>(deviceStatistics.drawCount));
+		m_pCounters->Set(m_TriangleGauge, static_cast<int64_t>(deviceStatistics.triangleCount));
+		m_pCounters->Set(m_UploadBytesGauge, static_cast<int64_t>(deviceStatistics.uploadBytes));
+	}
+
+	// Asking the OS costs a few microseconds, the working set doesn't change that fast
+	if (m_pCounters->Get(m_FrameCounter) % g_ResidentMemoryInterval == 1)
+	{
+		m_pCounters->Set(m_ResidentMemoryGauge, PerformanceCounters::QueryResidentBytes());
+	}
+
+	m_pCounters->EndFrame(frameTimeUs);
+}
+void Renderer::LogStartup()
+{
+	// Warm when the assets came out of the archive, cold when they were read as loose files
+	m_StartupReported = true;
+	const double firstFrameMs{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_StartupTime).count() };
+	const AssetPreloader::Statistics& assetStatistics = m_Assets.GetStatistics();
+
+	std::wstringstream message;
+	message << L"Startup (" << (assetStatistics.fromArchive ? L"warm" : L"cold") << L"): first frame after " << firstFrameMs
+		<< L" ms, " << m_DeviceCreationMs << L" ms creating the device, " << assetStatistics.assetCount << L" assets ("
+		<< assetStatistics.byteCount / 1024 << L" KB, " << assetStatistics.failedCount << L" failed) loaded in "
+		<< assetStatistics.loadMs << L" ms from " << (assetStatistics.fromArchive ? L"the archive" : L"loose files")
+		<< L", " << assetStatistics.waitMs << L" ms waiting on loads";
+	if (assetStatistics.packed) message << L", packed into a new archive in " << assetStatistics.packMs << L" ms";
+	Logger::Log(message.str());
+
+	// Every variant drawn with is compiled by now, so the next run starts without compiling any
+	m_ShaderPermutations.LogStatistics();
+	if (!m_ShaderPermutations.SaveToFile(utils::GetFullResourcePath(L"ShaderCache.bin"))) Logger::Log(L"ERROR - Failed to save the compiled shader cache");
+}
+void Renderer::LogFrameStatistics()
+{
+	// Report every few seconds
+	if (++m_FrameCount % g_StatisticsInterval != 0) return;
+
+	const MultiViewCuller::Statistics& cullStatistics = m_ViewCuller.GetStatistics();
+
+	std::wstringstream message;
+	message << L"Culling: " << cullStatistics.objectCount << L" objects, " << cullStatistics.viewCount << L" views in "
+		<< cullStatistics.groupCount << L" groups, " << cullStatistics.groupCandidates << L" group candidates, "
+		<< cullStatistics.visiblePairs << L" visible pairs, " << cullStatistics.sharedMs << L" ms shared, "
+		<< cullStatistics.perViewMs << L" ms per view tests";
+	Logger::Log(message.str());
+
+	if (m_ClusteredLightingReady && !m_LightClusters.empty())
+	{
+		const LightClusterGrid::Statistics& lightStatistics = m_LightClusters.front()->GetStatistics();
+
+		message.str(L"");
+		message << L"Clustered lighting (first view): " << lightStatistics.lightCount << L" lights, "
+			<< lightStatistics.indexCount << L" indices, max " << lightStatistics.maxLightsPerCluster << L" per cluster, "
+			<< lightStatistics.assignMs << L" ms assigning";
+		Logger::Log(message.str());
+	}
+
+	if (m_ShadowsReady && m_ShadowsEnabled)
+	{
+		const std::vector<ShadowCascades::Cascade>& cascades = m_ShadowCascades.GetCascades();
+		const MultiViewCuller::Statistics& casterStatistics = m_ShadowCuller.GetStatistics();
+
+		message.str(L"");
+		message << L"Shadows: " << cascades.size() << L" cascades split at";
+		for (size_t cascadeIndex{}; cascadeIndex < cascades.size(); ++cascadeIndex) message << (cascadeIndex == 0 ? L" " : L"/") << cascades[cascadeIndex].farDepth;
+		message << L", casters";
+		for (uint32_t cascadeIndex{}; cascadeIndex < cascades.size(); ++cascadeIndex) message << (cascadeIndex == 0 ? L" " : L"/") << m_ShadowCuller.GetVisibleObjects(cascadeIndex).size();
+		message << L", texels of";
+		for (size_t cascadeIndex{}; cascadeIndex < cascades.size(); ++cascadeIndex) message << (cascadeIndex == 0 ? L" " : L"/") << cascades[cascadeIndex].texelSize;
+		message << L" units, " << m_ShadowCascades.GetStatistics().fitMs << L" ms fitting, " << casterStatistics.sharedMs + casterStatistics.perViewMs << L" ms culling casters";
+		Logger::Log(message.str());
+	}
+
+	if (m_ParticlesReady)
+	{
+		const ParticleSystem::Statistics& particleStatistics = m_Particles.GetStatistics();
+		const double simulateMs{ particleStatistics.emitMs + particleStatistics.simulateMs + particleStatistics.killMs };
+		const double particlesPerMs{ simulateMs > 0.0 ? particleStatistics.aliveCount / simulateMs : 0.0 };
+
+		message.str(L"");
+		message << L"Particles: " << particleStatistics.aliveCount << L" alive, " << particleStatistics.emittedCount << L" emitted, "
+			<< particleStatistics.killedCount << L" killed, " << particleStatistics.emitMs << L" ms emit, "
+			<< particleStatistics.simulateMs << L" ms integrate, " << particleStatistics.killMs << L" ms kill ("
+			<< particlesPerMs << L" particles per ms), " << particleStatistics.sortMs << L" ms sort in "
+			<< particleStatistics.sortPasses << L" passes, " << particleStatistics.buildMs << L" ms building instances";
+		Logger::Log(message.str());
+	}
+
+	if (m_CharactersReady)
+	{
+		const AnimationSystem::Statistics& animationStatistics = m_Animation.GetStatistics();
+
+		message.str(L"");
+		message << L"Animation: " << animationStatistics.characterCount << L" characters of " << m_Animation.GetBoneCount() << L" bones, "
+			<< animationStatistics.sampledLayers << L" layers sampled, " << animationStatistics.animateMs << L" ms animating, ";
+		if (m_SkinOnCpu) message << animationStatistics.skinnedVertices << L" vertices skinned on the CPU in " << animationStatistics.skinMs << L" ms";
+		else message << L"skinned on the GPU";
+		Logger::Log(message.str());
+	}
+
+	if (m_MeshletsReady)
+	{
+		const MeshletCuller::Statistics& meshletStatistics = m_MeshletCuller.GetStatistics();
+		const double rejectedPercentage{ meshletStatistics.testedTriangles > 0 ? 100.0 * meshletStatistics.rejectedTriangles / meshletStatistics.testedTriangles : 0.0 };
+
+		message.str(L"");
+		message << L"Meshlets: " << meshletStatistics.testedMeshlets << L" tested, " << meshletStatistics.frustumCulled << L" outside the frustum, "
+			<< meshletStatistics.backfaceCulled << L" backfacing, " << meshletStatistics.rejectedTriangles << L" of " << meshletStatistics.testedTriangles
+			<< L" triangles rejected (" << rejectedPercentage << L"%), " << meshletStatistics.cullMs << L" ms culling";
+		Logger::Log(message.str());
+	}
+
+	// CPU cost of recording the frame, the same calls on either backend
+	message.str(L"");
+	message << L"Submission: " << m_SubmissionMs / g_StatisticsInterval << L" ms per frame on the "
+		<< (m_pDevice->GetType() == RenderDeviceType::Null ? L"null" : m_pDevice->GetType() == RenderDeviceType::Software ? L"software" : L"D3D11") << L" device";
+	Logger::Log(message.str());
+
+	if (m_DynamicResolution)
+	{
+		const ResolutionController::Statistics& resolutionStatistics = m_ResolutionController.GetStatistics();
+
+		message.str(L"");
+		message << L"Resolution: " << m_pDevice->GetRenderWidth() << L"x" << m_pDevice->GetRenderHeight() << L" of "
+			<< m_pDevice->GetBackBufferWidth() << L"x" << m_pDevice->GetBackBufferHeight() << L" (" << resolutionStatistics.scale * 100.f
+			<< L"%), " << resolutionStatistics.filteredMs << L" ms GPU against a " << resolutionStatistics.budgetMs << L" ms budget, "
+			<< resolutionStatistics.changes << L" changes, " << resolutionStatistics.framesOverBudget << L" frames over budget";
+		Logger::Log(message.str());
+	}
+
+	if (m_RecordedLists > 0)
+	{
+		message.str(L"");
+		message << L"Parallel recording: " << m_RecordedLists / static_cast<double>(g_StatisticsInterval) << L" lists per frame on "
+			<< m_pDevice->GetRecorderCount() << L" workers, " << m_RecordingMs / g_StatisticsInterval << L" ms recording per frame";
+		Logger::Log(message.str());
+	}
+
+	// Read back through the snapshot, like any external monitor would
+	PerformanceCounters::Snapshot counterSnapshot{};
+	if (m_pCounters->GetSnapshot(counterSnapshot))
+	{
+		const RollingHistogram::Summary& frameTime = counterSnapshot.frameTime;
+
+		message.str(L"");
+		message << L"Frame time: " << frameTime.mean / 1000.0 << L" ms mean, " << frameTime.p50 / 1000.0 << L" ms p50, "
+			<< frameTime.p99 / 1000.0 << L" ms p99, " << frameTime.p999 / 1000.0 << L" ms p99.9, " << frameTime.max / 1000.0
+			<< L" ms max over " << frameTime.count << L" frames, " << m_pCounters->Get(m_ResidentMemoryGauge) / (1024 * 1024) << L" MB resident";
+		Logger::Log(message.str());
+	}
+
+	m_SubmissionMs = 0.0;
+	m_RecordingMs = 0.0;
+	m_RecordedLists = 0;
+	m_pDevice->LogStatistics();
+}
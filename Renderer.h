@@ -1,16 +1,33 @@
 #pragma once
 
 #include <Windows.h>
-#include <d3d11.h>
-#include <d3dcompiler.h>
-#include <wrl.h>
-#include <DirectXMath.h>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "AnimationSystem.h"
+#include "AssetPreloader.h"
+#include "BoundingVolumeHierarchy.h"
+#include "EngineMath.h"
+#include "FrameCaptureEncoder.h"
+#include "LightClusterGrid.h"
+#include "MeshletCuller.h"
+#include "MultiViewCuller.h"
+#include "ParticleSystem.h"
+#include "RenderDevice.h"
+#include "RenderView.h"
+#include "ResolutionController.h"
+#include "ShaderPermutationCache.h"
+#include "ShadowCascades.h"
+
+class PerformanceCounters;
 
 class Renderer final
 {
 public:
 	// Rule of five
-	Renderer(HWND windowHandle);
+	Renderer(HWND windowHandle, RenderDeviceType deviceType);
 	~Renderer() = default;
 
 	Renderer(const Renderer& other) = delete;
@@ -24,63 +41,312 @@ public:
 
 	void CreateDeviceDependentResources();		// Called whenever the scene must be intialized or restarted
 	void CreateWindowSizeDependentResources();	// Called whenever the window state changes (buffers also need to be changed, see the DirectX manual)
+	void Resize(uint32_t width, uint32_t height);	// Resizes the backBuffer targets, then recreates the size dependent resources
+	void SetFrameTimeTarget(float targetMs);		// Frame pacing target the dynamic resolution fits the GPU time in
 
 private:
 	// Structs
-	struct CB_BaseVertex
+	struct CB_BaseVertex				// Per object
 	{
-		DirectX::XMFLOAT4X4 worldViewProjection;
-		DirectX::XMFLOAT4X4 worldMatrix;
+		math::Float4x4 worldMatrix;
 	};
 
 	static_assert((sizeof(CB_BaseVertex) % 16) == 0, "Constant Buffer size must be 16-byte aligned");
 
+	struct CB_View						// Per view
+	{
+		math::Float4x4 viewProjection;
+		math::Float4 cameraPosition;
+	};
+
+	static_assert((sizeof(CB_View) % 16) == 0, "Constant Buffer size must be 16-byte aligned");
+
+	struct CB_Clusters
+	{
+		math::UInt4 clusterCount;
+		math::Float4 clusterParams;	// xy = clusters per pixel, z = slice scale, w = slice bias
+		math::Float4 viewportOffset;	// xy = top left of the view in pixels
+	};
+
+	static_assert((sizeof(CB_Clusters) % 16) == 0, "Constant Buffer size must be 16-byte aligned");
+
+	struct CB_Skin						// Per character
+	{
+		math::Float4x4 bones[AnimationSystem::g_MaxBones];
+	};
+
+	static_assert((sizeof(CB_Skin) % 256) == 0, "Skin constants are batched, so they must fill whole 256-byte slots");
+
+	struct CB_Shadows
+	{
+		math::Float4x4 cascadeViewProjections[ShadowCascades::g_MaxCascades];
+		math::Float4 cascadeSplits;		// Far view depth of every cascade
+		math::Float4 sunDirection;		// xyz = towards the sun
+		math::Float4 sunColor;			// w = cascade count
+		math::Float4 shadowParams;		// x = texel size in uv
+	};
+
+	static_assert((sizeof(CB_Shadows) % 16) == 0, "Constant Buffer size must be 16-byte aligned");
+
 	struct BaseVertexInput
 	{
-		DirectX::XMFLOAT3 position;
-		DirectX::XMFLOAT3 normal;
-		DirectX::XMFLOAT2 uv;
+		math::Float3 position;
+		math::Float3 normal;
+		math::Float2 uv;
 	};
 
+	static_assert(sizeof(AnimationSystem::Vertex) == sizeof(BaseVertexInput), "CPU skinned vertices are drawn with the base inputLayout");
+
+	enum class ViewMode
+	{
+		Single,
+		SplitScreen,
+		Cubemap
+	};
+
+	// Batched constants are bound with an offset, which has to be a multiple of 256 bytes
+	static constexpr uint32_t g_ConstantSlotSize{ 256 };
+
+	// Features of the surface shaders, in the order they are declared
+	static constexpr uint32_t g_SkinnedFeature{ 1u << 0 };				// Surface_VS
+	static constexpr uint32_t g_ClusteredLightingFeature{ 1u << 0 };	// Surface_PS
+	static constexpr uint32_t g_ShadowsFeature{ 1u << 1 };				// Surface_PS
+
+	// Views past the camera views are shadow cascades, they share the view constant slots
+	static constexpr uint32_t g_MaxViewSlots{ MultiViewCuller::g_MaxViews + ShadowCascades::g_MaxCascades };
+
+	static constexpr uint32_t g_ParticleCapacity{ 131072 };
+
+	static constexpr uint32_t g_DenseMeshRings{ 64 };		// 16k triangles per dense mesh
+	static constexpr uint32_t g_DenseMeshSegments{ 128 };
+	static constexpr float g_DenseMeshRadius{ 3.f };
+
+	static constexpr uint32_t g_CharacterBones{ 16 };		// One tentacle per character
+	static constexpr uint32_t g_CharacterRingsPerBone{ 4 };
+	static constexpr uint32_t g_CharacterSegments{ 12 };
+	static constexpr float g_CharacterBoneLength{ 0.25f };
+	static constexpr float g_CharacterRadius{ 0.12f };
+	static constexpr uint32_t g_CharacterGridSize{ 8 };		// 64 characters
+
+	static constexpr uint32_t g_StatisticsInterval{ 600 };	// Frames between reports
+
+	static constexpr size_t g_MinDrawsPerList{ 64 };
+	static constexpr uint32_t g_BenchmarkRepeats{ 8 };
+	static constexpr uint32_t g_BenchmarkIterations{ 32 };
+
+	static constexpr uint32_t g_ResidentMemoryInterval{ 60 };	// Frames between working set queries
+
+	static constexpr float g_MinRenderScale{ 0.5f };		// A quarter of the pixels
+	static constexpr float g_RenderScaleHeadroom{ 0.9f };
+	static constexpr uint32_t g_RenderScaleSettleFrames{ 4 };	// GPU times are read back a few frames late
+
 	// Member variables
 	HWND m_WindowHandle;
 
-	Microsoft::WRL::ComPtr<ID3D11Device> m_pDevice;
-	Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_pDeviceContext;
-	Microsoft::WRL::ComPtr<IDXGISwapChain> m_pSwapChain;
-	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> m_pRenderTargetView;
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> m_pDepthStencil;
-	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> m_pDepthStencilView;
+	// Startup, the assets load while the device is created
+	AssetPreloader m_Assets;
+	std::chrono::steady_clock::time_point m_StartupTime;
+	double m_DeviceCreationMs;
+	bool m_StartupReported;
+
+	std::unique_ptr<RenderDevice> m_pDevice;
 
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> m_pBackBuffer;
-	D3D11_TEXTURE2D_DESC m_BackBufferDescription;
+	// Shader permutations, the surface shaders are compiled at runtime for every set of features drawn with
+	ShaderPermutationCache m_ShaderPermutations;
+	uint32_t m_SurfaceVertexShader;
+	uint32_t m_SurfacePixelShader;
 
-	Microsoft::WRL::ComPtr<ID3D11InputLayout> m_pInputLayout;
-	Microsoft::WRL::ComPtr<ID3D11VertexShader> m_pVertexShader;
-	Microsoft::WRL::ComPtr<ID3D11PixelShader> m_pPixelShader;
+	InputLayoutHandle m_InputLayout;
+	VertexShaderHandle m_VertexShader;
+	PixelShaderHandle m_PixelShader;
+	PipelineStateHandle m_PipelineState;
 
-	Microsoft::WRL::ComPtr<ID3D11Buffer> m_pConstantBuffer;
+	BufferHandle m_ConstantBuffer;
 	CB_BaseVertex m_VertexConstantBuffer;
+	BufferHandle m_ViewConstantBuffer;
+	CB_View m_ViewConstants;
 
-	Microsoft::WRL::ComPtr<ID3D11Buffer> m_pVertexBuffer;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> m_pIndexBuffer;
+	BufferHandle m_ObjectConstantBatch;		// Every object, one slot each
+	BufferHandle m_ViewConstantBatch;		// Every view, rewritten once per frame
+	std::vector<char> m_ViewConstantSlots;
+
+	BufferHandle m_VertexBuffer;
+	BufferHandle m_IndexBuffer;
 	int m_IndexCount;
 
-	D3D11_VIEWPORT m_Viewport;
-	D3D_FEATURE_LEVEL m_FeatureLevel;
 	bool m_SuccesfullCreation;
 
-	DirectX::XMFLOAT3 m_CameraPos;
+	math::Float3 m_CameraPos;
+	float m_FieldOfView;
+	float m_NearZ;
+	float m_FarZ;
 
-	// Member functions
-	bool CreateDevice();
-	bool CreateSwapChain();
-	bool CreateRenderTarget();
-	bool CreateDepthStencil();
-	void CreateViewport();
+	// Scene
+	math::Float4 m_MeshBoundingSphere;
+	std::vector<math::Float4x4> m_ObjectWorldMatrices;
+	std::vector<math::Float4> m_ObjectSpheres;
+
+	// Picking, the meshes are in object space and the objects in world space
+	BoundingVolumeHierarchy m_MeshHierarchy;
+	BoundingVolumeHierarchy m_DenseMeshHierarchy;
+	BoundingVolumeHierarchy m_ObjectHierarchy;
+	std::vector<BoundingVolumeHierarchy::Hit> m_PickCandidates;
+
+	// Dense meshes, drawn from their visible meshlets
+	MeshletCuller m_MeshletCuller;
+	std::vector<std::vector<MeshletCuller::DrawRange>> m_MeshletDraws;	// Per view
+
+	BufferHandle m_DenseVertexBuffer;
+	BufferHandle m_MeshletIndexBuffer;		// Compacted survivors of every view, rewritten every frame
+	uint32_t m_MeshletIndexCapacity;
+	math::Float4 m_DenseMeshBoundingSphere;
+	uint32_t m_DenseObjectStart;			// Scene objects from here on use the dense mesh
+	bool m_MeshletsReady;
+
+	// Views
+	ViewMode m_ViewMode;
+	std::vector<RenderView> m_Views;
+	MultiViewCuller m_ViewCuller;
+
+	// Clustered lighting
+	std::vector<LightClusterGrid::Light> m_Lights;
+	std::vector<std::unique_ptr<LightClusterGrid>> m_LightClusters;	// One grid per view
+
+	PixelShaderHandle m_ClusteredPixelShader;
+	BufferHandle m_ClusterConstantBuffer;
+	CB_Clusters m_ClusterConstants;
+
+	BufferHandle m_LightBuffer;
+	BufferHandle m_ClusterRangeBuffer;
+	BufferHandle m_LightIndexBuffer;
+	ShaderViewHandle m_LightView;
+	ShaderViewHandle m_ClusterRangeView;
+	ShaderViewHandle m_LightIndexView;
+	uint32_t m_LightIndexCapacity;
+	bool m_ClusteredLightingReady;
+
+	// Sun shadows, cascades fitted to the first view
+	ShadowCascades m_ShadowCascades;
+	MultiViewCuller m_ShadowCuller;		// Casters of every cascade
+	math::Float3 m_SunDirection;		// Away from the sun
+
+	DepthTargetHandle m_ShadowMap;		// One slice per cascade
+	ShaderViewHandle m_ShadowMapView;
+	PipelineStateHandle m_ShadowPipelineState;
+	PixelShaderHandle m_ShadowedPixelShader;
+	PixelShaderHandle m_ShadowedClusteredPixelShader;
+	BufferHandle m_ShadowConstantBuffer;
+	CB_Shadows m_ShadowConstants;
+	bool m_ShadowsReady;
+	bool m_ShadowsEnabled;
+
+	// Particles
+	ParticleSystem m_Particles;
+
+	VertexShaderHandle m_ParticleVertexShader;
+	PixelShaderHandle m_ParticlePixelShader;
+	InputLayoutHandle m_ParticleInputLayout;
+	PipelineStateHandle m_ParticlePipelineState;
+
+	BufferHandle m_ParticleQuadVertexBuffer;
+	BufferHandle m_ParticleQuadIndexBuffer;
+	BufferHandle m_ParticleInstanceBuffer;	// Sorted instances, rewritten every frame
+	bool m_ParticlesReady;
+
+	// Skinned characters
+	AnimationSystem m_Animation;
+	bool m_SkinOnCpu;
+
+	VertexShaderHandle m_SkinnedVertexShader;
+	InputLayoutHandle m_SkinnedInputLayout;
+
+	BufferHandle m_SkinnedVertexBuffer;		// Bind pose with the bone influences, shared by every character
+	BufferHandle m_CharacterVertexBuffer;	// Skinned on the CPU, every character after the other, rewritten every frame
+	BufferHandle m_CharacterIndexBuffer;
+	uint32_t m_CharacterIndexCount;
 
+	BufferHandle m_IdentityConstantBuffer;	// World matrix of the CPU skinned vertices, they are in world space already
+	BufferHandle m_SkinConstantBatch;		// Every character, one palette slot each
+	BufferHandle m_SkinConstantBuffer;		// Fallback, updated before every draw
+	CB_Skin m_SkinConstants;
+	std::vector<char> m_SkinConstantSlots;
+	bool m_CharactersReady;
+
+	// Dynamic resolution
+	ResolutionController m_ResolutionController;
+	bool m_DynamicResolution;
+
+	// Parallel recording
+	bool m_ParallelRecording;
+	double m_RecordingMs;					// Since the last report
+	uint32_t m_RecordedLists;
+
+	uint32_t m_FrameCount;
+	double m_SubmissionMs;					// CPU time spent submitting, since the last report
+
+	// Performance counters
+	PerformanceCounters* m_pCounters;
+	uint32_t m_FrameCounter;
+	uint32_t m_FrameTimeGauge;
+	uint32_t m_DrawCallGauge;
+	uint32_t m_TriangleGauge;
+	uint32_t m_UploadBytesGauge;
+	uint32_t m_ResidentMemoryGauge;
+	uint32_t m_JobQueueGauge;				// Loading tasks and recording lists that haven't finished
+	uint32_t m_ResizeHitchGauge;			// Of the last resize
+	uint32_t m_RenderScaleGauge;			// Percentage of the backBuffer width and height drawn
+	std::chrono::steady_clock::time_point m_LastFrameStart;
+
+	// Member functions
 	void CreateShaders();
-	HRESULT CreateTriangle();
+	bool CreateTriangle();
+	bool CreateDenseMesh();
+	bool CreateSceneObjects();
+	void BuildObjectHierarchy();
 	void CreateViewProjectionMatrix();
+	void UpdateRenderResolution();
+
+	const RenderView& GetView(uint32_t viewIndex) const;	// Camera view or shadow cascade
+	const std::vector<uint32_t>& GetVisibleObjects(uint32_t viewIndex) const;
+	uint32_t GetViewCount() const;							// Camera views and shadow cascades drawn this frame
+
+	bool CreateViewConstants();
+	void UploadViewConstants();
+	void BindViewConstants(CommandRecorder& recorder, uint32_t viewIndex);
+	void BindObjectConstants(CommandRecorder& recorder, uint32_t objectIndex);
+
+	void BindViewState(CommandRecorder& recorder, uint32_t viewIndex);
+	void RecordDraws(CommandRecorder& recorder, uint32_t viewIndex, const uint32_t* pObjects, size_t objectCount);
+	uint32_t RecordDrawsInParallel(uint32_t viewIndex, const uint32_t* pObjects, size_t objectCount, uint32_t workerCount);	// Returns the number of lists
+	void BenchmarkRecording();
+
+	void CullMeshlets();
+	void RecordMeshletDraws(CommandRecorder& recorder, uint32_t viewIndex);
+
+	void CreateLights();
+	void CreateClusteredLighting();
+	bool CreateLightIndexBuffer(uint32_t capacity);
+	void UploadLights();
+	void UpdateClusteredLighting(uint32_t viewIndex);
+
+	void CreateShadows();
+	void UpdateShadows();
+	void RenderShadowMaps();
+
+	void CreateParticles();
+	void RenderParticles();
+
+	void CreateCharacters();
+	void UpdateCharacters(float deltaTime);
+	void UploadCharacters();
+	void BindSkinConstants(CommandRecorder& recorder, uint32_t characterIndex);
+	void RecordCharacterDraws(CommandRecorder& recorder, uint32_t viewIndex);
+
+	void PickObject();
+
+	void ToggleCapture(FrameCaptureEncoder::Format format);
+	void UpdateCounters(std::chrono::steady_clock::time_point frameStart);
+	void LogStartup();
+	void LogFrameStatistics();
 };
 
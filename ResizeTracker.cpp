@@ -0,0 +1,44 @@
+#include "ResizeTracker.h"
+
+void ResizeTracker::OnSize(bool minimized, uint32_t width, uint32_t height)
+{
+	++m_Statistics.sizeMessages;
+
+	// A zero client area is as good as minimized, restoring brings back the size from before
+	m_Minimized = minimized || width == 0 || height == 0;
+	if (m_Minimized) return;
+
+	// Later messages overwrite earlier ones, only the last size matters
+	m_PendingWidth = width;
+	m_PendingHeight = height;
+	m_HasPendingSize = true;
+}
+void ResizeTracker::OnEnterSizeMove()
+{
+	m_SizeMoving = true;
+}
+void ResizeTracker::OnExitSizeMove()
+{
+	m_SizeMoving = false;
+}
+
+bool ResizeTracker::TakePendingResize(uint32_t& width, uint32_t& height)
+{
+	// Resizing on every step of a drag would recreate the targets dozens of times
+	if (!m_HasPendingSize || m_Minimized || m_SizeMoving) return false;
+
+	width = m_PendingWidth;
+	height = m_PendingHeight;
+	m_HasPendingSize = false;
+
+	++m_Statistics.resizes;
+	return true;
+}
+bool ResizeTracker::ShouldRender()
+{
+	// Without a client area the swapChain can't present anything, don't spend a frame on it
+	if (!m_Minimized) return true;
+
+	++m_Statistics.skippedFrames;
+	return false;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+
+// Turns the stream of window size messages into at most one backBuffer resize per frame
+// Sizes seen while the user drags the border are held back until the drag ends, only the last one is applied
+// Minimized windows report a zero size, that is never a resize but stops rendering until the window comes back
+// Plain state, no window calls, so it can be driven without a window
+class ResizeTracker final
+{
+public:
+	// Structs
+	struct Statistics
+	{
+		uint32_t sizeMessages;
+		uint32_t resizes;				// Pending sizes handed out, every other message was coalesced
+		uint32_t skippedFrames;			// While minimized or without a client area
+	};
+
+	// Rule of five
+	ResizeTracker() = default;
+	~ResizeTracker() = default;
+
+	ResizeTracker(const ResizeTracker& other) = delete;
+	ResizeTracker(ResizeTracker&& other) = delete;
+	ResizeTracker& operator= (const ResizeTracker& other) = delete;
+	ResizeTracker& operator= (ResizeTracker&& other) = delete;
+
+	// Publics
+	void OnSize(bool minimized, uint32_t width, uint32_t height);	// WM_SIZE
+	void OnEnterSizeMove();											// WM_ENTERSIZEMOVE
+	void OnExitSizeMove();											// WM_EXITSIZEMOVE
+
+	// Once per frame, after the messages were handled
+	bool TakePendingResize(uint32_t& width, uint32_t& height);	// True at most once for every new size
+	bool ShouldRender();										// Counts the skipped frames
+
+	bool IsMinimized() const { return m_Minimized; }
+	bool IsSizeMoving() const { return m_SizeMoving; }
+	const Statistics& GetStatistics() const { return m_Statistics; }
+
+private:
+	// Member variables
+	uint32_t m_PendingWidth{ 0 };
+	uint32_t m_PendingHeight{ 0 };
+	bool m_HasPendingSize{ false };
+
+	bool m_Minimized{ false };
+	bool m_SizeMoving{ false };
+
+	Statistics m_Statistics{};
+};
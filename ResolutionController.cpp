@@ -0,0 +1,86 @@
+#include "ResolutionController.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	constexpr float g_Smoothing{ 0.15f };		// Weight of a new measurement
+	constexpr float g_OverBudget{ 1.05f };		// Filtered time over the budget that drops the scale
+	constexpr float g_UnderBudget{ 0.85f };		// Filtered time under the budget that raises it
+	constexpr float g_AimRatio{ 0.95f };		// Changes aim between the two, so noise doesn't push the next frame straight out again
+	constexpr float g_ClimbRate{ 0.5f };		// Part of the way to the ideal scale taken when raising
+	constexpr float g_MaxClimb{ 0.1f };
+}
+
+ResolutionController::ResolutionController(const Settings& settings)
+	: m_Settings{ settings }
+	, m_Statistics{}
+	, m_SettleFrames{}
+{
+	Reset();
+}
+
+float ResolutionController::Update(float frameMs)
+{
+	if (frameMs <= 0.f) return m_Statistics.scale;
+
+	m_Statistics.budgetMs = m_Settings.targetMs * m_Settings.headroom;
+	if (frameMs > m_Statistics.budgetMs) ++m_Statistics.framesOverBudget;
+
+	// Measurements right after a change can still belong to frames drawn at the old scale
+	if (m_SettleFrames > 0)
+	{
+		--m_SettleFrames;
+		return m_Statistics.scale;
+	}
+
+	m_Statistics.filteredMs = m_Statistics.filteredMs > 0.f ? m_Statistics.filteredMs + g_Smoothing * (frameMs - m_Statistics.filteredMs) : frameMs;
+
+	// The scale that would land inside the dead band
+	const float ratio{ m_Statistics.filteredMs / m_Statistics.budgetMs };
+	const float idealScale{ m_Statistics.scale * std::sqrt(g_AimRatio / ratio) };
+
+	if (ratio > g_OverBudget)
+	{
+		// Missing frames is worse than a blurry one, jump straight down
+		ChangeScale(idealScale);
+	}
+	else if (ratio < g_UnderBudget)
+	{
+		const float climb{ (std::min)(g_ClimbRate * (idealScale - m_Statistics.scale), g_MaxClimb) };
+		ChangeScale(m_Statistics.scale + climb);
+	}
+
+	return m_Statistics.scale;
+}
+void ResolutionController::Reset()
+{
+	m_Statistics = Statistics{};
+	m_Statistics.scale = m_Settings.maxScale;
+	m_Statistics.budgetMs = m_Settings.targetMs * m_Settings.headroom;
+	m_SettleFrames = 0;
+}
+
+void ResolutionController::SetTargetMs(float targetMs)
+{
+	m_Settings.targetMs = targetMs;
+	m_Statistics.budgetMs = targetMs * m_Settings.headroom;
+}
+
+// Privates
+// --------
+void ResolutionController::ChangeScale(float scale)
+{
+	scale = std::clamp(scale, m_Settings.minScale, m_Settings.maxScale);
+	scale = std::clamp(std::round(scale / g_ScaleStep) * g_ScaleStep, m_Settings.minScale, m_Settings.maxScale);
+	if (scale == m_Statistics.scale) return;
+
+	// Predict the time at the new scale, so the filter doesn't have to forget the old one first
+	const float pixelRatio{ scale / m_Statistics.scale };
+	m_Statistics.filteredMs *= pixelRatio * pixelRatio;
+
+	m_Statistics.scale = scale;
+	++m_Statistics.changes;
+	m_SettleFrames = m_Settings.settleFrames;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+// Picks the render scale from the measured frame time, so the frame fits the pacing target on any hardware
+// Assumes the measured cost follows the pixel count: a scale of s costs s * s of the full resolution frame
+// Drops quickly when over budget and climbs back slowly, with a dead band in between so it settles instead of oscillating
+// After every change it waits a few frames, the backend measures its frames with some latency
+class ResolutionController final
+{
+public:
+	// Structs
+	struct Settings
+	{
+		float targetMs;					// Frame time to fit in, the pacing target
+		float minScale;
+		float maxScale;
+		float headroom;					// Fraction of the target aimed for, leaves room for spikes
+		uint32_t settleFrames;			// Measurements ignored after a change
+	};
+
+	struct Statistics
+	{
+		float scale;
+		float filteredMs;				// Smoothed measurement the decisions are based on
+		float budgetMs;					// Target with the headroom applied
+		uint32_t changes;				// Since the last reset
+		uint32_t framesOverBudget;
+	};
+
+	static constexpr float g_ScaleStep{ 1.f / 64.f };	// Scales are rounded to this, tiny changes aren't worth new viewports
+
+	// Rule of five
+	explicit ResolutionController(const Settings& settings);
+	~ResolutionController() = default;
+
+	ResolutionController(const ResolutionController& other) = delete;
+	ResolutionController(ResolutionController&& other) = delete;
+	ResolutionController& operator= (const ResolutionController& other) = delete;
+	ResolutionController& operator= (ResolutionController&& other) = delete;
+
+	// Publics
+	float Update(float frameMs);		// Once per frame, 0 or less means there is no measurement yet
+	void Reset();						// Back to the maximum scale
+
+	void SetTargetMs(float targetMs);
+	float GetScale() const { return m_Statistics.scale; }
+	const Settings& GetSettings() const { return m_Settings; }
+	const Statistics& GetStatistics() const { return m_Statistics; }
+
+private:
+	// Member variables
+	Settings m_Settings;
+	Statistics m_Statistics;
+	uint32_t m_SettleFrames;
+
+	// Member functions
+	void ChangeScale(float scale);
+};
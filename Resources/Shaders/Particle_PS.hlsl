@@ -0,0 +1,17 @@
+
+struct PS_INPUT
+{
+    float4 position : SV_POSITION; // System value
+    float3 normal : NORMAL;
+    float2 uv : TEXCOORD0;
+    float4 color : COLOR;
+};
+
+float4 PSMain(PS_INPUT input) : SV_TARGET
+{
+    // Soft round sprite
+    const float2 centered = input.uv * 2.0 - 1.0;
+    const float falloff = saturate(1.0 - dot(centered, centered));
+
+    return float4(input.color.rgb, input.color.a * falloff);
+}
@@ -0,0 +1,46 @@
+
+cbuffer CB_View : register(b1)      // Shared with Surface_VS.hlsl
+{
+    matrix g_ViewProjection;        // World to projection space
+    float4 g_CameraPosition;
+};
+
+struct VS_INPUT
+{
+    // Per vertex, the unit quad
+    float3 position : POSITION;
+    float3 normal : NORMAL;
+    float2 uv : TEXCOORD0;
+
+    // Per instance, see ParticleSystem::Instance
+    float4 positionSize : INSTANCE_POSITION;    // xyz = world position, w = size
+    float4 color : INSTANCE_COLOR;
+};
+
+struct VS_OUTPUT
+{
+    float4 position : SV_POSITION;  // System value
+    float3 normal : NORMAL;
+    float2 uv : TEXCOORD0;
+    float4 color : COLOR;
+};
+
+VS_OUTPUT VSMain(VS_INPUT input)
+{
+    VS_OUTPUT output;
+
+    // Expand the quad so it faces the camera
+    const float3 toCamera = normalize(g_CameraPosition.xyz - input.positionSize.xyz);
+    const float3 right = normalize(cross(toCamera, float3(0, 1, 0)));
+    const float3 up = cross(right, toCamera);
+
+    const float3 worldPosition = input.positionSize.xyz
+        + (right * input.position.x + up * input.position.y) * input.positionSize.w;
+
+    output.position = mul(float4(worldPosition, 1.0), g_ViewProjection);
+    output.normal = toCamera;
+    output.uv = input.uv;
+    output.color = input.color;
+
+    return output;
+}
@@ -0,0 +1,159 @@
+// Compiled at runtime as shader permutations, every feature below is a define set to 1 when enabled
+// CLUSTERED_LIGHTING: the lights of the pixel's cluster are read from t0-t2 and shaded, otherwise the albedo is output unlit
+// SHADOWS: the sun in b2 is shaded, shadowed through the cascades in t3 with the comparison sampler in s0
+
+cbuffer CB_Object : register(b0)
+{
+    float4 g_objectColor;
+};
+
+#if CLUSTERED_LIGHTING
+// Keep in sync with LightClusterGrid.h
+struct Light
+{
+    float3 position;
+    float range;
+    float3 color;
+    float spotCosOuter;     // Below -1 for point lights
+    float3 direction;
+    float spotCosInner;
+};
+
+cbuffer CB_Clusters : register(b1)
+{
+    uint4 g_ClusterCount;   // xyz = clusters per axis
+    float4 g_ClusterParams; // xy = clusters per pixel, z = slice scale, w = slice bias
+    float4 g_ViewportOffset;    // xy = top left of the view in pixels
+};
+
+StructuredBuffer<Light> g_Lights : register(t0);
+Buffer<uint2> g_ClusterRanges : register(t1);     // Offset and count into g_LightIndices
+Buffer<uint> g_LightIndices : register(t2);
+#endif
+
+#if SHADOWS
+// Keep in sync with CB_Shadows in Renderer.h
+cbuffer CB_Shadows : register(b2)
+{
+    matrix g_CascadeViewProjections[4];
+    float4 g_CascadeSplits;     // Far view depth of every cascade
+    float4 g_SunDirection;      // xyz = towards the sun
+    float4 g_SunColor;          // w = cascade count
+    float4 g_ShadowParams;      // x = texel size in uv
+};
+
+Texture2DArray<float> g_ShadowMap : register(t3);   // One slice per cascade
+SamplerComparisonState g_ShadowSampler : register(s0);
+#endif
+
+struct PS_INPUT
+{
+    float4 position : SV_POSITION; // System value
+    float3 normal : NORMAL;
+    float2 uv : TEXCOORD0;
+    float3 worldPosition : WORLDPOS;
+};
+
+#if CLUSTERED_LIGHTING
+uint GetClusterIndex(float4 screenPosition)
+{
+    // W holds the view depth for a perspective projection
+    const float viewDepth = screenPosition.w;
+
+    uint3 cluster;
+    cluster.xy = min(uint2((screenPosition.xy - g_ViewportOffset.xy) * g_ClusterParams.xy), g_ClusterCount.xy - 1);
+    cluster.z = min(uint(max(log(viewDepth) * g_ClusterParams.z + g_ClusterParams.w, 0.0)), g_ClusterCount.z - 1);
+
+    return cluster.x + g_ClusterCount.x * (cluster.y + g_ClusterCount.y * cluster.z);
+}
+
+float3 ShadeLight(Light light, float3 worldPosition, float3 normal)
+{
+    const float3 toLight = light.position - worldPosition;
+    const float distance = length(toLight);
+    const float3 lightDirection = toLight / max(distance, 0.0001);
+
+    // Smooth falloff to zero at the range
+    const float falloff = saturate(1.0 - distance / light.range);
+    float attenuation = falloff * falloff;
+
+    // Spot cone
+    if (light.spotCosOuter >= -1.0)
+    {
+        const float cosAngle = dot(-lightDirection, light.direction);
+        attenuation *= smoothstep(light.spotCosOuter, light.spotCosInner, cosAngle);
+    }
+
+    const float diffuse = saturate(dot(normal, lightDirection));
+    return light.color * diffuse * attenuation;
+}
+#endif
+
+#if SHADOWS
+float GetSunShadow(float3 worldPosition, float viewDepth)
+{
+    // First cascade reaching past the pixel, nothing is shadowed past the last one
+    const uint cascadeCount = (uint) g_SunColor.w;
+    uint cascade = 0;
+    while (cascade < cascadeCount && viewDepth > g_CascadeSplits[cascade])
+    {
+        ++cascade;
+    }
+
+    if (cascade >= cascadeCount)
+    {
+        return 1.0;
+    }
+
+    const float4 lightPosition = mul(float4(worldPosition, 1.0), g_CascadeViewProjections[cascade]);
+    const float2 uv = float2(0.5, -0.5) * lightPosition.xy + 0.5;
+
+    // 4 taps half a texel apart, each one filtered over 2x2 texels by the sampler
+    const float2 offsets[4] = { float2(-0.5, -0.5), float2(0.5, -0.5), float2(-0.5, 0.5), float2(0.5, 0.5) };
+
+    float lit = 0.0;
+    [unroll]
+    for (uint tap = 0; tap < 4; ++tap)
+    {
+        const float3 location = float3(uv + offsets[tap] * g_ShadowParams.x, cascade);
+        lit += g_ShadowMap.SampleCmpLevelZero(g_ShadowSampler, location, lightPosition.z);
+    }
+
+    return lit * 0.25;
+}
+#endif
+
+float4 PSMain(PS_INPUT input) : SV_TARGET
+{
+    const float3 albedo = float3(1, 0, 0);
+
+#if CLUSTERED_LIGHTING || SHADOWS
+    const float3 ambient = float3(0.05, 0.05, 0.05);
+    const float3 normal = normalize(input.normal);
+
+    float3 lighting = ambient;
+#endif
+
+#if SHADOWS
+    // W holds the view depth for a perspective projection
+    const float sunDiffuse = saturate(dot(normal, g_SunDirection.xyz));
+    lighting += g_SunColor.rgb * sunDiffuse * GetSunShadow(input.worldPosition, input.position.w);
+#endif
+
+#if CLUSTERED_LIGHTING
+    // Only loop over the lights of this pixel's cluster
+    const uint2 range = g_ClusterRanges[GetClusterIndex(input.position)];
+
+    for (uint index = 0; index < range.y; ++index)
+    {
+        const Light light = g_Lights[g_LightIndices[range.x + index]];
+        lighting += ShadeLight(light, input.worldPosition, normal);
+    }
+#endif
+
+#if CLUSTERED_LIGHTING || SHADOWS
+    return float4(albedo * lighting, 1);
+#else
+    return float4(albedo, 1);
+#endif
+}
@@ -0,0 +1,63 @@
+// Compiled at runtime as shader permutations, every feature below is a define set to 1 when enabled
+// SKINNED: the bone palette in b2 is blended from BLENDINDICES and BLENDWEIGHT, instead of the world matrix in b0
+
+#if SKINNED
+cbuffer CB_Skin : register(b2)
+{
+    matrix g_Bones[64];             // Bind pose to world space, the world matrix of the character is folded in
+};
+#else
+cbuffer CB_Object : register(b0)    // Register for GPU access (b. for constant buffers)
+{
+    matrix g_World;                 // World space
+};
+#endif
+
+cbuffer CB_View : register(b1)
+{
+    matrix g_ViewProjection;        // World to projection space
+    float4 g_CameraPosition;
+};
+
+struct VS_INPUT
+{
+    float3 position : POSITION;
+    float3 normal : NORMAL;
+    float2 uv : TEXCOORD0;
+#if SKINNED
+    uint4 boneIndices : BLENDINDICES;
+    float4 boneWeights : BLENDWEIGHT;   // Adding up to 1
+#endif
+};
+
+struct VS_OUTPUT
+{
+    float4 position : SV_POSITION;  // System value
+    float3 normal : NORMAL;
+    float2 uv : TEXCOORD0;
+    float3 worldPosition : WORLDPOS;    // Last, so pixelShaders without lighting can ignore it
+};
+
+VS_OUTPUT VSMain(VS_INPUT input)
+{
+    VS_OUTPUT output;
+
+#if SKINNED
+    // Blend the palette first, one transform per vertex instead of four
+    const matrix world = g_Bones[input.boneIndices.x] * input.boneWeights.x
+        + g_Bones[input.boneIndices.y] * input.boneWeights.y
+        + g_Bones[input.boneIndices.z] * input.boneWeights.z
+        + g_Bones[input.boneIndices.w] * input.boneWeights.w;
+#else
+    const matrix world = g_World;
+#endif
+
+    const float4 worldPosition = mul(float4(input.position, 1.0), world);
+
+    output.position = mul(worldPosition, g_ViewProjection);
+    output.normal = normalize(mul(input.normal, (float3x3) world));
+    output.uv = input.uv;
+    output.worldPosition = worldPosition.xyz;
+    
+    return output;
+}
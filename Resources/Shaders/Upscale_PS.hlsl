@@ -0,0 +1,19 @@
+cbuffer CB_Upscale : register(b0)   // Shared with Upscale_VS.hlsl
+{
+    float2 g_UvScale;
+    float2 g_MaxUv;
+};
+
+Texture2D g_SceneTarget : register(t0);
+SamplerState g_LinearClamp : register(s0);
+
+struct PS_INPUT
+{
+    float4 position : SV_POSITION;  // System value
+    float2 uv : TEXCOORD0;
+};
+
+float4 PSMain(PS_INPUT input) : SV_TARGET
+{
+    return g_SceneTarget.SampleLevel(g_LinearClamp, min(input.uv, g_MaxUv), 0);
+}
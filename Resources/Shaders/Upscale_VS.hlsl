@@ -0,0 +1,23 @@
+cbuffer CB_Upscale : register(b0)
+{
+    float2 g_UvScale;               // Part of the scene target the frame was drawn in
+    float2 g_MaxUv;                 // Last texel center inside it, so filtering never reads outside
+};
+
+struct VS_OUTPUT
+{
+    float4 position : SV_POSITION;  // System value
+    float2 uv : TEXCOORD0;
+};
+
+// One triangle covering the whole backBuffer, without any vertexBuffer
+VS_OUTPUT VSMain(uint vertexId : SV_VertexID)
+{
+    VS_OUTPUT output;
+
+    const float2 corner = float2((vertexId << 1) & 2, vertexId & 2);
+    output.position = float4(corner * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+    output.uv = corner * g_UvScale;
+
+    return output;
+}
@@ -0,0 +1,137 @@
+#include "RollingHistogram.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <iterator>
+
+// Linear buckets up to 64, after that a value is its top 6 bits and a shift
+namespace
+{
+	constexpr uint32_t g_LinearBuckets{ 64 };
+	constexpr uint32_t g_SubBuckets{ 32 };
+}
+
+RollingHistogram::RollingHistogram(uint32_t sliceCount, int64_t sliceDuration)
+	: m_SliceCount{ (std::max)(sliceCount, 1u) }
+	, m_SliceDuration{ (std::max)(sliceDuration, int64_t{ 1 }) }
+	, m_SliceBuckets(size_t{ m_SliceCount } * g_BucketCount, 0)
+	, m_SliceCounts(m_SliceCount, 0)
+	, m_SliceSums(m_SliceCount, 0)
+	, m_TotalBuckets(g_BucketCount, 0)
+	, m_TotalCount{ 0 }
+	, m_TotalSum{ 0 }
+	, m_CurrentSlice{ 0 }
+	, m_SliceElapsed{ 0 }
+{
+}
+
+void RollingHistogram::Record(int64_t value)
+{
+	const int64_t clamped{ std::clamp<int64_t>(value, 0, g_MaxValue) };
+	const uint32_t bucketIndex{ GetBucketIndex(clamped) };
+
+	++m_SliceBuckets[size_t{ m_CurrentSlice } * g_BucketCount + bucketIndex];
+	++m_SliceCounts[m_CurrentSlice];
+	m_SliceSums[m_CurrentSlice] += clamped;
+
+	++m_TotalBuckets[bucketIndex];
+	++m_TotalCount;
+	m_TotalSum += clamped;
+}
+void RollingHistogram::Advance(int64_t elapsed)
+{
+	m_SliceElapsed += (std::max)(elapsed, int64_t{ 0 });
+
+	// A long stall empties the whole window at most once
+	uint32_t droppedSlices{};
+	while (m_SliceElapsed >= m_SliceDuration)
+	{
+		m_SliceElapsed -= m_SliceDuration;
+		m_CurrentSlice = (m_CurrentSlice + 1) % m_SliceCount;
+		DropSlice(m_CurrentSlice);
+
+		if (++droppedSlices == m_SliceCount)
+		{
+			m_SliceElapsed %= m_SliceDuration;
+			break;
+		}
+	}
+}
+void RollingHistogram::Clear()
+{
+	std::fill(m_SliceBuckets.begin(), m_SliceBuckets.end(), 0);
+	std::fill(m_SliceCounts.begin(), m_SliceCounts.end(), 0);
+	std::fill(m_SliceSums.begin(), m_SliceSums.end(), 0);
+	std::fill(m_TotalBuckets.begin(), m_TotalBuckets.end(), 0);
+	m_TotalCount = 0;
+	m_TotalSum = 0;
+	m_SliceElapsed = 0;
+}
+
+RollingHistogram::Summary RollingHistogram::GetSummary() const
+{
+	Summary summary{};
+	summary.count = m_TotalCount;
+	if (m_TotalCount == 0) return summary;
+
+	summary.mean = static_cast<double>(m_TotalSum) / m_TotalCount;
+
+	// Rank of each percentile, rounded up so p99.9 of a short window is its maximum
+	const double fractions[]{ 0.5, 0.9, 0.99, 0.999 };
+	int64_t* pResults[]{ &summary.p50, &summary.p90, &summary.p99, &summary.p999 };
+
+	uint32_t nextPercentile{};
+	uint64_t cumulativeCount{};
+	for (uint32_t bucketIndex{}; bucketIndex < g_BucketCount; ++bucketIndex)
+	{
+		const uint64_t bucketCount{ m_TotalBuckets[bucketIndex] };
+		if (bucketCount == 0) continue;
+
+		cumulativeCount += bucketCount;
+		const int64_t upperBound{ GetBucketUpperBound(bucketIndex) };
+		while (nextPercentile < std::size(fractions) && cumulativeCount >= static_cast<uint64_t>(std::ceil(fractions[nextPercentile] * m_TotalCount)))
+		{
+			*pResults[nextPercentile++] = upperBound;
+		}
+		summary.max = upperBound;
+	}
+
+	return summary;
+}
+
+uint32_t RollingHistogram::GetBucketIndex(int64_t value)
+{
+	const uint64_t clamped{ static_cast<uint64_t>(std::clamp<int64_t>(value, 0, g_MaxValue)) };
+	if (clamped < g_LinearBuckets) return static_cast<uint32_t>(clamped);
+
+	// The shift keeps the value in [32, 64), one group of 32 buckets per shift
+	const uint32_t shift{ static_cast<uint32_t>(std::bit_width(clamped)) - 6 };
+	return g_LinearBuckets + (shift - 1) * g_SubBuckets + static_cast<uint32_t>((clamped >> shift) - g_SubBuckets);
+}
+int64_t RollingHistogram::GetBucketUpperBound(uint32_t bucketIndex)
+{
+	if (bucketIndex < g_LinearBuckets) return bucketIndex;
+
+	const uint32_t groupIndex{ bucketIndex - g_LinearBuckets };
+	const uint32_t shift{ groupIndex / g_SubBuckets + 1 };
+	const int64_t subBucket{ groupIndex % g_SubBuckets + g_SubBuckets };
+	return ((subBucket + 1) << shift) - 1;
+}
+
+// Privates
+// --------
+void RollingHistogram::DropSlice(uint32_t sliceIndex)
+{
+	uint32_t* pBuckets{ m_SliceBuckets.data() + size_t{ sliceIndex } * g_BucketCount };
+	for (uint32_t bucketIndex{}; bucketIndex < g_BucketCount; ++bucketIndex)
+	{
+		m_TotalBuckets[bucketIndex] -= pBuckets[bucketIndex];
+		pBuckets[bucketIndex] = 0;
+	}
+
+	m_TotalCount -= m_SliceCounts[sliceIndex];
+	m_TotalSum -= m_SliceSums[sliceIndex];
+	m_SliceCounts[sliceIndex] = 0;
+	m_SliceSums[sliceIndex] = 0;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// HDR style histogram of integer values (microseconds for frame times) over a rolling window
+// Buckets are exact below 64, then 32 per power of two, so every value keeps ~3% relative precision up to a minute
+// The window is split in slices, the oldest slice is dropped as a whole and the totals are kept up to date incrementally
+class RollingHistogram final
+{
+public:
+	// Structs
+	struct Summary
+	{
+		uint64_t count;
+		double mean;
+		int64_t p50;		// Percentiles are the highest value of their bucket, so they never under report
+		int64_t p90;
+		int64_t p99;
+		int64_t p999;
+		int64_t max;
+	};
+
+	static constexpr int64_t g_MaxValue{ (int64_t{ 1 } << 26) - 1 };	// Larger values are clamped
+	static constexpr uint32_t g_BucketCount{ 64 + 20 * 32 };
+
+	// Rule of five
+	RollingHistogram(uint32_t sliceCount, int64_t sliceDuration);
+	~RollingHistogram() = default;
+
+	RollingHistogram(const RollingHistogram& other) = delete;
+	RollingHistogram(RollingHistogram&& other) = delete;
+	RollingHistogram& operator= (const RollingHistogram& other) = delete;
+	RollingHistogram& operator= (RollingHistogram&& other) = delete;
+
+	// Publics
+	void Record(int64_t value);
+	void Advance(int64_t elapsed);		// Same unit as the slice duration, drops the slices that fell out of the window
+	void Clear();
+
+	Summary GetSummary() const;			// One pass over the buckets
+	uint64_t GetCount() const { return m_TotalCount; }
+
+	static uint32_t GetBucketIndex(int64_t value);
+	static int64_t GetBucketUpperBound(uint32_t bucketIndex);
+
+private:
+	// Member variables
+	uint32_t m_SliceCount;
+	int64_t m_SliceDuration;
+
+	std::vector<uint32_t> m_SliceBuckets;	// g_BucketCount per slice
+	std::vector<uint64_t> m_SliceCounts;
+	std::vector<int64_t> m_SliceSums;
+
+	std::vector<uint64_t> m_TotalBuckets;	// Sum of every slice
+	uint64_t m_TotalCount;
+	int64_t m_TotalSum;
+
+	uint32_t m_CurrentSlice;
+	int64_t m_SliceElapsed;
+
+	// Member functions
+	void DropSlice(uint32_t sliceIndex);
+};
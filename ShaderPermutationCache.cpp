@@ -0,0 +1,320 @@
+#include "ShaderPermutationCache.h"
+#include "Logger.h"
+#include "Hash.h"
+
+#include <ppl.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+	constexpr uint32_t g_CacheFileMagic{ 0x31565053 };	// "SPV1"
+
+	std::wstring Widen(const std::string& string)
+	{
+		return std::wstring(string.begin(), string.end());
+	}
+}
+
+void ShaderPermutationCache::Initialize(const CompileFunction& compile, const std::string& vertexProfile, const std::string& pixelProfile)
+{
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	m_Compile = compile;
+	m_Profiles[static_cast<size_t>(ShaderStage::Vertex)] = vertexProfile;
+	m_Profiles[static_cast<size_t>(ShaderStage::Pixel)] = pixelProfile;
+}
+bool ShaderPermutationCache::LoadFromFile(const std::wstring& filePath)
+{
+	const auto startTime{ std::chrono::steady_clock::now() };
+
+	std::vector<char> fileBytes;
+	if (!utils::ReadBinaryFile(filePath, fileBytes))
+	{
+		Logger::Log(L"No compiled shader cache found, every shader variant will be compiled");
+		return false;
+	}
+
+	// Header, then per entry its key, size and bytecode
+	size_t offset{};
+	auto read = [&](void* pValue, size_t size)
+	{
+		if (offset + size > fileBytes.size()) return false;
+		std::memcpy(pValue, fileBytes.data() + offset, size);
+		offset += size;
+		return true;
+	};
+
+	uint32_t magic{};
+	uint32_t entryCount{};
+	if (!read(&magic, sizeof(magic)) || magic != g_CacheFileMagic || !read(&entryCount, sizeof(entryCount)))
+	{
+		Logger::Log(L"ERROR - Compiled shader cache is invalid, ignoring it");
+		return false;
+	}
+
+	std::unordered_map<uint64_t, std::vector<char>> entries;
+	for (uint32_t entryIndex{}; entryIndex < entryCount; ++entryIndex)
+	{
+		uint64_t key{};
+		uint32_t size{};
+		if (!read(&key, sizeof(key)) || !read(&size, sizeof(size)) || offset + size > fileBytes.size())
+		{
+			Logger::Log(L"ERROR - Compiled shader cache is truncated, ignoring it");
+			return false;
+		}
+
+		entries[key].assign(fileBytes.data() + offset, fileBytes.data() + offset + size);
+		offset += size;
+	}
+
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	m_FileEntries = std::move(entries);
+	m_Statistics.loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	return true;
+}
+bool ShaderPermutationCache::SaveToFile(const std::wstring& filePath)
+{
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	if (!m_Dirty) return true;
+
+	// Written next to the target and renamed over it, a crash never leaves half a cache
+	const std::filesystem::path targetPath{ filePath };
+	std::filesystem::path temporaryPath{ targetPath };
+	temporaryPath += L".tmp";
+	{
+		std::ofstream file{ temporaryPath, std::ios::binary | std::ios::trunc };
+		if (!file)
+		{
+			Logger::Log(L"ERROR - Failed to open the compiled shader cache for writing");
+			return false;
+		}
+
+		uint32_t entryCount{};
+		for (const Shader& shader : m_Shaders)
+		{
+			for (const Variant& variant : shader.variants) entryCount += variant.state == VariantState::Ready ? 1 : 0;
+		}
+
+		file.write(reinterpret_cast<const char*>(&g_CacheFileMagic), sizeof(g_CacheFileMagic));
+		file.write(reinterpret_cast<const char*>(&entryCount), sizeof(entryCount));
+
+		for (const Shader& shader : m_Shaders)
+		{
+			for (uint32_t featureMask{}; featureMask < shader.variants.size(); ++featureMask)
+			{
+				const Variant& variant = shader.variants[featureMask];
+				if (variant.state != VariantState::Ready) continue;
+
+				const uint64_t key{ GetVariantKey(shader, featureMask) };
+				const uint32_t size{ static_cast<uint32_t>(variant.bytecode.size()) };
+				file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+				file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+				file.write(variant.bytecode.data(), size);
+			}
+		}
+
+		if (!file) return false;
+	}
+
+	std::error_code error{};
+	std::filesystem::rename(temporaryPath, targetPath, error);
+	if (error) return false;
+
+	m_Dirty = false;
+	return true;
+}
+uint32_t ShaderPermutationCache::AddShader(const ShaderDescription& description, const utils::ResourceReader& readResource)
+{
+	if (description.features.size() > g_MaxFeatures)
+	{
+		Logger::Log(L"ERROR - Shader " + description.sourceName + L" declares too many features");
+		return g_NoShader;
+	}
+
+	Shader shader{};
+	if (!readResource(description.sourceName, shader.source) || shader.source.empty())
+	{
+		Logger::Log(L"ERROR - Failed to read the shader source " + description.sourceName);
+		return g_NoShader;
+	}
+
+	shader.description = description;
+	shader.sourceName.assign(description.sourceName.begin(), description.sourceName.end());
+	shader.sourceHash = hashing::Fnv1a(shader.source.data(), shader.source.size());
+	shader.variants.resize(size_t{ 1 } << description.features.size());
+
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	m_Shaders.push_back(std::move(shader));
+	++m_Statistics.shaderCount;
+	return static_cast<uint32_t>(m_Shaders.size() - 1);
+}
+void ShaderPermutationCache::Precompile(const std::vector<VariantRequest>& variants)
+{
+	const auto startTime{ std::chrono::steady_clock::now() };
+
+	// Held throughout, the workers only write the variant they compile
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+
+	std::vector<VariantRequest> compiles;
+	for (const VariantRequest& request : variants)
+	{
+		if (request.shader >= m_Shaders.size() || request.featureMask >= m_Shaders[request.shader].variants.size()) continue;
+
+		Shader& shader = m_Shaders[request.shader];
+		Variant& variant = shader.variants[request.featureMask];
+		if (variant.state != VariantState::Missing) continue;
+
+		if (TakeFromFile(shader, request.featureMask, variant)) FinishVariant(shader, request.featureMask, variant);
+		else compiles.push_back(request);
+	}
+
+	// Requests for the same variant compile once
+	std::sort(compiles.begin(), compiles.end(), [](const VariantRequest& first, const VariantRequest& second)
+	{
+		return first.shader != second.shader ? first.shader < second.shader : first.featureMask < second.featureMask;
+	});
+	compiles.erase(std::unique(compiles.begin(), compiles.end(), [](const VariantRequest& first, const VariantRequest& second)
+	{
+		return first.shader == second.shader && first.featureMask == second.featureMask;
+	}), compiles.end());
+
+	Concurrency::parallel_for(static_cast<size_t>(0), compiles.size(), [&](size_t compileIndex)
+	{
+		const VariantRequest& request = compiles[compileIndex];
+		const Shader& shader = m_Shaders[request.shader];
+		CompileVariant(shader, request.featureMask, m_Shaders[request.shader].variants[request.featureMask]);
+	});
+
+	for (const VariantRequest& request : compiles)
+	{
+		FinishVariant(m_Shaders[request.shader], request.featureMask, m_Shaders[request.shader].variants[request.featureMask]);
+	}
+
+	m_Statistics.precompileMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+const std::vector<char>* ShaderPermutationCache::GetBytecode(uint32_t shaderIndex, uint32_t featureMask)
+{
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	if (shaderIndex >= m_Shaders.size() || featureMask >= m_Shaders[shaderIndex].variants.size()) return nullptr;
+
+	Shader& shader = m_Shaders[shaderIndex];
+	Variant& variant = shader.variants[featureMask];
+
+	// Nobody asked for it ahead of time, the caller waits for the compile
+	if (variant.state == VariantState::Missing)
+	{
+		if (!TakeFromFile(shader, featureMask, variant))
+		{
+			CompileVariant(shader, featureMask, variant);
+			m_Statistics.stallMs += variant.compileMs;
+			++m_Statistics.stallCount;
+		}
+		FinishVariant(shader, featureMask, variant);
+	}
+
+	return variant.state == VariantState::Ready ? &variant.bytecode : nullptr;
+}
+std::wstring ShaderPermutationCache::GetVariantName(uint32_t shaderIndex, uint32_t featureMask) const
+{
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	if (shaderIndex >= m_Shaders.size()) return std::wstring{};
+
+	const Shader& shader = m_Shaders[shaderIndex];
+	std::wstring name{ shader.description.sourceName };
+	for (const std::string& define : GetDefines(shader, featureMask)) name += L"+" + Widen(define);
+	return name;
+}
+void ShaderPermutationCache::LogStatistics() const
+{
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+
+	std::wstringstream message;
+	message << L"Shader permutations: " << m_Statistics.shaderCount << L" shaders, " << m_Statistics.variantCount << L" variants ("
+		<< m_Statistics.compiledCount << L" compiled, " << m_Statistics.cachedCount << L" from the cache, " << m_Statistics.failedCount << L" failed), "
+		<< m_Statistics.precompileMs << L" ms stalled precompiling and " << m_Statistics.stallMs << L" ms on " << m_Statistics.stallCount
+		<< L" first-use compiles, " << m_Statistics.compileMs << L" ms compiling in total, cache read in " << m_Statistics.loadMs << L" ms";
+	Logger::Log(message.str());
+}
+uint64_t ShaderPermutationCache::HashVariant(uint64_t sourceHash, const std::string& entryPoint, const std::string& profile, const std::vector<std::string>& defines)
+{
+	hashing::Hasher hasher{};
+	hasher.Add(sourceHash).AddString(entryPoint.c_str()).AddString(profile.c_str()).Add(defines.size());
+	for (const std::string& define : defines) hasher.AddString(define.c_str());
+	return hasher.Get();
+}
+
+// Privates
+// --------
+void ShaderPermutationCache::CompileVariant(const Shader& shader, uint32_t featureMask, Variant& variant) const
+{
+	const auto startTime{ std::chrono::steady_clock::now() };
+
+	const std::vector<std::string> defines{ GetDefines(shader, featureMask) };
+	std::vector<ShaderDefine> shaderDefines;
+	shaderDefines.reserve(defines.size());
+	for (const std::string& define : defines) shaderDefines.push_back(ShaderDefine{ define.c_str(), "1" });
+
+	const ShaderCompileDescription description
+	{
+		shader.source.data(),
+		shader.source.size(),
+		shader.sourceName.c_str(),
+		shader.description.entryPoint.c_str(),
+		m_Profiles[static_cast<size_t>(shader.description.stage)].c_str(),
+		shaderDefines.data(),
+		static_cast<uint32_t>(shaderDefines.size())
+	};
+
+	const bool compiled{ m_Compile && m_Compile(description, variant.bytecode, variant.errors) && !variant.bytecode.empty() };
+	variant.state = compiled ? VariantState::Ready : VariantState::Failed;
+	variant.fromFile = false;
+	variant.compileMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+void ShaderPermutationCache::FinishVariant(const Shader& shader, uint32_t featureMask, Variant& variant)
+{
+	if (variant.state == VariantState::Failed)
+	{
+		++m_Statistics.failedCount;
+		Logger::Log(L"ERROR - Failed to compile the shader variant " + shader.description.sourceName + L" (mask " + std::to_wstring(featureMask) + L"): " + Widen(variant.errors));
+		return;
+	}
+
+	++m_Statistics.variantCount;
+	if (variant.fromFile)
+	{
+		++m_Statistics.cachedCount;
+		return;
+	}
+
+	++m_Statistics.compiledCount;
+	m_Statistics.compileMs += variant.compileMs;
+	m_Dirty = true;
+}
+bool ShaderPermutationCache::TakeFromFile(const Shader& shader, uint32_t featureMask, Variant& variant)
+{
+	const auto foundIt = m_FileEntries.find(GetVariantKey(shader, featureMask));
+	if (foundIt == m_FileEntries.end()) return false;
+
+	variant.bytecode = std::move(foundIt->second);
+	variant.state = VariantState::Ready;
+	variant.fromFile = true;
+	m_FileEntries.erase(foundIt);
+	return true;
+}
+uint64_t ShaderPermutationCache::GetVariantKey(const Shader& shader, uint32_t featureMask) const
+{
+	return HashVariant(shader.sourceHash, shader.description.entryPoint, m_Profiles[static_cast<size_t>(shader.description.stage)], GetDefines(shader, featureMask));
+}
+std::vector<std::string> ShaderPermutationCache::GetDefines(const Shader& shader, uint32_t featureMask) const
+{
+	std::vector<std::string> defines;
+	for (size_t feature{}; feature < shader.description.features.size(); ++feature)
+	{
+		if (featureMask & (1u << feature)) defines.push_back(shader.description.features[feature]);
+	}
+	return defines;
+}
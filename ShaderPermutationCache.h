@@ -0,0 +1,125 @@
+#pragma once
+
+#include "RenderDevice.h"
+#include "Utils.h"
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Variants of HLSL shaders that declare optional features, each feature is a define and a variant is the set of features it enables
+// Every shader keeps a table of 2^featureCount variants indexed by the feature mask, so a lookup is one index
+// Variants are compiled on the workers ahead of time, or on first use when nobody asked for them before; both stalls are measured
+// Compiled bytecode is persisted keyed by a hash of the source, entry point, profile and defines, so only edited shaders compile again
+class ShaderPermutationCache final
+{
+public:
+	// Structs
+	struct ShaderDescription
+	{
+		std::wstring sourceName;			// Read through the resource reader
+		std::string entryPoint;
+		ShaderStage stage;
+		std::vector<std::string> features;	// Feature i is bit i of the variant mask, defined as 1 when set
+	};
+
+	struct VariantRequest
+	{
+		uint32_t shader;
+		uint32_t featureMask;
+	};
+
+	struct Statistics
+	{
+		uint32_t shaderCount;
+		uint32_t variantCount;			// Compiled or loaded
+		uint32_t compiledCount;
+		uint32_t cachedCount;			// Taken from the file instead of compiled
+		uint32_t failedCount;
+		double loadMs;					// Reading the file
+		double precompileMs;			// Wall time of the ahead of time compiles
+		double compileMs;				// Summed over the workers
+		double stallMs;					// First-use compiles that blocked the caller
+		uint32_t stallCount;
+	};
+
+	using CompileFunction = std::function<bool(const ShaderCompileDescription& description, std::vector<char>& bytecode, std::string& errors)>;
+
+	static constexpr uint32_t g_NoShader{ 0xFFFFFFFF };
+	static constexpr uint32_t g_MaxFeatures{ 8 };		// 256 variants, the table stays small
+
+	// Rule of five
+	ShaderPermutationCache() = default;
+	~ShaderPermutationCache() = default;
+
+	ShaderPermutationCache(const ShaderPermutationCache& other) = delete;
+	ShaderPermutationCache(ShaderPermutationCache&& other) = delete;
+	ShaderPermutationCache& operator= (const ShaderPermutationCache& other) = delete;
+	ShaderPermutationCache& operator= (ShaderPermutationCache&& other) = delete;
+
+	// Publics
+	// Thread-safe from here on, the compile function is called from the workers
+	void Initialize(const CompileFunction& compile, const std::string& vertexProfile, const std::string& pixelProfile);
+	bool LoadFromFile(const std::wstring& filePath);	// Missing or stale files only mean compiling everything
+	bool SaveToFile(const std::wstring& filePath);		// Every variant held, only writes when something was compiled since the load
+
+	uint32_t AddShader(const ShaderDescription& description, const utils::ResourceReader& readResource);	// g_NoShader when the source can't be read
+	void Precompile(const std::vector<VariantRequest>& variants);	// Blocks until they are done, missing ones compile in parallel
+
+	const std::vector<char>* GetBytecode(uint32_t shader, uint32_t featureMask);	// Compiles on first use, nullptr when the variant failed, stays valid as long as the cache
+	std::wstring GetVariantName(uint32_t shader, uint32_t featureMask) const;		// Source name and the features, for the device objects
+
+	const Statistics& GetStatistics() const { return m_Statistics; }
+	void LogStatistics() const;
+
+	// Stable key, exposed so it can be checked without a device
+	static uint64_t HashVariant(uint64_t sourceHash, const std::string& entryPoint, const std::string& profile, const std::vector<std::string>& defines);
+
+private:
+	// Structs
+	enum class VariantState : uint8_t
+	{
+		Missing,
+		Ready,
+		Failed							// Not retried, the error was logged once
+	};
+
+	struct Variant
+	{
+		std::vector<char> bytecode;
+		std::string errors;				// Logged by the caller, not the worker
+		VariantState state;
+		bool fromFile;
+		double compileMs;
+	};
+
+	struct Shader
+	{
+		ShaderDescription description;
+		std::string sourceName;			// Narrow, for the compiler messages
+		std::vector<char> source;
+		uint64_t sourceHash;
+		std::vector<Variant> variants;	// Indexed by the feature mask
+	};
+
+	// Member variables
+	CompileFunction m_Compile{};
+	std::string m_Profiles[2]{};		// Per ShaderStage
+
+	mutable std::mutex m_Mutex{};
+	std::vector<Shader> m_Shaders{};
+	std::unordered_map<uint64_t, std::vector<char>> m_FileEntries{};	// Loaded but not asked for yet
+	bool m_Dirty{ false };
+
+	Statistics m_Statistics{};
+
+	// Member functions
+	void CompileVariant(const Shader& shader, uint32_t featureMask, Variant& variant) const;	// Doesn't touch the shared state
+	void FinishVariant(const Shader& shader, uint32_t featureMask, Variant& variant);	// Counts it and logs the errors
+	bool TakeFromFile(const Shader& shader, uint32_t featureMask, Variant& variant);
+	uint64_t GetVariantKey(const Shader& shader, uint32_t featureMask) const;
+	std::vector<std::string> GetDefines(const Shader& shader, uint32_t featureMask) const;
+};
@@ -0,0 +1,310 @@
+#include "ShadowBenchmark.h"
+#include "BoundingVolumeHierarchy.h"
+#include "Logger.h"
+#include "MultiViewCuller.h"
+#include "SoftwareRasterizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sstream>
+
+using namespace math;
+
+namespace
+{
+	constexpr uint32_t g_ObjectCount{ 16384 };
+	constexpr uint32_t g_PathFrames{ 512 };
+	constexpr uint32_t g_StabilityFrames{ 256 };
+	constexpr uint32_t g_ReceiversPerCaster{ 256 };
+
+	constexpr ShadowCascades::Settings g_Settings{ 4, 1024, 0.7f, 60.f };
+	constexpr Float3 g_LightDirection{ 0.3224f, -0.9211f, 0.2303f };	// Normalized
+	constexpr Float4 g_Viewport{ 0.f, 0.f, 1280.f, 720.f };
+
+	constexpr float g_CasterHalfSize{ 1.f };
+	constexpr float g_AlignmentTolerance{ 1e-2f };	// In texels
+	constexpr float g_EdgeMargin{ 3.f };			// Texels around a shadow edge that aren't checked
+
+	// Where a point falls in the light's texels, for the snapping checks
+	Float2 GetTexelPosition(const RenderView& view, const Float3& position)
+	{
+		Float4 clip{};
+		StoreFloat4(&clip, Vector4Transform(VectorSet(position.x, position.y, position.z, 1.f), LoadFloat4x4(&view.viewProjectionMatrix)));
+		return Float2{ (clip.x * 0.5f + 0.5f) * view.viewportRect.z, (0.5f - clip.y * 0.5f) * view.viewportRect.w };
+	}
+
+	float GetFraction(float value)
+	{
+		return value - std::floor(value);
+	}
+}
+
+ShadowBenchmark::ShadowBenchmark()
+	: m_Cascades{ g_Settings }
+	, m_Result{}
+{
+}
+
+bool ShadowBenchmark::Run()
+{
+	m_Result = Result{};
+
+	TimeFitting();
+	CheckStability();
+	CheckShadowing();
+
+	return LogResults();
+}
+
+// Privates
+// --------
+void ShadowBenchmark::TimeFitting()
+{
+	using namespace std::chrono;
+
+	std::mt19937 randomEngine{ 1337 };	// Fixed seed, same objects every run
+	std::uniform_real_distribution<float> ground{ -100.f, 100.f };
+	std::uniform_real_distribution<float> height{ 0.f, 10.f };
+	std::uniform_real_distribution<float> size{ 0.25f, 2.f };
+
+	// Scene bounds come from the object hierarchy, like in the renderer
+	std::vector<Float4> spheres(g_ObjectCount);
+	std::vector<BoundingVolumeHierarchy::Bounds> bounds(g_ObjectCount);
+	for (uint32_t objectIndex{}; objectIndex < g_ObjectCount; ++objectIndex)
+	{
+		Float4& sphere = spheres[objectIndex];
+		sphere = Float4{ ground(randomEngine), height(randomEngine), ground(randomEngine), size(randomEngine) };
+		bounds[objectIndex] = BoundingVolumeHierarchy::Bounds{ Float3{ sphere.x - sphere.w, sphere.y - sphere.w, sphere.z - sphere.w },
+			Float3{ sphere.x + sphere.w, sphere.y + sphere.w, sphere.z + sphere.w } };
+	}
+
+	BoundingVolumeHierarchy hierarchy{};
+	hierarchy.Build(bounds);
+
+	MultiViewCuller culler{};
+	culler.SetObjects(spheres);
+
+	// Circling the scene while looking across it
+	double fitSeconds{};
+	double cullSeconds{};
+	for (uint32_t frame{}; frame < g_PathFrames; ++frame)
+	{
+		const float angle{ g_2Pi * frame / g_PathFrames };
+		const Float3 position{ 60.f * std::cos(angle), 3.f, 60.f * std::sin(angle) };
+		const Float3 forward{ -std::cos(angle + 0.5f), -0.15f, -std::sin(angle + 0.5f) };
+		const RenderView camera{ RenderView::CreatePerspective(position, forward, Float3{ 0.f, 1.f, 0.f }, ConvertToRadians(45.f), 0.1f, 100.f, g_Viewport) };
+
+		const steady_clock::time_point fitStart{ steady_clock::now() };
+		m_Cascades.Update(camera, g_LightDirection, hierarchy.GetBounds());
+		const steady_clock::time_point cullStart{ steady_clock::now() };
+		culler.Cull(m_Cascades.GetViews());
+		const steady_clock::time_point cullEnd{ steady_clock::now() };
+
+		fitSeconds += duration<double>(cullStart - fitStart).count();
+		cullSeconds += duration<double>(cullEnd - cullStart).count();
+
+		for (uint32_t cascadeIndex{}; cascadeIndex < m_Cascades.GetViews().size(); ++cascadeIndex)
+		{
+			m_Result.casters[cascadeIndex] += static_cast<double>(culler.GetVisibleObjects(cascadeIndex).size()) / g_PathFrames;
+		}
+	}
+
+	m_Result.objectCount = g_ObjectCount;
+	m_Result.frameCount = g_PathFrames;
+	m_Result.cascadeCount = static_cast<uint32_t>(m_Cascades.GetViews().size());
+	m_Result.fitUs = fitSeconds * 1e6 / g_PathFrames;
+	m_Result.cullUs = cullSeconds * 1e6 / g_PathFrames;
+}
+void ShadowBenchmark::CheckStability()
+{
+	const BoundingVolumeHierarchy::Bounds sceneBounds{ Float3{ -100.f, 0.f, -100.f }, Float3{ 100.f, 10.f, 100.f } };
+	const Float3 up{ 0.f, 1.f, 0.f };
+	const Float3 probe{ 5.f, 0.f, 10.f };
+
+	// Moves far smaller than a texel, a fixed point has to stay at the same spot inside its texel
+	std::vector<Float2> referenceFractions;
+	for (uint32_t frame{}; frame < g_StabilityFrames; ++frame)
+	{
+		const Float3 position{ 5.f + 0.013f * frame, 3.f, -20.f + 0.007f * frame };
+		const RenderView camera{ RenderView::CreatePerspective(position, Float3{ 0.3f, -0.2f, 1.f }, up, ConvertToRadians(45.f), 0.1f, 100.f, g_Viewport) };
+		m_Cascades.Update(camera, g_LightDirection, sceneBounds);
+
+		bool isAligned{ true };
+		for (uint32_t cascadeIndex{}; cascadeIndex < m_Cascades.GetViews().size(); ++cascadeIndex)
+		{
+			const Float2 texel{ GetTexelPosition(m_Cascades.GetViews()[cascadeIndex], probe) };
+			const Float2 fraction{ GetFraction(texel.x), GetFraction(texel.y) };
+			if (frame == 0)
+			{
+				referenceFractions.push_back(fraction);
+				continue;
+			}
+
+			// A fraction right next to 0 may come back right next to 1
+			const float errorX{ std::fabs(fraction.x - referenceFractions[cascadeIndex].x) };
+			const float errorY{ std::fabs(fraction.y - referenceFractions[cascadeIndex].y) };
+			if ((std::min)(errorX, 1.f - errorX) > g_AlignmentTolerance || (std::min)(errorY, 1.f - errorY) > g_AlignmentTolerance) isAligned = false;
+		}
+
+		if (frame == 0) continue;
+		++m_Result.movedFrames;
+		if (isAligned) ++m_Result.alignedFrames;
+	}
+
+	// A full turn on the spot, the cascades may move but never change size
+	std::vector<float> referenceRadii;
+	for (uint32_t frame{}; frame < g_StabilityFrames; ++frame)
+	{
+		const float yaw{ g_2Pi * frame / g_StabilityFrames };
+		const float pitch{ 0.4f * std::sin(3.f * yaw) };
+		const Float3 forward{ std::sin(yaw) * std::cos(pitch), std::sin(pitch), std::cos(yaw) * std::cos(pitch) };
+		const RenderView camera{ RenderView::CreatePerspective(Float3{ 5.f, 3.f, -20.f }, forward, up, ConvertToRadians(45.f), 0.1f, 100.f, g_Viewport) };
+		m_Cascades.Update(camera, g_LightDirection, sceneBounds);
+
+		bool isStable{ true };
+		for (uint32_t cascadeIndex{}; cascadeIndex < m_Cascades.GetCascades().size(); ++cascadeIndex)
+		{
+			const float radius{ m_Cascades.GetCascades()[cascadeIndex].radius };
+			if (frame == 0) referenceRadii.push_back(radius);
+			else if (radius != referenceRadii[cascadeIndex]) isStable = false;
+		}
+
+		if (frame == 0) continue;
+		++m_Result.turnedFrames;
+		if (isStable) ++m_Result.stableSizeFrames;
+	}
+}
+void ShadowBenchmark::CheckShadowing()
+{
+	using namespace std::chrono;
+
+	// A ground plane and a few floating squares spread over the cascades
+	const Float3 casterCenters[]{ { 0.f, 1.5f, 3.f }, { -3.f, 2.f, 9.f }, { 4.f, 2.5f, 18.f }, { -6.f, 3.f, 32.f }, { 8.f, 3.5f, 50.f } };
+	const float groundSize{ 150.f };
+
+	std::vector<Float4> positions{ { -groundSize, 0.f, -groundSize, 1.f }, { -groundSize, 0.f, groundSize, 1.f }, { groundSize, 0.f, groundSize, 1.f }, { groundSize, 0.f, -groundSize, 1.f } };
+	for (const Float3& center : casterCenters)
+	{
+		positions.push_back(Float4{ center.x - g_CasterHalfSize, center.y, center.z - g_CasterHalfSize, 1.f });
+		positions.push_back(Float4{ center.x - g_CasterHalfSize, center.y, center.z + g_CasterHalfSize, 1.f });
+		positions.push_back(Float4{ center.x + g_CasterHalfSize, center.y, center.z + g_CasterHalfSize, 1.f });
+		positions.push_back(Float4{ center.x + g_CasterHalfSize, center.y, center.z - g_CasterHalfSize, 1.f });
+	}
+
+	std::vector<uint32_t> indices;
+	for (uint32_t quad{}; quad < positions.size() / 4; ++quad)
+	{
+		const uint32_t first{ quad * 4 };
+		indices.insert(indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 });
+	}
+
+	const RenderView camera{ RenderView::CreatePerspective(Float3{ 0.f, 6.f, -4.f }, Float3{ 0.f, -0.35f, 1.f }, Float3{ 0.f, 1.f, 0.f },
+		ConvertToRadians(60.f), 0.1f, 100.f, g_Viewport) };
+	m_Cascades.Update(camera, g_LightDirection, BoundingVolumeHierarchy::Bounds{ Float3{ -groundSize, 0.f, -groundSize }, Float3{ groundSize, 3.5f, groundSize } });
+
+	// Depth passes, the casters are drawn with the same bias as in the renderer
+	const uint32_t resolution{ m_Cascades.GetSettings().resolution };
+	const SoftwareRasterizer::DrawState drawState{ false, true, true, false, false, 0, ShadowCascades::g_DepthBias, ShadowCascades::g_SlopeScaledDepthBias };
+
+	SoftwareRasterizer rasterizer{};
+	std::vector<std::vector<float>> depthMaps(m_Cascades.GetViews().size());
+	std::vector<Float4> clipPositions(positions.size());
+
+	const steady_clock::time_point depthStart{ steady_clock::now() };
+	for (uint32_t cascadeIndex{}; cascadeIndex < depthMaps.size(); ++cascadeIndex)
+	{
+		depthMaps[cascadeIndex].resize(static_cast<size_t>(resolution) * resolution);
+		rasterizer.BindDepthTarget(depthMaps[cascadeIndex].data(), resolution, resolution, true);
+
+		Vector4TransformStream(clipPositions.data(), positions.data(), positions.size(), LoadFloat4x4(&m_Cascades.GetViews()[cascadeIndex].viewProjectionMatrix));
+		rasterizer.DrawTriangles(clipPositions.data(), indices.data(), static_cast<uint32_t>(indices.size()), drawState);
+	}
+	m_Result.depthPassMs = duration<double, std::milli>(steady_clock::now() - depthStart).count();
+	m_Result.depthPixels = rasterizer.GetStatistics().shadedPixels;
+
+	// Ground points around every shadow, shadowed when the ray towards the light hits a square
+	std::mt19937 randomEngine{ 7 };
+	std::uniform_real_distribution<float> offset{ -3.f, 3.f };
+	const float towardsLight{ -1.f / g_LightDirection.y };	// Ray length per unit of height
+
+	for (const Float3& shadowingCaster : casterCenters)
+	{
+		const Float3 shadowCenter{ shadowingCaster.x + g_LightDirection.x * shadowingCaster.y * towardsLight, 0.f,
+			shadowingCaster.z + g_LightDirection.z * shadowingCaster.y * towardsLight };
+
+		for (uint32_t receiverIndex{}; receiverIndex < g_ReceiversPerCaster; ++receiverIndex)
+		{
+			const Float3 receiver{ shadowCenter.x + offset(randomEngine), 0.f, shadowCenter.z + offset(randomEngine) };
+
+			// Only what the camera sees inside the shadow distance
+			Float4 cameraClip{};
+			StoreFloat4(&cameraClip, Vector4Transform(VectorSet(receiver.x, receiver.y, receiver.z, 1.f), LoadFloat4x4(&camera.viewProjectionMatrix)));
+			if (cameraClip.w <= camera.nearZ || std::fabs(cameraClip.x) > cameraClip.w || std::fabs(cameraClip.y) > cameraClip.w) continue;
+
+			const std::vector<ShadowCascades::Cascade>& cascades = m_Cascades.GetCascades();
+			const auto cascade = std::find_if(cascades.begin(), cascades.end(), [&](const ShadowCascades::Cascade& candidate) { return cameraClip.w <= candidate.farDepth; });
+			if (cascade == cascades.end()) continue;
+
+			const uint32_t cascadeIndex{ static_cast<uint32_t>(cascade - cascades.begin()) };
+			const float margin{ g_EdgeMargin * cascade->texelSize * towardsLight };
+
+			bool isShadowed{ false };
+			bool isNearEdge{ false };
+			for (const Float3& caster : casterCenters)
+			{
+				const float distanceX{ std::fabs(receiver.x - g_LightDirection.x * caster.y * towardsLight - caster.x) };
+				const float distanceZ{ std::fabs(receiver.z - g_LightDirection.z * caster.y * towardsLight - caster.z) };
+				if (distanceX <= g_CasterHalfSize && distanceZ <= g_CasterHalfSize) isShadowed = true;
+				if ((std::fabs(distanceX - g_CasterHalfSize) < margin && distanceZ < g_CasterHalfSize + margin)
+					|| (std::fabs(distanceZ - g_CasterHalfSize) < margin && distanceX < g_CasterHalfSize + margin)) isNearEdge = true;
+			}
+			if (isNearEdge) continue;
+
+			// Compared like the LESS_EQUAL sampler does, without filtering
+			const RenderView& view = m_Cascades.GetViews()[cascadeIndex];
+			Float4 lightClip{};
+			StoreFloat4(&lightClip, Vector4Transform(VectorSet(receiver.x, receiver.y, receiver.z, 1.f), LoadFloat4x4(&view.viewProjectionMatrix)));
+			const int32_t texelX{ static_cast<int32_t>(std::floor((lightClip.x * 0.5f + 0.5f) * resolution)) };
+			const int32_t texelY{ static_cast<int32_t>(std::floor((0.5f - lightClip.y * 0.5f) * resolution)) };
+
+			bool isMapShadowed{ false };
+			if (texelX >= 0 && texelY >= 0 && texelX < static_cast<int32_t>(resolution) && texelY < static_cast<int32_t>(resolution))
+			{
+				isMapShadowed = lightClip.z > depthMaps[cascadeIndex][static_cast<size_t>(texelY) * resolution + texelX];
+			}
+
+			++m_Result.checkedReceivers;
+			if (isShadowed) ++m_Result.shadowedReceivers;
+			if (isShadowed == isMapShadowed) ++m_Result.matchingReceivers;
+		}
+	}
+}
+bool ShadowBenchmark::LogResults() const
+{
+	const Result& result = m_Result;
+
+	std::wstringstream message;
+	message << L"Shadow benchmark: " << result.cascadeCount << L" cascades over " << result.objectCount << L" objects, "
+		<< result.fitUs << L" us fitting and " << result.cullUs << L" us culling casters per frame, casters per cascade";
+	for (uint32_t cascadeIndex{}; cascadeIndex < result.cascadeCount; ++cascadeIndex) message << (cascadeIndex == 0 ? L" " : L"/") << std::lround(result.casters[cascadeIndex]);
+	Logger::Log(message.str());
+
+	message.str(L"");
+	message << L"Shadow benchmark: " << result.alignedFrames << L" of " << result.movedFrames << L" sub-texel moves stayed on the texel grid, "
+		<< result.stableSizeFrames << L" of " << result.turnedFrames << L" turns kept the cascade sizes";
+	Logger::Log(message.str());
+
+	message.str(L"");
+	message << L"Shadow benchmark: depth passes wrote " << result.depthPixels << L" pixels in " << result.depthPassMs << L" ms, "
+		<< result.matchingReceivers << L" of " << result.checkedReceivers << L" receivers (" << result.shadowedReceivers
+		<< L" shadowed) match the analytic shadows";
+	Logger::Log(message.str());
+
+	const bool isStable{ result.alignedFrames == result.movedFrames && result.stableSizeFrames == result.turnedFrames };
+	const bool isMatching{ result.matchingReceivers == result.checkedReceivers };
+	if (!isStable) Logger::Log(L"ERROR - Shadow benchmark: the cascades shimmer");
+	if (!isMatching) Logger::Log(L"ERROR - Shadow benchmark: the depth passes disagree with the analytic shadows");
+	return isStable && isMatching;
+}
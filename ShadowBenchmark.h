@@ -0,0 +1,57 @@
+#pragma once
+
+#include "EngineMath.h"
+#include "ShadowCascades.h"
+
+#include <vector>
+
+// Times fitting the shadow cascades and culling their casters along a camera path
+// Checks the maps stay on their texel grid and keep their size as the camera moves, and compares rasterized shadows with analytic ones
+class ShadowBenchmark final
+{
+public:
+	// Structs
+	struct Result
+	{
+		uint32_t objectCount;
+		uint32_t frameCount;
+		uint32_t cascadeCount;
+		double fitUs;						// Per frame
+		double cullUs;
+		double casters[ShadowCascades::g_MaxCascades];	// Per frame
+		uint32_t alignedFrames;				// Sub-texel moves that kept every cascade on the texel grid
+		uint32_t movedFrames;
+		uint32_t stableSizeFrames;			// Turns that kept every cascade size
+		uint32_t turnedFrames;
+		uint64_t depthPixels;				// Written by the depth passes
+		double depthPassMs;
+		uint32_t matchingReceivers;
+		uint32_t checkedReceivers;
+		uint32_t shadowedReceivers;
+	};
+
+	// Rule of five
+	ShadowBenchmark();
+	~ShadowBenchmark() = default;
+
+	ShadowBenchmark(const ShadowBenchmark& other) = delete;
+	ShadowBenchmark(ShadowBenchmark&& other) = delete;
+	ShadowBenchmark& operator= (const ShadowBenchmark& other) = delete;
+	ShadowBenchmark& operator= (ShadowBenchmark&& other) = delete;
+
+	// Publics
+	bool Run();	// False when a check failed, the failures are logged as errors
+
+	const Result& GetResult() const { return m_Result; }
+
+private:
+	// Member variables
+	ShadowCascades m_Cascades;
+	Result m_Result;
+
+	// Member functions
+	void TimeFitting();
+	void CheckStability();
+	void CheckShadowing();
+	bool LogResults() const;
+};
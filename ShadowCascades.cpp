@@ -0,0 +1,129 @@
+#include "ShadowCascades.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+using namespace math;
+
+namespace
+{
+	constexpr float g_RadiusStep{ 1.f / 16.f };			// Radii are rounded up to this, float noise must not change the texel size
+	constexpr float g_ConeCullRadii{ 1000.f };			// How far back along the light the views are placed, in cascade radii
+	constexpr float g_MinDepthRange{ 1e-3f };
+}
+
+ShadowCascades::ShadowCascades(const Settings& settings)
+	: m_Settings{ settings }
+	, m_Views{}
+	, m_Cascades{}
+	, m_Statistics{}
+{
+	m_Settings.cascadeCount = std::clamp(m_Settings.cascadeCount, 1u, g_MaxCascades);
+	m_Settings.resolution = (std::max)(m_Settings.resolution, 2u);
+}
+
+void ShadowCascades::Update(const RenderView& camera, const Float3& lightDirection, const BoundingVolumeHierarchy::Bounds& sceneBounds)
+{
+	const std::chrono::steady_clock::time_point fitStart{ std::chrono::steady_clock::now() };
+
+	const uint32_t cascadeCount{ m_Settings.cascadeCount };
+	const float nearZ{ camera.nearZ };
+	const float farZ{ (std::max)((std::min)(camera.farZ, m_Settings.maxDistance), nearZ * 2.f) };
+	const float resolution{ static_cast<float>(m_Settings.resolution) };
+
+	const Matrix lightView{ GetLightViewMatrix(lightDirection) };
+	const Matrix lightToWorld{ MatrixTranspose(lightView) };	// Only a rotation
+	const Matrix cameraToLight{ MatrixInverse(LoadFloat4x4(&camera.viewMatrix)) * lightView };
+
+	// Corners of a slice are this far from the view axis per unit of depth, squared
+	const float tanHalfFov{ std::tan(0.5f * camera.fovRadians) };
+	const float diagonalSquared{ tanHalfFov * tanHalfFov * (1.f + camera.aspectRatio * camera.aspectRatio) };
+
+	// Depth range of the whole scene seen from the light, an inverted box means there is no scene
+	float sceneMinZ{ FLT_MAX };
+	float sceneMaxZ{ -FLT_MAX };
+	if (sceneBounds.minimum.x <= sceneBounds.maximum.x)
+	{
+		for (uint32_t corner{}; corner < 8; ++corner)
+		{
+			const Vector worldCorner
+			{
+				VectorSet(corner & 1 ? sceneBounds.maximum.x : sceneBounds.minimum.x,
+					corner & 2 ? sceneBounds.maximum.y : sceneBounds.minimum.y,
+					corner & 4 ? sceneBounds.maximum.z : sceneBounds.minimum.z, 1.f)
+			};
+			const float lightZ{ VectorGetZ(Vector3TransformCoord(worldCorner, lightView)) };
+			sceneMinZ = (std::min)(sceneMinZ, lightZ);
+			sceneMaxZ = (std::max)(sceneMaxZ, lightZ);
+		}
+	}
+
+	m_Views.resize(cascadeCount);
+	m_Cascades.resize(cascadeCount);
+	for (uint32_t cascadeIndex{}; cascadeIndex < cascadeCount; ++cascadeIndex)
+	{
+		Cascade& cascade = m_Cascades[cascadeIndex];
+		cascade.nearDepth = GetSplitDepth(cascadeIndex, cascadeCount, nearZ, farZ, m_Settings.splitLambda);
+		cascade.farDepth = GetSplitDepth(cascadeIndex + 1, cascadeCount, nearZ, farZ, m_Settings.splitLambda);
+
+		// Tightest sphere around the slice: on the view axis, as far from the near corners as from the far ones, but never past the far plane
+		// Only depends on the split depths and the field of view, turning the camera leaves it alone
+		const float nearDepth{ cascade.nearDepth };
+		const float farDepth{ cascade.farDepth };
+		const float centerDepth{ (std::min)(0.5f * (nearDepth + farDepth) * (1.f + diagonalSquared), farDepth) };
+		const float nearDistanceSquared{ nearDepth * nearDepth * diagonalSquared + (centerDepth - nearDepth) * (centerDepth - nearDepth) };
+		const float farDistanceSquared{ farDepth * farDepth * diagonalSquared + (farDepth - centerDepth) * (farDepth - centerDepth) };
+		cascade.radius = std::ceil(std::sqrt((std::max)(nearDistanceSquared, farDistanceSquared)) / g_RadiusStep) * g_RadiusStep;
+		cascade.texelSize = 2.f * cascade.radius / resolution;
+
+		// Snapped to the texel grid of light space, the edges of the map stay on whole texels as well
+		Float3 center{};
+		StoreFloat3(&center, Vector3TransformCoord(VectorSet(0.f, 0.f, centerDepth, 1.f), cameraToLight));
+		center.x = std::floor(center.x / cascade.texelSize) * cascade.texelSize;
+		center.y = std::floor(center.y / cascade.texelSize) * cascade.texelSize;
+		cascade.lightSpaceCenter = center;
+
+		// Casters between the light and the slice have to be in front of the near plane, receivers end at the back of the sphere
+		const float nearPlane{ (std::min)(sceneMinZ, center.z - cascade.radius) };
+		const float farPlane{ (std::max)((std::min)(sceneMaxZ, center.z + cascade.radius), nearPlane + g_MinDepthRange) };
+		const Matrix projection{ MatrixOrthographicOffCenterLH(center.x - cascade.radius, center.x + cascade.radius,
+			center.y - cascade.radius, center.y + cascade.radius, nearPlane, farPlane) };
+
+		RenderView& view = m_Views[cascadeIndex];
+		StoreFloat4x4(&view.viewMatrix, lightView);
+		StoreFloat4x4(&view.projectionMatrix, projection);
+		StoreFloat4x4(&view.viewProjectionMatrix, lightView * projection);
+
+		const Vector worldCenter{ Vector3TransformCoord(LoadFloat3(&center), lightToWorld) };
+		StoreFloat3(&view.position, VectorSubtract(worldCenter, VectorScale(LoadFloat3(&lightDirection), g_ConeCullRadii * cascade.radius)));
+
+		view.fovRadians = 0.f;
+		view.aspectRatio = 1.f;
+		view.nearZ = nearPlane;
+		view.farZ = farPlane;
+		view.viewportRect = Float4{ 0.f, 0.f, resolution, resolution };
+	}
+
+	m_Statistics.cascadeCount = cascadeCount;
+	m_Statistics.fitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - fitStart).count();
+}
+
+float ShadowCascades::GetSplitDepth(uint32_t split, uint32_t cascadeCount, float nearZ, float farZ, float lambda)
+{
+	if (split == 0) return nearZ;
+	if (split >= cascadeCount) return farZ;
+
+	// Practical split scheme, logarithmic keeps the texel density even but starves the far cascades
+	const float fraction{ static_cast<float>(split) / cascadeCount };
+	const float logarithmic{ nearZ * std::pow(farZ / nearZ, fraction) };
+	const float uniform{ nearZ + (farZ - nearZ) * fraction };
+	return lambda * logarithmic + (1.f - lambda) * uniform;
+}
+Matrix ShadowCascades::GetLightViewMatrix(const Float3& lightDirection)
+{
+	// Any up works as long as it stays the same, the snapping grid is tied to it
+	const Vector up{ std::fabs(lightDirection.y) > 0.99f ? VectorSet(0.f, 0.f, 1.f, 0.f) : VectorSet(0.f, 1.f, 0.f, 0.f) };
+	return MatrixLookToLH(VectorZero(), LoadFloat3(&lightDirection), up);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "BoundingVolumeHierarchy.h"
+#include "EngineMath.h"
+#include "RenderView.h"
+
+#include <cstdint>
+#include <vector>
+
+// Fits the cascades of a directional light's shadow map to a perspective camera, on the CPU
+// The camera range is split between uniform and logarithmic splits, every slice gets the tightest sphere around it,
+// so the cascade keeps its size however the camera turns; its center is snapped to whole texels in light space, so moving doesn't shimmer
+// Depth covers the scene bounds towards the light, every caster that can shade the slice lands in front of the far plane
+class ShadowCascades final
+{
+public:
+	// Structs
+	struct Settings
+	{
+		uint32_t cascadeCount;			// Up to g_MaxCascades
+		uint32_t resolution;			// Texels along a side, every cascade is square
+		float splitLambda;				// 0 gives uniform splits, 1 logarithmic ones
+		float maxDistance;				// Shadows end here, or at the camera's far plane when that is nearer
+	};
+
+	struct Cascade
+	{
+		float nearDepth;				// View depth of the camera slice
+		float farDepth;
+		float radius;					// Of the sphere around the slice, in world units
+		float texelSize;				// World units per shadow map texel
+		math::Float3 lightSpaceCenter;	// Snapped to whole texels
+	};
+
+	struct Statistics
+	{
+		uint32_t cascadeCount;
+		double fitMs;					// Of the last update
+	};
+
+	static constexpr uint32_t g_MaxCascades{ 4 };
+
+	// Casters are drawn with this bias into a float depth map, the slope part covers the texel a receiver falls between
+	static constexpr int32_t g_DepthBias{ 1000 };
+	static constexpr float g_SlopeScaledDepthBias{ 2.f };
+
+	// Rule of five
+	explicit ShadowCascades(const Settings& settings);
+	~ShadowCascades() = default;
+
+	ShadowCascades(const ShadowCascades& other) = delete;
+	ShadowCascades(ShadowCascades&& other) = delete;
+	ShadowCascades& operator= (const ShadowCascades& other) = delete;
+	ShadowCascades& operator= (ShadowCascades&& other) = delete;
+
+	// Publics
+	// The camera has to be a perspective view, the light direction points away from the light
+	void Update(const RenderView& camera, const math::Float3& lightDirection, const BoundingVolumeHierarchy::Bounds& sceneBounds);
+
+	// Orthographic, viewports cover the whole cascade; positions are far back along the light so cone tests see nearly parallel rays
+	const std::vector<RenderView>& GetViews() const { return m_Views; }
+	const std::vector<Cascade>& GetCascades() const { return m_Cascades; }
+	const Settings& GetSettings() const { return m_Settings; }
+	const Statistics& GetStatistics() const { return m_Statistics; }
+
+	static float GetSplitDepth(uint32_t split, uint32_t cascadeCount, float nearZ, float farZ, float lambda);	// Split 0 is nearZ, cascadeCount is farZ
+	static math::Matrix GetLightViewMatrix(const math::Float3& lightDirection);	// Light space at the origin, fixed for a direction
+
+private:
+	// Member variables
+	Settings m_Settings;
+	std::vector<RenderView> m_Views;
+	std::vector<Cascade> m_Cascades;
+	Statistics m_Statistics;
+};
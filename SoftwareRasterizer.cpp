@@ -0,0 +1,563 @@
+#include "SoftwareRasterizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	// Triangles reaching further than this many viewports out are clipped, so the fixed point coordinates can't overflow
+	constexpr float g_GuardBand{ 1024.f };
+
+	enum ClipBits : uint32_t
+	{
+		g_ClipNear = 1 << 0,
+		g_ClipLeft = 1 << 1,
+		g_ClipRight = 1 << 2,
+		g_ClipBottom = 1 << 3,
+		g_ClipTop = 1 << 4,
+		g_OutsideLeft = 1 << 5,			// Trivial rejection only, rasterizing handles these
+		g_OutsideRight = 1 << 6,
+		g_OutsideBottom = 1 << 7,
+		g_OutsideTop = 1 << 8,
+		g_OutsideFar = 1 << 9
+	};
+
+	constexpr uint32_t g_ClipMask{ g_ClipNear | g_ClipLeft | g_ClipRight | g_ClipBottom | g_ClipTop };
+
+	uint32_t GetClipBits(const math::Float4& position)
+	{
+		const float guardW{ g_GuardBand * position.w };
+
+		uint32_t bits{};
+		if (position.z < 0.f) bits |= g_ClipNear;
+		if (position.x < -guardW) bits |= g_ClipLeft;
+		if (position.x > guardW) bits |= g_ClipRight;
+		if (position.y < -guardW) bits |= g_ClipBottom;
+		if (position.y > guardW) bits |= g_ClipTop;
+		if (position.x < -position.w) bits |= g_OutsideLeft;
+		if (position.x > position.w) bits |= g_OutsideRight;
+		if (position.y < -position.w) bits |= g_OutsideBottom;
+		if (position.y > position.w) bits |= g_OutsideTop;
+		if (position.z > position.w) bits |= g_OutsideFar;
+		return bits;
+	}
+
+	// Distance to one clip plane, inside when positive
+	float GetPlaneDistance(const math::Float4& position, uint32_t planeBit)
+	{
+		switch (planeBit)
+		{
+		case g_ClipNear:	return position.z;
+		case g_ClipLeft:	return position.x + g_GuardBand * position.w;
+		case g_ClipRight:	return g_GuardBand * position.w - position.x;
+		case g_ClipBottom:	return position.y + g_GuardBand * position.w;
+		default:			return g_GuardBand * position.w - position.y;
+		}
+	}
+
+	math::Float4 Lerp(const math::Float4& a, const math::Float4& b, float t)
+	{
+		return math::Float4{ a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t };
+	}
+
+	// Rounded to a float before anything is added to it, so no compiler or flag can fuse it into a multiply-add that rounds once
+	float RoundProduct(float a, float b)
+	{
+		volatile float product{ a * b };
+		return product;
+	}
+
+	uint32_t BlendChannels(uint32_t a, uint32_t b, uint32_t weight)	// weight of b out of 256
+	{
+		const uint32_t redBlue{ (((a & 0x00FF00FF) * (256 - weight) + (b & 0x00FF00FF) * weight) >> 8) & 0x00FF00FF };
+		const uint32_t alphaGreen{ ((((a >> 8) & 0x00FF00FF) * (256 - weight) + ((b >> 8) & 0x00FF00FF) * weight)) & 0xFF00FF00 };
+		return redBlue | alphaGreen;
+	}
+}
+
+void SoftwareRasterizer::Resize(uint32_t width, uint32_t height)
+{
+	m_Width = width;
+	m_Height = height;
+	m_Color.assign(static_cast<size_t>(width) * height, 0);
+	m_Depth.assign(static_cast<size_t>(width) * height, 1.f);
+	m_Tiles.assign(static_cast<size_t>((width + g_TileSize - 1) >> g_TileBits) * ((height + g_TileSize - 1) >> g_TileBits), DepthTile{ 1.f, 1.f });
+
+	BindOwnTargets();
+}
+void SoftwareRasterizer::Clear(uint32_t color, float depth, uint32_t width, uint32_t height)
+{
+	width = (std::min)(width, m_Width);
+	height = (std::min)(height, m_Height);
+
+	for (uint32_t y{}; y < height; ++y)
+	{
+		const size_t rowStart{ static_cast<size_t>(y) * m_Width };
+		std::fill_n(m_Color.begin() + rowStart, width, color);
+		std::fill_n(m_Depth.begin() + rowStart, width, depth);
+	}
+
+	// Tiles reaching past the cleared part keep the depths out there
+	if (m_HierarchicalDepth) UpdateTiles(m_Depth.data(), m_Width, m_Height, m_Tiles.data(), 0, 0, width, height);
+}
+void SoftwareRasterizer::SetViewport(float x, float y, float width, float height)
+{
+	m_ViewportX = x;
+	m_ViewportY = y;
+	m_ViewportWidth = width;
+	m_ViewportHeight = height;
+
+	// Clip space ends at the viewport edges, nothing outside it is ever drawn
+	m_ScissorMinX = std::clamp(static_cast<int32_t>(std::lround(x)), 0, static_cast<int32_t>(m_TargetWidth));
+	m_ScissorMinY = std::clamp(static_cast<int32_t>(std::lround(y)), 0, static_cast<int32_t>(m_TargetHeight));
+	m_ScissorMaxX = std::clamp(static_cast<int32_t>(std::lround(x + width)), 0, static_cast<int32_t>(m_TargetWidth));
+	m_ScissorMaxY = std::clamp(static_cast<int32_t>(std::lround(y + height)), 0, static_cast<int32_t>(m_TargetHeight));
+}
+
+void SoftwareRasterizer::BindDepthTarget(float* pDepth, uint32_t width, uint32_t height, bool clear)
+{
+	m_pColorTarget = nullptr;
+	m_pDepthTarget = pDepth;
+	m_TargetWidth = width;
+	m_TargetHeight = height;
+
+	m_TileColumns = (width + g_TileSize - 1) >> g_TileBits;
+	m_BoundTiles.resize(static_cast<size_t>(m_TileColumns) * ((height + g_TileSize - 1) >> g_TileBits));
+	m_pTiles = m_BoundTiles.data();
+	if (clear)
+	{
+		std::fill_n(pDepth, static_cast<size_t>(width) * height, 1.f);
+		std::fill(m_BoundTiles.begin(), m_BoundTiles.end(), DepthTile{ 1.f, 1.f });
+	}
+	else if (m_HierarchicalDepth)
+	{
+		// Nothing is known about what the caller left in it, built from the depth like after turning the hierarchy on
+		UpdateTiles(pDepth, width, height, m_pTiles, 0, 0, width, height);
+	}
+
+	SetViewport(0.f, 0.f, static_cast<float>(width), static_cast<float>(height));
+}
+void SoftwareRasterizer::BindOwnTargets()
+{
+	m_pColorTarget = m_Color.data();
+	m_pDepthTarget = m_Depth.data();
+	m_TargetWidth = m_Width;
+	m_TargetHeight = m_Height;
+	m_pTiles = m_Tiles.data();
+	m_TileColumns = (m_Width + g_TileSize - 1) >> g_TileBits;
+
+	SetViewport(0.f, 0.f, static_cast<float>(m_Width), static_cast<float>(m_Height));
+}
+
+void SoftwareRasterizer::SetHierarchicalDepth(bool isEnabled)
+{
+	if (isEnabled && !m_HierarchicalDepth)
+	{
+		UpdateTiles(m_Depth.data(), m_Width, m_Height, m_Tiles.data(), 0, 0, m_Width, m_Height);
+		if (m_pDepthTarget != m_Depth.data()) UpdateTiles(m_pDepthTarget, m_TargetWidth, m_TargetHeight, m_pTiles, 0, 0, m_TargetWidth, m_TargetHeight);
+	}
+
+	m_HierarchicalDepth = isEnabled;
+}
+
+void SoftwareRasterizer::DrawTriangles(const math::Float4* pClipPositions, const uint32_t* pIndices, uint32_t indexCount, const DrawState& state)
+{
+	const uint32_t triangleCount{ indexCount / 3 };
+	m_Statistics.submittedTriangles += triangleCount;
+
+	for (uint32_t triangleIndex{}; triangleIndex < triangleCount; ++triangleIndex)
+	{
+		const uint32_t firstIndex{ triangleIndex * 3 };
+		const math::Float4& v0 = pClipPositions[pIndices ? pIndices[firstIndex + 0] : firstIndex + 0];
+		const math::Float4& v1 = pClipPositions[pIndices ? pIndices[firstIndex + 1] : firstIndex + 1];
+		const math::Float4& v2 = pClipPositions[pIndices ? pIndices[firstIndex + 2] : firstIndex + 2];
+
+		// Every corner on the wrong side of the same plane
+		const uint32_t bits0{ GetClipBits(v0) };
+		const uint32_t bits1{ GetClipBits(v1) };
+		const uint32_t bits2{ GetClipBits(v2) };
+		if (bits0 & bits1 & bits2)
+		{
+			++m_Statistics.culledTriangles;
+			continue;
+		}
+
+		if ((bits0 | bits1 | bits2) & g_ClipMask)
+		{
+			++m_Statistics.clippedTriangles;
+			DrawClipped(v0, v1, v2, state);
+		}
+		else
+		{
+			RasterizeTriangle(v0, v1, v2, state);
+		}
+	}
+}
+
+void SoftwareRasterizer::Upscale(const uint32_t* pSource, uint32_t sourceStride, uint32_t sourceWidth, uint32_t sourceHeight,
+	uint32_t* pDestination, uint32_t destinationWidth, uint32_t destinationHeight)
+{
+	if (sourceWidth == 0 || sourceHeight == 0) return;
+
+	// Source texel and weight of the next one for every column, shared by all rows
+	std::vector<uint32_t> columns(destinationWidth);
+	std::vector<uint32_t> columnWeights(destinationWidth);
+	const float scaleX{ static_cast<float>(sourceWidth) / destinationWidth };
+	for (uint32_t x{}; x < destinationWidth; ++x)
+	{
+		const float sourceX{ std::clamp((x + 0.5f) * scaleX - 0.5f, 0.f, static_cast<float>(sourceWidth - 1)) };
+		columns[x] = static_cast<uint32_t>(sourceX);
+		columnWeights[x] = static_cast<uint32_t>((sourceX - columns[x]) * 256.f);
+	}
+
+	// Source rows filtered horizontally once, every output row only blends the two it falls between
+	std::vector<uint32_t> filteredRows[2]{ std::vector<uint32_t>(destinationWidth), std::vector<uint32_t>(destinationWidth) };
+	uint32_t filteredRowIndices[2]{ UINT32_MAX, UINT32_MAX };
+	const auto filterRow = [&](uint32_t row, std::vector<uint32_t>& filteredRow)
+	{
+		const uint32_t* pRow{ pSource + static_cast<size_t>(row) * sourceStride };
+		for (uint32_t x{}; x < destinationWidth; ++x)
+		{
+			const uint32_t left{ columns[x] };
+			filteredRow[x] = BlendChannels(pRow[left], pRow[(std::min)(left + 1, sourceWidth - 1)], columnWeights[x]);
+		}
+	};
+
+	const float scaleY{ static_cast<float>(sourceHeight) / destinationHeight };
+	for (uint32_t y{}; y < destinationHeight; ++y)
+	{
+		const float sourceY{ std::clamp((y + 0.5f) * scaleY - 0.5f, 0.f, static_cast<float>(sourceHeight - 1)) };
+		const uint32_t row{ static_cast<uint32_t>(sourceY) };
+		const uint32_t rowWeight{ static_cast<uint32_t>((sourceY - row) * 256.f) };
+		const uint32_t nextRow{ (std::min)(row + 1, sourceHeight - 1) };
+
+		// Moving down one source row, the old bottom row becomes the top one
+		if (filteredRowIndices[0] != row && filteredRowIndices[1] == row)
+		{
+			std::swap(filteredRows[0], filteredRows[1]);
+			std::swap(filteredRowIndices[0], filteredRowIndices[1]);
+		}
+		if (filteredRowIndices[0] != row)
+		{
+			filterRow(row, filteredRows[0]);
+			filteredRowIndices[0] = row;
+		}
+		if (filteredRowIndices[1] != nextRow)
+		{
+			filterRow(nextRow, filteredRows[1]);
+			filteredRowIndices[1] = nextRow;
+		}
+
+		const uint32_t* pTop{ filteredRows[0].data() };
+		const uint32_t* pBottom{ filteredRows[1].data() };
+		uint32_t* pOutput{ pDestination + static_cast<size_t>(y) * destinationWidth };
+		for (uint32_t x{}; x < destinationWidth; ++x)
+		{
+			pOutput[x] = BlendChannels(pTop[x], pBottom[x], rowWeight);
+		}
+	}
+}
+
+// Privates
+// --------
+void SoftwareRasterizer::DrawClipped(const math::Float4& v0, const math::Float4& v1, const math::Float4& v2, const DrawState& state)
+{
+	// Sutherland-Hodgman, every plane adds at most one corner
+	std::array<math::Float4, 8> polygon{ v0, v1, v2 };
+	std::array<math::Float4, 8> clipped{};
+	uint32_t cornerCount{ 3 };
+
+	for (const uint32_t planeBit : { g_ClipNear, g_ClipLeft, g_ClipRight, g_ClipBottom, g_ClipTop })
+	{
+		uint32_t clippedCount{};
+		for (uint32_t corner{}; corner < cornerCount; ++corner)
+		{
+			const math::Float4& current = polygon[corner];
+			const math::Float4& next = polygon[(corner + 1) % cornerCount];
+			const float currentDistance{ GetPlaneDistance(current, planeBit) };
+			const float nextDistance{ GetPlaneDistance(next, planeBit) };
+
+			if (currentDistance >= 0.f) clipped[clippedCount++] = current;
+			if ((currentDistance >= 0.f) != (nextDistance >= 0.f))
+			{
+				clipped[clippedCount++] = Lerp(current, next, currentDistance / (currentDistance - nextDistance));
+			}
+		}
+
+		polygon = clipped;
+		cornerCount = clippedCount;
+		if (cornerCount < 3) return;
+	}
+
+	// Same winding as the original, as a fan
+	for (uint32_t corner{ 1 }; corner + 1 < cornerCount; ++corner)
+	{
+		RasterizeTriangle(polygon[0], polygon[corner], polygon[corner + 1], state);
+	}
+}
+void SoftwareRasterizer::RasterizeTriangle(const math::Float4& v0, const math::Float4& v1, const math::Float4& v2, const DrawState& state)
+{
+	ScreenVertex s0{ ToScreen(v0) };
+	ScreenVertex s1{ ToScreen(v1) };
+	ScreenVertex s2{ ToScreen(v2) };
+
+	// Positive for clockwise triangles, y points down on screen
+	int64_t area{ static_cast<int64_t>(s1.x - s0.x) * (s2.y - s0.y) - static_cast<int64_t>(s2.x - s0.x) * (s1.y - s0.y) };
+	if (area < 0 && !state.cullBackFaces)
+	{
+		std::swap(s1, s2);
+		area = -area;
+	}
+	if (area <= 0)
+	{
+		++m_Statistics.culledTriangles;
+		return;
+	}
+
+	// Pixels whose center may be inside, clipped to the viewport
+	const int32_t minX{ (std::max)((std::min)({ s0.x, s1.x, s2.x }) >> g_SubpixelBits, m_ScissorMinX) };
+	const int32_t minY{ (std::max)((std::min)({ s0.y, s1.y, s2.y }) >> g_SubpixelBits, m_ScissorMinY) };
+	const int32_t maxX{ (std::min)((std::max)({ s0.x, s1.x, s2.x }) >> g_SubpixelBits, m_ScissorMaxX - 1) };
+	const int32_t maxY{ (std::min)((std::max)({ s0.y, s1.y, s2.y }) >> g_SubpixelBits, m_ScissorMaxY - 1) };
+	if (minX > maxX || minY > maxY)
+	{
+		++m_Statistics.culledTriangles;
+		return;
+	}
+
+	// Edge functions, each one is the weight of the corner opposite the edge
+	struct Edge
+	{
+		int64_t stepX;
+		int64_t stepY;
+		int64_t firstValue;				// At the center of the first pixel
+		int64_t bias;
+	};
+
+	const int64_t sampleX{ static_cast<int64_t>(minX) * g_SubpixelScale + g_SubpixelScale / 2 };
+	const int64_t sampleY{ static_cast<int64_t>(minY) * g_SubpixelScale + g_SubpixelScale / 2 };
+	const auto setupEdge = [&](const ScreenVertex& a, const ScreenVertex& b)
+	{
+		const int64_t deltaX{ b.x - a.x };
+		const int64_t deltaY{ b.y - a.y };
+
+		// Top-left rule: pixel centers exactly on any other edge belong to the neighbour
+		const bool topLeft{ deltaY < 0 || (deltaY == 0 && deltaX > 0) };
+		return Edge{ -deltaY * g_SubpixelScale, deltaX * g_SubpixelScale, deltaX * (sampleY - a.y) - deltaY * (sampleX - a.x), topLeft ? 0 : -1 };
+	};
+
+	const Edge edge0{ setupEdge(s1, s2) };
+	const Edge edge1{ setupEdge(s2, s0) };
+	const Edge edge2{ setupEdge(s0, s1) };
+
+	// Depth is affine in screen space
+	const float inverseArea{ 1.f / static_cast<float>(area) };
+	const float depthStepX{ (edge1.stepX * (s1.z - s0.z) + edge2.stepX * (s2.z - s0.z)) * inverseArea };
+	const float depthStepY{ (edge1.stepY * (s1.z - s0.z) + edge2.stepY * (s2.z - s0.z)) * inverseArea };
+	float firstDepth{ s0.z + (edge1.firstValue * (s1.z - s0.z) + edge2.firstValue * (s2.z - s0.z)) * inverseArea };
+
+	// Constant part in units of the last mantissa bit of the farthest corner, D3D11's rule for float depth
+	if (state.depthBias != 0 || state.slopeScaledDepthBias != 0.f)
+	{
+		int exponent{};
+		std::frexp((std::max)({ s0.z, s1.z, s2.z }), &exponent);
+		firstDepth += std::ldexp(static_cast<float>(state.depthBias), exponent - 24)
+			+ state.slopeScaledDepthBias * (std::max)(std::fabs(depthStepX), std::fabs(depthStepY));
+	}
+
+	// Every pixel's depth is the depth of its row plus the offset of its column, both rounded products looked up once per triangle,
+	// so one addition is all that is left per pixel and each depth is the same bits wherever it is computed, whatever FMA contraction the build allows
+	// Both roundings keep it monotonic along rows and columns, so the nearest and farthest depth of any block of pixels are exactly those of its corners
+	m_RowDepths.resize(static_cast<size_t>(maxY - minY) + 1);
+	m_ColumnOffsets.resize(static_cast<size_t>(maxX - minX) + 1);
+	for (int32_t y{ minY }; y <= maxY; ++y) m_RowDepths[y - minY] = firstDepth + RoundProduct(static_cast<float>(y - minY), depthStepY);
+	for (int32_t x{ minX }; x <= maxX; ++x) m_ColumnOffsets[x - minX] = RoundProduct(static_cast<float>(x - minX), depthStepX);
+
+	const float* pRowDepths{ m_RowDepths.data() };
+	const float* pColumnOffsets{ m_ColumnOffsets.data() };
+	const auto getRowDepth = [&](int32_t y) { return pRowDepths[y - minY]; };
+	const auto getDepth = [&](float rowDepth, int32_t x) { return rowDepth + pColumnOffsets[x - minX]; };
+	const auto passesDepth = [&](float depth, float storedDepth) { return state.depthLessEqual ? depth <= storedDepth : depth < storedDepth; };
+
+	const bool testHierarchy{ m_HierarchicalDepth && state.depthTest };
+	const bool updateHierarchy{ m_HierarchicalDepth && state.depthWrite };
+
+	const int32_t firstTileX{ minX >> g_TileBits };
+	const int32_t firstTileY{ minY >> g_TileBits };
+	const int32_t lastTileX{ maxX >> g_TileBits };
+	const int32_t lastTileY{ maxY >> g_TileBits };
+
+	// Whole triangle behind everything stored under its bounds
+	if (testHierarchy)
+	{
+		const float topDepth{ getRowDepth(minY) };
+		const float bottomDepth{ getRowDepth(maxY) };
+		const float nearestDepth{ (std::min)({ getDepth(topDepth, minX), getDepth(topDepth, maxX), getDepth(bottomDepth, minX), getDepth(bottomDepth, maxX) }) };
+
+		float farthestStored{ -FLT_MAX };
+		for (int32_t tileY{ firstTileY }; tileY <= lastTileY; ++tileY)
+		{
+			const DepthTile* pRow{ m_pTiles + static_cast<size_t>(tileY) * m_TileColumns };
+			for (int32_t tileX{ firstTileX }; tileX <= lastTileX; ++tileX) farthestStored = (std::max)(farthestStored, pRow[tileX].farthest);
+		}
+
+		if (!passesDepth(nearestDepth, farthestStored))
+		{
+			++m_Statistics.rejectedTriangles;
+			return;
+		}
+	}
+
+	++m_Statistics.rasterizedTriangles;
+
+	const bool writeColor{ state.colorWrite && m_pColorTarget };
+
+	for (int32_t tileY{ firstTileY }; tileY <= lastTileY; ++tileY)
+	{
+		const int32_t blockMinY{ (std::max)(tileY << g_TileBits, minY) };
+		const int32_t blockMaxY{ (std::min)(((tileY + 1) << g_TileBits) - 1, maxY) };
+		const float topDepth{ getRowDepth(blockMinY) };
+		const float bottomDepth{ getRowDepth(blockMaxY) };
+
+		for (int32_t tileX{ firstTileX }; tileX <= lastTileX; ++tileX)
+		{
+			const int32_t blockMinX{ (std::max)(tileX << g_TileBits, minX) };
+			const int32_t blockMaxX{ (std::min)(((tileX + 1) << g_TileBits) - 1, maxX) };
+
+			// Outside when every corner is outside the same edge, the edge functions are affine too
+			const auto getBlockValue = [&](const Edge& edge) { return edge.firstValue + edge.bias + (blockMinX - minX) * edge.stepX + (blockMinY - minY) * edge.stepY; };
+			const auto isOutside = [&](const Edge& edge, int64_t blockValue)
+			{
+				return blockValue + (std::max)(edge.stepX * (blockMaxX - blockMinX), int64_t{}) + (std::max)(edge.stepY * (blockMaxY - blockMinY), int64_t{}) < 0;
+			};
+
+			const int64_t blockValue0{ getBlockValue(edge0) };
+			const int64_t blockValue1{ getBlockValue(edge1) };
+			const int64_t blockValue2{ getBlockValue(edge2) };
+			if (isOutside(edge0, blockValue0) || isOutside(edge1, blockValue1) || isOutside(edge2, blockValue2)) continue;
+
+			DepthTile& tile = m_pTiles[static_cast<size_t>(tileY) * m_TileColumns + tileX];
+			bool testDepth{ state.depthTest };
+			if (testHierarchy)
+			{
+				const float depth00{ getDepth(topDepth, blockMinX) };
+				const float depth10{ getDepth(topDepth, blockMaxX) };
+				const float depth01{ getDepth(bottomDepth, blockMinX) };
+				const float depth11{ getDepth(bottomDepth, blockMaxX) };
+
+				if (!passesDepth((std::min)({ depth00, depth10, depth01, depth11 }), tile.farthest))
+				{
+					++m_Statistics.rejectedBlocks;
+					continue;
+				}
+				if (passesDepth((std::max)({ depth00, depth10, depth01, depth11 }), tile.nearest))
+				{
+					++m_Statistics.acceptedBlocks;
+					testDepth = false;
+				}
+			}
+
+			// Writes only move the nearest depth and, when they replace the farthest one, make it worth reading the block again
+			float nearestWritten{ FLT_MAX };
+			float farthestWritten{ -FLT_MAX };
+			bool replacedFarthest{ false };
+			const float tileFarthest{ tile.farthest };
+			for (int32_t y{ blockMinY }; y <= blockMaxY; ++y)
+			{
+				int64_t value0{ blockValue0 + (y - blockMinY) * edge0.stepY };
+				int64_t value1{ blockValue1 + (y - blockMinY) * edge1.stepY };
+				int64_t value2{ blockValue2 + (y - blockMinY) * edge2.stepY };
+				const float rowDepth{ getRowDepth(y) };
+
+				const size_t rowStart{ static_cast<size_t>(y) * m_TargetWidth };
+				for (int32_t x{ blockMinX }; x <= blockMaxX; ++x)
+				{
+					if ((value0 | value1 | value2) >= 0)
+					{
+						++m_Statistics.coveredPixels;
+
+						const float depth{ getDepth(rowDepth, x) };
+						float& storedDepth = m_pDepthTarget[rowStart + x];
+						if (!testDepth || passesDepth(depth, storedDepth))
+						{
+							if (state.depthWrite)
+							{
+								replacedFarthest = replacedFarthest || storedDepth >= tileFarthest;
+								nearestWritten = (std::min)(nearestWritten, depth);
+								farthestWritten = (std::max)(farthestWritten, depth);
+								storedDepth = depth;
+							}
+							if (writeColor) m_pColorTarget[rowStart + x] = state.color;
+							++m_Statistics.shadedPixels;
+						}
+					}
+
+					value0 += edge0.stepX;
+					value1 += edge1.stepX;
+					value2 += edge2.stepX;
+				}
+			}
+
+			if (!updateHierarchy || nearestWritten > farthestWritten) continue;
+
+			if (replacedFarthest)
+			{
+				UpdateTiles(m_pDepthTarget, m_TargetWidth, m_TargetHeight, m_pTiles, blockMinX, blockMinY, blockMaxX + 1, blockMaxY + 1);
+			}
+			else
+			{
+				tile.nearest = (std::min)(tile.nearest, nearestWritten);
+				tile.farthest = (std::max)(tile.farthest, farthestWritten);	// Only without a depth test
+			}
+		}
+	}
+}
+SoftwareRasterizer::ScreenVertex SoftwareRasterizer::ToScreen(const math::Float4& clipPosition) const
+{
+	const float inverseW{ 1.f / clipPosition.w };
+	const float screenX{ m_ViewportX + (clipPosition.x * inverseW * 0.5f + 0.5f) * m_ViewportWidth };
+	const float screenY{ m_ViewportY + (0.5f - clipPosition.y * inverseW * 0.5f) * m_ViewportHeight };
+
+	// Rounded by hand, lround is a library call and this runs three times per triangle
+	const float fixedX{ screenX * g_SubpixelScale };
+	const float fixedY{ screenY * g_SubpixelScale };
+	return ScreenVertex
+	{
+		static_cast<int32_t>(fixedX + (fixedX < 0.f ? -0.5f : 0.5f)),
+		static_cast<int32_t>(fixedY + (fixedY < 0.f ? -0.5f : 0.5f)),
+		clipPosition.z * inverseW
+	};
+}
+void SoftwareRasterizer::UpdateTiles(const float* pDepth, uint32_t width, uint32_t height, DepthTile* pTiles, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY)
+{
+	if (minX >= maxX || minY >= maxY) return;
+
+	const uint32_t tileColumns{ (width + g_TileSize - 1) >> g_TileBits };
+	for (int32_t tileY{ minY >> g_TileBits }; tileY <= (maxY - 1) >> g_TileBits; ++tileY)
+	{
+		for (int32_t tileX{ minX >> g_TileBits }; tileX <= (maxX - 1) >> g_TileBits; ++tileX)
+		{
+			// The whole block, also the pixels outside the rectangle
+			const uint32_t blockMinX{ static_cast<uint32_t>(tileX) << g_TileBits };
+			const uint32_t blockMaxX{ (std::min)(blockMinX + g_TileSize, width) };
+			const uint32_t blockMinY{ static_cast<uint32_t>(tileY) << g_TileBits };
+			const uint32_t blockMaxY{ (std::min)(blockMinY + g_TileSize, height) };
+
+			DepthTile tile{ FLT_MAX, -FLT_MAX };
+			for (uint32_t y{ blockMinY }; y < blockMaxY; ++y)
+			{
+				const float* pRow{ pDepth + static_cast<size_t>(y) * width };
+				for (uint32_t x{ blockMinX }; x < blockMaxX; ++x)
+				{
+					tile.nearest = (std::min)(tile.nearest, pRow[x]);
+					tile.farthest = (std::max)(tile.farthest, pRow[x]);
+				}
+			}
+
+			pTiles[static_cast<size_t>(tileY) * tileColumns + tileX] = tile;
+		}
+	}
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "EngineMath.h"
+
+#include <cstdint>
+#include <vector>
+
+// Triangle rasterizer on the CPU, with a color and a depth target, or an outside depth only target for shadow maps
+// Takes clip space positions like the output of a vertex shader, clips against the near plane and follows the D3D11 conventions:
+// clockwise front faces, pixel centers at half coordinates, the top-left fill rule and a LESS depth test
+// Edge functions are evaluated in 28.4 fixed point, so neighbouring triangles never leave gaps or shade a pixel twice
+// Pixels are visited in 8x8 blocks; a nearest and farthest depth per block of the targets rejects hidden triangles and blocks before shading
+class SoftwareRasterizer final
+{
+public:
+	// Structs
+	struct DrawState
+	{
+		bool cullBackFaces;
+		bool depthTest;
+		bool depthWrite;
+		bool depthLessEqual;			// Instead of LESS, to shade what a depth prepass left visible
+		bool colorWrite;
+		uint32_t color;					// 0xAARRGGBB, every pixel of the draw gets it
+		int32_t depthBias;				// Like D3D11 on a float depth target, in steps of the largest depth of the triangle
+		float slopeScaledDepthBias;
+	};
+
+	struct Statistics					// Since the last reset
+	{
+		uint64_t submittedTriangles;
+		uint64_t culledTriangles;		// Outside the frustum, backfacing or without area
+		uint64_t clippedTriangles;		// Crossed the near plane
+		uint64_t rasterizedTriangles;
+		uint64_t rejectedTriangles;		// Behind the depth hierarchy over their whole bounds
+		uint64_t coveredPixels;			// Inside a triangle in a visited block, depth tested unless the block was accepted
+		uint64_t shadedPixels;			// Passed the depth test
+		uint64_t rejectedBlocks;		// Behind the depth hierarchy, never visited
+		uint64_t acceptedBlocks;		// In front of the depth hierarchy, shaded without reading the depth
+	};
+
+	// Rule of five
+	SoftwareRasterizer() = default;
+	~SoftwareRasterizer() = default;
+
+	SoftwareRasterizer(const SoftwareRasterizer& other) = delete;
+	SoftwareRasterizer(SoftwareRasterizer&& other) = delete;
+	SoftwareRasterizer& operator= (const SoftwareRasterizer& other) = delete;
+	SoftwareRasterizer& operator= (SoftwareRasterizer&& other) = delete;
+
+	// Publics
+	void Resize(uint32_t width, uint32_t height);
+	void Clear(uint32_t color, float depth, uint32_t width, uint32_t height);	// Only the top left width x height
+	void SetViewport(float x, float y, float width, float height);				// Clipped to the targets
+
+	// Draws go to a width x height depth buffer owned by the caller until the own targets are bound again, colors are dropped
+	// Both reset the viewport to the whole target; clearing fills the buffer with the far depth, which also spares reading it for the depth hierarchy
+	void BindDepthTarget(float* pDepth, uint32_t width, uint32_t height, bool clear);
+	void BindOwnTargets();
+
+	// Off visits every block and doesn't keep the hierarchy up to date, turning it back on rebuilds it from the depth
+	void SetHierarchicalDepth(bool isEnabled);
+	bool IsHierarchicalDepthEnabled() const { return m_HierarchicalDepth; }
+
+	// Triangle list, without indices every three positions form a triangle
+	void DrawTriangles(const math::Float4* pClipPositions, const uint32_t* pIndices, uint32_t indexCount, const DrawState& state);
+
+	math::Float4 GetViewport() const { return math::Float4{ m_ViewportX, m_ViewportY, m_ViewportWidth, m_ViewportHeight }; }	// x, y, width, height
+
+	uint32_t GetWidth() const { return m_Width; }
+	uint32_t GetHeight() const { return m_Height; }
+	const uint32_t* GetColor() const { return m_Color.data(); }
+	const float* GetDepth() const { return m_Depth.data(); }
+
+	const Statistics& GetStatistics() const { return m_Statistics; }
+	void ResetStatistics() { m_Statistics = Statistics{}; }
+
+	// Bilinear, the source is a sourceWidth x sourceHeight rectangle in the top left of a sourceStride wide image
+	static void Upscale(const uint32_t* pSource, uint32_t sourceStride, uint32_t sourceWidth, uint32_t sourceHeight,
+		uint32_t* pDestination, uint32_t destinationWidth, uint32_t destinationHeight);
+
+private:
+	// Structs
+	struct ScreenVertex
+	{
+		int32_t x;						// 28.4 fixed point
+		int32_t y;
+		float z;
+	};
+
+	struct DepthTile
+	{
+		float nearest;					// Of the depths stored in the block
+		float farthest;
+	};
+
+	static constexpr int32_t g_SubpixelBits{ 4 };
+	static constexpr int32_t g_SubpixelScale{ 1 << g_SubpixelBits };
+	static constexpr int32_t g_TileBits{ 3 };		// 8x8 pixels
+	static constexpr int32_t g_TileSize{ 1 << g_TileBits };
+
+	// Member variables
+	uint32_t m_Width{ 0 };
+	uint32_t m_Height{ 0 };
+	std::vector<uint32_t> m_Color{};
+	std::vector<float> m_Depth{};
+	std::vector<DepthTile> m_Tiles{};
+	std::vector<DepthTile> m_BoundTiles{};	// Of the bound depth target
+	std::vector<float> m_RowDepths{};		// Per triangle scratch, kept to avoid allocating
+	std::vector<float> m_ColumnOffsets{};
+
+	// Where the draws go, the own targets unless a depth target is bound
+	uint32_t* m_pColorTarget{ nullptr };
+	float* m_pDepthTarget{ nullptr };
+	uint32_t m_TargetWidth{ 0 };
+	uint32_t m_TargetHeight{ 0 };
+	DepthTile* m_pTiles{ nullptr };
+	uint32_t m_TileColumns{ 0 };
+	bool m_HierarchicalDepth{ true };
+
+	float m_ViewportX{ 0.f };
+	float m_ViewportY{ 0.f };
+	float m_ViewportWidth{ 0.f };
+	float m_ViewportHeight{ 0.f };
+
+	// Pixel rectangle the viewport covers, inclusive minimum and exclusive maximum
+	int32_t m_ScissorMinX{ 0 };
+	int32_t m_ScissorMinY{ 0 };
+	int32_t m_ScissorMaxX{ 0 };
+	int32_t m_ScissorMaxY{ 0 };
+
+	Statistics m_Statistics{};
+
+	// Member functions
+	void DrawClipped(const math::Float4& v0, const math::Float4& v1, const math::Float4& v2, const DrawState& state);
+	void RasterizeTriangle(const math::Float4& v0, const math::Float4& v1, const math::Float4& v2, const DrawState& state);
+	ScreenVertex ToScreen(const math::Float4& clipPosition) const;
+	static void UpdateTiles(const float* pDepth, uint32_t width, uint32_t height, DepthTile* pTiles, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY);
+};
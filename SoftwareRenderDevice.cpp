@@ -0,0 +1,541 @@
+#include "SoftwareRenderDevice.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+SoftwareRenderDevice::SoftwareRenderDevice(uint32_t backBufferWidth, uint32_t backBufferHeight)
+	: m_Validator{ backBufferWidth, backBufferHeight }
+	, m_Rasterizer{}
+	, m_PresentedImage(static_cast<size_t>(backBufferWidth) * backBufferHeight)
+	, m_pFrameCapture{}
+	, m_CreationMutex{}
+	, m_BufferData(g_MaxObjects)
+	, m_InputLayouts(g_MaxObjects)
+	, m_PipelineStates(g_MaxObjects)
+	, m_DepthTargets(g_MaxObjects)
+	, m_State{}
+	, m_Recorders{}
+	, m_Indices{}
+	, m_Positions{}
+	, m_ClipPositions{}
+	, m_PrepassDraws{}
+	, m_PrepassPositions{}
+	, m_PrepassIndices{}
+	, m_DepthPrepass{ false }
+	, m_LastFrameStatistics{}
+	, m_FrameRasterMs{}
+	, m_FrameDepthPixels{}
+	, m_LastFrameDepthPixels{}
+	, m_DepthPassStartPixels{}
+	, m_FramePrepassPixels{}
+	, m_LastFramePrepassPixels{}
+	, m_InDepthPass{ false }
+{
+	m_Rasterizer.Resize(backBufferWidth, backBufferHeight);
+
+	const uint32_t recorderCount{ std::clamp(std::thread::hardware_concurrency(), 1u, g_MaxRecorders) };
+	for (uint32_t index{}; index < recorderCount; ++index)
+	{
+		m_Recorders.push_back(std::make_unique<CommandBuffer>());
+	}
+}
+
+BufferHandle SoftwareRenderDevice::CreateBuffer(const BufferDescription& description, const void* pInitialData)
+{
+	std::lock_guard<std::mutex> lock{ m_CreationMutex };
+
+	const BufferHandle buffer{ m_Validator.CreateBuffer(description, pInitialData) };
+	if (!buffer.IsValid()) return buffer;
+
+	std::vector<uint8_t>& data = m_BufferData[buffer.GetIndex()];
+	data.assign(description.byteSize, 0);
+	if (pInitialData) memcpy(data.data(), pInitialData, description.byteSize);
+
+	return buffer;
+}
+ShaderViewHandle SoftwareRenderDevice::CreateShaderView(BufferHandle buffer, ElementFormat format, uint32_t elementCount)
+{
+	std::lock_guard<std::mutex> lock{ m_CreationMutex };
+	return m_Validator.CreateShaderView(buffer, format, elementCount);
+}
+VertexShaderHandle SoftwareRenderDevice::CreateVertexShader(const std::wstring& name, const std::vector<char>& bytecode)
+{
+	std::lock_guard<std::mutex> lock{ m_CreationMutex };
+	return m_Validator.CreateVertexShader(name, bytecode);
+}
+PixelShaderHandle SoftwareRenderDevice::CreatePixelShader(const std::wstring& name, const std::vector<char>& bytecode)
+{
+	std::lock_guard<std::mutex> lock{ m_CreationMutex };
+	return m_Validator.CreatePixelShader(name, bytecode);
+}
+InputLayoutHandle SoftwareRenderDevice::CreateInputLayout(const InputElement* pElements, uint32_t elementCount, const std::wstring& shaderName, const std::vector<char>& bytecode)
+{
+	std::lock_guard<std::mutex> lock{ m_CreationMutex };
+
+	const InputLayoutHandle inputLayout{ m_Validator.CreateInputLayout(pElements, elementCount, shaderName, bytecode) };
+	if (!inputLayout.IsValid()) return inputLayout;
+
+	// Elements of one slot are packed in order, like D3D11_APPEND_ALIGNED_ELEMENT
+	InputLayoutEntry entry{};
+	uint32_t offset{};
+	for (uint32_t index{}; index < elementCount; ++index)
+	{
+		const InputElement& element = pElements[index];
+		if (element.inputSlot != 0) continue;
+
+		if (!element.perInstance && element.format == ElementFormat::R32G32B32_Float && element.semanticIndex == 0 && strcmp(element.pSemanticName, "POSITION") == 0)
+		{
+			entry.hasPosition = true;
+			entry.positionOffset = offset;
+		}
+		offset += GetElementSize(element.format);
+	}
+
+	m_InputLayouts[inputLayout.GetIndex()] = entry;
+	return inputLayout;
+}
+PipelineStateHandle SoftwareRenderDevice::CreatePipelineState(const PipelineStateDescription& description)
+{
+	std::lock_guard<std::mutex> lock{ m_CreationMutex };
+
+	const PipelineStateHandle pipelineState{ m_Validator.CreatePipelineState(description) };
+	if (pipelineState.IsValid()) m_PipelineStates[pipelineState.GetIndex()] = description;
+
+	return pipelineState;
+}
+DepthTargetHandle SoftwareRenderDevice::CreateDepthTarget(const DepthTargetDescription& description)
+{
+	std::lock_guard<std::mutex> lock{ m_CreationMutex };
+
+	const DepthTargetHandle depthTarget{ m_Validator.CreateDepthTarget(description) };
+	if (!depthTarget.IsValid()) return depthTarget;
+
+	DepthTargetEntry& entry = m_DepthTargets[depthTarget.GetIndex()];
+	entry.description = description;
+	entry.depth.assign(static_cast<size_t>(description.width) * description.height * description.sliceCount, 1.f);
+	return depthTarget;
+}
+ShaderViewHandle SoftwareRenderDevice::CreateDepthShaderView(DepthTargetHandle depthTarget)
+{
+	std::lock_guard<std::mutex> lock{ m_CreationMutex };
+	return m_Validator.CreateDepthShaderView(depthTarget);
+}
+
+void SoftwareRenderDevice::DestroyBuffer(BufferHandle buffer)
+{
+	// A stale handle's slot may belong to another buffer by now
+	if (m_Validator.IsAlive(buffer)) m_BufferData[buffer.GetIndex()] = std::vector<uint8_t>{};
+	m_Validator.DestroyBuffer(buffer);
+}
+void SoftwareRenderDevice::DestroyShaderView(ShaderViewHandle view)
+{
+	m_Validator.DestroyShaderView(view);
+}
+void SoftwareRenderDevice::DestroyDepthTarget(DepthTargetHandle depthTarget)
+{
+	if (m_Validator.IsAlive(depthTarget)) m_DepthTargets[depthTarget.GetIndex()] = DepthTargetEntry{};
+	m_Validator.DestroyDepthTarget(depthTarget);
+}
+
+bool SoftwareRenderDevice::CompileShader(const ShaderCompileDescription& description, std::vector<char>& bytecode, std::string& errors)
+{
+	// The rasterizer never runs the bytecode, the validator's stand-in is enough
+	return m_Validator.CompileShader(description, bytecode, errors);
+}
+
+void SoftwareRenderDevice::BeginFrame(const float clearColor[4])
+{
+	m_Validator.BeginFrame(clearColor);
+	m_State = BoundState{};
+	m_FrameDepthPixels = 0;
+	m_FramePrepassPixels = 0;
+	m_PrepassDraws.clear();
+	m_PrepassPositions.clear();
+	m_PrepassIndices.clear();
+
+	const std::chrono::steady_clock::time_point clearStart{ std::chrono::steady_clock::now() };
+
+	// Only the part the frame is drawn in, the rest is never read
+	const auto toChannel = [](float value) { return static_cast<uint32_t>(std::clamp(value, 0.f, 1.f) * 255.f + 0.5f); };
+	const uint32_t color{ toChannel(clearColor[3]) << 24 | toChannel(clearColor[0]) << 16 | toChannel(clearColor[1]) << 8 | toChannel(clearColor[2]) };
+	m_Rasterizer.Clear(color, 1.f, GetRenderWidth(), GetRenderHeight());
+	m_Rasterizer.ResetStatistics();
+
+	m_FrameRasterMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - clearStart).count();
+}
+void SoftwareRenderDevice::Present()
+{
+	const std::chrono::steady_clock::time_point presentStart{ std::chrono::steady_clock::now() };
+
+	ShadePrepassDraws();
+
+	const uint32_t width{ GetBackBufferWidth() };
+	const uint32_t height{ GetBackBufferHeight() };
+	if (GetRenderWidth() == width && GetRenderHeight() == height)
+	{
+		memcpy(m_PresentedImage.data(), m_Rasterizer.GetColor(), m_PresentedImage.size() * sizeof(uint32_t));
+	}
+	else
+	{
+		SoftwareRasterizer::Upscale(m_Rasterizer.GetColor(), width, GetRenderWidth(), GetRenderHeight(), m_PresentedImage.data(), width, height);
+	}
+
+	m_FrameRasterMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - presentStart).count();
+
+	// Not part of the raster time, the capture logs its own cost
+	if (m_pFrameCapture) m_pFrameCapture->CaptureFrame(m_PresentedImage.data(), width, height);
+
+	m_Validator.Present();
+	m_LastFrameStatistics = m_Validator.GetFrameStatistics();
+	m_LastFrameStatistics.gpuMs = static_cast<float>(m_FrameRasterMs);
+	m_LastFrameDepthPixels = m_FrameDepthPixels;
+	m_LastFramePrepassPixels = m_FramePrepassPixels;
+}
+bool SoftwareRenderDevice::ResizeBackBuffer(uint32_t width, uint32_t height)
+{
+	if (!m_Validator.ResizeBackBuffer(width, height)) return false;
+
+	m_Rasterizer.Resize(width, height);
+	m_PresentedImage.assign(static_cast<size_t>(width) * height, 0);
+	return true;
+}
+
+void SoftwareRenderDevice::SetRenderResolution(uint32_t width, uint32_t height)
+{
+	// The targets keep the backBuffer size, the views only use less of them
+	m_Validator.SetRenderResolution(width, height);
+}
+
+void SoftwareRenderDevice::UpdateBuffer(BufferHandle buffer, const void* pData, uint32_t byteSize)
+{
+	m_Validator.UpdateBuffer(buffer, pData, byteSize);
+	if (!m_Validator.IsAlive(buffer) || !pData) return;
+
+	std::vector<uint8_t>& data = m_BufferData[buffer.GetIndex()];
+	if (byteSize <= data.size()) memcpy(data.data(), pData, byteSize);
+}
+
+void SoftwareRenderDevice::BeginDepthPass(DepthTargetHandle depthTarget, uint32_t slice)
+{
+	m_Validator.BeginDepthPass(depthTarget, slice);
+	if (m_InDepthPass || !m_Validator.IsAlive(depthTarget)) return;
+
+	DepthTargetEntry& entry = m_DepthTargets[depthTarget.GetIndex()];
+	if (slice >= entry.description.sliceCount) return;
+
+	const size_t sliceSize{ static_cast<size_t>(entry.description.width) * entry.description.height };
+	float* pSlice{ entry.depth.data() + sliceSize * slice };
+
+	m_State = BoundState{};
+	m_Rasterizer.BindDepthTarget(pSlice, entry.description.width, entry.description.height, true);
+	m_DepthPassStartPixels = m_Rasterizer.GetStatistics().shadedPixels;
+	m_InDepthPass = true;
+}
+void SoftwareRenderDevice::EndDepthPass()
+{
+	m_Validator.EndDepthPass();
+	if (!m_InDepthPass) return;
+
+	m_State = BoundState{};
+	m_Rasterizer.BindOwnTargets();
+	m_FrameDepthPixels += m_Rasterizer.GetStatistics().shadedPixels - m_DepthPassStartPixels;
+	m_InDepthPass = false;
+}
+
+void SoftwareRenderDevice::SetViewport(const Viewport& viewport)
+{
+	m_Validator.SetViewport(viewport);
+	m_Rasterizer.SetViewport(viewport.x, viewport.y, viewport.width, viewport.height);
+}
+void SoftwareRenderDevice::SetPipelineState(PipelineStateHandle pipelineState)
+{
+	m_Validator.SetPipelineState(pipelineState);
+	m_State.pipelineState = pipelineState;
+}
+void SoftwareRenderDevice::SetInputLayout(InputLayoutHandle inputLayout)
+{
+	m_Validator.SetInputLayout(inputLayout);
+	m_State.inputLayout = inputLayout;
+}
+void SoftwareRenderDevice::SetVertexShader(VertexShaderHandle vertexShader)
+{
+	m_Validator.SetVertexShader(vertexShader);
+}
+void SoftwareRenderDevice::SetPixelShader(PixelShaderHandle pixelShader)
+{
+	m_Validator.SetPixelShader(pixelShader);
+	m_State.pixelShader = pixelShader;
+}
+void SoftwareRenderDevice::SetVertexBuffers(uint32_t startSlot, uint32_t bufferCount, const BufferHandle* pBuffers, const uint32_t* pStrides)
+{
+	m_Validator.SetVertexBuffers(startSlot, bufferCount, pBuffers, pStrides);
+	if (startSlot != 0 || bufferCount == 0 || !pBuffers || !pStrides) return;
+
+	m_State.vertexBuffer = pBuffers[0];
+	m_State.vertexStride = pStrides[0];
+}
+void SoftwareRenderDevice::SetIndexBuffer(BufferHandle buffer, ElementFormat format)
+{
+	m_Validator.SetIndexBuffer(buffer, format);
+	m_State.indexBuffer = buffer;
+	m_State.indexFormat = format;
+}
+void SoftwareRenderDevice::SetConstantBuffer(ShaderStage stage, uint32_t slot, BufferHandle buffer, uint32_t firstConstant, uint32_t constantCount)
+{
+	m_Validator.SetConstantBuffer(stage, slot, buffer, firstConstant, constantCount);
+	if (stage != ShaderStage::Vertex) return;
+
+	if (slot == 0) m_State.objectConstants = ConstantBinding{ buffer, firstConstant };
+	if (slot == 1) m_State.viewConstants = ConstantBinding{ buffer, firstConstant };
+}
+void SoftwareRenderDevice::SetShaderViews(ShaderStage stage, uint32_t startSlot, uint32_t viewCount, const ShaderViewHandle* pViews)
+{
+	m_Validator.SetShaderViews(stage, startSlot, viewCount, pViews);
+}
+
+void SoftwareRenderDevice::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+	m_Validator.DrawIndexed(indexCount, startIndex, baseVertex);
+
+	const std::chrono::steady_clock::time_point drawStart{ std::chrono::steady_clock::now() };
+	RasterizeDraw(indexCount, startIndex, baseVertex);
+	m_FrameRasterMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - drawStart).count();
+}
+void SoftwareRenderDevice::DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount)
+{
+	m_Validator.DrawIndexedInstanced(indexCountPerInstance, instanceCount);
+}
+
+CommandRecorder& SoftwareRenderDevice::BeginRecording(uint32_t recorderIndex)
+{
+	CommandBuffer& commands = *m_Recorders[(std::min)(recorderIndex, GetRecorderCount() - 1)];
+	commands.Clear();
+	return commands;
+}
+void SoftwareRenderDevice::EndRecording(uint32_t /*recorderIndex*/)
+{
+}
+void SoftwareRenderDevice::ExecuteRecording(uint32_t recorderIndex)
+{
+	if (recorderIndex >= GetRecorderCount()) return;
+
+	// Replayed through this device, so the draws are rasterized and validated like immediate ones
+	m_State = BoundState{};
+	m_Recorders[recorderIndex]->Replay(*this);
+	m_Recorders[recorderIndex]->Clear();
+	m_State = BoundState{};
+}
+
+bool SoftwareRenderDevice::StartCapture(FrameCaptureEncoder::Format format, const std::wstring& filePath)
+{
+	if (!m_pFrameCapture) m_pFrameCapture = std::make_unique<MemoryFrameCapture>();
+	return m_pFrameCapture->Start(format, filePath);
+}
+void SoftwareRenderDevice::StopCapture()
+{
+	if (m_pFrameCapture) m_pFrameCapture->Stop();
+}
+bool SoftwareRenderDevice::IsCapturing() const
+{
+	return m_pFrameCapture && m_pFrameCapture->IsCapturing();
+}
+
+void SoftwareRenderDevice::LogStatistics() const
+{
+	const Statistics& statistics = m_LastFrameStatistics;
+	const SoftwareRasterizer::Statistics& rasterStatistics = m_Rasterizer.GetStatistics();
+
+	std::wstringstream message;
+	message << L"Software device: " << statistics.drawCount << L" draws, " << statistics.triangleCount << L" triangles, "
+		<< statistics.bindCount << L" binds, " << statistics.validationErrors << L" validation errors, "
+		<< GetRenderWidth() << L"x" << GetRenderHeight() << L" drawn in " << statistics.gpuMs << L" ms ("
+		<< rasterStatistics.rasterizedTriangles << L" rasterized, " << rasterStatistics.culledTriangles << L" culled, "
+		<< rasterStatistics.clippedTriangles << L" clipped, " << rasterStatistics.shadedPixels << L" pixels shaded, "
+		<< m_LastFrameDepthPixels << L" of them in depth passes";
+	if (m_DepthPrepass) message << L" and " << m_LastFramePrepassPixels << L" depth only in the prepass";
+	message << L")";
+	Logger::Log(message.str());
+
+	message.str(L"");
+	message << L"Software device: hierarchical depth " << (IsHierarchicalDepthEnabled() ? L"on" : L"off") << L", depth prepass " << (m_DepthPrepass ? L"on" : L"off")
+		<< L", " << rasterStatistics.rejectedTriangles << L" triangles and " << rasterStatistics.rejectedBlocks << L" 8x8 blocks rejected, "
+		<< rasterStatistics.acceptedBlocks << L" blocks shaded without reading the depth";
+	Logger::Log(message.str());
+
+	if (IsCapturing()) m_pFrameCapture->LogStatistics();
+}
+
+// Privates
+// --------
+void SoftwareRenderDevice::RasterizeDraw(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+	using namespace math;
+
+	// Draws the validator already complained about, or that unskinned Surface_VS can't describe, are skipped
+	if (!m_Validator.IsAlive(m_State.pipelineState) || !m_Validator.IsAlive(m_State.inputLayout)) return;
+	if (!m_Validator.IsAlive(m_State.vertexBuffer) || !m_Validator.IsAlive(m_State.indexBuffer) || m_State.vertexStride == 0) return;
+
+	const InputLayoutEntry& inputLayout = m_InputLayouts[m_State.inputLayout.GetIndex()];
+	const uint8_t* pObjectConstants{ GetConstants(m_State.objectConstants, sizeof(Float4x4)) };
+	const uint8_t* pViewConstants{ GetConstants(m_State.viewConstants, sizeof(Float4x4)) };
+	if (!inputLayout.hasPosition || !pObjectConstants || !pViewConstants) return;
+
+	// Both matrices are uploaded transposed for the shader
+	Float4x4 world{};
+	Float4x4 viewProjection{};
+	memcpy(&world, pObjectConstants, sizeof(Float4x4));
+	memcpy(&viewProjection, pViewConstants, sizeof(Float4x4));
+	const Matrix worldViewProjection{ MatrixTranspose(LoadFloat4x4(&world)) * MatrixTranspose(LoadFloat4x4(&viewProjection)) };
+
+	const std::vector<uint8_t>& vertexData = m_BufferData[m_State.vertexBuffer.GetIndex()];
+	const std::vector<uint8_t>& indexData = m_BufferData[m_State.indexBuffer.GetIndex()];
+	const uint32_t indexSize{ m_State.indexFormat == ElementFormat::R16_UInt ? 2u : 4u };
+	if (indexCount == 0 || (static_cast<uint64_t>(startIndex) + indexCount) * indexSize > indexData.size()) return;
+
+	m_Indices.resize(indexCount);
+	int64_t firstVertex{ INT64_MAX };
+	int64_t lastVertex{ INT64_MIN };
+	for (uint32_t index{}; index < indexCount; ++index)
+	{
+		uint32_t vertexIndex{};
+		if (indexSize == 2)
+		{
+			uint16_t shortIndex{};
+			memcpy(&shortIndex, indexData.data() + static_cast<size_t>(startIndex + index) * 2, sizeof(uint16_t));
+			vertexIndex = shortIndex;
+		}
+		else
+		{
+			memcpy(&vertexIndex, indexData.data() + static_cast<size_t>(startIndex + index) * 4, sizeof(uint32_t));
+		}
+
+		const int64_t vertex{ static_cast<int64_t>(vertexIndex) + baseVertex };
+		firstVertex = (std::min)(firstVertex, vertex);
+		lastVertex = (std::max)(lastVertex, vertex);
+		m_Indices[index] = vertexIndex;
+	}
+
+	if (firstVertex < 0 || static_cast<uint64_t>(lastVertex) * m_State.vertexStride + inputLayout.positionOffset + sizeof(Float3) > vertexData.size()) return;
+
+	// Shared vertices are transformed once when the draw uses a compact range, like a post-transform cache would
+	// Sparse draws transform every index instead, a range that big would be mostly unused
+	const uint64_t rangeSize{ static_cast<uint64_t>(lastVertex - firstVertex + 1) };
+	const bool transformRange{ rangeSize <= indexCount };
+	const uint32_t positionCount{ transformRange ? static_cast<uint32_t>(rangeSize) : indexCount };
+
+	const auto readPosition = [&](int64_t vertex)
+	{
+		Float3 position{};
+		memcpy(&position, vertexData.data() + static_cast<size_t>(vertex) * m_State.vertexStride + inputLayout.positionOffset, sizeof(Float3));
+		return Float4{ position.x, position.y, position.z, 1.f };
+	};
+
+	m_Positions.resize(positionCount);
+	if (transformRange)
+	{
+		for (uint32_t vertex{}; vertex < positionCount; ++vertex) m_Positions[vertex] = readPosition(firstVertex + vertex);
+
+		const int64_t rebase{ baseVertex - firstVertex };
+		for (uint32_t& vertexIndex : m_Indices) vertexIndex = static_cast<uint32_t>(vertexIndex + rebase);
+	}
+	else
+	{
+		for (uint32_t index{}; index < indexCount; ++index) m_Positions[index] = readPosition(m_Indices[index] + static_cast<int64_t>(baseVertex));
+	}
+
+	m_ClipPositions.resize(positionCount);
+	Vector4TransformStream(m_ClipPositions.data(), m_Positions.data(), positionCount, worldViewProjection);
+
+	const PipelineStateDescription& pipelineState = m_PipelineStates[m_State.pipelineState.GetIndex()];
+	const SoftwareRasterizer::DrawState drawState
+	{
+		pipelineState.cullMode == CullMode::Back,
+		pipelineState.depthTest,
+		pipelineState.depthWrite,
+		false,
+		true,
+		GetShaderColor(m_State.pixelShader),
+		pipelineState.depthBias,
+		pipelineState.slopeScaledDepthBias
+	};
+	const uint32_t* pIndices{ transformRange ? m_Indices.data() : nullptr };
+	if (!m_DepthPrepass || m_InDepthPass)
+	{
+		m_Rasterizer.DrawTriangles(m_ClipPositions.data(), pIndices, indexCount, drawState);
+		return;
+	}
+
+	// Every draw is kept to be shaded in order, the ones that test and write depth are drawn depth only now and only shade what stayed visible
+	SoftwareRasterizer::DrawState shadeState{ drawState };
+	if (drawState.depthTest && drawState.depthWrite)
+	{
+		SoftwareRasterizer::DrawState depthState{ drawState };
+		depthState.colorWrite = false;
+
+		const uint64_t startPixels{ m_Rasterizer.GetStatistics().shadedPixels };
+		m_Rasterizer.DrawTriangles(m_ClipPositions.data(), pIndices, indexCount, depthState);
+		m_FramePrepassPixels += m_Rasterizer.GetStatistics().shadedPixels - startPixels;
+
+		shadeState.depthWrite = false;
+		shadeState.depthLessEqual = true;
+	}
+
+	m_PrepassDraws.push_back(PrepassDraw{ static_cast<uint32_t>(m_PrepassPositions.size()), static_cast<uint32_t>(m_PrepassIndices.size()), indexCount,
+		transformRange, m_Rasterizer.GetViewport(), shadeState });
+	m_PrepassPositions.insert(m_PrepassPositions.end(), m_ClipPositions.begin(), m_ClipPositions.begin() + positionCount);
+	if (transformRange) m_PrepassIndices.insert(m_PrepassIndices.end(), m_Indices.begin(), m_Indices.begin() + indexCount);
+}
+void SoftwareRenderDevice::ShadePrepassDraws()
+{
+	for (const PrepassDraw& draw : m_PrepassDraws)
+	{
+		m_Rasterizer.SetViewport(draw.viewport.x, draw.viewport.y, draw.viewport.z, draw.viewport.w);
+		m_Rasterizer.DrawTriangles(m_PrepassPositions.data() + draw.firstPosition, draw.isIndexed ? m_PrepassIndices.data() + draw.firstIndex : nullptr,
+			draw.indexCount, draw.state);
+	}
+
+	m_PrepassDraws.clear();
+	m_PrepassPositions.clear();
+	m_PrepassIndices.clear();
+}
+const uint8_t* SoftwareRenderDevice::GetConstants(const ConstantBinding& binding, uint32_t byteSize) const
+{
+	if (!m_Validator.IsAlive(binding.buffer)) return nullptr;
+
+	const std::vector<uint8_t>& data = m_BufferData[binding.buffer.GetIndex()];
+	const uint64_t offset{ static_cast<uint64_t>(binding.firstConstant) * 16 };
+	return offset + byteSize <= data.size() ? data.data() + offset : nullptr;
+}
+const float* SoftwareRenderDevice::GetDepthTarget(DepthTargetHandle depthTarget, uint32_t slice) const
+{
+	if (!m_Validator.IsAlive(depthTarget)) return nullptr;
+
+	const DepthTargetEntry& entry = m_DepthTargets[depthTarget.GetIndex()];
+	if (slice >= entry.description.sliceCount) return nullptr;
+	return entry.depth.data() + static_cast<size_t>(entry.description.width) * entry.description.height * slice;
+}
+uint32_t SoftwareRenderDevice::GetShaderColor(PixelShaderHandle pixelShader)
+{
+	// Stable per shader and never too dark to tell apart from the background
+	const uint32_t hash{ pixelShader.id * 2654435761u };
+	return 0xFF000000 | ((hash & 0x007F7F7F) + 0x00404040);
+}
+uint32_t SoftwareRenderDevice::GetElementSize(ElementFormat format)
+{
+	switch (format)
+	{
+	case ElementFormat::R16_UInt:			return 2;
+	case ElementFormat::R32_UInt:			return 4;
+	case ElementFormat::R32G32_UInt:		return 8;
+	case ElementFormat::R8G8B8A8_UInt:		return 4;
+	case ElementFormat::R32G32_Float:		return 8;
+	case ElementFormat::R32G32B32_Float:	return 12;
+	case ElementFormat::R32G32B32A32_Float:	return 16;
+	default:								return 0;
+	}
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include "CommandBuffer.h"
+#include "MemoryFrameCapture.h"
+#include "NullRenderDevice.h"
+#include "RenderDevice.h"
+#include "SoftwareRasterizer.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Backend that draws the frame on the CPU, so rendering can be checked headless and on any platform
+// Every call goes through a NullRenderDevice first, for the same validation and counts
+// Only runs the fixed part of unskinned Surface_VS: the POSITION element is transformed by the world matrix in b0 and the viewProjection in b1,
+// every pixel gets a flat color picked from the pixelShader; instanced draws are only counted
+// Depth passes are rasterized into the slices of the depth target, so shadow maps can be read back, but no shader ever samples them
+// With the depth prepass on, the frame's draws are rasterized depth-only as they come and kept, then shaded at Present against the finished depth;
+// like a LESS_EQUAL pass on a GPU, a pixel where intersecting draws tie is shaded by each of them and keeps the last one's color
+class SoftwareRenderDevice final : public RenderDevice
+{
+public:
+	// Rule of five
+	SoftwareRenderDevice(uint32_t backBufferWidth, uint32_t backBufferHeight);
+	~SoftwareRenderDevice() override = default;
+
+	SoftwareRenderDevice(const SoftwareRenderDevice& other) = delete;
+	SoftwareRenderDevice(SoftwareRenderDevice&& other) = delete;
+	SoftwareRenderDevice& operator= (const SoftwareRenderDevice& other) = delete;
+	SoftwareRenderDevice& operator= (SoftwareRenderDevice&& other) = delete;
+
+	// Publics
+	RenderDeviceType GetType() const override { return RenderDeviceType::Software; }
+	const Features& GetFeatures() const override { return m_Validator.GetFeatures(); }
+	uint32_t GetBackBufferWidth() const override { return m_Validator.GetBackBufferWidth(); }
+	uint32_t GetBackBufferHeight() const override { return m_Validator.GetBackBufferHeight(); }
+
+	BufferHandle CreateBuffer(const BufferDescription& description, const void* pInitialData) override;
+	ShaderViewHandle CreateShaderView(BufferHandle buffer, ElementFormat format, uint32_t elementCount) override;
+	VertexShaderHandle CreateVertexShader(const std::wstring& name, const std::vector<char>& bytecode) override;
+	PixelShaderHandle CreatePixelShader(const std::wstring& name, const std::vector<char>& bytecode) override;
+	InputLayoutHandle CreateInputLayout(const InputElement* pElements, uint32_t elementCount, const std::wstring& shaderName, const std::vector<char>& bytecode) override;
+	PipelineStateHandle CreatePipelineState(const PipelineStateDescription& description) override;
+	DepthTargetHandle CreateDepthTarget(const DepthTargetDescription& description) override;
+	ShaderViewHandle CreateDepthShaderView(DepthTargetHandle depthTarget) override;
+
+	void DestroyBuffer(BufferHandle buffer) override;
+	void DestroyShaderView(ShaderViewHandle view) override;
+	void DestroyDepthTarget(DepthTargetHandle depthTarget) override;
+
+	const char* GetShaderProfile(ShaderStage stage) const override { return m_Validator.GetShaderProfile(stage); }
+	bool CompileShader(const ShaderCompileDescription& description, std::vector<char>& bytecode, std::string& errors) override;
+
+	void BeginFrame(const float clearColor[4]) override;
+	void Present() override;
+	bool ResizeBackBuffer(uint32_t width, uint32_t height) override;
+
+	void SetRenderResolution(uint32_t width, uint32_t height) override;
+	uint32_t GetRenderWidth() const override { return m_Validator.GetRenderWidth(); }
+	uint32_t GetRenderHeight() const override { return m_Validator.GetRenderHeight(); }
+
+	void UpdateBuffer(BufferHandle buffer, const void* pData, uint32_t byteSize) override;
+
+	void BeginDepthPass(DepthTargetHandle depthTarget, uint32_t slice) override;
+	void EndDepthPass() override;
+
+	void SetViewport(const Viewport& viewport) override;
+	void SetPipelineState(PipelineStateHandle pipelineState) override;
+	void SetInputLayout(InputLayoutHandle inputLayout) override;
+	void SetVertexShader(VertexShaderHandle vertexShader) override;
+	void SetPixelShader(PixelShaderHandle pixelShader) override;
+	void SetVertexBuffers(uint32_t startSlot, uint32_t bufferCount, const BufferHandle* pBuffers, const uint32_t* pStrides) override;
+	void SetIndexBuffer(BufferHandle buffer, ElementFormat format) override;
+	void SetConstantBuffer(ShaderStage stage, uint32_t slot, BufferHandle buffer, uint32_t firstConstant = 0, uint32_t constantCount = 0) override;
+	void SetShaderViews(ShaderStage stage, uint32_t startSlot, uint32_t viewCount, const ShaderViewHandle* pViews) override;
+
+	void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+	void DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount) override;
+
+	uint32_t GetRecorderCount() const override { return static_cast<uint32_t>(m_Recorders.size()); }
+	CommandRecorder& BeginRecording(uint32_t recorderIndex) override;
+	void EndRecording(uint32_t recorderIndex) override;
+	void ExecuteRecording(uint32_t recorderIndex) override;
+
+	bool StartCapture(FrameCaptureEncoder::Format format, const std::wstring& filePath) override;	// Captures the presented images
+	void StopCapture() override;
+	bool IsCapturing() const override;
+
+	const Statistics& GetFrameStatistics() const override { return m_LastFrameStatistics; }
+	void LogStatistics() const override;
+
+	const uint32_t* GetPresentedImage() const { return m_PresentedImage.data(); }	// 0xAARRGGBB, backBuffer sized
+	const SoftwareRasterizer& GetRasterizer() const { return m_Rasterizer; }
+	const float* GetDepthTarget(DepthTargetHandle depthTarget, uint32_t slice) const;	// width x height, nullptr when unknown
+
+	// Hidden triangles and blocks are rejected by the rasterizer's depth hierarchy, the prepass also keeps hidden pixels of visible blocks from being shaded
+	void SetHierarchicalDepth(bool isEnabled) { m_Rasterizer.SetHierarchicalDepth(isEnabled); }
+	bool IsHierarchicalDepthEnabled() const { return m_Rasterizer.IsHierarchicalDepthEnabled(); }
+	void SetDepthPrepass(bool isEnabled) { m_DepthPrepass = isEnabled; }
+	bool IsDepthPrepassEnabled() const { return m_DepthPrepass; }
+
+private:
+	// Structs
+	struct InputLayoutEntry
+	{
+		bool hasPosition;		// Float3 POSITION in slot 0, per vertex
+		uint32_t positionOffset;
+	};
+
+	struct DepthTargetEntry
+	{
+		DepthTargetDescription description;
+		std::vector<float> depth;			// Slice after slice
+	};
+
+	struct ConstantBinding
+	{
+		BufferHandle buffer;
+		uint32_t firstConstant;
+	};
+
+	struct BoundState
+	{
+		PipelineStateHandle pipelineState;
+		InputLayoutHandle inputLayout;
+		PixelShaderHandle pixelShader;
+		BufferHandle vertexBuffer;	// Slot 0
+		uint32_t vertexStride;
+		BufferHandle indexBuffer;
+		ElementFormat indexFormat;
+		ConstantBinding objectConstants;	// b0
+		ConstantBinding viewConstants;		// b1
+	};
+
+	struct PrepassDraw				// Shaded at Present, its positions and indices are kept in the frame's arrays
+	{
+		uint32_t firstPosition;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		bool isIndexed;
+		math::Float4 viewport;			// x, y, width, height
+		SoftwareRasterizer::DrawState state;
+	};
+
+	static constexpr uint32_t g_MaxObjects{ 4096 };		// Same as the validator
+	static constexpr uint32_t g_MaxRecorders{ 8 };
+
+	// Member variables
+	NullRenderDevice m_Validator;
+	SoftwareRasterizer m_Rasterizer;
+	std::vector<uint32_t> m_PresentedImage;
+	std::unique_ptr<MemoryFrameCapture> m_pFrameCapture;	// Created by the first capture, along with its encoder thread
+
+	// Indexed by the handle ids the validator hands out, sized up front so the render thread reads them without locking
+	std::mutex m_CreationMutex;
+	std::vector<std::vector<uint8_t>> m_BufferData;
+	std::vector<InputLayoutEntry> m_InputLayouts;
+	std::vector<PipelineStateDescription> m_PipelineStates;
+	std::vector<DepthTargetEntry> m_DepthTargets;
+
+	BoundState m_State;
+	std::vector<std::unique_ptr<CommandBuffer>> m_Recorders;
+
+	std::vector<uint32_t> m_Indices;					// Per draw scratch, kept to avoid allocating
+	std::vector<math::Float4> m_Positions;
+	std::vector<math::Float4> m_ClipPositions;
+
+	std::vector<PrepassDraw> m_PrepassDraws;			// Kept between frames like the scratch arrays
+	std::vector<math::Float4> m_PrepassPositions;
+	std::vector<uint32_t> m_PrepassIndices;
+	bool m_DepthPrepass;
+
+	Statistics m_LastFrameStatistics;
+	double m_FrameRasterMs;
+	uint64_t m_FrameDepthPixels;		// Shaded while a depth pass was bound
+	uint64_t m_LastFrameDepthPixels;
+	uint64_t m_DepthPassStartPixels;
+	uint64_t m_FramePrepassPixels;		// Depth only, shaded again at Present when visible
+	uint64_t m_LastFramePrepassPixels;
+	bool m_InDepthPass;
+
+	// Member functions
+	void RasterizeDraw(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex);
+	void ShadePrepassDraws();
+	const uint8_t* GetConstants(const ConstantBinding& binding, uint32_t byteSize) const;
+	static uint32_t GetShaderColor(PixelShaderHandle pixelShader);
+	static uint32_t GetElementSize(ElementFormat format);
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Lookup-or-create table for one kind of pipeline object
+// Creation goes through a callback, so the table itself can be driven by a mock device, and runs outside the lock so a slow creation doesn't stall lookups of other keys
+template <typename T, typename Deleter = std::default_delete<T>>
+class StateCacheTable final
+{
+public:
+	using CreateFunction = std::function<T*()>;	// A new object the table then owns, nullptr when creation failed
+
+	struct Statistics
+	{
+		uint32_t hits;
+		uint32_t misses;
+		uint32_t failures;
+		uint32_t duplicates;	// Created by two threads at once, the later one is dropped
+		double creationMs;
+	};
+
+	// Rule of five
+	StateCacheTable() = default;
+	~StateCacheTable() = default;
+
+	StateCacheTable(const StateCacheTable& other) = delete;
+	StateCacheTable(StateCacheTable&& other) = delete;
+	StateCacheTable& operator= (const StateCacheTable& other) = delete;
+	StateCacheTable& operator= (StateCacheTable&& other) = delete;
+
+	// Publics
+	T* GetOrCreate(uint64_t key, const CreateFunction& createFunction, bool* pCreated = nullptr)
+	{
+		if (pCreated) *pCreated = false;
+
+		// Hit
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			const auto foundIt = m_Entries.find(key);
+			if (foundIt != m_Entries.end())
+			{
+				++m_Statistics.hits;
+				return foundIt->second.get();
+			}
+
+			++m_Statistics.misses;
+		}
+
+		// Miss, create and time it
+		const auto startTime{ std::chrono::steady_clock::now() };
+		Entry pObject{ createFunction() };
+		const double creationMs{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count() };
+
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		m_Statistics.creationMs += creationMs;
+
+		if (!pObject)
+		{
+			++m_Statistics.failures;
+			return nullptr;
+		}
+
+		// Another thread may have created the same key meanwhile, everyone gets the object that was inserted first
+		const auto [entryIt, isInserted] = m_Entries.try_emplace(key, std::move(pObject));
+		if (!isInserted)
+		{
+			++m_Statistics.duplicates;
+			return entryIt->second.get();
+		}
+
+		if (pCreated) *pCreated = true;
+		return entryIt->second.get();
+	}
+
+	bool Contains(uint64_t key) const
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		return m_Entries.find(key) != m_Entries.end();
+	}
+	size_t GetSize() const
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		return m_Entries.size();
+	}
+	Statistics GetStatistics() const
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		return m_Statistics;
+	}
+	void Clear()
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		m_Entries.clear();
+		m_Statistics = {};
+	}
+
+private:
+	// Structs
+	using Entry = std::unique_ptr<T, Deleter>;
+
+	// Member variables
+	mutable std::mutex m_Mutex;
+	std::unordered_map<uint64_t, Entry> m_Entries;
+	Statistics m_Statistics{};
+};
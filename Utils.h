@@ -1,10 +1,16 @@
 #pragma once
 #include <string>
 #include <filesystem>
+#include <fstream>
+#include <functional>
+#include <vector>
 
 namespace utils
 {
-	std::wstring GetFullResourcePath(const std::wstring& resource)
+	// Reads a resource by name, lets loaders take their bytes from the preloaded assets instead of the disk
+	using ResourceReader = std::function<bool(const std::wstring& resource, std::vector<char>& readBytes)>;
+
+	inline std::wstring GetFullResourcePath(const std::wstring& resource)
 	{
 		// Get buildPath
 		wchar_t exePath[MAX_PATH];
@@ -14,4 +20,18 @@ namespace utils
 		// Return full path
 		return buildPath.wstring() + L"/" + resource;
 	}
-}
\ No newline at end of file
+
+	inline bool ReadBinaryFile(const std::wstring& filePath, std::vector<char>& readBytes)
+	{
+		// Open file at the end, so the size is known
+		std::ifstream file{ filePath.c_str(), std::ifstream::binary | std::ifstream::ate };
+		if (!file) return false;
+
+		// Read file
+		const std::streamsize fileSize{ file.tellg() };
+		file.seekg(0, std::ios::beg);
+
+		readBytes.resize(static_cast<size_t>(fileSize));
+		return static_cast<bool>(file.read(readBytes.data(), fileSize));
+	}
+}